@@ -75,6 +75,61 @@ extern "C" {
  */
 #define VIGEM_SUCCESS(_val_) (_val_ == VIGEM_ERROR_NONE)
 
+    /*
+     * Thread safety
+     *
+     * Once connected, a driver connection object may be used from any number of threads
+     * at the same time. vigem_connect, vigem_disconnect and vigem_free must not run
+     * concurrently with any other call on the same connection object.
+     *
+     * Report updates and queries may be issued for different targets from different
+     * threads in parallel; each call uses its own overlapped request. Concurrent
+     * vigem_target_add, vigem_target_remove, vigem_target_attach_source and
+     * vigem_target_detach_source calls on the same target are resolved atomically:
+     * exactly one of them proceeds, the others fail with VIGEM_ERROR_ALREADY_CONNECTED
+     * or VIGEM_ERROR_TARGET_NOT_PLUGGED_IN. Notification callbacks may be registered and
+     * unregistered from any thread, including from within the callback itself.
+     *
+     * vigem_target_free must not run concurrently with any other call on the same target.
+     */
+
+    /**
+     * Decides which bus a target added by vigem_target_add gets plugged into, if the
+     * client is connected to more than one bus device.
+     */
+    typedef enum _VIGEM_BUS_PLACEMENT
+    {
+        //
+        // Every target goes to the first bus found (default)
+        // 
+        VIGEM_BUS_PLACEMENT_FIRST = 0,
+        //
+        // Targets go to each bus in turn
+        // 
+        VIGEM_BUS_PLACEMENT_ROUND_ROBIN,
+        //
+        // Targets go to the bus with the fewest targets of this client
+        // 
+        VIGEM_BUS_PLACEMENT_LEAST_LOADED
+
+    } VIGEM_BUS_PLACEMENT, *PVIGEM_BUS_PLACEMENT;
+
+    /**
+     * Change of the bus devices present in the system, see vigem_register_bus_notification.
+     */
+    typedef enum _VIGEM_BUS_EVENT
+    {
+        //
+        // A bus device became available, e.g. after a driver update
+        // 
+        VIGEM_BUS_EVENT_ARRIVAL = 0,
+        //
+        // A bus device went away, its targets are gone
+        // 
+        VIGEM_BUS_EVENT_REMOVAL
+
+    } VIGEM_BUS_EVENT, *PVIGEM_BUS_EVENT;
+
     /** Defines an alias representing a driver connection object */
     typedef struct _VIGEM_CLIENT_T *PVIGEM_CLIENT;
 
@@ -106,6 +161,18 @@ extern "C" {
 
     typedef EVT_VIGEM_X360_NOTIFICATION *PFN_VIGEM_X360_NOTIFICATION;
 
+    typedef
+        _Function_class_(EVT_VIGEM_X360_USER_INDEX_NOTIFICATION)
+        VOID CALLBACK
+        EVT_VIGEM_X360_USER_INDEX_NOTIFICATION(
+            PVIGEM_CLIENT Client,
+            PVIGEM_TARGET Target,
+            ULONG UserIndex,
+            LPVOID UserData
+        );
+
+    typedef EVT_VIGEM_X360_USER_INDEX_NOTIFICATION *PFN_VIGEM_X360_USER_INDEX_NOTIFICATION;
+
     typedef
         _Function_class_(EVT_VIGEM_DS4_NOTIFICATION)
         VOID CALLBACK
@@ -120,6 +187,17 @@ extern "C" {
 
     typedef EVT_VIGEM_DS4_NOTIFICATION *PFN_VIGEM_DS4_NOTIFICATION;
 
+    typedef
+        _Function_class_(EVT_VIGEM_BUS_NOTIFICATION)
+        VOID CALLBACK
+        EVT_VIGEM_BUS_NOTIFICATION(
+            PVIGEM_CLIENT Client,
+            VIGEM_BUS_EVENT Event,
+            LPVOID UserData
+        );
+
+    typedef EVT_VIGEM_BUS_NOTIFICATION *PFN_VIGEM_BUS_NOTIFICATION;
+
     /**
      *  Allocates an object representing a driver connection
      *
@@ -142,7 +220,10 @@ extern "C" {
 
     /**
      * Initializes the driver object and establishes a connection to the emulation bus
-     *          driver. Returns an error if no compatible bus device has been found.
+     *          driver. Returns an error if no compatible bus device has been found. Every
+     *          compatible bus device present is opened, up to eight; bus-wide calls go to
+     *          the first one found. The bus devices found are remembered for the process,
+     *          later connects open them directly and only enumerate again if one is gone.
      *
      * @author	Benjamin "Nefarius" Hglinger-Stelzer
      * @date	28.08.2017
@@ -214,6 +295,27 @@ extern "C" {
      */
     VIGEM_API VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target);
 
+    /**
+     * Adds a provided target device to the given bus device, bypassing the placement set
+     *                with vigem_set_bus_placement.
+     *
+     * @param 	vigem   	The driver connection object.
+     * @param 	target  	The target device object.
+     * @param 	busIndex	Index of the bus device, below vigem_get_bus_count.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_add_to_bus(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, ULONG busIndex);
+
+    /**
+     * Returns the index of the bus device the provided target device got plugged into.
+     *
+     * @param 	target	The target device object.
+     *
+     * @returns	The bus index, 0 if the target isn't plugged in.
+     */
+    VIGEM_API ULONG vigem_target_get_bus_index(PVIGEM_TARGET target);
+
     /**
      * Adds a provided target device to the bus driver, which is equal to a device plug-in
      *          event of a physical hardware device. This function immediately returns. An optional
@@ -389,6 +491,21 @@ extern "C" {
      */
     VIGEM_API VIGEM_ERROR vigem_target_ds4_update_ex(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, DS4_REPORT_EX report);
 
+    /**
+     * Sends a report prepared in a caller-owned submit structure to the provided target
+     *                device, without copying it first. The structure is an XUSB_SUBMIT_REPORT,
+     *                DS4_SUBMIT_REPORT or DS4_SUBMIT_REPORT_EX (see ViGEm/km/BusShared.h)
+     *                matching the target type, initialized with its _INIT function. Its
+     *                SerialNo gets filled in, so it can be set up before the target is added.
+     *
+     * @param 	vigem 	The driver connection object.
+     * @param 	target	The target device object.
+     * @param 	submit	The submit structure.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_submit_report(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVOID submit);
+
     /**
      * Returns the internal index (serial number) the bus driver assigned to the provided
      *               target device object. Note that this value is specific to the inner workings of
@@ -449,6 +566,359 @@ extern "C" {
      */
     VIGEM_API VIGEM_ERROR vigem_target_x360_get_user_index(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PULONG index);
 
+    /**
+     * Registers a function which gets called once the host assigns a user index to the
+     *                provided Xenon device and every time it changes afterwards, replacing
+     *                polling vigem_target_x360_get_user_index. The callback runs on a worker
+     *                thread which ends when the target device is removed.
+     *
+     * @param 	vigem			The driver connection object.
+     * @param 	target			The target device object.
+     * @param 	notification	The notification callback.
+     * @param 	userData		The user data passed to the notification callback.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_x360_register_user_index_notification(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PFN_VIGEM_X360_USER_INDEX_NOTIFICATION notification, LPVOID userData);
+
+    /**
+     * Removes a previously registered user index callback function from the provided target
+     *                object. The worker thread exits with the next user index change.
+     *
+     * @param 	target	The target device object.
+     */
+    VIGEM_API void vigem_target_x360_unregister_user_index_notification(PVIGEM_TARGET target);
+
+    /**
+     * Uploads axis transform profiles (deadzones, response curves, inversion and remapping)
+     *                the bus driver applies to every report submitted to the provided target
+     *                device. Passing NULL removes an active transform.
+     *
+     * @param 	vigem   	The driver connection object.
+     * @param 	target  	The target device object.
+     * @param 	profiles	Array of VIGEM_AXIS_COUNT profiles indexed by VIGEM_AXIS, or NULL.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_axis_transform(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, const VIGEM_AXIS_PROFILE* profiles);
+
+    /**
+     * Enables or disables aggregation mode on an owned target device. While enabled, other
+     *                sessions may attach to the target with vigem_target_attach_source and their
+     *                reports get merged with the owner's: buttons are combined, axes follow the
+     *                selected axis mode.
+     *
+     * @param 	vigem   	The driver connection object.
+     * @param 	target  	The target device object.
+     * @param 	enable  	TRUE to accept reports from attached sessions.
+     * @param 	axisMode	How axis values of the sources get merged.
+     * @param 	priority	Priority of the owner's reports (higher wins).
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_aggregation(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, BOOL enable, VIGEM_AGGREGATION_AXIS_MODE axisMode, UCHAR priority);
+
+    /**
+     * Attaches a freshly allocated target device object to an existing target device owned by
+     *                another session. Reports submitted with it get merged in-bus. The target device
+     *                object must be of the same type as the existing target device.
+     *
+     * @param 	vigem   	The driver connection object.
+     * @param 	target  	The (not yet added) target device object.
+     * @param 	serialNo	The index (serial number) of the existing target device.
+     * @param 	priority	Priority of this session's reports (higher wins).
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_attach_source(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, ULONG serialNo, UCHAR priority);
+
+    /**
+     * Detaches a target device object attached with vigem_target_attach_source.
+     *
+     * @param 	vigem 	The driver connection object.
+     * @param 	target	The target device object.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_detach_source(PVIGEM_CLIENT vigem, PVIGEM_TARGET target);
+
+    /**
+     * Starts or stops recording the reports submitted to the provided target device and the
+     *                notifications the host sends back to it. The bus keeps the log (see
+     *                ViGEm/km/ReportLog.h) in a bounded ring; records that don't fit get dropped
+     *                until the log is drained. Stopping discards undrained data, restarting
+     *                begins a new log.
+     *
+     * @param 	vigem   	The driver connection object.
+     * @param 	target  	The target device object.
+     * @param 	enable  	TRUE to start recording, FALSE to stop.
+     * @param 	capacity	Size of the log ring in bytes, 0 for the default.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_recording(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, BOOL enable, ULONG capacity);
+
+    /**
+     * Moves recorded data of the provided target device into the supplied buffer. The chunks
+     *                of consecutive calls concatenate to a complete log, starting with a
+     *                VIGEM_REPORT_LOG_HEADER.
+     *
+     * @param 	vigem  	The driver connection object.
+     * @param 	target 	The target device object.
+     * @param 	buffer 	Receives the log data.
+     * @param 	length 	Size of buffer in bytes.
+     * @param 	written	Number of bytes written to buffer, 0 if the log is empty.
+     * @param 	dropped	Optional. Number of records dropped since recording started.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_drain_recording(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVOID buffer, ULONG length, PULONG written, PULONG dropped);
+
+    /**
+     * Starts or stops passing the output transfers the host sends to the provided target
+     *                device through unmodified. Unlike notifications, which carry the few
+     *                bytes the bus interprets, each transfer is kept whole with its length and
+     *                arrival time (see ViGEm/km/RawOutput.h) in a bounded ring; transfers that
+     *                don't fit get dropped until the ring is drained. Stopping discards
+     *                undrained transfers.
+     *
+     * @param 	vigem   	The driver connection object.
+     * @param 	target  	The target device object.
+     * @param 	enable  	TRUE to start passing transfers through, FALSE to stop.
+     * @param 	capacity	Size of the ring in bytes, 0 for the default.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_raw_output(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, BOOL enable, ULONG capacity);
+
+    /**
+     * Moves passed through output transfers of the provided target device into the supplied
+     *                buffer. Only whole records are moved, walk them with VIGEM_RAW_OUTPUT_NEXT.
+     *                The buffer should hold at least VIGEM_RAW_OUTPUT_MAX_RECORD bytes.
+     *
+     * @param 	vigem  	The driver connection object.
+     * @param 	target 	The target device object.
+     * @param 	buffer 	Receives the records.
+     * @param 	length 	Size of buffer in bytes.
+     * @param 	written	Number of bytes written to buffer, 0 if no transfer is pending.
+     * @param 	dropped	Optional. Number of transfers dropped since passthrough started.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_drain_raw_output(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVOID buffer, ULONG length, PULONG written, PULONG dropped);
+
+    /**
+     * Submits the reports of a recorded log to the provided target device, preserving their
+     *                original timing scaled by the given speed factor. The log may be a
+     *                memory-mapped file. Blocks until the last report got submitted.
+     *
+     * @param 	vigem 	The driver connection object.
+     * @param 	target	The target device object, must be of the recorded type.
+     * @param 	log   	The log data.
+     * @param 	length	Size of the log data in bytes.
+     * @param 	speed 	Playback speed factor, 1.0 for original timing.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_replay(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, const VOID* log, ULONG length, double speed);
+
+    /**
+     * Starts a macro (e.g. turbo or a timed button sequence) the bus driver overlays onto the
+     *                reports of the provided target device, or stops the macro running in the
+     *                given slot if stepCount is 0. Steps are timed by the bus at millisecond
+     *                resolution, no further calls are needed while the macro runs.
+     *
+     * @param 	vigem      	The driver connection object.
+     * @param 	target     	The target device object.
+     * @param 	slot       	The macro slot (0 - VIGEM_MACRO_MAX_SLOTS - 1).
+     * @param 	steps      	The sequence, or NULL to stop the macro.
+     * @param 	stepCount  	Number of steps (up to VIGEM_MACRO_MAX_STEPS), 0 to stop the macro.
+     * @param 	repeatCount	Number of times the sequence runs, 0 to repeat until stopped.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_macro(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, UCHAR slot, const VIGEM_MACRO_STEP* steps, USHORT stepCount, USHORT repeatCount);
+
+    /**
+     * Sets the scheduling class of all reports submitted through this driver connection.
+     *                Reports exceeding the rate of the class are not rejected; the bus keeps
+     *                only the latest one per target and delivers it once the budget allows.
+     *
+     * @param 	vigem           	The driver connection object.
+     * @param 	qosClass        	The scheduling class, VIGEM_QOS_CLASS_INTERACTIVE is unlimited.
+     * @param 	reportsPerSecond	Sustained reports per second, 0 for the class default.
+     * @param 	burst           	Reports admitted back to back, 0 for the class default.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_set_session_qos(PVIGEM_CLIENT vigem, VIGEM_QOS_CLASS qosClass, ULONG reportsPerSecond, ULONG burst);
+
+    /**
+     * Retrieves how many USB request blocks of each function the provided target device
+     *                handled since it got plugged in.
+     *
+     * @param 	vigem 	The driver connection object.
+     * @param 	target	The target device object.
+     * @param 	counts	Receives VIGEM_URB_STAT_COUNT counters, indexed by VIGEM_URB_STATISTIC.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_get_urb_statistics(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PULONGLONG counts);
+
+    /**
+     * Retrieves the memory the bus currently holds for the provided target device. Buffers
+     *                for notifications and the interrupt timer only exist once used and get
+     *                released again while the device is idle.
+     *
+     * @param 	vigem    	The driver connection object.
+     * @param 	target   	The target device object.
+     * @param 	footprint	Receives the sizes and allocated VIGEM_TARGET_RESOURCE flags.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_get_footprint(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVIGEM_TARGET_FOOTPRINT footprint);
+
+    /**
+     * Retrieves when the host is expected to poll the input pipe of the provided target
+     *                device next. Feeders can time their submissions to arrive just before it
+     *                instead of waiting up to a full poll interval. The estimate is updated
+     *                on every poll, querying it does not block.
+     *
+     * @param 	vigem	The driver connection object.
+     * @param 	target	The target device object.
+     * @param 	phase	Receives the estimate, see VIGEM_POLL_PHASE.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_get_poll_phase(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVIGEM_POLL_PHASE phase);
+
+    /**
+     * Retrieves when the provided target device reached each phase of its plug-in, from
+     *                the request arriving at the bus to the device being ready for reports.
+     *                Differences between consecutive phases tell where time-to-ready is
+     *                spent. Phases not reached (yet) read 0.
+     *
+     * @param 	vigem   	The driver connection object.
+     * @param 	target  	The target device object.
+     * @param 	timeline	Receives the timestamps, indexed by VIGEM_PLUGIN_PHASE.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_get_plugin_timeline(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVIGEM_PLUGIN_TIMELINE timeline);
+
+    /**
+     * Starts or stops the binary event trace of the bus. Stopping discards events not yet
+     *                drained. Restarting with a different capacity starts with empty rings.
+     *                The trace covers all sessions, so the driver connection must have been
+     *                opened by an administrator.
+     *
+     * @param 	vigem   	The driver connection object.
+     * @param 	enable  	TRUE to start, FALSE to stop the trace.
+     * @param 	capacity	Events kept per processor until drained, a power of two; 0 selects
+     *                  	VIGEM_EVENT_TRACE_DEFAULT_CAPACITY.
+     *
+     * @returns	A VIGEM_ERROR, VIGEM_ERROR_BUS_ACCESS_FAILED without administrator rights.
+     */
+    VIGEM_API VIGEM_ERROR vigem_set_event_trace(PVIGEM_CLIENT vigem, BOOL enable, ULONG capacity);
+
+    /**
+     * Moves recorded events out of the bus. Records are VIGEM_EVENT_RECORD structures
+     *                (see ViGEm/km/EventTrace.h), ordered by time per processor; merge them by
+     *                Timestamp for a global timeline. Like vigem_set_event_trace this needs
+     *                a driver connection opened by an administrator.
+     *
+     * @param 	vigem    	The driver connection object.
+     * @param 	records  	Receives the records.
+     * @param 	count    	Capacity of records in VIGEM_EVENT_RECORD units.
+     * @param 	drained  	Receives the number of records written.
+     * @param 	dropped  	Optional, receives the number of events lost to full rings.
+     * @param 	frequency	Optional, receives the timestamp frequency in counts per second.
+     *
+     * @returns	A VIGEM_ERROR, VIGEM_ERROR_BUS_ACCESS_FAILED without administrator rights.
+     */
+    VIGEM_API VIGEM_ERROR vigem_drain_events(PVIGEM_CLIENT vigem, PVOID records, ULONG count, PULONG drained, PULONGLONG dropped, PULONGLONG frequency);
+
+    /**
+     * Keeps the given number of targets of a type pre-created and initialized on the bus.
+     *                vigem_target_add claims one of these instead of waiting for a new device
+     *                to enumerate, if the target uses the default vendor and product IDs. Once
+     *                removed or its client disconnects, a claimed target gets its state reset
+     *                and returns to the pool while it is below depth. The pool gets topped up
+     *                once half of it is claimed. Idle pooled targets are visible to the system
+     *                like any other connected controller.
+     *
+     * @param 	vigem	The driver connection object.
+     * @param 	type 	The target type, Xbox360Wired or DualShock4Wired.
+     * @param 	depth	Idle targets to keep, up to VIGEM_TARGET_POOL_MAX_DEPTH; 0 disables
+     *               	pooling and removes idle targets.
+     *
+     * @returns	A VIGEM_ERROR, VIGEM_ERROR_BUS_ACCESS_FAILED without administrator rights.
+     */
+    VIGEM_API VIGEM_ERROR vigem_set_target_pool(PVIGEM_CLIENT vigem, VIGEM_TARGET_TYPE type, ULONG depth);
+
+    /**
+     * Retrieves the functionality and limits the connected bus reported on vigem_connect.
+     *                The library uses them to pick the fastest data path the driver offers
+     *                and fails unsupported calls without a round-trip. Fields beyond
+     *                capabilities->Size weren't reported by the driver and read 0.
+     *
+     * @param 	vigem			The driver connection object.
+     * @param 	capabilities	Receives the capabilities, see VIGEM_BUS_CAPABILITIES.
+     *
+     * @returns	A VIGEM_ERROR, VIGEM_ERROR_NOT_SUPPORTED if the driver predates this query.
+     */
+    VIGEM_API VIGEM_ERROR vigem_get_capabilities(PVIGEM_CLIENT vigem, PVIGEM_BUS_CAPABILITIES capabilities);
+
+    /**
+     * Sets how vigem_target_add spreads targets across the connected bus devices. Each bus
+     *                enumerates and services its targets on its own, so spreading many
+     *                targets keeps one bus from becoming the bottleneck.
+     *
+     * @param 	vigem	 	The driver connection object.
+     * @param 	placement	The placement policy, see VIGEM_BUS_PLACEMENT.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_set_bus_placement(PVIGEM_CLIENT vigem, VIGEM_BUS_PLACEMENT placement);
+
+    /**
+     * Returns the number of bus devices the driver connection object is connected to.
+     *
+     * @param 	vigem	The driver connection object.
+     *
+     * @returns	The bus count, 0 if not connected.
+     */
+    VIGEM_API ULONG vigem_get_bus_count(PVIGEM_CLIENT vigem);
+
+    /**
+     * Registers a function which gets called when a bus device arrives or goes away, so a
+     *                disconnected client can reconnect as soon as the bus is back instead of
+     *                polling vigem_connect. The registration is kept across vigem_disconnect
+     *                and vigem_connect and only ends with vigem_unregister_bus_notification
+     *                or vigem_free. The callback runs on a system thread and must not call
+     *                vigem_unregister_bus_notification or vigem_free itself; it may call
+     *                vigem_connect and vigem_disconnect if no other thread does.
+     *
+     * @param 	vigem			The driver connection object.
+     * @param 	notification	The notification callback.
+     * @param 	userData		The user data passed to the notification callback.
+     *
+     * @returns	A VIGEM_ERROR, VIGEM_ERROR_NOT_SUPPORTED before Windows 8.
+     */
+    VIGEM_API VIGEM_ERROR vigem_register_bus_notification(
+        PVIGEM_CLIENT vigem,
+        PFN_VIGEM_BUS_NOTIFICATION notification,
+        LPVOID userData
+    );
+
+    /**
+     * Removes a previously registered bus notification callback. Once returned the callback
+     *                doesn't run anymore.
+     *
+     * @param 	vigem	The driver connection object.
+     */
+    VIGEM_API void vigem_unregister_bus_notification(PVIGEM_CLIENT vigem);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,441 @@
+/*
+MIT License
+
+Copyright (c) 2017-2020 Nefarius Software Solutions e.U. and Contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+//
+// Header-only C++ layer on top of the C client API. Reports are built in place
+// inside the submit structure the driver receives, so sending one involves no
+// intermediate copies and no heap allocations after the target got created.
+// 
+// Requires C++17. Nothing here throws; errors are returned as VIGEM_ERROR.
+// 
+
+#pragma once
+
+#include <utility>
+#include <cstddef>
+
+#include "ViGEm/Client.h"
+#include "ViGEm/km/BusShared.h"
+
+#if defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
+
+namespace vigem
+{
+    /**
+     * Owns a driver connection object, disconnects and frees it on destruction.
+     */
+    class Client
+    {
+    public:
+        Client() noexcept : _client(vigem_alloc())
+        {
+        }
+
+        ~Client()
+        {
+            reset();
+        }
+
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        Client(Client&& other) noexcept : _client(std::exchange(other._client, nullptr))
+        {
+        }
+
+        Client& operator=(Client&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                _client = std::exchange(other._client, nullptr);
+            }
+            return *this;
+        }
+
+        VIGEM_ERROR connect() noexcept
+        {
+            return _client ? vigem_connect(_client) : VIGEM_ERROR_BUS_INVALID_HANDLE;
+        }
+
+        void disconnect() noexcept
+        {
+            if (_client)
+                vigem_disconnect(_client);
+        }
+
+        PVIGEM_CLIENT get() const noexcept { return _client; }
+
+        explicit operator bool() const noexcept { return _client != nullptr; }
+
+    private:
+        void reset() noexcept
+        {
+            if (!_client)
+                return;
+
+            vigem_disconnect(_client);
+            vigem_free(_client);
+            _client = nullptr;
+        }
+
+        PVIGEM_CLIENT _client;
+    };
+
+    /**
+     * Owns a target device object together with the submit structure its reports are
+     * built in. Removed from the bus (if added) and freed on destruction.
+     */
+    class Target
+    {
+    public:
+        ~Target()
+        {
+            reset();
+        }
+
+        Target(const Target&) = delete;
+        Target& operator=(const Target&) = delete;
+
+        VIGEM_ERROR add(const Client& client) noexcept
+        {
+            if (!_target)
+                return VIGEM_ERROR_TARGET_UNINITIALIZED;
+
+            const auto error = vigem_target_add(client.get(), _target);
+
+            if (VIGEM_SUCCESS(error))
+                _client = client.get();
+
+            return error;
+        }
+
+        VIGEM_ERROR remove() noexcept
+        {
+            if (!_client)
+                return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
+
+            const auto error = vigem_target_remove(std::exchange(_client, nullptr), _target);
+
+            return error;
+        }
+
+        /**
+         * Sends the report currently held in the submit structure.
+         */
+        VIGEM_ERROR submit() noexcept
+        {
+            if (!_client)
+                return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
+
+            return vigem_target_submit_report(_client, _target, &_submit);
+        }
+
+        ULONG index() const noexcept { return _target ? vigem_target_get_index(_target) : 0; }
+
+        bool attached() const noexcept { return _target && vigem_target_is_attached(_target); }
+
+        PVIGEM_TARGET get() const noexcept { return _target; }
+
+        explicit operator bool() const noexcept { return _target != nullptr; }
+
+    protected:
+        explicit Target(PVIGEM_TARGET target) noexcept : _target(target), _client(nullptr), _submit{}
+        {
+        }
+
+        Target(Target&& other) noexcept :
+            _target(std::exchange(other._target, nullptr)),
+            _client(std::exchange(other._client, nullptr)),
+            _submit(other._submit)
+        {
+        }
+
+        Target& operator=(Target&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                _target = std::exchange(other._target, nullptr);
+                _client = std::exchange(other._client, nullptr);
+                _submit = other._submit;
+            }
+            return *this;
+        }
+
+        //
+        // Storage for the submit structure matching the target type
+        // 
+        union SubmitBuffer
+        {
+            XUSB_SUBMIT_REPORT Xusb;
+            DS4_SUBMIT_REPORT_EX Ds4;
+        };
+
+        PVIGEM_TARGET _target;
+        PVIGEM_CLIENT _client;
+        SubmitBuffer _submit;
+
+    private:
+        void reset() noexcept
+        {
+            if (!_target)
+                return;
+
+            if (_client)
+                vigem_target_remove(_client, _target);
+
+            vigem_target_free(_target);
+            _target = nullptr;
+            _client = nullptr;
+        }
+    };
+
+    /**
+     * Writes into the XUSB_REPORT of an X360Target. Setters can be chained.
+     */
+    class X360ReportBuilder
+    {
+    public:
+        explicit X360ReportBuilder(XUSB_REPORT& report) noexcept : _report(report)
+        {
+        }
+
+        X360ReportBuilder& clear() noexcept
+        {
+            _report = XUSB_REPORT{};
+            return *this;
+        }
+
+        X360ReportBuilder& buttons(USHORT mask) noexcept
+        {
+            _report.wButtons = mask;
+            return *this;
+        }
+
+        X360ReportBuilder& press(XUSB_BUTTON button) noexcept
+        {
+            _report.wButtons |= static_cast<USHORT>(button);
+            return *this;
+        }
+
+        X360ReportBuilder& release(XUSB_BUTTON button) noexcept
+        {
+            _report.wButtons &= static_cast<USHORT>(~button);
+            return *this;
+        }
+
+        X360ReportBuilder& triggers(BYTE left, BYTE right) noexcept
+        {
+            _report.bLeftTrigger = left;
+            _report.bRightTrigger = right;
+            return *this;
+        }
+
+        X360ReportBuilder& left_thumb(SHORT x, SHORT y) noexcept
+        {
+            _report.sThumbLX = x;
+            _report.sThumbLY = y;
+            return *this;
+        }
+
+        X360ReportBuilder& right_thumb(SHORT x, SHORT y) noexcept
+        {
+            _report.sThumbRX = x;
+            _report.sThumbRY = y;
+            return *this;
+        }
+
+        XUSB_REPORT& raw() noexcept { return _report; }
+
+    private:
+        XUSB_REPORT& _report;
+    };
+
+    /**
+     * Writes into the DS4_REPORT_EX of a Ds4Target. Setters can be chained.
+     */
+    class Ds4ReportBuilder
+    {
+    public:
+        explicit Ds4ReportBuilder(DS4_REPORT_EX& report) noexcept : _report(report)
+        {
+        }
+
+        //
+        // Resets to the neutral state (centered sticks, D-Pad released)
+        // 
+        Ds4ReportBuilder& clear() noexcept
+        {
+            _report = DS4_REPORT_EX{};
+            DS4_REPORT_INIT(reinterpret_cast<PDS4_REPORT>(&_report.Report));
+            return *this;
+        }
+
+        Ds4ReportBuilder& buttons(USHORT mask) noexcept
+        {
+            _report.Report.wButtons = static_cast<USHORT>((_report.Report.wButtons & 0xF) | (mask & ~0xF));
+            return *this;
+        }
+
+        Ds4ReportBuilder& press(DS4_BUTTONS button) noexcept
+        {
+            _report.Report.wButtons |= static_cast<USHORT>(button);
+            return *this;
+        }
+
+        Ds4ReportBuilder& release(DS4_BUTTONS button) noexcept
+        {
+            _report.Report.wButtons &= static_cast<USHORT>(~button);
+            return *this;
+        }
+
+        Ds4ReportBuilder& dpad(DS4_DPAD_DIRECTIONS direction) noexcept
+        {
+            _report.Report.wButtons = static_cast<USHORT>((_report.Report.wButtons & ~0xF) | direction);
+            return *this;
+        }
+
+        Ds4ReportBuilder& special(BYTE mask) noexcept
+        {
+            _report.Report.bSpecial = mask;
+            return *this;
+        }
+
+        Ds4ReportBuilder& triggers(BYTE left, BYTE right) noexcept
+        {
+            _report.Report.bTriggerL = left;
+            _report.Report.bTriggerR = right;
+            return *this;
+        }
+
+        Ds4ReportBuilder& left_thumb(BYTE x, BYTE y) noexcept
+        {
+            _report.Report.bThumbLX = x;
+            _report.Report.bThumbLY = y;
+            return *this;
+        }
+
+        Ds4ReportBuilder& right_thumb(BYTE x, BYTE y) noexcept
+        {
+            _report.Report.bThumbRX = x;
+            _report.Report.bThumbRY = y;
+            return *this;
+        }
+
+        Ds4ReportBuilder& gyro(SHORT x, SHORT y, SHORT z) noexcept
+        {
+            _report.Report.wGyroX = x;
+            _report.Report.wGyroY = y;
+            _report.Report.wGyroZ = z;
+            return *this;
+        }
+
+        Ds4ReportBuilder& accel(SHORT x, SHORT y, SHORT z) noexcept
+        {
+            _report.Report.wAccelX = x;
+            _report.Report.wAccelY = y;
+            _report.Report.wAccelZ = z;
+            return *this;
+        }
+
+        Ds4ReportBuilder& touch(const DS4_TOUCH& current, BYTE packets = 1) noexcept
+        {
+            _report.Report.sCurrentTouch = current;
+            _report.Report.bTouchPacketsN = packets;
+            return *this;
+        }
+
+        DS4_REPORT_EX& raw() noexcept { return _report; }
+
+    private:
+        DS4_REPORT_EX& _report;
+    };
+
+    /**
+     * An Xbox 360 Controller target.
+     */
+    class X360Target final : public Target
+    {
+    public:
+        X360Target() noexcept : Target(vigem_target_x360_alloc())
+        {
+            XUSB_SUBMIT_REPORT_INIT(&_submit.Xusb, 0);
+        }
+
+        X360Target(X360Target&&) noexcept = default;
+        X360Target& operator=(X360Target&&) noexcept = default;
+
+        X360ReportBuilder report() noexcept { return X360ReportBuilder(_submit.Xusb.Report); }
+    };
+
+    /**
+     * A DualShock 4 Controller target, always submitting the full input report.
+     */
+    class Ds4Target final : public Target
+    {
+    public:
+        Ds4Target() noexcept : Target(vigem_target_ds4_alloc())
+        {
+            DS4_SUBMIT_REPORT_EX_INIT(&_submit.Ds4, 0);
+            report().clear();
+        }
+
+        Ds4Target(Ds4Target&&) noexcept = default;
+        Ds4Target& operator=(Ds4Target&&) noexcept = default;
+
+        Ds4ReportBuilder report() noexcept { return Ds4ReportBuilder(_submit.Ds4.Report); }
+    };
+
+    /**
+     * Submits the pending report of each target, stopping at the first failure.
+     * 
+     * @returns	VIGEM_ERROR_NONE or the first error encountered.
+     */
+    inline VIGEM_ERROR submit_all(Target* const* targets, std::size_t count) noexcept
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const auto error = targets[i]->submit();
+
+            if (!VIGEM_SUCCESS(error))
+                return error;
+        }
+
+        return VIGEM_ERROR_NONE;
+    }
+
+#if defined(__cpp_lib_span)
+    inline VIGEM_ERROR submit_all(std::span<Target* const> targets) noexcept
+    {
+        return submit_all(targets.data(), targets.size());
+    }
+#endif
+}
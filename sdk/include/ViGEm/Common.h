@@ -254,3 +254,495 @@ typedef struct _DS4_REPORT_EX
 } DS4_REPORT_EX, *PDS4_REPORT_EX;
 
 #include <poppack.h>
+
+//
+// Logical controller axes a transform profile can be applied to.
+// 
+// Stick axes are kept in the native orientation of the target type
+// (XUSB: Y up is positive, DualShock 4: Y down is positive).
+// 
+typedef enum _VIGEM_AXIS
+{
+    VIGEM_AXIS_THUMB_LX = 0,
+    VIGEM_AXIS_THUMB_LY,
+    VIGEM_AXIS_THUMB_RX,
+    VIGEM_AXIS_THUMB_RY,
+    VIGEM_AXIS_TRIGGER_L,
+    VIGEM_AXIS_TRIGGER_R,
+
+    VIGEM_AXIS_COUNT
+
+} VIGEM_AXIS, *PVIGEM_AXIS;
+
+//
+// Number of points of an axis response curve.
+// 
+#define VIGEM_AXIS_CURVE_POINTS         17
+
+//
+// Largest normalized axis magnitude.
+// 
+#define VIGEM_AXIS_MAX                  0x7FFF
+
+//
+// Inverts the output direction of an axis.
+// 
+#define VIGEM_AXIS_FLAG_INVERT          0x01
+
+//
+// Describes how a single output axis is computed from the submitted report.
+// 
+// All values are normalized magnitudes (0 - VIGEM_AXIS_MAX), so the same
+// profile works for XUSB and DualShock 4 targets.
+// 
+typedef struct _VIGEM_AXIS_PROFILE
+{
+    //
+    // Axis (VIGEM_AXIS) the input value is read from.
+    // 
+    UCHAR Source;
+
+    //
+    // Combination of VIGEM_AXIS_FLAG_* values.
+    // 
+    UCHAR Flags;
+
+    //
+    // Inner deadzone; magnitudes up to this value are reported as zero.
+    // 
+    USHORT Deadzone;
+
+    //
+    // Output magnitude at equidistant input magnitudes (after deadzone
+    // removal), linearly interpolated in between. Must be non-decreasing.
+    // 
+    USHORT Curve[VIGEM_AXIS_CURVE_POINTS];
+
+} VIGEM_AXIS_PROFILE, *PVIGEM_AXIS_PROFILE;
+
+//
+// Initializes a VIGEM_AXIS_PROFILE structure to a pass-through profile.
+// 
+VOID FORCEINLINE VIGEM_AXIS_PROFILE_INIT(
+    _Out_ PVIGEM_AXIS_PROFILE Profile,
+    _In_ VIGEM_AXIS Axis
+)
+{
+    int i;
+
+    RtlZeroMemory(Profile, sizeof(VIGEM_AXIS_PROFILE));
+
+    Profile->Source = (UCHAR)Axis;
+
+    for (i = 0; i < VIGEM_AXIS_CURVE_POINTS; i++)
+    {
+        Profile->Curve[i] = (USHORT)((i * VIGEM_AXIS_MAX + (VIGEM_AXIS_CURVE_POINTS - 1) / 2) / (VIGEM_AXIS_CURVE_POINTS - 1));
+    }
+}
+
+//
+// Maximum number of sessions (including the owner) feeding one target.
+// 
+#define VIGEM_AGGREGATION_MAX_SOURCES   4
+
+//
+// Rules for merging axes of multiple sources driving one target.
+// 
+// Buttons of all sources are always combined (logical OR).
+// 
+typedef enum _VIGEM_AGGREGATION_AXIS_MODE
+{
+    //
+    // The value deflected the furthest from neutral wins.
+    // 
+    VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE = 0,
+
+    //
+    // The highest priority source deflecting the axis wins.
+    // 
+    VIGEM_AGGREGATION_AXIS_PRIORITY = 1
+
+} VIGEM_AGGREGATION_AXIS_MODE, *PVIGEM_AGGREGATION_AXIS_MODE;
+
+//
+// Maximum number of steps of one macro.
+// 
+#define VIGEM_MACRO_MAX_STEPS           16
+
+//
+// Maximum number of macros running on one target at the same time.
+// 
+#define VIGEM_MACRO_MAX_SLOTS           8
+
+//
+// D-Pad directions of DS4 macro buttons; the hat value in wButtons is
+// replaced by this direction mask (and bSpecial moves to bits 16-23).
+// 
+#define VIGEM_MACRO_DS4_DPAD_NORTH      0x01
+#define VIGEM_MACRO_DS4_DPAD_EAST       0x02
+#define VIGEM_MACRO_DS4_DPAD_SOUTH      0x04
+#define VIGEM_MACRO_DS4_DPAD_WEST       0x08
+
+//
+// One step of a macro sequence, overlaid onto the reports of a target.
+// 
+typedef struct _VIGEM_MACRO_STEP
+{
+    //
+    // How long this step is held, in milliseconds (at least 1).
+    // 
+    USHORT DurationMs;
+
+    //
+    // Bit (1 << VIGEM_AXIS) set for every axis overridden by Axes.
+    // 
+    USHORT AxisMask;
+
+    //
+    // Buttons forced pressed (XUSB_BUTTON or DS4 buttons as described above).
+    // 
+    ULONG ButtonsSet;
+
+    //
+    // Buttons forced released.
+    // 
+    ULONG ButtonsClear;
+
+    //
+    // Axis values; sticks are signed, triggers range 0 - VIGEM_AXIS_MAX.
+    // 
+    SHORT Axes[VIGEM_AXIS_COUNT];
+
+} VIGEM_MACRO_STEP, *PVIGEM_MACRO_STEP;
+
+//
+// Scheduling classes of sessions submitting reports.
+// 
+// Reports exceeding the rate of a class are not rejected; the latest one
+// is held back and delivered as soon as the rate allows.
+// 
+typedef enum _VIGEM_QOS_CLASS
+{
+    //
+    // No rate limit (default).
+    // 
+    VIGEM_QOS_CLASS_INTERACTIVE = 0,
+
+    //
+    // Limited well above any device polling rate.
+    // 
+    VIGEM_QOS_CLASS_NORMAL = 1,
+
+    //
+    // Limited to keep bulk or scripted feeders from crowding others out.
+    // 
+    VIGEM_QOS_CLASS_BACKGROUND = 2,
+
+    VIGEM_QOS_CLASS_COUNT
+
+} VIGEM_QOS_CLASS, *PVIGEM_QOS_CLASS;
+
+//
+// USB request block functions counted per target by the bus.
+// 
+typedef enum _VIGEM_URB_STATISTIC
+{
+    VIGEM_URB_STAT_BULK_OR_INTERRUPT_TRANSFER = 0,
+    VIGEM_URB_STAT_CONTROL_TRANSFER,
+    VIGEM_URB_STAT_CONTROL_TRANSFER_EX,
+    VIGEM_URB_STAT_SELECT_CONFIGURATION,
+    VIGEM_URB_STAT_SELECT_INTERFACE,
+    VIGEM_URB_STAT_GET_DESCRIPTOR_FROM_DEVICE,
+    VIGEM_URB_STAT_GET_STATUS_FROM_DEVICE,
+    VIGEM_URB_STAT_ABORT_PIPE,
+    VIGEM_URB_STAT_CLASS_INTERFACE,
+    VIGEM_URB_STAT_GET_DESCRIPTOR_FROM_INTERFACE,
+
+    //
+    // Any function not listed above.
+    // 
+    VIGEM_URB_STAT_OTHER,
+
+    VIGEM_URB_STAT_COUNT
+
+} VIGEM_URB_STATISTIC, *PVIGEM_URB_STATISTIC;
+
+//
+// Optional resources a target allocates on first use, see VIGEM_TARGET_FOOTPRINT.
+// 
+typedef enum _VIGEM_TARGET_RESOURCE
+{
+    //
+    // Buffers holding host notifications until the owner retrieves them.
+    // 
+    VIGEM_TARGET_RESOURCE_NOTIFICATION_BUFFERS = 0x01,
+
+    //
+    // Membership in the bus tick pacing interrupt IN transfers (DualShock 4 only).
+    // 
+    VIGEM_TARGET_RESOURCE_INPUT_TIMER = 0x02,
+
+    //
+    // Storage of an active report log.
+    // 
+    VIGEM_TARGET_RESOURCE_REPORT_LOG = 0x04,
+
+    //
+    // Ring of an active raw output passthrough.
+    // 
+    VIGEM_TARGET_RESOURCE_RAW_OUTPUT = 0x08
+
+} VIGEM_TARGET_RESOURCE, *PVIGEM_TARGET_RESOURCE;
+
+//
+// Memory held by a target device on the bus.
+// 
+typedef struct _VIGEM_TARGET_FOOTPRINT
+{
+    //
+    // Size of the target object itself, allocated while plugged in.
+    // 
+    ULONG ObjectSize;
+
+    //
+    // Bytes of notification buffers, 0 if not allocated.
+    // 
+    ULONG NotificationBufferSize;
+
+    //
+    // Bytes of report log storage, 0 if not recording.
+    // 
+    ULONG ReportLogSize;
+
+    //
+    // Combination of VIGEM_TARGET_RESOURCE flags currently allocated.
+    // 
+    ULONG Resources;
+
+    //
+    // Bytes of raw output ring storage, 0 if passthrough is off.
+    // 
+    ULONG RawOutputSize;
+
+} VIGEM_TARGET_FOOTPRINT, *PVIGEM_TARGET_FOOTPRINT;
+
+//
+// Most idle targets the bus keeps pre-created per type.
+// 
+#define VIGEM_TARGET_POOL_MAX_DEPTH     16
+
+//
+// Estimated timing of the host polling the input pipe of a target device.
+// 
+// Times are in 100ns units of system interrupt time (KeQueryInterruptTime,
+// QueryInterruptTime). Submitting shortly before NextPoll minimizes the
+// age of the report the host picks up.
+// 
+typedef struct _VIGEM_POLL_PHASE
+{
+    //
+    // Interrupt time the estimate was taken at.
+    // 
+    ULONGLONG Now;
+
+    //
+    // Estimated time of the most recent poll, 0 without samples.
+    // 
+    ULONGLONG LastPoll;
+
+    //
+    // Predicted time of the next poll after Now, 0 while Period is unknown.
+    // 
+    ULONGLONG NextPoll;
+
+    //
+    // Estimated poll period.
+    // 
+    ULONG Period;
+
+    //
+    // Mean deviation of polls from the prediction.
+    // 
+    ULONG Jitter;
+
+    //
+    // Polls observed since the estimate was last acquired.
+    // 
+    ULONG Samples;
+
+    //
+    // TRUE once enough polls matched the prediction to rely on it.
+    // 
+    BOOL Locked;
+
+} VIGEM_POLL_PHASE, *PVIGEM_POLL_PHASE;
+
+//
+// Phases a target device passes through from plug-in until it's ready.
+// 
+typedef enum _VIGEM_PLUGIN_PHASE
+{
+    //
+    // Plug-in request arrived at the bus.
+    // 
+    VIGEM_PLUGIN_PHASE_REQUESTED,
+    //
+    // Bus-side resources of the target got set up.
+    // 
+    VIGEM_PLUGIN_PHASE_PREPARED,
+    //
+    // Child device object got created.
+    // 
+    VIGEM_PLUGIN_PHASE_DEVICE_CREATED,
+    //
+    // Child device entered the working state.
+    // 
+    VIGEM_PLUGIN_PHASE_HARDWARE_PREPARED,
+    //
+    // Host requested the first descriptor.
+    // 
+    VIGEM_PLUGIN_PHASE_DESCRIPTOR_REQUESTED,
+    //
+    // Host selected a configuration.
+    // 
+    VIGEM_PLUGIN_PHASE_CONFIGURED,
+    //
+    // Host started reading input (XUSB init sequence done, first DS4 interrupt transfer).
+    // 
+    VIGEM_PLUGIN_PHASE_INPUT_STARTED,
+    //
+    // Device is ready to receive reports (boot event signaled).
+    // 
+    VIGEM_PLUGIN_PHASE_READY,
+
+    VIGEM_PLUGIN_PHASE_COUNT
+
+} VIGEM_PLUGIN_PHASE, *PVIGEM_PLUGIN_PHASE;
+
+//
+// Time-to-ready breakdown of a target device plug-in.
+// 
+// Times are in 100ns units of system interrupt time (KeQueryInterruptTime,
+// QueryInterruptTime), indexed by VIGEM_PLUGIN_PHASE. A phase not reached
+// (yet) reads 0. Each phase records its first occurrence only.
+// 
+typedef struct _VIGEM_PLUGIN_TIMELINE
+{
+    ULONGLONG Timestamps[VIGEM_PLUGIN_PHASE_COUNT];
+
+} VIGEM_PLUGIN_TIMELINE, *PVIGEM_PLUGIN_TIMELINE;
+
+//
+// Optional functionality of the bus driver, see VIGEM_BUS_CAPABILITIES.
+// 
+typedef enum _VIGEM_BUS_FEATURE
+{
+    //
+    // The bus assigns free serials on plug-in.
+    // 
+    VIGEM_BUS_FEATURE_ASSIGN_SERIAL = 0x0001,
+
+    //
+    // Plug-in returns right away, readiness is awaited separately.
+    // 
+    VIGEM_BUS_FEATURE_WAIT_DEVICE_READY = 0x0002,
+
+    //
+    // DualShock 4 targets accept full reports.
+    // 
+    VIGEM_BUS_FEATURE_DS4_REPORT_EX = 0x0004,
+
+    //
+    // Idle targets can be kept pre-created per type.
+    // 
+    VIGEM_BUS_FEATURE_TARGET_POOL = 0x0008,
+
+    //
+    // Axis transforms, aggregation of sources and macros are applied to reports.
+    // 
+    VIGEM_BUS_FEATURE_REPORT_PROCESSING = 0x0010,
+
+    //
+    // Reports and output can be recorded into rings drained in bulk.
+    // 
+    VIGEM_BUS_FEATURE_RECORDING_RINGS = 0x0020,
+
+    //
+    // Bus events can be traced into a ring drained in bulk.
+    // 
+    VIGEM_BUS_FEATURE_EVENT_TRACE = 0x0040,
+
+    //
+    // Xbox 360 user index changes can be awaited instead of polled.
+    // 
+    VIGEM_BUS_FEATURE_USER_INDEX_WAIT = 0x0080,
+
+    //
+    // Targets without traffic park their periodic work.
+    // 
+    VIGEM_BUS_FEATURE_IDLE_PARKING = 0x0100
+
+} VIGEM_BUS_FEATURE, *PVIGEM_BUS_FEATURE;
+
+//
+// Functionality and limits reported by the bus driver.
+// 
+// Fields get appended over time; Size tells how many bytes the driver
+// filled in, anything beyond is not reported by it.
+// 
+typedef struct _VIGEM_BUS_CAPABILITIES
+{
+    //
+    // Bytes of this structure reported by the driver.
+    // 
+    ULONG Size;
+
+    //
+    // Common version the driver was built with.
+    // 
+    ULONG Version;
+
+    //
+    // Combination of VIGEM_BUS_FEATURE flags.
+    // 
+    ULONG Features;
+
+    //
+    // Highest serial number the bus assigns.
+    // 
+    ULONG MaxTargets;
+
+    //
+    // Most idle targets the bus keeps pre-created per type.
+    // 
+    ULONG MaxPoolDepth;
+
+    //
+    // Byte capacity bounds of report logs.
+    // 
+    ULONG RecordingMinCapacity;
+    ULONG RecordingMaxCapacity;
+
+    //
+    // Byte capacity bounds of raw output rings.
+    // 
+    ULONG RawOutputMinCapacity;
+    ULONG RawOutputMaxCapacity;
+
+    //
+    // Record capacity bounds of the event trace.
+    // 
+    ULONG EventTraceMinCapacity;
+    ULONG EventTraceMaxCapacity;
+
+    //
+    // Milliseconds between reports repeated to polling DualShock 4 hosts.
+    // 
+    ULONG Ds4TickInterval;
+
+    //
+    // Milliseconds without traffic before a target parks, 0 if disabled.
+    // 
+    ULONG IdleTimeout;
+
+} VIGEM_BUS_CAPABILITIES, *PVIGEM_BUS_CAPABILITIES;
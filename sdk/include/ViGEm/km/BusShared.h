@@ -63,6 +63,24 @@ DEFINE_GUID(GUID_DEVINTERFACE_BUSENUM_VIGEM,
 #define IOCTL_VIGEM_UNPLUG_TARGET       BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x001)
 #define IOCTL_VIGEM_CHECK_VERSION       BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x002)
 #define IOCTL_VIGEM_WAIT_DEVICE_READY   BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x003)
+#define IOCTL_VIGEM_SET_AXIS_TRANSFORM  BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x004)
+#define IOCTL_VIGEM_SET_AGGREGATION     BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x005)
+#define IOCTL_VIGEM_ATTACH_SOURCE       BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x006)
+#define IOCTL_VIGEM_SET_RECORDING       BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x007)
+#define IOCTL_VIGEM_DRAIN_RECORDING     BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x008)
+#define IOCTL_VIGEM_SET_MACRO           BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x009)
+#define IOCTL_VIGEM_SET_SESSION_QOS     BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x00A)
+#define IOCTL_VIGEM_GET_STATISTICS      BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x00B)
+#define IOCTL_VIGEM_SET_EVENT_TRACE     BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x00C)
+#define IOCTL_VIGEM_DRAIN_EVENTS        BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x00D)
+#define IOCTL_VIGEM_GET_FOOTPRINT       BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x00E)
+#define IOCTL_VIGEM_PLUGIN_TARGET_EX    BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x00F)
+#define IOCTL_VIGEM_SET_TARGET_POOL     BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x010)
+#define IOCTL_VIGEM_GET_POLL_PHASE      BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x011)
+#define IOCTL_VIGEM_GET_PLUGIN_TIMELINE BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x012)
+#define IOCTL_VIGEM_SET_RAW_OUTPUT      BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x013)
+#define IOCTL_VIGEM_DRAIN_RAW_OUTPUT    BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x014)
+#define IOCTL_VIGEM_GET_CAPABILITIES    BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x015)
 
 #define IOCTL_XUSB_REQUEST_NOTIFICATION BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x200)
 #define IOCTL_XUSB_SUBMIT_REPORT        BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x201)
@@ -71,6 +89,7 @@ DEFINE_GUID(GUID_DEVINTERFACE_BUSENUM_VIGEM,
 //#define IOCTL_XGIP_SUBMIT_REPORT        BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x204)
 //#define IOCTL_XGIP_SUBMIT_INTERRUPT     BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x205)
 #define IOCTL_XUSB_GET_USER_INDEX       BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x206)
+#define IOCTL_XUSB_WAIT_USER_INDEX      BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x207)
 
 
 //
@@ -82,6 +101,10 @@ DEFINE_GUID(GUID_DEVINTERFACE_BUSENUM_VIGEM,
 //
 // Data structure used in IOCTL_VIGEM_PLUGIN_TARGET requests.
 // 
+// IOCTL_VIGEM_PLUGIN_TARGET_EX requests ignore SerialNo on input and
+// return the serial the bus assigned in it. They claim an idle pooled
+// target if one of the type exists, see IOCTL_VIGEM_SET_TARGET_POOL.
+// 
 typedef struct _VIGEM_PLUGIN_TARGET
 {
     //
@@ -92,7 +115,7 @@ typedef struct _VIGEM_PLUGIN_TARGET
     //
     // Serial number of target device.
     // 
-    IN ULONG SerialNo;
+    IN OUT ULONG SerialNo;
 
     // 
     // Type of the target device to emulate.
@@ -210,121 +233,945 @@ VOID FORCEINLINE VIGEM_WAIT_DEVICE_READY_INIT(
 
 #pragma endregion 
 
-#pragma region XUSB (aka Xbox 360 device) section
+#pragma region Axis transform
 
 //
-// Data structure used in IOCTL_XUSB_REQUEST_NOTIFICATION requests.
+// Data structure used in IOCTL_VIGEM_SET_AXIS_TRANSFORM requests.
 // 
-typedef struct _XUSB_REQUEST_NOTIFICATION
+typedef struct _VIGEM_SET_AXIS_TRANSFORM
 {
     //
-    // sizeof(struct _XUSB_REQUEST_NOTIFICATION)
+    // sizeof(struct _VIGEM_SET_AXIS_TRANSFORM)
     // 
-    ULONG Size;
+    IN ULONG Size;
 
     //
     // Serial number of target device.
     // 
-    ULONG SerialNo;
+    IN ULONG SerialNo;
 
     //
-    // Vibration intensity value of the large motor (0-255).
+    // If FALSE, an active transform gets removed and Axes is ignored.
     // 
-    UCHAR LargeMotor;
+    IN BOOLEAN Enable;
 
     //
-    // Vibration intensity value of the small motor (0-255).
+    // Profile of each output axis, indexed by VIGEM_AXIS.
     // 
-    UCHAR SmallMotor;
+    IN VIGEM_AXIS_PROFILE Axes[VIGEM_AXIS_COUNT];
+
+} VIGEM_SET_AXIS_TRANSFORM, *PVIGEM_SET_AXIS_TRANSFORM;
+
+//
+// Initializes a VIGEM_SET_AXIS_TRANSFORM structure with pass-through profiles.
+// 
+VOID FORCEINLINE VIGEM_SET_AXIS_TRANSFORM_INIT(
+    _Out_ PVIGEM_SET_AXIS_TRANSFORM Transform,
+    _In_ ULONG SerialNo
+)
+{
+    int i;
+
+    RtlZeroMemory(Transform, sizeof(VIGEM_SET_AXIS_TRANSFORM));
+
+    Transform->Size = sizeof(VIGEM_SET_AXIS_TRANSFORM);
+    Transform->SerialNo = SerialNo;
+
+    for (i = 0; i < VIGEM_AXIS_COUNT; i++)
+    {
+        VIGEM_AXIS_PROFILE_INIT(&Transform->Axes[i], (VIGEM_AXIS)i);
+    }
+}
+
+#pragma endregion
+
+#pragma region Aggregation
 
+//
+// Data structure used in IOCTL_VIGEM_SET_AGGREGATION requests.
+// 
+typedef struct _VIGEM_SET_AGGREGATION
+{
     //
-    // Index number of the slot/LED that XUSB.sys has assigned.
+    // sizeof(struct _VIGEM_SET_AGGREGATION)
     // 
-    UCHAR LedNumber;
+    IN ULONG Size;
 
-} XUSB_REQUEST_NOTIFICATION, *PXUSB_REQUEST_NOTIFICATION;
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // If TRUE, the target accepts reports from attached sessions.
+    // 
+    IN BOOLEAN Enable;
+
+    //
+    // Priority of the owner's reports (higher wins).
+    // 
+    IN UCHAR Priority;
+
+    //
+    // How axis values of the sources get merged.
+    // 
+    IN VIGEM_AGGREGATION_AXIS_MODE AxisMode;
+
+} VIGEM_SET_AGGREGATION, *PVIGEM_SET_AGGREGATION;
 
 //
-// Initializes a XUSB_REQUEST_NOTIFICATION structure.
+// Initializes a VIGEM_SET_AGGREGATION structure.
 // 
-VOID FORCEINLINE XUSB_REQUEST_NOTIFICATION_INIT(
-    _Out_ PXUSB_REQUEST_NOTIFICATION Request,
-          _In_ ULONG SerialNo
+VOID FORCEINLINE VIGEM_SET_AGGREGATION_INIT(
+    _Out_ PVIGEM_SET_AGGREGATION Aggregation,
+    _In_ ULONG SerialNo
 )
 {
-    RtlZeroMemory(Request, sizeof(XUSB_REQUEST_NOTIFICATION));
+    RtlZeroMemory(Aggregation, sizeof(VIGEM_SET_AGGREGATION));
 
-    Request->Size = sizeof(XUSB_REQUEST_NOTIFICATION);
-    Request->SerialNo = SerialNo;
+    Aggregation->Size = sizeof(VIGEM_SET_AGGREGATION);
+    Aggregation->SerialNo = SerialNo;
 }
 
 //
-// Data structure used in IOCTL_XUSB_SUBMIT_REPORT requests.
+// Data structure used in IOCTL_VIGEM_ATTACH_SOURCE requests.
 // 
-typedef struct _XUSB_SUBMIT_REPORT
+typedef struct _VIGEM_ATTACH_SOURCE
 {
     //
-    // sizeof(struct _XUSB_SUBMIT_REPORT)
+    // sizeof(struct _VIGEM_ATTACH_SOURCE)
     // 
-    ULONG Size;
+    IN ULONG Size;
 
     //
     // Serial number of target device.
     // 
-    ULONG SerialNo;
+    IN ULONG SerialNo;
 
     //
-    // Report to submit to the target device.
+    // Expected type of the target device.
     // 
-    XUSB_REPORT Report;
+    IN VIGEM_TARGET_TYPE TargetType;
 
-} XUSB_SUBMIT_REPORT, *PXUSB_SUBMIT_REPORT;
+    //
+    // TRUE to attach the calling session, FALSE to detach it.
+    // 
+    IN BOOLEAN Attach;
+
+    //
+    // Priority of this session's reports (higher wins).
+    // 
+    IN UCHAR Priority;
+
+} VIGEM_ATTACH_SOURCE, *PVIGEM_ATTACH_SOURCE;
 
 //
-// Initializes an XUSB report.
+// Initializes a VIGEM_ATTACH_SOURCE structure.
 // 
-VOID FORCEINLINE XUSB_SUBMIT_REPORT_INIT(
-    _Out_ PXUSB_SUBMIT_REPORT Report,
+VOID FORCEINLINE VIGEM_ATTACH_SOURCE_INIT(
+    _Out_ PVIGEM_ATTACH_SOURCE Attach,
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType
+)
+{
+    RtlZeroMemory(Attach, sizeof(VIGEM_ATTACH_SOURCE));
+
+    Attach->Size = sizeof(VIGEM_ATTACH_SOURCE);
+    Attach->SerialNo = SerialNo;
+    Attach->TargetType = TargetType;
+}
+
+#pragma endregion
+
+#pragma region Recording
+
+//
+// Bounds of the log ring size in bytes
+// 
+#define VIGEM_RECORDING_MIN_CAPACITY        0x1000
+#define VIGEM_RECORDING_DEFAULT_CAPACITY    0x10000
+#define VIGEM_RECORDING_MAX_CAPACITY        0x400000
+
+//
+// Data structure used in IOCTL_VIGEM_SET_RECORDING requests.
+// 
+typedef struct _VIGEM_SET_RECORDING
+{
+    //
+    // sizeof(struct _VIGEM_SET_RECORDING)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // TRUE to (re)start recording, FALSE to stop and discard the log.
+    // 
+    IN BOOLEAN Enable;
+
+    //
+    // Size of the log ring in bytes, 0 for VIGEM_RECORDING_DEFAULT_CAPACITY.
+    // 
+    IN ULONG Capacity;
+
+} VIGEM_SET_RECORDING, *PVIGEM_SET_RECORDING;
+
+//
+// Initializes a VIGEM_SET_RECORDING structure.
+// 
+VOID FORCEINLINE VIGEM_SET_RECORDING_INIT(
+    _Out_ PVIGEM_SET_RECORDING Recording,
     _In_ ULONG SerialNo
 )
 {
-    RtlZeroMemory(Report, sizeof(XUSB_SUBMIT_REPORT));
+    RtlZeroMemory(Recording, sizeof(VIGEM_SET_RECORDING));
 
-    Report->Size = sizeof(XUSB_SUBMIT_REPORT);
-    Report->SerialNo = SerialNo;
+    Recording->Size = sizeof(VIGEM_SET_RECORDING);
+    Recording->SerialNo = SerialNo;
 }
 
-typedef struct _XUSB_GET_USER_INDEX
+//
+// Data structure used in IOCTL_VIGEM_DRAIN_RECORDING requests. The output
+// buffer receives this structure followed by up to (output buffer length -
+// sizeof(VIGEM_DRAIN_RECORDING)) bytes of log (see ReportLog.h).
+// 
+typedef struct _VIGEM_DRAIN_RECORDING
 {
     //
-    // sizeof(struct _XUSB_GET_USER_INDEX)
+    // sizeof(struct _VIGEM_DRAIN_RECORDING)
     // 
-    ULONG Size;
+    IN ULONG Size;
 
     //
     // Serial number of target device.
     // 
-    ULONG SerialNo;
+    IN ULONG SerialNo;
 
     //
-    // User index of target device.
+    // Records dropped so far because the ring was full.
     // 
-    OUT ULONG UserIndex;
+    OUT ULONG Dropped;
 
-} XUSB_GET_USER_INDEX, *PXUSB_GET_USER_INDEX;
+    //
+    // Number of log bytes following this structure.
+    // 
+    OUT ULONG Length;
+
+} VIGEM_DRAIN_RECORDING, *PVIGEM_DRAIN_RECORDING;
 
 //
-// Initializes XUSB_GET_USER_INDEX structure.
+// Initializes a VIGEM_DRAIN_RECORDING structure.
 // 
-VOID FORCEINLINE XUSB_GET_USER_INDEX_INIT(
-    _Out_ PXUSB_GET_USER_INDEX GetRequest,
+VOID FORCEINLINE VIGEM_DRAIN_RECORDING_INIT(
+    _Out_ PVIGEM_DRAIN_RECORDING Drain,
     _In_ ULONG SerialNo
 )
 {
-    RtlZeroMemory(GetRequest, sizeof(XUSB_GET_USER_INDEX));
+    RtlZeroMemory(Drain, sizeof(VIGEM_DRAIN_RECORDING));
 
-    GetRequest->Size = sizeof(XUSB_GET_USER_INDEX);
-    GetRequest->SerialNo = SerialNo;
+    Drain->Size = sizeof(VIGEM_DRAIN_RECORDING);
+    Drain->SerialNo = SerialNo;
+}
+
+#pragma endregion
+
+#pragma region Macros
+
+//
+// Data structure used in IOCTL_VIGEM_SET_MACRO requests.
+// 
+typedef struct _VIGEM_SET_MACRO
+{
+    //
+    // sizeof(struct _VIGEM_SET_MACRO)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // Macro slot (0 - VIGEM_MACRO_MAX_SLOTS - 1) to (re)load or stop.
+    // 
+    IN UCHAR Slot;
+
+    //
+    // TRUE to start the macro in Slot, FALSE to stop it.
+    // 
+    IN BOOLEAN Enable;
+
+    //
+    // Number of times the sequence runs, 0 to repeat until stopped.
+    // 
+    IN USHORT RepeatCount;
+
+    //
+    // Number of valid entries in Steps.
+    // 
+    IN USHORT StepCount;
+
+    //
+    // The sequence.
+    // 
+    IN VIGEM_MACRO_STEP Steps[VIGEM_MACRO_MAX_STEPS];
+
+} VIGEM_SET_MACRO, *PVIGEM_SET_MACRO;
+
+//
+// Initializes a VIGEM_SET_MACRO structure.
+// 
+VOID FORCEINLINE VIGEM_SET_MACRO_INIT(
+    _Out_ PVIGEM_SET_MACRO Macro,
+    _In_ ULONG SerialNo,
+    _In_ UCHAR Slot
+)
+{
+    RtlZeroMemory(Macro, sizeof(VIGEM_SET_MACRO));
+
+    Macro->Size = sizeof(VIGEM_SET_MACRO);
+    Macro->SerialNo = SerialNo;
+    Macro->Slot = Slot;
+}
+
+#pragma endregion
+
+#pragma region Session QoS
+
+//
+// Default limits (reports per second, burst) of the rate limited classes
+// 
+#define VIGEM_QOS_NORMAL_RATE           2000
+#define VIGEM_QOS_NORMAL_BURST          64
+#define VIGEM_QOS_BACKGROUND_RATE       250
+#define VIGEM_QOS_BACKGROUND_BURST      16
+
+//
+// Data structure used in IOCTL_VIGEM_SET_SESSION_QOS requests. Applies to
+// all reports submitted through the handle the request is issued on.
+// 
+typedef struct _VIGEM_SET_SESSION_QOS
+{
+    //
+    // sizeof(struct _VIGEM_SET_SESSION_QOS)
+    // 
+    IN ULONG Size;
+
+    //
+    // Scheduling class of the session.
+    // 
+    IN VIGEM_QOS_CLASS Class;
+
+    //
+    // Sustained reports per second, 0 for the class default.
+    // 
+    IN ULONG ReportsPerSecond;
+
+    //
+    // Reports accepted back to back before limiting, 0 for the class default.
+    // 
+    IN ULONG Burst;
+
+} VIGEM_SET_SESSION_QOS, *PVIGEM_SET_SESSION_QOS;
+
+//
+// Initializes a VIGEM_SET_SESSION_QOS structure.
+// 
+VOID FORCEINLINE VIGEM_SET_SESSION_QOS_INIT(
+    _Out_ PVIGEM_SET_SESSION_QOS Qos,
+    _In_ VIGEM_QOS_CLASS Class
+)
+{
+    RtlZeroMemory(Qos, sizeof(VIGEM_SET_SESSION_QOS));
+
+    Qos->Size = sizeof(VIGEM_SET_SESSION_QOS);
+    Qos->Class = Class;
+}
+
+#pragma endregion
+
+#pragma region Statistics
+
+//
+// Data structure used in IOCTL_VIGEM_GET_STATISTICS requests.
+// 
+typedef struct _VIGEM_GET_STATISTICS
+{
+    //
+    // sizeof(struct _VIGEM_GET_STATISTICS)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // USB request blocks handled since the target got plugged in, indexed
+    // by VIGEM_URB_STATISTIC.
+    // 
+    OUT ULONGLONG UrbCounts[VIGEM_URB_STAT_COUNT];
+
+} VIGEM_GET_STATISTICS, *PVIGEM_GET_STATISTICS;
+
+//
+// Initializes a VIGEM_GET_STATISTICS structure.
+// 
+VOID FORCEINLINE VIGEM_GET_STATISTICS_INIT(
+    _Out_ PVIGEM_GET_STATISTICS Statistics,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Statistics, sizeof(VIGEM_GET_STATISTICS));
+
+    Statistics->Size = sizeof(VIGEM_GET_STATISTICS);
+    Statistics->SerialNo = SerialNo;
+}
+
+#pragma endregion
+
+#pragma region Event trace
+
+//
+// Data structure used in IOCTL_VIGEM_SET_EVENT_TRACE requests.
+// 
+typedef struct _VIGEM_SET_EVENT_TRACE
+{
+    //
+    // sizeof(struct _VIGEM_SET_EVENT_TRACE)
+    // 
+    IN ULONG Size;
+
+    //
+    // TRUE to start recording events, FALSE to stop and discard them.
+    // 
+    IN BOOLEAN Enable;
+
+    //
+    // Records kept per processor, a power of two between
+    // VIGEM_EVENT_TRACE_MIN_CAPACITY and VIGEM_EVENT_TRACE_MAX_CAPACITY.
+    // 
+    IN ULONG Capacity;
+
+} VIGEM_SET_EVENT_TRACE, *PVIGEM_SET_EVENT_TRACE;
+
+//
+// Initializes a VIGEM_SET_EVENT_TRACE structure.
+// 
+VOID FORCEINLINE VIGEM_SET_EVENT_TRACE_INIT(
+    _Out_ PVIGEM_SET_EVENT_TRACE Trace,
+    _In_ BOOLEAN Enable,
+    _In_ ULONG Capacity
+)
+{
+    RtlZeroMemory(Trace, sizeof(VIGEM_SET_EVENT_TRACE));
+
+    Trace->Size = sizeof(VIGEM_SET_EVENT_TRACE);
+    Trace->Enable = Enable;
+    Trace->Capacity = Capacity;
+}
+
+//
+// Data structure used in IOCTL_VIGEM_DRAIN_EVENTS requests. The output
+// buffer receives this header followed by Count VIGEM_EVENT_RECORDs.
+// 
+typedef struct _VIGEM_DRAIN_EVENTS
+{
+    //
+    // sizeof(struct _VIGEM_DRAIN_EVENTS)
+    // 
+    IN ULONG Size;
+
+    //
+    // Number of records following this header.
+    // 
+    OUT ULONG Count;
+
+    //
+    // Records lost to full rings since the trace got enabled.
+    // 
+    OUT ULONGLONG Dropped;
+
+    //
+    // Frequency of the record timestamps in counts per second.
+    // 
+    OUT ULONGLONG Frequency;
+
+} VIGEM_DRAIN_EVENTS, *PVIGEM_DRAIN_EVENTS;
+
+//
+// Initializes a VIGEM_DRAIN_EVENTS structure.
+// 
+VOID FORCEINLINE VIGEM_DRAIN_EVENTS_INIT(
+    _Out_ PVIGEM_DRAIN_EVENTS Drain
+)
+{
+    RtlZeroMemory(Drain, sizeof(VIGEM_DRAIN_EVENTS));
+
+    Drain->Size = sizeof(VIGEM_DRAIN_EVENTS);
+}
+
+#pragma endregion
+
+#pragma region Footprint
+
+//
+// Data structure used in IOCTL_VIGEM_GET_FOOTPRINT requests.
+// 
+typedef struct _VIGEM_GET_FOOTPRINT
+{
+    //
+    // sizeof(struct _VIGEM_GET_FOOTPRINT)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // Memory currently held by the target.
+    // 
+    OUT VIGEM_TARGET_FOOTPRINT Footprint;
+
+} VIGEM_GET_FOOTPRINT, *PVIGEM_GET_FOOTPRINT;
+
+//
+// Initializes a VIGEM_GET_FOOTPRINT structure.
+// 
+VOID FORCEINLINE VIGEM_GET_FOOTPRINT_INIT(
+    _Out_ PVIGEM_GET_FOOTPRINT Footprint,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Footprint, sizeof(VIGEM_GET_FOOTPRINT));
+
+    Footprint->Size = sizeof(VIGEM_GET_FOOTPRINT);
+    Footprint->SerialNo = SerialNo;
+}
+
+#pragma endregion
+
+#pragma region Target pool
+
+//
+// Data structure used in IOCTL_VIGEM_SET_TARGET_POOL requests.
+// 
+typedef struct _VIGEM_SET_TARGET_POOL
+{
+    //
+    // sizeof(struct _VIGEM_SET_TARGET_POOL)
+    // 
+    IN ULONG Size;
+
+    //
+    // Type of the pooled targets.
+    // 
+    IN VIGEM_TARGET_TYPE TargetType;
+
+    //
+    // Idle targets to keep ready for IOCTL_VIGEM_PLUGIN_TARGET_EX, up to
+    // VIGEM_TARGET_POOL_MAX_DEPTH. 0 disables pooling.
+    // 
+    IN ULONG Depth;
+
+} VIGEM_SET_TARGET_POOL, *PVIGEM_SET_TARGET_POOL;
+
+//
+// Initializes a VIGEM_SET_TARGET_POOL structure.
+// 
+VOID FORCEINLINE VIGEM_SET_TARGET_POOL_INIT(
+    _Out_ PVIGEM_SET_TARGET_POOL Pool,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG Depth
+)
+{
+    RtlZeroMemory(Pool, sizeof(VIGEM_SET_TARGET_POOL));
+
+    Pool->Size = sizeof(VIGEM_SET_TARGET_POOL);
+    Pool->TargetType = TargetType;
+    Pool->Depth = Depth;
+}
+
+#pragma endregion
+
+#pragma region Poll phase
+
+//
+// Data structure used in IOCTL_VIGEM_GET_POLL_PHASE requests.
+// 
+typedef struct _VIGEM_GET_POLL_PHASE
+{
+    //
+    // sizeof(struct _VIGEM_GET_POLL_PHASE)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // Estimated timing of the host polling the input pipe.
+    // 
+    OUT VIGEM_POLL_PHASE Phase;
+
+} VIGEM_GET_POLL_PHASE, *PVIGEM_GET_POLL_PHASE;
+
+//
+// Initializes a VIGEM_GET_POLL_PHASE structure.
+// 
+VOID FORCEINLINE VIGEM_GET_POLL_PHASE_INIT(
+    _Out_ PVIGEM_GET_POLL_PHASE Phase,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Phase, sizeof(VIGEM_GET_POLL_PHASE));
+
+    Phase->Size = sizeof(VIGEM_GET_POLL_PHASE);
+    Phase->SerialNo = SerialNo;
+}
+
+#pragma endregion
+
+#pragma region Plug-in timeline
+
+//
+// Data structure used in IOCTL_VIGEM_GET_PLUGIN_TIMELINE requests.
+// 
+typedef struct _VIGEM_GET_PLUGIN_TIMELINE
+{
+    //
+    // sizeof(struct _VIGEM_GET_PLUGIN_TIMELINE)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // Time each plug-in phase was reached at.
+    // 
+    OUT VIGEM_PLUGIN_TIMELINE Timeline;
+
+} VIGEM_GET_PLUGIN_TIMELINE, *PVIGEM_GET_PLUGIN_TIMELINE;
+
+//
+// Initializes a VIGEM_GET_PLUGIN_TIMELINE structure.
+// 
+VOID FORCEINLINE VIGEM_GET_PLUGIN_TIMELINE_INIT(
+    _Out_ PVIGEM_GET_PLUGIN_TIMELINE Timeline,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Timeline, sizeof(VIGEM_GET_PLUGIN_TIMELINE));
+
+    Timeline->Size = sizeof(VIGEM_GET_PLUGIN_TIMELINE);
+    Timeline->SerialNo = SerialNo;
+}
+
+#pragma endregion
+
+#pragma region Raw output
+
+//
+// Data structure used in IOCTL_VIGEM_SET_RAW_OUTPUT requests.
+// 
+typedef struct _VIGEM_SET_RAW_OUTPUT
+{
+    //
+    // sizeof(struct _VIGEM_SET_RAW_OUTPUT)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // TRUE to (re)start passing output transfers through, FALSE to stop and
+    // discard undrained ones.
+    // 
+    IN BOOLEAN Enable;
+
+    //
+    // Size of the ring in bytes, 0 for VIGEM_RAW_OUTPUT_DEFAULT_CAPACITY.
+    // 
+    IN ULONG Capacity;
+
+} VIGEM_SET_RAW_OUTPUT, *PVIGEM_SET_RAW_OUTPUT;
+
+//
+// Initializes a VIGEM_SET_RAW_OUTPUT structure.
+// 
+VOID FORCEINLINE VIGEM_SET_RAW_OUTPUT_INIT(
+    _Out_ PVIGEM_SET_RAW_OUTPUT RawOutput,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(RawOutput, sizeof(VIGEM_SET_RAW_OUTPUT));
+
+    RawOutput->Size = sizeof(VIGEM_SET_RAW_OUTPUT);
+    RawOutput->SerialNo = SerialNo;
+}
+
+//
+// Data structure used in IOCTL_VIGEM_DRAIN_RAW_OUTPUT requests. The output
+// buffer receives this structure followed by as many whole records (see
+// RawOutput.h) as fit.
+// 
+typedef struct _VIGEM_DRAIN_RAW_OUTPUT
+{
+    //
+    // sizeof(struct _VIGEM_DRAIN_RAW_OUTPUT)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    //
+    // Transfers dropped so far because the ring was full.
+    // 
+    OUT ULONG Dropped;
+
+    //
+    // Number of record bytes following this structure.
+    // 
+    OUT ULONG Length;
+
+} VIGEM_DRAIN_RAW_OUTPUT, *PVIGEM_DRAIN_RAW_OUTPUT;
+
+//
+// Initializes a VIGEM_DRAIN_RAW_OUTPUT structure.
+// 
+VOID FORCEINLINE VIGEM_DRAIN_RAW_OUTPUT_INIT(
+    _Out_ PVIGEM_DRAIN_RAW_OUTPUT Drain,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Drain, sizeof(VIGEM_DRAIN_RAW_OUTPUT));
+
+    Drain->Size = sizeof(VIGEM_DRAIN_RAW_OUTPUT);
+    Drain->SerialNo = SerialNo;
+}
+
+#pragma endregion
+
+#pragma region Capabilities
+
+//
+// Data structure used in IOCTL_VIGEM_GET_CAPABILITIES requests.
+// 
+// Size may be smaller than this structure when sent by older clients, the
+// driver fills in as much of Capabilities as fits and reports the amount
+// in Capabilities.Size.
+// 
+typedef struct _VIGEM_GET_CAPABILITIES
+{
+    //
+    // sizeof(struct _VIGEM_GET_CAPABILITIES) of the caller
+    // 
+    ULONG Size;
+
+    //
+    // Functionality and limits of the bus
+    // 
+    OUT VIGEM_BUS_CAPABILITIES Capabilities;
+
+} VIGEM_GET_CAPABILITIES, *PVIGEM_GET_CAPABILITIES;
+
+//
+// Smallest request the driver answers, covers Size, Version and Features
+// 
+#define VIGEM_GET_CAPABILITIES_MIN_SIZE \
+    (FIELD_OFFSET(VIGEM_GET_CAPABILITIES, Capabilities) + FIELD_OFFSET(VIGEM_BUS_CAPABILITIES, MaxTargets))
+
+//
+// Initializes a VIGEM_GET_CAPABILITIES structure.
+// 
+VOID FORCEINLINE VIGEM_GET_CAPABILITIES_INIT(
+    _Out_ PVIGEM_GET_CAPABILITIES Get
+)
+{
+    RtlZeroMemory(Get, sizeof(VIGEM_GET_CAPABILITIES));
+
+    Get->Size = sizeof(VIGEM_GET_CAPABILITIES);
+}
+
+#pragma endregion
+
+#pragma region XUSB (aka Xbox 360 device) section
+
+//
+// Data structure used in IOCTL_XUSB_REQUEST_NOTIFICATION requests.
+// 
+typedef struct _XUSB_REQUEST_NOTIFICATION
+{
+    //
+    // sizeof(struct _XUSB_REQUEST_NOTIFICATION)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // Vibration intensity value of the large motor (0-255).
+    // 
+    UCHAR LargeMotor;
+
+    //
+    // Vibration intensity value of the small motor (0-255).
+    // 
+    UCHAR SmallMotor;
+
+    //
+    // Index number of the slot/LED that XUSB.sys has assigned.
+    // 
+    UCHAR LedNumber;
+
+} XUSB_REQUEST_NOTIFICATION, *PXUSB_REQUEST_NOTIFICATION;
+
+//
+// Initializes a XUSB_REQUEST_NOTIFICATION structure.
+// 
+VOID FORCEINLINE XUSB_REQUEST_NOTIFICATION_INIT(
+    _Out_ PXUSB_REQUEST_NOTIFICATION Request,
+          _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Request, sizeof(XUSB_REQUEST_NOTIFICATION));
+
+    Request->Size = sizeof(XUSB_REQUEST_NOTIFICATION);
+    Request->SerialNo = SerialNo;
+}
+
+//
+// Data structure used in IOCTL_XUSB_SUBMIT_REPORT requests.
+// 
+typedef struct _XUSB_SUBMIT_REPORT
+{
+    //
+    // sizeof(struct _XUSB_SUBMIT_REPORT)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // Report to submit to the target device.
+    // 
+    XUSB_REPORT Report;
+
+} XUSB_SUBMIT_REPORT, *PXUSB_SUBMIT_REPORT;
+
+//
+// Initializes an XUSB report.
+// 
+VOID FORCEINLINE XUSB_SUBMIT_REPORT_INIT(
+    _Out_ PXUSB_SUBMIT_REPORT Report,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Report, sizeof(XUSB_SUBMIT_REPORT));
+
+    Report->Size = sizeof(XUSB_SUBMIT_REPORT);
+    Report->SerialNo = SerialNo;
+}
+
+typedef struct _XUSB_GET_USER_INDEX
+{
+    //
+    // sizeof(struct _XUSB_GET_USER_INDEX)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // User index of target device.
+    // 
+    OUT ULONG UserIndex;
+
+} XUSB_GET_USER_INDEX, *PXUSB_GET_USER_INDEX;
+
+//
+// Initializes XUSB_GET_USER_INDEX structure.
+// 
+VOID FORCEINLINE XUSB_GET_USER_INDEX_INIT(
+    _Out_ PXUSB_GET_USER_INDEX GetRequest,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(GetRequest, sizeof(XUSB_GET_USER_INDEX));
+
+    GetRequest->Size = sizeof(XUSB_GET_USER_INDEX);
+    GetRequest->SerialNo = SerialNo;
+}
+
+//
+// Data structure used in IOCTL_XUSB_WAIT_USER_INDEX requests.
+// 
+typedef struct _XUSB_WAIT_USER_INDEX
+{
+    //
+    // sizeof(struct _XUSB_WAIT_USER_INDEX)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // User index last seen by the caller, -1 if none. The request stays
+    // pending until the user index of the target device differs from it.
+    // 
+    IN LONG KnownUserIndex;
+
+    //
+    // User index of target device.
+    // 
+    OUT ULONG UserIndex;
+
+} XUSB_WAIT_USER_INDEX, *PXUSB_WAIT_USER_INDEX;
+
+//
+// Initializes XUSB_WAIT_USER_INDEX structure.
+// 
+VOID FORCEINLINE XUSB_WAIT_USER_INDEX_INIT(
+    _Out_ PXUSB_WAIT_USER_INDEX WaitRequest,
+    _In_ ULONG SerialNo,
+    _In_ LONG KnownUserIndex
+)
+{
+    RtlZeroMemory(WaitRequest, sizeof(XUSB_WAIT_USER_INDEX));
+
+    WaitRequest->Size = sizeof(XUSB_WAIT_USER_INDEX);
+    WaitRequest->SerialNo = SerialNo;
+    WaitRequest->KnownUserIndex = KnownUserIndex;
 }
 
 #pragma endregion
@@ -0,0 +1,220 @@
+/*
+MIT License
+
+Copyright (c) 2017-2019 Nefarius Software Solutions e.U. and Contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "ViGEm/Common.h"
+
+//
+// Binary event trace of the bus hot paths.
+// 
+// Unlike WPP tracing, recording an event does no formatting: the bus
+// copies a fixed-size VIGEM_EVENT_RECORD into a ring of the current
+// processor. Records are drained with IOCTL_VIGEM_DRAIN_EVENTS and decoded
+// offline. Each ring is ordered by time; rings of different processors
+// get merged by Timestamp.
+// 
+
+//
+// Per processor ring capacity in records, must be a power of two
+// 
+#define VIGEM_EVENT_TRACE_MIN_CAPACITY      0x100
+#define VIGEM_EVENT_TRACE_DEFAULT_CAPACITY  0x1000
+#define VIGEM_EVENT_TRACE_MAX_CAPACITY      0x10000
+
+//
+// Events and the meaning of their payload
+// 
+typedef enum _VIGEM_EVENT_ID
+{
+    //
+    // Report passed to the target.
+    // Payload: session ID, report size, status
+    // 
+    VIGEM_EVENT_REPORT_SUBMITTED = 1,
+
+    //
+    // Report held back by the session rate limit.
+    // Payload: session ID
+    // 
+    VIGEM_EVENT_REPORT_COALESCED = 2,
+
+    //
+    // Macro overlay applied on a timer tick.
+    // Payload: buttons set, buttons cleared, axis mask
+    // 
+    VIGEM_EVENT_MACRO_OVERLAY = 3,
+
+    //
+    // Interrupt transfer entered the fast path.
+    // Payload: transfer flags, buffer length, status
+    // 
+    VIGEM_EVENT_URB_INTERRUPT = 4,
+
+    //
+    // Other URB function handled.
+    // Payload: function, status
+    // 
+    VIGEM_EVENT_URB_OTHER = 5,
+
+    //
+    // Interrupt OUT data (rumble, LED, lightbar) queued for the feeder.
+    // Payload: buffer length
+    // 
+    VIGEM_EVENT_NOTIFICATION_QUEUED = 6,
+
+    //
+    // Notification request of the feeder completed.
+    // Payload: large motor, small motor, LED number (XUSB) or lightbar
+    // color as VIGEM_EVENT_RGB (DS4)
+    // 
+    VIGEM_EVENT_NOTIFICATION_COMPLETED = 7,
+
+    //
+    // Host assigned another LED (player slot) to an XUSB target.
+    // Payload: previous and new LED number, -1 while unassigned
+    // 
+    VIGEM_EVENT_LED_CHANGED = 8,
+
+    VIGEM_EVENT_ID_COUNT
+
+} VIGEM_EVENT_ID, *PVIGEM_EVENT_ID;
+
+typedef struct _VIGEM_EVENT_RECORD
+{
+    //
+    // Performance counter value at the time of the event
+    // 
+    ULONGLONG Timestamp;
+
+    //
+    // A VIGEM_EVENT_ID
+    // 
+    USHORT EventId;
+
+    //
+    // Processor the event got recorded on
+    // 
+    USHORT Processor;
+
+    //
+    // Serial number of the target, 0 for bus-wide events
+    // 
+    ULONG SerialNo;
+
+    //
+    // Event specific, see VIGEM_EVENT_ID
+    // 
+    ULONG Payload[4];
+
+} VIGEM_EVENT_RECORD, *PVIGEM_EVENT_RECORD;
+
+//
+// Packs a DS4 lightbar color into a payload value, 0x00RRGGBB
+// 
+#define VIGEM_EVENT_RGB(_Color_) \
+    (((ULONG)(_Color_).Red << 16) | ((ULONG)(_Color_).Green << 8) | (ULONG)(_Color_).Blue)
+
+//
+// Drained records saved for offline decoding. The file is a
+// VIGEM_EVENT_LOG_HEADER followed by the records in the order they were
+// drained.
+// 
+
+#define VIGEM_EVENT_LOG_MAGIC       0x54454756 // "VGET"
+#define VIGEM_EVENT_LOG_VERSION     0x0001
+
+typedef struct _VIGEM_EVENT_LOG_HEADER
+{
+    //
+    // VIGEM_EVENT_LOG_MAGIC
+    // 
+    ULONG Magic;
+
+    //
+    // VIGEM_EVENT_LOG_VERSION
+    // 
+    USHORT Version;
+
+    //
+    // sizeof(VIGEM_EVENT_RECORD) of the writer
+    // 
+    USHORT RecordSize;
+
+    //
+    // Performance counter frequency the timestamps are based on
+    // 
+    ULONGLONG Frequency;
+
+    //
+    // Events the bus dropped while the log was captured
+    // 
+    ULONGLONG Dropped;
+
+} VIGEM_EVENT_LOG_HEADER, *PVIGEM_EVENT_LOG_HEADER;
+
+VOID FORCEINLINE VIGEM_EVENT_LOG_HEADER_INIT(
+    _Out_ PVIGEM_EVENT_LOG_HEADER Header,
+    _In_ ULONGLONG Frequency
+)
+{
+    RtlZeroMemory(Header, sizeof(VIGEM_EVENT_LOG_HEADER));
+
+    Header->Magic = VIGEM_EVENT_LOG_MAGIC;
+    Header->Version = VIGEM_EVENT_LOG_VERSION;
+    Header->RecordSize = sizeof(VIGEM_EVENT_RECORD);
+    Header->Frequency = Frequency;
+}
+
+//
+// Returns a printable name of an event ID.
+// 
+PCSTR FORCEINLINE VIGEM_EVENT_NAME(
+    _In_ USHORT EventId
+)
+{
+    switch (EventId)
+    {
+    case VIGEM_EVENT_REPORT_SUBMITTED:
+        return "ReportSubmitted";
+    case VIGEM_EVENT_REPORT_COALESCED:
+        return "ReportCoalesced";
+    case VIGEM_EVENT_MACRO_OVERLAY:
+        return "MacroOverlay";
+    case VIGEM_EVENT_URB_INTERRUPT:
+        return "UrbInterrupt";
+    case VIGEM_EVENT_URB_OTHER:
+        return "UrbOther";
+    case VIGEM_EVENT_NOTIFICATION_QUEUED:
+        return "NotificationQueued";
+    case VIGEM_EVENT_NOTIFICATION_COMPLETED:
+        return "NotificationCompleted";
+    case VIGEM_EVENT_LED_CHANGED:
+        return "LedChanged";
+    default:
+        return "Unknown";
+    }
+}
@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2017-2019 Nefarius Software Solutions e.U. and Contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "ViGEm/Common.h"
+
+//
+// Raw interrupt OUT transfers the host sent to a target.
+// 
+// While enabled, every output transfer is copied unmodified into a ring of
+// length-prefixed records:
+// 
+//   VIGEM_RAW_OUTPUT_RECORD   header
+//   UCHAR[Length]             transfer data
+//   UCHAR[]                   zero padding to VIGEM_RAW_OUTPUT_ALIGNMENT
+// 
+// Records are drained whole with IOCTL_VIGEM_DRAIN_RAW_OUTPUT and walked
+// with VIGEM_RAW_OUTPUT_NEXT. A gap in Sequence tells how many transfers
+// got dropped because the ring was full.
+// 
+
+//
+// Bounds of the ring size in bytes
+// 
+#define VIGEM_RAW_OUTPUT_MIN_CAPACITY       0x1000
+#define VIGEM_RAW_OUTPUT_DEFAULT_CAPACITY   0x10000
+#define VIGEM_RAW_OUTPUT_MAX_CAPACITY       0x400000
+
+//
+// Longer transfers get truncated, see TransferLength
+// 
+#define VIGEM_RAW_OUTPUT_MAX_PAYLOAD        0x40
+
+#define VIGEM_RAW_OUTPUT_ALIGNMENT          8
+
+typedef struct _VIGEM_RAW_OUTPUT_RECORD
+{
+    //
+    // Bytes of transfer data following this header
+    // 
+    USHORT Length;
+
+    //
+    // Length of the transfer, larger than Length if truncated
+    // 
+    USHORT TransferLength;
+
+    //
+    // Number of the transfer since the channel got enabled
+    // 
+    ULONG Sequence;
+
+    //
+    // Interrupt time (100ns units) the transfer arrived at
+    // 
+    ULONGLONG Time;
+
+} VIGEM_RAW_OUTPUT_RECORD, *PVIGEM_RAW_OUTPUT_RECORD;
+
+typedef const VIGEM_RAW_OUTPUT_RECORD* PCVIGEM_RAW_OUTPUT_RECORD;
+
+//
+// Upper bound of an encoded record
+// 
+#define VIGEM_RAW_OUTPUT_MAX_RECORD         (sizeof(VIGEM_RAW_OUTPUT_RECORD) + VIGEM_RAW_OUTPUT_MAX_PAYLOAD)
+
+//
+// Returns the size of a record carrying Length bytes, padding included.
+// 
+ULONG FORCEINLINE VIGEM_RAW_OUTPUT_RECORD_SIZE(
+    _In_ ULONG Length
+)
+{
+    return (ULONG)((sizeof(VIGEM_RAW_OUTPUT_RECORD) + Length + VIGEM_RAW_OUTPUT_ALIGNMENT - 1)
+        & ~(ULONG)(VIGEM_RAW_OUTPUT_ALIGNMENT - 1));
+}
+
+//
+// Transfer data of a record
+// 
+#define VIGEM_RAW_OUTPUT_DATA(Record)       ((const UCHAR*)((Record) + 1))
+
+//
+// Returns the record at *Offset of a drained buffer and advances *Offset
+// past it, or NULL at the end of the buffer or on a malformed record.
+// 
+PCVIGEM_RAW_OUTPUT_RECORD FORCEINLINE VIGEM_RAW_OUTPUT_NEXT(
+    _In_reads_bytes_(Length) const VOID* Buffer,
+    _In_ ULONG Length,
+    _Inout_ PULONG Offset
+)
+{
+    PCVIGEM_RAW_OUTPUT_RECORD record;
+    ULONG size;
+
+    if (*Offset > Length || Length - *Offset < sizeof(VIGEM_RAW_OUTPUT_RECORD))
+        return NULL;
+
+    record = (PCVIGEM_RAW_OUTPUT_RECORD)((const UCHAR*)Buffer + *Offset);
+
+    if (record->Length > VIGEM_RAW_OUTPUT_MAX_PAYLOAD)
+        return NULL;
+
+    size = VIGEM_RAW_OUTPUT_RECORD_SIZE(record->Length);
+
+    if (Length - *Offset < size)
+        return NULL;
+
+    *Offset += size;
+
+    return record;
+}
@@ -0,0 +1,393 @@
+/*
+MIT License
+
+Copyright (c) 2017-2019 Nefarius Software Solutions e.U. and Contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "ViGEm/Common.h"
+
+//
+// Compact log of the reports a feeder submitted to a target and of the
+// interrupt OUT data (rumble, LED, lightbar) the host sent back to it.
+// 
+// The log is a VIGEM_REPORT_LOG_HEADER followed by records:
+// 
+//   UCHAR   Flags       record kind (bits 0-1), keyframe flag (bit 2)
+//   varint  TimeDelta   100ns units since the previous record
+//   varint  Length      length of the payload
+//   ...     Payload     keyframe: Length raw bytes
+//                       otherwise: varint run count followed by runs of
+//                       { varint Skip, varint Count, Count bytes } patching
+//                       the previous payload of the same kind
+// 
+// Varints store 7 bits per byte, least significant group first. Records
+// are position independent, so a log can be read straight from a mapped
+// file. Writer and reader share VIGEM_REPORT_LOG_STATE to track deltas.
+// 
+
+#define VIGEM_REPORT_LOG_MAGIC          0x4C524756 // "VGRL"
+#define VIGEM_REPORT_LOG_VERSION        0x0001
+
+//
+// Longer payloads get truncated
+// 
+#define VIGEM_REPORT_LOG_MAX_PAYLOAD    0x40
+
+//
+// Upper bound of an encoded record
+// 
+#define VIGEM_REPORT_LOG_MAX_RECORD     (1 + 10 + 2 + VIGEM_REPORT_LOG_MAX_PAYLOAD)
+
+#define VIGEM_REPORT_LOG_KIND_MASK      0x03
+#define VIGEM_REPORT_LOG_FLAG_KEYFRAME  0x04
+
+typedef enum _VIGEM_REPORT_LOG_KIND
+{
+    //
+    // Report submitted by a feeder
+    // 
+    VIGEM_REPORT_LOG_INPUT = 0,
+
+    //
+    // Interrupt OUT transfer sent by the host
+    // 
+    VIGEM_REPORT_LOG_OUTPUT = 1,
+
+    VIGEM_REPORT_LOG_KIND_COUNT
+
+} VIGEM_REPORT_LOG_KIND, *PVIGEM_REPORT_LOG_KIND;
+
+#include <pshpack1.h>
+
+typedef struct _VIGEM_REPORT_LOG_HEADER
+{
+    //
+    // VIGEM_REPORT_LOG_MAGIC
+    // 
+    ULONG Magic;
+
+    //
+    // VIGEM_REPORT_LOG_VERSION
+    // 
+    USHORT Version;
+
+    //
+    // VIGEM_TARGET_TYPE of the recorded target
+    // 
+    USHORT TargetType;
+
+    //
+    // Serial number of the recorded target
+    // 
+    ULONG SerialNo;
+
+    //
+    // Time (100ns units) the first time delta is relative to
+    // 
+    ULONGLONG StartTime;
+
+} VIGEM_REPORT_LOG_HEADER, *PVIGEM_REPORT_LOG_HEADER;
+
+#include <poppack.h>
+
+//
+// Delta tracking state of a log writer or reader
+// 
+typedef struct _VIGEM_REPORT_LOG_STATE
+{
+    ULONGLONG LastTime;
+
+    ULONG PreviousLength[VIGEM_REPORT_LOG_KIND_COUNT];
+
+    UCHAR Previous[VIGEM_REPORT_LOG_KIND_COUNT][VIGEM_REPORT_LOG_MAX_PAYLOAD];
+
+} VIGEM_REPORT_LOG_STATE, *PVIGEM_REPORT_LOG_STATE;
+
+VOID FORCEINLINE VIGEM_REPORT_LOG_HEADER_INIT(
+    _Out_ PVIGEM_REPORT_LOG_HEADER Header,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG SerialNo,
+    _In_ ULONGLONG StartTime
+)
+{
+    RtlZeroMemory(Header, sizeof(VIGEM_REPORT_LOG_HEADER));
+
+    Header->Magic = VIGEM_REPORT_LOG_MAGIC;
+    Header->Version = VIGEM_REPORT_LOG_VERSION;
+    Header->TargetType = (USHORT)TargetType;
+    Header->SerialNo = SerialNo;
+    Header->StartTime = StartTime;
+}
+
+VOID FORCEINLINE VIGEM_REPORT_LOG_STATE_INIT(
+    _Out_ PVIGEM_REPORT_LOG_STATE State,
+    _In_ ULONGLONG StartTime
+)
+{
+    RtlZeroMemory(State, sizeof(VIGEM_REPORT_LOG_STATE));
+
+    State->LastTime = StartTime;
+}
+
+ULONG FORCEINLINE VIGEM_REPORT_LOG_PUT_VARINT(
+    _Out_ PUCHAR Buffer,
+    _In_ ULONGLONG Value
+)
+{
+    ULONG length = 0;
+
+    while (Value >= 0x80)
+    {
+        Buffer[length++] = (UCHAR)(Value | 0x80);
+        Value >>= 7;
+    }
+
+    Buffer[length++] = (UCHAR)Value;
+
+    return length;
+}
+
+//
+// Returns the number of bytes consumed, 0 if truncated or malformed.
+// 
+ULONG FORCEINLINE VIGEM_REPORT_LOG_GET_VARINT(
+    _In_ const UCHAR* Buffer,
+    _In_ ULONG Length,
+    _Out_ PULONGLONG Value
+)
+{
+    ULONG length = 0;
+    ULONG shift = 0;
+
+    *Value = 0;
+
+    while (length < Length && shift < 64)
+    {
+        const UCHAR current = Buffer[length++];
+
+        *Value |= (ULONGLONG)(current & 0x7F) << shift;
+
+        if (!(current & 0x80))
+            return length;
+
+        shift += 7;
+    }
+
+    return 0;
+}
+
+//
+// Encodes a record into Buffer (VIGEM_REPORT_LOG_MAX_RECORD bytes) and
+// returns its length. The state is left untouched; call
+// VIGEM_REPORT_LOG_COMMIT once the record actually got stored.
+// 
+ULONG FORCEINLINE VIGEM_REPORT_LOG_ENCODE(
+    _In_ const VIGEM_REPORT_LOG_STATE* State,
+    _In_ VIGEM_REPORT_LOG_KIND Kind,
+    _In_ ULONGLONG Time,
+    _In_ const UCHAR* Payload,
+    _In_ ULONG Length,
+    _Out_ PUCHAR Buffer
+)
+{
+    const UCHAR* previous = State->Previous[Kind];
+    UCHAR runs[VIGEM_REPORT_LOG_MAX_PAYLOAD * 2];
+    ULONG runsLength = 0;
+    ULONG runCount = 0;
+    ULONG offset = 0;
+    ULONG length;
+    BOOLEAN keyframe = (State->PreviousLength[Kind] != Length);
+
+    if (Length > VIGEM_REPORT_LOG_MAX_PAYLOAD)
+        Length = VIGEM_REPORT_LOG_MAX_PAYLOAD;
+
+    //
+    // Collect runs of changed bytes, bail out to a keyframe as soon as
+    // the delta gets larger than the payload itself
+    // 
+    while (!keyframe && offset < Length)
+    {
+        ULONG start = offset;
+        ULONG end;
+
+        while (start < Length && Payload[start] == previous[start])
+            start++;
+
+        if (start == Length)
+            break;
+
+        //
+        // Swallow short unchanged gaps, a new run costs two bytes
+        // 
+        end = start + 1;
+
+        while (end < Length
+            && (Payload[end] != previous[end]
+                || (end + 1 < Length && Payload[end + 1] != previous[end + 1])
+                || (end + 2 < Length && Payload[end + 2] != previous[end + 2])))
+            end++;
+
+        if (runsLength + 4 + (end - start) >= Length)
+        {
+            keyframe = TRUE;
+            break;
+        }
+
+        runsLength += VIGEM_REPORT_LOG_PUT_VARINT(&runs[runsLength], start - offset);
+        runsLength += VIGEM_REPORT_LOG_PUT_VARINT(&runs[runsLength], end - start);
+        RtlCopyMemory(&runs[runsLength], &Payload[start], end - start);
+        runsLength += end - start;
+
+        runCount++;
+        offset = end;
+    }
+
+    Buffer[0] = (UCHAR)(Kind & VIGEM_REPORT_LOG_KIND_MASK) | (keyframe ? VIGEM_REPORT_LOG_FLAG_KEYFRAME : 0);
+    length = 1;
+    length += VIGEM_REPORT_LOG_PUT_VARINT(&Buffer[length], (Time > State->LastTime) ? Time - State->LastTime : 0);
+    length += VIGEM_REPORT_LOG_PUT_VARINT(&Buffer[length], Length);
+
+    if (keyframe)
+    {
+        RtlCopyMemory(&Buffer[length], Payload, Length);
+        return length + Length;
+    }
+
+    length += VIGEM_REPORT_LOG_PUT_VARINT(&Buffer[length], runCount);
+    RtlCopyMemory(&Buffer[length], runs, runsLength);
+
+    return length + runsLength;
+}
+
+//
+// Advances the state past a record passed to VIGEM_REPORT_LOG_ENCODE.
+// 
+VOID FORCEINLINE VIGEM_REPORT_LOG_COMMIT(
+    _Inout_ PVIGEM_REPORT_LOG_STATE State,
+    _In_ VIGEM_REPORT_LOG_KIND Kind,
+    _In_ ULONGLONG Time,
+    _In_ const UCHAR* Payload,
+    _In_ ULONG Length
+)
+{
+    if (Length > VIGEM_REPORT_LOG_MAX_PAYLOAD)
+        Length = VIGEM_REPORT_LOG_MAX_PAYLOAD;
+
+    if (Time > State->LastTime)
+        State->LastTime = Time;
+
+    RtlCopyMemory(State->Previous[Kind], Payload, Length);
+    State->PreviousLength[Kind] = Length;
+}
+
+//
+// Decodes the record at Buffer and returns the number of bytes consumed,
+// 0 if the record is incomplete or malformed (the state is left untouched
+// in that case). On success, Payload points to the reconstructed payload
+// which stays valid until the next record of the same kind is decoded.
+// 
+ULONG FORCEINLINE VIGEM_REPORT_LOG_DECODE(
+    _Inout_ PVIGEM_REPORT_LOG_STATE State,
+    _In_ const UCHAR* Buffer,
+    _In_ ULONG Length,
+    _Out_ PVIGEM_REPORT_LOG_KIND Kind,
+    _Out_ PULONGLONG Time,
+    _Out_ const UCHAR** Payload,
+    _Out_ PULONG PayloadLength
+)
+{
+    UCHAR payload[VIGEM_REPORT_LOG_MAX_PAYLOAD];
+    ULONGLONG delta, payloadLength, runCount, skip, count;
+    ULONG offset = 1;
+    ULONG consumed;
+    ULONG position = 0;
+    VIGEM_REPORT_LOG_KIND kind;
+
+    if (Length < 1 || (Buffer[0] & VIGEM_REPORT_LOG_KIND_MASK) >= VIGEM_REPORT_LOG_KIND_COUNT)
+        return 0;
+
+    kind = (VIGEM_REPORT_LOG_KIND)(Buffer[0] & VIGEM_REPORT_LOG_KIND_MASK);
+
+    if (!(consumed = VIGEM_REPORT_LOG_GET_VARINT(&Buffer[offset], Length - offset, &delta)))
+        return 0;
+    offset += consumed;
+
+    if (!(consumed = VIGEM_REPORT_LOG_GET_VARINT(&Buffer[offset], Length - offset, &payloadLength)))
+        return 0;
+    offset += consumed;
+
+    if (payloadLength > VIGEM_REPORT_LOG_MAX_PAYLOAD)
+        return 0;
+
+    if (Buffer[0] & VIGEM_REPORT_LOG_FLAG_KEYFRAME)
+    {
+        if (Length - offset < payloadLength)
+            return 0;
+
+        RtlCopyMemory(payload, &Buffer[offset], (ULONG)payloadLength);
+        offset += (ULONG)payloadLength;
+    }
+    else
+    {
+        if (State->PreviousLength[kind] != payloadLength)
+            return 0;
+
+        RtlCopyMemory(payload, State->Previous[kind], (ULONG)payloadLength);
+
+        if (!(consumed = VIGEM_REPORT_LOG_GET_VARINT(&Buffer[offset], Length - offset, &runCount)))
+            return 0;
+        offset += consumed;
+
+        while (runCount--)
+        {
+            if (!(consumed = VIGEM_REPORT_LOG_GET_VARINT(&Buffer[offset], Length - offset, &skip)))
+                return 0;
+            offset += consumed;
+
+            if (!(consumed = VIGEM_REPORT_LOG_GET_VARINT(&Buffer[offset], Length - offset, &count)))
+                return 0;
+            offset += consumed;
+
+            if (skip + count > payloadLength - position || count > Length - offset)
+                return 0;
+
+            position += (ULONG)skip;
+            RtlCopyMemory(&payload[position], &Buffer[offset], (ULONG)count);
+            position += (ULONG)count;
+            offset += (ULONG)count;
+        }
+    }
+
+    State->LastTime += delta;
+    RtlCopyMemory(State->Previous[kind], payload, (ULONG)payloadLength);
+    State->PreviousLength[kind] = (ULONG)payloadLength;
+
+    *Kind = kind;
+    *Time = State->LastTime;
+    *Payload = State->Previous[kind];
+    *PayloadLength = (ULONG)payloadLength;
+
+    return offset;
+}
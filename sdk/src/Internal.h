@@ -30,25 +30,157 @@ SOFTWARE.
 // 
 #define VIGEM_TARGETS_MAX   USHRT_MAX
 
+//
+// Most bus instances a client connects to
+// 
+#define VIGEM_BUSES_MAX     8
+
 
 //
 // Represents a driver connection object.
 // 
 typedef struct _VIGEM_CLIENT_T
 {
+    //
+    // Primary bus, serves requests not bound to a target
+    // 
     HANDLE hBusDevice;
 
+    //
+    // Every compatible bus found on connect, the primary one first
+    // 
+    HANDLE Buses[VIGEM_BUSES_MAX];
+    ULONG BusCount;
+
+    //
+    // Targets currently plugged into each bus through this client
+    // 
+    volatile LONG BusTargets[VIGEM_BUSES_MAX];
+
+    //
+    // Decides the bus of targets added without one, see VIGEM_BUS_PLACEMENT
+    // 
+    VIGEM_BUS_PLACEMENT Placement;
+
+    //
+    // Round-robin cursor of the placement
+    // 
+    volatile LONG NextBus;
+
+    //
+    // Reported by the bus on connect, Size is 0 if the driver predates
+    // IOCTL_VIGEM_GET_CAPABILITIES
+    // 
+    VIGEM_BUS_CAPABILITIES Capabilities;
+
+    //
+    // Protects BusNotification and BusNotificationUserData. vigem_disconnect
+    // keeps this and all members after it.
+    // 
+    SRWLOCK BusNotificationLock;
+
+    //
+    // Bus arrival and removal notification, kept across vigem_disconnect
+    // 
+    FARPROC BusNotification;
+    LPVOID BusNotificationUserData;
+
+    //
+    // Registration of the bus watch, owned by the bus discovery
+    // 
+    PVOID BusWatch;
+
 } VIGEM_CLIENT;
 
+//
+// Finds, opens and watches bus devices. vigem_connect reaches the system
+// only through this, so the connection logic runs against any source of
+// bus devices.
+// 
+typedef struct _VIGEM_BUS_DISCOVERY
+{
+    //
+    // Appends the interface paths of every present bus device
+    // 
+    VOID (*Enumerate)(std::vector<std::wstring>& Paths);
+
+    //
+    // Opens a bus device and checks it's compatible with this library
+    // 
+    VIGEM_ERROR (*Open)(LPCWSTR Path, PHANDLE Bus);
+
+    //
+    // Reports bus device arrival and removal to vigem_internal_bus_changed
+    // until Unwatch returns. Unwatch waits for reports in progress.
+    // 
+    VIGEM_ERROR (*Watch)(PVIGEM_CLIENT Client);
+    VOID (*Unwatch)(PVIGEM_CLIENT Client);
+
+} VIGEM_BUS_DISCOVERY, *PVIGEM_BUS_DISCOVERY;
+
+//
+// Bus discovery vigem_connect and the bus watch go through
+// 
+extern const VIGEM_BUS_DISCOVERY* vigem_internal_discovery;
+
+//
+// Updates the bus cache and notifies the watching client of a bus change
+// 
+void vigem_internal_bus_changed(PVIGEM_CLIENT Client, VIGEM_BUS_EVENT Event, LPCWSTR Path);
+
+//
+// Bus devices opened last, shared by every client of the process so a
+// reconnect opens them right away instead of enumerating.
+// 
+typedef struct _VIGEM_BUS_CACHE
+{
+    SRWLOCK Lock;
+
+    //
+    // Interface paths of the compatible buses, the primary one first
+    // 
+    std::vector<std::wstring> Paths;
+
+    //
+    // Reported by the primary bus, Size is 0 if not known
+    // 
+    VIGEM_BUS_CAPABILITIES Capabilities;
+
+    //
+    // Clients watching for bus changes. The cached capabilities are only
+    // reused while a removal would have dropped them.
+    // 
+    volatile LONG Watches;
+
+} VIGEM_BUS_CACHE, *PVIGEM_BUS_CACHE;
+
+//
+// Whether a data path may be used on the connected bus. Without reported
+// capabilities every path gets tried and the error handling falls back.
+// 
+FORCEINLINE BOOL VIGEM_BUS_MAY_USE(
+    _In_ PVIGEM_CLIENT Client,
+    _In_ VIGEM_BUS_FEATURE Feature
+)
+{
+    return Client->Capabilities.Size == 0 || (Client->Capabilities.Features & Feature) != 0;
+}
+
 //
 // Represents the (connection) state of a target device object.
 // 
+// CONNECTING and REMOVING are held by the one thread currently adding or
+// removing the target, every other thread sees the target as busy.
+// 
 typedef enum _VIGEM_TARGET_STATE
 {
     VIGEM_TARGET_NEW,
     VIGEM_TARGET_INITIALIZED,
     VIGEM_TARGET_CONNECTED,
-    VIGEM_TARGET_DISCONNECTED
+    VIGEM_TARGET_DISCONNECTED,
+    VIGEM_TARGET_ATTACHED_SOURCE,
+    VIGEM_TARGET_CONNECTING,
+    VIGEM_TARGET_REMOVING
 } VIGEM_TARGET_STATE, *PVIGEM_TARGET_STATE;
 
 
@@ -59,13 +191,83 @@ typedef enum _VIGEM_TARGET_STATE
 typedef struct _VIGEM_TARGET_T
 {
     ULONG Size;
+
+    //
+    // Only written while State is CONNECTING or REMOVING, published by the
+    // state change that follows
+    // 
     ULONG SerialNo;
-    VIGEM_TARGET_STATE State;
+
+    //
+    // Index of the client bus the target is plugged into, same rules as SerialNo
+    // 
+    ULONG BusIndex;
+
+    //
+    // A VIGEM_TARGET_STATE, only changed with interlocked operations
+    // 
+    volatile LONG State;
+
     USHORT VendorId;
     USHORT ProductId;
     VIGEM_TARGET_TYPE Type;
+
+    //
+    // Protects Notification, NotificationUserData, UserIndexNotification,
+    // UserIndexNotificationUserData and cancelNotificationThreadEvent
+    // 
+    SRWLOCK NotificationLock;
+
     FARPROC Notification;
     LPVOID NotificationUserData;
 
+    FARPROC UserIndexNotification;
+    LPVOID UserIndexNotificationUserData;
+
 	HANDLE cancelNotificationThreadEvent;
 } VIGEM_TARGET;
+
+//
+// Handle of the bus the target device is plugged into.
+// 
+FORCEINLINE HANDLE VIGEM_TARGET_BUS(
+    _In_ PVIGEM_CLIENT Client,
+    _In_ PVIGEM_TARGET Target
+)
+{
+    return (Target->BusIndex < Client->BusCount) ? Client->Buses[Target->BusIndex] : Client->hBusDevice;
+}
+
+//
+// Reads the current state of a target device object.
+// 
+FORCEINLINE VIGEM_TARGET_STATE VIGEM_TARGET_GET_STATE(
+    _In_ PVIGEM_TARGET Target
+)
+{
+    return static_cast<VIGEM_TARGET_STATE>(ReadAcquire(&Target->State));
+}
+
+//
+// Moves a target device object from one state to another. Fails if another
+// thread changed the state first.
+// 
+FORCEINLINE BOOL VIGEM_TARGET_TRANSITION(
+    _In_ PVIGEM_TARGET Target,
+    _In_ VIGEM_TARGET_STATE From,
+    _In_ VIGEM_TARGET_STATE To
+)
+{
+    return InterlockedCompareExchange(&Target->State, To, From) == From;
+}
+
+//
+// Sets the state of a target device object owned by the calling thread.
+// 
+FORCEINLINE VOID VIGEM_TARGET_SET_STATE(
+    _In_ PVIGEM_TARGET Target,
+    _In_ VIGEM_TARGET_STATE State
+)
+{
+    InterlockedExchange(&Target->State, State);
+}
@@ -28,6 +28,7 @@ SOFTWARE.
 // 
 #include <Windows.h>
 #include <SetupAPI.h>
+#include <cfgmgr32.h>
 #include <initguid.h>
 #include <Dbghelp.h>
 
@@ -35,6 +36,9 @@ SOFTWARE.
 // Driver shared
 // 
 #include "ViGEm/km/BusShared.h"
+#include "ViGEm/km/ReportLog.h"
+#include "ViGEm/km/EventTrace.h"
+#include "ViGEm/km/RawOutput.h"
 #include "ViGEm/Client.h"
 #include <winioctl.h>
 
@@ -44,6 +48,7 @@ SOFTWARE.
 #include <cstdlib>
 #include <climits>
 #include <vector>
+#include <string>
 #include <algorithm>
 #include <thread>
 #include <functional>
@@ -91,6 +96,9 @@ PVIGEM_TARGET FORCEINLINE VIGEM_TARGET_ALLOC_INIT(
     target->Size = sizeof(VIGEM_TARGET);
     target->State = VIGEM_TARGET_INITIALIZED;
     target->Type = Type;
+
+    InitializeSRWLock(&target->NotificationLock);
+
     return target;
 }
 
@@ -153,31 +161,84 @@ PVIGEM_CLIENT vigem_alloc()
     RtlZeroMemory(driver, sizeof(VIGEM_CLIENT));
     driver->hBusDevice = INVALID_HANDLE_VALUE;
 
+    InitializeSRWLock(&driver->BusNotificationLock);
+
     return driver;
 }
 
 void vigem_free(PVIGEM_CLIENT vigem)
 {
-    if (vigem)
-        free(vigem);
+    if (!vigem)
+        return;
+
+    vigem_unregister_bus_notification(vigem);
+
+    free(vigem);
 }
 
-VIGEM_ERROR vigem_connect(PVIGEM_CLIENT vigem)
+//
+// Caches the capabilities of the opened bus, leaves them empty on drivers
+// without support for the request.
+// 
+static void vigem_internal_query_capabilities(PVIGEM_CLIENT vigem)
 {
-    if (!vigem)
-        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_GET_CAPABILITIES caps;
+    VIGEM_GET_CAPABILITIES_INIT(&caps);
+
+    RtlZeroMemory(&vigem->Capabilities, sizeof(VIGEM_BUS_CAPABILITIES));
+
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_GET_CAPABILITIES,
+        &caps,
+        caps.Size,
+        &caps,
+        caps.Size,
+        &transferred,
+        &lOverlapped
+    );
+
+    //
+    // Only the part the driver filled in counts, the rest stays zeroed
+    // 
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) != 0
+        && transferred >= VIGEM_GET_CAPABILITIES_MIN_SIZE)
+    {
+        const auto size = min(caps.Capabilities.Size, static_cast<ULONG>(sizeof(VIGEM_BUS_CAPABILITIES)));
+
+        memcpy(&vigem->Capabilities, &caps.Capabilities, size);
+        vigem->Capabilities.Size = size;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+}
+
+//
+// Shared by every client of the process, see VIGEM_BUS_CACHE
+// 
+static VIGEM_BUS_CACHE vigem_internal_bus_cache = { SRWLOCK_INIT };
+
+typedef CONFIGRET (WINAPI *PFN_CM_REGISTER_NOTIFICATION)(
+    PCM_NOTIFY_FILTER pFilter,
+    PVOID pContext,
+    PCM_NOTIFY_CALLBACK pCallback,
+    PHCMNOTIFICATION pNotifyContext
+    );
+
+typedef CONFIGRET (WINAPI *PFN_CM_UNREGISTER_NOTIFICATION)(
+    HCMNOTIFICATION NotifyContext
+    );
 
+static void vigem_internal_setupapi_enumerate(std::vector<std::wstring>& paths)
+{
     SP_DEVICE_INTERFACE_DATA deviceInterfaceData = { 0 };
     deviceInterfaceData.cbSize = sizeof(deviceInterfaceData);
     DWORD memberIndex = 0;
     DWORD requiredSize = 0;
-    auto error = VIGEM_ERROR_BUS_NOT_FOUND;
-
-    // check for already open handle as re-opening accidentally would destroy all live targets
-    if (vigem->hBusDevice != INVALID_HANDLE_VALUE)
-    {
-        return VIGEM_ERROR_BUS_ALREADY_CONNECTED;
-    }
 
     const auto deviceInfoSet = SetupDiGetClassDevs(
         &GUID_DEVINTERFACE_BUSENUM_VIGEM,
@@ -186,6 +247,9 @@ VIGEM_ERROR vigem_connect(PVIGEM_CLIENT vigem)
         DIGCF_PRESENT | DIGCF_DEVICEINTERFACE
     );
 
+    if (deviceInfoSet == INVALID_HANDLE_VALUE)
+        return;
+
     // enumerate device instances
     while (SetupDiEnumDeviceInterfaces(
         deviceInfoSet,
@@ -200,10 +264,14 @@ VIGEM_ERROR vigem_connect(PVIGEM_CLIENT vigem)
 
         // allocate target buffer
         const auto detailDataBuffer = static_cast<PSP_DEVICE_INTERFACE_DETAIL_DATA>(malloc(requiredSize));
+
+        if (!detailDataBuffer)
+            break;
+
         detailDataBuffer->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
 
         // get detail buffer
-        if (!SetupDiGetDeviceInterfaceDetail(
+        if (SetupDiGetDeviceInterfaceDetail(
             deviceInfoSet,
             &deviceInterfaceData,
             detailDataBuffer,
@@ -212,66 +280,317 @@ VIGEM_ERROR vigem_connect(PVIGEM_CLIENT vigem)
             nullptr
         ))
         {
-            SetupDiDestroyDeviceInfoList(deviceInfoSet);
-            free(detailDataBuffer);
-            error = VIGEM_ERROR_BUS_NOT_FOUND;
-            continue;
+            paths.emplace_back(detailDataBuffer->DevicePath);
         }
 
-        // bus found, open it
-        vigem->hBusDevice = CreateFile(
-            detailDataBuffer->DevicePath,
-            GENERIC_READ | GENERIC_WRITE,
-            FILE_SHARE_READ | FILE_SHARE_WRITE,
-            nullptr,
-            OPEN_EXISTING,
-            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_OVERLAPPED,
-            nullptr
+        free(detailDataBuffer);
+    }
+
+    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+}
+
+static VIGEM_ERROR vigem_internal_setupapi_open(LPCWSTR path, PHANDLE bus)
+{
+    *bus = CreateFile(
+        path,
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_OVERLAPPED,
+        nullptr
+    );
+
+    // check bus open result
+    if (*bus == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_CHECK_VERSION version;
+    VIGEM_CHECK_VERSION_INIT(&version, VIGEM_COMMON_VERSION);
+
+    // send compiled library version to driver to check compatibility
+    DeviceIoControl(
+        *bus,
+        IOCTL_VIGEM_CHECK_VERSION,
+        &version,
+        version.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    // wait for result
+    const auto compatible = GetOverlappedResult(*bus, &lOverlapped, &transferred, TRUE) != 0;
+
+    CloseHandle(lOverlapped.hEvent);
+
+    if (compatible)
+        return VIGEM_ERROR_NONE;
+
+    CloseHandle(*bus);
+    *bus = INVALID_HANDLE_VALUE;
+
+    return VIGEM_ERROR_BUS_VERSION_MISMATCH;
+}
+
+static DWORD CALLBACK vigem_internal_cm_notification(
+    HCMNOTIFICATION hNotify,
+    PVOID Context,
+    CM_NOTIFY_ACTION Action,
+    PCM_NOTIFY_EVENT_DATA EventData,
+    DWORD EventDataSize
+)
+{
+    UNREFERENCED_PARAMETER(hNotify);
+    UNREFERENCED_PARAMETER(EventDataSize);
+
+    const auto client = static_cast<PVIGEM_CLIENT>(Context);
+
+    switch (Action)
+    {
+    case CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL:
+        vigem_internal_bus_changed(client, VIGEM_BUS_EVENT_ARRIVAL, EventData->u.DeviceInterface.SymbolicLink);
+        break;
+    case CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL:
+        vigem_internal_bus_changed(client, VIGEM_BUS_EVENT_REMOVAL, EventData->u.DeviceInterface.SymbolicLink);
+        break;
+    default:
+        break;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+//
+// Resolved at runtime, the notification API doesn't exist before Windows 8
+// 
+static HMODULE vigem_internal_cfgmgr32()
+{
+    static const auto module = LoadLibraryW(L"cfgmgr32.dll");
+
+    return module;
+}
+
+static VIGEM_ERROR vigem_internal_cm_watch(PVIGEM_CLIENT client)
+{
+    const auto module = vigem_internal_cfgmgr32();
+    const auto pRegister = module
+        ? reinterpret_cast<PFN_CM_REGISTER_NOTIFICATION>(GetProcAddress(module, "CM_Register_Notification"))
+        : nullptr;
+
+    if (!pRegister)
+        return VIGEM_ERROR_NOT_SUPPORTED;
+
+    CM_NOTIFY_FILTER filter = { 0 };
+    filter.cbSize = sizeof(CM_NOTIFY_FILTER);
+    filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+    filter.u.DeviceInterface.ClassGuid = GUID_DEVINTERFACE_BUSENUM_VIGEM;
+
+    HCMNOTIFICATION notification = nullptr;
+
+    if (pRegister(&filter, client, vigem_internal_cm_notification, &notification) != CR_SUCCESS)
+        return VIGEM_ERROR_NOT_SUPPORTED;
+
+    client->BusWatch = notification;
+
+    return VIGEM_ERROR_NONE;
+}
+
+static void vigem_internal_cm_unwatch(PVIGEM_CLIENT client)
+{
+    const auto module = vigem_internal_cfgmgr32();
+    const auto pUnregister = module
+        ? reinterpret_cast<PFN_CM_UNREGISTER_NOTIFICATION>(GetProcAddress(module, "CM_Unregister_Notification"))
+        : nullptr;
+
+    if (pUnregister && client->BusWatch)
+        pUnregister(static_cast<HCMNOTIFICATION>(client->BusWatch));
+
+    client->BusWatch = nullptr;
+}
+
+//
+// Bus devices of the system, via SetupAPI and the configuration manager
+// 
+static const VIGEM_BUS_DISCOVERY vigem_internal_system_discovery = {
+    vigem_internal_setupapi_enumerate,
+    vigem_internal_setupapi_open,
+    vigem_internal_cm_watch,
+    vigem_internal_cm_unwatch
+};
+
+const VIGEM_BUS_DISCOVERY* vigem_internal_discovery = &vigem_internal_system_discovery;
+
+void vigem_internal_bus_changed(PVIGEM_CLIENT client, VIGEM_BUS_EVENT event, LPCWSTR path)
+{
+    AcquireSRWLockExclusive(&vigem_internal_bus_cache.Lock);
+
+    auto& paths = vigem_internal_bus_cache.Paths;
+    const auto cached = std::find_if(paths.begin(), paths.end(), [path](const std::wstring& cachedPath)
+    {
+        return _wcsicmp(cachedPath.c_str(), path) == 0;
+    });
+
+    if (event == VIGEM_BUS_EVENT_ARRIVAL && cached == paths.end())
+        paths.emplace_back(path);
+    else if (event == VIGEM_BUS_EVENT_REMOVAL && cached != paths.end())
+        paths.erase(cached);
+
+    //
+    // A driver update removes and re-adds the bus, what it reports may differ
+    // 
+    RtlZeroMemory(&vigem_internal_bus_cache.Capabilities, sizeof(VIGEM_BUS_CAPABILITIES));
+
+    ReleaseSRWLockExclusive(&vigem_internal_bus_cache.Lock);
+
+    //
+    // Invoke outside the lock so the callback may unregister itself
+    // 
+    AcquireSRWLockShared(&client->BusNotificationLock);
+    const auto notification = client->BusNotification;
+    const auto userData = client->BusNotificationUserData;
+    ReleaseSRWLockShared(&client->BusNotificationLock);
+
+    if (notification)
+    {
+        reinterpret_cast<PFN_VIGEM_BUS_NOTIFICATION>(notification)(
+            client, event, userData
         );
+    }
+}
 
-        // check bus open result
-        if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+//
+// Opens every compatible bus of the given paths, fails if none opened
+// 
+static VIGEM_ERROR vigem_internal_open_buses(
+    PVIGEM_CLIENT vigem,
+    const std::vector<std::wstring>& paths,
+    std::vector<std::wstring>& opened
+)
+{
+    auto error = VIGEM_ERROR_BUS_NOT_FOUND;
+
+    for (const auto& path : paths)
+    {
+        if (vigem->BusCount >= VIGEM_BUSES_MAX)
+            break;
+
+        HANDLE bus = INVALID_HANDLE_VALUE;
+        const auto result = vigem_internal_discovery->Open(path.c_str(), &bus);
+
+        if (VIGEM_SUCCESS(result))
         {
-            error = VIGEM_ERROR_BUS_ACCESS_FAILED;
-            free(detailDataBuffer);
+            vigem->Buses[vigem->BusCount++] = bus;
+            opened.push_back(path);
+            error = VIGEM_ERROR_NONE;
             continue;
         }
 
-        DWORD transferred = 0;
-        OVERLAPPED lOverlapped = { 0 };
-        lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        // the first failure decides the error while no bus opened
+        if (vigem->BusCount == 0 && error == VIGEM_ERROR_BUS_NOT_FOUND)
+            error = result;
+    }
 
-        VIGEM_CHECK_VERSION version;
-        VIGEM_CHECK_VERSION_INIT(&version, VIGEM_COMMON_VERSION);
+    return error;
+}
 
-        // send compiled library version to driver to check compatibility
-        DeviceIoControl(
-            vigem->hBusDevice,
-            IOCTL_VIGEM_CHECK_VERSION,
-            &version,
-            version.Size,
-            nullptr,
-            0,
-            &transferred,
-            &lOverlapped
-        );
+static void vigem_internal_close_buses(PVIGEM_CLIENT vigem)
+{
+    for (ULONG bus = 0; bus < vigem->BusCount; bus++)
+        CloseHandle(vigem->Buses[bus]);
+
+    vigem->BusCount = 0;
+}
+
+VIGEM_ERROR vigem_connect(PVIGEM_CLIENT vigem)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    // check for already open handle as re-opening accidentally would destroy all live targets
+    if (vigem->hBusDevice != INVALID_HANDLE_VALUE)
+    {
+        return VIGEM_ERROR_BUS_ALREADY_CONNECTED;
+    }
+
+    std::vector<std::wstring> paths;
+    std::vector<std::wstring> opened;
+    auto error = VIGEM_ERROR_BUS_NOT_FOUND;
 
-        // wait for result
-        if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
+    AcquireSRWLockShared(&vigem_internal_bus_cache.Lock);
+    paths = vigem_internal_bus_cache.Paths;
+    ReleaseSRWLockShared(&vigem_internal_bus_cache.Lock);
+
+    //
+    // Reconnects open the buses found before without enumerating, unless
+    // one of them is gone
+    // 
+    if (!paths.empty())
+    {
+        error = vigem_internal_open_buses(vigem, paths, opened);
+
+        if (opened.size() != paths.size())
         {
-            error = VIGEM_ERROR_NONE;
-            free(detailDataBuffer);
-            CloseHandle(lOverlapped.hEvent);
-            break;
+            vigem_internal_close_buses(vigem);
+            opened.clear();
         }
+    }
 
-        error = VIGEM_ERROR_BUS_VERSION_MISMATCH;
+    // every compatible bus found becomes one targets get placed on
+    if (opened.empty())
+    {
+        paths.clear();
+        vigem_internal_discovery->Enumerate(paths);
 
-        CloseHandle(lOverlapped.hEvent);
-        free(detailDataBuffer);
+        error = vigem_internal_open_buses(vigem, paths, opened);
     }
 
-    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+    if (vigem->BusCount == 0)
+        return error;
+
+    //
+    // The first bus found serves everything not bound to a target
+    // 
+    vigem->hBusDevice = vigem->Buses[0];
+
+    //
+    // Capabilities cached by a previous connect still hold unless a bus
+    // changed since, which is only known while bus changes are watched
+    // 
+    auto reuseCapabilities = false;
+
+    AcquireSRWLockExclusive(&vigem_internal_bus_cache.Lock);
+
+    if (vigem_internal_bus_cache.Paths == opened
+        && vigem_internal_bus_cache.Capabilities.Size != 0
+        && ReadAcquire(&vigem_internal_bus_cache.Watches) > 0)
+    {
+        vigem->Capabilities = vigem_internal_bus_cache.Capabilities;
+        reuseCapabilities = true;
+    }
+    else
+    {
+        vigem_internal_bus_cache.Paths = opened;
+        RtlZeroMemory(&vigem_internal_bus_cache.Capabilities, sizeof(VIGEM_BUS_CAPABILITIES));
+    }
+
+    ReleaseSRWLockExclusive(&vigem_internal_bus_cache.Lock);
+
+    if (!reuseCapabilities)
+    {
+        // Selects the data paths used from here on
+        vigem_internal_query_capabilities(vigem);
+
+        AcquireSRWLockExclusive(&vigem_internal_bus_cache.Lock);
+        if (vigem_internal_bus_cache.Paths == opened)
+            vigem_internal_bus_cache.Capabilities = vigem->Capabilities;
+        ReleaseSRWLockExclusive(&vigem_internal_bus_cache.Lock);
+    }
 
     return error;
 }
@@ -283,9 +602,14 @@ void vigem_disconnect(PVIGEM_CLIENT vigem)
 
     if (vigem->hBusDevice != INVALID_HANDLE_VALUE)
     {
-        CloseHandle(vigem->hBusDevice);
-
-        RtlZeroMemory(vigem, sizeof(VIGEM_CLIENT));
+        // The primary bus is the first of them
+        vigem_internal_close_buses(vigem);
+
+        //
+        // The bus watch outlives the connection, it tells when to reconnect.
+        // Reports may be reading the notification meanwhile, leave it alone.
+        // 
+        RtlZeroMemory(vigem, offsetof(VIGEM_CLIENT, BusNotificationLock));
         vigem->hBusDevice = INVALID_HANDLE_VALUE;
     }
 }
@@ -322,9 +646,37 @@ void vigem_target_free(PVIGEM_TARGET target)
 		free(target);
 }
 
-VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+//
+// Picks the bus a new target goes to according to the placement policy
+// 
+static ULONG vigem_internal_place_target(PVIGEM_CLIENT vigem)
+{
+    ULONG best = 0;
+
+    switch (vigem->Placement)
+    {
+    case VIGEM_BUS_PLACEMENT_ROUND_ROBIN:
+        return static_cast<ULONG>(InterlockedIncrement(&vigem->NextBus) - 1) % vigem->BusCount;
+    case VIGEM_BUS_PLACEMENT_LEAST_LOADED:
+        for (ULONG bus = 1; bus < vigem->BusCount; bus++)
+        {
+            if (ReadAcquire(&vigem->BusTargets[bus]) < ReadAcquire(&vigem->BusTargets[best]))
+                best = bus;
+        }
+        return best;
+    default:
+        return 0;
+    }
+}
+
+//
+// Plugs the target into the given bus, or the one the placement policy picks if negative
+// 
+static VIGEM_ERROR vigem_internal_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, LONG busIndex)
 {
     VIGEM_ERROR error = VIGEM_ERROR_NO_FREE_SLOT;
+    VIGEM_TARGET_STATE previous = VIGEM_TARGET_NEW;
+    bool claimed = false;
     DWORD transferred = 0;
     VIGEM_PLUGIN_TARGET plugin;
     VIGEM_WAIT_DEVICE_READY devReady;
@@ -352,24 +704,55 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
         	break;
         }
 
-        if (target->State == VIGEM_TARGET_NEW)
+        if (busIndex >= static_cast<LONG>(vigem->BusCount))
+        {
+            error = VIGEM_ERROR_INVALID_PARAMETER;
+            break;
+        }
+
+        previous = VIGEM_TARGET_GET_STATE(target);
+
+        if (previous == VIGEM_TARGET_NEW)
         {
             error = VIGEM_ERROR_TARGET_UNINITIALIZED;
         	break;
         }
 
-        if (target->State == VIGEM_TARGET_CONNECTED)
+        if (previous == VIGEM_TARGET_CONNECTED
+            || previous == VIGEM_TARGET_CONNECTING
+            || previous == VIGEM_TARGET_REMOVING)
         {
             error = VIGEM_ERROR_ALREADY_CONNECTED;
         	break;
-        }       
+        }
+
+        //
+        // Claim the target, concurrent add or remove calls fail from here on
+        // 
+        if (!VIGEM_TARGET_TRANSITION(target, previous, VIGEM_TARGET_CONNECTING))
+        {
+            error = VIGEM_ERROR_ALREADY_CONNECTED;
+            break;
+        }
+
+        claimed = true;
+        target->SerialNo = 0;
+        target->BusIndex = (busIndex >= 0) ? static_cast<ULONG>(busIndex) : vigem_internal_place_target(vigem);
+
+        const HANDLE bus = vigem->Buses[target->BusIndex];
 
     	//
-    	// TODO: this is mad stupid, redesign, so that the bus fills the assigned slot
+    	// Serial 0 lets the bus assign a free serial. Drivers without support
+    	// for this fail it and the remaining serials get probed one by one.
+    	// Drivers reporting capabilities skip whichever path they lack.
     	// 
-        for (target->SerialNo = 1; target->SerialNo <= VIGEM_TARGETS_MAX; target->SerialNo++)
+        const ULONG firstSerialNo = VIGEM_BUS_MAY_USE(vigem, VIGEM_BUS_FEATURE_ASSIGN_SERIAL) ? 0 : 1;
+
+        for (ULONG serialNo = firstSerialNo; serialNo <= VIGEM_TARGETS_MAX; serialNo++)
         {
-	        VIGEM_PLUGIN_TARGET_INIT(&plugin, target->SerialNo, target->Type);
+	        const bool assignSerial = (serialNo == 0);
+
+	        VIGEM_PLUGIN_TARGET_INIT(&plugin, serialNo, target->Type);
 
 	        plugin.VendorId = target->VendorId;
 	        plugin.ProductId = target->ProductId;
@@ -388,12 +771,12 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
         	 * hopefully the applications will just ignore these errors and retry ;)
         	 */
 	        DeviceIoControl(
-		        vigem->hBusDevice,
-		        IOCTL_VIGEM_PLUGIN_TARGET,
+		        bus,
+		        assignSerial ? IOCTL_VIGEM_PLUGIN_TARGET_EX : IOCTL_VIGEM_PLUGIN_TARGET,
 		        &plugin,
 		        plugin.Size,
-		        nullptr,
-		        0,
+		        assignSerial ? &plugin : nullptr,
+		        assignSerial ? plugin.Size : 0,
 		        &transferred,
 		        &olPlugIn
 	        );
@@ -401,8 +784,25 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
         	//
         	// This should return fairly immediately >=v1.17
         	// 
-	        if (GetOverlappedResult(vigem->hBusDevice, &olPlugIn, &transferred, TRUE) != 0)
+	        if (GetOverlappedResult(bus, &olPlugIn, &transferred, TRUE) != 0)
 	        {
+		        target->SerialNo = plugin.SerialNo;
+
+		        // Undone by vigem_target_remove
+		        InterlockedIncrement(&vigem->BusTargets[target->BusIndex]);
+
+		        //
+		        // Plug-in already waited for the device to be ready
+		        // 
+		        if (!VIGEM_BUS_MAY_USE(vigem, VIGEM_BUS_FEATURE_WAIT_DEVICE_READY))
+		        {
+			        VIGEM_TARGET_SET_STATE(target, VIGEM_TARGET_CONNECTED);
+			        claimed = false;
+
+			        error = VIGEM_ERROR_NONE;
+			        break;
+		        }
+
 	        	/*
 	        	 * This function is announced to be blocking/synchronous, a concept that 
 	        	 * doesn't reflect the way the bus driver/PNP manager bring child devices
@@ -415,7 +815,7 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
 		        VIGEM_WAIT_DEVICE_READY_INIT(&devReady, plugin.SerialNo);
 
 		        DeviceIoControl(
-			        vigem->hBusDevice,
+			        bus,
 			        IOCTL_VIGEM_WAIT_DEVICE_READY,
 			        &devReady,
 			        devReady.Size,
@@ -425,9 +825,10 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
 			        &olWait
 		        );
 
-		        if (GetOverlappedResult(vigem->hBusDevice, &olWait, &transferred, TRUE) != 0)
+		        if (GetOverlappedResult(bus, &olWait, &transferred, TRUE) != 0)
 		        {
-			        target->State = VIGEM_TARGET_CONNECTED;
+			        VIGEM_TARGET_SET_STATE(target, VIGEM_TARGET_CONNECTED);
+			        claimed = false;
 
 			        error = VIGEM_ERROR_NONE;
 			        break;
@@ -438,7 +839,8 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
 		        // 
 		        if (GetLastError() == ERROR_INVALID_PARAMETER)
 		        {
-			        target->State = VIGEM_TARGET_CONNECTED;
+			        VIGEM_TARGET_SET_STATE(target, VIGEM_TARGET_CONNECTED);
+			        claimed = false;
 
 			        error = VIGEM_ERROR_NONE;
 			        break;
@@ -447,12 +849,27 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
 		        //
 		        // Don't leave device connected if the wait call failed
 		        // 
+		        VIGEM_TARGET_SET_STATE(target, VIGEM_TARGET_CONNECTED);
+		        claimed = false;
 		        error = vigem_target_remove(vigem, target);
 		        break;
 	        }
+
+	        //
+	        // Supported but failed, e.g. all serials taken; probing won't help
+	        // 
+	        if (assignSerial && GetLastError() != ERROR_INVALID_PARAMETER)
+		        break;
         }
     } while (false);
 
+    //
+    // Release the claim if the target didn't make it onto the bus, once
+    // connected the state may already belong to another call
+    // 
+    if (claimed)
+        VIGEM_TARGET_SET_STATE(target, previous);
+
     if (olPlugIn.hEvent)
 	    CloseHandle(olPlugIn.hEvent);
 
@@ -462,6 +879,19 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
     return error;
 }
 
+VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+{
+    return vigem_internal_target_add(vigem, target, -1);
+}
+
+VIGEM_ERROR vigem_target_add_to_bus(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, ULONG busIndex)
+{
+    if (busIndex >= VIGEM_BUSES_MAX)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    return vigem_internal_target_add(vigem, target, static_cast<LONG>(busIndex));
+}
+
 VIGEM_ERROR vigem_target_add_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PFN_VIGEM_TARGET_ADD_RESULT result)
 {
 	if (!vigem)
@@ -473,10 +903,14 @@ VIGEM_ERROR vigem_target_add_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PF
 	if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
 		return VIGEM_ERROR_BUS_NOT_FOUND;
 
-	if (target->State == VIGEM_TARGET_NEW)
+	const auto state = VIGEM_TARGET_GET_STATE(target);
+
+	if (state == VIGEM_TARGET_NEW)
 		return VIGEM_ERROR_TARGET_UNINITIALIZED;
 
-	if (target->State == VIGEM_TARGET_CONNECTED)
+	if (state == VIGEM_TARGET_CONNECTED
+		|| state == VIGEM_TARGET_CONNECTING
+		|| state == VIGEM_TARGET_REMOVING)
 		return VIGEM_ERROR_ALREADY_CONNECTED;
 
 	std::thread _async{
@@ -508,10 +942,13 @@ VIGEM_ERROR vigem_target_remove(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
     if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
         return VIGEM_ERROR_BUS_NOT_FOUND;
 
-    if (target->State == VIGEM_TARGET_NEW)
+    if (VIGEM_TARGET_GET_STATE(target) == VIGEM_TARGET_NEW)
         return VIGEM_ERROR_TARGET_UNINITIALIZED;
 
-    if (target->State != VIGEM_TARGET_CONNECTED)
+    //
+    // Only one of several concurrent callers gets to remove the target
+    // 
+    if (!VIGEM_TARGET_TRANSITION(target, VIGEM_TARGET_CONNECTED, VIGEM_TARGET_REMOVING))
         return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
 
     DWORD transfered = 0;
@@ -522,7 +959,7 @@ VIGEM_ERROR vigem_target_remove(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
     VIGEM_UNPLUG_TARGET_INIT(&unplug, target->SerialNo);
 
     DeviceIoControl(
-        vigem->hBusDevice,
+        VIGEM_TARGET_BUS(vigem, target),
         IOCTL_VIGEM_UNPLUG_TARGET,
         &unplug,
         unplug.Size,
@@ -532,14 +969,17 @@ VIGEM_ERROR vigem_target_remove(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
         &lOverlapped
     );
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transfered, TRUE) != 0)
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transfered, TRUE) != 0)
     {
-        target->State = VIGEM_TARGET_DISCONNECTED;
+        InterlockedDecrement(&vigem->BusTargets[target->BusIndex]);
+
+        VIGEM_TARGET_SET_STATE(target, VIGEM_TARGET_DISCONNECTED);
         CloseHandle(lOverlapped.hEvent);
 
         return VIGEM_ERROR_NONE;
     }
 
+    VIGEM_TARGET_SET_STATE(target, VIGEM_TARGET_CONNECTED);
     CloseHandle(lOverlapped.hEvent);
 
     return VIGEM_ERROR_REMOVAL_FAILED;
@@ -564,8 +1004,13 @@ VIGEM_ERROR vigem_target_x360_register_notification(
     if (target->SerialNo == 0 || notification == nullptr)
         return VIGEM_ERROR_INVALID_TARGET;
 
+    AcquireSRWLockExclusive(&target->NotificationLock);
+
     if (target->Notification == reinterpret_cast<FARPROC>(notification))
+    {
+        ReleaseSRWLockExclusive(&target->NotificationLock);
         return VIGEM_ERROR_CALLBACK_ALREADY_REGISTERED;
+    }
 
     target->Notification = reinterpret_cast<FARPROC>(notification);
     target->NotificationUserData = userData;
@@ -580,11 +1025,12 @@ VIGEM_ERROR vigem_target_x360_register_notification(
     else
 	    ResetEvent(target->cancelNotificationThreadEvent);
 
+    ReleaseSRWLockExclusive(&target->NotificationLock);
+
     std::thread _async{
 	    [](
 	    PVIGEM_TARGET _Target,
-	    PVIGEM_CLIENT _Client,
-	    LPVOID _UserData)
+	    PVIGEM_CLIENT _Client)
 	    {
 		    DWORD transferred = 0;
 		    OVERLAPPED lOverlapped = {0};
@@ -593,10 +1039,16 @@ VIGEM_ERROR vigem_target_x360_register_notification(
 		    XUSB_REQUEST_NOTIFICATION xrn;
 		    XUSB_REQUEST_NOTIFICATION_INIT(&xrn, _Target->SerialNo);
 
+		    //
+		    // Requests go out without touching the client or the target, either
+		    // may be freed once one of them fails
+		    // 
+		    const HANDLE bus = VIGEM_TARGET_BUS(_Client, _Target);
+
 		    do
 		    {
 			    DeviceIoControl(
-				    _Client->hBusDevice,
+				    bus,
 				    IOCTL_XUSB_REQUEST_NOTIFICATION,
 				    &xrn,
 				    xrn.Size,
@@ -606,22 +1058,37 @@ VIGEM_ERROR vigem_target_x360_register_notification(
 				    &lOverlapped
 			    );
 
-			    if (GetOverlappedResult(_Client->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
+			    if (GetOverlappedResult(bus, &lOverlapped, &transferred, TRUE) != 0)
 			    {
-				    if (_Target->Notification == nullptr)
+				    //
+				    // Invoke outside the lock so the callback may unregister itself
+				    // 
+				    AcquireSRWLockShared(&_Target->NotificationLock);
+				    const auto notification = _Target->Notification;
+				    const auto userData = _Target->NotificationUserData;
+				    ReleaseSRWLockShared(&_Target->NotificationLock);
+
+				    if (notification == nullptr)
 				    {
 					    CloseHandle(lOverlapped.hEvent);
 					    return;
 				    }
 
-				    reinterpret_cast<PFN_VIGEM_X360_NOTIFICATION>(_Target->Notification)(
-					    _Client, _Target, xrn.LargeMotor, xrn.SmallMotor, xrn.LedNumber, _UserData
+				    reinterpret_cast<PFN_VIGEM_X360_NOTIFICATION>(notification)(
+					    _Client, _Target, xrn.LargeMotor, xrn.SmallMotor, xrn.LedNumber, userData
 				    );
 
 				    continue;
 			    }
 
-			    if (GetLastError() == ERROR_ACCESS_DENIED || GetLastError() == ERROR_OPERATION_ABORTED)
+			    //
+			    // Cancelled by the removal, or the target or the connection was
+			    // already gone when the request after a callback went out
+			    // 
+			    const auto error = GetLastError();
+
+			    if (error == ERROR_ACCESS_DENIED || error == ERROR_OPERATION_ABORTED
+				    || error == ERROR_DEV_NOT_EXIST || error == ERROR_INVALID_HANDLE)
 			    {
 				    CloseHandle(lOverlapped.hEvent);
 				    return;
@@ -629,7 +1096,7 @@ VIGEM_ERROR vigem_target_x360_register_notification(
 		    }
 		    while (TRUE);
 	    },
-	    target, vigem, userData
+	    target, vigem
     };
 
     _async.detach();
@@ -656,8 +1123,13 @@ VIGEM_ERROR vigem_target_ds4_register_notification(
     if (target->SerialNo == 0 || notification == nullptr)
         return VIGEM_ERROR_INVALID_TARGET;
 
+    AcquireSRWLockExclusive(&target->NotificationLock);
+
     if (target->Notification == reinterpret_cast<FARPROC>(notification))
+    {
+        ReleaseSRWLockExclusive(&target->NotificationLock);
         return VIGEM_ERROR_CALLBACK_ALREADY_REGISTERED;
+    }
 
     target->Notification = reinterpret_cast<FARPROC>(notification);
     target->NotificationUserData = userData;
@@ -672,11 +1144,12 @@ VIGEM_ERROR vigem_target_ds4_register_notification(
 	else
 		ResetEvent(target->cancelNotificationThreadEvent);
 
+    ReleaseSRWLockExclusive(&target->NotificationLock);
+
     std::thread _async{
 	    [](
 	    PVIGEM_TARGET _Target,
-	    PVIGEM_CLIENT _Client,
-	    LPVOID _UserData)
+	    PVIGEM_CLIENT _Client)
 	    {
 		    DWORD transferred = 0;
 		    OVERLAPPED lOverlapped = {0};
@@ -685,10 +1158,16 @@ VIGEM_ERROR vigem_target_ds4_register_notification(
 		    DS4_REQUEST_NOTIFICATION ds4rn;
 		    DS4_REQUEST_NOTIFICATION_INIT(&ds4rn, _Target->SerialNo);
 
+		    //
+		    // Requests go out without touching the client or the target, either
+		    // may be freed once one of them fails
+		    // 
+		    const HANDLE bus = VIGEM_TARGET_BUS(_Client, _Target);
+
 		    do
 		    {
 			    DeviceIoControl(
-				    _Client->hBusDevice,
+				    bus,
 				    IOCTL_DS4_REQUEST_NOTIFICATION,
 				    &ds4rn,
 				    ds4rn.Size,
@@ -698,24 +1177,39 @@ VIGEM_ERROR vigem_target_ds4_register_notification(
 				    &lOverlapped
 			    );
 
-			    if (GetOverlappedResult(_Client->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
+			    if (GetOverlappedResult(bus, &lOverlapped, &transferred, TRUE) != 0)
 			    {
-				    if (_Target->Notification == nullptr)
+				    //
+				    // Invoke outside the lock so the callback may unregister itself
+				    // 
+				    AcquireSRWLockShared(&_Target->NotificationLock);
+				    const auto notification = _Target->Notification;
+				    const auto userData = _Target->NotificationUserData;
+				    ReleaseSRWLockShared(&_Target->NotificationLock);
+
+				    if (notification == nullptr)
 				    {
 					    CloseHandle(lOverlapped.hEvent);
 					    return;
 				    }
 
-				    reinterpret_cast<PFN_VIGEM_DS4_NOTIFICATION>(_Target->Notification)(
+				    reinterpret_cast<PFN_VIGEM_DS4_NOTIFICATION>(notification)(
 					    _Client, _Target, ds4rn.Report.LargeMotor,
 					    ds4rn.Report.SmallMotor,
-					    ds4rn.Report.LightbarColor, _UserData
+					    ds4rn.Report.LightbarColor, userData
 				    );
 
 				    continue;
 			    }
 
-			    if (GetLastError() == ERROR_ACCESS_DENIED || GetLastError() == ERROR_OPERATION_ABORTED)
+			    //
+			    // Cancelled by the removal, or the target or the connection was
+			    // already gone when the request after a callback went out
+			    // 
+			    const auto error = GetLastError();
+
+			    if (error == ERROR_ACCESS_DENIED || error == ERROR_OPERATION_ABORTED
+				    || error == ERROR_DEV_NOT_EXIST || error == ERROR_INVALID_HANDLE)
 			    {
 				    CloseHandle(lOverlapped.hEvent);
 				    return;
@@ -723,7 +1217,7 @@ VIGEM_ERROR vigem_target_ds4_register_notification(
 		    }
 		    while (TRUE);
 	    },
-	    target, vigem, userData
+	    target, vigem
     };
 
     _async.detach();
@@ -733,6 +1227,8 @@ VIGEM_ERROR vigem_target_ds4_register_notification(
 
 void vigem_target_x360_unregister_notification(PVIGEM_TARGET target)
 {	
+	AcquireSRWLockExclusive(&target->NotificationLock);
+
 	if (target->cancelNotificationThreadEvent != 0)
 		SetEvent(target->cancelNotificationThreadEvent);
     
@@ -744,6 +1240,8 @@ void vigem_target_x360_unregister_notification(PVIGEM_TARGET target)
 
 	target->Notification = nullptr;
 	target->NotificationUserData = nullptr;
+
+	ReleaseSRWLockExclusive(&target->NotificationLock);
 }
 
 void vigem_target_ds4_unregister_notification(PVIGEM_TARGET target)
@@ -799,7 +1297,7 @@ VIGEM_ERROR vigem_target_x360_update(
     xsr.Report = report;
 
     DeviceIoControl(
-        vigem->hBusDevice,
+        VIGEM_TARGET_BUS(vigem, target),
         IOCTL_XUSB_SUBMIT_REPORT,
         &xsr,
         xsr.Size,
@@ -809,7 +1307,7 @@ VIGEM_ERROR vigem_target_x360_update(
         &lOverlapped
     );
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
     {
         if (GetLastError() == ERROR_ACCESS_DENIED)
         {
@@ -851,7 +1349,7 @@ VIGEM_ERROR vigem_target_ds4_update(
     dsr.Report = report;
 
     DeviceIoControl(
-        vigem->hBusDevice,
+        VIGEM_TARGET_BUS(vigem, target),
         IOCTL_DS4_SUBMIT_REPORT,
         &dsr,
         dsr.Size,
@@ -861,7 +1359,7 @@ VIGEM_ERROR vigem_target_ds4_update(
         &lOverlapped
     );
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
     {
         if (GetLastError() == ERROR_ACCESS_DENIED)
         {
@@ -893,13 +1391,16 @@ VIGEM_ERROR vigem_target_ds4_update_ex(PVIGEM_CLIENT vigem, PVIGEM_TARGET target
 	OVERLAPPED lOverlapped = {0};
 	lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 
+	if (!VIGEM_BUS_MAY_USE(vigem, VIGEM_BUS_FEATURE_DS4_REPORT_EX))
+		return VIGEM_ERROR_NOT_SUPPORTED;
+
 	DS4_SUBMIT_REPORT_EX dsr;
 	DS4_SUBMIT_REPORT_EX_INIT(&dsr, target->SerialNo);
 
 	dsr.Report = report;
 
 	DeviceIoControl(
-		vigem->hBusDevice,
+		VIGEM_TARGET_BUS(vigem, target),
 		IOCTL_DS4_SUBMIT_REPORT, // Same IOCTL, just different size
 		&dsr,
 		dsr.Size,
@@ -909,7 +1410,7 @@ VIGEM_ERROR vigem_target_ds4_update_ex(PVIGEM_CLIENT vigem, PVIGEM_TARGET target
 		&lOverlapped
 	);
 
-	if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+	if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
 	{
 		if (GetLastError() == ERROR_ACCESS_DENIED)
 		{
@@ -936,6 +1437,88 @@ VIGEM_ERROR vigem_target_ds4_update_ex(PVIGEM_CLIENT vigem, PVIGEM_TARGET target
 	return VIGEM_ERROR_NONE;
 }
 
+VIGEM_ERROR vigem_target_submit_report(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVOID submit)
+{
+    DWORD ioControlCode;
+
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!submit)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    //
+    // The submit structures start with Size and SerialNo, the size tells them apart
+    // 
+    const ULONG size = static_cast<PXUSB_SUBMIT_REPORT>(submit)->Size;
+
+    switch (target->Type)
+    {
+    case Xbox360Wired:
+        if (size != sizeof(XUSB_SUBMIT_REPORT))
+            return VIGEM_ERROR_INVALID_PARAMETER;
+
+        ioControlCode = IOCTL_XUSB_SUBMIT_REPORT;
+        break;
+    case DualShock4Wired:
+        if (size != sizeof(DS4_SUBMIT_REPORT) && size != sizeof(DS4_SUBMIT_REPORT_EX))
+            return VIGEM_ERROR_INVALID_PARAMETER;
+
+        if (size == sizeof(DS4_SUBMIT_REPORT_EX) && !VIGEM_BUS_MAY_USE(vigem, VIGEM_BUS_FEATURE_DS4_REPORT_EX))
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        ioControlCode = IOCTL_DS4_SUBMIT_REPORT;
+        break;
+    default:
+        return VIGEM_ERROR_NOT_SUPPORTED;
+    }
+
+    static_cast<PXUSB_SUBMIT_REPORT>(submit)->SerialNo = target->SerialNo;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        ioControlCode,
+        submit,
+        size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_ACCESS_DENIED)
+            return VIGEM_ERROR_INVALID_TARGET;
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
 ULONG vigem_target_get_index(PVIGEM_TARGET target)
 {
     return target->SerialNo;
@@ -948,7 +1531,7 @@ VIGEM_TARGET_TYPE vigem_target_get_type(PVIGEM_TARGET target)
 
 BOOL vigem_target_is_attached(PVIGEM_TARGET target)
 {
-    return (target->State == VIGEM_TARGET_CONNECTED);
+    return (VIGEM_TARGET_GET_STATE(target) == VIGEM_TARGET_CONNECTED);
 }
 
 VIGEM_ERROR vigem_target_x360_get_user_index(
@@ -980,7 +1563,7 @@ VIGEM_ERROR vigem_target_x360_get_user_index(
     XUSB_GET_USER_INDEX_INIT(&gui, target->SerialNo);
 
     DeviceIoControl(
-        vigem->hBusDevice,
+        VIGEM_TARGET_BUS(vigem, target),
         IOCTL_XUSB_GET_USER_INDEX,
         &gui,
         gui.Size,
@@ -990,7 +1573,7 @@ VIGEM_ERROR vigem_target_x360_get_user_index(
         &lOverlapped
     );
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
     {
         const auto error = GetLastError();
 
@@ -1013,3 +1596,1395 @@ VIGEM_ERROR vigem_target_x360_get_user_index(
 
     return VIGEM_ERROR_NONE;
 }
+
+VIGEM_ERROR vigem_target_x360_register_user_index_notification(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    PFN_VIGEM_X360_USER_INDEX_NOTIFICATION notification,
+    LPVOID userData
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || target->Type != Xbox360Wired || notification == nullptr)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!VIGEM_BUS_MAY_USE(vigem, VIGEM_BUS_FEATURE_USER_INDEX_WAIT))
+        return VIGEM_ERROR_NOT_SUPPORTED;
+
+    AcquireSRWLockExclusive(&target->NotificationLock);
+
+    if (target->UserIndexNotification == reinterpret_cast<FARPROC>(notification))
+    {
+        ReleaseSRWLockExclusive(&target->NotificationLock);
+        return VIGEM_ERROR_CALLBACK_ALREADY_REGISTERED;
+    }
+
+    target->UserIndexNotification = reinterpret_cast<FARPROC>(notification);
+    target->UserIndexNotificationUserData = userData;
+
+    ReleaseSRWLockExclusive(&target->NotificationLock);
+
+    std::thread _async{
+        [](
+        PVIGEM_TARGET _Target,
+        PVIGEM_CLIENT _Client)
+        {
+            DWORD transferred = 0;
+            OVERLAPPED lOverlapped = { 0 };
+            lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+            XUSB_WAIT_USER_INDEX wui;
+            LONG known = -1;
+
+            //
+            // The target may get removed and freed while a wait is pending,
+            // don't touch it again for what doesn't change anyway
+            // 
+            const ULONG serial = _Target->SerialNo;
+            const HANDLE bus = VIGEM_TARGET_BUS(_Client, _Target);
+
+            do
+            {
+                //
+                // Completes right away if the index already differs from the last one seen
+                // 
+                XUSB_WAIT_USER_INDEX_INIT(&wui, serial, known);
+
+                DeviceIoControl(
+                    bus,
+                    IOCTL_XUSB_WAIT_USER_INDEX,
+                    &wui,
+                    wui.Size,
+                    &wui,
+                    wui.Size,
+                    &transferred,
+                    &lOverlapped
+                );
+
+                if (GetOverlappedResult(bus, &lOverlapped, &transferred, TRUE) == 0)
+                {
+                    //
+                    // Target removed, request cancelled or driver without support
+                    // 
+                    CloseHandle(lOverlapped.hEvent);
+                    return;
+                }
+
+                //
+                // Invoke outside the lock so the callback may unregister itself
+                // 
+                AcquireSRWLockShared(&_Target->NotificationLock);
+                const auto notification = _Target->UserIndexNotification;
+                const auto userData = _Target->UserIndexNotificationUserData;
+                ReleaseSRWLockShared(&_Target->NotificationLock);
+
+                if (notification == nullptr)
+                {
+                    CloseHandle(lOverlapped.hEvent);
+                    return;
+                }
+
+                reinterpret_cast<PFN_VIGEM_X360_USER_INDEX_NOTIFICATION>(notification)(
+                    _Client, _Target, wui.UserIndex, userData
+                );
+
+                known = static_cast<LONG>(wui.UserIndex);
+            }
+            while (TRUE);
+        },
+        target, vigem
+    };
+
+    _async.detach();
+
+    return VIGEM_ERROR_NONE;
+}
+
+void vigem_target_x360_unregister_user_index_notification(PVIGEM_TARGET target)
+{
+    AcquireSRWLockExclusive(&target->NotificationLock);
+
+    target->UserIndexNotification = nullptr;
+    target->UserIndexNotificationUserData = nullptr;
+
+    ReleaseSRWLockExclusive(&target->NotificationLock);
+}
+
+VIGEM_ERROR vigem_target_set_axis_transform(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    const VIGEM_AXIS_PROFILE* profiles
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+
+    VIGEM_SET_AXIS_TRANSFORM transform;
+    VIGEM_SET_AXIS_TRANSFORM_INIT(&transform, target->SerialNo);
+
+    if (profiles)
+    {
+        //
+        // Validate here so the driver rejecting a profile can't be
+        // confused with an older driver not knowing the request
+        // 
+        for (int axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+        {
+            const auto profile = &profiles[axis];
+
+            if (profile->Source >= VIGEM_AXIS_COUNT
+                || (profile->Flags & ~VIGEM_AXIS_FLAG_INVERT)
+                || profile->Deadzone >= VIGEM_AXIS_MAX)
+                return VIGEM_ERROR_INVALID_PARAMETER;
+
+            for (int point = 0; point < VIGEM_AXIS_CURVE_POINTS; point++)
+            {
+                if (profile->Curve[point] > VIGEM_AXIS_MAX
+                    || (point > 0 && profile->Curve[point] < profile->Curve[point - 1]))
+                    return VIGEM_ERROR_INVALID_PARAMETER;
+            }
+
+            transform.Axes[axis] = *profile;
+        }
+
+        transform.Enable = TRUE;
+    }
+
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_SET_AXIS_TRANSFORM,
+        &transform,
+        transform.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_ACCESS_DENIED)
+            return VIGEM_ERROR_INVALID_TARGET;
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_set_aggregation(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    BOOL enable,
+    VIGEM_AGGREGATION_AXIS_MODE axisMode,
+    UCHAR priority
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (axisMode != VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE && axisMode != VIGEM_AGGREGATION_AXIS_PRIORITY)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_SET_AGGREGATION aggregation;
+    VIGEM_SET_AGGREGATION_INIT(&aggregation, target->SerialNo);
+
+    aggregation.Enable = enable ? TRUE : FALSE;
+    aggregation.AxisMode = axisMode;
+    aggregation.Priority = priority;
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_SET_AGGREGATION,
+        &aggregation,
+        aggregation.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+//
+// Sends IOCTL_VIGEM_ATTACH_SOURCE for the provided target.
+// 
+static VIGEM_ERROR vigem_internal_attach_source(
+    PVIGEM_CLIENT vigem,
+    ULONG serialNo,
+    VIGEM_TARGET_TYPE type,
+    BOOLEAN attach,
+    UCHAR priority
+)
+{
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_ATTACH_SOURCE source;
+    VIGEM_ATTACH_SOURCE_INIT(&source, serialNo, type);
+
+    source.Attach = attach;
+    source.Priority = priority;
+
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_ATTACH_SOURCE,
+        &source,
+        source.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        switch (error)
+        {
+        case ERROR_NO_SYSTEM_RESOURCES:
+            return VIGEM_ERROR_NO_FREE_SLOT;
+        case ERROR_INVALID_PARAMETER:
+            return VIGEM_ERROR_NOT_SUPPORTED;
+        default:
+            return VIGEM_ERROR_INVALID_TARGET;
+        }
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_attach_source(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    ULONG serialNo,
+    UCHAR priority
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (serialNo == 0)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    const auto previous = VIGEM_TARGET_GET_STATE(target);
+
+    if (previous == VIGEM_TARGET_CONNECTED
+        || previous == VIGEM_TARGET_ATTACHED_SOURCE
+        || previous == VIGEM_TARGET_CONNECTING
+        || previous == VIGEM_TARGET_REMOVING)
+        return VIGEM_ERROR_ALREADY_CONNECTED;
+
+    if (!VIGEM_TARGET_TRANSITION(target, previous, VIGEM_TARGET_CONNECTING))
+        return VIGEM_ERROR_ALREADY_CONNECTED;
+
+    const auto error = vigem_internal_attach_source(vigem, serialNo, target->Type, TRUE, priority);
+
+    if (VIGEM_SUCCESS(error))
+    {
+        // Serials are resolved on the primary bus
+        target->BusIndex = 0;
+        target->SerialNo = serialNo;
+        VIGEM_TARGET_SET_STATE(target, VIGEM_TARGET_ATTACHED_SOURCE);
+    }
+    else
+        VIGEM_TARGET_SET_STATE(target, previous);
+
+    return error;
+}
+
+VIGEM_ERROR vigem_target_detach_source(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (!VIGEM_TARGET_TRANSITION(target, VIGEM_TARGET_ATTACHED_SOURCE, VIGEM_TARGET_REMOVING))
+        return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
+
+    const auto error = vigem_internal_attach_source(vigem, target->SerialNo, target->Type, FALSE, 0);
+
+    target->SerialNo = 0;
+    VIGEM_TARGET_SET_STATE(target, VIGEM_TARGET_DISCONNECTED);
+
+    return error;
+}
+
+VIGEM_ERROR vigem_target_set_recording(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, BOOL enable, ULONG capacity)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (enable && capacity != 0
+        && (capacity < VIGEM_RECORDING_MIN_CAPACITY || capacity > VIGEM_RECORDING_MAX_CAPACITY))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_SET_RECORDING recording;
+    VIGEM_SET_RECORDING_INIT(&recording, target->SerialNo);
+
+    recording.Enable = enable ? TRUE : FALSE;
+    recording.Capacity = capacity;
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_SET_RECORDING,
+        &recording,
+        recording.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        if (error == ERROR_NO_SYSTEM_RESOURCES)
+            return VIGEM_ERROR_NO_FREE_SLOT;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_drain_recording(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    PVOID buffer,
+    ULONG length,
+    PULONG written,
+    PULONG dropped
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!buffer || !written || length == 0 || length > ULONG_MAX - sizeof(VIGEM_DRAIN_RECORDING))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    //
+    // The log data follows the header in the output buffer
+    // 
+    std::vector<UCHAR> transfer(sizeof(VIGEM_DRAIN_RECORDING) + length);
+    const auto drain = reinterpret_cast<PVIGEM_DRAIN_RECORDING>(transfer.data());
+
+    VIGEM_DRAIN_RECORDING_INIT(drain, target->SerialNo);
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_DRAIN_RECORDING,
+        drain,
+        drain->Size,
+        transfer.data(),
+        static_cast<DWORD>(transfer.size()),
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    memcpy(buffer, transfer.data() + sizeof(VIGEM_DRAIN_RECORDING), drain->Length);
+
+    *written = drain->Length;
+
+    if (dropped)
+        *dropped = drain->Dropped;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_set_raw_output(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, BOOL enable, ULONG capacity)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (enable && capacity != 0
+        && (capacity < VIGEM_RAW_OUTPUT_MIN_CAPACITY || capacity > VIGEM_RAW_OUTPUT_MAX_CAPACITY))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_SET_RAW_OUTPUT rawOutput;
+    VIGEM_SET_RAW_OUTPUT_INIT(&rawOutput, target->SerialNo);
+
+    rawOutput.Enable = enable ? TRUE : FALSE;
+    rawOutput.Capacity = capacity;
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_SET_RAW_OUTPUT,
+        &rawOutput,
+        rawOutput.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        if (error == ERROR_NO_SYSTEM_RESOURCES)
+            return VIGEM_ERROR_NO_FREE_SLOT;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_drain_raw_output(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    PVOID buffer,
+    ULONG length,
+    PULONG written,
+    PULONG dropped
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!buffer || !written || length == 0 || length > ULONG_MAX - sizeof(VIGEM_DRAIN_RAW_OUTPUT))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    //
+    // The records follow the header in the output buffer
+    // 
+    std::vector<UCHAR> transfer(sizeof(VIGEM_DRAIN_RAW_OUTPUT) + length);
+    const auto drain = reinterpret_cast<PVIGEM_DRAIN_RAW_OUTPUT>(transfer.data());
+
+    VIGEM_DRAIN_RAW_OUTPUT_INIT(drain, target->SerialNo);
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_DRAIN_RAW_OUTPUT,
+        drain,
+        drain->Size,
+        transfer.data(),
+        static_cast<DWORD>(transfer.size()),
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    memcpy(buffer, transfer.data() + sizeof(VIGEM_DRAIN_RAW_OUTPUT), drain->Length);
+
+    *written = drain->Length;
+
+    if (dropped)
+        *dropped = drain->Dropped;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_replay(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, const VOID* log, ULONG length, double speed)
+{
+    VIGEM_REPORT_LOG_STATE state;
+    LARGE_INTEGER frequency, start, now;
+
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!log || length < sizeof(VIGEM_REPORT_LOG_HEADER) || !(speed > 0.0))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    const auto bytes = static_cast<const UCHAR*>(log);
+    const auto header = static_cast<const VIGEM_REPORT_LOG_HEADER*>(log);
+
+    if (header->Magic != VIGEM_REPORT_LOG_MAGIC || header->Version != VIGEM_REPORT_LOG_VERSION)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    if (header->TargetType != target->Type)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    VIGEM_REPORT_LOG_STATE_INIT(&state, header->StartTime);
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    ULONG offset = sizeof(VIGEM_REPORT_LOG_HEADER);
+
+    while (offset < length)
+    {
+        VIGEM_REPORT_LOG_KIND kind;
+        ULONGLONG time;
+        const UCHAR* payload;
+        ULONG payloadLength;
+        VIGEM_ERROR error = VIGEM_ERROR_NONE;
+
+        const ULONG consumed = VIGEM_REPORT_LOG_DECODE(
+            &state,
+            &bytes[offset],
+            length - offset,
+            &kind,
+            &time,
+            &payload,
+            &payloadLength
+        );
+
+        if (consumed == 0)
+            return VIGEM_ERROR_INVALID_PARAMETER;
+
+        offset += consumed;
+
+        //
+        // Host notifications are only recorded for reference
+        // 
+        if (kind != VIGEM_REPORT_LOG_INPUT)
+            continue;
+
+        //
+        // Sleep most of the way, spin for the remainder to stay on time
+        // 
+        const auto due = static_cast<LONGLONG>(
+            static_cast<double>(time - header->StartTime) / speed * frequency.QuadPart / 10000000.0);
+
+        for (;;)
+        {
+            QueryPerformanceCounter(&now);
+
+            const auto remaining = due - (now.QuadPart - start.QuadPart);
+
+            if (remaining <= 0)
+                break;
+
+            const auto remainingMs = remaining * 1000 / frequency.QuadPart;
+
+            if (remainingMs > 2)
+                Sleep(static_cast<DWORD>(remainingMs - 1));
+            else
+                YieldProcessor();
+        }
+
+        if (target->Type == Xbox360Wired && payloadLength >= sizeof(XUSB_REPORT))
+        {
+            XUSB_REPORT report;
+            memcpy(&report, payload, sizeof(XUSB_REPORT));
+            error = vigem_target_x360_update(vigem, target, report);
+        }
+        else if (target->Type == DualShock4Wired && payloadLength >= sizeof(DS4_REPORT_EX))
+        {
+            DS4_REPORT_EX report;
+            memcpy(&report, payload, sizeof(DS4_REPORT_EX));
+            error = vigem_target_ds4_update_ex(vigem, target, report);
+        }
+        else if (target->Type == DualShock4Wired && payloadLength >= sizeof(DS4_REPORT))
+        {
+            DS4_REPORT report;
+            memcpy(&report, payload, sizeof(DS4_REPORT));
+            error = vigem_target_ds4_update(vigem, target, report);
+        }
+
+        if (!VIGEM_SUCCESS(error))
+            return error;
+    }
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_set_macro(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    UCHAR slot,
+    const VIGEM_MACRO_STEP* steps,
+    USHORT stepCount,
+    USHORT repeatCount
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (slot >= VIGEM_MACRO_MAX_SLOTS || stepCount > VIGEM_MACRO_MAX_STEPS || (stepCount && !steps))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    for (USHORT i = 0; i < stepCount; i++)
+    {
+        if (steps[i].DurationMs == 0 || steps[i].AxisMask >= (1 << VIGEM_AXIS_COUNT)
+            || steps[i].Axes[VIGEM_AXIS_TRIGGER_L] < 0 || steps[i].Axes[VIGEM_AXIS_TRIGGER_R] < 0)
+            return VIGEM_ERROR_INVALID_PARAMETER;
+    }
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_SET_MACRO macro;
+    VIGEM_SET_MACRO_INIT(&macro, target->SerialNo, slot);
+
+    macro.Enable = (stepCount > 0) ? TRUE : FALSE;
+    macro.RepeatCount = repeatCount;
+    macro.StepCount = stepCount;
+
+    if (stepCount)
+        memcpy(macro.Steps, steps, stepCount * sizeof(VIGEM_MACRO_STEP));
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_SET_MACRO,
+        &macro,
+        macro.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_set_session_qos(
+    PVIGEM_CLIENT vigem,
+    VIGEM_QOS_CLASS qosClass,
+    ULONG reportsPerSecond,
+    ULONG burst
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (qosClass < VIGEM_QOS_CLASS_INTERACTIVE || qosClass >= VIGEM_QOS_CLASS_COUNT)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_SET_SESSION_QOS qos;
+    VIGEM_SET_SESSION_QOS_INIT(&qos, qosClass);
+
+    qos.ReportsPerSecond = reportsPerSecond;
+    qos.Burst = burst;
+
+    //
+    // Targets may be placed on any of the buses
+    // 
+    for (ULONG bus = 0; bus < vigem->BusCount; bus++)
+    {
+        DeviceIoControl(
+            vigem->Buses[bus],
+            IOCTL_VIGEM_SET_SESSION_QOS,
+            &qos,
+            qos.Size,
+            nullptr,
+            0,
+            &transferred,
+            &lOverlapped
+        );
+
+        if (GetOverlappedResult(vigem->Buses[bus], &lOverlapped, &transferred, TRUE) == 0)
+        {
+            const auto error = GetLastError();
+
+            CloseHandle(lOverlapped.hEvent);
+
+            if (error == ERROR_INVALID_PARAMETER)
+                return VIGEM_ERROR_NOT_SUPPORTED;
+
+            return VIGEM_ERROR_BUS_ACCESS_FAILED;
+        }
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_get_urb_statistics(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PULONGLONG counts)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!counts)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_GET_STATISTICS statistics;
+    VIGEM_GET_STATISTICS_INIT(&statistics, target->SerialNo);
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_GET_STATISTICS,
+        &statistics,
+        statistics.Size,
+        &statistics,
+        statistics.Size,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    memcpy(counts, statistics.UrbCounts, sizeof(statistics.UrbCounts));
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_get_footprint(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVIGEM_TARGET_FOOTPRINT footprint)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!footprint)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_GET_FOOTPRINT request;
+    VIGEM_GET_FOOTPRINT_INIT(&request, target->SerialNo);
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_GET_FOOTPRINT,
+        &request,
+        request.Size,
+        &request,
+        request.Size,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    *footprint = request.Footprint;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_get_poll_phase(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVIGEM_POLL_PHASE phase)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!phase)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_GET_POLL_PHASE request;
+    VIGEM_GET_POLL_PHASE_INIT(&request, target->SerialNo);
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_GET_POLL_PHASE,
+        &request,
+        request.Size,
+        &request,
+        request.Size,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    *phase = request.Phase;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_get_plugin_timeline(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVIGEM_PLUGIN_TIMELINE timeline)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || VIGEM_TARGET_GET_STATE(target) != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (!timeline)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_GET_PLUGIN_TIMELINE request;
+    VIGEM_GET_PLUGIN_TIMELINE_INIT(&request, target->SerialNo);
+
+    DeviceIoControl(
+        VIGEM_TARGET_BUS(vigem, target),
+        IOCTL_VIGEM_GET_PLUGIN_TIMELINE,
+        &request,
+        request.Size,
+        &request,
+        request.Size,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(VIGEM_TARGET_BUS(vigem, target), &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_INVALID_TARGET;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    *timeline = request.Timeline;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_set_event_trace(PVIGEM_CLIENT vigem, BOOL enable, ULONG capacity)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (enable && capacity == 0)
+        capacity = VIGEM_EVENT_TRACE_DEFAULT_CAPACITY;
+
+    if (enable && (capacity < VIGEM_EVENT_TRACE_MIN_CAPACITY || capacity > VIGEM_EVENT_TRACE_MAX_CAPACITY
+        || (capacity & (capacity - 1)) != 0))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_SET_EVENT_TRACE trace;
+    VIGEM_SET_EVENT_TRACE_INIT(&trace, enable ? TRUE : FALSE, capacity);
+
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_SET_EVENT_TRACE,
+        &trace,
+        trace.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_drain_events(
+    PVIGEM_CLIENT vigem,
+    PVOID records,
+    ULONG count,
+    PULONG drained,
+    PULONGLONG dropped,
+    PULONGLONG frequency
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (!records || !drained || count == 0
+        || count > (ULONG_MAX - sizeof(VIGEM_DRAIN_EVENTS)) / sizeof(VIGEM_EVENT_RECORD))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    //
+    // The records follow the header in the output buffer
+    // 
+    std::vector<UCHAR> transfer(sizeof(VIGEM_DRAIN_EVENTS) + count * sizeof(VIGEM_EVENT_RECORD));
+    const auto drain = reinterpret_cast<PVIGEM_DRAIN_EVENTS>(transfer.data());
+
+    VIGEM_DRAIN_EVENTS_INIT(drain);
+
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_DRAIN_EVENTS,
+        drain,
+        drain->Size,
+        transfer.data(),
+        static_cast<DWORD>(transfer.size()),
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    memcpy(records, transfer.data() + sizeof(VIGEM_DRAIN_EVENTS), drain->Count * sizeof(VIGEM_EVENT_RECORD));
+
+    *drained = drain->Count;
+
+    if (dropped)
+        *dropped = drain->Dropped;
+
+    if (frequency)
+        *frequency = drain->Frequency;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_set_target_pool(PVIGEM_CLIENT vigem, VIGEM_TARGET_TYPE type, ULONG depth)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if ((type != Xbox360Wired && type != DualShock4Wired) || depth > VIGEM_TARGET_POOL_MAX_DEPTH)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    if (!VIGEM_BUS_MAY_USE(vigem, VIGEM_BUS_FEATURE_TARGET_POOL))
+        return VIGEM_ERROR_NOT_SUPPORTED;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    VIGEM_SET_TARGET_POOL pool;
+    VIGEM_SET_TARGET_POOL_INIT(&pool, type, depth);
+
+    //
+    // Targets may be placed on any of the buses
+    // 
+    for (ULONG bus = 0; bus < vigem->BusCount; bus++)
+    {
+        DeviceIoControl(
+            vigem->Buses[bus],
+            IOCTL_VIGEM_SET_TARGET_POOL,
+            &pool,
+            pool.Size,
+            nullptr,
+            0,
+            &transferred,
+            &lOverlapped
+        );
+
+        if (GetOverlappedResult(vigem->Buses[bus], &lOverlapped, &transferred, TRUE) == 0)
+        {
+            const auto error = GetLastError();
+
+            CloseHandle(lOverlapped.hEvent);
+
+            if (error == ERROR_INVALID_PARAMETER)
+                return VIGEM_ERROR_NOT_SUPPORTED;
+
+            return VIGEM_ERROR_BUS_ACCESS_FAILED;
+        }
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_get_capabilities(PVIGEM_CLIENT vigem, PVIGEM_BUS_CAPABILITIES capabilities)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (!capabilities)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    if (vigem->Capabilities.Size == 0)
+        return VIGEM_ERROR_NOT_SUPPORTED;
+
+    *capabilities = vigem->Capabilities;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_set_bus_placement(PVIGEM_CLIENT vigem, VIGEM_BUS_PLACEMENT placement)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (placement < VIGEM_BUS_PLACEMENT_FIRST || placement > VIGEM_BUS_PLACEMENT_LEAST_LOADED)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    vigem->Placement = placement;
+
+    return VIGEM_ERROR_NONE;
+}
+
+ULONG vigem_get_bus_count(PVIGEM_CLIENT vigem)
+{
+    return vigem ? vigem->BusCount : 0;
+}
+
+ULONG vigem_target_get_bus_index(PVIGEM_TARGET target)
+{
+    return target->BusIndex;
+}
+
+VIGEM_ERROR vigem_register_bus_notification(
+    PVIGEM_CLIENT vigem,
+    PFN_VIGEM_BUS_NOTIFICATION notification,
+    LPVOID userData
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (notification == nullptr)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    AcquireSRWLockExclusive(&vigem->BusNotificationLock);
+
+    if (vigem->BusNotification != nullptr)
+    {
+        ReleaseSRWLockExclusive(&vigem->BusNotificationLock);
+        return VIGEM_ERROR_CALLBACK_ALREADY_REGISTERED;
+    }
+
+    //
+    // Set before the watch starts, the first report may arrive right away
+    // 
+    vigem->BusNotification = reinterpret_cast<FARPROC>(notification);
+    vigem->BusNotificationUserData = userData;
+
+    ReleaseSRWLockExclusive(&vigem->BusNotificationLock);
+
+    const auto error = vigem_internal_discovery->Watch(vigem);
+
+    if (!VIGEM_SUCCESS(error))
+    {
+        AcquireSRWLockExclusive(&vigem->BusNotificationLock);
+        vigem->BusNotification = nullptr;
+        vigem->BusNotificationUserData = nullptr;
+        ReleaseSRWLockExclusive(&vigem->BusNotificationLock);
+        return error;
+    }
+
+    InterlockedIncrement(&vigem_internal_bus_cache.Watches);
+
+    return VIGEM_ERROR_NONE;
+}
+
+void vigem_unregister_bus_notification(PVIGEM_CLIENT vigem)
+{
+    if (!vigem)
+        return;
+
+    AcquireSRWLockShared(&vigem->BusNotificationLock);
+    const bool registered = (vigem->BusNotification != nullptr);
+    ReleaseSRWLockShared(&vigem->BusNotificationLock);
+
+    if (!registered)
+        return;
+
+    // No report is in progress once this returns, reports take the lock
+    vigem_internal_discovery->Unwatch(vigem);
+
+    InterlockedDecrement(&vigem_internal_bus_cache.Watches);
+
+    AcquireSRWLockExclusive(&vigem->BusNotificationLock);
+    vigem->BusNotification = nullptr;
+    vigem->BusNotificationUserData = nullptr;
+    ReleaseSRWLockExclusive(&vigem->BusNotificationLock);
+}
@@ -0,0 +1,215 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "AxisTransform.hpp"
+
+
+NTSTATUS ViGEm::Bus::Core::AxisTransform::Load(const VIGEM_AXIS_PROFILE* Profiles)
+{
+	//
+	// Validate everything before touching the active tables
+	// 
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+	{
+		const VIGEM_AXIS_PROFILE* profile = &Profiles[axis];
+
+		if (profile->Source >= VIGEM_AXIS_COUNT
+			|| (profile->Flags & ~VIGEM_AXIS_FLAG_INVERT)
+			|| profile->Deadzone >= VIGEM_AXIS_MAX)
+		{
+			return STATUS_INVALID_PARAMETER;
+		}
+
+		for (ULONG point = 0; point < VIGEM_AXIS_CURVE_POINTS; point++)
+		{
+			if (profile->Curve[point] > VIGEM_AXIS_MAX
+				|| (point > 0 && profile->Curve[point] < profile->Curve[point - 1]))
+			{
+				return STATUS_INVALID_PARAMETER;
+			}
+		}
+	}
+
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+	{
+		const VIGEM_AXIS_PROFILE* profile = &Profiles[axis];
+
+		this->_Source[axis] = profile->Source;
+		this->_Direction[axis] = (profile->Flags & VIGEM_AXIS_FLAG_INVERT) ? -1 : 1;
+		this->_Deadzone[axis] = profile->Deadzone;
+
+		//
+		// Round up so full deflection always reaches the last curve point
+		// 
+		const LONGLONG range = VIGEM_AXIS_MAX - profile->Deadzone;
+		this->_Scale[axis] = ((static_cast<LONGLONG>(CURVE_FULL_SCALE) << SCALE_SHIFT) + range - 1) / range;
+
+		for (ULONG point = 0; point < VIGEM_AXIS_CURVE_POINTS; point++)
+		{
+			this->_Curve[axis][point] = profile->Curve[point];
+		}
+
+		this->_Curve[axis][VIGEM_AXIS_CURVE_POINTS] = profile->Curve[VIGEM_AXIS_CURVE_POINTS - 1];
+	}
+
+	this->_Enabled = true;
+
+	return STATUS_SUCCESS;
+}
+
+void ViGEm::Bus::Core::AxisTransform::Reset()
+{
+	this->_Enabled = false;
+}
+
+void ViGEm::Bus::Core::AxisTransform::Apply(LONG (&Axes)[VIGEM_AXIS_COUNT]) const
+{
+	LONG input[VIGEM_AXIS_COUNT];
+
+	//
+	// Gather first so remapped axes read the original values
+	// 
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+	{
+		input[axis] = Axes[this->_Source[axis]];
+	}
+
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+	{
+		const LONG sign = (input[axis] < 0) ? -1 : 1;
+
+		LONG magnitude = input[axis] * sign;
+
+		magnitude = (magnitude > VIGEM_AXIS_MAX) ? VIGEM_AXIS_MAX : magnitude;
+		magnitude -= this->_Deadzone[axis];
+		magnitude = (magnitude < 0) ? 0 : magnitude;
+		magnitude = static_cast<LONG>((magnitude * this->_Scale[axis]) >> SCALE_SHIFT);
+		magnitude = (magnitude > CURVE_FULL_SCALE) ? CURVE_FULL_SCALE : magnitude;
+
+		//
+		// Piecewise linear interpolation between two curve points
+		// 
+		const LONG segment = magnitude >> CURVE_SEGMENT_SHIFT;
+		const LONG fraction = magnitude & CURVE_SEGMENT_MASK;
+		const LONG low = this->_Curve[axis][segment];
+		const LONG high = this->_Curve[axis][segment + 1];
+
+		const LONG value = low + (((high - low) * fraction + (1 << (CURVE_SEGMENT_SHIFT - 1))) >> CURVE_SEGMENT_SHIFT);
+
+		Axes[axis] = value * sign * this->_Direction[axis];
+	}
+}
+
+#pragma region Report conversion
+
+//
+// Triggers only use the positive half of the normalized range
+// 
+static BYTE TriggerFromAxis(LONG Value)
+{
+	Value = (Value * 0xFF + VIGEM_AXIS_MAX / 2) / VIGEM_AXIS_MAX;
+
+	return static_cast<BYTE>((Value < 0) ? 0 : ((Value > 0xFF) ? 0xFF : Value));
+}
+
+static LONG TriggerToAxis(BYTE Value)
+{
+	return (static_cast<LONG>(Value) << 7) | (Value >> 1);
+}
+
+static SHORT ThumbFromAxis(LONG Value)
+{
+	Value = (Value < -VIGEM_AXIS_MAX - 1) ? -VIGEM_AXIS_MAX - 1 : Value;
+	Value = (Value > VIGEM_AXIS_MAX) ? VIGEM_AXIS_MAX : Value;
+
+	return static_cast<SHORT>(Value);
+}
+
+//
+// DualShock 4 sticks are unsigned bytes centered at 0x80
+// 
+static BYTE Ds4ThumbFromAxis(LONG Value)
+{
+	Value = ((ThumbFromAxis(Value) + 0x80) >> 8) + 0x80;
+
+	return static_cast<BYTE>((Value > 0xFF) ? 0xFF : Value);
+}
+
+static LONG Ds4ThumbToAxis(BYTE Value)
+{
+	return (static_cast<LONG>(Value) - 0x80) * 0x100;
+}
+
+void ViGEm::Bus::Core::AxisTransform::FromXusbReport(const XUSB_REPORT* Report, LONG (&Axes)[VIGEM_AXIS_COUNT])
+{
+	Axes[VIGEM_AXIS_THUMB_LX] = Report->sThumbLX;
+	Axes[VIGEM_AXIS_THUMB_LY] = Report->sThumbLY;
+	Axes[VIGEM_AXIS_THUMB_RX] = Report->sThumbRX;
+	Axes[VIGEM_AXIS_THUMB_RY] = Report->sThumbRY;
+	Axes[VIGEM_AXIS_TRIGGER_L] = TriggerToAxis(Report->bLeftTrigger);
+	Axes[VIGEM_AXIS_TRIGGER_R] = TriggerToAxis(Report->bRightTrigger);
+}
+
+void ViGEm::Bus::Core::AxisTransform::ToXusbReport(const LONG (&Axes)[VIGEM_AXIS_COUNT], PXUSB_REPORT Report)
+{
+	Report->sThumbLX = ThumbFromAxis(Axes[VIGEM_AXIS_THUMB_LX]);
+	Report->sThumbLY = ThumbFromAxis(Axes[VIGEM_AXIS_THUMB_LY]);
+	Report->sThumbRX = ThumbFromAxis(Axes[VIGEM_AXIS_THUMB_RX]);
+	Report->sThumbRY = ThumbFromAxis(Axes[VIGEM_AXIS_THUMB_RY]);
+	Report->bLeftTrigger = TriggerFromAxis(Axes[VIGEM_AXIS_TRIGGER_L]);
+	Report->bRightTrigger = TriggerFromAxis(Axes[VIGEM_AXIS_TRIGGER_R]);
+}
+
+void ViGEm::Bus::Core::AxisTransform::FromDs4Report(const DS4_REPORT* Report, LONG (&Axes)[VIGEM_AXIS_COUNT])
+{
+	Axes[VIGEM_AXIS_THUMB_LX] = Ds4ThumbToAxis(Report->bThumbLX);
+	Axes[VIGEM_AXIS_THUMB_LY] = Ds4ThumbToAxis(Report->bThumbLY);
+	Axes[VIGEM_AXIS_THUMB_RX] = Ds4ThumbToAxis(Report->bThumbRX);
+	Axes[VIGEM_AXIS_THUMB_RY] = Ds4ThumbToAxis(Report->bThumbRY);
+	Axes[VIGEM_AXIS_TRIGGER_L] = TriggerToAxis(Report->bTriggerL);
+	Axes[VIGEM_AXIS_TRIGGER_R] = TriggerToAxis(Report->bTriggerR);
+}
+
+void ViGEm::Bus::Core::AxisTransform::ToDs4Report(const LONG (&Axes)[VIGEM_AXIS_COUNT], PDS4_REPORT Report)
+{
+	Report->bThumbLX = Ds4ThumbFromAxis(Axes[VIGEM_AXIS_THUMB_LX]);
+	Report->bThumbLY = Ds4ThumbFromAxis(Axes[VIGEM_AXIS_THUMB_LY]);
+	Report->bThumbRX = Ds4ThumbFromAxis(Axes[VIGEM_AXIS_THUMB_RX]);
+	Report->bThumbRY = Ds4ThumbFromAxis(Axes[VIGEM_AXIS_THUMB_RY]);
+	Report->bTriggerL = TriggerFromAxis(Axes[VIGEM_AXIS_TRIGGER_L]);
+	Report->bTriggerR = TriggerFromAxis(Axes[VIGEM_AXIS_TRIGGER_R]);
+}
+
+#pragma endregion
@@ -0,0 +1,112 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+#include <ViGEm/Common.h>
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Applies per-axis deadzones, response curves, inversion and remapping
+	// to a report using fixed-point math only.
+	// 
+	// Axis values are normalized to the signed 16-bit range (triggers only
+	// use the positive half). The component has no WDF dependencies.
+	// 
+	class AxisTransform
+	{
+	public:
+		AxisTransform() = default;
+
+		//
+		// Validates and precomputes VIGEM_AXIS_COUNT profiles. On failure
+		// the previously loaded tables remain untouched.
+		// 
+		NTSTATUS Load(const VIGEM_AXIS_PROFILE* Profiles);
+
+		void Reset();
+
+		bool IsEnabled() const { return this->_Enabled; }
+
+		void Apply(LONG (&Axes)[VIGEM_AXIS_COUNT]) const;
+
+		static void FromXusbReport(const XUSB_REPORT* Report, LONG (&Axes)[VIGEM_AXIS_COUNT]);
+
+		static void ToXusbReport(const LONG (&Axes)[VIGEM_AXIS_COUNT], PXUSB_REPORT Report);
+
+		static void FromDs4Report(const DS4_REPORT* Report, LONG (&Axes)[VIGEM_AXIS_COUNT]);
+
+		static void ToDs4Report(const LONG (&Axes)[VIGEM_AXIS_COUNT], PDS4_REPORT Report);
+
+	private:
+		//
+		// Normalized magnitudes are scaled to [0, 2^15] so the last curve
+		// segment gets hit exactly at full deflection.
+		// 
+		static const LONG CURVE_SEGMENT_SHIFT = 11;
+
+		static const LONG CURVE_SEGMENT_MASK = (1 << CURVE_SEGMENT_SHIFT) - 1;
+
+		static const LONG CURVE_FULL_SCALE = 1 << 15;
+
+		static const LONG SCALE_SHIFT = 16;
+
+		//
+		// Tables are kept as structure of arrays to keep the per-axis
+		// loop free of data dependent branches
+		// 
+
+		ULONG _Source[VIGEM_AXIS_COUNT]{};
+
+		LONG _Direction[VIGEM_AXIS_COUNT]{};
+
+		LONG _Deadzone[VIGEM_AXIS_COUNT]{};
+
+		//
+		// Q16 factor stretching [Deadzone, MAX] to [0, CURVE_FULL_SCALE]
+		// 
+		LONGLONG _Scale[VIGEM_AXIS_COUNT]{};
+
+		//
+		// Curve points plus a duplicated last point for full deflection
+		// 
+		LONG _Curve[VIGEM_AXIS_COUNT][VIGEM_AXIS_CURVE_POINTS + 1]{};
+
+		bool _Enabled{};
+	};
+}
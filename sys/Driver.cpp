@@ -42,8 +42,11 @@
 #pragma alloc_text (INIT, DriverEntry)
 #pragma alloc_text (PAGE, Bus_EvtDeviceAdd)
 #pragma alloc_text (PAGE, Bus_DeviceFileCreate)
+#pragma alloc_text (PAGE, Bus_IsPrivilegedOpen)
 #pragma alloc_text (PAGE, Bus_FileClose)
 #pragma alloc_text (PAGE, Bus_EvtDriverContextCleanup)
+#pragma alloc_text (PAGE, Bus_EvtDeviceContextCleanup)
+#pragma alloc_text (PAGE, Bus_EvtIdentityTimerFunc)
 #endif
 
 #include "Queue.hpp"
@@ -116,6 +119,8 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
     WDF_FILEOBJECT_CONFIG       foConfig;
     WDF_OBJECT_ATTRIBUTES       fdoAttributes;
     WDF_OBJECT_ATTRIBUTES       fileHandleAttributes;
+    WDF_TIMER_CONFIG            timerConfig;
+    WDF_OBJECT_ATTRIBUTES       timerAttributes;
     PFDO_DEVICE_DATA            pFDOData;
     PWSTR                       pSymbolicNameList;
 
@@ -176,6 +181,7 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
     WDF_CHILD_LIST_CONFIG_INIT(&config, sizeof(PDO_IDENTIFICATION_DESCRIPTION), Bus_EvtDeviceListCreatePdo);
 
     config.EvtChildListIdentificationDescriptionCompare = EmulationTargetPDO::EvtChildListIdentificationDescriptionCompare;
+    config.EvtChildListIdentificationDescriptionCleanup = EmulationTargetPDO::EvtChildListIdentificationDescriptionCleanup;
 
     WdfFdoInitSetDefaultChildListConfig(DeviceInit, &config, WDF_NO_OBJECT_ATTRIBUTES);
 
@@ -194,6 +200,7 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
 #pragma region Create FDO
 
     WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&fdoAttributes, FDO_DEVICE_DATA);
+    fdoAttributes.EvtCleanupCallback = Bus_EvtDeviceContextCleanup;
 
     status = WdfDeviceCreate(&DeviceInit, &fdoAttributes, &device);
 
@@ -218,6 +225,116 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
     pFDOData->InterfaceReferenceCounter = 0;
     pFDOData->NextSessionId = FDO_FIRST_SESSION_ID;
 
+    ExInitializeFastMutex(&pFDOData->SessionTargetLock);
+    pFDOData->Serials.Initialize();
+    pFDOData->Pool.Initialize();
+    pFDOData->Identities.Initialize();
+
+    status = pFDOData->Events.Initialize();
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR,
+            TRACE_DRIVER,
+            "EventTrace::Initialize failed with status %!STATUS!",
+            status);
+        return status;
+    }
+
+#pragma endregion
+
+#pragma region Create macro timer
+
+    KeInitializeSpinLock(&pFDOData->MacroLock);
+
+    //
+    // One-shot, re-armed by the callback only while macros are running
+    // 
+    WDF_TIMER_CONFIG_INIT(&timerConfig, Bus_EvtMacroTimerFunc);
+    timerConfig.UseHighResolutionTimer = WdfTrue;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+    timerAttributes.ParentObject = device;
+
+    status = WdfTimerCreate(&timerConfig, &timerAttributes, &pFDOData->MacroTimer);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR,
+            TRACE_DRIVER,
+            "WdfTimerCreate failed with status %!STATUS!",
+            status);
+        return status;
+    }
+
+#pragma endregion
+
+#pragma region Create DualShock 4 tick
+
+    KeInitializeSpinLock(&pFDOData->Ds4TickLock);
+
+    //
+    // One-shot, re-armed by the callback only while requests are waiting
+    // 
+    WDF_TIMER_CONFIG_INIT(&timerConfig, Bus_EvtDs4TickFunc);
+    timerConfig.TolerableDelay = Bus_QueryDs4TickTolerance();
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+    timerAttributes.ParentObject = device;
+
+    status = WdfTimerCreate(&timerConfig, &timerAttributes, &pFDOData->Ds4TickTimer);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR,
+            TRACE_DRIVER,
+            "WdfTimerCreate failed with status %!STATUS!",
+            status);
+        return status;
+    }
+
+    //
+    // Idle targets leave the tick until their next report
+    // 
+    pFDOData->IdleTimeout = static_cast<ULONGLONG>(Bus_QueryIdleTimeout()) * 10000;
+
+#pragma endregion
+
+#pragma region Load DualShock 4 identities
+
+    //
+    // One-shot at PASSIVE_LEVEL, registry writes happen in the callback
+    // 
+    WDF_TIMER_CONFIG_INIT(&timerConfig, Bus_EvtIdentityTimerFunc);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+    timerAttributes.ParentObject = device;
+    timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+    status = WdfTimerCreate(&timerConfig, &timerAttributes, &pFDOData->IdentityTimer);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR,
+            TRACE_DRIVER,
+            "WdfTimerCreate failed with status %!STATUS!",
+            status);
+        return status;
+    }
+
+    //
+    // Not fatal, targets get new identities if the stored ones are unavailable
+    // 
+    status = Bus_LoadIdentities(device);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING,
+            TRACE_DRIVER,
+            "Bus_LoadIdentities failed with status %!STATUS!",
+            status);
+    }
+
 #pragma endregion
 
 #pragma region Create default I/O queue for FDO
@@ -271,6 +388,38 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
     return status;
 }
 
+//
+// Whether the create request comes from kernel-mode or from a caller with
+// an administrator token.
+// 
+_Use_decl_annotations_
+BOOLEAN
+Bus_IsPrivilegedOpen(
+    WDFREQUEST Request
+)
+{
+    const PIRP irp = WdfRequestWdmGetIrp(Request);
+
+    PAGED_CODE();
+
+    if (irp->RequestorMode == KernelMode)
+        return TRUE;
+
+    const PIO_SECURITY_CONTEXT securityContext =
+        IoGetCurrentIrpStackLocation(irp)->Parameters.Create.SecurityContext;
+
+    if (securityContext == NULL || securityContext->AccessState == NULL)
+        return FALSE;
+
+    const PSECURITY_SUBJECT_CONTEXT subjectContext = &securityContext->AccessState->SubjectSecurityContext;
+
+    SeLockSubjectContext(subjectContext);
+    const BOOLEAN isAdmin = SeTokenIsAdmin(SeQuerySubjectContextToken(subjectContext));
+    SeUnlockSubjectContext(subjectContext);
+
+    return isAdmin;
+}
+
 // Gets called when the user-land process (or kernel driver) exits or closes the handle,
 // and all IO has completed.
 // 
@@ -288,8 +437,6 @@ Bus_DeviceFileCreate(
     LONG             refCount = 0;
     LONG             sessionId = 0;
 
-    UNREFERENCED_PARAMETER(Request);
-
     PAGED_CODE();
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
@@ -319,6 +466,15 @@ Bus_DeviceFileCreate(
             sessionId = InterlockedIncrement(&pFDOData->NextSessionId);
 
             pFileData->SessionId = sessionId;
+
+            pFileData->Privileged = Bus_IsPrivilegedOpen(Request);
+
+            pFileData->Targets.Initialize();
+
+            KeInitializeSpinLock(&pFileData->QosLock);
+            // Unlimited until the session asks for a class
+            Bus_SetSessionQos(pFileData, VIGEM_QOS_CLASS_INTERACTIVE, 0, 0);
+
             status = STATUS_SUCCESS;
 
             TraceEvents(TRACE_LEVEL_INFORMATION,
@@ -389,6 +545,22 @@ Bus_FileClose(
             (int)refCount);
     }
 
+    //
+    // Unplug devices owned by this session
+    // 
+    Bus_UnPlugSessionDevices(device, pFileData);
+
+    //
+    // Sessions feeding devices they don't own only get detached. This
+    // needs a walk of all children, so it's limited to sessions that
+    // ever attached as a source.
+    // 
+    if (!pFileData->HasAttachedSources)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Exit");
+        return;
+    }
+
     list = WdfFdoGetDefaultChildList(device);
 
     WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
@@ -406,35 +578,10 @@ Bus_FileClose(
             break;
         }
 
-        //TraceEvents(TRACE_LEVEL_VERBOSE,
-        //    TRACE_DRIVER,
-        //    "PDO properties: status = %!STATUS!, pdoPID = %d, curPID = %d, pdoSID = %d, curSID = %d, internal = %d",
-        //    (int)childInfo.Status,
-        //    (int)description.OwnerProcessId,
-        //    (int)CURRENT_PROCESS_ID(),
-        //    (int)description.SessionId,
-        //    (int)pFileData->SessionId,
-        //    (int)description.OwnerIsDriver
-        //);
-
-        // Only unplug devices with matching session id
         if (childInfo.Status == WdfChildListRetrieveDeviceSuccess
-            && description.SessionId == pFileData->SessionId)
+            && description.SessionId != pFileData->SessionId)
         {
-            TraceEvents(TRACE_LEVEL_INFORMATION,
-                TRACE_DRIVER,
-                "Unplugging device with serial %d",
-                description.SerialNo);
-
-            // "Unplug" child
-            status = WdfChildListUpdateChildDescriptionAsMissing(list, &description.Header);
-            if (!NT_SUCCESS(status))
-            {
-                TraceEvents(TRACE_LEVEL_ERROR,
-                    TRACE_DRIVER,
-                    "WdfChildListUpdateChildDescriptionAsMissing failed with status %!STATUS!",
-                    status);
-            }
+            (void)description.Target->AttachSource(pFileData->SessionId, FALSE, 0);
         }
     }
 
@@ -443,6 +590,111 @@ Bus_FileClose(
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Exit with status %!STATUS!", status);
 }
 
+//
+// Sets the scheduling class and rate limit of a session, 0 selects the
+// class defaults.
+// 
+_Use_decl_annotations_
+VOID
+Bus_SetSessionQos(
+    PFDO_FILE_DATA FileData,
+    VIGEM_QOS_CLASS Class,
+    ULONG ReportsPerSecond,
+    ULONG Burst
+)
+{
+    KIRQL irql;
+
+    switch (Class)
+    {
+    case VIGEM_QOS_CLASS_NORMAL:
+        ReportsPerSecond = ReportsPerSecond ? ReportsPerSecond : VIGEM_QOS_NORMAL_RATE;
+        Burst = Burst ? Burst : VIGEM_QOS_NORMAL_BURST;
+        break;
+    case VIGEM_QOS_CLASS_BACKGROUND:
+        ReportsPerSecond = ReportsPerSecond ? ReportsPerSecond : VIGEM_QOS_BACKGROUND_RATE;
+        Burst = Burst ? Burst : VIGEM_QOS_BACKGROUND_BURST;
+        break;
+    default:
+        ReportsPerSecond = 0;
+        break;
+    }
+
+    KeAcquireSpinLock(&FileData->QosLock, &irql);
+
+    FileData->QosClass = Class;
+    FileData->Qos.Configure(ReportsPerSecond, Burst);
+
+    KeReleaseSpinLock(&FileData->QosLock, irql);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION,
+        TRACE_DRIVER,
+        "Session %d uses QoS class %d (%d reports/s, burst %d)",
+        FileData->SessionId,
+        Class,
+        ReportsPerSecond,
+        Burst);
+}
+
+//
+// Advances the macros of all targets and pushes changed overlays.
+// 
+_Use_decl_annotations_
+VOID
+Bus_EvtMacroTimerFunc(
+    _In_ WDFTIMER Timer
+)
+{
+    const WDFDEVICE device = static_cast<WDFDEVICE>(WdfTimerGetParentObject(Timer));
+
+    if (EmulationTargetPDO::ServiceMacroTick(device))
+        WdfTimerStart(Timer, WDF_REL_TIMEOUT_IN_MS(FDO_MACRO_TICK_MS));
+}
+
+//
+// Completes the waiting interrupt IN requests of all DualShock 4 targets.
+// 
+_Use_decl_annotations_
+VOID
+Bus_EvtDs4TickFunc(
+    _In_ WDFTIMER Timer
+)
+{
+    const WDFDEVICE device = static_cast<WDFDEVICE>(WdfTimerGetParentObject(Timer));
+
+    if (EmulationTargetDS4::ServiceBusTick(device))
+        WdfTimerStart(Timer, WDF_REL_TIMEOUT_IN_MS(FDO_DS4_TICK_MS));
+}
+
+//
+// Persists the DualShock 4 identities added since the timer got started.
+// 
+_Use_decl_annotations_
+VOID
+Bus_EvtIdentityTimerFunc(
+    _In_ WDFTIMER Timer
+)
+{
+    const WDFDEVICE device = static_cast<WDFDEVICE>(WdfTimerGetParentObject(Timer));
+
+    PAGED_CODE();
+
+    //
+    // Cleared first, identities added while writing schedule another flush
+    // 
+    InterlockedExchange(&FdoGetData(device)->IdentityFlushPending, FALSE);
+
+    const NTSTATUS status = Bus_PersistIdentities(device);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR,
+            TRACE_DRIVER,
+            "Bus_PersistIdentities failed with status %!STATUS!",
+            status);
+    }
+}
+
 VOID
 Bus_EvtDriverContextCleanup(
     _In_ WDFOBJECT DriverObject
@@ -475,4 +727,30 @@ Return Value:
 
 }
 
+//
+// Frees resources of the bus FDO once all children are gone.
+// 
+_Use_decl_annotations_
+VOID
+Bus_EvtDeviceContextCleanup(
+    WDFOBJECT Device
+)
+{
+    PAGED_CODE();
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
+
+    //
+    // Don't lose identities still waiting for the timer
+    // 
+    (void)Bus_PersistIdentities(static_cast<WDFDEVICE>(Device));
+
+    FdoGetData(Device)->Events.Cleanup();
+    FdoGetData(Device)->Serials.Cleanup();
+    FdoGetData(Device)->Identities.Cleanup();
+    FdoGetData(Device)->Ds4Tick.Cleanup();
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Exit");
+}
+
 EXTERN_C_END
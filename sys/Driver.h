@@ -43,6 +43,15 @@
 #define NTSTRSAFE_LIB
 #include <ntstrsafe.h>
 
+#include "MacroScheduler.hpp"
+#include "TokenBucket.hpp"
+#include "SessionTargetList.hpp"
+#include "EventTrace.hpp"
+#include "SerialTable.hpp"
+#include "TargetPool.hpp"
+#include "IdentityTable.hpp"
+#include "TickSet.hpp"
+
 
 #pragma region Macros
 
@@ -65,10 +74,126 @@ typedef struct _FDO_DEVICE_DATA
     // 
     LONG NextSessionId;
 
+    //
+    // Macros running on all targets of this bus
+    // 
+    ViGEm::Bus::Core::MacroScheduler Macros;
+
+    //
+    // Protects Macros
+    // 
+    KSPIN_LOCK MacroLock;
+
+    //
+    // Advances Macros while any macro is running
+    // 
+    WDFTIMER MacroTimer;
+
+    //
+    // Protects the target lists of all sessions and the links of all targets
+    // 
+    FAST_MUTEX SessionTargetLock;
+
+    //
+    // Binary event trace of this bus and its targets
+    // 
+    ViGEm::Bus::Core::EventTrace Events;
+
+    //
+    // Serials of the targets on this bus, maps them to their targets
+    // 
+    ViGEm::Bus::Core::SerialTable Serials;
+
+    //
+    // Pre-created targets waiting to be claimed, protected by SessionTargetLock
+    // 
+    ViGEm::Bus::Core::TargetPool Pool;
+
+    //
+    // Persisted DualShock 4 addresses, loaded once when the bus is added
+    // 
+    ViGEm::Bus::Core::IdentityTable Identities;
+
+    //
+    // Writes Identities behind plug-ins that added to it
+    // 
+    WDFTIMER IdentityTimer;
+
+    //
+    // Set while IdentityTimer is due
+    // 
+    LONG IdentityFlushPending;
+
+    //
+    // DualShock 4 targets with interrupt IN requests waiting for a report
+    // 
+    ViGEm::Bus::Core::TickSet Ds4Tick;
+
+    //
+    // Protects Ds4Tick
+    // 
+    KSPIN_LOCK Ds4TickLock;
+
+    //
+    // Number of the current Ds4Tick pass, targets remember the last one serving them
+    // 
+    ULONG Ds4TickGeneration;
+
+    //
+    // Services Ds4Tick while it has members
+    // 
+    WDFTIMER Ds4TickTimer;
+
+    //
+    // 100ns units without reports or output traffic after which targets
+    // park their periodic work, 0 if disabled
+    // 
+    ULONGLONG IdleTimeout;
+
 } FDO_DEVICE_DATA, * PFDO_DEVICE_DATA;
 
 #define FDO_FIRST_SESSION_ID 100
 
+//
+// Session of idle pooled targets, never assigned to a file handle
+// 
+#define FDO_POOL_SESSION_ID 0
+
+//
+// Number of targets unplugged per acquisition of SessionTargetLock
+// 
+#define FDO_UNPLUG_BATCH_SIZE 32
+
+//
+// Interval of the macro timer in milliseconds (one scheduler tick)
+// 
+#define FDO_MACRO_TICK_MS 1
+
+//
+// Delay in milliseconds before new identities get persisted, batches
+// plug-ins in quick succession into one registry write
+// 
+#define FDO_IDENTITY_FLUSH_DELAY_MS 2000
+
+//
+// Interval of the DualShock 4 tick in milliseconds, the longest a pending
+// interrupt IN request waits for a report
+// 
+#define FDO_DS4_TICK_MS 5
+
+//
+// Default of the Ds4TickTolerance parameter, milliseconds the DualShock 4
+// tick may be delayed to coalesce with other timers
+// 
+#define FDO_DS4_TICK_TOLERANCE_MS 1
+
+//
+// Default of the IdleTimeout parameter, milliseconds without reports or
+// output traffic before a target parks its periodic work. Parking is off
+// unless the parameter is set.
+// 
+#define FDO_IDLE_TIMEOUT_MS 0
+
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FDO_DEVICE_DATA, FdoGetData)
 
 // 
@@ -81,6 +206,37 @@ typedef struct _FDO_FILE_DATA
     // 
     LONG SessionId;
 
+    //
+    // Scheduling class of reports submitted through this handle
+    // 
+    VIGEM_QOS_CLASS QosClass;
+
+    //
+    // Rate limit of reports submitted through this handle
+    // 
+    ViGEm::Bus::Core::TokenBucket Qos;
+
+    //
+    // Protects Qos
+    // 
+    KSPIN_LOCK QosLock;
+
+    //
+    // Targets plugged in through this handle
+    // 
+    ViGEm::Bus::Core::SessionTargetList Targets;
+
+    //
+    // Set once this handle attached as a source to any target
+    // 
+    LONG HasAttachedSources;
+
+    //
+    // Set if the handle got opened by an administrator or kernel-mode
+    // caller, required for bus-wide diagnostics and settings
+    // 
+    BOOLEAN Privileged;
+
 } FDO_FILE_DATA, * PFDO_FILE_DATA;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FDO_FILE_DATA, FileObjectGetData)
@@ -102,6 +258,14 @@ EVT_WDF_CHILD_LIST_CREATE_DEVICE Bus_EvtDeviceListCreatePdo;
 
 EVT_WDF_OBJECT_CONTEXT_CLEANUP Bus_EvtDriverContextCleanup;
 
+EVT_WDF_TIMER Bus_EvtMacroTimerFunc;
+
+EVT_WDF_TIMER Bus_EvtIdentityTimerFunc;
+
+EVT_WDF_TIMER Bus_EvtDs4TickFunc;
+
+EVT_WDF_OBJECT_CONTEXT_CLEANUP Bus_EvtDeviceContextCleanup;
+
 #pragma endregion
 
 #pragma region Bus enumeration-specific functions
@@ -111,6 +275,7 @@ Bus_PlugInDevice(
     _In_ WDFDEVICE Device,
     _In_ WDFREQUEST Request,
     _In_ BOOLEAN IsInternal,
+    _In_ BOOLEAN AssignSerial,
     _Out_ size_t* Transferred
 );
 
@@ -122,6 +287,84 @@ Bus_UnPlugDevice(
     _Out_ size_t* Transferred
 );
 
+VOID
+Bus_UnPlugSessionDevices(
+    _In_ WDFDEVICE Device,
+    _In_ PFDO_FILE_DATA FileData
+);
+
+NTSTATUS
+Bus_SetTargetPool(
+    _In_ WDFDEVICE Device,
+    _In_ VIGEM_TARGET_TYPE Type,
+    _In_ ULONG Depth
+);
+
+#pragma endregion
+
+#pragma region DualShock 4 identities
+
+NTSTATUS
+Bus_LoadIdentities(
+    _In_ WDFDEVICE Device
+);
+
+NTSTATUS
+Bus_PersistIdentities(
+    _In_ WDFDEVICE Device
+);
+
+VOID
+Bus_ScheduleIdentityFlush(
+    _In_ WDFDEVICE Device
+);
+
+#pragma endregion
+
+#pragma region DualShock 4 tick
+
+ULONG
+Bus_QueryDs4TickTolerance(
+    VOID
+);
+
+ULONG
+Bus_QueryIdleTimeout(
+    VOID
+);
+
+#pragma endregion
+
+#pragma region Capabilities
+
+VOID
+Bus_QueryCapabilities(
+    _In_ WDFDEVICE Device,
+    _Out_ PVIGEM_BUS_CAPABILITIES Capabilities
+);
+
+#pragma endregion
+
+#pragma region Session QoS
+
+VOID
+Bus_SetSessionQos(
+    _In_ PFDO_FILE_DATA FileData,
+    _In_ VIGEM_QOS_CLASS Class,
+    _In_ ULONG ReportsPerSecond,
+    _In_ ULONG Burst
+);
+
+#pragma endregion
+
+#pragma region Access control
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+BOOLEAN
+Bus_IsPrivilegedOpen(
+    _In_ WDFREQUEST Request
+);
+
 #pragma endregion
 
 EXTERN_C_END
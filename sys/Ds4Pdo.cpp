@@ -35,6 +35,7 @@
 
 #include <ntifs.h>
 #include "Ds4Pdo.hpp"
+#include "Driver.h"
 #include "trace.h"
 #include "Ds4Pdo.tmh"
 #define NTSTRSAFE_LIB
@@ -45,6 +46,19 @@
 
 PCWSTR ViGEm::Bus::Targets::EmulationTargetDS4::_deviceDescription = L"Virtual DualShock 4 Controller";
 
+// Default HID input report (everything zero`d)
+const UCHAR ViGEm::Bus::Targets::EmulationTargetDS4::_DefaultHidReport[DS4_REPORT_SIZE] =
+{
+	0x01, 0x82, 0x7F, 0x7E, 0x80, 0x08, 0x00, 0x58,
+	0x00, 0x00, 0xFD, 0x63, 0x06, 0x03, 0x00, 0xFE,
+	0xFF, 0xFC, 0xFF, 0x79, 0xFD, 0x1B, 0x14, 0xD1,
+	0xE9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1B, 0x00,
+	0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x80,
+	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00,
+	0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00,
+	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00
+};
+
 ViGEm::Bus::Targets::EmulationTargetDS4::EmulationTargetDS4(ULONG Serial, LONG SessionId, USHORT VendorId,
                                                             USHORT ProductId) : EmulationTargetPDO(
 	Serial, SessionId, VendorId, ProductId)
@@ -62,6 +76,13 @@ ViGEm::Bus::Targets::EmulationTargetDS4::EmulationTargetDS4(ULONG Serial, LONG S
 	// 
 	this->_PowerCapabilities.DeviceState[PowerSystemWorking] = PowerDeviceD0;
 	this->_PowerCapabilities.WakeFromD0 = WdfTrue;
+
+	Core::TickSet::InitializeLink(&this->_BusTickLink, this);
+}
+
+ViGEm::Bus::Targets::EmulationTargetDS4::~EmulationTargetDS4()
+{
+	this->LeaveBusTick();
 }
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoPrepareDevice(PWDFDEVICE_INIT DeviceInit,
@@ -152,26 +173,10 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoPrepareDevice(PWDFDEVICE_IN
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoPrepareHardware()
 {
-	// Set default HID input report (everything zero`d)
-	UCHAR DefaultHidReport[DS4_REPORT_SIZE] =
-	{
-		0x01, 0x82, 0x7F, 0x7E, 0x80, 0x08, 0x00, 0x58,
-		0x00, 0x00, 0xFD, 0x63, 0x06, 0x03, 0x00, 0xFE,
-		0xFF, 0xFC, 0xFF, 0x79, 0xFD, 0x1B, 0x14, 0xD1,
-		0xE9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1B, 0x00,
-		0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x80,
-		0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00,
-		0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00,
-		0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00
-	};
-
 	// Initialize HID reports to defaults
-	RtlCopyBytes(this->_Report, DefaultHidReport, DS4_REPORT_SIZE);
+	RtlCopyBytes(this->_Report, _DefaultHidReport, DS4_REPORT_SIZE);
 	RtlZeroMemory(&this->_OutputReport, sizeof(DS4_OUTPUT_REPORT));
 
-	// Start pending IRP queue flush timer
-	WdfTimerStart(this->_PendingUsbInRequestsTimer, DS4_QUEUE_FLUSH_PERIOD);
-
 	return STATUS_SUCCESS;
 }
 
@@ -179,132 +184,32 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoInitContext()
 {
 	NTSTATUS status;
 
-	// Initialize periodic timer
-	WDF_TIMER_CONFIG timerConfig;
-	WDF_TIMER_CONFIG_INIT_PERIODIC(
-		&timerConfig,
-		PendingUsbRequestsTimerFunc,
-		DS4_QUEUE_FLUSH_PERIOD
-	);
-
-	// Timer object attributes
-	WDF_OBJECT_ATTRIBUTES timerAttribs;
-	WDF_OBJECT_ATTRIBUTES_INIT(&timerAttribs);
-
-	// PDO is parent
-	timerAttribs.ParentObject = this->_PdoDevice;
-
-	// Create timer
-	status = WdfTimerCreate(
-		&timerConfig,
-		&timerAttribs,
-		&this->_PendingUsbInRequestsTimer
-	);
-	if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_DS4,
-		            "WdfTimerCreate failed with status %!STATUS!",
-		            status);
-		return status;
-	}
+	static_assert(sizeof(MAC_ADDRESS) == Core::IdentityTable::ADDRESS_LENGTH, "MAC address size mismatch");
 
-	// Load/generate MAC address
+	const WDFDEVICE parentDevice = WdfPdoGetParent(this->_PdoDevice);
+	Core::IdentityTable& identities = FdoGetData(parentDevice)->Identities;
 
+	//
+	// Identities got loaded with the bus, new ones are persisted behind the plug-in
 	// 
-	// TODO: tidy up this region
-	// 
-
-	WDFKEY keyParams, keyTargets, keyDS, keySerial;
-	UNICODE_STRING keyName, valueName;
-
-	status = WdfDriverOpenParametersRegistryKey(
-		WdfGetDriver(),
-		STANDARD_RIGHTS_ALL,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&keyParams
-	);
-	if (!NT_SUCCESS(status))
+	if (!identities.Lookup(this->_SerialNo, reinterpret_cast<PUCHAR>(&this->_TargetMacAddress)))
 	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_DS4,
-		            "WdfDriverOpenParametersRegistryKey failed with status %!STATUS!",
-		            status);
-		return status;
-	}
+		GenerateRandomMacAddress(&this->_TargetMacAddress);
 
-	RtlUnicodeStringInit(&keyName, L"Targets");
-
-	status = WdfRegistryCreateKey(
-		keyParams,
-		&keyName,
-		KEY_ALL_ACCESS,
-		REG_OPTION_NON_VOLATILE,
-		nullptr,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&keyTargets
-	);
-	if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_DS4,
-		            "WdfRegistryCreateKey failed with status %!STATUS!",
-		            status);
-		return status;
-	}
+		status = identities.Insert(this->_SerialNo, reinterpret_cast<PUCHAR>(&this->_TargetMacAddress));
 
-	RtlUnicodeStringInit(&keyName, L"DualShock");
-
-	status = WdfRegistryCreateKey(
-		keyTargets,
-		&keyName,
-		KEY_ALL_ACCESS,
-		REG_OPTION_NON_VOLATILE,
-		nullptr,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&keyDS
-	);
-	if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_DS4,
-		            "WdfRegistryCreateKey failed with status %!STATUS!",
-		            status);
-		return status;
-	}
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_DS4,
+			            "IdentityTable::Insert failed with status %!STATUS!",
+			            status);
+			return status;
+		}
 
-	DECLARE_UNICODE_STRING_SIZE(serialPath, 4);
-	RtlUnicodeStringPrintf(&serialPath, L"%04d", this->_SerialNo);
-
-	status = WdfRegistryCreateKey(
-		keyDS,
-		&serialPath,
-		KEY_ALL_ACCESS,
-		REG_OPTION_NON_VOLATILE,
-		nullptr,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&keySerial
-	);
-	if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_DS4,
-		            "WdfRegistryCreateKey failed with status %!STATUS!",
-		            status);
-		return status;
+		Bus_ScheduleIdentityFlush(parentDevice);
 	}
 
-	RtlUnicodeStringInit(&valueName, L"TargetMacAddress");
-
-	status = WdfRegistryQueryValue(
-		keySerial,
-		&valueName,
-		sizeof(MAC_ADDRESS),
-		&this->_TargetMacAddress,
-		nullptr,
-		nullptr
-	);
-
 	TraceEvents(TRACE_LEVEL_INFORMATION,
 	            TRACE_DS4,
 	            "MAC-Address: %02X:%02X:%02X:%02X:%02X:%02X\n",
@@ -315,39 +220,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoInitContext()
 	            this->_TargetMacAddress.Nic1,
 	            this->_TargetMacAddress.Nic2);
 
-	if (status == STATUS_OBJECT_NAME_NOT_FOUND)
-	{
-		GenerateRandomMacAddress(&this->_TargetMacAddress);
-
-		status = WdfRegistryAssignValue(
-			keySerial,
-			&valueName,
-			REG_BINARY,
-			sizeof(MAC_ADDRESS),
-			static_cast<PVOID>(&this->_TargetMacAddress)
-		);
-		if (!NT_SUCCESS(status))
-		{
-			TraceEvents(TRACE_LEVEL_ERROR,
-			            TRACE_DS4,
-			            "WdfRegistryAssignValue failed with status %!STATUS!",
-			            status);
-			return status;
-		}
-	}
-	else if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_DS4,
-		            "WdfRegistryQueryValue failed with status %!STATUS!",
-		            status);
-		return status;
-	}
-
-	WdfRegistryClose(keySerial);
-	WdfRegistryClose(keyDS);
-	WdfRegistryClose(keyTargets);
-	WdfRegistryClose(keyParams);
+	// Idle time counts from plug-in
+	(void)this->_Idle.Activity(KeQueryInterruptTime());
 
 	return STATUS_SUCCESS;
 }
@@ -473,7 +347,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SelectConfiguration(PURB Urb)
 void ViGEm::Bus::Targets::EmulationTargetDS4::AbortPipe()
 {
 	// Higher driver shutting down, emptying PDOs queues
-	WdfTimerStop(this->_PendingUsbInRequestsTimer, TRUE);
+	this->LeaveBusTick();
 }
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbClassInterface(PURB Urb)
@@ -897,6 +771,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetDescriptorFromInterface(
 		//
 		// Notify client library that PDO is ready
 		// 
+		this->MarkPluginPhase(VIGEM_PLUGIN_PHASE_READY);
 		KeSetEvent(&this->_PdoBootNotificationEvent, 0, FALSE);
 	}
 
@@ -1008,18 +883,31 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 	if (pTransfer->TransferFlags & USBD_TRANSFER_DIRECTION_IN
 		&& pTransfer->PipeHandle == reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0084))
 	{
-		TraceDbg(
-			TRACE_USBPDO,
-			">> >> >> Incoming request, queuing...");
+		this->MarkPluginPhase(VIGEM_PLUGIN_PHASE_INPUT_STARTED);
+		this->RecordPoll();
 
 		/* This request is sent periodically and relies on data the "feeder"
 		   has to supply, so we queue this request and return with STATUS_PENDING.
 		   The request gets completed as soon as the "feeder" sent an update. */
 		status = WdfRequestForwardToIoQueue(Request, this->_PendingUsbInRequests);
 
-		return (NT_SUCCESS(status)) ? STATUS_PENDING : status;
+		if (!NT_SUCCESS(status))
+			return status;
+
+		//
+		// Parked targets hold the request until the next report arrives
+		// 
+		if (!this->_Idle.IsParked())
+			this->JoinBusTick();
+
+		return STATUS_PENDING;
 	}
 
+	this->RecordReport(VIGEM_REPORT_LOG_OUTPUT, pTransfer->TransferBuffer, pTransfer->TransferBufferLength);
+	this->RecordRawOutput(pTransfer->TransferBuffer, pTransfer->TransferBufferLength);
+
+	this->ResumeFromIdle();
+
 	// Store relevant bytes of buffer in PDO context
 	RtlCopyBytes(&this->_OutputReport,
 		static_cast<PUCHAR>(pTransfer->TransferBuffer) + DS4_OUTPUT_BUFFER_OFFSET,
@@ -1045,10 +933,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 			notify->SerialNo = this->_SerialNo;
 			notify->Report = this->_OutputReport;
 
-			DumpAsHex("!! XUSB_REQUEST_NOTIFICATION",
-			          notify,
-			          sizeof(DS4_REQUEST_NOTIFICATION)
-			);
+			this->RecordEvent(VIGEM_EVENT_NOTIFICATION_COMPLETED, notify->Report.LargeMotor, notify->Report.SmallMotor,
+			                  VIGEM_EVENT_RGB(notify->Report.LightbarColor));
 
 			WdfRequestCompleteWithInformation(notifyRequest, status, notify->Size);
 		}
@@ -1060,12 +946,12 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 			            status);
 		}
 	}
-	else
+	else if (const DMFMODULE bufferQueue = this->ReferenceNotificationBuffers())
 	{
 		PVOID clientBuffer, contextBuffer;
 
 		if (NT_SUCCESS(DMF_BufferQueue_Fetch(
-			this->_UsbInterruptOutBufferQueue,
+			bufferQueue,
 			&clientBuffer,
 			&contextBuffer
 		)))
@@ -1078,10 +964,12 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 
 			*static_cast<size_t*>(contextBuffer) = DS4_OUTPUT_BUFFER_LENGTH;
 
-			TraceDbg(TRACE_USBPDO, "Queued %Iu bytes", DS4_OUTPUT_BUFFER_LENGTH);
+			this->RecordEvent(VIGEM_EVENT_NOTIFICATION_QUEUED, DS4_OUTPUT_BUFFER_LENGTH);
 
-			DMF_BufferQueue_Enqueue(this->_UsbInterruptOutBufferQueue, clientBuffer);
+			DMF_BufferQueue_Enqueue(bufferQueue, clientBuffer);
 		}
+
+		this->DereferenceNotificationBuffers();
 	}
 	
 	return status;
@@ -1125,6 +1013,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 	 * original API that didn't allow submitting the full report.
 	 */
 
+	this->ResumeFromIdle();
+
 	status = WdfIoQueueRetrieveNextRequest(this->_PendingUsbInRequests, &usbRequest);
 
 	if (!NT_SUCCESS(status))
@@ -1155,8 +1045,6 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 	// 
 	if (pSubmit->Size == sizeof(DS4_SUBMIT_REPORT))
 	{
-		TraceDbg(TRACE_DS4, "Received DS4_SUBMIT_REPORT update");
-		
 		RtlCopyBytes(
 			&this->_Report[1],
 			&(static_cast<PDS4_SUBMIT_REPORT>(NewReport))->Report,
@@ -1169,8 +1057,6 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 	// 
 	if (pSubmit->Size == sizeof(DS4_SUBMIT_REPORT_EX))
 	{
-		TraceDbg(TRACE_DS4, "Received DS4_SUBMIT_REPORT_EX update");
-		
 		RtlCopyBytes(
 			&this->_Report[1],
 			&(static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report,
@@ -1184,9 +1070,68 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 	// Complete pending request
 	WdfRequestComplete(usbRequest, status);
 
+	InterlockedExchange(&this->_ServedSinceTick, TRUE);
+
 	return status;
 }
 
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::ApplyAxisTransform(PVOID NewReport, const Core::AxisTransform& Transform)
+{
+	//
+	// DS4_SUBMIT_REPORT and DS4_SUBMIT_REPORT_EX share the layout of
+	// the leading DS4_REPORT fields, so this works for both
+	// 
+	const auto pReport = &static_cast<PDS4_SUBMIT_REPORT>(NewReport)->Report;
+	LONG axes[VIGEM_AXIS_COUNT];
+
+	Core::AxisTransform::FromDs4Report(pReport, axes);
+	Transform.Apply(axes);
+	Core::AxisTransform::ToDs4Report(axes, pReport);
+}
+
+bool ViGEm::Bus::Targets::EmulationTargetDS4::AggregateReport(PVOID NewReport, LONG SessionId, Core::ReportAggregator& Aggregator)
+{
+	//
+	// Only the DS4_REPORT part is merged, extended fields (motion,
+	// touch) of DS4_SUBMIT_REPORT_EX pass through from the submitter
+	// 
+	const auto pReport = &static_cast<PDS4_SUBMIT_REPORT>(NewReport)->Report;
+	Core::AGGREGATOR_STATE input, merged;
+
+	Core::ReportAggregator::FromDs4Report(pReport, input);
+
+	if (!Aggregator.Merge(SessionId, input, merged))
+		return false;
+
+	Core::ReportAggregator::ToDs4Report(merged, pReport);
+
+	return true;
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::ApplyMacroOverlay(PVOID NewReport, const Core::MACRO_OVERLAY& Overlay)
+{
+	const auto pReport = &static_cast<PDS4_SUBMIT_REPORT>(NewReport)->Report;
+	Core::AGGREGATOR_STATE state;
+
+	Core::ReportAggregator::FromDs4Report(pReport, state);
+	Core::MacroSet::ApplyOverlay(Overlay, state.Buttons, state.Axes);
+	Core::ReportAggregator::ToDs4Report(state, pReport);
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::SubmitNeutralReport()
+{
+	DS4_SUBMIT_REPORT neutral;
+
+	//
+	// The partial report leaves touch and motion data alone, start over from the defaults
+	// 
+	RtlCopyBytes(this->_Report, _DefaultHidReport, DS4_REPORT_SIZE);
+
+	DS4_SUBMIT_REPORT_INIT(&neutral, this->_SerialNo);
+
+	(void)this->SubmitReportImpl(&neutral);
+}
+
 VOID ViGEm::Bus::Targets::EmulationTargetDS4::ReverseByteArray(PUCHAR Array, INT Length)
 {
 	const auto s = static_cast<PUCHAR>(ExAllocatePoolWithTag(
@@ -1222,7 +1167,7 @@ VOID ViGEm::Bus::Targets::EmulationTargetDS4::GenerateRandomMacAddress(PMAC_ADDR
 	Address->Nic2 = RtlRandomEx(&seed) % 0xFF;
 }
 
-void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEUE Queue)
+void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEUE Queue, DMFMODULE BufferQueue)
 {
 	NTSTATUS status;
 	WDFREQUEST request;
@@ -1237,7 +1182,7 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
 		status = DMF_BufferQueue_Dequeue(
-			this->_UsbInterruptOutBufferQueue,
+			BufferQueue,
 			&clientBuffer,
 			&contextBuffer
 		);
@@ -1268,20 +1213,18 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 			notify->SerialNo = this->_SerialNo;
 			notify->Report = *static_cast<PDS4_OUTPUT_REPORT>(clientBuffer);
 
-			DumpAsHex("!! XUSB_REQUEST_NOTIFICATION", 
-				notify, 
-				sizeof(DS4_REQUEST_NOTIFICATION)
-			);
+			this->RecordEvent(VIGEM_EVENT_NOTIFICATION_COMPLETED, notify->Report.LargeMotor, notify->Report.SmallMotor,
+			                  VIGEM_EVENT_RGB(notify->Report.LightbarColor));
 			
 			WdfRequestCompleteWithInformation(request, status, notify->Size);
 		}
 
-		DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
+		DMF_BufferQueue_Reuse(BufferQueue, clientBuffer);
 
 		//
 		// If no more buffer to process, exit loop and await next callback
 		// 
-		if (DMF_BufferQueue_Count(this->_UsbInterruptOutBufferQueue) == 0)
+		if (DMF_BufferQueue_Count(BufferQueue) == 0)
 		{
 			break;
 		}
@@ -1290,43 +1233,194 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 	TraceDbg(TRACE_USBPDO, "%!FUNC! Exit");
 }
 
-VOID ViGEm::Bus::Targets::EmulationTargetDS4::PendingUsbRequestsTimerFunc(
-	_In_ WDFTIMER Timer
-)
+bool ViGEm::Bus::Targets::EmulationTargetDS4::ServiceBusTick(WDFDEVICE Device)
 {
-	const auto ctx = reinterpret_cast<EmulationTargetDS4*>(Core::EmulationTargetPdoGetContext(
-		WdfTimerGetParentObject(Timer))->Target);
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+	WDFREQUEST batch[BUS_TICK_BATCH];
+	ULONG queuedRequests;
 
-	WDFREQUEST usbRequest;
+	const ULONGLONG now = KeQueryInterruptTime();
 
 	TraceDbg(TRACE_DS4, "%!FUNC! Entry");
 
-	// Get pending USB request
-	const auto status = WdfIoQueueRetrieveNextRequest(ctx->_PendingUsbInRequests, &usbRequest);
+	KeAcquireSpinLockAtDpcLevel(&pFdoData->Ds4TickLock);
+
+	//
+	// The set changes while the lock is dropped between batches, targets
+	// visited by this pass are recognized by its number instead of position
+	// 
+	const ULONG generation = ++pFdoData->Ds4TickGeneration;
+
+	ULONG index = pFdoData->Ds4Tick.GetCount();
 
-	if (NT_SUCCESS(status))
+	while (index > 0)
 	{
-		// Get pending IRP
-		const auto pendingIrp = WdfRequestWdmGetIrp(usbRequest);
+		ULONG count = 0;
+
+		//
+		// Walk backwards, leaving targets get replaced by already visited ones
+		// 
+		while (index > 0 && count < BUS_TICK_BATCH)
+		{
+			const Core::PTICK_SET_LINK link = pFdoData->Ds4Tick.GetAt(--index);
+			const auto ctx = static_cast<EmulationTargetDS4*>(link->Context);
 
-		const auto irpStack = IoGetCurrentIrpStackLocation(pendingIrp);
+			if (ctx->_BusTickGeneration == generation)
+				continue;
 
-		// Get USB request block
-		const auto urb = static_cast<PURB>(irpStack->Parameters.Others.Argument1);
+			ctx->_BusTickGeneration = generation;
 
-		// Get transfer buffer
-		const auto buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
+			// Requests forwarded from here on rejoin the tick
+			InterlockedExchange(&ctx->_BusTickQueued, FALSE);
 
-		// Set buffer length to report size
-		urb->UrbBulkOrInterruptTransfer.TransferBufferLength = DS4_REPORT_SIZE;
+			//
+			// Idle, the host keeps its requests until the next report
+			// 
+			if (ctx->_Idle.IsParked() || ctx->_Idle.Park(now, pFdoData->IdleTimeout))
+			{
+				pFdoData->Ds4Tick.Remove(link);
+				continue;
+			}
 
-		// Copy cached report to transfer buffer 
-		if (buffer)
-			RtlCopyBytes(buffer, ctx->_Report, DS4_REPORT_SIZE);
+			//
+			// Fed since the previous tick, the host already got the current report
+			// 
+			if (!InterlockedExchange(&ctx->_ServedSinceTick, FALSE)
+				&& NT_SUCCESS(WdfIoQueueRetrieveNextRequest(ctx->_PendingUsbInRequests, &batch[count])))
+			{
+				// Get pending IRP
+				const auto pendingIrp = WdfRequestWdmGetIrp(batch[count]);
 
-		// Complete pending request
-		WdfRequestComplete(usbRequest, status);
+				const auto irpStack = IoGetCurrentIrpStackLocation(pendingIrp);
+
+				// Get USB request block
+				const auto urb = static_cast<PURB>(irpStack->Parameters.Others.Argument1);
+
+				// Get transfer buffer
+				const auto buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
+
+				// Set buffer length to report size
+				urb->UrbBulkOrInterruptTransfer.TransferBufferLength = DS4_REPORT_SIZE;
+
+				// Copy cached report to transfer buffer 
+				if (buffer)
+					RtlCopyBytes(buffer, ctx->_Report, DS4_REPORT_SIZE);
+
+				count++;
+			}
+
+			// Keep ticking only while requests are waiting
+			WdfIoQueueGetState(ctx->_PendingUsbInRequests, &queuedRequests, nullptr);
+
+			if (queuedRequests > 0)
+				InterlockedExchange(&ctx->_BusTickQueued, TRUE);
+			else
+				pFdoData->Ds4Tick.Remove(link);
+		}
+
+		//
+		// Complete outside the lock, the host may forward the next request right away
+		// 
+		KeReleaseSpinLockFromDpcLevel(&pFdoData->Ds4TickLock);
+
+		for (ULONG request = 0; request < count; request++)
+		{
+			WdfRequestComplete(batch[request], STATUS_SUCCESS);
+		}
+
+		KeAcquireSpinLockAtDpcLevel(&pFdoData->Ds4TickLock);
+
+		//
+		// Targets may have left or joined meanwhile, look at all of them again
+		// 
+		if (count > 0)
+			index = pFdoData->Ds4Tick.GetCount();
+	}
+
+	const bool pending = !pFdoData->Ds4Tick.IsEmpty();
+
+	KeReleaseSpinLockFromDpcLevel(&pFdoData->Ds4TickLock);
+
+	TraceDbg(TRACE_DS4, "%!FUNC! Exit");
+
+	return pending;
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::JoinBusTick()
+{
+	KIRQL irql;
+
+	//
+	// Already on the tick, it picks up the newly queued request
+	// 
+	if (InterlockedExchange(&this->_BusTickQueued, TRUE))
+		return;
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(WdfPdoGetParent(this->_PdoDevice));
+
+	KeAcquireSpinLock(&pFdoData->Ds4TickLock, &irql);
+
+	const bool idle = pFdoData->Ds4Tick.IsEmpty();
+	const NTSTATUS status = pFdoData->Ds4Tick.Insert(&this->_BusTickLink);
+
+	KeReleaseSpinLock(&pFdoData->Ds4TickLock, irql);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_DS4,
+		            "TickSet::Insert failed with status %!STATUS!",
+		            status);
+
+		// Queued requests still get completed by the next submitted report
+		InterlockedExchange(&this->_BusTickQueued, FALSE);
+		return;
 	}
 
-	TraceDbg(TRACE_DS4, "%!FUNC! Exit with status %!STATUS!", status);
+	//
+	// The tick stops while no target waits, the first one restarts it
+	// 
+	if (idle)
+		WdfTimerStart(pFdoData->Ds4TickTimer, WDF_REL_TIMEOUT_IN_MS(FDO_DS4_TICK_MS));
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::LeaveBusTick()
+{
+	KIRQL irql;
+
+	// Never joined without a device object
+	if (!this->_PdoDevice)
+		return;
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(WdfPdoGetParent(this->_PdoDevice));
+
+	//
+	// The tick only dereferences members under this lock
+	// 
+	KeAcquireSpinLock(&pFdoData->Ds4TickLock, &irql);
+
+	pFdoData->Ds4Tick.Remove(&this->_BusTickLink);
+	InterlockedExchange(&this->_BusTickQueued, FALSE);
+
+	KeReleaseSpinLock(&pFdoData->Ds4TickLock, irql);
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::ResumeFromIdle()
+{
+	if (this->_Idle.Activity(KeQueryInterruptTime()))
+	{
+		TraceDbg(TRACE_DS4, "Serial %d resumed from idle", this->_SerialNo);
+
+		this->JoinBusTick();
+	}
+}
+
+ULONG ViGEm::Bus::Targets::EmulationTargetDS4::GetResources()
+{
+	ULONG resources = EmulationTargetPDO::GetResources();
+
+	if (Core::TickSet::Contains(&this->_BusTickLink))
+		resources |= VIGEM_TARGET_RESOURCE_INPUT_TIMER;
+
+	return resources;
 }
@@ -36,6 +36,8 @@
 #pragma once
 
 #include "EmulationTargetPDO.hpp"
+#include "TickSet.hpp"
+#include "IdleTracker.hpp"
 #include <ViGEm/km/BusShared.h>
 
 
@@ -64,11 +66,18 @@ namespace ViGEm::Bus::Targets
 		return (pReq->Value >> 8) & 0xFF;
 	}
 
-	class EmulationTargetDS4 : public Core::EmulationTargetPDO
+	class EmulationTargetDS4 final : public Core::EmulationTargetPDO
 	{
+		//
+		// Invokes the protected handlers through this type, see DispatchTarget
+		// 
+		friend class Core::EmulationTargetPDO;
+
 	public:
 		EmulationTargetDS4(ULONG Serial, LONG SessionId, USHORT VendorId = 0x054C, USHORT ProductId = 0x05C4);
 
+		~EmulationTargetDS4() override;
+
 		NTSTATUS PdoPrepareDevice(PWDFDEVICE_INIT DeviceInit,
 		                          PUNICODE_STRING DeviceId,
 		                          PUNICODE_STRING DeviceDescription) override;
@@ -98,16 +107,46 @@ namespace ViGEm::Bus::Targets
 		NTSTATUS UsbControlTransfer(PURB Urb) override;
 		
 		NTSTATUS SubmitReportImpl(PVOID NewReport) override;
+
+		//
+		// Completes the next pending interrupt IN request of every target
+		// on the bus tick that wasn't fed since the previous tick. Returns
+		// whether the tick needs to run again.
+		// 
+		static bool ServiceBusTick(WDFDEVICE Device);
 		
 	private:
-		static EVT_WDF_TIMER PendingUsbRequestsTimerFunc;
+		//
+		// Schedules completing the next pending interrupt IN request
+		// 
+		VOID JoinBusTick();
+
+		//
+		// Stops the bus tick from referencing this target
+		// 
+		VOID LeaveBusTick();
+
+		//
+		// Records traffic, puts a parked target back on the bus tick
+		// 
+		VOID ResumeFromIdle();
 
 		static VOID ReverseByteArray(PUCHAR Array, INT Length);
 
 		static VOID GenerateRandomMacAddress(PMAC_ADDRESS Address);
 
 	protected:
-		void ProcessPendingNotification(WDFQUEUE Queue) override;
+		void ProcessPendingNotification(WDFQUEUE Queue, DMFMODULE BufferQueue) override;
+
+		VOID ApplyAxisTransform(PVOID NewReport, const Core::AxisTransform& Transform) override;
+
+		bool AggregateReport(PVOID NewReport, LONG SessionId, Core::ReportAggregator& Aggregator) override;
+
+		VOID ApplyMacroOverlay(PVOID NewReport, const Core::MACRO_OVERLAY& Overlay) override;
+
+		VOID SubmitNeutralReport() override;
+
+		ULONG GetResources();
 	private:
 		static PCWSTR _deviceDescription;
 
@@ -134,7 +173,16 @@ namespace ViGEm::Bus::Targets
 		static const int DS4_OUTPUT_BUFFER_LENGTH = 0x05;
 
 		static const int DS4_REPORT_SIZE = 0x40;
-		static const int DS4_QUEUE_FLUSH_PERIOD = 0x05;
+
+		//
+		// Requests a tick completes before leaving the bus tick lock
+		// 
+		static const ULONG BUS_TICK_BATCH = 32;
+
+		//
+		// HID Input Report the device powers up with
+		// 
+		static const UCHAR _DefaultHidReport[DS4_REPORT_SIZE];
 
 		//
 		// HID Input Report buffer
@@ -147,9 +195,31 @@ namespace ViGEm::Bus::Targets
 		DS4_OUTPUT_REPORT _OutputReport;
 
 		//
-		// Timer for dispatching interrupt transfer
+		// Membership in the bus tick dispatching interrupt transfers
+		//
+		Core::TICK_SET_LINK _BusTickLink{};
+
+		//
+		// Set while this target is on the bus tick
+		// 
+		LONG _BusTickQueued{};
+
+		//
+		// Set when a submitted report completed a request, the next tick
+		// skips this target
+		// 
+		LONG _ServedSinceTick{};
+
+		//
+		// Bus tick pass that last visited this target, protected by the tick lock
+		// 
+		ULONG _BusTickGeneration{};
+
 		//
-		WDFTIMER _PendingUsbInRequestsTimer;
+		// Parks the bus tick membership while neither reports nor output
+		// reports arrive
+		// 
+		Core::IdleTracker _Idle{};
 
 		//
 		// Auto-generated MAC address of the target device
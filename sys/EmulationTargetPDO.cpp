@@ -34,6 +34,10 @@
 
 
 #include "EmulationTargetPDO.hpp"
+#include "XusbPdo.hpp"
+#include "Ds4Pdo.hpp"
+#include "TargetDispatch.hpp"
+#include "Driver.h"
 #include "CRTCPP.hpp"
 #include "trace.h"
 #include "EmulationTargetPDO.tmh"
@@ -41,10 +45,23 @@
 #include <ntstrsafe.h>
 #include <usbioctl.h>
 #include <usbiodef.h>
+#include <ViGEm/km/BusShared.h>
 
 #include "Debugging.hpp"
 
 
+namespace ViGEm::Bus::Core
+{
+	//
+	// DispatchTargetAs over the target types of the bus
+	// 
+	template <typename Handler>
+	FORCEINLINE auto DispatchTarget(EmulationTargetPDO* Target, Handler&& Function)
+	{
+		return DispatchTargetAs<Targets::EmulationTargetXUSB, Targets::EmulationTargetDS4>(Target, Function);
+	}
+}
+
 PCWSTR ViGEm::Bus::Core::EmulationTargetPDO::_deviceLocation = L"Virtual Gamepad Emulation Bus";
 
 NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentDevice, PWDFDEVICE_INIT DeviceInit)
@@ -57,7 +74,9 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 	UNICODE_STRING deviceDescription;
 	WDF_OBJECT_ATTRIBUTES attributes;
 	WDF_IO_QUEUE_CONFIG usbInQueueConfig;
+	WDF_IO_QUEUE_CONFIG idleQueueConfig;
 	WDF_IO_QUEUE_CONFIG notificationsQueueConfig;
+	WDF_TIMER_CONFIG coalesceTimerConfig;
 	PEMULATION_TARGET_PDO_CONTEXT pPdoContext;
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSPDO, "%!FUNC! Entry");
@@ -67,10 +86,10 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 	// reserve space for device id
 	DECLARE_UNICODE_STRING_SIZE(deviceId, MAX_INSTANCE_ID_LEN);
 
-	UNREFERENCED_PARAMETER(ParentDevice);
-
 	PAGED_CODE();
 
+	this->_EventTrace = &FdoGetData(ParentDevice)->Events;
+
 	// set device type
 	WdfDeviceInitSetDeviceType(DeviceInit, FILE_DEVICE_BUS_EXTENDER);
 	// Bus is power policy owner
@@ -138,6 +157,7 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 		WDF_PNPPOWER_EVENT_CALLBACKS_INIT(&pnpPowerCallbacks);
 
 		pnpPowerCallbacks.EvtDevicePrepareHardware = EvtDevicePrepareHardware;
+		pnpPowerCallbacks.EvtDeviceD0Exit = EvtDeviceD0Exit;
 
 		WdfDeviceInitSetPnpPowerEventCallbacks(DeviceInit, &pnpPowerCallbacks);
 
@@ -170,6 +190,8 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 			"Created PDO 0x%p",
 			this->_PdoDevice);
 
+		this->MarkPluginPhase(VIGEM_PLUGIN_PHASE_DEVICE_CREATED);
+
 #pragma endregion
 
 #pragma region Expose USB Interface
@@ -234,6 +256,25 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 			break;
 		}
 
+		// Create queue holding the selective suspend request of the function driver
+		WDF_IO_QUEUE_CONFIG_INIT(&idleQueueConfig, WdfIoQueueDispatchManual);
+		idleQueueConfig.PowerManaged = WdfFalse;
+
+		status = WdfIoQueueCreate(
+			this->_PdoDevice,
+			&idleQueueConfig,
+			WDF_NO_OBJECT_ATTRIBUTES,
+			&this->_PendingIdleNotification
+		);
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_BUSPDO,
+				"WdfIoQueueCreate (PendingIdleNotification) failed with status %!STATUS!",
+				status);
+			break;
+		}
+
 		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
 		attributes.ParentObject = this->_PdoDevice;
 
@@ -269,6 +310,27 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 			break;
 		}
 
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = this->_PdoDevice;
+
+		// Create timer delivering reports held back by the session rate limit
+		WDF_TIMER_CONFIG_INIT(&coalesceTimerConfig, EvtCoalesceTimerFunc);
+		coalesceTimerConfig.UseHighResolutionTimer = WdfTrue;
+
+		status = WdfTimerCreate(
+			&coalesceTimerConfig,
+			&attributes,
+			&this->_CoalesceTimer
+		);
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_BUSPDO,
+				"WdfTimerCreate (CoalesceTimer) failed with status %!STATUS!",
+				status);
+			break;
+		}
+
 #pragma endregion
 
 #pragma region Default I/O queue setup
@@ -319,6 +381,11 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 		WdfDeviceSetPowerCapabilities(this->_PdoDevice, &this->_PowerCapabilities);
 
 #pragma endregion
+
+		//
+		// Lookups by serial may use this target from here on
+		// 
+		FdoGetData(ParentDevice)->Serials.SetOnline(this->_SerialNo);
 	} while (FALSE);
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
@@ -334,12 +401,30 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceContextCleanup(
 
 	const auto ctx = EmulationTargetPdoGetContext(Device);
 
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(WdfPdoGetParent(static_cast<WDFDEVICE>(Device)));
+
+	//
+	// Hide from lookups before tearing down, frees the serial for new targets
+	// 
+	pFdoData->Serials.Release(ctx->Target->_SerialNo);
+
 	//
 	// This queues parent is the FDO so explicitly free memory
 	//
 	WdfIoQueuePurgeSynchronously(ctx->Target->_WaitDeviceReadyRequests);
 	WdfObjectDelete(ctx->Target->_WaitDeviceReadyRequests);
 
+	//
+	// Same for notifications, which would otherwise pile up until the bus goes away
+	// 
+	if (ctx->Target->_PendingNotificationRequests)
+	{
+		WdfIoQueuePurgeSynchronously(ctx->Target->_PendingNotificationRequests);
+		WdfObjectDelete(ctx->Target->_PendingNotificationRequests);
+	}
+
+	ctx->Target->FreeNotificationBuffers();
+
 	//
 	// Wait for thread to finish, if active
 	// 
@@ -368,6 +453,33 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceContextCleanup(
 		}
 	}
 	
+	//
+	// Stop macros so the bus timer no longer references this target
+	// 
+	KIRQL irql;
+
+	KeAcquireSpinLock(&pFdoData->MacroLock, &irql);
+	ctx->Target->_Macros.Clear(pFdoData->Macros);
+	KeReleaseSpinLock(&pFdoData->MacroLock, irql);
+
+	ExWaitForRundownProtectionRelease(&ctx->Target->_MacroRundown);
+
+	//
+	// Leave the target list of the session, if still on it
+	// 
+	ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+	SessionTargetList::Remove(&ctx->Target->_SessionLink);
+	ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
+	//
+	// Release log storage, if still recording
+	// 
+	if (const PUCHAR storage = ctx->Target->_Recorder.Stop())
+		ExFreePoolWithTag(storage, REPORT_RECORDER_POOL_TAG);
+
+	if (const PUCHAR storage = ctx->Target->_RawOutput.Stop())
+		ExFreePoolWithTag(storage, RAW_OUTPUT_RING_POOL_TAG);
+
 	//
 	// PDO device object getting disposed, free context object 
 	// 
@@ -376,241 +488,1069 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceContextCleanup(
 	TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_BUSPDO, "%!FUNC! Exit");
 }
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitReport(PVOID NewReport)
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitReport(PVOID NewReport, LONG SessionId)
 {
-	return (this->IsOwnerProcess())
-		? this->SubmitReportImpl(NewReport)
-		: STATUS_ACCESS_DENIED;
-}
+	//
+	// A newer report supersedes the one held back for the same session
+	// 
+	if (this->_CoalescedPending)
+	{
+		KIRQL irql;
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueNotification(WDFREQUEST Request) const
-{
-	return (this->IsOwnerProcess())
-		? WdfRequestForwardToIoQueue(Request, this->_PendingNotificationRequests)
-		: STATUS_ACCESS_DENIED;
-}
+		KeAcquireSpinLock(&this->_CoalesceLock, &irql);
 
-bool ViGEm::Bus::Core::EmulationTargetPDO::IsOwnerProcess() const
-{
-	return this->_OwnerProcessId == current_process_id();
-}
+		if (this->_CoalescedSessionId == SessionId)
+			this->_CoalescedPending = false;
 
-VIGEM_TARGET_TYPE ViGEm::Bus::Core::EmulationTargetPDO::GetType() const
-{
-	return this->_TargetType;
+		KeReleaseSpinLock(&this->_CoalesceLock, irql);
+	}
+
+	return this->DispatchReport(NewReport, SessionId, this->IsOwnerProcess());
 }
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFREQUEST Request)
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::ValidateReport(PVOID NewReport, LONG SessionId)
 {
-	NTSTATUS status;
-
-	if (!this->IsOwnerProcess())
-		return STATUS_ACCESS_DENIED;
+	const ULONG size = *static_cast<PULONG>(NewReport);
 
-	if (!this->_WaitDeviceReadyRequests)
-		return STATUS_INVALID_DEVICE_STATE;
+	if (size < REPORT_PAYLOAD_OFFSET || size > MAX_SUBMIT_REPORT_SIZE)
+		return STATUS_INVALID_BUFFER_SIZE;
 
-	if (this->_WaitDeviceReadyCompletionWorkerThreadHandle)
-	{
-		status = KeWaitForSingleObject(
-			&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
-			Executive,
-			KernelMode,
-			FALSE,
-			nullptr
-		);
+	if (this->IsOwnerProcess())
+		return STATUS_SUCCESS;
 
-		if (NT_SUCCESS(status))
-		{
-			ZwClose(this->_WaitDeviceReadyCompletionWorkerThreadHandle);
-			this->_WaitDeviceReadyCompletionWorkerThreadHandle = nullptr;
-		}
-		else
-		{
-			TraceEvents(TRACE_LEVEL_WARNING,
-			            TRACE_BUSPDO,
-			            "KeWaitForSingleObject failed with status %!STATUS!",
-			            status
-			);
-		}
-	}
-	
-	status = WdfRequestForwardToIoQueue(Request, this->_WaitDeviceReadyRequests);
+	bool isSource = false;
 
-	if (!NT_SUCCESS(status))
+	if (this->_Aggregator.IsEnabled())
 	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_BUSPDO,
-		            "WdfRequestForwardToIoQueue failed with status %!STATUS!",
-		            status
-		);
-
-		return status;
-	}
-
-	OBJECT_ATTRIBUTES threadOb;
+		const KIRQL irql = ExAcquireSpinLockShared(&this->_AggregatorLock);
 
-	InitializeObjectAttributes(&threadOb, NULL,
-	                           OBJ_KERNEL_HANDLE, NULL, NULL);
-
-	status = PsCreateSystemThread(&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
-	                              static_cast<ACCESS_MASK>(0L),
-	                              &threadOb,
-	                              nullptr,
-	                              nullptr,
-	                              WaitDeviceReadyCompletionWorkerRoutine,
-	                              this
-	);
+		isSource = this->_Aggregator.IsEnabled() && this->_Aggregator.IsSource(SessionId);
 
-	if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_BUSPDO,
-		            "PsCreateSystemThread failed with status %!STATUS!",
-		            status
-		);
+		ExReleaseSpinLockShared(&this->_AggregatorLock, irql);
 	}
 
-	return status;
+	return isSource ? STATUS_SUCCESS : STATUS_ACCESS_DENIED;
 }
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice)
+bool ViGEm::Bus::Core::EmulationTargetPDO::CoalesceReport(PVOID NewReport, LONG SessionId)
 {
-	NTSTATUS status;
-	WDF_OBJECT_ATTRIBUTES attributes;
-	WDF_IO_QUEUE_CONFIG plugInQueueConfig;
-	DMF_MODULE_ATTRIBUTES moduleAttributes;
-	DMF_CONFIG_BufferQueue dmfBufferCfg;
-	
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = ParentDevice;
+	KIRQL irql;
+	UCHAR previous[MAX_SUBMIT_REPORT_SIZE];
+	LONG previousSessionId = 0;
+	bool previousIsOwner = false;
+	bool flushPrevious = false;
+	const bool isOwner = this->IsOwnerProcess();
+	const ULONG size = min(*static_cast<PULONG>(NewReport), MAX_SUBMIT_REPORT_SIZE);
 
-	// Create and assign queue for incoming interrupt transfer
-	WDF_IO_QUEUE_CONFIG_INIT(&plugInQueueConfig, WdfIoQueueDispatchManual);
+	KeAcquireSpinLock(&this->_CoalesceLock, &irql);
 
-	status = WdfIoQueueCreate(
-		ParentDevice,
-		&plugInQueueConfig,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&this->_WaitDeviceReadyRequests
-	);
-	if (!NT_SUCCESS(status))
+	//
+	// Another session's held back report must not get lost
+	// 
+	if (this->_CoalescedPending && this->_CoalescedSessionId != SessionId)
 	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-			TRACE_BUSPDO,
-			"WdfIoQueueCreate (PendingPlugInRequests) failed with status %!STATUS!",
-			status);
+		RtlCopyMemory(previous, this->_CoalescedReport, sizeof(previous));
+		previousSessionId = this->_CoalescedSessionId;
+		previousIsOwner = this->_CoalescedIsOwner;
+		flushPrevious = true;
 	}
 
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = ParentDevice;
+	//
+	// Only a report replacing one of its own session rides on the slot
+	// that session already paid for
+	// 
+	const bool schedule = !this->_CoalescedPending || flushPrevious;
 
-	DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(
-		&dmfBufferCfg,
-		&moduleAttributes
-	);
+	RtlCopyMemory(this->_CoalescedReport, NewReport, size);
+	this->_CoalescedSessionId = SessionId;
+	this->_CoalescedIsOwner = isOwner;
+	this->_CoalescedPending = true;
 
-	// Don't auto-grow; start dropping packets on overrun
-	dmfBufferCfg.SourceSettings.EnableLookAside = FALSE;
-	// Maximum number of buffers to be filled and kept queued
-	dmfBufferCfg.SourceSettings.BufferCount = MAX_OUT_BUFFER_QUEUE_COUNT;
-	// Maximum byte count per buffer
-	dmfBufferCfg.SourceSettings.BufferSize = MAX_OUT_BUFFER_QUEUE_SIZE;
-	// Field to store real buffer content length
-	dmfBufferCfg.SourceSettings.BufferContextSize = sizeof(size_t);
-	// "Expensive" memory ;)
-	dmfBufferCfg.SourceSettings.PoolType = NonPagedPoolNx;
+	KeReleaseSpinLock(&this->_CoalesceLock, irql);
 
-	status = DMF_BufferQueue_Create(
-		ParentDevice,
-		&moduleAttributes,
-		&attributes,
-		&this->_UsbInterruptOutBufferQueue
-	);
+	if (flushPrevious)
+		(void)this->DispatchReport(previous, previousSessionId, previousIsOwner);
 
-	if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_BUSPDO,
-		            "DMF_BufferQueue_Create failed with status %!STATUS!",
-		            status
-		);
-	}
+	this->RecordEvent(VIGEM_EVENT_REPORT_COALESCED, SessionId);
 
-	return status;
+	return schedule;
 }
 
-unsigned long ViGEm::Bus::Core::EmulationTargetPDO::current_process_id()
+VOID ViGEm::Bus::Core::EmulationTargetPDO::ScheduleCoalescedReport(ULONGLONG DueTime)
 {
-	return static_cast<DWORD>(reinterpret_cast<DWORD_PTR>(PsGetCurrentProcessId()) & 0xFFFFFFFF);
-}
+	const ULONGLONG now = KeQueryInterruptTime();
 
-#pragma region USB Interface Functions
+	//
+	// Negative due time is relative, in 100ns units
+	// 
+	WdfTimerStart(this->_CoalesceTimer, (DueTime > now) ? -static_cast<LONGLONG>(DueTime - now) : -1);
+}
 
-BOOLEAN USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceIsDeviceHighSpeed(IN PVOID BusContext)
+VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtCoalesceTimerFunc(WDFTIMER Timer)
 {
-	UNREFERENCED_PARAMETER(BusContext);
+	UCHAR report[MAX_SUBMIT_REPORT_SIZE];
+	const auto target = EmulationTargetPdoGetContext(WdfTimerGetParentObject(Timer))->Target;
 
-	return TRUE;
-}
+	KeAcquireSpinLockAtDpcLevel(&target->_CoalesceLock);
 
-NTSTATUS USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceQueryBusInformation(
-	IN PVOID BusContext, IN ULONG Level,
-	IN OUT PVOID BusInformationBuffer,
-	IN OUT PULONG BusInformationBufferLength,
-	OUT PULONG BusInformationActualLength)
-{
-	UNREFERENCED_PARAMETER(BusContext);
-	UNREFERENCED_PARAMETER(Level);
-	UNREFERENCED_PARAMETER(BusInformationBuffer);
-	UNREFERENCED_PARAMETER(BusInformationBufferLength);
-	UNREFERENCED_PARAMETER(BusInformationActualLength);
+	const bool pending = target->_CoalescedPending;
+	const LONG sessionId = target->_CoalescedSessionId;
+	const bool isOwner = target->_CoalescedIsOwner;
 
-	return STATUS_UNSUCCESSFUL;
-}
+	RtlCopyMemory(report, target->_CoalescedReport, sizeof(report));
+	target->_CoalescedPending = false;
 
-NTSTATUS USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceSubmitIsoOutUrb(IN PVOID BusContext, IN PURB Urb)
-{
-	UNREFERENCED_PARAMETER(BusContext);
-	UNREFERENCED_PARAMETER(Urb);
+	KeReleaseSpinLockFromDpcLevel(&target->_CoalesceLock);
 
-	return STATUS_UNSUCCESSFUL;
+	if (pending)
+		(void)target->DispatchReport(report, sessionId, isOwner);
 }
 
-NTSTATUS USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceQueryBusTime(
-	IN PVOID BusContext, IN OUT PULONG CurrentUsbFrame)
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::DispatchReport(PVOID NewReport, LONG SessionId, bool IsOwner)
 {
-	UNREFERENCED_PARAMETER(BusContext);
-	UNREFERENCED_PARAMETER(CurrentUsbFrame);
-
-	return STATUS_UNSUCCESSFUL;
+	return DispatchTarget(this, [&](auto* Self)
+	{
+		return DispatchReportAs(Self, NewReport, SessionId, IsOwner);
+	});
 }
 
-VOID USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceGetUSBDIVersion(IN PVOID BusContext,
-	IN OUT PUSBD_VERSION_INFORMATION
-	VersionInformation,
-	IN OUT PULONG HcdCapabilities)
+template <typename Target>
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::DispatchReportAs(Target* Self, PVOID NewReport, LONG SessionId, bool IsOwner)
 {
-	UNREFERENCED_PARAMETER(BusContext);
-
-	if (VersionInformation != nullptr)
+	//
+	// Record exactly what the feeder sent, before merging and transforming
+	// 
+	if (IsOwner || Self->_Aggregator.IsEnabled())
 	{
-		VersionInformation->USBDI_Version = 0x500; /* Usbport */
-		VersionInformation->Supported_USB_Version = 0x200; /* USB 2.0 */
+		const ULONG size = *static_cast<PULONG>(NewReport);
+
+		Self->RecordReport(
+			VIGEM_REPORT_LOG_INPUT,
+			static_cast<PUCHAR>(NewReport) + REPORT_PAYLOAD_OFFSET,
+			size - REPORT_PAYLOAD_OFFSET
+		);
 	}
 
-	if (HcdCapabilities != nullptr)
+	if (Self->_Aggregator.IsEnabled())
 	{
-		*HcdCapabilities = 0;
-	}
-}
+		const KIRQL irql = ExAcquireSpinLockExclusive(&Self->_AggregatorLock);
 
+		//
+		// Merge into the submitted report, the owner always uses its slot
+		// 
+		const bool accepted = (Self->_Aggregator.IsEnabled())
+			                      ? Self->AggregateReport(NewReport, IsOwner ? Self->_SessionId : SessionId,
+			                                              Self->_Aggregator)
+			                      : IsOwner;
 
-#pragma endregion
+		ExReleaseSpinLockExclusive(&Self->_AggregatorLock, irql);
 
-VOID ViGEm::Bus::Core::EmulationTargetPDO::WaitDeviceReadyCompletionWorkerRoutine(IN PVOID StartContext)
-{
-	const auto ctx = static_cast<EmulationTargetPDO*>(StartContext);
+		if (!accepted)
+			return STATUS_ACCESS_DENIED;
+	}
+	else if (!IsOwner)
+		return STATUS_ACCESS_DENIED;
+
+	//
+	// Unlocked peek keeps the common (no profile) case free of lock traffic
+	// 
+	if (Self->_AxisTransform.IsEnabled())
+	{
+		const KIRQL irql = ExAcquireSpinLockShared(&Self->_AxisTransformLock);
+
+		if (Self->_AxisTransform.IsEnabled())
+			Self->ApplyAxisTransform(NewReport, Self->_AxisTransform);
+
+		ExReleaseSpinLockShared(&Self->_AxisTransformLock, irql);
+	}
+
+	if (Self->_MacroBaseEnabled)
+	{
+		KIRQL irql;
+		MACRO_OVERLAY overlay;
+
+		KeAcquireSpinLock(&Self->_MacroReportLock, &irql);
+
+		Self->_MacroBaseReportSize = min(*static_cast<PULONG>(NewReport), MAX_SUBMIT_REPORT_SIZE);
+		RtlCopyMemory(Self->_MacroBaseReport, NewReport, Self->_MacroBaseReportSize);
+		overlay = Self->_MacroOverlay;
+
+		KeReleaseSpinLock(&Self->_MacroReportLock, irql);
+
+		if (overlay.ButtonsSet || overlay.ButtonsClear || overlay.AxisMask)
+			Self->ApplyMacroOverlay(NewReport, overlay);
+	}
+
+	const NTSTATUS status = Self->SubmitReportImpl(NewReport);
+
+	Self->RecordEvent(VIGEM_EVENT_REPORT_SUBMITTED, SessionId, *static_cast<PULONG>(NewReport), status);
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SetAxisTransform(BOOLEAN Enable, const VIGEM_AXIS_PROFILE* Profiles)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	const KIRQL irql = ExAcquireSpinLockExclusive(&this->_AxisTransformLock);
+
+	if (Enable)
+		status = this->_AxisTransform.Load(Profiles);
+	else
+		this->_AxisTransform.Reset();
+
+	ExReleaseSpinLockExclusive(&this->_AxisTransformLock, irql);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSPDO,
+		"Axis transform of serial %d %s with status %!STATUS!",
+		this->_SerialNo,
+		Enable ? "loaded" : "removed",
+		status);
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SetAggregation(BOOLEAN Enable, VIGEM_AGGREGATION_AXIS_MODE AxisMode,
+                                                              UCHAR Priority)
+{
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (AxisMode != VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE && AxisMode != VIGEM_AGGREGATION_AXIS_PRIORITY)
+		return STATUS_INVALID_PARAMETER;
+
+	const KIRQL irql = ExAcquireSpinLockExclusive(&this->_AggregatorLock);
+
+	if (Enable)
+		this->_Aggregator.Enable(this->_SessionId, AxisMode, Priority);
+	else
+		this->_Aggregator.Disable();
+
+	ExReleaseSpinLockExclusive(&this->_AggregatorLock, irql);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSPDO,
+		"Aggregation of serial %d %s (axis mode %d)",
+		this->_SerialNo,
+		Enable ? "enabled" : "disabled",
+		AxisMode);
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::AttachSource(LONG SessionId, BOOLEAN Attach, UCHAR Priority)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	//
+	// The owner is always a source
+	// 
+	if (SessionId == this->_SessionId)
+		return STATUS_INVALID_PARAMETER;
+
+	const KIRQL irql = ExAcquireSpinLockExclusive(&this->_AggregatorLock);
+
+	if (!Attach)
+		status = this->_Aggregator.Detach(SessionId) ? STATUS_SUCCESS : STATUS_NOT_FOUND;
+	else if (!this->_Aggregator.IsEnabled())
+		status = STATUS_ACCESS_DENIED;
+	else
+		status = this->_Aggregator.Attach(SessionId, Priority);
+
+	ExReleaseSpinLockExclusive(&this->_AggregatorLock, irql);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSPDO,
+		"%s session %d to serial %d with status %!STATUS!",
+		Attach ? "Attaching" : "Detaching",
+		SessionId,
+		this->_SerialNo,
+		status);
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SetRecording(BOOLEAN Enable, ULONG Capacity)
+{
+	KIRQL irql;
+	PUCHAR storage = nullptr;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (Enable)
+	{
+		if (Capacity == 0)
+			Capacity = VIGEM_RECORDING_DEFAULT_CAPACITY;
+
+		if (Capacity < VIGEM_RECORDING_MIN_CAPACITY || Capacity > VIGEM_RECORDING_MAX_CAPACITY)
+			return STATUS_INVALID_PARAMETER;
+
+		storage = static_cast<PUCHAR>(ExAllocatePoolWithTag(
+			NonPagedPoolNx,
+			Capacity,
+			REPORT_RECORDER_POOL_TAG
+		));
+
+		if (storage == nullptr)
+			return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	KeAcquireSpinLock(&this->_RecorderLock, &irql);
+
+	//
+	// Swap buffers under the lock, free the old one outside of it
+	// 
+	const PUCHAR previous = this->_Recorder.Stop();
+
+	if (storage)
+		this->_Recorder.Start(storage, Capacity, this->_TargetType, this->_SerialNo, KeQueryInterruptTime());
+
+	KeReleaseSpinLock(&this->_RecorderLock, irql);
+
+	if (previous)
+		ExFreePoolWithTag(previous, REPORT_RECORDER_POOL_TAG);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSPDO,
+		"Recording of serial %d %s (capacity %d)",
+		this->_SerialNo,
+		Enable ? "started" : "stopped",
+		Capacity);
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::DrainRecording(PUCHAR Buffer, ULONG Length, PULONG Written,
+                                                              PULONG Dropped)
+{
+	KIRQL irql;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	KeAcquireSpinLock(&this->_RecorderLock, &irql);
+
+	if (this->_Recorder.IsActive())
+	{
+		*Written = this->_Recorder.Drain(Buffer, Length);
+		*Dropped = this->_Recorder.GetDropped();
+	}
+	else
+		status = STATUS_INVALID_DEVICE_STATE;
+
+	KeReleaseSpinLock(&this->_RecorderLock, irql);
+
+	return status;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::RecordReport(VIGEM_REPORT_LOG_KIND Kind, const VOID* Payload,
+                                                        ULONG Length)
+{
+	KIRQL irql;
+
+	//
+	// Unlocked peek keeps the common (not recording) case free of lock traffic
+	// 
+	if (!this->_Recorder.IsActive())
+		return;
+
+	const ULONGLONG time = KeQueryInterruptTime();
+
+	KeAcquireSpinLock(&this->_RecorderLock, &irql);
+
+	this->_Recorder.Record(Kind, time, Payload, Length);
+
+	KeReleaseSpinLock(&this->_RecorderLock, irql);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SetRawOutput(BOOLEAN Enable, ULONG Capacity)
+{
+	KIRQL irql;
+	PUCHAR storage = nullptr;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (Enable)
+	{
+		if (Capacity == 0)
+			Capacity = VIGEM_RAW_OUTPUT_DEFAULT_CAPACITY;
+
+		if (Capacity < VIGEM_RAW_OUTPUT_MIN_CAPACITY || Capacity > VIGEM_RAW_OUTPUT_MAX_CAPACITY)
+			return STATUS_INVALID_PARAMETER;
+
+		storage = static_cast<PUCHAR>(ExAllocatePoolWithTag(
+			NonPagedPoolNx,
+			Capacity,
+			RAW_OUTPUT_RING_POOL_TAG
+		));
+
+		if (storage == nullptr)
+			return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	KeAcquireSpinLock(&this->_RawOutputLock, &irql);
+
+	const PUCHAR previous = this->_RawOutput.Stop();
+
+	if (storage)
+		this->_RawOutput.Start(storage, Capacity);
+
+	KeReleaseSpinLock(&this->_RawOutputLock, irql);
+
+	if (previous)
+		ExFreePoolWithTag(previous, RAW_OUTPUT_RING_POOL_TAG);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSPDO,
+		"Raw output of serial %d %s (capacity %d)",
+		this->_SerialNo,
+		Enable ? "enabled" : "disabled",
+		Capacity);
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::DrainRawOutput(PUCHAR Buffer, ULONG Length, PULONG Written,
+                                                              PULONG Dropped)
+{
+	KIRQL irql;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	KeAcquireSpinLock(&this->_RawOutputLock, &irql);
+
+	if (this->_RawOutput.IsActive())
+	{
+		*Written = this->_RawOutput.Drain(Buffer, Length);
+		*Dropped = this->_RawOutput.GetDropped();
+	}
+	else
+		status = STATUS_INVALID_DEVICE_STATE;
+
+	KeReleaseSpinLock(&this->_RawOutputLock, irql);
+
+	return status;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::RecordRawOutput(const VOID* Payload, ULONG Length)
+{
+	KIRQL irql;
+
+	//
+	// Unlocked peek keeps the common (disabled) case free of lock traffic
+	// 
+	if (!this->_RawOutput.IsActive())
+		return;
+
+	const ULONGLONG time = KeQueryInterruptTime();
+
+	KeAcquireSpinLock(&this->_RawOutputLock, &irql);
+
+	this->_RawOutput.Write(time, Payload, Length);
+
+	KeReleaseSpinLock(&this->_RawOutputLock, irql);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SetMacro(UCHAR Slot, BOOLEAN Enable, USHORT RepeatCount,
+                                                        USHORT StepCount, const VIGEM_MACRO_STEP* Steps)
+{
+	KIRQL irql;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(WdfPdoGetParent(this->_PdoDevice));
+	MACRO_OVERLAY overlay;
+	ULONG sequence = 0;
+
+	KeAcquireSpinLock(&pFdoData->MacroLock, &irql);
+
+	if (Enable)
+		status = this->_Macros.Load(pFdoData->Macros, GetMacroTicks(), Slot, RepeatCount, StepCount, Steps);
+	else
+		this->_Macros.Unload(pFdoData->Macros, Slot);
+
+	//
+	// Only running macros need the base report of every submit
+	// 
+	this->_MacroBaseEnabled = this->_Macros.IsActive();
+
+	if (NT_SUCCESS(status))
+		sequence = this->CaptureMacroOverlay(overlay);
+
+	const bool pending = !pFdoData->Macros.IsEmpty();
+
+	KeReleaseSpinLock(&pFdoData->MacroLock, irql);
+
+	//
+	// First step takes effect right away, a stopped macro releases its overlay
+	// 
+	if (NT_SUCCESS(status))
+		this->SubmitMacroOverlay(overlay, sequence);
+
+	if (pending)
+		WdfTimerStart(pFdoData->MacroTimer, WDF_REL_TIMEOUT_IN_MS(FDO_MACRO_TICK_MS));
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSPDO,
+		"Macro slot %d of serial %d %s with status %!STATUS!",
+		Slot,
+		this->_SerialNo,
+		Enable ? "started" : "stopped",
+		status);
+
+	return status;
+}
+
+ULONG ViGEm::Bus::Core::EmulationTargetPDO::CaptureMacroOverlay(MACRO_OVERLAY& Overlay)
+{
+	this->_Macros.GetOverlay(Overlay);
+
+	return ++this->_MacroCaptureSequence;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::SubmitMacroOverlay(const MACRO_OVERLAY& Overlay, ULONG Sequence)
+{
+	KIRQL irql;
+	UCHAR report[MAX_SUBMIT_REPORT_SIZE];
+	const MACRO_OVERLAY overlay = Overlay;
+
+	KeAcquireSpinLock(&this->_MacroReportLock, &irql);
+
+	//
+	// A later capture already got submitted
+	// 
+	if (static_cast<LONG>(Sequence - this->_MacroOverlaySequence) <= 0)
+	{
+		KeReleaseSpinLock(&this->_MacroReportLock, irql);
+		return;
+	}
+
+	const ULONG size = this->_MacroBaseReportSize;
+
+	RtlCopyMemory(report, this->_MacroBaseReport, size);
+	this->_MacroOverlay = overlay;
+	this->_MacroOverlaySequence = Sequence;
+
+	KeReleaseSpinLock(&this->_MacroReportLock, irql);
+
+	//
+	// Nothing to overlay until the feeder submitted a report
+	// 
+	if (size == 0)
+		return;
+
+	DispatchTarget(this, [&](auto* Self)
+	{
+		Self->ApplyMacroOverlay(report, overlay);
+
+		Self->RecordEvent(VIGEM_EVENT_MACRO_OVERLAY, overlay.ButtonsSet, overlay.ButtonsClear, overlay.AxisMask);
+
+		(void)Self->SubmitReportImpl(report);
+	});
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::ServiceMacroTick(WDFDEVICE Device)
+{
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+	EmulationTargetPDO* due = nullptr;
+
+	KeAcquireSpinLockAtDpcLevel(&pFdoData->MacroLock);
+
+	//
+	// Targets unregister under this lock on removal and wait for the
+	// rundown, so the ones collected here stay valid until submitted
+	// 
+	for (auto set = pFdoData->Macros.Advance(GetMacroTicks()); set; set = set->NextChanged)
+	{
+		const auto target = static_cast<EmulationTargetPDO*>(set->GetContext());
+
+		if (!ExAcquireRundownProtection(&target->_MacroRundown))
+			continue;
+
+		target->_MacroBaseEnabled = target->_Macros.IsActive();
+		target->_MacroDueSequence = target->CaptureMacroOverlay(target->_MacroDueOverlay);
+		target->_MacroDueNext = due;
+		due = target;
+	}
+
+	const bool pending = !pFdoData->Macros.IsEmpty();
+
+	KeReleaseSpinLockFromDpcLevel(&pFdoData->MacroLock);
+
+	while (due)
+	{
+		const auto target = due;
+		due = target->_MacroDueNext;
+
+		target->SubmitMacroOverlay(target->_MacroDueOverlay, target->_MacroDueSequence);
+
+		ExReleaseRundownProtection(&target->_MacroRundown);
+	}
+
+	return pending;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueNotification(WDFREQUEST Request)
+{
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	//
+	// Buffers must exist before the queue state callback can fire
+	// 
+	const NTSTATUS status = this->AllocateNotificationBuffers(
+		WdfIoQueueGetDevice(WdfRequestGetIoQueue(Request))
+	);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	return WdfRequestForwardToIoQueue(Request, this->_PendingNotificationRequests);
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::IsOwnerProcess() const
+{
+	return this->_OwnerProcessId == current_process_id();
+}
+
+VIGEM_TARGET_TYPE ViGEm::Bus::Core::EmulationTargetPDO::GetType() const
+{
+	return this->_TargetType;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::SetPooled()
+{
+	this->_Pooled = true;
+	this->_OwnerProcessId = 0;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::Claim(LONG SessionId)
+{
+	this->_OwnerProcessId = current_process_id();
+	this->_SessionId = SessionId;
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSPDO,
+		"Pooled serial %d claimed by session %d",
+		this->_SerialNo,
+		SessionId);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::Recycle()
+{
+	KIRQL irql;
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(WdfPdoGetParent(this->_PdoDevice));
+
+	//
+	// The former owner loses access before its state gets reset
+	// 
+	this->_OwnerProcessId = 0;
+	this->_SessionId = FDO_POOL_SESSION_ID;
+
+	KeAcquireSpinLock(&pFdoData->MacroLock, &irql);
+	this->_Macros.Clear(pFdoData->Macros);
+	this->_MacroBaseEnabled = false;
+	KeReleaseSpinLock(&pFdoData->MacroLock, irql);
+
+	//
+	// An overlay still being submitted must not land on the reset state
+	// 
+	ExWaitForRundownProtectionRelease(&this->_MacroRundown);
+	ExReInitializeRundownProtection(&this->_MacroRundown);
+
+	KeAcquireSpinLock(&this->_MacroReportLock, &irql);
+	this->_MacroBaseReportSize = 0;
+	this->_MacroOverlay = {};
+	KeReleaseSpinLock(&this->_MacroReportLock, irql);
+
+	KeAcquireSpinLock(&this->_CoalesceLock, &irql);
+	this->_CoalescedPending = false;
+	KeReleaseSpinLock(&this->_CoalesceLock, irql);
+
+	irql = ExAcquireSpinLockExclusive(&this->_AxisTransformLock);
+	this->_AxisTransform.Reset();
+	ExReleaseSpinLockExclusive(&this->_AxisTransformLock, irql);
+
+	irql = ExAcquireSpinLockExclusive(&this->_AggregatorLock);
+	this->_Aggregator.Disable();
+	ExReleaseSpinLockExclusive(&this->_AggregatorLock, irql);
+
+	KeAcquireSpinLock(&this->_RecorderLock, &irql);
+	const PUCHAR storage = this->_Recorder.Stop();
+	KeReleaseSpinLock(&this->_RecorderLock, irql);
+
+	if (storage)
+		ExFreePoolWithTag(storage, REPORT_RECORDER_POOL_TAG);
+
+	KeAcquireSpinLock(&this->_RawOutputLock, &irql);
+	const PUCHAR rawOutput = this->_RawOutput.Stop();
+	KeReleaseSpinLock(&this->_RawOutputLock, irql);
+
+	if (rawOutput)
+		ExFreePoolWithTag(rawOutput, RAW_OUTPUT_RING_POOL_TAG);
+
+	//
+	// Pending notification requests belong to the former owner
+	// 
+	if (this->_PendingNotificationRequests)
+	{
+		WdfIoQueuePurgeSynchronously(this->_PendingNotificationRequests);
+		WdfIoQueueStart(this->_PendingNotificationRequests);
+	}
+
+	this->PurgeOwnerRequests();
+
+	this->FreeNotificationBuffers();
+
+	this->SubmitNeutralReport();
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSPDO,
+		"Serial %d returned to the pool",
+		this->_SerialNo);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFREQUEST Request)
+{
+	NTSTATUS status;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (!this->_WaitDeviceReadyRequests)
+		return STATUS_INVALID_DEVICE_STATE;
+
+	if (this->_WaitDeviceReadyCompletionWorkerThreadHandle)
+	{
+		status = KeWaitForSingleObject(
+			&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
+			Executive,
+			KernelMode,
+			FALSE,
+			nullptr
+		);
+
+		if (NT_SUCCESS(status))
+		{
+			ZwClose(this->_WaitDeviceReadyCompletionWorkerThreadHandle);
+			this->_WaitDeviceReadyCompletionWorkerThreadHandle = nullptr;
+		}
+		else
+		{
+			TraceEvents(TRACE_LEVEL_WARNING,
+			            TRACE_BUSPDO,
+			            "KeWaitForSingleObject failed with status %!STATUS!",
+			            status
+			);
+		}
+	}
+	
+	status = WdfRequestForwardToIoQueue(Request, this->_WaitDeviceReadyRequests);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_BUSPDO,
+		            "WdfRequestForwardToIoQueue failed with status %!STATUS!",
+		            status
+		);
+
+		return status;
+	}
+
+	OBJECT_ATTRIBUTES threadOb;
+
+	InitializeObjectAttributes(&threadOb, NULL,
+	                           OBJ_KERNEL_HANDLE, NULL, NULL);
+
+	status = PsCreateSystemThread(&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
+	                              static_cast<ACCESS_MASK>(0L),
+	                              &threadOb,
+	                              nullptr,
+	                              nullptr,
+	                              WaitDeviceReadyCompletionWorkerRoutine,
+	                              this
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_BUSPDO,
+		            "PsCreateSystemThread failed with status %!STATUS!",
+		            status
+		);
+	}
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice)
+{
+	NTSTATUS status;
+	WDF_IO_QUEUE_CONFIG plugInQueueConfig;
+
+	// Create and assign queue for incoming interrupt transfer
+	WDF_IO_QUEUE_CONFIG_INIT(&plugInQueueConfig, WdfIoQueueDispatchManual);
+
+	status = WdfIoQueueCreate(
+		ParentDevice,
+		&plugInQueueConfig,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&this->_WaitDeviceReadyRequests
+	);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSPDO,
+			"WdfIoQueueCreate (PendingPlugInRequests) failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	this->MarkPluginPhase(VIGEM_PLUGIN_PHASE_PREPARED);
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::AllocateNotificationBuffers(WDFDEVICE ParentDevice)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	DMF_MODULE_ATTRIBUTES moduleAttributes;
+	DMF_CONFIG_BufferQueue dmfBufferCfg;
+	DMFMODULE bufferQueue;
+
+	PAGED_CODE();
+
+	ExAcquireFastMutex(&this->_NotificationBuffersLock);
+
+	if (this->_UsbInterruptOutBufferQueue)
+	{
+		ExReleaseFastMutex(&this->_NotificationBuffersLock);
+		return status;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = ParentDevice;
+
+	DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(
+		&dmfBufferCfg,
+		&moduleAttributes
+	);
+
+	// Don't auto-grow; start dropping packets on overrun
+	dmfBufferCfg.SourceSettings.EnableLookAside = FALSE;
+	// Maximum number of buffers to be filled and kept queued
+	dmfBufferCfg.SourceSettings.BufferCount = MAX_OUT_BUFFER_QUEUE_COUNT;
+	// Maximum byte count per buffer
+	dmfBufferCfg.SourceSettings.BufferSize = MAX_OUT_BUFFER_QUEUE_SIZE;
+	// Field to store real buffer content length
+	dmfBufferCfg.SourceSettings.BufferContextSize = sizeof(size_t);
+	// "Expensive" memory ;)
+	dmfBufferCfg.SourceSettings.PoolType = NonPagedPoolNx;
+
+	status = DMF_BufferQueue_Create(
+		ParentDevice,
+		&moduleAttributes,
+		&attributes,
+		&bufferQueue
+	);
+
+	if (NT_SUCCESS(status))
+	{
+		InterlockedExchangePointer(
+			reinterpret_cast<PVOID volatile*>(&this->_UsbInterruptOutBufferQueue),
+			bufferQueue
+		);
+	}
+	else
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_BUSPDO,
+		            "DMF_BufferQueue_Create failed with status %!STATUS!",
+		            status
+		);
+	}
+
+	ExReleaseFastMutex(&this->_NotificationBuffersLock);
+
+	return status;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::FreeNotificationBuffers()
+{
+	PAGED_CODE();
+
+	ExAcquireFastMutex(&this->_NotificationBuffersLock);
+
+	const DMFMODULE bufferQueue = this->_UsbInterruptOutBufferQueue;
+
+	if (bufferQueue)
+	{
+		//
+		// Wait for transfers and notifications still using the buffers
+		// 
+		ExWaitForRundownProtectionRelease(&this->_NotificationBuffersRundown);
+
+		this->_UsbInterruptOutBufferQueue = nullptr;
+
+		ExReInitializeRundownProtection(&this->_NotificationBuffersRundown);
+
+		WdfObjectDelete(bufferQueue);
+	}
+
+	ExReleaseFastMutex(&this->_NotificationBuffersLock);
+}
+
+DMFMODULE ViGEm::Bus::Core::EmulationTargetPDO::ReferenceNotificationBuffers()
+{
+	if (!ExAcquireRundownProtection(&this->_NotificationBuffersRundown))
+		return nullptr;
+
+	const DMFMODULE bufferQueue = this->_UsbInterruptOutBufferQueue;
+
+	if (!bufferQueue)
+		ExReleaseRundownProtection(&this->_NotificationBuffersRundown);
+
+	return bufferQueue;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::DereferenceNotificationBuffers()
+{
+	ExReleaseRundownProtection(&this->_NotificationBuffersRundown);
+}
+
+ULONG ViGEm::Bus::Core::EmulationTargetPDO::GetResources()
+{
+	ULONG resources = 0;
+	KIRQL irql;
+
+	if (this->_UsbInterruptOutBufferQueue)
+		resources |= VIGEM_TARGET_RESOURCE_NOTIFICATION_BUFFERS;
+
+	KeAcquireSpinLock(&this->_RecorderLock, &irql);
+	if (this->_Recorder.IsActive())
+		resources |= VIGEM_TARGET_RESOURCE_REPORT_LOG;
+	KeReleaseSpinLock(&this->_RecorderLock, irql);
+
+	KeAcquireSpinLock(&this->_RawOutputLock, &irql);
+	if (this->_RawOutput.IsActive())
+		resources |= VIGEM_TARGET_RESOURCE_RAW_OUTPUT;
+	KeReleaseSpinLock(&this->_RawOutputLock, irql);
+
+	return resources;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::GetFootprint(PVIGEM_TARGET_FOOTPRINT Footprint)
+{
+	KIRQL irql;
+
+	RtlZeroMemory(Footprint, sizeof(VIGEM_TARGET_FOOTPRINT));
+
+	DispatchTarget(this, [&](auto* Target)
+	{
+		Footprint->ObjectSize = sizeof(*Target);
+		Footprint->Resources = Target->GetResources();
+	});
+
+	if (Footprint->Resources & VIGEM_TARGET_RESOURCE_NOTIFICATION_BUFFERS)
+	{
+		Footprint->NotificationBufferSize = static_cast<ULONG>(
+			MAX_OUT_BUFFER_QUEUE_COUNT * (MAX_OUT_BUFFER_QUEUE_SIZE + sizeof(size_t)));
+	}
+
+	KeAcquireSpinLock(&this->_RecorderLock, &irql);
+	Footprint->ReportLogSize = this->_Recorder.GetCapacity();
+	KeReleaseSpinLock(&this->_RecorderLock, irql);
+
+	KeAcquireSpinLock(&this->_RawOutputLock, &irql);
+	Footprint->RawOutputSize = this->_RawOutput.GetCapacity();
+	KeReleaseSpinLock(&this->_RawOutputLock, irql);
+}
+
+unsigned long ViGEm::Bus::Core::EmulationTargetPDO::current_process_id()
+{
+	return static_cast<DWORD>(reinterpret_cast<DWORD_PTR>(PsGetCurrentProcessId()) & 0xFFFFFFFF);
+}
+
+#pragma region USB Interface Functions
+
+BOOLEAN USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceIsDeviceHighSpeed(IN PVOID BusContext)
+{
+	UNREFERENCED_PARAMETER(BusContext);
+
+	return TRUE;
+}
+
+NTSTATUS USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceQueryBusInformation(
+	IN PVOID BusContext, IN ULONG Level,
+	IN OUT PVOID BusInformationBuffer,
+	IN OUT PULONG BusInformationBufferLength,
+	OUT PULONG BusInformationActualLength)
+{
+	UNREFERENCED_PARAMETER(BusContext);
+	UNREFERENCED_PARAMETER(Level);
+	UNREFERENCED_PARAMETER(BusInformationBuffer);
+	UNREFERENCED_PARAMETER(BusInformationBufferLength);
+	UNREFERENCED_PARAMETER(BusInformationActualLength);
+
+	return STATUS_UNSUCCESSFUL;
+}
+
+NTSTATUS USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceSubmitIsoOutUrb(IN PVOID BusContext, IN PURB Urb)
+{
+	UNREFERENCED_PARAMETER(BusContext);
+	UNREFERENCED_PARAMETER(Urb);
+
+	return STATUS_UNSUCCESSFUL;
+}
+
+NTSTATUS USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceQueryBusTime(
+	IN PVOID BusContext, IN OUT PULONG CurrentUsbFrame)
+{
+	UNREFERENCED_PARAMETER(BusContext);
+	UNREFERENCED_PARAMETER(CurrentUsbFrame);
+
+	return STATUS_UNSUCCESSFUL;
+}
+
+VOID USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceGetUSBDIVersion(IN PVOID BusContext,
+	IN OUT PUSBD_VERSION_INFORMATION
+	VersionInformation,
+	IN OUT PULONG HcdCapabilities)
+{
+	UNREFERENCED_PARAMETER(BusContext);
+
+	if (VersionInformation != nullptr)
+	{
+		VersionInformation->USBDI_Version = 0x500; /* Usbport */
+		VersionInformation->Supported_USB_Version = 0x200; /* USB 2.0 */
+	}
+
+	if (HcdCapabilities != nullptr)
+	{
+		*HcdCapabilities = 0;
+	}
+}
+
+
+#pragma endregion
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::WaitDeviceReadyCompletionWorkerRoutine(IN PVOID StartContext)
+{
+	const auto ctx = static_cast<EmulationTargetPDO*>(StartContext);
 
 	WDFREQUEST waitRequest;
 	LARGE_INTEGER timeout;
@@ -675,44 +1615,12 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::WaitDeviceReadyCompletionWorkerRoutin
 
 	ZwClose(ctx->_WaitDeviceReadyCompletionWorkerThreadHandle);
 	ctx->_WaitDeviceReadyCompletionWorkerThreadHandle = nullptr;
-	KeClearEvent(&ctx->_PdoBootNotificationEvent);
-	(void)PsTerminateSystemThread(0);
-}
-
-VOID ViGEm::Bus::Core::EmulationTargetPDO::DumpAsHex(PCSTR Prefix, PVOID Buffer, ULONG BufferLength)
-{
-#ifdef DBG
-
-	size_t dumpBufferLength = ((BufferLength * sizeof(CHAR)) * 2) + 1;
-	PSTR dumpBuffer = static_cast<PSTR>(ExAllocatePoolWithTag(
-		NonPagedPoolNx,
-		dumpBufferLength,
-		'1234'
-	));
-	if (dumpBuffer)
-	{
-
-		RtlZeroMemory(dumpBuffer, dumpBufferLength);
-
-		for (ULONG i = 0; i < BufferLength; i++)
-		{
-			sprintf(&dumpBuffer[i * 2], "%02X", static_cast<PUCHAR>(Buffer)[i]);
-		}
-
-		TraceDbg(TRACE_BUSPDO,
-			"%s - Buffer length: %04d, buffer content: %s\n",
-			Prefix,
-			BufferLength,
-			dumpBuffer
-		);
 
-		ExFreePoolWithTag(dumpBuffer, '1234');
-	}
-#else
-	UNREFERENCED_PARAMETER(Prefix);
-	UNREFERENCED_PARAMETER(Buffer);
-	UNREFERENCED_PARAMETER(BufferLength);
-#endif
+	//
+	// The event stays signaled once booted, so waits for a pooled target
+	// claimed again complete right away
+	// 
+	(void)PsTerminateSystemThread(0);
 }
 
 void ViGEm::Bus::Core::EmulationTargetPDO::UsbAbortPipe()
@@ -756,6 +1664,8 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::UsbSelectConfiguration(PURB Urb)
 		">> >> >> URB_FUNCTION_SELECT_CONFIGURATION: TotalLength %d",
 		Urb->UrbHeader.Length);
 
+	this->MarkPluginPhase(VIGEM_PLUGIN_PHASE_CONFIGURED);
+
 	if (Urb->UrbHeader.Length == sizeof(struct _URB_SELECT_CONFIGURATION))
 	{
 		TraceDbg(
@@ -775,6 +1685,14 @@ _ProductId(ProductId)
 {
 	this->_OwnerProcessId = current_process_id();
 	KeInitializeEvent(&this->_PdoBootNotificationEvent, NotificationEvent, FALSE);
+	KeInitializeSpinLock(&this->_RecorderLock);
+	KeInitializeSpinLock(&this->_RawOutputLock);
+	KeInitializeSpinLock(&this->_MacroReportLock);
+	KeInitializeSpinLock(&this->_CoalesceLock);
+	ExInitializeRundownProtection(&this->_NotificationBuffersRundown);
+	ExInitializeRundownProtection(&this->_MacroRundown);
+	ExInitializeFastMutex(&this->_NotificationBuffersLock);
+	SessionTargetList::InitializeLink(&this->_SessionLink, Serial);
 
 	WDF_DEVICE_PNP_CAPABILITIES_INIT(&this->_PnpCapabilities);
 	WDF_DEVICE_POWER_CAPABILITIES_INIT(&this->_PowerCapabilities);
@@ -783,27 +1701,12 @@ _ProductId(ProductId)
 bool ViGEm::Bus::Core::EmulationTargetPDO::GetPdoBySerial(
 	IN WDFDEVICE ParentDevice, IN ULONG SerialNo, OUT EmulationTargetPDO** Object)
 {
-	WDF_CHILD_RETRIEVE_INFO info;
+	EmulationTargetPDO* target = FdoGetData(ParentDevice)->Serials.Lookup(SerialNo);
 
-	const WDFCHILDLIST list = WdfFdoGetDefaultChildList(ParentDevice);
-
-	PDO_IDENTIFICATION_DESCRIPTION description;
-
-	WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
-
-	//
-	// Identify by serial number
-	// 
-	description.SerialNo = SerialNo;
-
-	WDF_CHILD_RETRIEVE_INFO_INIT(&info, &description.Header);
-
-	const WDFDEVICE pdoDevice = WdfChildListRetrievePdo(list, &info);
-
-	if (pdoDevice == nullptr)
+	if (target == nullptr)
 		return false;
 
-	*Object = EmulationTargetPdoGetContext(pdoDevice)->Target;
+	*Object = target;
 
 	return true;
 }
@@ -833,66 +1736,72 @@ BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::EvtChildListIdentificationDescript
 	return (lhs->SerialNo == rhs->SerialNo) ? TRUE : FALSE;
 }
 
-
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFDEVICE ParentDevice, ULONG SerialNo,
-                                                                      WDFREQUEST Request)
+VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtChildListIdentificationDescriptionCleanup(
+	WDFCHILDLIST DeviceList,
+	PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER IdentificationDescription)
 {
-	NTSTATUS status;
-	PDO_IDENTIFICATION_DESCRIPTION description;
-	WDF_CHILD_LIST_ITERATOR iterator;
-	WDF_CHILD_RETRIEVE_INFO childInfo;
-	WDFDEVICE childDevice;
+	const auto description = CONTAINING_RECORD(IdentificationDescription,
+		ViGEm::Bus::Core::PDO_IDENTIFICATION_DESCRIPTION,
+		Header);
 
-	TraceDbg(TRACE_BUSPDO, "%!FUNC! Entry");
-	
-	const WDFCHILDLIST list = WdfFdoGetDefaultChildList(ParentDevice);
+	//
+	// Children removed before their PDO got created leave the target behind
+	// 
+	if (description->Target != nullptr
+		&& DisposeOffline(WdfChildListGetDevice(DeviceList), description->SerialNo, description->Target))
+	{
+		TraceEvents(TRACE_LEVEL_INFORMATION,
+			TRACE_BUSPDO,
+			"Disposed target with serial %d that never came online",
+			description->SerialNo);
+	}
+}
 
-	WDF_CHILD_LIST_ITERATOR_INIT(
-		&iterator,
-		WdfRetrieveAddedChildren // might not be online yet
-	);
-	WdfChildListBeginIteration(
-		list,
-		&iterator
-	);
+bool ViGEm::Bus::Core::EmulationTargetPDO::DisposeOffline(WDFDEVICE ParentDevice, ULONG SerialNo,
+                                                          EmulationTargetPDO* Target)
+{
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(ParentDevice);
 
-	WDF_CHILD_RETRIEVE_INFO_INIT(
-		&childInfo,
-		&description.Header
-	);
+	//
+	// Claims the target, it mustn't be touched before
+	// 
+	if (!pFdoData->Serials.ReleaseOffline(SerialNo, Target))
+		return false;
+
+	ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+	SessionTargetList::Remove(&Target->_SessionLink);
+	ExReleaseFastMutex(&pFdoData->SessionTargetLock);
 
 	//
-	// Compare to find explicit PDO asked for (by serial)
+	// Created by PdoPrepare with the FDO as parent
 	// 
-	childInfo.EvtChildListIdentificationDescriptionCompare = EvtChildListIdentificationDescriptionCompare;
+	if (Target->_WaitDeviceReadyRequests)
+	{
+		WdfIoQueuePurgeSynchronously(Target->_WaitDeviceReadyRequests);
+		WdfObjectDelete(Target->_WaitDeviceReadyRequests);
+	}
 
-	WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(
-		&description.Header,
-		sizeof(description)
-	);
+	delete Target;
+
+	return true;
+}
 
-	// ReSharper disable once CppAssignedValueIsNeverUsed
-	description.SerialNo = SerialNo;
 
-	status = WdfChildListRetrieveNextDevice(
-		list,
-		&iterator,
-		&childDevice, // is NULL due to WdfRetrievePendingChildren
-		&childInfo
-	);
-	if (NT_SUCCESS(status))
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFDEVICE ParentDevice, ULONG SerialNo,
+                                                                      WDFREQUEST Request)
+{
+	NTSTATUS status = STATUS_DEVICE_DOES_NOT_EXIST;
+
+	TraceDbg(TRACE_BUSPDO, "%!FUNC! Entry");
+
+	//
+	// The PDO might not be online yet
+	// 
+	if (EmulationTargetPDO* target = FdoGetData(ParentDevice)->Serials.LookupAdded(SerialNo))
 	{
-		//
-		// Object pointer filled after successful retrieval
-		// 
-		status = description.Target->EnqueueWaitDeviceReady(Request);
+		status = target->EnqueueWaitDeviceReady(Request);
 	}
 
-	WdfChildListEndIteration(
-		list,
-		&iterator
-	);
-
 	TraceDbg(TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
 	
 	return status;
@@ -913,11 +1822,46 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EvtDevicePrepareHardware(
 
 	NTSTATUS status = ctx->Target->PdoPrepareHardware();
 
+	if (NT_SUCCESS(status))
+	{
+		ctx->Target->MarkPluginPhase(VIGEM_PLUGIN_PHASE_HARDWARE_PREPARED);
+	}
+
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
 
 	return status;
 }
 
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceD0Exit(
+	_In_ WDFDEVICE Device,
+	_In_ WDF_POWER_DEVICE_STATE TargetState
+)
+{
+	ULONG queuedRequests = 0;
+
+	UNREFERENCED_PARAMETER(TargetState);
+
+	const auto ctx = EmulationTargetPdoGetContext(Device);
+
+	//
+	// The host stopped talking to the device; drop the notification buffers
+	// unless the owner is still waiting or has not collected everything yet
+	// 
+	if (const DMFMODULE bufferQueue = ctx->Target->ReferenceNotificationBuffers())
+	{
+		WdfIoQueueGetState(ctx->Target->_PendingNotificationRequests, &queuedRequests, nullptr);
+
+		const bool isIdle = queuedRequests == 0 && DMF_BufferQueue_Count(bufferQueue) == 0;
+
+		ctx->Target->DereferenceNotificationBuffers();
+
+		if (isIdle)
+			ctx->Target->FreeNotificationBuffers();
+	}
+
+	return STATUS_SUCCESS;
+}
+
 VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl(
 	_In_ WDFQUEUE Queue,
 	_In_ WDFREQUEST Request,
@@ -932,241 +1876,251 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl(
 	UNREFERENCED_PARAMETER(InputBufferLength);
 
 	NTSTATUS status = STATUS_INVALID_PARAMETER;
-	PIRP irp;
-	PURB urb;
-	PIO_STACK_LOCATION irpStack;
-
-	TraceDbg(TRACE_BUSPDO, "%!FUNC! Entry");
+	ULONG queuedRequests;
 
 	// No help from the framework available from here on
-	irp = WdfRequestWdmGetIrp(Request);
-	irpStack = IoGetCurrentIrpStackLocation(irp);
+	const PIRP irp = WdfRequestWdmGetIrp(Request);
 
-	switch (IoControlCode)
+	if (IoControlCode == IOCTL_INTERNAL_USB_SUBMIT_URB)
 	{
-	case IOCTL_INTERNAL_USB_SUBMIT_URB:
-
-		TraceDbg(
-			TRACE_BUSPDO,
-			">> IOCTL_INTERNAL_USB_SUBMIT_URB");
+		const PURB urb = static_cast<PURB>(URB_FROM_IRP(irp));
 
-		urb = static_cast<PURB>(URB_FROM_IRP(irp));
-
-		switch (urb->UrbHeader.Function)
+		//
+		// Interrupt transfers are nearly all of the steady state traffic,
+		// keep them clear of tracing and the handler table
+		// 
+		if (urb->UrbHeader.Function == URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER)
 		{
-		case URB_FUNCTION_CONTROL_TRANSFER:
-
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_CONTROL_TRANSFER");
-
-			status = ctx->Target->UsbControlTransfer(urb);
-
-			break;
-
-		case URB_FUNCTION_CONTROL_TRANSFER_EX:
-
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_CONTROL_TRANSFER_EX");
-
-			status = STATUS_UNSUCCESSFUL;
-
-			break;
-
-		case URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER:
-
-			TraceDbg(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER");
-
-			status = ctx->Target->UsbBulkOrInterruptTransfer(&urb->UrbBulkOrInterruptTransfer, Request);
-
-			break;
-
-		case URB_FUNCTION_SELECT_CONFIGURATION:
-
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_SELECT_CONFIGURATION");
-
-			status = ctx->Target->UsbSelectConfiguration(urb);
-
-			break;
-
-		case URB_FUNCTION_SELECT_INTERFACE:
-
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_SELECT_INTERFACE");
-
-			status = ctx->Target->UsbSelectInterface(urb);
-
-			break;
-
-		case URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE:
-
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE");
+			ctx->Target->_UrbStatistics.Hit(VIGEM_URB_STAT_BULK_OR_INTERRUPT_TRANSFER);
 
-			switch (urb->UrbControlDescriptorRequest.DescriptorType)
+			status = DispatchTarget(ctx->Target, [&](auto* Target)
 			{
-			case USB_DEVICE_DESCRIPTOR_TYPE:
-
-				TraceEvents(TRACE_LEVEL_VERBOSE,
-					TRACE_BUSPDO,
-					">> >> >> USB_DEVICE_DESCRIPTOR_TYPE");
+				return Target->UsbBulkOrInterruptTransfer(&urb->UrbBulkOrInterruptTransfer, Request);
+			});
 
-				status = ctx->Target->UsbGetDeviceDescriptorType(
-					static_cast<PUSB_DEVICE_DESCRIPTOR>(urb->UrbControlDescriptorRequest.TransferBuffer));
-
-				break;
+			ctx->Target->RecordEvent(
+				VIGEM_EVENT_URB_INTERRUPT,
+				urb->UrbBulkOrInterruptTransfer.TransferFlags,
+				urb->UrbBulkOrInterruptTransfer.TransferBufferLength,
+				status
+			);
+		}
+		else
+		{
+			status = ctx->Target->UsbDispatchUrb(urb, Request);
+		}
 
-			case USB_CONFIGURATION_DESCRIPTOR_TYPE:
+		if (status != STATUS_PENDING)
+		{
+			WdfRequestComplete(Request, status);
+		}
 
-				TraceEvents(TRACE_LEVEL_VERBOSE,
-					TRACE_BUSPDO,
-					">> >> >> USB_CONFIGURATION_DESCRIPTOR_TYPE");
+		return;
+	}
 
-				status = ctx->Target->UsbGetConfigurationDescriptorType(urb);
+	TraceDbg(TRACE_BUSPDO, "%!FUNC! Entry");
 
-				break;
+	const PIO_STACK_LOCATION irpStack = IoGetCurrentIrpStackLocation(irp);
 
-			case USB_STRING_DESCRIPTOR_TYPE:
+	switch (IoControlCode)
+	{
+	case IOCTL_INTERNAL_USB_GET_PORT_STATUS:
 
-				TraceEvents(TRACE_LEVEL_VERBOSE,
-					TRACE_BUSPDO,
-					">> >> >> USB_STRING_DESCRIPTOR_TYPE");
+		TraceEvents(TRACE_LEVEL_VERBOSE,
+			TRACE_BUSPDO,
+			">> IOCTL_INTERNAL_USB_GET_PORT_STATUS");
 
-				status = ctx->Target->UsbGetStringDescriptorType(urb);
+		// We report the (virtual) port as always active
+		*static_cast<unsigned long*>(irpStack->Parameters.Others.Argument1) = USBD_PORT_ENABLED | USBD_PORT_CONNECTED;
 
-				break;
+		status = STATUS_SUCCESS;
 
-			default:
+		break;
 
-				TraceEvents(TRACE_LEVEL_VERBOSE,
-					TRACE_BUSPDO,
-					">> >> >> Unknown descriptor type");
+	case IOCTL_INTERNAL_USB_RESET_PORT:
 
-				break;
-			}
+		TraceEvents(TRACE_LEVEL_VERBOSE,
+			TRACE_BUSPDO,
+			">> IOCTL_INTERNAL_USB_RESET_PORT");
 
-			TraceDbg(
-				TRACE_BUSPDO,
-				"<< <<");
+		// Sure, why not ;)
+		status = STATUS_SUCCESS;
 
-			break;
+		break;
 
-		case URB_FUNCTION_GET_STATUS_FROM_DEVICE:
+	case IOCTL_INTERNAL_USB_SUBMIT_IDLE_NOTIFICATION:
 
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_GET_STATUS_FROM_DEVICE");
+		TraceEvents(TRACE_LEVEL_VERBOSE,
+			TRACE_BUSPDO,
+			">> IOCTL_INTERNAL_USB_SUBMIT_IDLE_NOTIFICATION");
 
-			// Defaults always succeed
-			status = STATUS_SUCCESS;
+		//
+		// A hub calls the request's callback once the port may suspend and
+		// completes it on resume. Completing it right away ended every idle
+		// period at once, so the function driver re-armed its idle timer and
+		// submitted it again, a periodic wakeup of each idle target. The
+		// emulated port never suspends (no remote wakeup to resume on the
+		// next report), so the request is held until the function driver
+		// cancels it because it needs the device, or the device goes away.
+		// 
+		WdfIoQueueGetState(ctx->Target->_PendingIdleNotification, &queuedRequests, nullptr);
 
+		if (queuedRequests > 0)
+		{
+			status = STATUS_DEVICE_BUSY;
 			break;
+		}
 
-		case URB_FUNCTION_ABORT_PIPE:
+		status = WdfRequestForwardToIoQueue(Request, ctx->Target->_PendingIdleNotification);
 
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_ABORT_PIPE");
+		if (NT_SUCCESS(status))
+			status = STATUS_PENDING;
 
-			ctx->Target->UsbAbortPipe();
+		break;
 
-			break;
+	default:
+
+		TraceEvents(TRACE_LEVEL_VERBOSE,
+			TRACE_BUSPDO,
+			">> Unknown I/O control code 0x%X",
+			IoControlCode);
 
-		case URB_FUNCTION_CLASS_INTERFACE:
+		break;
+	}
 
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_CLASS_INTERFACE");
+	if (status != STATUS_PENDING)
+	{
+		WdfRequestComplete(Request, status);
+	}
 
-			status = ctx->Target->UsbClassInterface(urb);
+	TraceDbg(TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
+}
 
-			break;
+//
+// Order matches VIGEM_URB_STATISTIC
+// 
+const ViGEm::Bus::Core::EmulationTargetPDO::URB_HANDLER ViGEm::Bus::Core::EmulationTargetPDO::UrbHandlers[] =
+{
+	// VIGEM_URB_STAT_BULK_OR_INTERRUPT_TRANSFER
+	[](EmulationTargetPDO* Target, PURB Urb, WDFREQUEST Request)
+	{
+		return Target->UsbBulkOrInterruptTransfer(&Urb->UrbBulkOrInterruptTransfer, Request);
+	},
+	// VIGEM_URB_STAT_CONTROL_TRANSFER
+	[](EmulationTargetPDO* Target, PURB Urb, WDFREQUEST)
+	{
+		return Target->UsbControlTransfer(Urb);
+	},
+	// VIGEM_URB_STAT_CONTROL_TRANSFER_EX
+	[](EmulationTargetPDO*, PURB, WDFREQUEST) -> NTSTATUS
+	{
+		return STATUS_UNSUCCESSFUL;
+	},
+	// VIGEM_URB_STAT_SELECT_CONFIGURATION
+	[](EmulationTargetPDO* Target, PURB Urb, WDFREQUEST)
+	{
+		return Target->UsbSelectConfiguration(Urb);
+	},
+	// VIGEM_URB_STAT_SELECT_INTERFACE
+	[](EmulationTargetPDO* Target, PURB Urb, WDFREQUEST)
+	{
+		return Target->UsbSelectInterface(Urb);
+	},
+	// VIGEM_URB_STAT_GET_DESCRIPTOR_FROM_DEVICE
+	[](EmulationTargetPDO* Target, PURB Urb, WDFREQUEST)
+	{
+		return Target->UsbGetDescriptorFromDevice(Urb);
+	},
+	// VIGEM_URB_STAT_GET_STATUS_FROM_DEVICE
+	[](EmulationTargetPDO*, PURB, WDFREQUEST) -> NTSTATUS
+	{
+		// Defaults always succeed
+		return STATUS_SUCCESS;
+	},
+	// VIGEM_URB_STAT_ABORT_PIPE
+	[](EmulationTargetPDO* Target, PURB, WDFREQUEST) -> NTSTATUS
+	{
+		Target->UsbAbortPipe();
 
-		case URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE:
+		// Pipes get aborted, the request itself is still reported as failed
+		return STATUS_INVALID_PARAMETER;
+	},
+	// VIGEM_URB_STAT_CLASS_INTERFACE
+	[](EmulationTargetPDO* Target, PURB Urb, WDFREQUEST)
+	{
+		return Target->UsbClassInterface(Urb);
+	},
+	// VIGEM_URB_STAT_GET_DESCRIPTOR_FROM_INTERFACE
+	[](EmulationTargetPDO* Target, PURB Urb, WDFREQUEST)
+	{
+		return Target->UsbGetDescriptorFromInterface(Urb);
+	},
+	// VIGEM_URB_STAT_OTHER
+	[](EmulationTargetPDO*, PURB Urb, WDFREQUEST) -> NTSTATUS
+	{
+		TraceEvents(TRACE_LEVEL_VERBOSE,
+			TRACE_BUSPDO,
+			">> >>  Unknown function: 0x%X",
+			Urb->UrbHeader.Function);
 
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE");
+		return STATUS_INVALID_PARAMETER;
+	},
+};
 
-			status = ctx->Target->UsbGetDescriptorFromInterface(urb);
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::UsbDispatchUrb(PURB Urb, WDFREQUEST Request)
+{
+	static_assert(ARRAYSIZE(UrbHandlers) == VIGEM_URB_STAT_COUNT, "UrbHandlers must cover VIGEM_URB_STATISTIC");
 
-			break;
+	const VIGEM_URB_STATISTIC statistic = UrbStatistics::Classify(Urb->UrbHeader.Function);
 
-		default:
+	this->_UrbStatistics.Hit(statistic);
 
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSPDO,
-				">> >>  Unknown function: 0x%X",
-				urb->UrbHeader.Function);
+	const NTSTATUS status = UrbHandlers[statistic](this, Urb, Request);
 
-			break;
-		}
+	this->RecordEvent(VIGEM_EVENT_URB_OTHER, Urb->UrbHeader.Function, status);
 
-		TraceDbg(
-			TRACE_BUSPDO,
-			"<<");
+	return status;
+}
 
-		break;
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::UsbGetDescriptorFromDevice(PURB Urb)
+{
+	this->MarkPluginPhase(VIGEM_PLUGIN_PHASE_DESCRIPTOR_REQUESTED);
 
-	case IOCTL_INTERNAL_USB_GET_PORT_STATUS:
+	switch (Urb->UrbControlDescriptorRequest.DescriptorType)
+	{
+	case USB_DEVICE_DESCRIPTOR_TYPE:
 
 		TraceEvents(TRACE_LEVEL_VERBOSE,
 			TRACE_BUSPDO,
-			">> IOCTL_INTERNAL_USB_GET_PORT_STATUS");
-
-		// We report the (virtual) port as always active
-		*static_cast<unsigned long*>(irpStack->Parameters.Others.Argument1) = USBD_PORT_ENABLED | USBD_PORT_CONNECTED;
-
-		status = STATUS_SUCCESS;
+			">> >> >> USB_DEVICE_DESCRIPTOR_TYPE");
 
-		break;
+		return this->UsbGetDeviceDescriptorType(
+			static_cast<PUSB_DEVICE_DESCRIPTOR>(Urb->UrbControlDescriptorRequest.TransferBuffer));
 
-	case IOCTL_INTERNAL_USB_RESET_PORT:
+	case USB_CONFIGURATION_DESCRIPTOR_TYPE:
 
 		TraceEvents(TRACE_LEVEL_VERBOSE,
 			TRACE_BUSPDO,
-			">> IOCTL_INTERNAL_USB_RESET_PORT");
+			">> >> >> USB_CONFIGURATION_DESCRIPTOR_TYPE");
 
-		// Sure, why not ;)
-		status = STATUS_SUCCESS;
-
-		break;
+		return this->UsbGetConfigurationDescriptorType(Urb);
 
-	case IOCTL_INTERNAL_USB_SUBMIT_IDLE_NOTIFICATION:
+	case USB_STRING_DESCRIPTOR_TYPE:
 
 		TraceEvents(TRACE_LEVEL_VERBOSE,
 			TRACE_BUSPDO,
-			">> IOCTL_INTERNAL_USB_SUBMIT_IDLE_NOTIFICATION");
-
-		// TODO: implement?
-		// This happens if the I/O latency is too high so HIDUSB aborts communication.
-		status = STATUS_SUCCESS;
+			">> >> >> USB_STRING_DESCRIPTOR_TYPE");
 
-		break;
+		return this->UsbGetStringDescriptorType(Urb);
 
 	default:
 
 		TraceEvents(TRACE_LEVEL_VERBOSE,
 			TRACE_BUSPDO,
-			">> Unknown I/O control code 0x%X",
-			IoControlCode);
-
-		break;
-	}
+			">> >> >> Unknown descriptor type");
 
-	if (status != STATUS_PENDING)
-	{
-		WdfRequestComplete(Request, status);
+		return STATUS_INVALID_PARAMETER;
 	}
-
-	TraceDbg(TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
 }
 
 void ViGEm::Bus::Core::EmulationTargetPDO::EvtWdfIoPendingNotificationQueueState(
@@ -1176,13 +2130,23 @@ void ViGEm::Bus::Core::EmulationTargetPDO::EvtWdfIoPendingNotificationQueueState
 {
 	const auto pThis = static_cast<EmulationTargetPDO*>(Context);
 
+	const DMFMODULE bufferQueue = pThis->ReferenceNotificationBuffers();
+
+	if (!bufferQueue)
+	{
+		return;
+	}
+
 	//
 	// No buffer available to answer the request with, leave queued
 	// 
-	if (DMF_BufferQueue_Count(pThis->_UsbInterruptOutBufferQueue) == 0)
+	if (DMF_BufferQueue_Count(bufferQueue) != 0)
 	{
-		return;
+		DispatchTarget(pThis, [&](auto* Target)
+		{
+			Target->ProcessPendingNotification(Queue, bufferQueue);
+		});
 	}
-	
-	pThis->ProcessPendingNotification(Queue);
+
+	pThis->DereferenceNotificationBuffers();
 }
@@ -47,6 +47,17 @@
 
 #include <ViGEm/Common.h>
 
+#include "AxisTransform.hpp"
+#include "ReportAggregator.hpp"
+#include "ReportRecorder.hpp"
+#include "RawOutputRing.hpp"
+#include "MacroScheduler.hpp"
+#include "SessionTargetList.hpp"
+#include "UrbStatistics.hpp"
+#include "PollPhase.hpp"
+#include "PluginTimeline.hpp"
+#include "EventTrace.hpp"
+
 //
 // Some insane macro-magic =3
 // 
@@ -65,6 +76,12 @@ namespace ViGEm::Bus::Core
 
 		virtual ~EmulationTargetPDO() = default;
 
+		static bool GetPdoBySerial(
+			IN WDFDEVICE ParentDevice,
+			IN ULONG SerialNo,
+			OUT EmulationTargetPDO** Object
+		);
+
 		static bool GetPdoByTypeAndSerial(
 			IN WDFDEVICE ParentDevice,
 			IN VIGEM_TARGET_TYPE Type,
@@ -79,6 +96,15 @@ namespace ViGEm::Bus::Core
 
 		static EVT_WDF_CHILD_LIST_IDENTIFICATION_DESCRIPTION_COMPARE EvtChildListIdentificationDescriptionCompare;
 
+		static EVT_WDF_CHILD_LIST_IDENTIFICATION_DESCRIPTION_CLEANUP EvtChildListIdentificationDescriptionCleanup;
+
+		//
+		// Frees a target whose device object was never created, along with its
+		// serial. Does nothing if the serial is no longer bound to it offline,
+		// the device object's cleanup frees it then.
+		// 
+		static bool DisposeOffline(WDFDEVICE ParentDevice, ULONG SerialNo, EmulationTargetPDO* Target);
+
 		virtual NTSTATUS PdoPrepareDevice(PWDFDEVICE_INIT DeviceInit,
 			PUNICODE_STRING DeviceId,
 			PUNICODE_STRING DeviceDescription) = 0;
@@ -116,14 +142,123 @@ namespace ViGEm::Bus::Core
 
 		virtual NTSTATUS UsbControlTransfer(PURB Urb) = 0;
 
-		NTSTATUS SubmitReport(PVOID NewReport);
+		NTSTATUS SubmitReport(PVOID NewReport, LONG SessionId);
+
+		//
+		// Fails with the status SubmitReport would for a report the session
+		// may not submit, without submitting it
+		// 
+		NTSTATUS ValidateReport(PVOID NewReport, LONG SessionId);
+
+		//
+		// Holds back a report exceeding its session's rate as the latest
+		// pending state. Returns true if the caller must schedule delivery:
+		// nothing was pending, or the pending report was another session's,
+		// whose delivery slot the report must not inherit.
+		// 
+		bool CoalesceReport(PVOID NewReport, LONG SessionId);
+
+		//
+		// Delivers the pending report at the given interrupt time
+		// 
+		VOID ScheduleCoalescedReport(ULONGLONG DueTime);
+
+		NTSTATUS SetAxisTransform(BOOLEAN Enable, const VIGEM_AXIS_PROFILE* Profiles);
+
+		NTSTATUS SetAggregation(BOOLEAN Enable, VIGEM_AGGREGATION_AXIS_MODE AxisMode, UCHAR Priority);
+
+		NTSTATUS AttachSource(LONG SessionId, BOOLEAN Attach, UCHAR Priority);
+
+		NTSTATUS SetRecording(BOOLEAN Enable, ULONG Capacity);
+
+		NTSTATUS DrainRecording(PUCHAR Buffer, ULONG Length, PULONG Written, PULONG Dropped);
+
+		NTSTATUS SetRawOutput(BOOLEAN Enable, ULONG Capacity);
+
+		NTSTATUS DrainRawOutput(PUCHAR Buffer, ULONG Length, PULONG Written, PULONG Dropped);
+
+		NTSTATUS SetMacro(UCHAR Slot, BOOLEAN Enable, USHORT RepeatCount, USHORT StepCount,
+		                  const VIGEM_MACRO_STEP* Steps);
 
-		NTSTATUS EnqueueNotification(WDFREQUEST Request) const;
+		//
+		// Advances the macros of all targets on the bus and submits the
+		// changed overlays. Returns whether macros are still running.
+		// 
+		static bool ServiceMacroTick(WDFDEVICE Device);
+
+		static ULONGLONG GetMacroTicks() { return KeQueryInterruptTime() / 10000; }
+
+		//
+		// Queues a notification request of the owner, allocating the
+		// notification buffers on first use
+		// 
+		NTSTATUS EnqueueNotification(WDFREQUEST Request);
 
 		bool IsOwnerProcess() const;
 
 		VIGEM_TARGET_TYPE GetType() const;
 
+		LONG GetSessionId() const { return this->_SessionId; }
+
+		USHORT GetVendorId() const { return this->_VendorId; }
+
+		USHORT GetProductId() const { return this->_ProductId; }
+
+		//
+		// Marks a target created for the pool, owned by no process
+		// 
+		VOID SetPooled();
+
+		bool IsPooled() const { return this->_Pooled; }
+
+		//
+		// Hands an idle pooled target to the calling process and session
+		// 
+		VOID Claim(LONG SessionId);
+
+		//
+		// Takes a pooled target from its owner and resets the state left
+		// behind, so it can wait for the next claim. Requires the device
+		// object to exist.
+		// 
+		VOID Recycle();
+
+		//
+		// Copies the URB hit counters, indexed by VIGEM_URB_STATISTIC
+		// 
+		VOID GetUrbStatistics(PULONGLONG Counts) const { this->_UrbStatistics.Snapshot(Counts); }
+
+		//
+		// Reports the memory currently held by this target
+		// 
+		VOID GetFootprint(PVIGEM_TARGET_FOOTPRINT Footprint);
+
+		//
+		// Reports when the host is expected to poll the input pipe next
+		// 
+		VOID GetPollPhase(PVIGEM_POLL_PHASE Phase) const
+		{
+			this->_PollPhase.Snapshot(KeQueryInterruptTime(), Phase);
+		}
+
+		//
+		// Records the first time this target reached a plug-in phase
+		// 
+		VOID MarkPluginPhase(VIGEM_PLUGIN_PHASE Phase, ULONGLONG Now = KeQueryInterruptTime())
+		{
+			this->_PluginTimeline.Mark(Phase, Now);
+		}
+
+		//
+		// Reports when each plug-in phase was reached
+		// 
+		VOID GetPluginTimeline(PVIGEM_PLUGIN_TIMELINE Timeline) const { this->_PluginTimeline.Snapshot(Timeline); }
+
+		//
+		// Chains this target into the list of its owning session
+		// 
+		PSESSION_TARGET_LINK GetSessionLink() { return &this->_SessionLink; }
+
 		NTSTATUS PdoPrepare(WDFDEVICE ParentDevice);
 
 	private:
@@ -131,13 +266,47 @@ namespace ViGEm::Bus::Core
 
 		static EVT_WDF_DEVICE_CONTEXT_CLEANUP EvtDeviceContextCleanup;
 
-		static bool GetPdoBySerial(
-			IN WDFDEVICE ParentDevice,
-			IN ULONG SerialNo,
-			OUT EmulationTargetPDO** Object
-		);
+		static EVT_WDF_TIMER EvtCoalesceTimerFunc;
+
+		static EVT_WDF_DEVICE_D0_EXIT EvtDeviceD0Exit;
+
+		NTSTATUS AllocateNotificationBuffers(WDFDEVICE ParentDevice);
+
+		//
+		// Releases the notification buffers once no more references exist
+		// 
+		VOID FreeNotificationBuffers();
+
+		typedef NTSTATUS (*URB_HANDLER)(EmulationTargetPDO* Target, PURB Urb, WDFREQUEST Request);
+
+		//
+		// Handlers of all but the fast path URB function, indexed by VIGEM_URB_STATISTIC
+		// 
+		static const URB_HANDLER UrbHandlers[];
+
+		NTSTATUS UsbDispatchUrb(PURB Urb, WDFREQUEST Request);
+
+		NTSTATUS UsbGetDescriptorFromDevice(PURB Urb);
+
+		NTSTATUS DispatchReport(PVOID NewReport, LONG SessionId, bool IsOwner);
+
+		//
+		// Report path bound to the concrete target type
+		// 
+		template <typename Target>
+		static NTSTATUS DispatchReportAs(Target* Self, PVOID NewReport, LONG SessionId, bool IsOwner);
 
 		NTSTATUS EnqueueWaitDeviceReady(WDFREQUEST Request);
+
+		//
+		// Takes the current macro overlay, called with the bus macro lock held
+		// 
+		ULONG CaptureMacroOverlay(MACRO_OVERLAY& Overlay);
+
+		//
+		// Re-submits the last report with a captured macro overlay
+		// 
+		VOID SubmitMacroOverlay(const MACRO_OVERLAY& Overlay, ULONG Sequence);
 		
 		HANDLE _WaitDeviceReadyCompletionWorkerThreadHandle{};
 
@@ -150,6 +319,17 @@ namespace ViGEm::Bus::Core
 		
 		static const size_t MAX_OUT_BUFFER_QUEUE_SIZE = 128;
 
+		//
+		// Size and SerialNo precede the report in all submit structures
+		// 
+		static const ULONG REPORT_PAYLOAD_OFFSET = 2 * sizeof(ULONG);
+
+		//
+		// Fits the largest submit structure (DS4_SUBMIT_REPORT_EX)
+		// 
+		static const ULONG MAX_SUBMIT_REPORT_SIZE = ALIGN_UP_BY(REPORT_PAYLOAD_OFFSET + sizeof(DS4_REPORT_EX),
+		                                                        sizeof(ULONG));
+
 		static PCWSTR _deviceLocation;
 
 		static BOOLEAN USB_BUSIFFN UsbInterfaceIsDeviceHighSpeed(IN PVOID BusContext);
@@ -180,8 +360,6 @@ namespace ViGEm::Bus::Core
 
 		static VOID WaitDeviceReadyCompletionWorkerRoutine(IN PVOID StartContext);
 
-		static VOID DumpAsHex(PCSTR Prefix, PVOID Buffer, ULONG BufferLength);
-		
 		virtual VOID GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length) = 0;
 
 		virtual NTSTATUS SelectConfiguration(PURB Urb) = 0;
@@ -190,7 +368,61 @@ namespace ViGEm::Bus::Core
 
 		virtual NTSTATUS SubmitReportImpl(PVOID NewReport) = 0;
 
-		virtual VOID ProcessPendingNotification(WDFQUEUE Queue) = 0;
+		virtual VOID ApplyAxisTransform(PVOID NewReport, const AxisTransform& Transform) = 0;
+
+		virtual bool AggregateReport(PVOID NewReport, LONG SessionId, ReportAggregator& Aggregator) = 0;
+
+		VOID RecordReport(VIGEM_REPORT_LOG_KIND Kind, const VOID* Payload, ULONG Length);
+
+		//
+		// Passes an interrupt OUT transfer through unmodified, if enabled
+		// 
+		VOID RecordRawOutput(const VOID* Payload, ULONG Length);
+
+		//
+		// Records a binary trace event of this target, if tracing is enabled
+		// 
+		FORCEINLINE VOID RecordEvent(USHORT EventId, ULONG Payload0 = 0, ULONG Payload1 = 0, ULONG Payload2 = 0)
+		{
+			if (this->_EventTrace)
+				this->_EventTrace->Record(EventId, this->_SerialNo, Payload0, Payload1, Payload2);
+		}
+
+		//
+		// Feeds the poll phase estimate, call for each interrupt IN transfer
+		// on the input pipe
+		// 
+		FORCEINLINE VOID RecordPoll()
+		{
+			this->_PollPhase.Arrival(KeQueryInterruptTime());
+		}
+
+		virtual VOID ApplyMacroOverlay(PVOID NewReport, const MACRO_OVERLAY& Overlay) = 0;
+
+		virtual VOID ProcessPendingNotification(WDFQUEUE Queue, DMFMODULE BufferQueue) = 0;
+
+		//
+		// Reports all controls released and centered
+		// 
+		virtual VOID SubmitNeutralReport() = 0;
+
+		//
+		// Fails target specific requests pended by the former owner
+		// 
+		virtual VOID PurgeOwnerRequests() {}
+
+		//
+		// Returns the notification buffers protected against release, or NULL
+		// if not allocated. Pair with DereferenceNotificationBuffers.
+		// 
+		DMFMODULE ReferenceNotificationBuffers();
+
+		VOID DereferenceNotificationBuffers();
+
+		//
+		// Combination of VIGEM_TARGET_RESOURCE flags currently allocated
+		// 
+		ULONG GetResources();
 
 		//
 		// PNP Capabilities may differ from device to device
@@ -217,6 +449,37 @@ namespace ViGEm::Bus::Core
 		// 
 		LONG _SessionId{};
 
+		//
+		// Link into the target list of the owning session, or the target
+		// pool while idle
+		// 
+		SESSION_TARGET_LINK _SessionLink{};
+
+		//
+		// Created for the target pool, returns there instead of unplugging
+		// 
+		bool _Pooled{};
+
+		//
+		// Event trace of the parent bus
+		// 
+		EventTrace* _EventTrace{};
+
+		//
+		// URB hit counters
+		// 
+		UrbStatistics _UrbStatistics{};
+
+		//
+		// Timing of the host polling the input pipe
+		// 
+		PollPhaseEstimator _PollPhase{};
+
+		//
+		// Time-to-ready breakdown of the plug-in
+		// 
+		PluginTimeline _PluginTimeline{};
+
 		//
 		// Device type this PDO is emulating
 		// 
@@ -242,6 +505,12 @@ namespace ViGEm::Bus::Core
 		//
 		WDFQUEUE _PendingUsbInRequests{};
 
+		//
+		// Selective suspend request of the function driver, held until
+		// canceled
+		//
+		WDFQUEUE _PendingIdleNotification{};
+
 		//
 		// Queue for inverted calls
 		//
@@ -263,9 +532,133 @@ namespace ViGEm::Bus::Core
 		KEVENT _PdoBootNotificationEvent;
 
 		//
-		// Queue for interrupt out requests delivered to user-land
+		// Queue for interrupt out requests delivered to user-land, allocated
+		// once the owner requests notifications
 		// 
 		DMFMODULE _UsbInterruptOutBufferQueue{};
+
+		//
+		// Guards _UsbInterruptOutBufferQueue against release while in use
+		// 
+		EX_RUNDOWN_REF _NotificationBuffersRundown{};
+
+		//
+		// Serializes allocating and freeing _UsbInterruptOutBufferQueue
+		// 
+		FAST_MUTEX _NotificationBuffersLock{};
+
+		//
+		// Axis profiles applied to submitted reports
+		// 
+		AxisTransform _AxisTransform;
+
+		//
+		// Protects _AxisTransform against concurrent updates
+		// 
+		EX_SPIN_LOCK _AxisTransformLock{};
+
+		//
+		// Merges reports of additional sessions feeding this target
+		// 
+		ReportAggregator _Aggregator;
+
+		//
+		// Protects _Aggregator
+		// 
+		EX_SPIN_LOCK _AggregatorLock{};
+
+		//
+		// Log of submitted reports and host notifications
+		// 
+		ReportRecorder _Recorder;
+
+		//
+		// Protects _Recorder
+		// 
+		KSPIN_LOCK _RecorderLock{};
+
+		//
+		// Raw interrupt OUT transfers awaiting the owner
+		// 
+		RawOutputRing _RawOutput;
+
+		//
+		// Protects _RawOutput
+		// 
+		KSPIN_LOCK _RawOutputLock{};
+
+		//
+		// Macros running on this target, protected by the bus macro lock
+		// 
+		MacroSet _Macros{this};
+
+		//
+		// Set while a macro runs, enables caching the base report
+		// 
+		bool _MacroBaseEnabled{};
+
+		//
+		// Keeps the target alive while the macro tick submits its overlay
+		// outside the bus macro lock
+		// 
+		EX_RUNDOWN_REF _MacroRundown{};
+
+		//
+		// Next target of the macro tick submitting overlays, with the
+		// overlay captured for it
+		// 
+		EmulationTargetPDO* _MacroDueNext{};
+
+		MACRO_OVERLAY _MacroDueOverlay{};
+
+		ULONG _MacroDueSequence{};
+
+		//
+		// Counts overlay captures under the bus macro lock, the overlay of
+		// an older capture never replaces a newer one
+		// 
+		ULONG _MacroCaptureSequence{};
+
+		ULONG _MacroOverlaySequence{};
+
+		//
+		// Last report as submitted (after transform), the macro overlay
+		// gets applied to
+		// 
+		UCHAR _MacroBaseReport[MAX_SUBMIT_REPORT_SIZE]{};
+
+		ULONG _MacroBaseReportSize{};
+
+		//
+		// Overlay of the macros currently running
+		// 
+		MACRO_OVERLAY _MacroOverlay{};
+
+		//
+		// Protects _MacroBaseReport and _MacroOverlay
+		// 
+		KSPIN_LOCK _MacroReportLock{};
+
+		//
+		// Latest report held back by the session rate limit
+		// 
+		UCHAR _CoalescedReport[MAX_SUBMIT_REPORT_SIZE]{};
+
+		LONG _CoalescedSessionId{};
+
+		bool _CoalescedIsOwner{};
+
+		bool _CoalescedPending{};
+
+		//
+		// Protects the _Coalesced* members
+		// 
+		KSPIN_LOCK _CoalesceLock{};
+
+		//
+		// Delivers _CoalescedReport
+		// 
+		WDFTIMER _CoalesceTimer{};
 	};
 
 	typedef struct _PDO_IDENTIFICATION_DESCRIPTION
@@ -281,7 +674,7 @@ namespace ViGEm::Bus::Core
 		ULONG SerialNo;
 
 		//
-		// Session ID
+		// Session ID at plug-in, pooled targets change owners later on
 		// 
 		LONG SessionId;
 
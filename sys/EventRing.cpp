@@ -0,0 +1,132 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "EventRing.hpp"
+
+
+SIZE_T ViGEm::Bus::Core::EventRing::GetStorageSize(ULONG Processors, ULONG Capacity)
+{
+	return Processors * (sizeof(PROCESSOR_RING) + static_cast<SIZE_T>(Capacity) * sizeof(EVENT_SLOT));
+}
+
+VOID ViGEm::Bus::Core::EventRing::Initialize(PVOID Storage, ULONG Processors, ULONG Capacity)
+{
+	RtlZeroMemory(Storage, GetStorageSize(Processors, Capacity));
+
+	this->_Rings = static_cast<PPROCESSOR_RING>(Storage);
+	this->_Slots = reinterpret_cast<PEVENT_SLOT>(this->_Rings + Processors);
+	this->_Processors = Processors;
+	this->_Capacity = Capacity;
+	this->_NextProcessor = 0;
+}
+
+bool ViGEm::Bus::Core::EventRing::Record(ULONG Processor, const VIGEM_EVENT_RECORD& Event)
+{
+	const ULONG index = Processor % this->_Processors;
+	const PPROCESSOR_RING ring = &this->_Rings[index];
+
+	LONG64 head = ReadNoFence64(&ring->Head);
+
+	for (;;)
+	{
+		if (head - ReadAcquire64(&ring->Tail) >= static_cast<LONG64>(this->_Capacity))
+		{
+			InterlockedIncrement64(&ring->Dropped);
+			return false;
+		}
+
+		const LONG64 observed = InterlockedCompareExchange64(&ring->Head, head + 1, head);
+
+		if (observed == head)
+			break;
+
+		head = observed;
+	}
+
+	const PEVENT_SLOT slot = &this->_Slots[static_cast<SIZE_T>(index) * this->_Capacity
+		+ static_cast<ULONG>(head & (this->_Capacity - 1))];
+
+	slot->Record = Event;
+
+	WriteRelease64(&slot->Sequence, head + 1);
+
+	return true;
+}
+
+ULONG ViGEm::Bus::Core::EventRing::Drain(PVIGEM_EVENT_RECORD Events, ULONG Count)
+{
+	ULONG drained = 0;
+
+	for (ULONG i = 0; i < this->_Processors && drained < Count; i++)
+	{
+		const ULONG index = (this->_NextProcessor + i) % this->_Processors;
+		const PPROCESSOR_RING ring = &this->_Rings[index];
+		const LONG64 head = ReadAcquire64(&ring->Head);
+		LONG64 tail = ReadNoFence64(&ring->Tail);
+
+		while (tail < head && drained < Count)
+		{
+			const PEVENT_SLOT slot = &this->_Slots[static_cast<SIZE_T>(index) * this->_Capacity
+				+ static_cast<ULONG>(tail & (this->_Capacity - 1))];
+
+			//
+			// Reserved but not yet published, the rest of this ring follows later
+			// 
+			if (ReadAcquire64(&slot->Sequence) != tail + 1)
+				break;
+
+			Events[drained++] = slot->Record;
+			tail++;
+		}
+
+		WriteRelease64(&ring->Tail, tail);
+	}
+
+	this->_NextProcessor = (this->_NextProcessor + 1) % this->_Processors;
+
+	return drained;
+}
+
+ULONGLONG ViGEm::Bus::Core::EventRing::GetDropped() const
+{
+	ULONGLONG dropped = 0;
+
+	for (ULONG i = 0; i < this->_Processors; i++)
+	{
+		dropped += static_cast<ULONGLONG>(ReadNoFence64(&this->_Rings[i].Dropped));
+	}
+
+	return dropped;
+}
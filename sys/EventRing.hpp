@@ -0,0 +1,119 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+#include <ViGEm/Common.h>
+#include <ViGEm/km/EventTrace.h>
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Lock-free rings of fixed-size event records, one per processor.
+	// 
+	// Producers reserve a slot with a compare-exchange on the ring of the
+	// processor they run on, so they only contend with producers that got
+	// migrated there, and publish the record with a release store of its
+	// sequence number. Records arriving at a full ring are dropped and
+	// counted. A single consumer drains all rings; callers serialize
+	// draining. Storage is handed in by the caller. The component has no
+	// WDF dependencies.
+	// 
+	class EventRing
+	{
+	public:
+		//
+		// Bytes of storage needed, Capacity must be a power of two
+		// 
+		static SIZE_T GetStorageSize(ULONG Processors, ULONG Capacity);
+
+		VOID Initialize(PVOID Storage, ULONG Processors, ULONG Capacity);
+
+		//
+		// Safe to call concurrently from any processor
+		// 
+		bool Record(ULONG Processor, const VIGEM_EVENT_RECORD& Event);
+
+		//
+		// Moves up to Count records out of the rings, returns the number moved
+		// 
+		ULONG Drain(PVIGEM_EVENT_RECORD Events, ULONG Count);
+
+		ULONGLONG GetDropped() const;
+
+	private:
+		typedef struct DECLSPEC_CACHEALIGN _PROCESSOR_RING
+		{
+			//
+			// Slots reserved by producers
+			// 
+			volatile LONG64 Head;
+
+			//
+			// Slots released by the consumer
+			// 
+			volatile LONG64 Tail;
+
+			volatile LONG64 Dropped;
+
+		} PROCESSOR_RING, * PPROCESSOR_RING;
+
+		typedef struct _EVENT_SLOT
+		{
+			//
+			// Head value plus one once the record is published
+			// 
+			volatile LONG64 Sequence;
+
+			VIGEM_EVENT_RECORD Record;
+
+		} EVENT_SLOT, * PEVENT_SLOT;
+
+		PPROCESSOR_RING _Rings;
+
+		PEVENT_SLOT _Slots;
+
+		ULONG _Processors;
+
+		ULONG _Capacity;
+
+		//
+		// Ring the next drain starts at, so no processor gets starved
+		// 
+		ULONG _NextProcessor;
+	};
+}
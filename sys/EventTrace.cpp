@@ -0,0 +1,164 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "EventTrace.hpp"
+
+
+NTSTATUS ViGEm::Bus::Core::EventTrace::Initialize()
+{
+	ExInitializeFastMutex(&this->_Lock);
+
+	this->_Rundown = ExAllocateCacheAwareRundownProtection(NonPagedPoolNx, EVENT_TRACE_POOL_TAG);
+
+	return (this->_Rundown != nullptr) ? STATUS_SUCCESS : STATUS_INSUFFICIENT_RESOURCES;
+}
+
+VOID ViGEm::Bus::Core::EventTrace::Cleanup()
+{
+	if (this->_Rundown == nullptr)
+		return;
+
+	ExAcquireFastMutex(&this->_Lock);
+	this->Disable();
+	ExReleaseFastMutex(&this->_Lock);
+
+	ExFreeCacheAwareRundownProtection(this->_Rundown);
+	this->_Rundown = nullptr;
+}
+
+NTSTATUS ViGEm::Bus::Core::EventTrace::SetEnabled(BOOLEAN Enable, ULONG Capacity)
+{
+	if (this->_Rundown == nullptr)
+		return STATUS_INVALID_DEVICE_STATE;
+
+	const ULONG processors = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+	const SIZE_T size = EventRing::GetStorageSize(processors, Capacity);
+
+	//
+	// Allocate before taking the lock, the old rings get freed after it
+	// 
+	const PVOID storage = Enable ? ExAllocatePoolWithTag(NonPagedPoolNx, size, EVENT_TRACE_POOL_TAG) : nullptr;
+
+	if (Enable && storage == nullptr)
+		return STATUS_INSUFFICIENT_RESOURCES;
+
+	ExAcquireFastMutex(&this->_Lock);
+
+	this->Disable();
+
+	if (storage)
+	{
+		this->_Ring.Initialize(storage, processors, Capacity);
+
+		InterlockedExchangePointer(&this->_Storage, storage);
+		InterlockedExchange(&this->_Enabled, TRUE);
+	}
+
+	ExReleaseFastMutex(&this->_Lock);
+
+	return STATUS_SUCCESS;
+}
+
+VOID ViGEm::Bus::Core::EventTrace::Disable()
+{
+	if (this->_Storage == nullptr)
+		return;
+
+	InterlockedExchange(&this->_Enabled, FALSE);
+
+	//
+	// Wait for recorders still using the rings
+	// 
+	ExWaitForRundownProtectionReleaseCacheAware(this->_Rundown);
+
+	ExFreePoolWithTag(this->_Storage, EVENT_TRACE_POOL_TAG);
+	InterlockedExchangePointer(&this->_Storage, nullptr);
+
+	ExReInitializeRundownProtectionCacheAware(this->_Rundown);
+}
+
+VOID ViGEm::Bus::Core::EventTrace::RecordEnabled(
+	USHORT EventId,
+	ULONG SerialNo,
+	ULONG Payload0,
+	ULONG Payload1,
+	ULONG Payload2,
+	ULONG Payload3
+)
+{
+	if (!ExAcquireRundownProtectionCacheAware(this->_Rundown))
+		return;
+
+	//
+	// Rings may have been swapped between the flag test and the rundown
+	// 
+	if (ReadPointerAcquire(&this->_Storage) != nullptr)
+	{
+		VIGEM_EVENT_RECORD event;
+		const ULONG processor = KeGetCurrentProcessorNumberEx(nullptr);
+
+		event.Timestamp = KeQueryPerformanceCounter(nullptr).QuadPart;
+		event.EventId = EventId;
+		event.Processor = static_cast<USHORT>(processor);
+		event.SerialNo = SerialNo;
+		event.Payload[0] = Payload0;
+		event.Payload[1] = Payload1;
+		event.Payload[2] = Payload2;
+		event.Payload[3] = Payload3;
+
+		(void)this->_Ring.Record(processor, event);
+	}
+
+	ExReleaseRundownProtectionCacheAware(this->_Rundown);
+}
+
+ULONG ViGEm::Bus::Core::EventTrace::Drain(PVIGEM_EVENT_RECORD Events, ULONG Count, PULONGLONG Dropped)
+{
+	ULONG drained = 0;
+
+	*Dropped = 0;
+
+	ExAcquireFastMutex(&this->_Lock);
+
+	if (this->_Storage != nullptr)
+	{
+		drained = this->_Ring.Drain(Events, Count);
+		*Dropped = this->_Ring.GetDropped();
+	}
+
+	ExReleaseFastMutex(&this->_Lock);
+
+	return drained;
+}
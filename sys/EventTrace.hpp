@@ -0,0 +1,113 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <ntddk.h>
+
+#include "EventRing.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	constexpr auto EVENT_TRACE_POOL_TAG = 'TEiV';
+
+	//
+	// Binary event trace of a bus, recorded into per-processor rings.
+	// 
+	// Recording is a single flag test while disabled. While enabled it
+	// takes cache-aware rundown protection, so the rings can be freed on
+	// disable without a lock on the hot path. Zeroed memory is a valid,
+	// disabled trace, so it can live in a WDF context; Initialize before
+	// enabling it.
+	// 
+	class EventTrace
+	{
+	public:
+		NTSTATUS Initialize();
+
+		//
+		// Disables the trace and frees all resources
+		// 
+		VOID Cleanup();
+
+		//
+		// Starts recording with fresh rings of the given capacity, or stops
+		// 
+		NTSTATUS SetEnabled(BOOLEAN Enable, ULONG Capacity);
+
+		FORCEINLINE VOID Record(
+			USHORT EventId,
+			ULONG SerialNo,
+			ULONG Payload0 = 0,
+			ULONG Payload1 = 0,
+			ULONG Payload2 = 0,
+			ULONG Payload3 = 0
+		)
+		{
+			if (ReadNoFence(&this->_Enabled))
+				this->RecordEnabled(EventId, SerialNo, Payload0, Payload1, Payload2, Payload3);
+		}
+
+		//
+		// Moves up to Count records into Events
+		// 
+		ULONG Drain(PVIGEM_EVENT_RECORD Events, ULONG Count, PULONGLONG Dropped);
+
+	private:
+		VOID RecordEnabled(USHORT EventId, ULONG SerialNo, ULONG Payload0, ULONG Payload1, ULONG Payload2,
+		                   ULONG Payload3);
+
+		//
+		// Frees the rings, caller holds _Lock
+		// 
+		VOID Disable();
+
+		volatile LONG _Enabled;
+
+		PEX_RUNDOWN_REF_CACHE_AWARE _Rundown;
+
+		//
+		// Serializes enabling, disabling and draining
+		// 
+		FAST_MUTEX _Lock;
+
+		//
+		// Ring storage, NULL while disabled
+		// 
+		PVOID _Storage;
+
+		EventRing _Ring;
+	};
+}
@@ -0,0 +1,218 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+
+#include "IdentityTable.hpp"
+
+
+VOID ViGEm::Bus::Core::IdentityTable::Initialize()
+{
+	ExInitializeFastMutex(&this->_Lock);
+}
+
+VOID ViGEm::Bus::Core::IdentityTable::Cleanup()
+{
+	if (this->_Entries)
+	{
+		ExFreePoolWithTag(this->_Entries, IDENTITY_TABLE_POOL_TAG);
+		this->_Entries = nullptr;
+	}
+
+	this->_Count = 0;
+	this->_Capacity = 0;
+}
+
+bool ViGEm::Bus::Core::IdentityTable::Lookup(ULONG SerialNo, PUCHAR Address)
+{
+	bool found = false;
+
+	ExAcquireFastMutex(&this->_Lock);
+
+	const ULONG index = this->Find(SerialNo);
+
+	if (index < this->_Count && this->_Entries[index].SerialNo == SerialNo)
+	{
+		RtlCopyMemory(Address, this->_Entries[index].Address, ADDRESS_LENGTH);
+		found = true;
+	}
+
+	ExReleaseFastMutex(&this->_Lock);
+
+	return found;
+}
+
+NTSTATUS ViGEm::Bus::Core::IdentityTable::Insert(ULONG SerialNo, const UCHAR* Address)
+{
+	ExAcquireFastMutex(&this->_Lock);
+
+	const NTSTATUS status = this->InsertLocked(SerialNo, Address);
+
+	if (NT_SUCCESS(status))
+		this->SetPending();
+
+	ExReleaseFastMutex(&this->_Lock);
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::IdentityTable::Serialize(PVOID Buffer, ULONG Length, PULONG Written)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	ExAcquireFastMutex(&this->_Lock);
+
+	const ULONG required = sizeof(IDENTITY_TABLE_HEADER) + this->_Count * sizeof(IDENTITY_ENTRY);
+
+	*Written = required;
+
+	if (Length < required)
+	{
+		status = STATUS_BUFFER_TOO_SMALL;
+	}
+	else
+	{
+		const auto header = static_cast<PIDENTITY_TABLE_HEADER>(Buffer);
+
+		header->Version = SERIALIZED_VERSION;
+		header->Count = this->_Count;
+
+		if (this->_Count)
+		{
+			RtlCopyMemory(header + 1, this->_Entries, this->_Count * sizeof(IDENTITY_ENTRY));
+		}
+
+		InterlockedExchange(&this->_Pending, FALSE);
+	}
+
+	ExReleaseFastMutex(&this->_Lock);
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::IdentityTable::Deserialize(const VOID* Buffer, ULONG Length)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (Length < sizeof(IDENTITY_TABLE_HEADER))
+		return STATUS_INVALID_PARAMETER;
+
+	const auto header = static_cast<const IDENTITY_TABLE_HEADER*>(Buffer);
+	const auto entries = reinterpret_cast<const IDENTITY_ENTRY*>(header + 1);
+
+	if (header->Version != SERIALIZED_VERSION
+		|| header->Count > (Length - sizeof(IDENTITY_TABLE_HEADER)) / sizeof(IDENTITY_ENTRY))
+		return STATUS_INVALID_PARAMETER;
+
+	ExAcquireFastMutex(&this->_Lock);
+
+	for (ULONG i = 0; i < header->Count && NT_SUCCESS(status); i++)
+	{
+		if (entries[i].SerialNo == 0)
+			continue;
+
+		status = this->InsertLocked(entries[i].SerialNo, entries[i].Address);
+	}
+
+	ExReleaseFastMutex(&this->_Lock);
+
+	return status;
+}
+
+ULONG ViGEm::Bus::Core::IdentityTable::Find(ULONG SerialNo) const
+{
+	ULONG low = 0;
+	ULONG high = this->_Count;
+
+	while (low < high)
+	{
+		const ULONG middle = low + (high - low) / 2;
+
+		if (this->_Entries[middle].SerialNo < SerialNo)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+NTSTATUS ViGEm::Bus::Core::IdentityTable::InsertLocked(ULONG SerialNo, const UCHAR* Address)
+{
+	const ULONG index = this->Find(SerialNo);
+
+	if (index < this->_Count && this->_Entries[index].SerialNo == SerialNo)
+	{
+		RtlCopyMemory(this->_Entries[index].Address, Address, ADDRESS_LENGTH);
+		return STATUS_SUCCESS;
+	}
+
+	if (this->_Count == this->_Capacity)
+	{
+		const ULONG capacity = this->_Capacity ? this->_Capacity * 2 : INITIAL_CAPACITY;
+
+		const auto entries = static_cast<PIDENTITY_ENTRY>(ExAllocatePoolWithTag(
+			NonPagedPoolNx,
+			capacity * sizeof(IDENTITY_ENTRY),
+			IDENTITY_TABLE_POOL_TAG
+		));
+
+		if (!entries)
+			return STATUS_INSUFFICIENT_RESOURCES;
+
+		if (this->_Entries)
+		{
+			RtlCopyMemory(entries, this->_Entries, this->_Count * sizeof(IDENTITY_ENTRY));
+			ExFreePoolWithTag(this->_Entries, IDENTITY_TABLE_POOL_TAG);
+		}
+
+		this->_Entries = entries;
+		this->_Capacity = capacity;
+	}
+
+	RtlMoveMemory(
+		&this->_Entries[index + 1],
+		&this->_Entries[index],
+		(this->_Count - index) * sizeof(IDENTITY_ENTRY)
+	);
+
+	RtlZeroMemory(&this->_Entries[index], sizeof(IDENTITY_ENTRY));
+	this->_Entries[index].SerialNo = SerialNo;
+	RtlCopyMemory(this->_Entries[index].Address, Address, ADDRESS_LENGTH);
+
+	this->_Count++;
+
+	return STATUS_SUCCESS;
+}
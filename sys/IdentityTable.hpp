@@ -0,0 +1,141 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	constexpr auto IDENTITY_TABLE_POOL_TAG = 'TIiV';
+
+	//
+	// Persisted hardware (MAC) addresses of DualShock 4 targets by serial.
+	// 
+	// Loaded once when the bus starts, so plug-ins are served from memory.
+	// Changes mark the table pending; the owner writes the whole table
+	// behind them with Serialize and calls SetPending if that fails.
+	// Entries are kept sorted by serial in one array, which is also the
+	// serialized layout after a short header. Runs at PASSIVE_LEVEL and is
+	// serialized internally. Zeroed memory is a valid, empty table, so it
+	// can live in a WDF context; Initialize before use. The component has
+	// no WDF dependencies.
+	// 
+	class IdentityTable
+	{
+	public:
+		static const ULONG ADDRESS_LENGTH = 6;
+
+		VOID Initialize();
+
+		//
+		// Frees all entries
+		// 
+		VOID Cleanup();
+
+		//
+		// Copies the address of the serial, false if it has none
+		// 
+		bool Lookup(ULONG SerialNo, PUCHAR Address);
+
+		//
+		// Adds or replaces the address of the serial
+		// 
+		NTSTATUS Insert(ULONG SerialNo, const UCHAR* Address);
+
+		bool IsPending() const { return ReadAcquire(&this->_Pending) != 0; }
+
+		VOID SetPending() { InterlockedExchange(&this->_Pending, TRUE); }
+
+		//
+		// Writes all entries to Buffer and clears pending. If Length is too
+		// small, fails with STATUS_BUFFER_TOO_SMALL and returns the required
+		// size in Written.
+		// 
+		NTSTATUS Serialize(PVOID Buffer, ULONG Length, PULONG Written);
+
+		//
+		// Adds the entries of a serialized table without marking it pending
+		// 
+		NTSTATUS Deserialize(const VOID* Buffer, ULONG Length);
+
+		ULONG GetCount() const { return this->_Count; }
+
+	private:
+		static const ULONG SERIALIZED_VERSION = 1;
+
+		static const ULONG INITIAL_CAPACITY = 16;
+
+		typedef struct _IDENTITY_ENTRY
+		{
+			ULONG SerialNo;
+
+			UCHAR Address[ADDRESS_LENGTH];
+
+			USHORT Reserved;
+
+		} IDENTITY_ENTRY, * PIDENTITY_ENTRY;
+
+		typedef struct _IDENTITY_TABLE_HEADER
+		{
+			ULONG Version;
+
+			ULONG Count;
+
+		} IDENTITY_TABLE_HEADER, * PIDENTITY_TABLE_HEADER;
+
+		//
+		// Returns the index of the first entry not below SerialNo
+		// 
+		ULONG Find(ULONG SerialNo) const;
+
+		NTSTATUS InsertLocked(ULONG SerialNo, const UCHAR* Address);
+
+		PIDENTITY_ENTRY _Entries;
+
+		ULONG _Count;
+
+		ULONG _Capacity;
+
+		//
+		// Set while changes are not persisted
+		// 
+		volatile LONG _Pending;
+
+		FAST_MUTEX _Lock;
+	};
+}
@@ -0,0 +1,76 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Tracks whether a target device went without traffic long enough to
+	// park its periodic work.
+	// 
+	// Time is in 100ns units of interrupt time. The last activity and the
+	// parked flag share one value, so activity racing with parking always
+	// wins. Zeroed memory is active as of time 0. The component has no WDF
+	// dependencies.
+	// 
+	class IdleTracker
+	{
+	public:
+		//
+		// Records traffic at Now. Returns whether the target was parked and
+		// needs its periodic work resumed.
+		// 
+		bool Activity(ULONGLONG Now);
+
+		//
+		// Parks the target if it saw no traffic for Timeout. Returns whether
+		// this call parked it. A Timeout of 0 never parks.
+		// 
+		bool Park(ULONGLONG Now, ULONGLONG Timeout);
+
+		bool IsParked() const;
+
+	private:
+		static const LONG64 PARKED = 1;
+
+		//
+		// Last activity, the lowest bit holds PARKED
+		// 
+		volatile LONG64 _State;
+	};
+}
@@ -0,0 +1,259 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MacroScheduler.hpp"
+
+
+#pragma region MacroScheduler
+
+void ViGEm::Bus::Core::MacroScheduler::Schedule(PMACRO_TIMER Timer, ULONGLONG Deadline)
+{
+	//
+	// Overdue timers fire on the next tick
+	// 
+	const ULONGLONG slotTick = max(Deadline, this->_Current + 1);
+	const auto slot = &this->_Slots[slotTick & WHEEL_MASK];
+
+	Timer->Deadline = Deadline;
+	Timer->Next = *slot;
+	Timer->Link = slot;
+
+	if (Timer->Next)
+		Timer->Next->Link = &Timer->Next;
+
+	*Timer->Link = Timer;
+
+	this->_Count++;
+}
+
+void ViGEm::Bus::Core::MacroScheduler::Cancel(PMACRO_TIMER Timer)
+{
+	if (!Timer->Link)
+		return;
+
+	*Timer->Link = Timer->Next;
+
+	if (Timer->Next)
+		Timer->Next->Link = Timer->Link;
+
+	Timer->Next = nullptr;
+	Timer->Link = nullptr;
+
+	this->_Count--;
+}
+
+ViGEm::Bus::Core::MacroSet* ViGEm::Bus::Core::MacroScheduler::Advance(ULONGLONG Now)
+{
+	PMACRO_TIMER expired = nullptr;
+	MacroSet* changed = nullptr;
+
+	if (Now <= this->_Current)
+		return nullptr;
+
+	//
+	// After a long stall one full rotation covers every slot
+	// 
+	const ULONGLONG first = (Now - this->_Current > WHEEL_SIZE) ? Now - WHEEL_SIZE + 1 : this->_Current + 1;
+
+	for (ULONGLONG tick = first; tick <= Now; tick++)
+	{
+		PMACRO_TIMER timer = this->_Slots[tick & WHEEL_MASK];
+
+		while (timer)
+		{
+			const PMACRO_TIMER next = timer->Next;
+
+			if (timer->Deadline <= Now)
+			{
+				this->Cancel(timer);
+
+				timer->Next = expired;
+				expired = timer;
+			}
+
+			timer = next;
+		}
+	}
+
+	this->_Current = Now;
+
+	//
+	// Step macros only after the scan so rescheduling can't revisit them
+	// 
+	while (expired)
+	{
+		const auto program = reinterpret_cast<MacroSet::PMACRO_PROGRAM>(expired);
+		MacroSet* owner = program->Owner;
+
+		expired = expired->Next;
+		program->Timer.Next = nullptr;
+
+		if (!MacroSet::Step(program, *this, Now))
+			owner->_ActiveMask &= ~(1UL << (program - owner->_Programs));
+
+		if (!owner->_Changed)
+		{
+			owner->_Changed = true;
+			owner->NextChanged = changed;
+			changed = owner;
+		}
+	}
+
+	for (MacroSet* set = changed; set; set = set->NextChanged)
+		set->_Changed = false;
+
+	return changed;
+}
+
+#pragma endregion
+
+#pragma region MacroSet
+
+NTSTATUS ViGEm::Bus::Core::MacroSet::Load(MacroScheduler& Scheduler, ULONGLONG Now, UCHAR Slot,
+                                          USHORT RepeatCount, USHORT StepCount, const VIGEM_MACRO_STEP* Steps)
+{
+	if (Slot >= VIGEM_MACRO_MAX_SLOTS || StepCount == 0 || StepCount > VIGEM_MACRO_MAX_STEPS)
+		return STATUS_INVALID_PARAMETER;
+
+	for (USHORT step = 0; step < StepCount; step++)
+	{
+		if (Steps[step].DurationMs == 0 || Steps[step].AxisMask >= (1 << VIGEM_AXIS_COUNT))
+			return STATUS_INVALID_PARAMETER;
+
+		for (ULONG axis = VIGEM_AXIS_TRIGGER_L; axis <= VIGEM_AXIS_TRIGGER_R; axis++)
+		{
+			if (Steps[step].Axes[axis] < 0)
+				return STATUS_INVALID_PARAMETER;
+		}
+	}
+
+	const PMACRO_PROGRAM program = &this->_Programs[Slot];
+
+	Scheduler.Cancel(&program->Timer);
+
+	RtlCopyMemory(program->Steps, Steps, StepCount * sizeof(VIGEM_MACRO_STEP));
+
+	program->Owner = this;
+	program->StepCount = StepCount;
+	program->RepeatCount = RepeatCount;
+	program->CurrentStep = 0;
+	program->CurrentRun = 0;
+
+	Scheduler.Schedule(&program->Timer, Now + Steps[0].DurationMs);
+
+	this->_ActiveMask |= 1UL << Slot;
+
+	return STATUS_SUCCESS;
+}
+
+void ViGEm::Bus::Core::MacroSet::Unload(MacroScheduler& Scheduler, UCHAR Slot)
+{
+	if (Slot >= VIGEM_MACRO_MAX_SLOTS)
+		return;
+
+	Scheduler.Cancel(&this->_Programs[Slot].Timer);
+
+	this->_ActiveMask &= ~(1UL << Slot);
+}
+
+void ViGEm::Bus::Core::MacroSet::Clear(MacroScheduler& Scheduler)
+{
+	for (UCHAR slot = 0; slot < VIGEM_MACRO_MAX_SLOTS; slot++)
+		this->Unload(Scheduler, slot);
+}
+
+void ViGEm::Bus::Core::MacroSet::GetOverlay(MACRO_OVERLAY& Overlay) const
+{
+	RtlZeroMemory(&Overlay, sizeof(MACRO_OVERLAY));
+
+	//
+	// Buttons of all macros combine, higher slots win on axes
+	// 
+	for (ULONG slot = 0; slot < VIGEM_MACRO_MAX_SLOTS; slot++)
+	{
+		if (!(this->_ActiveMask & (1UL << slot)))
+			continue;
+
+		const auto& program = this->_Programs[slot];
+		const auto& step = program.Steps[program.CurrentStep];
+
+		Overlay.ButtonsSet |= step.ButtonsSet;
+		Overlay.ButtonsClear |= step.ButtonsClear;
+		Overlay.AxisMask |= step.AxisMask;
+
+		for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+		{
+			if (step.AxisMask & (1 << axis))
+				Overlay.Axes[axis] = step.Axes[axis];
+		}
+	}
+}
+
+void ViGEm::Bus::Core::MacroSet::ApplyOverlay(const MACRO_OVERLAY& Overlay, ULONG& Buttons,
+                                              LONG (&Axes)[VIGEM_AXIS_COUNT])
+{
+	Buttons = (Buttons & ~Overlay.ButtonsClear) | Overlay.ButtonsSet;
+
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+	{
+		if (Overlay.AxisMask & (1 << axis))
+			Axes[axis] = Overlay.Axes[axis];
+	}
+}
+
+bool ViGEm::Bus::Core::MacroSet::Step(PMACRO_PROGRAM Program, MacroScheduler& Scheduler, ULONGLONG Now)
+{
+	if (++Program->CurrentStep == Program->StepCount)
+	{
+		Program->CurrentStep = 0;
+
+		if (Program->RepeatCount && ++Program->CurrentRun == Program->RepeatCount)
+			return false;
+	}
+
+	//
+	// Keep to the original timeline, unless hopelessly behind
+	// 
+	ULONGLONG deadline = Program->Timer.Deadline + Program->Steps[Program->CurrentStep].DurationMs;
+
+	if (deadline + RESYNC_TICKS < Now)
+		deadline = Now + Program->Steps[Program->CurrentStep].DurationMs;
+
+	Scheduler.Schedule(&Program->Timer, deadline);
+
+	return true;
+}
+
+#pragma endregion
@@ -0,0 +1,181 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+#include <ViGEm/Common.h>
+
+namespace ViGEm::Bus::Core
+{
+	class MacroSet;
+
+	//
+	// Button and axis values forced onto a report
+	// 
+	typedef struct _MACRO_OVERLAY
+	{
+		ULONG ButtonsSet;
+
+		ULONG ButtonsClear;
+
+		ULONG AxisMask;
+
+		LONG Axes[VIGEM_AXIS_COUNT];
+
+	} MACRO_OVERLAY, *PMACRO_OVERLAY;
+
+	//
+	// Timing wheel node, embedded in every running macro
+	// 
+	typedef struct _MACRO_TIMER
+	{
+		_MACRO_TIMER* Next;
+
+		_MACRO_TIMER** Link;
+
+		ULONGLONG Deadline;
+
+	} MACRO_TIMER, *PMACRO_TIMER;
+
+	//
+	// Hashed timing wheel shared by the macros of all targets on a bus.
+	// 
+	// Time is counted in ticks (milliseconds). Entries further out than one
+	// rotation stay in their slot until their deadline is reached. Zeroed
+	// memory is a valid, empty scheduler, so it can live in a WDF context.
+	// The component has no WDF dependencies; callers serialize access.
+	// 
+	class MacroScheduler
+	{
+	public:
+		void Schedule(PMACRO_TIMER Timer, ULONGLONG Deadline);
+
+		void Cancel(PMACRO_TIMER Timer);
+
+		bool IsEmpty() const { return this->_Count == 0; }
+
+		//
+		// Expires all timers due up to Now and steps their macros. Returns
+		// the list (linked through MacroSet::NextChanged) of macro sets
+		// whose overlay changed.
+		// 
+		MacroSet* Advance(ULONGLONG Now);
+
+	private:
+		static const ULONG WHEEL_SIZE = 0x100;
+
+		static const ULONG WHEEL_MASK = WHEEL_SIZE - 1;
+
+		PMACRO_TIMER _Slots[WHEEL_SIZE];
+
+		ULONGLONG _Current;
+
+		ULONG _Count;
+	};
+
+	//
+	// Macros running on one target.
+	// 
+	class MacroSet
+	{
+		friend class MacroScheduler;
+
+	public:
+		explicit MacroSet(PVOID Context) : _Context(Context) {}
+
+		//
+		// Validates and starts a macro in the given slot, replacing the
+		// one running there. RepeatCount 0 repeats forever.
+		// 
+		NTSTATUS Load(MacroScheduler& Scheduler, ULONGLONG Now, UCHAR Slot, USHORT RepeatCount,
+		              USHORT StepCount, const VIGEM_MACRO_STEP* Steps);
+
+		void Unload(MacroScheduler& Scheduler, UCHAR Slot);
+
+		void Clear(MacroScheduler& Scheduler);
+
+		bool IsActive() const { return this->_ActiveMask != 0; }
+
+		void GetOverlay(MACRO_OVERLAY& Overlay) const;
+
+		static void ApplyOverlay(const MACRO_OVERLAY& Overlay, ULONG& Buttons, LONG (&Axes)[VIGEM_AXIS_COUNT]);
+
+		PVOID GetContext() const { return this->_Context; }
+
+		MacroSet* NextChanged{};
+
+	private:
+		//
+		// Programs lagging further behind skip ahead instead of catching up
+		// 
+		static const ULONG RESYNC_TICKS = 0x100;
+
+		typedef struct _MACRO_PROGRAM
+		{
+			//
+			// Must stay the first member, expired timers get cast back
+			// 
+			MACRO_TIMER Timer;
+
+			MacroSet* Owner;
+
+			USHORT StepCount;
+
+			USHORT RepeatCount;
+
+			USHORT CurrentStep;
+
+			USHORT CurrentRun;
+
+			VIGEM_MACRO_STEP Steps[VIGEM_MACRO_MAX_STEPS];
+
+		} MACRO_PROGRAM, *PMACRO_PROGRAM;
+
+		//
+		// Moves an expired program to its next step, returns false once done
+		// 
+		static bool Step(PMACRO_PROGRAM Program, MacroScheduler& Scheduler, ULONGLONG Now);
+
+		PVOID _Context;
+
+		ULONG _ActiveMask{};
+
+		bool _Changed{};
+
+		MACRO_PROGRAM _Programs[VIGEM_MACRO_MAX_SLOTS]{};
+	};
+}
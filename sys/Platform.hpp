@@ -0,0 +1,401 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Kernel primitives used by the components without WDF dependencies.
+// 
+// Driver builds take them from the WDK. Defining VIGEM_PLATFORM_USER_MODE
+// maps the small subset those components use onto the C++ standard library
+// and GCC/Clang atomics, so they build and get unit tested on any such host
+// (see tests). Components include this instead of the WDK headers and use
+// nothing beyond what is defined here.
+// 
+#ifndef VIGEM_PLATFORM_USER_MODE
+
+#include <ntddk.h>
+#include <minwindef.h>
+
+#else
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <type_traits>
+
+#pragma region Types
+
+typedef void VOID;
+typedef char CHAR;
+typedef unsigned char UCHAR, BYTE, BOOLEAN, KIRQL;
+typedef int16_t SHORT;
+typedef uint16_t USHORT, WORD;
+typedef int32_t LONG, BOOL, NTSTATUS;
+typedef uint32_t ULONG, DWORD;
+typedef long long LONGLONG, LONG64;
+typedef unsigned long long ULONGLONG, ULONG64;
+typedef size_t SIZE_T;
+
+typedef void* PVOID;
+typedef const char* PCSTR;
+typedef UCHAR* PUCHAR;
+typedef USHORT* PUSHORT;
+typedef LONG* PLONG;
+typedef ULONG* PULONG;
+typedef ULONGLONG* PULONGLONG;
+
+#define TRUE 1
+#define FALSE 0
+
+#define MAXUSHORT 0xFFFF
+#define MAXULONG 0xFFFFFFFFUL
+
+#define FORCEINLINE inline
+#define DECLSPEC_CACHEALIGN alignas(64)
+#define RTL_NUMBER_OF(A) (sizeof(A) / sizeof((A)[0]))
+#define FIELD_OFFSET(Type, Field) (static_cast<LONG>(offsetof(Type, Field)))
+
+#define _In_
+#define _Out_
+#define _Inout_
+#define _In_reads_bytes_(Size)
+
+#pragma endregion
+
+#pragma region Shared interface
+
+//
+// Just enough of the I/O control vocabulary for BusShared.h to compile, 
+// the codes themselves are never sent anywhere in user mode
+// 
+#define IN
+#define OUT
+
+typedef struct _GUID
+{
+	ULONG Data1;
+	USHORT Data2;
+	USHORT Data3;
+	UCHAR Data4[8];
+} GUID;
+
+#define DEFINE_GUID(Name, L, W1, W2, B1, B2, B3, B4, B5, B6, B7, B8) \
+	inline constexpr GUID Name = { L, W1, W2, { B1, B2, B3, B4, B5, B6, B7, B8 } }
+
+#define FILE_DEVICE_BUS_EXTENDER 0x0000002A
+#define METHOD_BUFFERED 0
+#define FILE_READ_DATA 0x0001
+#define FILE_WRITE_DATA 0x0002
+
+#define CTL_CODE(DeviceType, Function, Method, Access) \
+	(((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
+
+#pragma endregion
+
+#pragma region Status codes
+
+#define STATUS_SUCCESS                  static_cast<NTSTATUS>(0x00000000L)
+#define STATUS_PENDING                  static_cast<NTSTATUS>(0x00000103L)
+#define STATUS_NO_MORE_ENTRIES          static_cast<NTSTATUS>(0x8000001AL)
+#define STATUS_INVALID_PARAMETER        static_cast<NTSTATUS>(0xC000000DL)
+#define STATUS_BUFFER_TOO_SMALL         static_cast<NTSTATUS>(0xC0000023L)
+#define STATUS_OBJECT_NAME_COLLISION    static_cast<NTSTATUS>(0xC0000035L)
+#define STATUS_INSUFFICIENT_RESOURCES   static_cast<NTSTATUS>(0xC000009AL)
+
+#define NT_SUCCESS(Status) (static_cast<NTSTATUS>(Status) >= 0)
+
+#pragma endregion
+
+#pragma region Helpers
+
+//
+// Functions rather than the WDK's macros, which would break the standard library
+// 
+template <typename A, typename B>
+constexpr std::common_type_t<A, B> max(A Lhs, B Rhs)
+{
+	typedef std::common_type_t<A, B> T;
+
+	return (static_cast<T>(Lhs) > static_cast<T>(Rhs)) ? static_cast<T>(Lhs) : static_cast<T>(Rhs);
+}
+
+template <typename A, typename B>
+constexpr std::common_type_t<A, B> min(A Lhs, B Rhs)
+{
+	typedef std::common_type_t<A, B> T;
+
+	return (static_cast<T>(Lhs) < static_cast<T>(Rhs)) ? static_cast<T>(Lhs) : static_cast<T>(Rhs);
+}
+
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+#define RtlCopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+#define RtlMoveMemory(Destination, Source, Length) memmove((Destination), (Source), (Length))
+
+FORCEINLINE BOOLEAN BitScanForward(PULONG Index, ULONG Mask)
+{
+	if (Mask == 0)
+		return FALSE;
+
+	*Index = static_cast<ULONG>(__builtin_ctz(Mask));
+
+	return TRUE;
+}
+
+#pragma endregion
+
+#pragma region Memory
+
+typedef enum _POOL_TYPE
+{
+	NonPagedPoolNx = 512
+
+} POOL_TYPE;
+
+//
+// Pool goes through the global allocator, so the benchmark counts it
+// 
+FORCEINLINE PVOID ExAllocatePoolWithTag(POOL_TYPE PoolType, SIZE_T NumberOfBytes, ULONG Tag)
+{
+	(void)PoolType;
+	(void)Tag;
+
+	return ::operator new(NumberOfBytes, std::nothrow);
+}
+
+FORCEINLINE VOID ExFreePoolWithTag(PVOID P, ULONG Tag)
+{
+	(void)Tag;
+
+	::operator delete(P);
+}
+
+#pragma endregion
+
+#pragma region Interlocked access
+
+FORCEINLINE LONG InterlockedIncrement(volatile LONG* Addend)
+{
+	return __atomic_add_fetch(Addend, 1, __ATOMIC_SEQ_CST);
+}
+
+FORCEINLINE LONG InterlockedDecrement(volatile LONG* Addend)
+{
+	return __atomic_sub_fetch(Addend, 1, __ATOMIC_SEQ_CST);
+}
+
+FORCEINLINE LONG InterlockedExchange(volatile LONG* Target, LONG Value)
+{
+	return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST);
+}
+
+FORCEINLINE LONG InterlockedCompareExchange(volatile LONG* Destination, LONG Exchange, LONG Comparand)
+{
+	__atomic_compare_exchange_n(Destination, &Comparand, Exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+	return Comparand;
+}
+
+FORCEINLINE LONG64 InterlockedIncrement64(volatile LONG64* Addend)
+{
+	return __atomic_add_fetch(Addend, 1, __ATOMIC_SEQ_CST);
+}
+
+FORCEINLINE LONG64 InterlockedExchange64(volatile LONG64* Target, LONG64 Value)
+{
+	return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST);
+}
+
+FORCEINLINE LONG64 InterlockedCompareExchange64(volatile LONG64* Destination, LONG64 Exchange, LONG64 Comparand)
+{
+	__atomic_compare_exchange_n(Destination, &Comparand, Exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+	return Comparand;
+}
+
+FORCEINLINE CHAR ReadNoFence8(const volatile CHAR* Source)
+{
+	return __atomic_load_n(Source, __ATOMIC_RELAXED);
+}
+
+FORCEINLINE VOID WriteRelease8(volatile CHAR* Destination, CHAR Value)
+{
+	__atomic_store_n(Destination, Value, __ATOMIC_RELEASE);
+}
+
+FORCEINLINE LONG ReadAcquire(const volatile LONG* Source)
+{
+	return __atomic_load_n(Source, __ATOMIC_ACQUIRE);
+}
+
+FORCEINLINE LONG64 ReadAcquire64(const volatile LONG64* Source)
+{
+	return __atomic_load_n(Source, __ATOMIC_ACQUIRE);
+}
+
+FORCEINLINE LONG64 ReadNoFence64(const volatile LONG64* Source)
+{
+	return __atomic_load_n(Source, __ATOMIC_RELAXED);
+}
+
+FORCEINLINE VOID WriteRelease64(volatile LONG64* Destination, LONG64 Value)
+{
+	__atomic_store_n(Destination, Value, __ATOMIC_RELEASE);
+}
+
+#define MemoryBarrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#define YieldProcessor() ((void)0)
+
+#pragma endregion
+
+#pragma region Lists
+
+typedef struct _LIST_ENTRY
+{
+	struct _LIST_ENTRY* Flink;
+	struct _LIST_ENTRY* Blink;
+
+} LIST_ENTRY, *PLIST_ENTRY;
+
+#define CONTAINING_RECORD(Address, Type, Field) \
+	(reinterpret_cast<Type*>(reinterpret_cast<PUCHAR>(Address) - offsetof(Type, Field)))
+
+FORCEINLINE VOID InitializeListHead(PLIST_ENTRY ListHead)
+{
+	ListHead->Flink = ListHead->Blink = ListHead;
+}
+
+FORCEINLINE BOOLEAN IsListEmpty(const LIST_ENTRY* ListHead)
+{
+	return ListHead->Flink == ListHead;
+}
+
+FORCEINLINE BOOLEAN RemoveEntryList(PLIST_ENTRY Entry)
+{
+	const PLIST_ENTRY flink = Entry->Flink;
+	const PLIST_ENTRY blink = Entry->Blink;
+
+	blink->Flink = flink;
+	flink->Blink = blink;
+
+	return flink == blink;
+}
+
+FORCEINLINE PLIST_ENTRY RemoveHeadList(PLIST_ENTRY ListHead)
+{
+	const PLIST_ENTRY entry = ListHead->Flink;
+
+	RemoveEntryList(entry);
+
+	return entry;
+}
+
+FORCEINLINE VOID InsertTailList(PLIST_ENTRY ListHead, PLIST_ENTRY Entry)
+{
+	const PLIST_ENTRY blink = ListHead->Blink;
+
+	Entry->Flink = ListHead;
+	Entry->Blink = blink;
+	blink->Flink = Entry;
+	ListHead->Blink = Entry;
+}
+
+#pragma endregion
+
+#pragma region Locks
+
+typedef struct _FAST_MUTEX
+{
+	std::mutex Lock;
+
+} FAST_MUTEX, *PFAST_MUTEX;
+
+FORCEINLINE VOID ExInitializeFastMutex(PFAST_MUTEX FastMutex)
+{
+	(void)FastMutex;
+}
+
+FORCEINLINE VOID ExAcquireFastMutex(PFAST_MUTEX FastMutex)
+{
+	FastMutex->Lock.lock();
+}
+
+FORCEINLINE VOID ExReleaseFastMutex(PFAST_MUTEX FastMutex)
+{
+	FastMutex->Lock.unlock();
+}
+
+typedef struct _EX_SPIN_LOCK
+{
+	std::shared_mutex Lock;
+
+} EX_SPIN_LOCK, *PEX_SPIN_LOCK;
+
+FORCEINLINE KIRQL ExAcquireSpinLockExclusive(PEX_SPIN_LOCK SpinLock)
+{
+	SpinLock->Lock.lock();
+
+	return 0;
+}
+
+FORCEINLINE VOID ExReleaseSpinLockExclusive(PEX_SPIN_LOCK SpinLock, KIRQL OldIrql)
+{
+	(void)OldIrql;
+
+	SpinLock->Lock.unlock();
+}
+
+FORCEINLINE KIRQL ExAcquireSpinLockShared(PEX_SPIN_LOCK SpinLock)
+{
+	SpinLock->Lock.lock_shared();
+
+	return 0;
+}
+
+FORCEINLINE VOID ExReleaseSpinLockShared(PEX_SPIN_LOCK SpinLock, KIRQL OldIrql)
+{
+	(void)OldIrql;
+
+	SpinLock->Lock.unlock_shared();
+}
+
+#pragma endregion
+
+#endif
@@ -0,0 +1,152 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+
+#include "PollPhase.hpp"
+
+
+VOID ViGEm::Bus::Core::PollPhaseEstimator::Arrival(ULONGLONG Now)
+{
+	if (InterlockedCompareExchange(&this->_Busy, 1, 0) != 0)
+		return;
+
+	InterlockedIncrement(&this->_Sequence);
+
+	const LONGLONG delta = static_cast<LONGLONG>(Now - this->_LastArrival);
+
+	if (this->_Samples == 0 || Now < this->_Phase)
+	{
+		this->_Phase = Now;
+		this->_Samples = 1;
+	}
+	else if (this->_Period == 0)
+	{
+		//
+		// The first interval in range seeds the period
+		// 
+		if (delta >= PERIOD_MIN && delta <= PERIOD_MAX)
+		{
+			this->_Period = delta;
+			this->_Samples++;
+		}
+
+		this->_Phase = Now;
+	}
+	else if (delta > this->_Period * GAP_PERIODS)
+	{
+		this->_Phase = Now;
+		this->_Samples = 1;
+	}
+	else
+	{
+		//
+		// Predict the poll closest to the arrival, skipped polls included
+		// 
+		const LONGLONG elapsed = static_cast<LONGLONG>(Now - this->_Phase);
+		const LONGLONG polls = max((elapsed + this->_Period / 2) / this->_Period, 1);
+		const ULONGLONG predicted = this->_Phase + polls * this->_Period;
+		const LONGLONG error = static_cast<LONGLONG>(Now - predicted);
+
+		this->_Phase = predicted + error / PHASE_GAIN;
+		this->_Period = min(max(this->_Period + error / (polls * PERIOD_GAIN), PERIOD_MIN), PERIOD_MAX);
+		this->_Jitter += ((error < 0 ? -error : error) - this->_Jitter) / JITTER_GAIN;
+
+		if (this->_Samples < MAXULONG)
+			this->_Samples++;
+	}
+
+	this->_LastArrival = Now;
+
+	InterlockedIncrement(&this->_Sequence);
+	InterlockedExchange(&this->_Busy, 0);
+}
+
+VOID ViGEm::Bus::Core::PollPhaseEstimator::Snapshot(ULONGLONG Now, PVIGEM_POLL_PHASE Phase) const
+{
+	ULONGLONG phase = 0;
+	LONGLONG period = 0;
+	LONGLONG jitter = 0;
+	ULONG samples = 0;
+
+	for (ULONG attempt = 0; attempt < SNAPSHOT_RETRIES; attempt++)
+	{
+		const LONG sequence = ReadAcquire(&this->_Sequence);
+
+		if (sequence & 1)
+		{
+			YieldProcessor();
+			continue;
+		}
+
+		phase = this->_Phase;
+		period = this->_Period;
+		jitter = this->_Jitter;
+		samples = this->_Samples;
+
+		MemoryBarrier();
+
+		if (ReadAcquire(&this->_Sequence) == sequence)
+			break;
+
+		//
+		// Report no estimate rather than a torn one
+		// 
+		samples = 0;
+	}
+
+	RtlZeroMemory(Phase, sizeof(VIGEM_POLL_PHASE));
+
+	Phase->Now = Now;
+
+	if (samples == 0)
+		return;
+
+	Phase->LastPoll = phase;
+	Phase->Samples = samples;
+
+	if (period == 0)
+		return;
+
+	ULONGLONG next = phase + period;
+
+	if (next <= Now)
+		next += ((Now - next) / period + 1) * period;
+
+	Phase->NextPoll = next;
+	Phase->Period = static_cast<ULONG>(period);
+	Phase->Jitter = static_cast<ULONG>(jitter);
+	Phase->Locked = samples >= LOCK_SAMPLES && jitter * 4 < period;
+}
@@ -0,0 +1,128 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+#include <ViGEm/Common.h>
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Tracks when the host polls an interrupt IN pipe (phase-locked loop).
+	// 
+	// Each arrival is compared to the predicted poll; a fraction of the
+	// error corrects the phase, a smaller one the period. Time is in 100ns
+	// units of interrupt time. Arrivals are serialized internally and a
+	// concurrent one is dropped; snapshots may be taken at any time.
+	// Zeroed memory is a valid estimator without samples. The component
+	// has no WDF dependencies.
+	// 
+	class PollPhaseEstimator
+	{
+	public:
+		//
+		// Feeds the time an interrupt IN transfer arrived
+		// 
+		VOID Arrival(ULONGLONG Now);
+
+		//
+		// Copies the current estimate, predicting the next poll after Now
+		// 
+		VOID Snapshot(ULONGLONG Now, PVIGEM_POLL_PHASE Phase) const;
+
+	private:
+		//
+		// Accepted poll periods, a high-speed microframe to 100ms
+		// 
+		static const LONGLONG PERIOD_MIN = 1250;
+		static const LONGLONG PERIOD_MAX = 1000000;
+
+		//
+		// Divisors applied to the phase error for phase, period and jitter
+		// 
+		static const LONGLONG PHASE_GAIN = 4;
+		static const LONGLONG PERIOD_GAIN = 16;
+		static const LONGLONG JITTER_GAIN = 8;
+
+		//
+		// Silence of this many periods means polling stopped; the phase
+		// gets acquired anew
+		// 
+		static const LONGLONG GAP_PERIODS = 8;
+
+		//
+		// Samples needed before the estimate counts as locked
+		// 
+		static const ULONG LOCK_SAMPLES = 16;
+
+		//
+		// Snapshot attempts before giving up on a concurrent update
+		// 
+		static const ULONG SNAPSHOT_RETRIES = 64;
+
+		//
+		// Set while an arrival is processed
+		// 
+		volatile LONG _Busy;
+
+		//
+		// Odd while the estimate is being updated
+		// 
+		volatile LONG _Sequence;
+
+		//
+		// Estimated time of the most recent poll
+		// 
+		ULONGLONG _Phase;
+
+		//
+		// Estimated poll period, 0 until two arrivals were seen
+		// 
+		LONGLONG _Period;
+
+		//
+		// Mean absolute phase error
+		// 
+		LONGLONG _Jitter;
+
+		ULONGLONG _LastArrival;
+
+		ULONG _Samples;
+	};
+}
@@ -48,129 +48,1107 @@ using ViGEm::Bus::Core::EmulationTargetPDO;
 using ViGEm::Bus::Targets::EmulationTargetXUSB;
 using ViGEm::Bus::Targets::EmulationTargetDS4;
 
+//
+// Returns the session ID of the file handle the request was issued on.
+// 
+static LONG Bus_GetRequestSessionId(WDFREQUEST Request)
+{
+	const WDFFILEOBJECT fileObject = WdfRequestGetFileObject(Request);
+
+	if (fileObject == nullptr)
+		return 0;
+
+	const PFDO_FILE_DATA pFileData = FileObjectGetData(fileObject);
+
+	return (pFileData != nullptr) ? pFileData->SessionId : 0;
+}
+
+//
+// Whether the request was issued on a handle allowed to use bus-wide
+// diagnostics and settings.
+// 
+static bool Bus_IsPrivilegedRequest(WDFREQUEST Request)
+{
+	const WDFFILEOBJECT fileObject = WdfRequestGetFileObject(Request);
+
+	if (fileObject == nullptr)
+		return WdfRequestGetRequestorMode(Request) == KernelMode;
+
+	const PFDO_FILE_DATA pFileData = FileObjectGetData(fileObject);
+
+	return (pFileData != nullptr) && pFileData->Privileged;
+}
+
+//
+// Submits a report subject to the rate limit of the issuing session.
+// Reports exceeding it are coalesced and delivered once admitted.
+// 
+static NTSTATUS Bus_SubmitReport(WDFREQUEST Request, EmulationTargetPDO* Pdo, PVOID Report)
+{
+	const WDFFILEOBJECT fileObject = WdfRequestGetFileObject(Request);
+	const PFDO_FILE_DATA pFileData = (fileObject != nullptr) ? FileObjectGetData(fileObject) : nullptr;
+
+	if (pFileData == nullptr)
+		return Pdo->SubmitReport(Report, 0);
+
+	KIRQL irql;
+	const ULONGLONG now = KeQueryInterruptTime();
+
+	KeAcquireSpinLock(&pFileData->QosLock, &irql);
+	const bool admitted = !pFileData->Qos.IsLimited() || pFileData->Qos.TryAcquire(now);
+	KeReleaseSpinLock(&pFileData->QosLock, irql);
+
+	if (admitted)
+		return Pdo->SubmitReport(Report, pFileData->SessionId);
+
+	//
+	// Held back reports get no status of their own, fail the ones the
+	// target would reject right away
+	// 
+	const NTSTATUS status = Pdo->ValidateReport(Report, pFileData->SessionId);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	//
+	// The first held back report of a session reserves a delivery slot on
+	// that session's budget, later ones merely replace it so a flooding
+	// session can't queue up work. Rescheduling moves the pending timer
+	// to the slot of the new owner.
+	// 
+	if (Pdo->CoalesceReport(Report, pFileData->SessionId))
+	{
+		KeAcquireSpinLock(&pFileData->QosLock, &irql);
+		const ULONGLONG due = pFileData->Qos.Reserve(now);
+		KeReleaseSpinLock(&pFileData->QosLock, irql);
+
+		Pdo->ScheduleCoalescedReport(due);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+EXTERN_C_START
+
+//
+// Responds to I/O control requests sent to the FDO.
+// 
+VOID Bus_EvtIoDeviceControl(
+	IN WDFQUEUE Queue,
+	IN WDFREQUEST Request,
+	IN size_t OutputBufferLength,
+	IN size_t InputBufferLength,
+	IN ULONG IoControlCode
+)
+{
+	NTSTATUS status = STATUS_INVALID_PARAMETER;
+	WDFDEVICE Device;
+	size_t length = 0;
+	PXUSB_SUBMIT_REPORT xusbSubmit = nullptr;
+	PXUSB_REQUEST_NOTIFICATION xusbNotify = nullptr;
+	PDS4_SUBMIT_REPORT ds4Submit = nullptr;
+	PDS4_REQUEST_NOTIFICATION ds4Notify = nullptr;
+	PVIGEM_CHECK_VERSION pCheckVersion = nullptr;
+	PVIGEM_WAIT_DEVICE_READY pWaitDeviceReady = nullptr;
+	PXUSB_GET_USER_INDEX pXusbGetUserIndex = nullptr;
+	PXUSB_WAIT_USER_INDEX pXusbWaitUserIndex = nullptr;
+	PVIGEM_SET_AXIS_TRANSFORM pSetAxisTransform = nullptr;
+	PVIGEM_SET_AGGREGATION pSetAggregation = nullptr;
+	PVIGEM_ATTACH_SOURCE pAttachSource = nullptr;
+	PVIGEM_SET_RECORDING pSetRecording = nullptr;
+	PVIGEM_DRAIN_RECORDING pDrainRecording = nullptr;
+	size_t drainLength = 0;
+	PVIGEM_SET_MACRO pSetMacro = nullptr;
+	PVIGEM_SET_SESSION_QOS pSetSessionQos = nullptr;
+	PVIGEM_GET_STATISTICS pGetStatistics = nullptr;
+	PVIGEM_SET_EVENT_TRACE pSetEventTrace = nullptr;
+	PVIGEM_DRAIN_EVENTS pDrainEvents = nullptr;
+	PVIGEM_GET_FOOTPRINT pGetFootprint = nullptr;
+	PVIGEM_SET_TARGET_POOL pSetTargetPool = nullptr;
+	PVIGEM_GET_POLL_PHASE pGetPollPhase = nullptr;
+	PVIGEM_GET_PLUGIN_TIMELINE pGetPluginTimeline = nullptr;
+	PVIGEM_SET_RAW_OUTPUT pSetRawOutput = nullptr;
+	PVIGEM_DRAIN_RAW_OUTPUT pDrainRawOutput = nullptr;
+	PVIGEM_GET_CAPABILITIES pGetCapabilities = nullptr;
+	VIGEM_BUS_CAPABILITIES capabilities;
+	LARGE_INTEGER frequency;
+	EmulationTargetPDO* pdo;
+
+	Device = WdfIoQueueGetDevice(Queue);
+
+	TraceDbg(TRACE_QUEUE, "%!FUNC! Entry (device: 0x%p)", Device);
+
+	switch (IoControlCode)
+	{
+#pragma region IOCTL_VIGEM_CHECK_VERSION
+
+	case IOCTL_VIGEM_CHECK_VERSION:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_CHECK_VERSION");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_CHECK_VERSION),
+			reinterpret_cast<PVOID*>(&pCheckVersion),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_CHECK_VERSION))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		status = (pCheckVersion->Version == VIGEM_COMMON_VERSION) ? STATUS_SUCCESS : STATUS_NOT_SUPPORTED;
+
+		TraceEvents(TRACE_LEVEL_VERBOSE,
+		            TRACE_QUEUE,
+		            "Requested version: 0x%04X, compiled version: 0x%04X",
+		            pCheckVersion->Version, VIGEM_COMMON_VERSION);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_WAIT_DEVICE_READY
+
+	case IOCTL_VIGEM_WAIT_DEVICE_READY:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_WAIT_DEVICE_READY");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_WAIT_DEVICE_READY),
+			reinterpret_cast<PVOID*>(&pWaitDeviceReady),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_WAIT_DEVICE_READY))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pWaitDeviceReady->SerialNo == 0)
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_QUEUE,
+				"Invalid serial 0 submitted");
+
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		status = EmulationTargetPDO::EnqueueWaitDeviceReady(
+			Device,
+			pWaitDeviceReady->SerialNo,
+			Request
+		);
+
+		status = NT_SUCCESS(status) ? STATUS_PENDING : STATUS_DEVICE_DOES_NOT_EXIST;
+		
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_PLUGIN_TARGET
+
+	case IOCTL_VIGEM_PLUGIN_TARGET:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_PLUGIN_TARGET");
+
+		status = Bus_PlugInDevice(Device, Request, FALSE, FALSE, &length);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_PLUGIN_TARGET_EX
+
+	case IOCTL_VIGEM_PLUGIN_TARGET_EX:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_PLUGIN_TARGET_EX");
+
+		status = Bus_PlugInDevice(Device, Request, FALSE, TRUE, &length);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_UNPLUG_TARGET
+
+	case IOCTL_VIGEM_UNPLUG_TARGET:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_UNPLUG_TARGET");
+
+		status = Bus_UnPlugDevice(Device, Request, FALSE, &length);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_SET_AXIS_TRANSFORM
+
+	case IOCTL_VIGEM_SET_AXIS_TRANSFORM:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SET_AXIS_TRANSFORM");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_SET_AXIS_TRANSFORM),
+			reinterpret_cast<PVOID*>(&pSetAxisTransform),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_SET_AXIS_TRANSFORM)
+			|| pSetAxisTransform->Size != sizeof(VIGEM_SET_AXIS_TRANSFORM))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pSetAxisTransform->SerialNo == 0)
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "Invalid serial 0 submitted");
+
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pSetAxisTransform->SerialNo, &pdo))
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+		else
+			status = pdo->SetAxisTransform(pSetAxisTransform->Enable, pSetAxisTransform->Axes);
+
+		//
+		// Nothing gets returned to the caller
+		// 
+		length = 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_SET_AGGREGATION
+
+	case IOCTL_VIGEM_SET_AGGREGATION:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SET_AGGREGATION");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_SET_AGGREGATION),
+			reinterpret_cast<PVOID*>(&pSetAggregation),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_SET_AGGREGATION)
+			|| pSetAggregation->Size != sizeof(VIGEM_SET_AGGREGATION))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pSetAggregation->SerialNo == 0)
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "Invalid serial 0 submitted");
+
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pSetAggregation->SerialNo, &pdo))
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+		else
+			status = pdo->SetAggregation(
+				pSetAggregation->Enable,
+				pSetAggregation->AxisMode,
+				pSetAggregation->Priority
+			);
+
+		length = 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_ATTACH_SOURCE
+
+	case IOCTL_VIGEM_ATTACH_SOURCE:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_ATTACH_SOURCE");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_ATTACH_SOURCE),
+			reinterpret_cast<PVOID*>(&pAttachSource),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_ATTACH_SOURCE)
+			|| pAttachSource->Size != sizeof(VIGEM_ATTACH_SOURCE))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pAttachSource->SerialNo == 0)
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "Invalid serial 0 submitted");
+
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, pAttachSource->TargetType, pAttachSource->SerialNo, &pdo))
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+		else
+			status = pdo->AttachSource(
+				Bus_GetRequestSessionId(Request),
+				pAttachSource->Attach,
+				pAttachSource->Priority
+			);
+
+		//
+		// Handle close has to look for targets to detach from
+		// 
+		if (NT_SUCCESS(status) && pAttachSource->Attach && WdfRequestGetFileObject(Request) != nullptr)
+			InterlockedExchange(&FileObjectGetData(WdfRequestGetFileObject(Request))->HasAttachedSources, TRUE);
+
+		length = 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_SET_RECORDING
+
+	case IOCTL_VIGEM_SET_RECORDING:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SET_RECORDING");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_SET_RECORDING),
+			reinterpret_cast<PVOID*>(&pSetRecording),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_SET_RECORDING)
+			|| pSetRecording->Size != sizeof(VIGEM_SET_RECORDING))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pSetRecording->SerialNo == 0)
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "Invalid serial 0 submitted");
+
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pSetRecording->SerialNo, &pdo))
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+		else
+			status = pdo->SetRecording(pSetRecording->Enable, pSetRecording->Capacity);
+
+		length = 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_DRAIN_RECORDING
+
+	case IOCTL_VIGEM_DRAIN_RECORDING:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_DRAIN_RECORDING");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_DRAIN_RECORDING),
+			reinterpret_cast<PVOID*>(&pDrainRecording),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || pDrainRecording->Size != sizeof(VIGEM_DRAIN_RECORDING))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pDrainRecording->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		//
+		// Input and output share the system buffer, log data follows the header
+		// 
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_DRAIN_RECORDING),
+			reinterpret_cast<PVOID*>(&pDrainRecording),
+			&drainLength
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			            status);
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pDrainRecording->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			break;
+		}
+
+		status = pdo->DrainRecording(
+			reinterpret_cast<PUCHAR>(pDrainRecording) + sizeof(VIGEM_DRAIN_RECORDING),
+			static_cast<ULONG>(drainLength - sizeof(VIGEM_DRAIN_RECORDING)),
+			&pDrainRecording->Length,
+			&pDrainRecording->Dropped
+		);
+
+		length = NT_SUCCESS(status) ? sizeof(VIGEM_DRAIN_RECORDING) + pDrainRecording->Length : 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_SET_MACRO
+
+	case IOCTL_VIGEM_SET_MACRO:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SET_MACRO");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_SET_MACRO),
+			reinterpret_cast<PVOID*>(&pSetMacro),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_SET_MACRO)
+			|| pSetMacro->Size != sizeof(VIGEM_SET_MACRO))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pSetMacro->SerialNo == 0)
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "Invalid serial 0 submitted");
+
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pSetMacro->SerialNo, &pdo))
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+		else
+			status = pdo->SetMacro(
+				pSetMacro->Slot,
+				pSetMacro->Enable,
+				pSetMacro->RepeatCount,
+				pSetMacro->StepCount,
+				pSetMacro->Steps
+			);
+
+		length = 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_SET_SESSION_QOS
+
+	case IOCTL_VIGEM_SET_SESSION_QOS:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SET_SESSION_QOS");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_SET_SESSION_QOS),
+			reinterpret_cast<PVOID*>(&pSetSessionQos),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_SET_SESSION_QOS)
+			|| pSetSessionQos->Size != sizeof(VIGEM_SET_SESSION_QOS)
+			|| pSetSessionQos->Class >= VIGEM_QOS_CLASS_COUNT
+			|| WdfRequestGetFileObject(Request) == nullptr)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		Bus_SetSessionQos(
+			FileObjectGetData(WdfRequestGetFileObject(Request)),
+			pSetSessionQos->Class,
+			pSetSessionQos->ReportsPerSecond,
+			pSetSessionQos->Burst
+		);
+
+		length = 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_GET_STATISTICS
+
+	case IOCTL_VIGEM_GET_STATISTICS:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_GET_STATISTICS");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_GET_STATISTICS),
+			reinterpret_cast<PVOID*>(&pGetStatistics),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || pGetStatistics->Size != sizeof(VIGEM_GET_STATISTICS))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pGetStatistics->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_GET_STATISTICS),
+			reinterpret_cast<PVOID*>(&pGetStatistics),
+			&length
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			            status);
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pGetStatistics->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			length = 0;
+			break;
+		}
+
+		pdo->GetUrbStatistics(pGetStatistics->UrbCounts);
+
+		length = sizeof(VIGEM_GET_STATISTICS);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_SET_EVENT_TRACE
+
+	case IOCTL_VIGEM_SET_EVENT_TRACE:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SET_EVENT_TRACE");
+
+		// Records cover the targets of all sessions
+		if (!Bus_IsPrivilegedRequest(Request))
+		{
+			status = STATUS_ACCESS_DENIED;
+			break;
+		}
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_SET_EVENT_TRACE),
+			reinterpret_cast<PVOID*>(&pSetEventTrace),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_SET_EVENT_TRACE)
+			|| pSetEventTrace->Size != sizeof(VIGEM_SET_EVENT_TRACE))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// Ring indices get masked, the capacity must be a power of two
+		if (pSetEventTrace->Enable
+			&& (pSetEventTrace->Capacity < VIGEM_EVENT_TRACE_MIN_CAPACITY
+				|| pSetEventTrace->Capacity > VIGEM_EVENT_TRACE_MAX_CAPACITY
+				|| (pSetEventTrace->Capacity & (pSetEventTrace->Capacity - 1)) != 0))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		status = FdoGetData(Device)->Events.SetEnabled(pSetEventTrace->Enable, pSetEventTrace->Capacity);
+
+		TraceEvents(TRACE_LEVEL_INFORMATION,
+		            TRACE_QUEUE,
+		            "Event trace %s (capacity %d) with status %!STATUS!",
+		            pSetEventTrace->Enable ? "enabled" : "disabled",
+		            pSetEventTrace->Capacity,
+		            status);
+
+		length = 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_DRAIN_EVENTS
+
+	case IOCTL_VIGEM_DRAIN_EVENTS:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_DRAIN_EVENTS");
+
+		// Records cover the targets of all sessions
+		if (!Bus_IsPrivilegedRequest(Request))
+		{
+			status = STATUS_ACCESS_DENIED;
+			break;
+		}
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_DRAIN_EVENTS),
+			reinterpret_cast<PVOID*>(&pDrainEvents),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || pDrainEvents->Size != sizeof(VIGEM_DRAIN_EVENTS))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		//
+		// Input and output share the system buffer, records follow the header
+		// 
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_DRAIN_EVENTS),
+			reinterpret_cast<PVOID*>(&pDrainEvents),
+			&length
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			            status);
+			break;
+		}
+
+		pDrainEvents->Count = FdoGetData(Device)->Events.Drain(
+			reinterpret_cast<PVIGEM_EVENT_RECORD>(pDrainEvents + 1),
+			static_cast<ULONG>((length - sizeof(VIGEM_DRAIN_EVENTS)) / sizeof(VIGEM_EVENT_RECORD)),
+			&pDrainEvents->Dropped
+		);
+
+		(void)KeQueryPerformanceCounter(&frequency);
+		pDrainEvents->Frequency = frequency.QuadPart;
+
+		length = sizeof(VIGEM_DRAIN_EVENTS) + pDrainEvents->Count * sizeof(VIGEM_EVENT_RECORD);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_GET_FOOTPRINT
+
+	case IOCTL_VIGEM_GET_FOOTPRINT:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_GET_FOOTPRINT");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_GET_FOOTPRINT),
+			reinterpret_cast<PVOID*>(&pGetFootprint),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || pGetFootprint->Size != sizeof(VIGEM_GET_FOOTPRINT))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pGetFootprint->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_GET_FOOTPRINT),
+			reinterpret_cast<PVOID*>(&pGetFootprint),
+			&length
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			            status);
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pGetFootprint->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			length = 0;
+			break;
+		}
 
-EXTERN_C_START
+		pdo->GetFootprint(&pGetFootprint->Footprint);
 
-//
-// Responds to I/O control requests sent to the FDO.
-// 
-VOID Bus_EvtIoDeviceControl(
-	IN WDFQUEUE Queue,
-	IN WDFREQUEST Request,
-	IN size_t OutputBufferLength,
-	IN size_t InputBufferLength,
-	IN ULONG IoControlCode
-)
-{
-	NTSTATUS status = STATUS_INVALID_PARAMETER;
-	WDFDEVICE Device;
-	size_t length = 0;
-	PXUSB_SUBMIT_REPORT xusbSubmit = nullptr;
-	PXUSB_REQUEST_NOTIFICATION xusbNotify = nullptr;
-	PDS4_SUBMIT_REPORT ds4Submit = nullptr;
-	PDS4_REQUEST_NOTIFICATION ds4Notify = nullptr;
-	PVIGEM_CHECK_VERSION pCheckVersion = nullptr;
-	PVIGEM_WAIT_DEVICE_READY pWaitDeviceReady = nullptr;
-	PXUSB_GET_USER_INDEX pXusbGetUserIndex = nullptr;
-	EmulationTargetPDO* pdo;
+		length = sizeof(VIGEM_GET_FOOTPRINT);
 
-	Device = WdfIoQueueGetDevice(Queue);
+		break;
 
-	TraceDbg(TRACE_QUEUE, "%!FUNC! Entry (device: 0x%p)", Device);
+#pragma endregion
 
-	switch (IoControlCode)
-	{
-#pragma region IOCTL_VIGEM_CHECK_VERSION
+#pragma region IOCTL_VIGEM_SET_TARGET_POOL
 
-	case IOCTL_VIGEM_CHECK_VERSION:
+	case IOCTL_VIGEM_SET_TARGET_POOL:
 
-		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_CHECK_VERSION");
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SET_TARGET_POOL");
+
+		// The pool is shared by all sessions
+		if (!Bus_IsPrivilegedRequest(Request))
+		{
+			status = STATUS_ACCESS_DENIED;
+			break;
+		}
 
 		status = WdfRequestRetrieveInputBuffer(
 			Request,
-			sizeof(VIGEM_CHECK_VERSION),
-			reinterpret_cast<PVOID*>(&pCheckVersion),
+			sizeof(VIGEM_SET_TARGET_POOL),
+			reinterpret_cast<PVOID*>(&pSetTargetPool),
 			&length
 		);
 
-		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_CHECK_VERSION))
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_SET_TARGET_POOL)
+			|| pSetTargetPool->Size != sizeof(VIGEM_SET_TARGET_POOL))
 		{
 			status = STATUS_INVALID_PARAMETER;
 			break;
 		}
 
-		status = (pCheckVersion->Version == VIGEM_COMMON_VERSION) ? STATUS_SUCCESS : STATUS_NOT_SUPPORTED;
+		status = Bus_SetTargetPool(Device, pSetTargetPool->TargetType, pSetTargetPool->Depth);
 
-		TraceEvents(TRACE_LEVEL_VERBOSE,
-		            TRACE_QUEUE,
-		            "Requested version: 0x%04X, compiled version: 0x%04X",
-		            pCheckVersion->Version, VIGEM_COMMON_VERSION);
+		length = 0;
 
 		break;
 
 #pragma endregion
 
-#pragma region IOCTL_VIGEM_WAIT_DEVICE_READY
+#pragma region IOCTL_VIGEM_GET_POLL_PHASE
 
-	case IOCTL_VIGEM_WAIT_DEVICE_READY:
+	case IOCTL_VIGEM_GET_POLL_PHASE:
 
-		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_WAIT_DEVICE_READY");
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_GET_POLL_PHASE");
 
 		status = WdfRequestRetrieveInputBuffer(
 			Request,
-			sizeof(VIGEM_WAIT_DEVICE_READY),
-			reinterpret_cast<PVOID*>(&pWaitDeviceReady),
+			sizeof(VIGEM_GET_POLL_PHASE),
+			reinterpret_cast<PVOID*>(&pGetPollPhase),
 			&length
 		);
 
-		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_WAIT_DEVICE_READY))
+		if (!NT_SUCCESS(status) || pGetPollPhase->Size != sizeof(VIGEM_GET_POLL_PHASE))
 		{
 			status = STATUS_INVALID_PARAMETER;
 			break;
 		}
 
 		// This request only supports a single PDO at a time
-		if (pWaitDeviceReady->SerialNo == 0)
+		if (pGetPollPhase->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_GET_POLL_PHASE),
+			reinterpret_cast<PVOID*>(&pGetPollPhase),
+			&length
+		);
+
+		if (!NT_SUCCESS(status))
 		{
 			TraceEvents(TRACE_LEVEL_ERROR,
-				TRACE_QUEUE,
-				"Invalid serial 0 submitted");
+			            TRACE_QUEUE,
+			            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			            status);
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pGetPollPhase->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			length = 0;
+			break;
+		}
+
+		pdo->GetPollPhase(&pGetPollPhase->Phase);
+
+		length = sizeof(VIGEM_GET_POLL_PHASE);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_GET_PLUGIN_TIMELINE
+
+	case IOCTL_VIGEM_GET_PLUGIN_TIMELINE:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_GET_PLUGIN_TIMELINE");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_GET_PLUGIN_TIMELINE),
+			reinterpret_cast<PVOID*>(&pGetPluginTimeline),
+			&length
+		);
 
+		if (!NT_SUCCESS(status) || pGetPluginTimeline->Size != sizeof(VIGEM_GET_PLUGIN_TIMELINE))
+		{
 			status = STATUS_INVALID_PARAMETER;
 			break;
 		}
 
-		status = EmulationTargetPDO::EnqueueWaitDeviceReady(
-			Device,
-			pWaitDeviceReady->SerialNo,
-			Request
+		// This request only supports a single PDO at a time
+		if (pGetPluginTimeline->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_GET_PLUGIN_TIMELINE),
+			reinterpret_cast<PVOID*>(&pGetPluginTimeline),
+			&length
 		);
 
-		status = NT_SUCCESS(status) ? STATUS_PENDING : STATUS_DEVICE_DOES_NOT_EXIST;
-		
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			            status);
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pGetPluginTimeline->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			length = 0;
+			break;
+		}
+
+		pdo->GetPluginTimeline(&pGetPluginTimeline->Timeline);
+
+		length = sizeof(VIGEM_GET_PLUGIN_TIMELINE);
+
 		break;
 
 #pragma endregion
 
-#pragma region IOCTL_VIGEM_PLUGIN_TARGET
+#pragma region IOCTL_VIGEM_SET_RAW_OUTPUT
 
-	case IOCTL_VIGEM_PLUGIN_TARGET:
+	case IOCTL_VIGEM_SET_RAW_OUTPUT:
 
-		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_PLUGIN_TARGET");
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SET_RAW_OUTPUT");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_SET_RAW_OUTPUT),
+			reinterpret_cast<PVOID*>(&pSetRawOutput),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || length != sizeof(VIGEM_SET_RAW_OUTPUT)
+			|| pSetRawOutput->Size != sizeof(VIGEM_SET_RAW_OUTPUT))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pSetRawOutput->SerialNo == 0)
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "Invalid serial 0 submitted");
+
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pSetRawOutput->SerialNo, &pdo))
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+		else
+			status = pdo->SetRawOutput(pSetRawOutput->Enable, pSetRawOutput->Capacity);
 
-		status = Bus_PlugInDevice(Device, Request, FALSE, &length);
+		length = 0;
 
 		break;
 
 #pragma endregion
 
-#pragma region IOCTL_VIGEM_UNPLUG_TARGET
+#pragma region IOCTL_VIGEM_DRAIN_RAW_OUTPUT
 
-	case IOCTL_VIGEM_UNPLUG_TARGET:
+	case IOCTL_VIGEM_DRAIN_RAW_OUTPUT:
 
-		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_UNPLUG_TARGET");
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_DRAIN_RAW_OUTPUT");
 
-		status = Bus_UnPlugDevice(Device, Request, FALSE, &length);
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_DRAIN_RAW_OUTPUT),
+			reinterpret_cast<PVOID*>(&pDrainRawOutput),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || pDrainRawOutput->Size != sizeof(VIGEM_DRAIN_RAW_OUTPUT))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pDrainRawOutput->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		//
+		// Input and output share the system buffer, records follow the header
+		// 
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_DRAIN_RAW_OUTPUT),
+			reinterpret_cast<PVOID*>(&pDrainRawOutput),
+			&drainLength
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			            status);
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(Device, pDrainRawOutput->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			break;
+		}
+
+		status = pdo->DrainRawOutput(
+			reinterpret_cast<PUCHAR>(pDrainRawOutput) + sizeof(VIGEM_DRAIN_RAW_OUTPUT),
+			static_cast<ULONG>(drainLength - sizeof(VIGEM_DRAIN_RAW_OUTPUT)),
+			&pDrainRawOutput->Length,
+			&pDrainRawOutput->Dropped
+		);
+
+		length = NT_SUCCESS(status) ? sizeof(VIGEM_DRAIN_RAW_OUTPUT) + pDrainRawOutput->Length : 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_GET_CAPABILITIES
+
+	case IOCTL_VIGEM_GET_CAPABILITIES:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_GET_CAPABILITIES");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			VIGEM_GET_CAPABILITIES_MIN_SIZE,
+			reinterpret_cast<PVOID*>(&pGetCapabilities),
+			&length
+		);
+
+		//
+		// Older and newer clients send smaller or larger structures
+		// 
+		if (!NT_SUCCESS(status)
+			|| pGetCapabilities->Size < VIGEM_GET_CAPABILITIES_MIN_SIZE
+			|| pGetCapabilities->Size > length)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			length = 0;
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			pGetCapabilities->Size,
+			reinterpret_cast<PVOID*>(&pGetCapabilities),
+			&length
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			            status);
+			length = 0;
+			break;
+		}
+
+		Bus_QueryCapabilities(Device, &capabilities);
+
+		length = min(static_cast<size_t>(pGetCapabilities->Size), sizeof(VIGEM_GET_CAPABILITIES));
+		capabilities.Size = static_cast<ULONG>(length - FIELD_OFFSET(VIGEM_GET_CAPABILITIES, Capabilities));
+
+		RtlCopyMemory(&pGetCapabilities->Capabilities, &capabilities, capabilities.Size);
 
 		break;
 
@@ -214,7 +1192,7 @@ VOID Bus_EvtIoDeviceControl(
 			if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, Xbox360Wired, xusbSubmit->SerialNo, &pdo))
 				status = STATUS_DEVICE_DOES_NOT_EXIST;
 			else
-				status = pdo->SubmitReport(xusbSubmit);
+				status = Bus_SubmitReport(Request, pdo, xusbSubmit);
 		}
 
 		break;
@@ -348,7 +1326,7 @@ VOID Bus_EvtIoDeviceControl(
 		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, DualShock4Wired, ds4Submit->SerialNo, &pdo))
 			status = STATUS_DEVICE_DOES_NOT_EXIST;
 		else
-			status = pdo->SubmitReport(ds4Submit);
+			status = Bus_SubmitReport(Request, pdo, ds4Submit);
 
 		break;
 
@@ -458,6 +1436,60 @@ VOID Bus_EvtIoDeviceControl(
 
 		break;
 
+#pragma endregion
+
+#pragma region IOCTL_XUSB_WAIT_USER_INDEX
+
+	case IOCTL_XUSB_WAIT_USER_INDEX:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_XUSB_WAIT_USER_INDEX");
+
+		// Don't accept the request if the output buffer can't hold the results
+		if (OutputBufferLength < sizeof(XUSB_WAIT_USER_INDEX))
+		{
+			KdPrint((DRIVERNAME "IOCTL_XUSB_WAIT_USER_INDEX: output buffer too small: %ul\n", OutputBufferLength));
+			break;
+		}
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(XUSB_WAIT_USER_INDEX),
+			reinterpret_cast<PVOID*>(&pXusbWaitUserIndex),
+			&length);
+
+		if (!NT_SUCCESS(status))
+		{
+			KdPrint((DRIVERNAME "WdfRequestRetrieveInputBuffer failed 0x%x\n", status));
+			break;
+		}
+
+		if ((sizeof(XUSB_WAIT_USER_INDEX) == pXusbWaitUserIndex->Size) && (length == InputBufferLength))
+		{
+			// This request only supports a single PDO at a time
+			if (pXusbWaitUserIndex->SerialNo == 0)
+			{
+				status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+
+			if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, Xbox360Wired, pXusbWaitUserIndex->SerialNo, &pdo))
+			{
+				status = STATUS_DEVICE_DOES_NOT_EXIST;
+				break;
+			}
+
+			//
+			// Pends until the host assigns a different user index
+			// 
+			status = static_cast<EmulationTargetXUSB*>(pdo)->WaitUserIndex(
+				Request,
+				pXusbWaitUserIndex->KnownUserIndex,
+				&pXusbWaitUserIndex->UserIndex
+			);
+		}
+
+		break;
+
 #pragma endregion
 
 	default:
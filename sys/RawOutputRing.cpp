@@ -0,0 +1,136 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "RawOutputRing.hpp"
+
+
+void ViGEm::Bus::Core::RawOutputRing::Start(PUCHAR Storage, ULONG Capacity)
+{
+	this->_Storage = Storage;
+	this->_Capacity = Capacity;
+	this->_ReadOffset = 0;
+	this->_Used = 0;
+	this->_Sequence = 0;
+	this->_Dropped = 0;
+}
+
+PUCHAR ViGEm::Bus::Core::RawOutputRing::Stop()
+{
+	const PUCHAR storage = this->_Storage;
+
+	this->_Storage = nullptr;
+	this->_Capacity = 0;
+	this->_Used = 0;
+
+	return storage;
+}
+
+void ViGEm::Bus::Core::RawOutputRing::Write(ULONGLONG Time, const VOID* Payload, ULONG Length)
+{
+	static const UCHAR padding[VIGEM_RAW_OUTPUT_ALIGNMENT] = {};
+	VIGEM_RAW_OUTPUT_RECORD record;
+
+	if (!this->_Storage)
+		return;
+
+	record.Length = static_cast<USHORT>(min(Length, VIGEM_RAW_OUTPUT_MAX_PAYLOAD));
+	record.TransferLength = static_cast<USHORT>(min(Length, MAXUSHORT));
+	record.Sequence = this->_Sequence++;
+	record.Time = Time;
+
+	const ULONG size = VIGEM_RAW_OUTPUT_RECORD_SIZE(record.Length);
+
+	if (size > this->_Capacity - this->_Used)
+	{
+		this->_Dropped++;
+		return;
+	}
+
+	const ULONG writeOffset = (this->_ReadOffset + this->_Used) % this->_Capacity;
+
+	this->CopyIn(writeOffset, &record, sizeof(record));
+	this->CopyIn(writeOffset + sizeof(record), Payload, record.Length);
+	this->CopyIn(writeOffset + sizeof(record) + record.Length, padding, size - sizeof(record) - record.Length);
+
+	this->_Used += size;
+}
+
+ULONG ViGEm::Bus::Core::RawOutputRing::Drain(PUCHAR Buffer, ULONG Length)
+{
+	VIGEM_RAW_OUTPUT_RECORD record;
+	ULONG drained = 0;
+
+	if (!this->_Storage)
+		return 0;
+
+	//
+	// Records are only ever consumed whole, so the reader can walk the buffer
+	// 
+	while (this->_Used > 0)
+	{
+		this->CopyOut(this->_ReadOffset, &record, sizeof(record));
+
+		const ULONG size = VIGEM_RAW_OUTPUT_RECORD_SIZE(record.Length);
+
+		if (size > Length - drained)
+			break;
+
+		this->CopyOut(this->_ReadOffset, &Buffer[drained], size);
+
+		this->_ReadOffset = (this->_ReadOffset + size) % this->_Capacity;
+		this->_Used -= size;
+		drained += size;
+	}
+
+	return drained;
+}
+
+void ViGEm::Bus::Core::RawOutputRing::CopyIn(ULONG Offset, const VOID* Buffer, ULONG Length)
+{
+	Offset %= this->_Capacity;
+
+	const ULONG first = min(Length, this->_Capacity - Offset);
+
+	RtlCopyMemory(&this->_Storage[Offset], Buffer, first);
+	RtlCopyMemory(this->_Storage, static_cast<const UCHAR*>(Buffer) + first, Length - first);
+}
+
+void ViGEm::Bus::Core::RawOutputRing::CopyOut(ULONG Offset, PVOID Buffer, ULONG Length) const
+{
+	const ULONG first = min(Length, this->_Capacity - Offset);
+
+	RtlCopyMemory(Buffer, &this->_Storage[Offset], first);
+	RtlCopyMemory(static_cast<PUCHAR>(Buffer) + first, this->_Storage, Length - first);
+}
@@ -0,0 +1,103 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+#include <ViGEm/Common.h>
+#include <ViGEm/km/RawOutput.h>
+
+namespace ViGEm::Bus::Core
+{
+	constexpr auto RAW_OUTPUT_RING_POOL_TAG = 'ORiV';
+
+	//
+	// Keeps the raw interrupt OUT transfers of a target in a bounded ring
+	// using the RawOutput.h format.
+	// 
+	// The ring storage is handed in by the caller so allocation can happen
+	// outside of any lock; callers serialize access. The component has no
+	// WDF dependencies.
+	// 
+	class RawOutputRing
+	{
+	public:
+		RawOutputRing() = default;
+
+		//
+		// Takes ownership of Storage and restarts the sequence
+		// 
+		void Start(PUCHAR Storage, ULONG Capacity);
+
+		//
+		// Returns the storage (or NULL if not active) for the caller to free
+		// 
+		PUCHAR Stop();
+
+		bool IsActive() const { return this->_Storage != nullptr; }
+
+		//
+		// Appends a transfer. If it doesn't fit, it gets dropped and counted.
+		// 
+		void Write(ULONGLONG Time, const VOID* Payload, ULONG Length);
+
+		//
+		// Moves as many whole records as fit into Length bytes of Buffer
+		// 
+		ULONG Drain(PUCHAR Buffer, ULONG Length);
+
+		ULONG GetDropped() const { return this->_Dropped; }
+
+		ULONG GetCapacity() const { return this->_Capacity; }
+
+	private:
+		void CopyIn(ULONG Offset, const VOID* Buffer, ULONG Length);
+
+		void CopyOut(ULONG Offset, PVOID Buffer, ULONG Length) const;
+
+		PUCHAR _Storage{};
+
+		ULONG _Capacity{};
+
+		ULONG _ReadOffset{};
+
+		ULONG _Used{};
+
+		ULONG _Sequence{};
+
+		ULONG _Dropped{};
+	};
+}
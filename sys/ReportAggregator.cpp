@@ -0,0 +1,250 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ReportAggregator.hpp"
+#include "AxisTransform.hpp"
+
+
+void ViGEm::Bus::Core::ReportAggregator::Enable(LONG OwnerSessionId, VIGEM_AGGREGATION_AXIS_MODE AxisMode,
+                                                UCHAR OwnerPriority)
+{
+	RtlZeroMemory(this->_Sources, sizeof(this->_Sources));
+
+	this->_Sources[0].SessionId = OwnerSessionId;
+	this->_Sources[0].Priority = OwnerPriority;
+	this->_Sources[0].InUse = true;
+
+	this->_AxisMode = AxisMode;
+	this->_Enabled = true;
+}
+
+void ViGEm::Bus::Core::ReportAggregator::Disable()
+{
+	this->_Enabled = false;
+}
+
+NTSTATUS ViGEm::Bus::Core::ReportAggregator::Attach(LONG SessionId, UCHAR Priority)
+{
+	AGGREGATOR_SOURCE* source = this->FindSource(SessionId);
+
+	//
+	// Re-attaching only updates the priority
+	// 
+	if (source != nullptr)
+	{
+		source->Priority = Priority;
+		return STATUS_SUCCESS;
+	}
+
+	for (ULONG slot = 1; slot < VIGEM_AGGREGATION_MAX_SOURCES; slot++)
+	{
+		if (this->_Sources[slot].InUse)
+			continue;
+
+		RtlZeroMemory(&this->_Sources[slot], sizeof(AGGREGATOR_SOURCE));
+
+		this->_Sources[slot].SessionId = SessionId;
+		this->_Sources[slot].Priority = Priority;
+		this->_Sources[slot].InUse = true;
+
+		return STATUS_SUCCESS;
+	}
+
+	return STATUS_INSUFFICIENT_RESOURCES;
+}
+
+bool ViGEm::Bus::Core::ReportAggregator::Detach(LONG SessionId)
+{
+	//
+	// The owner slot can't be detached
+	// 
+	for (ULONG slot = 1; slot < VIGEM_AGGREGATION_MAX_SOURCES; slot++)
+	{
+		if (this->_Sources[slot].InUse && this->_Sources[slot].SessionId == SessionId)
+		{
+			this->_Sources[slot].InUse = false;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+ViGEm::Bus::Core::ReportAggregator::AGGREGATOR_SOURCE* ViGEm::Bus::Core::ReportAggregator::FindSource(LONG SessionId)
+{
+	for (ULONG slot = 0; slot < VIGEM_AGGREGATION_MAX_SOURCES; slot++)
+	{
+		if (this->_Sources[slot].InUse && this->_Sources[slot].SessionId == SessionId)
+			return &this->_Sources[slot];
+	}
+
+	return nullptr;
+}
+
+bool ViGEm::Bus::Core::ReportAggregator::IsSource(LONG SessionId) const
+{
+	for (ULONG slot = 0; slot < VIGEM_AGGREGATION_MAX_SOURCES; slot++)
+	{
+		if (this->_Sources[slot].InUse && this->_Sources[slot].SessionId == SessionId)
+			return true;
+	}
+
+	return false;
+}
+
+bool ViGEm::Bus::Core::ReportAggregator::Merge(LONG SessionId, const AGGREGATOR_STATE& Input, AGGREGATOR_STATE& Output)
+{
+	AGGREGATOR_SOURCE* source = this->FindSource(SessionId);
+
+	if (source == nullptr)
+		return false;
+
+	source->State = Input;
+	source->HasState = true;
+
+	Output.Buttons = 0;
+
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+	{
+		Output.Axes[axis] = 0;
+	}
+
+	//
+	// Rank of the source the current axis value came from, -1 if none
+	// 
+	LONG rank[VIGEM_AXIS_COUNT];
+
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+	{
+		rank[axis] = -1;
+	}
+
+	for (ULONG slot = 0; slot < VIGEM_AGGREGATION_MAX_SOURCES; slot++)
+	{
+		const AGGREGATOR_SOURCE* current = &this->_Sources[slot];
+
+		if (!current->InUse || !current->HasState)
+			continue;
+
+		Output.Buttons |= current->State.Buttons;
+
+		for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+		{
+			const LONG value = current->State.Axes[axis];
+			const LONG magnitude = (value < 0) ? -value : value;
+
+			//
+			// Max-magnitude ranks by deflection; priority ranks active
+			// sources above idle ones, then by priority
+			// 
+			const LONG candidate = (this->_AxisMode == VIGEM_AGGREGATION_AXIS_PRIORITY)
+				                       ? ((magnitude > PRIORITY_ACTIVE_THRESHOLD) ? 0x100 : 0) + current->Priority
+				                       : magnitude;
+
+			if (candidate > rank[axis])
+			{
+				rank[axis] = candidate;
+				Output.Axes[axis] = value;
+			}
+		}
+	}
+
+	return true;
+}
+
+#pragma region Report conversion
+
+//
+// D-Pad hat value (0-8) to direction mask (N = 1, E = 2, S = 4, W = 8)
+// 
+static const UCHAR Ds4HatToMask[] = { 0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9, 0x0 };
+
+//
+// Direction mask to D-Pad hat value, contradicting directions cancel out
+// 
+static const UCHAR Ds4MaskToHat[] =
+{
+	DS4_BUTTON_DPAD_NONE,       // none
+	DS4_BUTTON_DPAD_NORTH,      // N
+	DS4_BUTTON_DPAD_EAST,       // E
+	DS4_BUTTON_DPAD_NORTHEAST,  // N E
+	DS4_BUTTON_DPAD_SOUTH,      // S
+	DS4_BUTTON_DPAD_NONE,       // N S
+	DS4_BUTTON_DPAD_SOUTHEAST,  // E S
+	DS4_BUTTON_DPAD_EAST,       // N E S
+	DS4_BUTTON_DPAD_WEST,       // W
+	DS4_BUTTON_DPAD_NORTHWEST,  // N W
+	DS4_BUTTON_DPAD_NONE,       // E W
+	DS4_BUTTON_DPAD_NORTH,      // N E W
+	DS4_BUTTON_DPAD_SOUTHWEST,  // S W
+	DS4_BUTTON_DPAD_WEST,       // N S W
+	DS4_BUTTON_DPAD_SOUTH,      // E S W
+	DS4_BUTTON_DPAD_NONE        // all
+};
+
+void ViGEm::Bus::Core::ReportAggregator::FromXusbReport(const XUSB_REPORT* Report, AGGREGATOR_STATE& State)
+{
+	State.Buttons = Report->wButtons;
+
+	AxisTransform::FromXusbReport(Report, State.Axes);
+}
+
+void ViGEm::Bus::Core::ReportAggregator::ToXusbReport(const AGGREGATOR_STATE& State, PXUSB_REPORT Report)
+{
+	Report->wButtons = static_cast<USHORT>(State.Buttons);
+
+	AxisTransform::ToXusbReport(State.Axes, Report);
+}
+
+void ViGEm::Bus::Core::ReportAggregator::FromDs4Report(const DS4_REPORT* Report, AGGREGATOR_STATE& State)
+{
+	const ULONG hat = Report->wButtons & 0xF;
+
+	State.Buttons = (Report->wButtons & ~0xFUL)
+		| ((hat < RTL_NUMBER_OF(Ds4HatToMask)) ? Ds4HatToMask[hat] : 0)
+		| (static_cast<ULONG>(Report->bSpecial) << 16);
+
+	AxisTransform::FromDs4Report(Report, State.Axes);
+}
+
+void ViGEm::Bus::Core::ReportAggregator::ToDs4Report(const AGGREGATOR_STATE& State, PDS4_REPORT Report)
+{
+	Report->wButtons = static_cast<USHORT>((State.Buttons & 0xFFF0) | Ds4MaskToHat[State.Buttons & 0xF]);
+	Report->bSpecial = static_cast<BYTE>(State.Buttons >> 16);
+
+	AxisTransform::ToDs4Report(State.Axes, Report);
+}
+
+#pragma endregion
@@ -0,0 +1,130 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+#include <ViGEm/Common.h>
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Normalized input state of one source
+	// 
+	typedef struct _AGGREGATOR_STATE
+	{
+		//
+		// XUSB button bits, or DS4 buttons with the D-Pad hat expanded to a
+		// direction mask (bits 0-3) and the special buttons in bits 16-23
+		// 
+		ULONG Buttons;
+
+		//
+		// Axis values as used by AxisTransform
+		// 
+		LONG Axes[VIGEM_AXIS_COUNT];
+
+	} AGGREGATOR_STATE, *PAGGREGATOR_STATE;
+
+	//
+	// Merges the reports of multiple sessions driving one target.
+	// 
+	// Slot 0 always belongs to the owner. The component has no WDF
+	// dependencies; callers serialize access.
+	// 
+	class ReportAggregator
+	{
+	public:
+		ReportAggregator() = default;
+
+		void Enable(LONG OwnerSessionId, VIGEM_AGGREGATION_AXIS_MODE AxisMode, UCHAR OwnerPriority);
+
+		void Disable();
+
+		bool IsEnabled() const { return this->_Enabled; }
+
+		NTSTATUS Attach(LONG SessionId, UCHAR Priority);
+
+		bool Detach(LONG SessionId);
+
+		bool IsSource(LONG SessionId) const;
+
+		//
+		// Stores the state submitted by a source and produces the merged
+		// state of all sources. Fails if the session isn't a source.
+		// 
+		bool Merge(LONG SessionId, const AGGREGATOR_STATE& Input, AGGREGATOR_STATE& Output);
+
+		static void FromXusbReport(const XUSB_REPORT* Report, AGGREGATOR_STATE& State);
+
+		static void ToXusbReport(const AGGREGATOR_STATE& State, PXUSB_REPORT Report);
+
+		static void FromDs4Report(const DS4_REPORT* Report, AGGREGATOR_STATE& State);
+
+		static void ToDs4Report(const AGGREGATOR_STATE& State, PDS4_REPORT Report);
+
+	private:
+		//
+		// Deflection below this is considered idle in priority mode
+		// 
+		static const LONG PRIORITY_ACTIVE_THRESHOLD = 0x0800;
+
+		typedef struct _AGGREGATOR_SOURCE
+		{
+			LONG SessionId;
+
+			UCHAR Priority;
+
+			bool InUse;
+
+			//
+			// Set once the source submitted its first report
+			// 
+			bool HasState;
+
+			AGGREGATOR_STATE State;
+
+		} AGGREGATOR_SOURCE, *PAGGREGATOR_SOURCE;
+
+		AGGREGATOR_SOURCE* FindSource(LONG SessionId);
+
+		AGGREGATOR_SOURCE _Sources[VIGEM_AGGREGATION_MAX_SOURCES]{};
+
+		VIGEM_AGGREGATION_AXIS_MODE _AxisMode{};
+
+		bool _Enabled{};
+	};
+}
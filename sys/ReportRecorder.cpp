@@ -0,0 +1,121 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ReportRecorder.hpp"
+
+
+void ViGEm::Bus::Core::ReportRecorder::Start(PUCHAR Storage, ULONG Capacity, VIGEM_TARGET_TYPE TargetType,
+                                             ULONG SerialNo, ULONGLONG StartTime)
+{
+	VIGEM_REPORT_LOG_HEADER header;
+
+	this->_Storage = Storage;
+	this->_Capacity = Capacity;
+	this->_ReadOffset = 0;
+	this->_Used = 0;
+	this->_Dropped = 0;
+
+	VIGEM_REPORT_LOG_HEADER_INIT(&header, TargetType, SerialNo, StartTime);
+	VIGEM_REPORT_LOG_STATE_INIT(&this->_State, StartTime);
+
+	this->Write(reinterpret_cast<PUCHAR>(&header), sizeof(header));
+}
+
+PUCHAR ViGEm::Bus::Core::ReportRecorder::Stop()
+{
+	const PUCHAR storage = this->_Storage;
+
+	this->_Storage = nullptr;
+	this->_Capacity = 0;
+	this->_Used = 0;
+
+	return storage;
+}
+
+void ViGEm::Bus::Core::ReportRecorder::Record(VIGEM_REPORT_LOG_KIND Kind, ULONGLONG Time, const VOID* Payload,
+                                              ULONG Length)
+{
+	UCHAR record[VIGEM_REPORT_LOG_MAX_RECORD];
+
+	if (!this->_Storage)
+		return;
+
+	const ULONG length = VIGEM_REPORT_LOG_ENCODE(
+		&this->_State,
+		Kind,
+		Time,
+		static_cast<const UCHAR*>(Payload),
+		Length,
+		record
+	);
+
+	if (length > this->_Capacity - this->_Used)
+	{
+		this->_Dropped++;
+		return;
+	}
+
+	this->Write(record, length);
+
+	VIGEM_REPORT_LOG_COMMIT(&this->_State, Kind, Time, static_cast<const UCHAR*>(Payload), Length);
+}
+
+ULONG ViGEm::Bus::Core::ReportRecorder::Drain(PUCHAR Buffer, ULONG Length)
+{
+	if (!this->_Storage)
+		return 0;
+
+	const ULONG length = min(Length, this->_Used);
+	const ULONG first = min(length, this->_Capacity - this->_ReadOffset);
+
+	RtlCopyMemory(Buffer, &this->_Storage[this->_ReadOffset], first);
+	RtlCopyMemory(&Buffer[first], this->_Storage, length - first);
+
+	this->_ReadOffset = (this->_ReadOffset + length) % this->_Capacity;
+	this->_Used -= length;
+
+	return length;
+}
+
+void ViGEm::Bus::Core::ReportRecorder::Write(const UCHAR* Buffer, ULONG Length)
+{
+	const ULONG writeOffset = (this->_ReadOffset + this->_Used) % this->_Capacity;
+	const ULONG first = min(Length, this->_Capacity - writeOffset);
+
+	RtlCopyMemory(&this->_Storage[writeOffset], Buffer, first);
+	RtlCopyMemory(this->_Storage, &Buffer[first], Length - first);
+
+	this->_Used += Length;
+}
@@ -0,0 +1,301 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "SerialTable.hpp"
+
+
+VOID ViGEm::Bus::Core::SerialTable::Initialize()
+{
+	ExInitializeFastMutex(&this->_WriteLock);
+
+	//
+	// Serial 0 is invalid, never hand it out
+	// 
+	this->MarkUsed(0);
+}
+
+VOID ViGEm::Bus::Core::SerialTable::Cleanup()
+{
+	for (ULONG index = 0; index < PAGE_COUNT; index++)
+	{
+		if (this->_Pages[index])
+		{
+			ExFreePoolWithTag(this->_Pages[index], SERIAL_TABLE_POOL_TAG);
+			this->_Pages[index] = nullptr;
+		}
+	}
+}
+
+NTSTATUS ViGEm::Bus::Core::SerialTable::Reserve(PULONG SerialNo)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	ULONG serial = *SerialNo;
+
+	ExAcquireFastMutex(&this->_WriteLock);
+
+	if (serial == 0)
+	{
+		serial = this->FindFree();
+
+		if (serial == 0)
+			status = STATUS_NO_MORE_ENTRIES;
+	}
+	else if (serial > MAX_SERIAL)
+	{
+		status = STATUS_INVALID_PARAMETER;
+	}
+	else if (this->_Used[serial / BITS_PER_WORD] & (1UL << (serial % BITS_PER_WORD)))
+	{
+		status = STATUS_OBJECT_NAME_COLLISION;
+	}
+
+	const ULONG index = serial / PAGE_SLOTS;
+
+	if (NT_SUCCESS(status) && this->_Pages[index] == nullptr)
+	{
+		const auto page = static_cast<PSERIAL_TABLE_PAGE>(ExAllocatePoolWithTag(
+			NonPagedPoolNx,
+			sizeof(SERIAL_TABLE_PAGE),
+			SERIAL_TABLE_POOL_TAG
+		));
+
+		if (page)
+		{
+			RtlZeroMemory(page, sizeof(SERIAL_TABLE_PAGE));
+
+			const KIRQL irql = ExAcquireSpinLockExclusive(&this->_PageLock);
+			this->_Pages[index] = page;
+			ExReleaseSpinLockExclusive(&this->_PageLock, irql);
+		}
+		else
+		{
+			status = STATUS_INSUFFICIENT_RESOURCES;
+		}
+	}
+
+	if (NT_SUCCESS(status))
+	{
+		this->MarkUsed(serial);
+		this->_Pages[index]->Count++;
+		this->_Count++;
+
+		*SerialNo = serial;
+	}
+
+	ExReleaseFastMutex(&this->_WriteLock);
+
+	return status;
+}
+
+VOID ViGEm::Bus::Core::SerialTable::Bind(ULONG SerialNo, EmulationTargetPDO* Target)
+{
+	ExAcquireFastMutex(&this->_WriteLock);
+
+	const PSERIAL_TABLE_PAGE page = this->_Pages[SerialNo / PAGE_SLOTS];
+
+	const KIRQL irql = ExAcquireSpinLockExclusive(&this->_PageLock);
+	page->Targets[SerialNo % PAGE_SLOTS] = Target;
+	ExReleaseSpinLockExclusive(&this->_PageLock, irql);
+
+	ExReleaseFastMutex(&this->_WriteLock);
+}
+
+VOID ViGEm::Bus::Core::SerialTable::SetOnline(ULONG SerialNo)
+{
+	const ULONG slot = SerialNo % PAGE_SLOTS;
+
+	ExAcquireFastMutex(&this->_WriteLock);
+
+	const PSERIAL_TABLE_PAGE page = this->_Pages[SerialNo / PAGE_SLOTS];
+
+	const KIRQL irql = ExAcquireSpinLockExclusive(&this->_PageLock);
+	page->Online[slot / BITS_PER_WORD] |= 1UL << (slot % BITS_PER_WORD);
+	ExReleaseSpinLockExclusive(&this->_PageLock, irql);
+
+	ExReleaseFastMutex(&this->_WriteLock);
+}
+
+VOID ViGEm::Bus::Core::SerialTable::Release(ULONG SerialNo)
+{
+	(void)this->ReleaseMatching(SerialNo, nullptr);
+}
+
+bool ViGEm::Bus::Core::SerialTable::ReleaseOffline(ULONG SerialNo, EmulationTargetPDO* Target)
+{
+	return this->ReleaseMatching(SerialNo, Target);
+}
+
+bool ViGEm::Bus::Core::SerialTable::ReleaseMatching(ULONG SerialNo, EmulationTargetPDO* Target)
+{
+	PSERIAL_TABLE_PAGE page = nullptr;
+	bool released = false;
+	const ULONG index = SerialNo / PAGE_SLOTS;
+	const ULONG slot = SerialNo % PAGE_SLOTS;
+
+	if (SerialNo == 0 || SerialNo > MAX_SERIAL)
+		return false;
+
+	ExAcquireFastMutex(&this->_WriteLock);
+
+	if (this->_Used[SerialNo / BITS_PER_WORD] & (1UL << (SerialNo % BITS_PER_WORD)))
+	{
+		page = this->_Pages[index];
+
+		//
+		// Only writers change the page, the write lock suffices for reading it
+		// 
+		if (Target != nullptr
+			&& (page->Targets[slot] != Target
+				|| (page->Online[slot / BITS_PER_WORD] & (1UL << (slot % BITS_PER_WORD)))))
+		{
+			ExReleaseFastMutex(&this->_WriteLock);
+			return false;
+		}
+
+		const KIRQL irql = ExAcquireSpinLockExclusive(&this->_PageLock);
+
+		page->Targets[slot] = nullptr;
+		page->Online[slot / BITS_PER_WORD] &= ~(1UL << (slot % BITS_PER_WORD));
+
+		//
+		// Keep the page while other serials of it are in use
+		// 
+		if (--page->Count == 0)
+			this->_Pages[index] = nullptr;
+		else
+			page = nullptr;
+
+		ExReleaseSpinLockExclusive(&this->_PageLock, irql);
+
+		this->MarkFree(SerialNo);
+		this->_Count--;
+
+		released = true;
+	}
+
+	ExReleaseFastMutex(&this->_WriteLock);
+
+	if (page)
+		ExFreePoolWithTag(page, SERIAL_TABLE_POOL_TAG);
+
+	return released;
+}
+
+ViGEm::Bus::Core::EmulationTargetPDO* ViGEm::Bus::Core::SerialTable::Lookup(ULONG SerialNo)
+{
+	return this->Find(SerialNo, true);
+}
+
+ViGEm::Bus::Core::EmulationTargetPDO* ViGEm::Bus::Core::SerialTable::LookupAdded(ULONG SerialNo)
+{
+	return this->Find(SerialNo, false);
+}
+
+VOID ViGEm::Bus::Core::SerialTable::MarkUsed(ULONG SerialNo)
+{
+	const ULONG used = SerialNo / BITS_PER_WORD;
+	const ULONG full = used / BITS_PER_WORD;
+
+	this->_Used[used] |= 1UL << (SerialNo % BITS_PER_WORD);
+
+	if (this->_Used[used] != MAXULONG)
+		return;
+
+	this->_Full[full] |= 1UL << (used % BITS_PER_WORD);
+
+	if (this->_Full[full] != MAXULONG)
+		return;
+
+	this->_Summary[full / BITS_PER_WORD] |= 1UL << (full % BITS_PER_WORD);
+}
+
+VOID ViGEm::Bus::Core::SerialTable::MarkFree(ULONG SerialNo)
+{
+	const ULONG used = SerialNo / BITS_PER_WORD;
+	const ULONG full = used / BITS_PER_WORD;
+
+	this->_Used[used] &= ~(1UL << (SerialNo % BITS_PER_WORD));
+	this->_Full[full] &= ~(1UL << (used % BITS_PER_WORD));
+	this->_Summary[full / BITS_PER_WORD] &= ~(1UL << (full % BITS_PER_WORD));
+}
+
+ULONG ViGEm::Bus::Core::SerialTable::FindFree() const
+{
+	ULONG summaryBit = 0, fullBit = 0, usedBit = 0;
+
+	for (ULONG summary = 0; summary < SUMMARY_WORDS; summary++)
+	{
+		if (!BitScanForward(&summaryBit, ~this->_Summary[summary]))
+			continue;
+
+		const ULONG full = summary * BITS_PER_WORD + summaryBit;
+
+		//
+		// A clear bit in a level always has a clear bit below it; if not,
+		// the levels disagree and no serial is handed out
+		// 
+		if (!BitScanForward(&fullBit, ~this->_Full[full]))
+			return 0;
+
+		const ULONG used = full * BITS_PER_WORD + fullBit;
+
+		if (!BitScanForward(&usedBit, ~this->_Used[used]))
+			return 0;
+
+		return used * BITS_PER_WORD + usedBit;
+	}
+
+	return 0;
+}
+
+ViGEm::Bus::Core::EmulationTargetPDO* ViGEm::Bus::Core::SerialTable::Find(ULONG SerialNo, bool OnlineOnly)
+{
+	EmulationTargetPDO* target = nullptr;
+	const ULONG slot = SerialNo % PAGE_SLOTS;
+
+	if (SerialNo == 0 || SerialNo > MAX_SERIAL)
+		return nullptr;
+
+	const KIRQL irql = ExAcquireSpinLockShared(&this->_PageLock);
+
+	const PSERIAL_TABLE_PAGE page = this->_Pages[SerialNo / PAGE_SLOTS];
+
+	if (page && (!OnlineOnly || page->Online[slot / BITS_PER_WORD] & (1UL << (slot % BITS_PER_WORD))))
+		target = page->Targets[slot];
+
+	ExReleaseSpinLockShared(&this->_PageLock, irql);
+
+	return target;
+}
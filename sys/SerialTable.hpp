@@ -0,0 +1,181 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	class EmulationTargetPDO;
+
+	constexpr auto SERIAL_TABLE_POOL_TAG = 'TSiV';
+
+	//
+	// Serial numbers of the targets on a bus and the targets they map to.
+	// 
+	// Free serials are found with three bit scans through a bitmap and two
+	// summary levels of it, lookups index pages of target pointers which
+	// only exist while one of their serials is in use. Serials stay taken
+	// from plug-in until the target gets disposed, so a new target never
+	// collides with one still being torn down.
+	// 
+	// Reserve, Bind, SetOnline and the Release methods run at PASSIVE_LEVEL and are
+	// serialized internally; lookups are safe at up to DISPATCH_LEVEL.
+	// Zeroed memory is a valid, empty table, so it can live in a WDF
+	// context; Initialize before use.
+	// 
+	class SerialTable
+	{
+	public:
+		//
+		// Highest serial a target can have
+		// 
+		static const ULONG MAX_SERIAL = 0xFFFF;
+
+		VOID Initialize();
+
+		//
+		// Frees all pages
+		// 
+		VOID Cleanup();
+
+		//
+		// Takes the given serial, or the lowest free one if SerialNo is 0
+		// 
+		NTSTATUS Reserve(PULONG SerialNo);
+
+		//
+		// Associates a reserved serial with its target
+		// 
+		VOID Bind(ULONG SerialNo, EmulationTargetPDO* Target);
+
+		//
+		// Marks the target's device object as created, see Lookup
+		// 
+		VOID SetOnline(ULONG SerialNo);
+
+		//
+		// Returns the serial to the free pool and forgets its target
+		// 
+		VOID Release(ULONG SerialNo);
+
+		//
+		// Releases the serial only if it's bound to Target and the target's
+		// device object was never created. Returns whether it did.
+		// 
+		bool ReleaseOffline(ULONG SerialNo, EmulationTargetPDO* Target);
+
+		//
+		// Returns the target of the serial once its device object exists
+		// 
+		EmulationTargetPDO* Lookup(ULONG SerialNo);
+
+		//
+		// Returns the target of the serial from plug-in on
+		// 
+		EmulationTargetPDO* LookupAdded(ULONG SerialNo);
+
+		ULONG GetCount() const { return this->_Count; }
+
+	private:
+		static const ULONG BITS_PER_WORD = 32;
+
+		static const ULONG USED_WORDS = (MAX_SERIAL + 1) / BITS_PER_WORD;
+
+		static const ULONG FULL_WORDS = USED_WORDS / BITS_PER_WORD;
+
+		static const ULONG SUMMARY_WORDS = FULL_WORDS / BITS_PER_WORD;
+
+		static const ULONG PAGE_SLOTS = 256;
+
+		static const ULONG PAGE_COUNT = (MAX_SERIAL + 1) / PAGE_SLOTS;
+
+		typedef struct _SERIAL_TABLE_PAGE
+		{
+			EmulationTargetPDO* Targets[PAGE_SLOTS];
+
+			ULONG Online[PAGE_SLOTS / BITS_PER_WORD];
+
+			ULONG Count;
+
+		} SERIAL_TABLE_PAGE, * PSERIAL_TABLE_PAGE;
+
+		VOID MarkUsed(ULONG SerialNo);
+
+		VOID MarkFree(ULONG SerialNo);
+
+		//
+		// Returns the lowest free serial or 0 if all are taken
+		// 
+		ULONG FindFree() const;
+
+		EmulationTargetPDO* Find(ULONG SerialNo, bool OnlineOnly);
+
+		//
+		// Releases the serial, if Target is set only while bound to it and offline
+		// 
+		bool ReleaseMatching(ULONG SerialNo, EmulationTargetPDO* Target);
+
+		//
+		// Bit set per serial in use
+		// 
+		ULONG _Used[USED_WORDS];
+
+		//
+		// Bit set per _Used word without a free serial
+		// 
+		ULONG _Full[FULL_WORDS];
+
+		//
+		// Bit set per _Full word with all bits set
+		// 
+		ULONG _Summary[SUMMARY_WORDS];
+
+		PSERIAL_TABLE_PAGE _Pages[PAGE_COUNT];
+
+		ULONG _Count;
+
+		//
+		// Serializes Reserve, Bind, SetOnline and Release
+		// 
+		FAST_MUTEX _WriteLock;
+
+		//
+		// Protects _Pages against lookups
+		// 
+		EX_SPIN_LOCK _PageLock;
+	};
+}
@@ -0,0 +1,102 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "SessionTargetList.hpp"
+
+
+VOID ViGEm::Bus::Core::SessionTargetList::Initialize()
+{
+	InitializeListHead(&this->_Head);
+}
+
+VOID ViGEm::Bus::Core::SessionTargetList::InitializeLink(PSESSION_TARGET_LINK Link, ULONG SerialNo)
+{
+	InitializeListHead(&Link->Entry);
+	Link->SerialNo = SerialNo;
+}
+
+VOID ViGEm::Bus::Core::SessionTargetList::Insert(PSESSION_TARGET_LINK Link)
+{
+	Remove(Link);
+	InsertTailList(&this->_Head, &Link->Entry);
+}
+
+VOID ViGEm::Bus::Core::SessionTargetList::Remove(PSESSION_TARGET_LINK Link)
+{
+	//
+	// Unlinked entries point to themselves, removal keeps it that way
+	// 
+	RemoveEntryList(&Link->Entry);
+	InitializeListHead(&Link->Entry);
+}
+
+bool ViGEm::Bus::Core::SessionTargetList::IsEmpty() const
+{
+	return IsListEmpty(&this->_Head) != FALSE;
+}
+
+ULONG ViGEm::Bus::Core::SessionTargetList::GetCount() const
+{
+	ULONG count = 0;
+
+	for (PLIST_ENTRY entry = this->_Head.Flink; entry != &this->_Head; entry = entry->Flink)
+		count++;
+
+	return count;
+}
+
+ULONG ViGEm::Bus::Core::SessionTargetList::TakeSerials(PULONG Serials, ULONG Count)
+{
+	ULONG taken = 0;
+
+	while (taken < Count && !IsListEmpty(&this->_Head))
+	{
+		const PLIST_ENTRY entry = RemoveHeadList(&this->_Head);
+		const PSESSION_TARGET_LINK link = CONTAINING_RECORD(entry, SESSION_TARGET_LINK, Entry);
+
+		InitializeListHead(entry);
+		Serials[taken++] = link->SerialNo;
+	}
+
+	return taken;
+}
+
+ULONG ViGEm::Bus::Core::SessionTargetList::PeekSerial() const
+{
+	if (IsListEmpty(&this->_Head))
+		return 0;
+
+	return CONTAINING_RECORD(this->_Head.Flink, SESSION_TARGET_LINK, Entry)->SerialNo;
+}
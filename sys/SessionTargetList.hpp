@@ -0,0 +1,96 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Link embedded in a target, chaining it into the list of its session
+	// 
+	typedef struct _SESSION_TARGET_LINK
+	{
+		LIST_ENTRY Entry;
+
+		ULONG SerialNo;
+
+	} SESSION_TARGET_LINK, * PSESSION_TARGET_LINK;
+
+	//
+	// Intrusive list of the targets a session owns.
+	// 
+	// Lets handle close and unplug-all touch only the closing session's
+	// targets instead of walking every child of the bus. Links point back
+	// into their list, so a target can unlink itself on disposal without
+	// knowing its session. The component has no WDF dependencies; callers
+	// serialize access to all lists a link may be on with one lock.
+	// 
+	class SessionTargetList
+	{
+	public:
+		VOID Initialize();
+
+		static VOID InitializeLink(PSESSION_TARGET_LINK Link, ULONG SerialNo);
+
+		VOID Insert(PSESSION_TARGET_LINK Link);
+
+		//
+		// Does nothing if the link isn't on a list
+		// 
+		static VOID Remove(PSESSION_TARGET_LINK Link);
+
+		bool IsEmpty() const;
+
+		//
+		// Walks the list, meant for short lists only
+		// 
+		ULONG GetCount() const;
+
+		//
+		// Unlinks up to Count targets and returns their serials
+		// 
+		ULONG TakeSerials(PULONG Serials, ULONG Count);
+
+		//
+		// Returns the serial of the first target, 0 if the list is empty
+		// 
+		ULONG PeekSerial() const;
+
+	private:
+		LIST_ENTRY _Head;
+	};
+}
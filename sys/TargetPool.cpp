@@ -0,0 +1,149 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "TargetPool.hpp"
+
+
+VOID ViGEm::Bus::Core::TargetPool::Initialize()
+{
+	for (auto& lane : this->_Lanes)
+	{
+		lane.Idle.Initialize();
+		lane.Depth = 0;
+		lane.Pending = 0;
+	}
+}
+
+bool ViGEm::Bus::Core::TargetPool::IsSupported(VIGEM_TARGET_TYPE Type)
+{
+	return Type == Xbox360Wired || Type == DualShock4Wired;
+}
+
+VOID ViGEm::Bus::Core::TargetPool::SetDepth(VIGEM_TARGET_TYPE Type, ULONG Depth)
+{
+	this->_Lanes[Type].Depth = Depth;
+}
+
+ULONG ViGEm::Bus::Core::TargetPool::GetDepth(VIGEM_TARGET_TYPE Type) const
+{
+	return this->_Lanes[Type].Depth;
+}
+
+ULONG ViGEm::Bus::Core::TargetPool::GetIdleCount(VIGEM_TARGET_TYPE Type) const
+{
+	return this->_Lanes[Type].Idle.GetCount();
+}
+
+ULONG ViGEm::Bus::Core::TargetPool::BeginRefill(VIGEM_TARGET_TYPE Type)
+{
+	TARGET_POOL_LANE& lane = this->_Lanes[Type];
+
+	const ULONG available = lane.Idle.GetCount() + lane.Pending;
+
+	//
+	// Wait until half of the depth is claimed, a target released soon after
+	// its claim then finds room to come back instead of being replaced by
+	// a newly created one
+	// 
+	if (available * 2 >= lane.Depth)
+		return 0;
+
+	const ULONG missing = lane.Depth - available;
+
+	lane.Pending += missing;
+
+	return missing;
+}
+
+VOID ViGEm::Bus::Core::TargetPool::Add(VIGEM_TARGET_TYPE Type, PSESSION_TARGET_LINK Link)
+{
+	TARGET_POOL_LANE& lane = this->_Lanes[Type];
+
+	lane.Idle.Insert(Link);
+	lane.Pending--;
+}
+
+VOID ViGEm::Bus::Core::TargetPool::Discard(VIGEM_TARGET_TYPE Type, PSESSION_TARGET_LINK Link)
+{
+	SessionTargetList::Remove(Link);
+	this->_Lanes[Type].Pending++;
+}
+
+VOID ViGEm::Bus::Core::TargetPool::CancelRefill(VIGEM_TARGET_TYPE Type, ULONG Count)
+{
+	this->_Lanes[Type].Pending -= Count;
+}
+
+ULONG ViGEm::Bus::Core::TargetPool::Peek(VIGEM_TARGET_TYPE Type) const
+{
+	return this->_Lanes[Type].Idle.PeekSerial();
+}
+
+ULONG ViGEm::Bus::Core::TargetPool::Take(VIGEM_TARGET_TYPE Type)
+{
+	ULONG serial = 0;
+
+	(void)this->_Lanes[Type].Idle.TakeSerials(&serial, 1);
+
+	return serial;
+}
+
+bool ViGEm::Bus::Core::TargetPool::Return(VIGEM_TARGET_TYPE Type, PSESSION_TARGET_LINK Link)
+{
+	TARGET_POOL_LANE& lane = this->_Lanes[Type];
+
+	//
+	// Targets still being created count against the depth, so returning
+	// doesn't overshoot it once they arrive
+	// 
+	if (lane.Idle.GetCount() + lane.Pending >= lane.Depth)
+		return false;
+
+	lane.Idle.Insert(Link);
+
+	return true;
+}
+
+ULONG ViGEm::Bus::Core::TargetPool::TakeExcess(VIGEM_TARGET_TYPE Type, PULONG Serials, ULONG Count)
+{
+	TARGET_POOL_LANE& lane = this->_Lanes[Type];
+
+	const ULONG idle = lane.Idle.GetCount();
+
+	if (idle <= lane.Depth)
+		return 0;
+
+	return lane.Idle.TakeSerials(Serials, min(Count, idle - lane.Depth));
+}
@@ -0,0 +1,132 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+#include <ViGEm/Common.h>
+
+#include "SessionTargetList.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Pre-created targets per type, waiting to be claimed by a session.
+	// 
+	// A pooled target goes through PnP enumeration, descriptor exchange and
+	// the host driver's initialization once; claiming it skips all of that.
+	// Released pooled targets come back here with their state reset instead
+	// of getting unplugged, as long as the pool is below its depth. Idle
+	// targets are chained through their session link, so a disposed target
+	// leaves the pool like it leaves any session. The component has no WDF
+	// dependencies; callers serialize access with the lock protecting all
+	// session target lists.
+	// 
+	class TargetPool
+	{
+	public:
+		VOID Initialize();
+
+		static bool IsSupported(VIGEM_TARGET_TYPE Type);
+
+		//
+		// Sets the number of idle targets to keep, 0 disables pooling
+		// 
+		VOID SetDepth(VIGEM_TARGET_TYPE Type, ULONG Depth);
+
+		ULONG GetDepth(VIGEM_TARGET_TYPE Type) const;
+
+		ULONG GetIdleCount(VIGEM_TARGET_TYPE Type) const;
+
+		//
+		// Returns the number of targets to create to reach the depth, 0
+		// while at least half of it is available. They count as pending
+		// until passed to Add or CancelRefill.
+		// 
+		ULONG BeginRefill(VIGEM_TARGET_TYPE Type);
+
+		//
+		// Links a newly created target as idle, completing one pending refill
+		// 
+		VOID Add(VIGEM_TARGET_TYPE Type, PSESSION_TARGET_LINK Link);
+
+		//
+		// Unlinks an added target that failed to get plugged in, its refill
+		// is pending again
+		// 
+		VOID Discard(VIGEM_TARGET_TYPE Type, PSESSION_TARGET_LINK Link);
+
+		//
+		// Drops pending refills that didn't result in a target
+		// 
+		VOID CancelRefill(VIGEM_TARGET_TYPE Type, ULONG Count);
+
+		//
+		// Returns the serial of the next idle target without unlinking it
+		// 
+		ULONG Peek(VIGEM_TARGET_TYPE Type) const;
+
+		//
+		// Unlinks the next idle target and returns its serial, 0 if none is idle
+		// 
+		ULONG Take(VIGEM_TARGET_TYPE Type);
+
+		//
+		// Links a released target as idle, fails if the pool is at its depth
+		// 
+		bool Return(VIGEM_TARGET_TYPE Type, PSESSION_TARGET_LINK Link);
+
+		//
+		// Unlinks up to Count idle targets above the depth and returns their serials
+		// 
+		ULONG TakeExcess(VIGEM_TARGET_TYPE Type, PULONG Serials, ULONG Count);
+
+	private:
+		static const ULONG LANE_COUNT = DualShock4Wired + 1;
+
+		typedef struct _TARGET_POOL_LANE
+		{
+			SessionTargetList Idle;
+
+			ULONG Depth;
+
+			ULONG Pending;
+
+		} TARGET_POOL_LANE, * PTARGET_POOL_LANE;
+
+		TARGET_POOL_LANE _Lanes[LANE_COUNT];
+	};
+}
@@ -0,0 +1,108 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "TickSet.hpp"
+
+
+VOID ViGEm::Bus::Core::TickSet::InitializeLink(PTICK_SET_LINK Link, PVOID Context)
+{
+	Link->Context = Context;
+	Link->Slot = 0;
+}
+
+VOID ViGEm::Bus::Core::TickSet::Cleanup()
+{
+	for (ULONG index = 0; index < this->_Count; index++)
+	{
+		this->_Entries[index]->Slot = 0;
+	}
+
+	if (this->_Entries)
+	{
+		ExFreePoolWithTag(this->_Entries, TICK_SET_POOL_TAG);
+		this->_Entries = nullptr;
+	}
+
+	this->_Count = 0;
+	this->_Capacity = 0;
+}
+
+NTSTATUS ViGEm::Bus::Core::TickSet::Insert(PTICK_SET_LINK Link)
+{
+	if (Link->Slot != 0)
+		return STATUS_SUCCESS;
+
+	if (this->_Count == this->_Capacity)
+	{
+		const ULONG capacity = this->_Capacity ? this->_Capacity * 2 : INITIAL_CAPACITY;
+
+		const auto entries = static_cast<PTICK_SET_LINK*>(ExAllocatePoolWithTag(
+			NonPagedPoolNx,
+			capacity * sizeof(PTICK_SET_LINK),
+			TICK_SET_POOL_TAG
+		));
+
+		if (!entries)
+			return STATUS_INSUFFICIENT_RESOURCES;
+
+		if (this->_Entries)
+		{
+			RtlCopyMemory(entries, this->_Entries, this->_Count * sizeof(PTICK_SET_LINK));
+			ExFreePoolWithTag(this->_Entries, TICK_SET_POOL_TAG);
+		}
+
+		this->_Entries = entries;
+		this->_Capacity = capacity;
+	}
+
+	this->_Entries[this->_Count] = Link;
+	Link->Slot = ++this->_Count;
+
+	return STATUS_SUCCESS;
+}
+
+VOID ViGEm::Bus::Core::TickSet::Remove(PTICK_SET_LINK Link)
+{
+	if (Link->Slot == 0)
+		return;
+
+	const ULONG index = Link->Slot - 1;
+	const PTICK_SET_LINK last = this->_Entries[--this->_Count];
+
+	this->_Entries[index] = last;
+	last->Slot = index + 1;
+
+	Link->Slot = 0;
+}
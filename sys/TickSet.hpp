@@ -0,0 +1,106 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	constexpr auto TICK_SET_POOL_TAG = 'STiV';
+
+	//
+	// Link embedded in a target, making it a member of a tick set
+	// 
+	typedef struct _TICK_SET_LINK
+	{
+		//
+		// Target the link is embedded in
+		// 
+		PVOID Context;
+
+		//
+		// Position in the set plus one, 0 if not a member
+		// 
+		ULONG Slot;
+
+	} TICK_SET_LINK, * PTICK_SET_LINK;
+
+	//
+	// Compact array of the targets a shared timer tick has to service.
+	// 
+	// Members are kept densely packed so a tick walks only the targets that
+	// have work, in one pass. Links know their position, removal swaps the
+	// last member into the gap. The component has no WDF dependencies;
+	// callers serialize access and may call at DISPATCH_LEVEL.
+	// 
+	class TickSet
+	{
+	public:
+		static VOID InitializeLink(PTICK_SET_LINK Link, PVOID Context);
+
+		VOID Cleanup();
+
+		//
+		// Adds the link unless it's a member already
+		// 
+		NTSTATUS Insert(PTICK_SET_LINK Link);
+
+		//
+		// Does nothing if the link isn't a member
+		// 
+		VOID Remove(PTICK_SET_LINK Link);
+
+		static bool Contains(const TICK_SET_LINK* Link) { return Link->Slot != 0; }
+
+		ULONG GetCount() const { return this->_Count; }
+
+		bool IsEmpty() const { return this->_Count == 0; }
+
+		//
+		// Member at Index, removing it moves the last member there
+		// 
+		PTICK_SET_LINK GetAt(ULONG Index) const { return this->_Entries[Index]; }
+
+	private:
+		static const ULONG INITIAL_CAPACITY = 16;
+
+		PTICK_SET_LINK* _Entries{};
+
+		ULONG _Count{};
+
+		ULONG _Capacity{};
+	};
+}
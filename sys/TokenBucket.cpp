@@ -0,0 +1,74 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "TokenBucket.hpp"
+
+
+void ViGEm::Bus::Core::TokenBucket::Configure(ULONG RatePerSecond, ULONG Burst)
+{
+	if (RatePerSecond == 0)
+	{
+		this->_Interval = 0;
+		this->_Tolerance = 0;
+		this->_ArrivalTime = 0;
+		return;
+	}
+
+	this->_Interval = max(UNITS_PER_SECOND / RatePerSecond, 1);
+	this->_Tolerance = this->_Interval * (max(Burst, 1) - 1);
+	this->_ArrivalTime = 0;
+}
+
+bool ViGEm::Bus::Core::TokenBucket::TryAcquire(ULONGLONG Now)
+{
+	const ULONGLONG arrival = max(this->_ArrivalTime, Now);
+
+	if (arrival - Now > this->_Tolerance)
+		return false;
+
+	this->_ArrivalTime = arrival + this->_Interval;
+
+	return true;
+}
+
+ULONGLONG ViGEm::Bus::Core::TokenBucket::Reserve(ULONGLONG Now)
+{
+	const ULONGLONG arrival = max(this->_ArrivalTime, Now);
+	const ULONGLONG due = (arrival - Now > this->_Tolerance) ? arrival - this->_Tolerance : Now;
+
+	this->_ArrivalTime = arrival + this->_Interval;
+
+	return due;
+}
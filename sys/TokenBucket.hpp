@@ -0,0 +1,90 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Rate limiter for submitted reports (generic cell rate algorithm).
+	// 
+	// Instead of a token count it tracks the theoretical arrival time of
+	// the next report, so refilling needs no timer. Time is in 100ns units.
+	// Zeroed memory is a valid, unlimited bucket, so it can live in a WDF
+	// context. The component has no WDF dependencies; callers serialize
+	// access.
+	// 
+	class TokenBucket
+	{
+	public:
+		//
+		// RatePerSecond 0 removes the limit
+		// 
+		void Configure(ULONG RatePerSecond, ULONG Burst);
+
+		bool IsLimited() const { return this->_Interval != 0; }
+
+		//
+		// Takes a token if one is available right now
+		// 
+		bool TryAcquire(ULONGLONG Now);
+
+		//
+		// Unconditionally takes the next token and returns the time it
+		// becomes available
+		// 
+		ULONGLONG Reserve(ULONGLONG Now);
+
+	private:
+		static const ULONGLONG UNITS_PER_SECOND = 10000000;
+
+		//
+		// Time between two reports at the sustained rate
+		// 
+		ULONGLONG _Interval;
+
+		//
+		// How far ahead of the sustained rate a burst may run
+		// 
+		ULONGLONG _Tolerance;
+
+		//
+		// Theoretical arrival time of the next conforming report
+		// 
+		ULONGLONG _ArrivalTime;
+	};
+}
@@ -0,0 +1,76 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "UrbStatistics.hpp"
+
+#include <usb.h>
+
+
+VIGEM_URB_STATISTIC ViGEm::Bus::Core::UrbStatistics::Classify(USHORT Function)
+{
+	switch (Function)
+	{
+	case URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER:
+		return VIGEM_URB_STAT_BULK_OR_INTERRUPT_TRANSFER;
+	case URB_FUNCTION_CONTROL_TRANSFER:
+		return VIGEM_URB_STAT_CONTROL_TRANSFER;
+	case URB_FUNCTION_CONTROL_TRANSFER_EX:
+		return VIGEM_URB_STAT_CONTROL_TRANSFER_EX;
+	case URB_FUNCTION_SELECT_CONFIGURATION:
+		return VIGEM_URB_STAT_SELECT_CONFIGURATION;
+	case URB_FUNCTION_SELECT_INTERFACE:
+		return VIGEM_URB_STAT_SELECT_INTERFACE;
+	case URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE:
+		return VIGEM_URB_STAT_GET_DESCRIPTOR_FROM_DEVICE;
+	case URB_FUNCTION_GET_STATUS_FROM_DEVICE:
+		return VIGEM_URB_STAT_GET_STATUS_FROM_DEVICE;
+	case URB_FUNCTION_ABORT_PIPE:
+		return VIGEM_URB_STAT_ABORT_PIPE;
+	case URB_FUNCTION_CLASS_INTERFACE:
+		return VIGEM_URB_STAT_CLASS_INTERFACE;
+	case URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE:
+		return VIGEM_URB_STAT_GET_DESCRIPTOR_FROM_INTERFACE;
+	default:
+		return VIGEM_URB_STAT_OTHER;
+	}
+}
+
+VOID ViGEm::Bus::Core::UrbStatistics::Snapshot(PULONGLONG Counts) const
+{
+	for (ULONG i = 0; i < VIGEM_URB_STAT_COUNT; i++)
+	{
+		Counts[i] = static_cast<ULONGLONG>(ReadNoFence64(&this->_Counts[i]));
+	}
+}
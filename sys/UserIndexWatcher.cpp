@@ -0,0 +1,62 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "UserIndexWatcher.hpp"
+
+
+bool ViGEm::Bus::Core::UserIndexWatcher::ApplyLedPacket(const UCHAR* Packet, ULONG Length, CHAR* Previous)
+{
+	static const UCHAR PATTERN_FIRST_QUADRANT = 0x02;
+	static const UCHAR PATTERN_LAST_QUADRANT = 0x05;
+
+	const CHAR previous = this->Get();
+
+	*Previous = previous;
+
+	if (Length != LED_PACKET_SIZE || Packet[0] != 0x01 || Packet[1] != 0x03)
+		return false;
+
+	if (Packet[2] < PATTERN_FIRST_QUADRANT || Packet[2] > PATTERN_LAST_QUADRANT)
+		return false;
+
+	const CHAR index = static_cast<CHAR>(Packet[2] - PATTERN_FIRST_QUADRANT);
+
+	if (index == previous)
+		return false;
+
+	WriteRelease8(&this->_Index, index);
+
+	return true;
+}
@@ -0,0 +1,87 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Platform.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// User index (XInput slot) of an Xbox 360 target as the host assigns it
+	// through the LED of the controller.
+	// 
+	// The host's LED set packets come in one at a time on the interrupt OUT
+	// pipe; the index may be read from anywhere. Feeders waiting for the
+	// index pass the one they already know and get woken once Satisfies
+	// holds. The component has no WDF dependencies.
+	// 
+	class UserIndexWatcher
+	{
+	public:
+		static const CHAR UNASSIGNED = -1;
+
+		//
+		// Size of an LED set packet: 01 03 <pattern>
+		// 
+		static const ULONG LED_PACKET_SIZE = 3;
+
+		//
+		// Forgets the index, as for a new device
+		// 
+		VOID Reset() { WriteRelease8(&this->_Index, UNASSIGNED); }
+
+		CHAR Get() const { return ReadNoFence8(&this->_Index); }
+
+		//
+		// Takes the index from an LED set packet. Patterns 02 to 05 light
+		// the quadrant of index 0 to 3, the others (blinking, rotating)
+		// keep the index. Returns whether it changed, Previous receives
+		// the index before the packet.
+		// 
+		bool ApplyLedPacket(const UCHAR* Packet, ULONG Length, CHAR* Previous);
+
+		//
+		// Whether Index is news to a feeder knowing KnownUserIndex
+		// 
+		static bool Satisfies(CHAR Index, LONG KnownUserIndex)
+		{
+			return Index != UNASSIGNED && Index != KnownUserIndex;
+		}
+
+	private:
+		volatile CHAR _Index = UNASSIGNED;
+	};
+}
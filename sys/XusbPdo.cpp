@@ -48,6 +48,28 @@
 
 PCWSTR ViGEm::Bus::Targets::EmulationTargetXUSB::_deviceDescription = L"Virtual Xbox 360 Controller";
 
+const UCHAR ViGEm::Bus::Targets::EmulationTargetXUSB::_InterruptBlob[XUSB_BLOB_STORAGE_SIZE] =
+{
+	// 0
+	0x01, 0x03, 0x0E,
+	// 1
+	0x02, 0x03, 0x00,
+	// 2
+	0x03, 0x03, 0x03,
+	// 3
+	0x08, 0x03, 0x00,
+	// 4
+	0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0xe4, 0xf2,
+	0xb3, 0xf8, 0x49, 0xf3, 0xb0, 0xfc, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00,
+	// 5
+	0x01, 0x03, 0x03,
+	// 6
+	0x05, 0x03, 0x00,
+	// 7
+	0x31, 0x3F, 0xCF, 0xDC
+};
+
 ViGEm::Bus::Targets::EmulationTargetXUSB::EmulationTargetXUSB(ULONG Serial, LONG SessionId, USHORT VendorId,
 	USHORT ProductId) : EmulationTargetPDO(
 		Serial, SessionId, VendorId, ProductId)
@@ -78,6 +100,18 @@ ViGEm::Bus::Targets::EmulationTargetXUSB::EmulationTargetXUSB(ULONG Serial, LONG
 	this->_PowerCapabilities.WakeFromD2 = WdfTrue;
 }
 
+ViGEm::Bus::Targets::EmulationTargetXUSB::~EmulationTargetXUSB()
+{
+	//
+	// This queues parent is the FDO so explicitly free memory
+	// 
+	if (this->_PendingUserIndexRequests)
+	{
+		WdfIoQueuePurgeSynchronously(this->_PendingUserIndexRequests);
+		WdfObjectDelete(this->_PendingUserIndexRequests);
+	}
+}
+
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoPrepareDevice(PWDFDEVICE_INIT DeviceInit, PUNICODE_STRING DeviceId,
 	PUNICODE_STRING DeviceDescription)
 {
@@ -209,18 +243,12 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoPrepareHardware()
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoInitContext()
 {
-	WDF_OBJECT_ATTRIBUTES attributes;
-	PUCHAR blobBuffer;
-
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = this->_PdoDevice;
-
 	TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_XUSB, "Initializing XUSB context...");
 
 	RtlZeroMemory(this->_Rumble, ARRAYSIZE(this->_Rumble));
 
 	// Is later overwritten by actual XInput slot
-	this->_LedNumber = -1;
+	this->_UserIndex.Reset();
 
 	RtlZeroMemory(&this->_Packet, sizeof(XUSB_INTERRUPT_IN_PACKET));
 	// Packet size (20 bytes = 0x14)
@@ -230,63 +258,43 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoInitContext()
 
 	this->_InterruptInitStage = 0;
 
-	// Allocate blob storage
-	NTSTATUS status = WdfMemoryCreate(
-		&attributes,
-		NonPagedPoolNx,
-		XUSB_POOL_TAG,
-		XUSB_BLOB_STORAGE_SIZE,
-		&this->_InterruptBlobStorage,
-		reinterpret_cast<PVOID*>(&blobBuffer)
+	// I/O Queue for pending IRPs
+	WDF_IO_QUEUE_CONFIG holdingInQueueConfig;
+
+	// Create and assign queue for unhandled interrupt requests
+	WDF_IO_QUEUE_CONFIG_INIT(&holdingInQueueConfig, WdfIoQueueDispatchManual);
+
+	NTSTATUS status = WdfIoQueueCreate(
+		this->_PdoDevice,
+		&holdingInQueueConfig,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&this->_HoldingUsbInRequests
 	);
 	if (!NT_SUCCESS(status))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_XUSB,
-			"WdfMemoryCreate failed with status %!STATUS!",
+			"WdfIoQueueCreate (HoldingUsbInRequests) failed with status %!STATUS!",
 			status);
 		return status;
 	}
 
-	// Fill blob storage
-	COPY_BYTE_ARRAY(blobBuffer, P99_PROTECT({
-		// 0
-		0x01, 0x03, 0x0E,
-		// 1
-		0x02, 0x03, 0x00,
-		// 2
-		0x03, 0x03, 0x03,
-		// 3
-		0x08, 0x03, 0x00,
-		// 4
-		0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0xe4, 0xf2,
-		0xb3, 0xf8, 0x49, 0xf3, 0xb0, 0xfc, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00,
-		// 5
-		0x01, 0x03, 0x03,
-		// 6
-		0x05, 0x03, 0x00,
-		// 7
-		0x31, 0x3F, 0xCF, 0xDC
-		}));
-
-	// I/O Queue for pending IRPs
-	WDF_IO_QUEUE_CONFIG holdingInQueueConfig;
+	WDF_IO_QUEUE_CONFIG userIndexQueueConfig;
 
-	// Create and assign queue for unhandled interrupt requests
-	WDF_IO_QUEUE_CONFIG_INIT(&holdingInQueueConfig, WdfIoQueueDispatchManual);
+	// Create queue for user index waits, they arrive on the FDO
+	WDF_IO_QUEUE_CONFIG_INIT(&userIndexQueueConfig, WdfIoQueueDispatchManual);
 
 	status = WdfIoQueueCreate(
-		this->_PdoDevice,
-		&holdingInQueueConfig,
+		WdfPdoGetParent(this->_PdoDevice),
+		&userIndexQueueConfig,
 		WDF_NO_OBJECT_ATTRIBUTES,
-		&this->_HoldingUsbInRequests
+		&this->_PendingUserIndexRequests
 	);
 	if (!NT_SUCCESS(status))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_XUSB,
-			"WdfIoQueueCreate (HoldingUsbInRequests) failed with status %!STATUS!",
+			"WdfIoQueueCreate (PendingUserIndexRequests) failed with status %!STATUS!",
 			status);
 		return status;
 	}
@@ -712,7 +720,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			TRACE_USBPDO,
 			">> >> >> Incoming request, queuing...");
 
-		auto blobBuffer = static_cast<PUCHAR>(WdfMemoryGetBuffer(this->_InterruptBlobStorage, nullptr));
+		const PCUCHAR blobBuffer = _InterruptBlob;
 
 		if (xusb_is_data_pipe(pTransfer))
 		{
@@ -760,6 +768,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			case 4:
 				pTransfer->TransferBufferLength = sizeof(XUSB_INTERRUPT_IN_PACKET);
 				this->_InterruptInitStage++;
+				this->MarkPluginPhase(VIGEM_PLUGIN_PHASE_INPUT_STARTED);
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
 					&blobBuffer[XUSB_BLOB_04_OFFSET],
@@ -776,6 +785,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				);
 				return STATUS_SUCCESS;
 			default:
+				this->RecordPoll();
+
 				/* This request is sent periodically and relies on data the "feeder"
 				* has to supply, so we queue this request and return with STATUS_PENDING.
 				* The request gets completed as soon as the "feeder" sent an update. */
@@ -807,41 +818,31 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 	}
 
 	// Data coming FROM the higher driver TO us
-	TraceDbg(
-		TRACE_USBPDO,
-		">> >> >> URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER: Handle %p, Flags %X, Length %d",
-		pTransfer->PipeHandle,
-		pTransfer->TransferFlags,
-		pTransfer->TransferBufferLength);
+	this->RecordReport(VIGEM_REPORT_LOG_OUTPUT, pTransfer->TransferBuffer, pTransfer->TransferBufferLength);
+	this->RecordRawOutput(pTransfer->TransferBuffer, pTransfer->TransferBufferLength);
 
 #pragma region Cache values
 
 	if (pTransfer->TransferBufferLength == XUSB_LEDSET_SIZE) // Led
 	{
-		auto Buffer = static_cast<PUCHAR>(pTransfer->TransferBuffer);
-
-		TraceDbg(
-			TRACE_USBPDO,
-			"-- LED Buffer: %02X %02X %02X",
-			Buffer[0], Buffer[1], Buffer[2]);
+		CHAR previousLedNumber;
 
 		// extract LED byte to get controller slot
-		if (Buffer[0] == 0x01 && Buffer[1] == 0x03 && Buffer[2] >= 0x02)
+		if (this->_UserIndex.ApplyLedPacket(static_cast<PUCHAR>(pTransfer->TransferBuffer),
+		                                    pTransfer->TransferBufferLength, &previousLedNumber))
 		{
-			if (Buffer[2] == 0x02)this->_LedNumber = 0;
-			if (Buffer[2] == 0x03)this->_LedNumber = 1;
-			if (Buffer[2] == 0x04)this->_LedNumber = 2;
-			if (Buffer[2] == 0x05)this->_LedNumber = 3;
-
-			TraceDbg(
-				TRACE_USBPDO,
-				"-- LED Number: %d",
-				this->_LedNumber);
+			//
+			// Wake feeders waiting for the slot instead of polling it
+			// 
+			this->RecordEvent(VIGEM_EVENT_LED_CHANGED, static_cast<ULONG>(previousLedNumber),
+			                  static_cast<ULONG>(this->GetLedNumber()));
+			this->CompleteUserIndexWaits();
 		}
 
 		//
 		// Notify client library that PDO is ready
 		// 
+		this->MarkPluginPhase(VIGEM_PLUGIN_PHASE_READY);
 		KeSetEvent(&this->_PdoBootNotificationEvent, 0, FALSE);
 	}
 
@@ -850,18 +851,6 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 	{
 		auto Buffer = static_cast<PUCHAR>(pTransfer->TransferBuffer);
 
-		TraceDbg(
-			TRACE_USBPDO,
-			"-- Rumble Buffer: %02X %02X %02X %02X %02X %02X %02X %02X",
-			Buffer[0],
-			Buffer[1],
-			Buffer[2],
-			Buffer[3],
-			Buffer[4],
-			Buffer[5],
-			Buffer[6],
-			Buffer[7]);
-
 		RtlCopyBytes(this->_Rumble, Buffer, pTransfer->TransferBufferLength);
 	}
 
@@ -886,14 +875,12 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			// Assign values to output buffer
 			notify->Size = sizeof(XUSB_REQUEST_NOTIFICATION);
 			notify->SerialNo = this->_SerialNo;
-			notify->LedNumber = this->_LedNumber;
+			notify->LedNumber = this->GetLedNumber();
 			notify->LargeMotor = this->_Rumble[3];
 			notify->SmallMotor = this->_Rumble[4];
 
-			DumpAsHex("!! XUSB_REQUEST_NOTIFICATION",
-			          notify,
-			          sizeof(XUSB_REQUEST_NOTIFICATION)
-			);
+			this->RecordEvent(VIGEM_EVENT_NOTIFICATION_COMPLETED, notify->LargeMotor, notify->SmallMotor,
+			                  notify->LedNumber);
 
 			WdfRequestCompleteWithInformation(notifyRequest, status, notify->Size);
 		}
@@ -905,12 +892,12 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			            status);
 		}
 	}
-	else
+	else if (const DMFMODULE bufferQueue = this->ReferenceNotificationBuffers())
 	{
 		PVOID clientBuffer, contextBuffer;
 
 		if (NT_SUCCESS(DMF_BufferQueue_Fetch(
-			this->_UsbInterruptOutBufferQueue,
+			bufferQueue,
 			&clientBuffer,
 			&contextBuffer
 		)) && pTransfer->TransferBufferLength <= MAX_OUT_BUFFER_QUEUE_SIZE)
@@ -923,10 +910,12 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 
 			*static_cast<size_t*>(contextBuffer) = pTransfer->TransferBufferLength;
 
-			TraceDbg(TRACE_USBPDO, "Queued %Iu bytes", pTransfer->TransferBufferLength);
+			this->RecordEvent(VIGEM_EVENT_NOTIFICATION_QUEUED, pTransfer->TransferBufferLength);
 
-			DMF_BufferQueue_Enqueue(this->_UsbInterruptOutBufferQueue, clientBuffer);
+			DMF_BufferQueue_Enqueue(bufferQueue, clientBuffer);
 		}
+
+		this->DereferenceNotificationBuffers();
 	}
 
 	return status;
@@ -935,19 +924,17 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbControlTransfer(PURB Urb)
 {
 	NTSTATUS status;
-	PUCHAR   blobBuffer;
 
 	switch (Urb->UrbControlTransfer.SetupPacket[6])
 	{
 	case 0x04:
 
-		blobBuffer = static_cast<PUCHAR>(WdfMemoryGetBuffer(this->_InterruptBlobStorage, nullptr));
 		//
 		// Xenon magic
 		// 
 		RtlCopyMemory(
 			Urb->UrbControlTransfer.TransferBuffer,
-			&blobBuffer[XUSB_BLOB_07_OFFSET],
+			&_InterruptBlob[XUSB_BLOB_07_OFFSET],
 			0x04
 		);
 		status = STATUS_SUCCESS;
@@ -1030,6 +1017,50 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitReportImpl(PVOID NewRep
 	return status;
 }
 
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::ApplyAxisTransform(PVOID NewReport, const Core::AxisTransform& Transform)
+{
+	const auto pReport = &static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Report;
+	LONG axes[VIGEM_AXIS_COUNT];
+
+	Core::AxisTransform::FromXusbReport(pReport, axes);
+	Transform.Apply(axes);
+	Core::AxisTransform::ToXusbReport(axes, pReport);
+}
+
+bool ViGEm::Bus::Targets::EmulationTargetXUSB::AggregateReport(PVOID NewReport, LONG SessionId, Core::ReportAggregator& Aggregator)
+{
+	const auto pReport = &static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Report;
+	Core::AGGREGATOR_STATE input, merged;
+
+	Core::ReportAggregator::FromXusbReport(pReport, input);
+
+	if (!Aggregator.Merge(SessionId, input, merged))
+		return false;
+
+	Core::ReportAggregator::ToXusbReport(merged, pReport);
+
+	return true;
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::ApplyMacroOverlay(PVOID NewReport, const Core::MACRO_OVERLAY& Overlay)
+{
+	const auto pReport = &static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Report;
+	Core::AGGREGATOR_STATE state;
+
+	Core::ReportAggregator::FromXusbReport(pReport, state);
+	Core::MacroSet::ApplyOverlay(Overlay, state.Buttons, state.Axes);
+	Core::ReportAggregator::ToXusbReport(state, pReport);
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitNeutralReport()
+{
+	XUSB_SUBMIT_REPORT neutral;
+
+	XUSB_SUBMIT_REPORT_INIT(&neutral, this->_SerialNo);
+
+	(void)this->SubmitReportImpl(&neutral);
+}
+
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::GetUserIndex(PULONG UserIndex) const
 {
 	if (!this->IsOwnerProcess())
@@ -1038,9 +1069,11 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::GetUserIndex(PULONG UserIndex
 	if (!UserIndex)
 		return STATUS_INVALID_PARAMETER;
 	
-	if (this->_LedNumber >= 0)
+	const CHAR ledNumber = this->GetLedNumber();
+
+	if (ledNumber >= 0)
 	{
-		*UserIndex = static_cast<ULONG>(this->_LedNumber);
+		*UserIndex = static_cast<ULONG>(ledNumber);
 		return STATUS_SUCCESS;
 	}
 
@@ -1049,7 +1082,146 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::GetUserIndex(PULONG UserIndex
 	return STATUS_INVALID_DEVICE_OBJECT_PARAMETER;
 }
 
-void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUEUE Queue)
+NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::WaitUserIndex(WDFREQUEST Request, LONG KnownUserIndex,
+                                                               PULONG UserIndex)
+{
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (!UserIndex)
+		return STATUS_INVALID_PARAMETER;
+
+	if (!this->_PendingUserIndexRequests)
+		return STATUS_INVALID_DEVICE_STATE;
+
+	const CHAR ledNumber = this->GetLedNumber();
+
+	if (Core::UserIndexWatcher::Satisfies(ledNumber, KnownUserIndex))
+	{
+		*UserIndex = static_cast<ULONG>(ledNumber);
+		return STATUS_SUCCESS;
+	}
+
+	//
+	// Keep the known index where the queue can be searched for it
+	// 
+	WDF_OBJECT_ATTRIBUTES attributes;
+	PXUSB_USER_INDEX_WAIT_CONTEXT wait = nullptr;
+
+	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, XUSB_USER_INDEX_WAIT_CONTEXT);
+
+	NTSTATUS status = WdfObjectAllocateContext(Request, &attributes, reinterpret_cast<PVOID*>(&wait));
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_XUSB,
+			"WdfObjectAllocateContext failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	wait->KnownUserIndex = KnownUserIndex;
+
+	status = WdfRequestForwardToIoQueue(Request, this->_PendingUserIndexRequests);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_XUSB,
+			"WdfRequestForwardToIoQueue failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	//
+	// The host might have assigned the slot while the request got queued
+	// 
+	if (this->GetLedNumber() != ledNumber)
+		this->CompleteUserIndexWaits();
+
+	return STATUS_PENDING;
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::CompleteUserIndexWaits()
+{
+	NTSTATUS status;
+	WDFREQUEST found;
+	WDFREQUEST previous = nullptr;
+
+	const CHAR ledNumber = this->GetLedNumber();
+
+	if (ledNumber == Core::UserIndexWatcher::UNASSIGNED || !this->_PendingUserIndexRequests)
+		return;
+
+	//
+	// Waits already satisfied by the current index stay queued untouched
+	// 
+	for (;;)
+	{
+		status = WdfIoQueueFindRequest(this->_PendingUserIndexRequests, previous, nullptr, nullptr, &found);
+
+		if (previous)
+		{
+			WdfObjectDereference(previous);
+			previous = nullptr;
+		}
+
+		// The previous request left the queue meanwhile, search from the start
+		if (status == STATUS_NOT_FOUND)
+			continue;
+
+		if (!NT_SUCCESS(status))
+			break;
+
+		if (!Core::UserIndexWatcher::Satisfies(ledNumber, XusbUserIndexWaitGetContext(found)->KnownUserIndex))
+		{
+			previous = found;
+			continue;
+		}
+
+		WDFREQUEST request;
+
+		status = WdfIoQueueRetrieveFoundRequest(this->_PendingUserIndexRequests, found, &request);
+
+		WdfObjectDereference(found);
+
+		// Got canceled meanwhile, search from the start
+		if (!NT_SUCCESS(status))
+			continue;
+
+		PXUSB_WAIT_USER_INDEX wait = nullptr;
+		size_t length = 0;
+
+		status = WdfRequestRetrieveInputBuffer(
+			request,
+			sizeof(XUSB_WAIT_USER_INDEX),
+			reinterpret_cast<PVOID*>(&wait),
+			&length
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			WdfRequestComplete(request, status);
+			continue;
+		}
+
+		wait->UserIndex = static_cast<ULONG>(ledNumber);
+
+		WdfRequestCompleteWithInformation(request, STATUS_SUCCESS, length);
+	}
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::PurgeOwnerRequests()
+{
+	if (this->_PendingUserIndexRequests)
+	{
+		WdfIoQueuePurgeSynchronously(this->_PendingUserIndexRequests);
+		WdfIoQueueStart(this->_PendingUserIndexRequests);
+	}
+}
+
+void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUEUE Queue, DMFMODULE BufferQueue)
 {
 	NTSTATUS status;
 	WDFREQUEST request;
@@ -1065,7 +1237,7 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
 		status = DMF_BufferQueue_Dequeue(
-			this->_UsbInterruptOutBufferQueue,
+			BufferQueue,
 			&clientBuffer,
 			&contextBuffer
 		);
@@ -1092,7 +1264,7 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 		// 
 		if (bufferLength != XUSB_RUMBLE_SIZE && bufferLength != XUSB_LEDSET_SIZE)
 		{
-			DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
+			DMF_BufferQueue_Reuse(BufferQueue, clientBuffer);
 			WdfRequestComplete(request, STATUS_INVALID_BUFFER_SIZE);
 			break; // await callback getting fired again
 		}
@@ -1106,7 +1278,7 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 		{			
 			notify->Size = sizeof(XUSB_REQUEST_NOTIFICATION);
 			notify->SerialNo = this->_SerialNo;
-			notify->LedNumber = this->_LedNumber; // Report last cached value
+			notify->LedNumber = this->GetLedNumber(); // Report last cached value
 
 			if (bufferLength == XUSB_RUMBLE_SIZE)
 			{
@@ -1119,20 +1291,18 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 				notify->SmallMotor = this->_Rumble[4]; // Cached value
 			}
 
-			DumpAsHex("!! XUSB_REQUEST_NOTIFICATION", 
-				notify, 
-				sizeof(XUSB_REQUEST_NOTIFICATION)
-			);
+			this->RecordEvent(VIGEM_EVENT_NOTIFICATION_COMPLETED, notify->LargeMotor, notify->SmallMotor,
+			                  notify->LedNumber);
 			
 			WdfRequestCompleteWithInformation(request, status, notify->Size);
 		}
 
-		DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
+		DMF_BufferQueue_Reuse(BufferQueue, clientBuffer);
 
 		//
 		// If no more buffer to process, exit loop and await next callback
 		// 
-		if (DMF_BufferQueue_Count(this->_UsbInterruptOutBufferQueue) == 0)
+		if (DMF_BufferQueue_Count(BufferQueue) == 0)
 		{
 			break;
 		}
@@ -36,6 +36,7 @@
 #pragma once
 
 #include "EmulationTargetPDO.hpp"
+#include "UserIndexWatcher.hpp"
 
 namespace ViGEm::Bus::Targets
 {
@@ -60,11 +61,18 @@ namespace ViGEm::Bus::Targets
 		return (pTransfer->PipeHandle == reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0083));
 	}
 
-	class EmulationTargetXUSB : public Core::EmulationTargetPDO
+	class EmulationTargetXUSB final : public Core::EmulationTargetPDO
 	{
+		//
+		// Invokes the protected handlers through this type, see DispatchTarget
+		// 
+		friend class Core::EmulationTargetPDO;
+
 	public:
 		EmulationTargetXUSB(ULONG Serial, LONG SessionId, USHORT VendorId = 0x045E, USHORT ProductId = 0x028E);
 
+		~EmulationTargetXUSB() override;
+
 		NTSTATUS PdoPrepareDevice(PWDFDEVICE_INIT DeviceInit,
 		                          PUNICODE_STRING DeviceId,
 		                          PUNICODE_STRING DeviceDescription) override;
@@ -97,9 +105,35 @@ namespace ViGEm::Bus::Targets
 
 		NTSTATUS GetUserIndex(PULONG UserIndex) const;
 
+		//
+		// Completes with the user index if it differs from KnownUserIndex,
+		// otherwise pends Request until the host assigns another one
+		// 
+		NTSTATUS WaitUserIndex(WDFREQUEST Request, LONG KnownUserIndex, PULONG UserIndex);
+
 	protected:
-		void ProcessPendingNotification(WDFQUEUE Queue) override;
+		void ProcessPendingNotification(WDFQUEUE Queue, DMFMODULE BufferQueue) override;
+
+		VOID ApplyAxisTransform(PVOID NewReport, const Core::AxisTransform& Transform) override;
+
+		bool AggregateReport(PVOID NewReport, LONG SessionId, Core::ReportAggregator& Aggregator) override;
+
+		VOID ApplyMacroOverlay(PVOID NewReport, const Core::MACRO_OVERLAY& Overlay) override;
+
+		VOID SubmitNeutralReport() override;
+
+		VOID PurgeOwnerRequests() override;
 	private:
+		//
+		// Completes pending user index waits the current index satisfies
+		// 
+		VOID CompleteUserIndexWaits();
+
+		//
+		// The index gets written by the host's LED requests, read it once per use
+		// 
+		CHAR GetLedNumber() const { return this->_UserIndex.Get(); }
+
 		static PCWSTR _deviceDescription;
 
 #if defined(_X86_)
@@ -131,7 +165,7 @@ namespace ViGEm::Bus::Targets
 		//
 		// LED number (represents XInput slot index)
 		//
-		CHAR _LedNumber;
+		Core::UserIndexWatcher _UserIndex;
 
 		//
 		// Report packet
@@ -143,6 +177,11 @@ namespace ViGEm::Bus::Targets
 		//
 		WDFQUEUE _HoldingUsbInRequests;
 
+		//
+		// Queue for IOCTL_XUSB_WAIT_USER_INDEX requests, parented to the FDO
+		// 
+		WDFQUEUE _PendingUserIndexRequests{};
+
 		//
 		// Required for XInputGetCapabilities to work
 		// 
@@ -154,8 +193,18 @@ namespace ViGEm::Bus::Targets
 		ULONG _InterruptInitStage;
 
 		//
-		// Storage of binary blobs (packets) for PDO initialization
+		// Binary blobs (packets) for PDO initialization, shared by all targets
 		// 
-		WDFMEMORY _InterruptBlobStorage;
+		static const UCHAR _InterruptBlob[XUSB_BLOB_STORAGE_SIZE];
 	};
+
+	typedef struct _XUSB_USER_INDEX_WAIT_CONTEXT
+	{
+		//
+		// Index the waiting feeder already knows, the wait completes on any other
+		// 
+		LONG KnownUserIndex;
+	} XUSB_USER_INDEX_WAIT_CONTEXT, * PXUSB_USER_INDEX_WAIT_CONTEXT;
+
+	WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(XUSB_USER_INDEX_WAIT_CONTEXT, XusbUserIndexWaitGetContext)
 }
@@ -46,12 +46,270 @@
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text (PAGE, Bus_PlugInDevice)
 #pragma alloc_text (PAGE, Bus_UnPlugDevice)
+#pragma alloc_text (PAGE, Bus_UnPlugSessionDevices)
+#pragma alloc_text (PAGE, Bus_SetTargetPool)
+#pragma alloc_text (PAGE, Bus_LoadIdentities)
+#pragma alloc_text (PAGE, Bus_PersistIdentities)
+#pragma alloc_text (PAGE, Bus_QueryDs4TickTolerance)
+#pragma alloc_text (PAGE, Bus_QueryIdleTimeout)
 #endif
 
 using ViGEm::Bus::Core::PDO_IDENTIFICATION_DESCRIPTION;
 using ViGEm::Bus::Core::EmulationTargetPDO;
 using ViGEm::Bus::Targets::EmulationTargetXUSB;
 using ViGEm::Bus::Targets::EmulationTargetDS4;
+using ViGEm::Bus::Core::TargetPool;
+using ViGEm::Bus::Core::IdentityTable;
+using ViGEm::Bus::Core::SerialTable;
+
+//
+// Reports the child with the given serial as unplugged.
+// 
+static VOID Bus_UnPlugChild(WDFCHILDLIST List, ULONG SerialNo)
+{
+	PDO_IDENTIFICATION_DESCRIPTION description;
+
+	WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+
+	//
+	// Children are identified by serial number
+	// 
+	description.SerialNo = SerialNo;
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSENUM,
+		"Unplugging device with serial %d",
+		SerialNo);
+
+	const NTSTATUS status = WdfChildListUpdateChildDescriptionAsMissing(List, &description.Header);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfChildListUpdateChildDescriptionAsMissing failed with status %!STATUS!",
+			status);
+	}
+}
+
+//
+// Creates the target object of the given type, NULL for unsupported types.
+// Zero vendor or product IDs select the defaults of the type.
+// 
+static EmulationTargetPDO* Bus_NewTarget(
+	VIGEM_TARGET_TYPE Type,
+	ULONG SerialNo,
+	LONG SessionId,
+	USHORT VendorId,
+	USHORT ProductId)
+{
+	if (VendorId == 0 || ProductId == 0)
+	{
+		switch (Type)
+		{
+		case Xbox360Wired:
+			return new EmulationTargetXUSB(SerialNo, SessionId);
+		case DualShock4Wired:
+			return new EmulationTargetDS4(SerialNo, SessionId);
+		default:
+			return nullptr;
+		}
+	}
+
+	switch (Type)
+	{
+	case Xbox360Wired:
+		return new EmulationTargetXUSB(SerialNo, SessionId, VendorId, ProductId);
+	case DualShock4Wired:
+		return new EmulationTargetDS4(SerialNo, SessionId, VendorId, ProductId);
+	default:
+		return nullptr;
+	}
+}
+
+//
+// Creates pooled targets until the pool of the given type is at its depth.
+// 
+static VOID Bus_RefillTargetPool(WDFDEVICE Device, VIGEM_TARGET_TYPE Type)
+{
+	PDO_IDENTIFICATION_DESCRIPTION  description;
+	NTSTATUS                        status = STATUS_SUCCESS;
+	ULONG                           serialNo;
+	ULONG                           created = 0;
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+	const ULONG count = pFdoData->Pool.BeginRefill(Type);
+	ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
+	while (created < count)
+	{
+		serialNo = 0;
+
+		status = pFdoData->Serials.Reserve(&serialNo);
+		if (!NT_SUCCESS(status))
+			break;
+
+		WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+
+		description.SerialNo = serialNo;
+		description.SessionId = FDO_POOL_SESSION_ID;
+		description.Target = Bus_NewTarget(Type, serialNo, FDO_POOL_SESSION_ID, 0, 0);
+
+		if (description.Target == nullptr)
+		{
+			pFdoData->Serials.Release(serialNo);
+			status = STATUS_INSUFFICIENT_RESOURCES;
+			break;
+		}
+
+		description.Target->MarkPluginPhase(VIGEM_PLUGIN_PHASE_REQUESTED);
+
+		description.Target->SetPooled();
+
+		pFdoData->Serials.Bind(serialNo, description.Target);
+
+		status = description.Target->PdoPrepare(Device);
+		if (!NT_SUCCESS(status))
+		{
+			(void)EmulationTargetPDO::DisposeOffline(Device, serialNo, description.Target);
+			break;
+		}
+
+		//
+		// Claimable from here on, the claiming session waits for the device to boot
+		// 
+		ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+		pFdoData->Pool.Add(Type, description.Target->GetSessionLink());
+		ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
+		status = WdfChildListAddOrUpdateChildDescriptionAsPresent(
+			WdfFdoGetDefaultChildList(Device),
+			&description.Header,
+			NULL
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+			pFdoData->Pool.Discard(Type, description.Target->GetSessionLink());
+			ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
+			(void)EmulationTargetPDO::DisposeOffline(Device, serialNo, description.Target);
+			break;
+		}
+
+		created++;
+	}
+
+	if (created < count)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"Created %d of %d pooled targets of type %d (%!STATUS!)",
+			created,
+			count,
+			Type,
+			status);
+
+		ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+		pFdoData->Pool.CancelRefill(Type, count - created);
+		ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+	}
+}
+
+//
+// Hands an idle pooled target matching the request to the session.
+// Returns false if there is none.
+// 
+static bool Bus_ClaimPooledTarget(
+	WDFDEVICE Device,
+	PFDO_FILE_DATA FileData,
+	PVIGEM_PLUGIN_TARGET PlugIn,
+	PULONG SerialNo)
+{
+	EmulationTargetPDO* pdo = nullptr;
+	ULONG serialNo;
+
+	if (!TargetPool::IsSupported(PlugIn->TargetType))
+		return false;
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+
+	while ((serialNo = pFdoData->Pool.Peek(PlugIn->TargetType)) != 0)
+	{
+		pdo = pFdoData->Serials.LookupAdded(serialNo);
+
+		//
+		// Disposed targets give up their serial before leaving the pool
+		// 
+		if (pdo == nullptr)
+		{
+			(void)pFdoData->Pool.Take(PlugIn->TargetType);
+			continue;
+		}
+
+		// Pooled targets report the default IDs of their type
+		if (PlugIn->VendorId != 0 && PlugIn->ProductId != 0
+			&& (PlugIn->VendorId != pdo->GetVendorId() || PlugIn->ProductId != pdo->GetProductId()))
+		{
+			pdo = nullptr;
+			break;
+		}
+
+		(void)pFdoData->Pool.Take(PlugIn->TargetType);
+
+		pdo->Claim(FileData->SessionId);
+		FileData->Targets.Insert(pdo->GetSessionLink());
+
+		break;
+	}
+
+	ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
+	if (pdo == nullptr)
+		return false;
+
+	*SerialNo = serialNo;
+
+	return true;
+}
+
+//
+// Takes a pooled target released by its session back into the pool, if
+// the pool is below its depth.
+// 
+static bool Bus_RecycleTarget(WDFDEVICE Device, ULONG SerialNo)
+{
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	//
+	// Resetting needs the device object, targets still booting get unplugged
+	// 
+	EmulationTargetPDO* pdo = pFdoData->Serials.Lookup(SerialNo);
+
+	if (pdo == nullptr || !pdo->IsPooled())
+		return false;
+
+	pdo->Recycle();
+
+	ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+	const bool returned = pFdoData->Pool.Return(pdo->GetType(), pdo->GetSessionLink());
+	ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
+	return returned;
+}
+
+//
+// Unplugs a target its session let go of, unless the pool takes it back.
+// 
+static VOID Bus_ReleaseChild(WDFDEVICE Device, ULONG SerialNo)
+{
+	if (!Bus_RecycleTarget(Device, SerialNo))
+		Bus_UnPlugChild(WdfFdoGetDefaultChildList(Device), SerialNo);
+}
 
 //
 // Simulates a device plug-in event.
@@ -60,14 +318,19 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 	_In_ WDFDEVICE Device,
 	_In_ WDFREQUEST Request,
 	_In_ BOOLEAN IsInternal,
+	_In_ BOOLEAN AssignSerial,
 	_Out_ size_t* Transferred)
 {
 	PDO_IDENTIFICATION_DESCRIPTION  description;
 	NTSTATUS                        status;
 	PVIGEM_PLUGIN_TARGET            plugIn;
+	PVIGEM_PLUGIN_TARGET            pluggedIn = NULL;
 	WDFFILEOBJECT                   fileObject;
 	PFDO_FILE_DATA                  pFileData;
+	PFDO_DEVICE_DATA                pFdoData;
 	size_t                          length = 0;
+	ULONG                           serialNo;
+	const ULONGLONG                 requested = KeQueryInterruptTime();
 
 	UNREFERENCED_PARAMETER(IsInternal);
 
@@ -99,7 +362,7 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 		return STATUS_INVALID_PARAMETER;
 	}
 
-	if (plugIn->SerialNo == 0)
+	if (!AssignSerial && plugIn->SerialNo == 0)
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_BUSENUM,
@@ -107,6 +370,26 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 		return STATUS_INVALID_PARAMETER;
 	}
 
+	//
+	// The assigned serial gets returned in place of the request
+	// 
+	if (AssignSerial)
+	{
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_PLUGIN_TARGET),
+			reinterpret_cast<PVOID*>(&pluggedIn),
+			NULL
+		);
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_BUSENUM,
+				"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!", status);
+			return STATUS_INVALID_PARAMETER;
+		}
+	}
+
 	*Transferred = length;
 
 	fileObject = WdfRequestGetFileObject(Request);
@@ -129,68 +412,81 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 		return STATUS_INVALID_PARAMETER;
 	}
 
+	pFdoData = FdoGetData(Device);
+
 	//
-	// Initialize the description with the information about the newly
-	// plugged in device.
-	//
-	WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+	// Pre-created targets get handed out right away, then replaced
+	// 
+	if (AssignSerial && Bus_ClaimPooledTarget(Device, pFileData, plugIn, &serialNo))
+	{
+		pluggedIn->SerialNo = serialNo;
 
-	description.SerialNo = plugIn->SerialNo;
-	description.SessionId = pFileData->SessionId;
+		Bus_RefillTargetPool(Device, plugIn->TargetType);
 
-	// Set default IDs if supplied values are invalid
-	if (plugIn->VendorId == 0 || plugIn->ProductId == 0)
-	{
-		switch (plugIn->TargetType)
-		{
-		case Xbox360Wired:
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", STATUS_SUCCESS);
 
-			description.Target = new EmulationTargetXUSB(plugIn->SerialNo, pFileData->SessionId);
+		return STATUS_SUCCESS;
+	}
 
-			break;
-		case DualShock4Wired:
+	//
+	// Take the serial first, so probing taken serials creates nothing
+	// 
+	serialNo = AssignSerial ? 0 : plugIn->SerialNo;
 
-			description.Target = new EmulationTargetDS4(plugIn->SerialNo, pFileData->SessionId);
+	status = pFdoData->Serials.Reserve(&serialNo);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"Serial %d not available (%!STATUS!)",
+			serialNo,
+			status);
 
-			break;
-		default:
-			return STATUS_NOT_SUPPORTED;
-		}
+		// Taken serials fail the way they always did
+		return (status == STATUS_OBJECT_NAME_COLLISION) ? STATUS_INVALID_PARAMETER : status;
 	}
-	else
-	{
-		switch (plugIn->TargetType)
-		{
-		case Xbox360Wired:
 
-			description.Target = new EmulationTargetXUSB(
-				plugIn->SerialNo,
-				pFileData->SessionId,
-				plugIn->VendorId,
-				plugIn->ProductId
-			);
+	//
+	// Initialize the description with the information about the newly
+	// plugged in device.
+	//
+	WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
 
-			break;
-		case DualShock4Wired:
+	description.SerialNo = serialNo;
+	description.SessionId = pFileData->SessionId;
 
-			description.Target = new EmulationTargetDS4(
-				plugIn->SerialNo,
-				pFileData->SessionId,
-				plugIn->VendorId,
-				plugIn->ProductId
-			);
+	// Set default IDs if supplied values are invalid
+	description.Target = Bus_NewTarget(
+		plugIn->TargetType,
+		serialNo,
+		pFileData->SessionId,
+		plugIn->VendorId,
+		plugIn->ProductId
+	);
 
-			break;
-		default:
-			return STATUS_NOT_SUPPORTED;
-		}
+	if (description.Target == nullptr)
+	{
+		status = STATUS_NOT_SUPPORTED;
+		goto pluginRelease;
 	}
 
-	if (!NT_SUCCESS(description.Target->PdoPrepare(Device)))
+	description.Target->MarkPluginPhase(VIGEM_PLUGIN_PHASE_REQUESTED, requested);
+
+	pFdoData->Serials.Bind(serialNo, description.Target);
+
+	status = description.Target->PdoPrepare(Device);
+	if (!NT_SUCCESS(status))
 	{
-		goto pluginEnd;
+		goto pluginDispose;
 	}
 
+	//
+	// Link into the session before the PDO can exist, it unlinks itself on disposal
+	// 
+	ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+	pFileData->Targets.Insert(description.Target->GetSessionLink());
+	ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
 	status = WdfChildListAddOrUpdateChildDescriptionAsPresent(
 		WdfFdoGetDefaultChildList(Device),
 		&description.Header,
@@ -204,7 +500,7 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 			"WdfChildListAddOrUpdateChildDescriptionAsPresent failed with status %!STATUS!",
 			status);
 
-		goto pluginEnd;
+		goto pluginDispose;
 	}
 
 	//
@@ -219,9 +515,29 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 			"The described PDO already exists (%!STATUS!)",
 			status);
 
-		goto pluginEnd;
+		goto pluginDispose;
+	}
+
+	if (AssignSerial)
+	{
+		pluggedIn->SerialNo = serialNo;
 	}
 
+	goto pluginEnd;
+
+pluginDispose:
+
+	//
+	// Unlinks and frees the target, unless the child list's cleanup already did
+	// 
+	(void)EmulationTargetPDO::DisposeOffline(Device, serialNo, description.Target);
+
+	goto pluginEnd;
+
+pluginRelease:
+
+	pFdoData->Serials.Release(serialNo);
+
 pluginEnd:
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", status);
@@ -248,6 +564,7 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 	PVIGEM_UNPLUG_TARGET                unPlug;
 	WDFFILEOBJECT                       fileObject;
 	PFDO_FILE_DATA                      pFileData = NULL;
+	EmulationTargetPDO*                 pdo;
 	size_t                              length = 0;
 
 	PAGED_CODE();
@@ -302,6 +619,37 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 		return STATUS_INVALID_PARAMETER;
 	}
 
+	//
+	// Devices of the session are known without a walk of all children
+	// 
+	if (unplugAll && !IsInternal)
+	{
+		Bus_UnPlugSessionDevices(Device, pFileData);
+
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", STATUS_SUCCESS);
+
+		return STATUS_SUCCESS;
+	}
+
+	//
+	// Only unplug owned child
+	// 
+	if (!unplugAll)
+	{
+		if (EmulationTargetPDO::GetPdoBySerial(Device, unPlug->SerialNo, &pdo)
+			&& (IsInternal || pdo->GetSessionId() == pFileData->SessionId))
+		{
+			if (IsInternal)
+				Bus_UnPlugChild(WdfFdoGetDefaultChildList(Device), unPlug->SerialNo);
+			else
+				Bus_ReleaseChild(Device, unPlug->SerialNo);
+		}
+
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", STATUS_SUCCESS);
+
+		return STATUS_SUCCESS;
+	}
+
 	TraceEvents(TRACE_LEVEL_VERBOSE,
 		TRACE_BUSENUM,
 		"Starting child list traversal");
@@ -381,3 +729,428 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 
 	return STATUS_SUCCESS;
 }
+
+//
+// Unplugs all devices owned by the given session, only touching those.
+// 
+EXTERN_C VOID Bus_UnPlugSessionDevices(
+	_In_ WDFDEVICE Device,
+	_In_ PFDO_FILE_DATA FileData)
+{
+	ULONG serials[FDO_UNPLUG_BATCH_SIZE];
+	ULONG count;
+
+	PAGED_CODE();
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	//
+	// Child list calls are made without holding the lock
+	// 
+	do
+	{
+		ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+		count = FileData->Targets.TakeSerials(serials, ARRAYSIZE(serials));
+		ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
+		for (ULONG i = 0; i < count; i++)
+		{
+			Bus_ReleaseChild(Device, serials[i]);
+		}
+	} while (count == ARRAYSIZE(serials));
+}
+
+//
+// Sets the number of idle pre-created targets of a type, unplugging idle
+// ones above it and creating missing ones.
+// 
+EXTERN_C NTSTATUS Bus_SetTargetPool(
+	_In_ WDFDEVICE Device,
+	_In_ VIGEM_TARGET_TYPE Type,
+	_In_ ULONG Depth)
+{
+	ULONG serials[VIGEM_TARGET_POOL_MAX_DEPTH];
+
+	PAGED_CODE();
+
+	if (!TargetPool::IsSupported(Type) || Depth > VIGEM_TARGET_POOL_MAX_DEPTH)
+		return STATUS_INVALID_PARAMETER;
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+	const WDFCHILDLIST list = WdfFdoGetDefaultChildList(Device);
+
+	//
+	// The idle count never exceeds the maximum depth, one pass gets all excess
+	// 
+	ExAcquireFastMutex(&pFdoData->SessionTargetLock);
+	pFdoData->Pool.SetDepth(Type, Depth);
+	const ULONG count = pFdoData->Pool.TakeExcess(Type, serials, ARRAYSIZE(serials));
+	ExReleaseFastMutex(&pFdoData->SessionTargetLock);
+
+	for (ULONG i = 0; i < count; i++)
+	{
+		Bus_UnPlugChild(list, serials[i]);
+	}
+
+	Bus_RefillTargetPool(Device, Type);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSENUM,
+		"Pool depth of type %d set to %d, %d idle targets unplugged",
+		Type,
+		Depth,
+		count);
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Opens (or creates) Parameters\Targets\DualShock of the driver key.
+// 
+static NTSTATUS Bus_OpenIdentityKey(_Out_ WDFKEY* Key)
+{
+	NTSTATUS status;
+	WDFKEY keyParams, keyTargets;
+	UNICODE_STRING keyName;
+
+	PAGED_CODE();
+
+	status = WdfDriverOpenParametersRegistryKey(
+		WdfGetDriver(),
+		STANDARD_RIGHTS_ALL,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&keyParams
+	);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	RtlUnicodeStringInit(&keyName, L"Targets");
+
+	status = WdfRegistryCreateKey(
+		keyParams,
+		&keyName,
+		KEY_ALL_ACCESS,
+		REG_OPTION_NON_VOLATILE,
+		nullptr,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&keyTargets
+	);
+
+	WdfRegistryClose(keyParams);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	RtlUnicodeStringInit(&keyName, L"DualShock");
+
+	status = WdfRegistryCreateKey(
+		keyTargets,
+		&keyName,
+		KEY_ALL_ACCESS,
+		REG_OPTION_NON_VOLATILE,
+		nullptr,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		Key
+	);
+
+	WdfRegistryClose(keyTargets);
+
+	return status;
+}
+
+//
+// Imports the per-serial keys (<serial>\TargetMacAddress) earlier versions
+// wrote on every plug-in. Only done while no identity table is stored.
+// 
+static VOID Bus_ImportLegacyIdentities(_In_ WDFKEY Key, _Inout_ IdentityTable& Identities)
+{
+	UCHAR buffer[sizeof(KEY_BASIC_INFORMATION) + 16 * sizeof(WCHAR)];
+	const auto info = reinterpret_cast<PKEY_BASIC_INFORMATION>(buffer);
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+	ULONG resultLength, length, serial;
+	WDFKEY keySerial;
+
+	PAGED_CODE();
+
+	DECLARE_CONST_UNICODE_STRING(valueName, L"TargetMacAddress");
+
+	for (ULONG index = 0;; index++)
+	{
+		NTSTATUS status = ZwEnumerateKey(
+			WdfRegistryWdmGetHandle(Key),
+			index,
+			KeyBasicInformation,
+			info,
+			sizeof(buffer),
+			&resultLength
+		);
+
+		if (status == STATUS_NO_MORE_ENTRIES)
+			break;
+
+		// Names too long for the buffer aren't serials
+		if (!NT_SUCCESS(status))
+			continue;
+
+		UNICODE_STRING name;
+		name.Buffer = info->Name;
+		name.Length = name.MaximumLength = static_cast<USHORT>(info->NameLength);
+
+		if (!NT_SUCCESS(RtlUnicodeStringToInteger(&name, 10, &serial))
+			|| serial == 0 || serial > SerialTable::MAX_SERIAL)
+			continue;
+
+		status = WdfRegistryOpenKey(Key, &name, KEY_READ, WDF_NO_OBJECT_ATTRIBUTES, &keySerial);
+
+		if (!NT_SUCCESS(status))
+			continue;
+
+		status = WdfRegistryQueryValue(
+			keySerial,
+			&valueName,
+			sizeof(address),
+			address,
+			&length,
+			nullptr
+		);
+
+		if (NT_SUCCESS(status) && length == sizeof(address))
+			(void)Identities.Insert(serial, address);
+
+		WdfRegistryClose(keySerial);
+	}
+}
+
+//
+// Loads the persisted DualShock 4 identities into the table of the bus.
+// 
+EXTERN_C NTSTATUS Bus_LoadIdentities(
+	_In_ WDFDEVICE Device)
+{
+	NTSTATUS status;
+	WDFKEY key;
+	ULONG length = 0;
+	ULONG type = REG_NONE;
+
+	PAGED_CODE();
+
+	IdentityTable& identities = FdoGetData(Device)->Identities;
+
+	DECLARE_CONST_UNICODE_STRING(valueName, L"Identities");
+
+	status = Bus_OpenIdentityKey(&key);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	status = WdfRegistryQueryValue(key, &valueName, 0, nullptr, &length, &type);
+
+	if (status == STATUS_OBJECT_NAME_NOT_FOUND)
+	{
+		Bus_ImportLegacyIdentities(key, identities);
+
+		if (identities.IsPending())
+			Bus_ScheduleIdentityFlush(Device);
+
+		status = STATUS_SUCCESS;
+	}
+	else if (status == STATUS_BUFFER_OVERFLOW && type == REG_BINARY)
+	{
+		const PVOID buffer = ExAllocatePoolWithTag(PagedPool, length, IDENTITY_TABLE_POOL_TAG);
+
+		if (buffer)
+		{
+			status = WdfRegistryQueryValue(key, &valueName, length, buffer, &length, nullptr);
+
+			if (NT_SUCCESS(status))
+				status = identities.Deserialize(buffer, length);
+
+			ExFreePoolWithTag(buffer, IDENTITY_TABLE_POOL_TAG);
+		}
+		else
+		{
+			status = STATUS_INSUFFICIENT_RESOURCES;
+		}
+	}
+	else if (NT_SUCCESS(status) || status == STATUS_BUFFER_OVERFLOW)
+	{
+		status = STATUS_INVALID_PARAMETER;
+	}
+
+	WdfRegistryClose(key);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSENUM,
+		"Loaded %d DualShock 4 identities",
+		identities.GetCount());
+
+	return status;
+}
+
+//
+// Writes the DualShock 4 identities of the bus, if changed, in one value.
+// 
+EXTERN_C NTSTATUS Bus_PersistIdentities(
+	_In_ WDFDEVICE Device)
+{
+	NTSTATUS status;
+	WDFKEY key;
+	PVOID buffer = nullptr;
+	ULONG length = 0;
+
+	PAGED_CODE();
+
+	IdentityTable& identities = FdoGetData(Device)->Identities;
+
+	DECLARE_CONST_UNICODE_STRING(valueName, L"Identities");
+
+	if (!identities.IsPending())
+		return STATUS_SUCCESS;
+
+	//
+	// The table may grow in between sizing and copying it, retry then
+	// 
+	do
+	{
+		if (buffer)
+			ExFreePoolWithTag(buffer, IDENTITY_TABLE_POOL_TAG);
+
+		buffer = length ? ExAllocatePoolWithTag(PagedPool, length, IDENTITY_TABLE_POOL_TAG) : nullptr;
+
+		if (length && !buffer)
+			return STATUS_INSUFFICIENT_RESOURCES;
+
+		status = identities.Serialize(buffer, length, &length);
+	} while (status == STATUS_BUFFER_TOO_SMALL);
+
+	if (NT_SUCCESS(status))
+	{
+		status = Bus_OpenIdentityKey(&key);
+
+		if (NT_SUCCESS(status))
+		{
+			status = WdfRegistryAssignValue(key, &valueName, REG_BINARY, length, buffer);
+
+			WdfRegistryClose(key);
+		}
+
+		if (!NT_SUCCESS(status))
+			identities.SetPending();
+	}
+
+	if (buffer)
+		ExFreePoolWithTag(buffer, IDENTITY_TABLE_POOL_TAG);
+
+	return status;
+}
+
+//
+// Persists the DualShock 4 identities after FDO_IDENTITY_FLUSH_DELAY_MS,
+// unless a flush is already due.
+// 
+EXTERN_C VOID Bus_ScheduleIdentityFlush(
+	_In_ WDFDEVICE Device)
+{
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	if (InterlockedCompareExchange(&pFdoData->IdentityFlushPending, TRUE, FALSE) == FALSE)
+		WdfTimerStart(pFdoData->IdentityTimer, WDF_REL_TIMEOUT_IN_MS(FDO_IDENTITY_FLUSH_DELAY_MS));
+}
+
+//
+// Reads the Ds4TickTolerance parameter of the driver key, bounded by the
+// tick interval.
+// 
+EXTERN_C ULONG Bus_QueryDs4TickTolerance(VOID)
+{
+	WDFKEY keyParams;
+	ULONG value;
+	ULONG tolerance = FDO_DS4_TICK_TOLERANCE_MS;
+	DECLARE_CONST_UNICODE_STRING(valueName, L"Ds4TickTolerance");
+
+	PAGED_CODE();
+
+	const NTSTATUS status = WdfDriverOpenParametersRegistryKey(
+		WdfGetDriver(),
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&keyParams
+	);
+
+	if (NT_SUCCESS(status))
+	{
+		if (NT_SUCCESS(WdfRegistryQueryULong(keyParams, &valueName, &value)))
+			tolerance = min(value, FDO_DS4_TICK_MS);
+
+		WdfRegistryClose(keyParams);
+	}
+
+	return tolerance;
+}
+
+//
+// Reads the IdleTimeout parameter of the driver key, 0 disables parking.
+// 
+EXTERN_C ULONG Bus_QueryIdleTimeout(VOID)
+{
+	WDFKEY keyParams;
+	ULONG value;
+	ULONG timeout = FDO_IDLE_TIMEOUT_MS;
+	DECLARE_CONST_UNICODE_STRING(valueName, L"IdleTimeout");
+
+	PAGED_CODE();
+
+	const NTSTATUS status = WdfDriverOpenParametersRegistryKey(
+		WdfGetDriver(),
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&keyParams
+	);
+
+	if (NT_SUCCESS(status))
+	{
+		if (NT_SUCCESS(WdfRegistryQueryULong(keyParams, &valueName, &value)))
+			timeout = value;
+
+		WdfRegistryClose(keyParams);
+	}
+
+	return timeout;
+}
+
+//
+// Reports what this build of the bus supports, clients pick their data
+// paths from it instead of probing.
+// 
+EXTERN_C VOID Bus_QueryCapabilities(WDFDEVICE Device, PVIGEM_BUS_CAPABILITIES Capabilities)
+{
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	RtlZeroMemory(Capabilities, sizeof(VIGEM_BUS_CAPABILITIES));
+
+	Capabilities->Size = sizeof(VIGEM_BUS_CAPABILITIES);
+	Capabilities->Version = VIGEM_COMMON_VERSION;
+	Capabilities->Features = VIGEM_BUS_FEATURE_ASSIGN_SERIAL
+		| VIGEM_BUS_FEATURE_WAIT_DEVICE_READY
+		| VIGEM_BUS_FEATURE_DS4_REPORT_EX
+		| VIGEM_BUS_FEATURE_TARGET_POOL
+		| VIGEM_BUS_FEATURE_REPORT_PROCESSING
+		| VIGEM_BUS_FEATURE_RECORDING_RINGS
+		| VIGEM_BUS_FEATURE_EVENT_TRACE
+		| VIGEM_BUS_FEATURE_USER_INDEX_WAIT;
+
+	if (pFdoData->IdleTimeout != 0)
+		Capabilities->Features |= VIGEM_BUS_FEATURE_IDLE_PARKING;
+
+	Capabilities->MaxTargets = SerialTable::MAX_SERIAL;
+	Capabilities->MaxPoolDepth = VIGEM_TARGET_POOL_MAX_DEPTH;
+	Capabilities->RecordingMinCapacity = VIGEM_RECORDING_MIN_CAPACITY;
+	Capabilities->RecordingMaxCapacity = VIGEM_RECORDING_MAX_CAPACITY;
+	Capabilities->RawOutputMinCapacity = VIGEM_RAW_OUTPUT_MIN_CAPACITY;
+	Capabilities->RawOutputMaxCapacity = VIGEM_RAW_OUTPUT_MAX_CAPACITY;
+	Capabilities->EventTraceMinCapacity = VIGEM_EVENT_TRACE_MIN_CAPACITY;
+	Capabilities->EventTraceMaxCapacity = VIGEM_EVENT_TRACE_MAX_CAPACITY;
+	Capabilities->Ds4TickInterval = FDO_DS4_TICK_MS;
+	Capabilities->IdleTimeout = static_cast<ULONG>(pFdoData->IdleTimeout / 10000);
+}
@@ -0,0 +1,279 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "AxisTransform.hpp"
+#include "Test.hpp"
+
+#include <cstring>
+
+using ViGEm::Bus::Core::AxisTransform;
+
+
+static void InitPassThrough(VIGEM_AXIS_PROFILE (&Profiles)[VIGEM_AXIS_COUNT])
+{
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+		VIGEM_AXIS_PROFILE_INIT(&Profiles[axis], static_cast<VIGEM_AXIS>(axis));
+}
+
+static LONG TransformOne(const AxisTransform& Transform, ULONG Axis, LONG Value)
+{
+	LONG axes[VIGEM_AXIS_COUNT] = {};
+
+	axes[Axis] = Value;
+	Transform.Apply(axes);
+
+	return axes[Axis];
+}
+
+TEST(PassThroughKeepsValues)
+{
+	VIGEM_AXIS_PROFILE profiles[VIGEM_AXIS_COUNT];
+	AxisTransform transform;
+
+	InitPassThrough(profiles);
+	CHECK_EQUAL(STATUS_SUCCESS, transform.Load(profiles));
+	CHECK(transform.IsEnabled());
+
+	for (LONG value = -VIGEM_AXIS_MAX; value <= VIGEM_AXIS_MAX; value += 7)
+	{
+		const LONG result = TransformOne(transform, VIGEM_AXIS_THUMB_LX, value);
+
+		CHECK(result - value <= 2 && value - result <= 2);
+	}
+
+	CHECK_EQUAL(0, TransformOne(transform, VIGEM_AXIS_THUMB_LX, 0));
+	CHECK_EQUAL(VIGEM_AXIS_MAX, TransformOne(transform, VIGEM_AXIS_THUMB_LX, VIGEM_AXIS_MAX));
+
+	// The negative end gets clamped to the symmetric range
+	CHECK_EQUAL(-VIGEM_AXIS_MAX, TransformOne(transform, VIGEM_AXIS_THUMB_LX, -VIGEM_AXIS_MAX - 1));
+}
+
+TEST(DeadzoneRescalesRemainingRange)
+{
+	VIGEM_AXIS_PROFILE profiles[VIGEM_AXIS_COUNT];
+	AxisTransform transform;
+
+	InitPassThrough(profiles);
+	profiles[VIGEM_AXIS_THUMB_RY].Deadzone = 4000;
+	CHECK_EQUAL(STATUS_SUCCESS, transform.Load(profiles));
+
+	CHECK_EQUAL(0, TransformOne(transform, VIGEM_AXIS_THUMB_RY, 3999));
+	CHECK_EQUAL(0, TransformOne(transform, VIGEM_AXIS_THUMB_RY, -4000));
+	CHECK(TransformOne(transform, VIGEM_AXIS_THUMB_RY, 4100) > 0);
+	CHECK_EQUAL(VIGEM_AXIS_MAX, TransformOne(transform, VIGEM_AXIS_THUMB_RY, VIGEM_AXIS_MAX));
+	CHECK_EQUAL(-VIGEM_AXIS_MAX, TransformOne(transform, VIGEM_AXIS_THUMB_RY, -VIGEM_AXIS_MAX));
+
+	// Halfway through the remaining range lands halfway on the curve
+	const LONG half = TransformOne(transform, VIGEM_AXIS_THUMB_RY, 4000 + (VIGEM_AXIS_MAX - 4000) / 2);
+
+	CHECK(half > VIGEM_AXIS_MAX / 2 - 16 && half < VIGEM_AXIS_MAX / 2 + 16);
+}
+
+TEST(CurvesAreMonotonicAndReachTheirEnds)
+{
+	VIGEM_AXIS_PROFILE profiles[VIGEM_AXIS_COUNT];
+	AxisTransform transform;
+
+	InitPassThrough(profiles);
+
+	//
+	// Quadratic response with a reduced maximum
+	// 
+	for (ULONG point = 0; point < VIGEM_AXIS_CURVE_POINTS; point++)
+	{
+		profiles[VIGEM_AXIS_THUMB_LY].Curve[point] = static_cast<USHORT>(point * point * 20000 / 256);
+	}
+
+	profiles[VIGEM_AXIS_THUMB_LY].Deadzone = 1000;
+
+	CHECK_EQUAL(STATUS_SUCCESS, transform.Load(profiles));
+
+	LONG previous = 0;
+
+	for (LONG value = 0; value <= VIGEM_AXIS_MAX; value++)
+	{
+		const LONG result = TransformOne(transform, VIGEM_AXIS_THUMB_LY, value);
+
+		CHECK(result >= previous);
+		CHECK(result <= 20000);
+		CHECK_EQUAL(-result, TransformOne(transform, VIGEM_AXIS_THUMB_LY, -value));
+
+		previous = result;
+	}
+
+	CHECK_EQUAL(20000, previous);
+}
+
+TEST(CurvePointsAreFollowed)
+{
+	VIGEM_AXIS_PROFILE profiles[VIGEM_AXIS_COUNT];
+	AxisTransform transform;
+
+	InitPassThrough(profiles);
+
+	for (ULONG point = 0; point < VIGEM_AXIS_CURVE_POINTS; point++)
+	{
+		profiles[VIGEM_AXIS_TRIGGER_L].Curve[point] = static_cast<USHORT>(point * point * 127);
+	}
+
+	CHECK_EQUAL(STATUS_SUCCESS, transform.Load(profiles));
+
+	//
+	// Input 2048 * n maps onto curve point n, the scale is rounded up so it may
+	// overshoot by a fraction of the following segment
+	// 
+	for (ULONG point = 0; point < VIGEM_AXIS_CURVE_POINTS - 1; point++)
+	{
+		const LONG expected = profiles[VIGEM_AXIS_TRIGGER_L].Curve[point];
+		const LONG result = TransformOne(transform, VIGEM_AXIS_TRIGGER_L, static_cast<LONG>(2048 * point));
+
+		CHECK(result >= expected && result <= expected + 2);
+	}
+
+	CHECK_EQUAL(static_cast<LONG>(profiles[VIGEM_AXIS_TRIGGER_L].Curve[VIGEM_AXIS_CURVE_POINTS - 1]),
+	            TransformOne(transform, VIGEM_AXIS_TRIGGER_L, VIGEM_AXIS_MAX));
+}
+
+TEST(RemapAndInvertReadOriginalValues)
+{
+	VIGEM_AXIS_PROFILE profiles[VIGEM_AXIS_COUNT];
+	AxisTransform transform;
+
+	InitPassThrough(profiles);
+
+	// Swap the left stick axes, invert the new Y
+	profiles[VIGEM_AXIS_THUMB_LX].Source = VIGEM_AXIS_THUMB_LY;
+	profiles[VIGEM_AXIS_THUMB_LY].Source = VIGEM_AXIS_THUMB_LX;
+	profiles[VIGEM_AXIS_THUMB_LY].Flags = VIGEM_AXIS_FLAG_INVERT;
+
+	CHECK_EQUAL(STATUS_SUCCESS, transform.Load(profiles));
+
+	LONG axes[VIGEM_AXIS_COUNT] = { VIGEM_AXIS_MAX, -VIGEM_AXIS_MAX, 0, 0, 0, 0 };
+
+	transform.Apply(axes);
+
+	CHECK_EQUAL(-VIGEM_AXIS_MAX, axes[VIGEM_AXIS_THUMB_LX]);
+	CHECK_EQUAL(-VIGEM_AXIS_MAX, axes[VIGEM_AXIS_THUMB_LY]);
+}
+
+TEST(InvalidProfilesLeaveTablesUntouched)
+{
+	VIGEM_AXIS_PROFILE profiles[VIGEM_AXIS_COUNT];
+	VIGEM_AXIS_PROFILE invalid[VIGEM_AXIS_COUNT];
+	AxisTransform transform;
+
+	InitPassThrough(profiles);
+	profiles[VIGEM_AXIS_THUMB_LX].Flags = VIGEM_AXIS_FLAG_INVERT;
+	CHECK_EQUAL(STATUS_SUCCESS, transform.Load(profiles));
+
+	InitPassThrough(invalid);
+	invalid[VIGEM_AXIS_TRIGGER_R].Source = VIGEM_AXIS_COUNT;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, transform.Load(invalid));
+
+	InitPassThrough(invalid);
+	invalid[VIGEM_AXIS_TRIGGER_R].Flags = 0x80;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, transform.Load(invalid));
+
+	InitPassThrough(invalid);
+	invalid[VIGEM_AXIS_TRIGGER_R].Deadzone = VIGEM_AXIS_MAX;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, transform.Load(invalid));
+
+	InitPassThrough(invalid);
+	invalid[VIGEM_AXIS_TRIGGER_R].Curve[5] = invalid[VIGEM_AXIS_TRIGGER_R].Curve[4] - 1;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, transform.Load(invalid));
+
+	InitPassThrough(invalid);
+	invalid[VIGEM_AXIS_TRIGGER_R].Curve[VIGEM_AXIS_CURVE_POINTS - 1] = VIGEM_AXIS_MAX + 1;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, transform.Load(invalid));
+
+	// Still the inverting profile loaded first
+	CHECK(transform.IsEnabled());
+	CHECK_EQUAL(-VIGEM_AXIS_MAX, TransformOne(transform, VIGEM_AXIS_THUMB_LX, VIGEM_AXIS_MAX));
+
+	transform.Reset();
+	CHECK(!transform.IsEnabled());
+}
+
+TEST(XusbReportRoundTrip)
+{
+	for (ULONG value = 0; value <= 0xFF; value++)
+	{
+		XUSB_REPORT report = {};
+		XUSB_REPORT result = {};
+		LONG axes[VIGEM_AXIS_COUNT];
+
+		report.bLeftTrigger = static_cast<BYTE>(value);
+		report.bRightTrigger = static_cast<BYTE>(0xFF - value);
+		report.sThumbLX = static_cast<SHORT>(value * 0x100 - 0x8000);
+		report.sThumbRY = static_cast<SHORT>(0x7FFF - value * 0x80);
+
+		AxisTransform::FromXusbReport(&report, axes);
+		AxisTransform::ToXusbReport(axes, &result);
+
+		CHECK_EQUAL(report.bLeftTrigger, result.bLeftTrigger);
+		CHECK_EQUAL(report.bRightTrigger, result.bRightTrigger);
+		CHECK_EQUAL(report.sThumbLX, result.sThumbLX);
+		CHECK_EQUAL(report.sThumbRY, result.sThumbRY);
+	}
+
+	LONG axes[VIGEM_AXIS_COUNT];
+	XUSB_REPORT report = {};
+
+	report.bLeftTrigger = 0xFF;
+	AxisTransform::FromXusbReport(&report, axes);
+	CHECK_EQUAL(VIGEM_AXIS_MAX, axes[VIGEM_AXIS_TRIGGER_L]);
+}
+
+TEST(Ds4ReportRoundTrip)
+{
+	for (ULONG value = 0; value <= 0xFF; value++)
+	{
+		DS4_REPORT report = {};
+		DS4_REPORT result = {};
+		LONG axes[VIGEM_AXIS_COUNT];
+
+		report.bThumbLX = static_cast<BYTE>(value);
+		report.bThumbLY = static_cast<BYTE>(0xFF - value);
+		report.bThumbRX = static_cast<BYTE>(value ^ 0x55);
+		report.bThumbRY = static_cast<BYTE>(value ^ 0xAA);
+		report.bTriggerL = static_cast<BYTE>(value);
+		report.bTriggerR = static_cast<BYTE>(0xFF - value);
+
+		AxisTransform::FromDs4Report(&report, axes);
+		AxisTransform::ToDs4Report(axes, &result);
+
+		CHECK(memcmp(&report, &result, sizeof(DS4_REPORT)) == 0);
+	}
+}
@@ -0,0 +1,588 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MockBus.hpp"
+#include "Test.hpp"
+
+#include <Internal.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+using ViGEm::Tests::GetOpenHandles;
+using ViGEm::Tests::ScopedMockBus;
+using ViGEm::Tests::WaitOpenHandles;
+
+//
+// Client connected to whatever mock buses are present
+// 
+static PVIGEM_CLIENT Connect()
+{
+	const auto client = vigem_alloc();
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+
+	return client;
+}
+
+static void Disconnect(PVIGEM_CLIENT Client)
+{
+	vigem_disconnect(Client);
+	vigem_free(Client);
+}
+
+//
+// Runs Function on Threads threads released at the same time
+// 
+template <typename F>
+static void RunConcurrently(ULONG Threads, F Function)
+{
+	std::atomic<bool> go{ false };
+	std::vector<std::thread> threads;
+
+	for (ULONG index = 0; index < Threads; index++)
+	{
+		threads.emplace_back([&go, &Function, index]
+		{
+			while (!go.load())
+				std::this_thread::yield();
+
+			Function(index);
+		});
+	}
+
+	go.store(true);
+
+	for (auto& thread : threads)
+		thread.join();
+}
+
+TEST(ConcurrentAddsPlugInOnce)
+{
+	ScopedMockBus bus;
+	const auto client = Connect();
+
+	for (int round = 0; round < 50; round++)
+	{
+		const auto target = vigem_target_x360_alloc();
+		std::vector<VIGEM_ERROR> errors(8);
+
+		RunConcurrently(8, [&](ULONG Index)
+		{
+			errors[Index] = vigem_target_add(client, target);
+		});
+
+		ULONG added = 0;
+
+		for (const auto error : errors)
+		{
+			if (error == VIGEM_ERROR_NONE)
+				added++;
+			else
+				CHECK_EQUAL(VIGEM_ERROR_ALREADY_CONNECTED, error);
+		}
+
+		CHECK_EQUAL(1UL, added);
+		CHECK_EQUAL(1UL, bus->GetTargetCount());
+		CHECK_EQUAL(1L, client->BusTargets[0]);
+
+		CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_remove(client, target));
+		vigem_target_free(target);
+	}
+
+	Disconnect(client);
+}
+
+TEST(ConcurrentRemovesUnplugOnce)
+{
+	ScopedMockBus bus;
+	const auto client = Connect();
+
+	for (int round = 0; round < 50; round++)
+	{
+		const auto target = vigem_target_ds4_alloc();
+		std::vector<VIGEM_ERROR> errors(8);
+
+		CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, target));
+
+		RunConcurrently(8, [&](ULONG Index)
+		{
+			errors[Index] = vigem_target_remove(client, target);
+		});
+
+		ULONG removed = 0;
+
+		for (const auto error : errors)
+		{
+			if (error == VIGEM_ERROR_NONE)
+				removed++;
+			else
+				CHECK_EQUAL(VIGEM_ERROR_TARGET_NOT_PLUGGED_IN, error);
+		}
+
+		CHECK_EQUAL(1UL, removed);
+		CHECK_EQUAL(0UL, bus->GetTargetCount());
+		CHECK_EQUAL(0L, client->BusTargets[0]);
+		CHECK(!vigem_target_is_attached(target));
+
+		vigem_target_free(target);
+	}
+
+	Disconnect(client);
+}
+
+TEST(AddRemoveStressKeepsStateConsistent)
+{
+	const ULONG threads = 8;
+	const ULONG targetCount = 4;
+	const ULONG iterations = 2000;
+
+	ScopedMockBus bus;
+	const auto client = Connect();
+	PVIGEM_TARGET targets[targetCount];
+	std::vector<LONG> balance(threads);
+
+	for (auto& target : targets)
+		target = vigem_target_x360_alloc();
+
+	//
+	// Every thread adds and removes all targets in its own order, whatever
+	// succeeds has to add up
+	// 
+	RunConcurrently(threads, [&](ULONG Index)
+	{
+		for (ULONG iteration = 0; iteration < iterations; iteration++)
+		{
+			const auto target = targets[(Index + iteration) % targetCount];
+
+			if ((iteration + Index) % 3 != 2)
+			{
+				if (vigem_target_add(client, target) == VIGEM_ERROR_NONE)
+					balance[Index]++;
+			}
+			else if (vigem_target_remove(client, target) == VIGEM_ERROR_NONE)
+				balance[Index]--;
+		}
+	});
+
+	LONG plugged = 0;
+	ULONG attached = 0;
+
+	for (const auto count : balance)
+		plugged += count;
+
+	for (const auto target : targets)
+	{
+		const auto state = VIGEM_TARGET_GET_STATE(target);
+
+		CHECK(state == VIGEM_TARGET_CONNECTED || state == VIGEM_TARGET_DISCONNECTED || state == VIGEM_TARGET_INITIALIZED);
+
+		if (vigem_target_is_attached(target))
+			attached++;
+	}
+
+	CHECK_EQUAL(static_cast<LONG>(attached), plugged);
+	CHECK_EQUAL(attached, bus->GetTargetCount());
+	CHECK_EQUAL(plugged, client->BusTargets[0]);
+
+	for (const auto target : targets)
+	{
+		vigem_target_remove(client, target);
+		vigem_target_free(target);
+	}
+
+	CHECK_EQUAL(0UL, bus->GetTargetCount());
+
+	Disconnect(client);
+}
+
+static std::atomic<ULONG> g_Notifications;
+
+static VOID CALLBACK CountNotification(
+	PVIGEM_CLIENT Client,
+	PVIGEM_TARGET Target,
+	UCHAR LargeMotor,
+	UCHAR SmallMotor,
+	UCHAR LedNumber,
+	LPVOID UserData
+)
+{
+	(void)Client;
+	(void)Target;
+	(void)SmallMotor;
+	(void)LedNumber;
+
+	//
+	// The user data always belongs to the callback it got registered with
+	// 
+	if (UserData == &g_Notifications && LargeMotor == 0x80)
+		g_Notifications++;
+}
+
+TEST(NotificationRegistrationDuringDelivery)
+{
+	ScopedMockBus bus;
+	const auto handles = GetOpenHandles();
+	const auto client = Connect();
+	const auto target = vigem_target_x360_alloc();
+	std::atomic<bool> done{ false };
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, target));
+
+	g_Notifications = 0;
+
+	//
+	// One thread keeps registering and unregistering while the bus keeps
+	// completing vibration requests
+	// 
+	std::thread registrar([&]
+	{
+		for (int iteration = 0; iteration < 500; iteration++)
+		{
+			vigem_target_x360_register_notification(client, target, CountNotification, &g_Notifications);
+			std::this_thread::yield();
+			vigem_target_x360_unregister_notification(target);
+		}
+
+		vigem_target_x360_register_notification(client, target, CountNotification, &g_Notifications);
+		done.store(true);
+	});
+
+	while (!done.load())
+		bus->Notify(target->SerialNo, 0x80, 0x40, 1);
+
+	registrar.join();
+
+	//
+	// The last registration stays and gets its notification
+	// 
+	while (bus->GetPendingNotifications(target->SerialNo) == 0)
+		std::this_thread::yield();
+
+	const auto before = g_Notifications.load();
+
+	bus->Notify(target->SerialNo, 0x80, 0x40, 1);
+
+	while (g_Notifications.load() == before)
+		std::this_thread::yield();
+
+	vigem_target_x360_unregister_notification(target);
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_remove(client, target));
+	Disconnect(client);
+
+	//
+	// Removal cancels what the notification threads wait for, they all end
+	// 
+	CHECK(WaitOpenHandles(handles, 5000));
+
+	vigem_target_free(target);
+}
+
+static std::mutex g_CallbackLock;
+static std::condition_variable g_CallbackSignal;
+static bool g_CallbackEntered;
+static bool g_CallbackReleased;
+
+static VOID CALLBACK BlockingNotification(
+	PVIGEM_CLIENT Client,
+	PVIGEM_TARGET Target,
+	UCHAR LargeMotor,
+	UCHAR SmallMotor,
+	UCHAR LedNumber,
+	LPVOID UserData
+)
+{
+	(void)Client;
+	(void)Target;
+	(void)LargeMotor;
+	(void)SmallMotor;
+	(void)LedNumber;
+	(void)UserData;
+
+	std::unique_lock<std::mutex> lock(g_CallbackLock);
+
+	g_CallbackEntered = true;
+	g_CallbackSignal.notify_all();
+	g_CallbackSignal.wait(lock, [] { return g_CallbackReleased; });
+}
+
+TEST(NotificationThreadEndsWhenTargetRemovedDuringCallback)
+{
+	ScopedMockBus bus;
+	const auto handles = GetOpenHandles();
+	const auto client = Connect();
+	const auto target = vigem_target_x360_alloc();
+
+	g_CallbackEntered = false;
+	g_CallbackReleased = false;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, target));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_x360_register_notification(client, target, BlockingNotification, nullptr));
+
+	while (bus->GetPendingNotifications(target->SerialNo) == 0)
+		std::this_thread::yield();
+
+	bus->Notify(target->SerialNo, 1, 2, 3);
+
+	{
+		std::unique_lock<std::mutex> lock(g_CallbackLock);
+		g_CallbackSignal.wait(lock, [] { return g_CallbackEntered; });
+	}
+
+	//
+	// The next request of the thread finds the target gone rather than
+	// getting cancelled by the removal
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_remove(client, target));
+
+	{
+		std::lock_guard<std::mutex> lock(g_CallbackLock);
+		g_CallbackReleased = true;
+		g_CallbackSignal.notify_all();
+	}
+
+	CHECK(WaitOpenHandles(handles + 2, 5000));
+
+	vigem_target_x360_unregister_notification(target);
+	Disconnect(client);
+
+	CHECK(WaitOpenHandles(handles, 5000));
+
+	vigem_target_free(target);
+}
+
+TEST(DisconnectEndsNotificationThreads)
+{
+	ScopedMockBus bus;
+	const auto handles = GetOpenHandles();
+	const auto client = Connect();
+	const ULONG targetCount = 16;
+	PVIGEM_TARGET targets[targetCount];
+
+	for (auto& target : targets)
+	{
+		target = vigem_target_ds4_alloc();
+
+		CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, target));
+	}
+
+	RunConcurrently(targetCount, [&](ULONG Index)
+	{
+		vigem_target_ds4_register_notification(
+			client,
+			targets[Index],
+			[](PVIGEM_CLIENT, PVIGEM_TARGET, UCHAR, UCHAR, DS4_LIGHTBAR_COLOR, LPVOID) {},
+			nullptr
+		);
+	});
+
+	for (const auto target : targets)
+	{
+		while (bus->GetPendingNotifications(target->SerialNo) == 0)
+			std::this_thread::yield();
+	}
+
+	//
+	// Closing the bus handle removes the targets of the session
+	// 
+	Disconnect(client);
+
+	CHECK_EQUAL(0UL, bus->GetTargetCount());
+
+	for (const auto target : targets)
+		vigem_target_x360_unregister_notification(target);
+
+	CHECK(WaitOpenHandles(handles, 5000));
+
+	for (const auto target : targets)
+		vigem_target_free(target);
+}
+
+static std::vector<ULONG> g_UserIndexes;
+
+static VOID CALLBACK RecordUserIndex(
+	PVIGEM_CLIENT Client,
+	PVIGEM_TARGET Target,
+	ULONG UserIndex,
+	LPVOID UserData
+)
+{
+	(void)Client;
+	(void)Target;
+	(void)UserData;
+
+	std::lock_guard<std::mutex> lock(g_CallbackLock);
+
+	g_UserIndexes.push_back(UserIndex);
+	g_CallbackSignal.notify_all();
+}
+
+static std::vector<ULONG> WaitUserIndexes(size_t Count)
+{
+	std::unique_lock<std::mutex> lock(g_CallbackLock);
+
+	g_CallbackSignal.wait_for(lock, std::chrono::seconds(5), [Count] { return g_UserIndexes.size() >= Count; });
+
+	return g_UserIndexes;
+}
+
+TEST(UserIndexNotificationFollowsLed)
+{
+	ScopedMockBus bus;
+	const auto handles = GetOpenHandles();
+	const auto client = Connect();
+	const auto target = vigem_target_x360_alloc();
+	ULONG index = 0;
+
+	g_UserIndexes.clear();
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, target));
+
+	//
+	// No index before the host lit a quadrant
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_XUSB_USERINDEX_OUT_OF_RANGE, vigem_target_x360_get_user_index(client, target, &index));
+
+	const auto connected = GetOpenHandles();
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_x360_register_user_index_notification(client, target, RecordUserIndex, nullptr));
+
+	while (bus->GetPendingUserIndexWaits(target->SerialNo) == 0)
+		std::this_thread::yield();
+
+	CHECK(bus->SetUserIndex(target->SerialNo, 1));
+	CHECK(WaitUserIndexes(1) == std::vector<ULONG>({ 1 }));
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_x360_get_user_index(client, target, &index));
+	CHECK_EQUAL(1UL, index);
+
+	//
+	// Blinking and the same quadrant again wake nobody
+	// 
+	while (bus->GetPendingUserIndexWaits(target->SerialNo) == 0)
+		std::this_thread::yield();
+
+	CHECK(!bus->SetLed(target->SerialNo, 0x0A));
+	CHECK(!bus->SetUserIndex(target->SerialNo, 1));
+	CHECK_EQUAL(1UL, bus->GetPendingUserIndexWaits(target->SerialNo));
+
+	CHECK(bus->SetUserIndex(target->SerialNo, 3));
+	CHECK(WaitUserIndexes(2) == std::vector<ULONG>({ 1, 3 }));
+
+	//
+	// Removal cancels the pending wait, the thread ends
+	// 
+	while (bus->GetPendingUserIndexWaits(target->SerialNo) == 0)
+		std::this_thread::yield();
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_remove(client, target));
+	CHECK(WaitOpenHandles(connected, 5000));
+
+	vigem_target_x360_unregister_user_index_notification(target);
+	Disconnect(client);
+
+	CHECK(WaitOpenHandles(handles, 5000));
+
+	vigem_target_free(target);
+}
+
+static VOID CALLBACK BlockingUserIndex(
+	PVIGEM_CLIENT Client,
+	PVIGEM_TARGET Target,
+	ULONG UserIndex,
+	LPVOID UserData
+)
+{
+	(void)Client;
+	(void)Target;
+	(void)UserIndex;
+	(void)UserData;
+
+	std::unique_lock<std::mutex> lock(g_CallbackLock);
+
+	g_CallbackEntered = true;
+	g_CallbackSignal.notify_all();
+	g_CallbackSignal.wait(lock, [] { return g_CallbackReleased; });
+}
+
+TEST(UserIndexThreadOutlivesFreedTarget)
+{
+	ScopedMockBus bus;
+	const auto handles = GetOpenHandles();
+	const auto client = Connect();
+	const auto target = vigem_target_x360_alloc();
+
+	g_CallbackEntered = false;
+	g_CallbackReleased = false;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, target));
+
+	const auto connected = GetOpenHandles();
+	const ULONG serialNo = target->SerialNo;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_x360_register_user_index_notification(client, target, BlockingUserIndex, nullptr));
+
+	while (bus->GetPendingUserIndexWaits(serialNo) == 0)
+		std::this_thread::yield();
+
+	bus->SetUserIndex(serialNo, 0);
+
+	{
+		std::unique_lock<std::mutex> lock(g_CallbackLock);
+		g_CallbackSignal.wait(lock, [] { return g_CallbackEntered; });
+	}
+
+	//
+	// The target is gone for good while the callback runs, the next wait
+	// of the thread must not read it
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_remove(client, target));
+	vigem_target_free(target);
+
+	{
+		std::lock_guard<std::mutex> lock(g_CallbackLock);
+		g_CallbackReleased = true;
+		g_CallbackSignal.notify_all();
+	}
+
+	CHECK(WaitOpenHandles(connected, 5000));
+
+	Disconnect(client);
+
+	CHECK(WaitOpenHandles(handles, 5000));
+}
@@ -0,0 +1,300 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MockBus.hpp"
+#include "Test.hpp"
+
+#include <ViGEm/Client.hpp>
+
+#include <cstring>
+#include <utility>
+
+using ViGEm::Tests::GetOpenHandles;
+using ViGEm::Tests::ScopedMockBus;
+
+
+//
+// Report the mock bus received last, as the submit structure T
+// 
+template <typename T>
+static T LastSubmit(ScopedMockBus& Bus, ULONG SerialNo)
+{
+	T submit{};
+	const std::vector<UCHAR> report = Bus->GetLastReport(SerialNo);
+
+	CHECK_EQUAL(sizeof(T), report.size());
+
+	if (report.size() == sizeof(T))
+		memcpy(&submit, report.data(), sizeof(T));
+
+	return submit;
+}
+
+TEST(ClientConnectsAndDisconnectsOnDestruction)
+{
+	ScopedMockBus bus;
+	const SIZE_T handles = GetOpenHandles();
+
+	{
+		vigem::Client client;
+
+		CHECK(static_cast<bool>(client));
+		CHECK_EQUAL(VIGEM_ERROR_NONE, client.connect());
+		CHECK(GetOpenHandles() > handles);
+	}
+
+	CHECK_EQUAL(handles, GetOpenHandles());
+}
+
+TEST(ClientMoveTransfersConnection)
+{
+	ScopedMockBus bus;
+	vigem::Client first;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, first.connect());
+
+	const PVIGEM_CLIENT connection = first.get();
+	vigem::Client second(std::move(first));
+
+	CHECK(!first);
+	CHECK(second.get() == connection);
+	CHECK_EQUAL(VIGEM_ERROR_BUS_INVALID_HANDLE, first.connect());
+
+	vigem::Client third;
+
+	third = std::move(second);
+
+	CHECK(!second);
+	CHECK(third.get() == connection);
+}
+
+TEST(TargetRemovedAndFreedOnDestruction)
+{
+	ScopedMockBus bus;
+	vigem::Client client;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, client.connect());
+
+	{
+		vigem::X360Target pad;
+		vigem::Ds4Target ds4;
+
+		CHECK_EQUAL(VIGEM_ERROR_NONE, pad.add(client));
+		CHECK_EQUAL(VIGEM_ERROR_NONE, ds4.add(client));
+		CHECK(pad.attached());
+		CHECK(pad.index() != 0);
+		CHECK(ds4.index() != pad.index());
+		CHECK_EQUAL(2UL, bus->GetTargetCount());
+	}
+
+	CHECK_EQUAL(0UL, bus->GetTargetCount());
+}
+
+TEST(SubmitNeedsPlugIn)
+{
+	ScopedMockBus bus;
+	vigem::Client client;
+	vigem::X360Target pad;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, client.connect());
+	CHECK_EQUAL(VIGEM_ERROR_TARGET_NOT_PLUGGED_IN, pad.submit());
+	CHECK_EQUAL(VIGEM_ERROR_TARGET_NOT_PLUGGED_IN, pad.remove());
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.add(client));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.remove());
+	CHECK_EQUAL(VIGEM_ERROR_TARGET_NOT_PLUGGED_IN, pad.submit());
+	CHECK_EQUAL(0UL, bus->GetRequests(IOCTL_XUSB_SUBMIT_REPORT));
+}
+
+TEST(X360ReportIsBuiltInPlace)
+{
+	ScopedMockBus bus;
+	vigem::Client client;
+	vigem::X360Target pad;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, client.connect());
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.add(client));
+
+	pad.report()
+	   .press(XUSB_GAMEPAD_A)
+	   .press(XUSB_GAMEPAD_START)
+	   .release(XUSB_GAMEPAD_A)
+	   .triggers(10, 200)
+	   .left_thumb(-1000, 1000)
+	   .right_thumb(32767, -32768);
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.submit());
+
+	const auto submit = LastSubmit<XUSB_SUBMIT_REPORT>(bus, pad.index());
+
+	CHECK_EQUAL(static_cast<ULONG>(sizeof(XUSB_SUBMIT_REPORT)), submit.Size);
+	CHECK_EQUAL(pad.index(), submit.SerialNo);
+	CHECK_EQUAL(static_cast<USHORT>(XUSB_GAMEPAD_START), submit.Report.wButtons);
+	CHECK_EQUAL(10, submit.Report.bLeftTrigger);
+	CHECK_EQUAL(200, submit.Report.bRightTrigger);
+	CHECK_EQUAL(-1000, submit.Report.sThumbLX);
+	CHECK_EQUAL(1000, submit.Report.sThumbLY);
+	CHECK_EQUAL(32767, submit.Report.sThumbRX);
+	CHECK_EQUAL(-32768, submit.Report.sThumbRY);
+
+	//
+	// The next report starts from the last one
+	// 
+	pad.report().buttons(XUSB_GAMEPAD_B);
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.submit());
+	CHECK_EQUAL(static_cast<USHORT>(XUSB_GAMEPAD_B), LastSubmit<XUSB_SUBMIT_REPORT>(bus, pad.index()).Report.wButtons);
+	CHECK_EQUAL(200, LastSubmit<XUSB_SUBMIT_REPORT>(bus, pad.index()).Report.bRightTrigger);
+
+	pad.report().clear();
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.submit());
+	CHECK_EQUAL(0, LastSubmit<XUSB_SUBMIT_REPORT>(bus, pad.index()).Report.bRightTrigger);
+	CHECK_EQUAL(3UL, bus->GetReports(pad.index()));
+}
+
+TEST(Ds4ReportStartsNeutralAndKeepsDpadApart)
+{
+	ScopedMockBus bus;
+	vigem::Client client;
+	vigem::Ds4Target pad;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, client.connect());
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.add(client));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.submit());
+
+	auto submit = LastSubmit<DS4_SUBMIT_REPORT_EX>(bus, pad.index());
+
+	CHECK_EQUAL(static_cast<ULONG>(sizeof(DS4_SUBMIT_REPORT_EX)), submit.Size);
+	CHECK_EQUAL(0x80, submit.Report.Report.bThumbLX);
+	CHECK_EQUAL(0x80, submit.Report.Report.bThumbRY);
+	CHECK_EQUAL(static_cast<USHORT>(DS4_BUTTON_DPAD_NONE), submit.Report.Report.wButtons);
+
+	pad.report()
+	   .dpad(DS4_BUTTON_DPAD_SOUTH)
+	   .buttons(DS4_BUTTON_CROSS | DS4_BUTTON_DPAD_WEST)
+	   .press(DS4_BUTTON_CIRCLE)
+	   .special(DS4_SPECIAL_BUTTON_PS)
+	   .triggers(1, 2)
+	   .gyro(1, 2, 3)
+	   .accel(-1, -2, -3);
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.submit());
+
+	submit = LastSubmit<DS4_SUBMIT_REPORT_EX>(bus, pad.index());
+
+	CHECK_EQUAL(static_cast<USHORT>(DS4_BUTTON_CROSS | DS4_BUTTON_CIRCLE | DS4_BUTTON_DPAD_SOUTH),
+	            submit.Report.Report.wButtons);
+	CHECK_EQUAL(static_cast<BYTE>(DS4_SPECIAL_BUTTON_PS), submit.Report.Report.bSpecial);
+	CHECK_EQUAL(2, submit.Report.Report.bTriggerR);
+	CHECK_EQUAL(3, submit.Report.Report.wGyroZ);
+	CHECK_EQUAL(-3, submit.Report.Report.wAccelZ);
+}
+
+TEST(MovedTargetKeepsPlugInAndReport)
+{
+	ScopedMockBus bus;
+	vigem::Client client;
+	vigem::X360Target first;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, client.connect());
+	CHECK_EQUAL(VIGEM_ERROR_NONE, first.add(client));
+
+	const ULONG serial = first.index();
+
+	first.report().triggers(7, 7);
+
+	vigem::X360Target second(std::move(first));
+
+	CHECK(!first);
+	CHECK_EQUAL(0UL, first.index());
+	CHECK_EQUAL(VIGEM_ERROR_TARGET_NOT_PLUGGED_IN, first.submit());
+	CHECK_EQUAL(serial, second.index());
+	CHECK_EQUAL(VIGEM_ERROR_NONE, second.submit());
+	CHECK_EQUAL(7, LastSubmit<XUSB_SUBMIT_REPORT>(bus, serial).Report.bLeftTrigger);
+
+	//
+	// Assigning over a plugged in target removes that one
+	// 
+	vigem::X360Target third;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, third.add(client));
+	CHECK_EQUAL(2UL, bus->GetTargetCount());
+
+	third = std::move(second);
+
+	CHECK_EQUAL(1UL, bus->GetTargetCount());
+	CHECK_EQUAL(serial, third.index());
+}
+
+TEST(SubmitAllStopsAtFirstFailure)
+{
+	ScopedMockBus bus;
+	vigem::Client client;
+	vigem::X360Target first;
+	vigem::Ds4Target unplugged;
+	vigem::X360Target last;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, client.connect());
+	CHECK_EQUAL(VIGEM_ERROR_NONE, first.add(client));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, last.add(client));
+
+	vigem::Target* const targets[] = { &first, &unplugged, &last };
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem::submit_all(targets, 1));
+	CHECK_EQUAL(VIGEM_ERROR_TARGET_NOT_PLUGGED_IN, vigem::submit_all(targets, 3));
+	CHECK_EQUAL(2UL, bus->GetReports(first.index()));
+	CHECK_EQUAL(0UL, bus->GetReports(last.index()));
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, unplugged.add(client));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem::submit_all(targets, 3));
+	CHECK_EQUAL(1UL, bus->GetReports(last.index()));
+}
+
+TEST(Ds4FullReportNeedsDriverSupport)
+{
+	ScopedMockBus bus(ViGEm::Tests::MockLegacyDriver());
+	vigem::Client client;
+	vigem::Ds4Target pad;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, client.connect());
+	CHECK_EQUAL(VIGEM_ERROR_NONE, pad.add(client));
+	//
+	// Without capabilities the request gets tried, the driver turns down the size
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NOT_SUPPORTED, pad.submit());
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_DS4_SUBMIT_REPORT));
+	CHECK_EQUAL(0UL, bus->GetReports(pad.index()));
+}
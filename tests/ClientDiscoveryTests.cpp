@@ -0,0 +1,256 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MockBus.hpp"
+#include "MockDiscovery.hpp"
+#include "Test.hpp"
+
+#include <Internal.h>
+
+#include <memory>
+#include <vector>
+
+using ViGEm::Tests::MOCK_BUS_DRIVER;
+using ViGEm::Tests::MockCurrentDriver;
+using ViGEm::Tests::ScopedMockBus;
+using ViGEm::Tests::ScopedMockDiscovery;
+
+
+//
+// What a bus notification callback saw, and what it did about it
+// 
+typedef struct _BUS_WATCH
+{
+	std::vector<VIGEM_BUS_EVENT> Events;
+
+	//
+	// Reconnect on arrival like a watchdog would, result of the last one
+	// 
+	bool Reconnect;
+	VIGEM_ERROR Reconnected;
+
+} BUS_WATCH;
+
+static VOID CALLBACK RecordBusEvent(PVIGEM_CLIENT Client, VIGEM_BUS_EVENT Event, LPVOID UserData)
+{
+	const auto watch = static_cast<BUS_WATCH*>(UserData);
+
+	watch->Events.push_back(Event);
+
+	if (watch->Reconnect && Event == VIGEM_BUS_EVENT_ARRIVAL)
+	{
+		vigem_disconnect(Client);
+		watch->Reconnected = vigem_connect(Client);
+	}
+}
+
+TEST(ReconnectOpensCachedBus)
+{
+	ScopedMockDiscovery discovery;
+	ScopedMockBus bus;
+	const auto client = vigem_alloc();
+
+	discovery.Arrive(bus.GetPath(), false);
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+	CHECK_EQUAL(1UL, discovery.GetEnumerations());
+
+	const ULONG opens = discovery.GetOpens();
+
+	vigem_disconnect(client);
+
+	//
+	// One open, no enumeration; nobody watches, so the capabilities might
+	// have changed and get asked for again
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+	CHECK_EQUAL(1UL, discovery.GetEnumerations());
+	CHECK_EQUAL(opens + 1, discovery.GetOpens());
+	CHECK_EQUAL(2UL, bus->GetRequests(IOCTL_VIGEM_CHECK_VERSION));
+	CHECK_EQUAL(2UL, bus->GetRequests(IOCTL_VIGEM_GET_CAPABILITIES));
+
+	vigem_disconnect(client);
+	vigem_free(client);
+}
+
+TEST(WatchedReconnectReusesCapabilities)
+{
+	ScopedMockDiscovery discovery;
+	ScopedMockBus bus;
+	const auto client = vigem_alloc();
+	BUS_WATCH watch = {};
+
+	discovery.Arrive(bus.GetPath(), false);
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_register_bus_notification(client, RecordBusEvent, &watch));
+	CHECK_EQUAL(1UL, discovery.GetWatchers());
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+	vigem_disconnect(client);
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+
+	//
+	// A change would have been reported, the version check is all that's left
+	// 
+	CHECK_EQUAL(2UL, bus->GetRequests(IOCTL_VIGEM_CHECK_VERSION));
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_VIGEM_GET_CAPABILITIES));
+
+	VIGEM_BUS_CAPABILITIES capabilities;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_get_capabilities(client, &capabilities));
+	CHECK_EQUAL(MockCurrentDriver().Features, capabilities.Features);
+
+	//
+	// The watch ends with the registration, not with the connection
+	// 
+	vigem_disconnect(client);
+	CHECK_EQUAL(1UL, discovery.GetWatchers());
+
+	vigem_unregister_bus_notification(client);
+	CHECK_EQUAL(0UL, discovery.GetWatchers());
+
+	discovery.Remove(bus.GetPath());
+	CHECK(watch.Events.empty());
+
+	vigem_free(client);
+}
+
+TEST(DriverUpdateReportedAndReconnectedWithoutEnumeration)
+{
+	ScopedMockDiscovery discovery;
+	auto bus = std::make_unique<ScopedMockBus>();
+	const auto client = vigem_alloc();
+	const auto target = vigem_target_x360_alloc();
+	BUS_WATCH watch = {};
+
+	discovery.Arrive(bus->GetPath(), false);
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_register_bus_notification(client, RecordBusEvent, &watch));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, target));
+
+	const ULONG enumerations = discovery.GetEnumerations();
+
+	//
+	// The update takes the bus away and brings up a new one, with
+	// different capabilities
+	// 
+	MOCK_BUS_DRIVER updated = MockCurrentDriver();
+
+	updated.Features = VIGEM_BUS_FEATURE_ASSIGN_SERIAL | VIGEM_BUS_FEATURE_WAIT_DEVICE_READY;
+
+	const std::wstring oldPath = bus->GetPath();
+
+	bus.reset();
+	discovery.Remove(oldPath);
+
+	CHECK(watch.Events == std::vector<VIGEM_BUS_EVENT>({ VIGEM_BUS_EVENT_REMOVAL }));
+
+	ScopedMockBus updatedBus(updated);
+
+	watch.Reconnect = true;
+	watch.Reconnected = VIGEM_ERROR_BUS_NOT_FOUND;
+
+	discovery.Arrive(updatedBus.GetPath());
+
+	//
+	// The callback reconnected: straight to the reported bus, asking it
+	// for its capabilities as the cached ones were dropped
+	// 
+	CHECK(watch.Events == std::vector<VIGEM_BUS_EVENT>({ VIGEM_BUS_EVENT_REMOVAL, VIGEM_BUS_EVENT_ARRIVAL }));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, watch.Reconnected);
+	CHECK_EQUAL(enumerations, discovery.GetEnumerations());
+	CHECK_EQUAL(1UL, vigem_get_bus_count(client));
+	CHECK_EQUAL(1UL, updatedBus->GetRequests(IOCTL_VIGEM_GET_CAPABILITIES));
+
+	VIGEM_BUS_CAPABILITIES capabilities;
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_get_capabilities(client, &capabilities));
+	CHECK_EQUAL(updated.Features, capabilities.Features);
+
+	//
+	// Targets went down with the old bus, they plug into the new one
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_remove(client, target));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, target));
+	CHECK_EQUAL(1UL, updatedBus->GetTargetCount());
+
+	vigem_target_remove(client, target);
+	vigem_unregister_bus_notification(client);
+	vigem_disconnect(client);
+	vigem_free(client);
+	vigem_target_free(target);
+}
+
+TEST(UnwatchedDriverUpdateFallsBackToEnumeration)
+{
+	ScopedMockDiscovery discovery;
+	auto bus = std::make_unique<ScopedMockBus>();
+	const auto client = vigem_alloc();
+
+	discovery.Arrive(bus->GetPath(), false);
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+	vigem_disconnect(client);
+
+	const ULONG enumerations = discovery.GetEnumerations();
+	const std::wstring oldPath = bus->GetPath();
+
+	bus.reset();
+	discovery.Remove(oldPath, false);
+
+	ScopedMockBus updatedBus;
+
+	discovery.Arrive(updatedBus.GetPath(), false);
+
+	//
+	// The cached bus fails to open, the enumeration finds the new one
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+	CHECK_EQUAL(enumerations + 1, discovery.GetEnumerations());
+	CHECK_EQUAL(1UL, updatedBus->GetRequests(IOCTL_VIGEM_CHECK_VERSION));
+
+	vigem_disconnect(client);
+
+	//
+	// Without any bus, the same
+	// 
+	discovery.Remove(updatedBus.GetPath(), false);
+
+	CHECK_EQUAL(VIGEM_ERROR_BUS_NOT_FOUND, vigem_connect(client));
+	CHECK_EQUAL(enumerations + 2, discovery.GetEnumerations());
+
+	vigem_free(client);
+}
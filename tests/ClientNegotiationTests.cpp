@@ -0,0 +1,229 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MockBus.hpp"
+#include "Test.hpp"
+
+#include <Internal.h>
+
+#include <thread>
+
+using ViGEm::Tests::MOCK_BUS_DRIVER;
+using ViGEm::Tests::MockCurrentDriver;
+using ViGEm::Tests::MockLegacyDriver;
+using ViGEm::Tests::ScopedMockBus;
+
+
+static PVIGEM_CLIENT Connect()
+{
+	const auto client = vigem_alloc();
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+
+	return client;
+}
+
+static void Disconnect(PVIGEM_CLIENT Client)
+{
+	vigem_disconnect(Client);
+	vigem_free(Client);
+}
+
+static VOID CALLBACK IgnoreUserIndex(PVIGEM_CLIENT, PVIGEM_TARGET, ULONG, LPVOID)
+{
+}
+
+TEST(CurrentDriverReportsCapabilities)
+{
+	ScopedMockBus bus;
+	const auto client = Connect();
+	VIGEM_BUS_CAPABILITIES capabilities;
+
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_VIGEM_CHECK_VERSION));
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_VIGEM_GET_CAPABILITIES));
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_get_capabilities(client, &capabilities));
+	CHECK_EQUAL(static_cast<ULONG>(sizeof(VIGEM_BUS_CAPABILITIES)), capabilities.Size);
+	CHECK_EQUAL(MockCurrentDriver().Features, capabilities.Features);
+	CHECK_EQUAL(MockCurrentDriver().MaxTargets, capabilities.MaxTargets);
+
+	Disconnect(client);
+}
+
+TEST(CurrentDriverTakesAssignedSerialPath)
+{
+	ScopedMockBus bus;
+	const auto client = Connect();
+	const auto first = vigem_target_x360_alloc();
+	const auto second = vigem_target_x360_alloc();
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, first));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, second));
+
+	//
+	// One request to plug in and one to wait for each, no probing
+	// 
+	CHECK_EQUAL(2UL, bus->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET_EX));
+	CHECK_EQUAL(0UL, bus->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET));
+	CHECK_EQUAL(2UL, bus->GetRequests(IOCTL_VIGEM_WAIT_DEVICE_READY));
+	CHECK_EQUAL(1UL, first->SerialNo);
+	CHECK_EQUAL(2UL, second->SerialNo);
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_x360_register_user_index_notification(client, first, IgnoreUserIndex, nullptr));
+
+	while (bus->GetPendingUserIndexWaits(first->SerialNo) == 0)
+		std::this_thread::yield();
+
+	vigem_target_x360_unregister_user_index_notification(first);
+	vigem_target_remove(client, first);
+	vigem_target_remove(client, second);
+	Disconnect(client);
+
+	vigem_target_free(first);
+	vigem_target_free(second);
+}
+
+TEST(LegacyDriverFallsBackToProbing)
+{
+	ScopedMockBus bus(MockLegacyDriver());
+	const auto client = Connect();
+	const auto first = vigem_target_x360_alloc();
+	const auto second = vigem_target_x360_alloc();
+	VIGEM_BUS_CAPABILITIES capabilities;
+
+	//
+	// The query fails, the client keeps going without capabilities
+	// 
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_VIGEM_GET_CAPABILITIES));
+	CHECK_EQUAL(VIGEM_ERROR_NOT_SUPPORTED, vigem_get_capabilities(client, &capabilities));
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, first));
+
+	//
+	// Serial assignment and the wait get tried, fail and are taken for an
+	// old driver; plug-in falls back to serial 1
+	// 
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET_EX));
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET));
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_VIGEM_WAIT_DEVICE_READY));
+	CHECK_EQUAL(1UL, first->SerialNo);
+	CHECK(vigem_target_is_attached(first));
+
+	//
+	// The next one probes past the serial in use
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, second));
+	CHECK_EQUAL(2UL, bus->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET_EX));
+	CHECK_EQUAL(3UL, bus->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET));
+	CHECK_EQUAL(2UL, second->SerialNo);
+
+	//
+	// Without capabilities the wait is tried and fails like the driver does
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_x360_register_user_index_notification(client, first, IgnoreUserIndex, nullptr));
+
+	while (bus->GetRequests(IOCTL_XUSB_WAIT_USER_INDEX) == 0)
+		std::this_thread::yield();
+
+	CHECK_EQUAL(0UL, bus->GetPendingUserIndexWaits(first->SerialNo));
+
+	vigem_target_x360_unregister_user_index_notification(first);
+	vigem_target_remove(client, first);
+	vigem_target_remove(client, second);
+	Disconnect(client);
+
+	vigem_target_free(first);
+	vigem_target_free(second);
+}
+
+TEST(ReportedCapabilitiesSkipMissingPaths)
+{
+	MOCK_BUS_DRIVER driver = MockCurrentDriver();
+
+	//
+	// A driver between the two: it reports capabilities but lacks serial
+	// assignment, the user index wait and the extended DualShock 4 report
+	// 
+	driver.Features = VIGEM_BUS_FEATURE_WAIT_DEVICE_READY;
+
+	ScopedMockBus bus(driver);
+	const auto client = Connect();
+	const auto x360 = vigem_target_x360_alloc();
+	const auto ds4 = vigem_target_ds4_alloc();
+	DS4_REPORT_EX report = {};
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, x360));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(client, ds4));
+
+	CHECK_EQUAL(0UL, bus->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET_EX));
+	CHECK_EQUAL(3UL, bus->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET));
+	CHECK_EQUAL(2UL, bus->GetRequests(IOCTL_VIGEM_WAIT_DEVICE_READY));
+
+	//
+	// Refused by the client, the driver never sees these
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NOT_SUPPORTED,
+		vigem_target_x360_register_user_index_notification(client, x360, IgnoreUserIndex, nullptr));
+	CHECK_EQUAL(VIGEM_ERROR_NOT_SUPPORTED, vigem_target_ds4_update_ex(client, ds4, report));
+	CHECK_EQUAL(0UL, bus->GetRequests(IOCTL_XUSB_WAIT_USER_INDEX));
+	CHECK_EQUAL(0UL, bus->GetRequests(IOCTL_DS4_SUBMIT_REPORT));
+
+	vigem_target_remove(client, x360);
+	vigem_target_remove(client, ds4);
+	Disconnect(client);
+
+	vigem_target_free(x360);
+	vigem_target_free(ds4);
+}
+
+TEST(VersionMismatchRefusesBus)
+{
+	MOCK_BUS_DRIVER driver = MockCurrentDriver();
+
+	driver.Version = VIGEM_COMMON_VERSION + 1;
+
+	ScopedMockBus bus(driver);
+	const auto client = vigem_alloc();
+
+	CHECK_EQUAL(VIGEM_ERROR_BUS_VERSION_MISMATCH, vigem_connect(client));
+
+	//
+	// Nothing else is asked of a driver of another version
+	// 
+	CHECK_EQUAL(1UL, bus->GetRequests(IOCTL_VIGEM_CHECK_VERSION));
+	CHECK_EQUAL(0UL, bus->GetRequests(IOCTL_VIGEM_GET_CAPABILITIES));
+
+	vigem_free(client);
+}
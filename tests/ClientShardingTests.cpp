@@ -0,0 +1,257 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MockBus.hpp"
+#include "Test.hpp"
+
+#include <Internal.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using ViGEm::Tests::ScopedMockBus;
+
+
+//
+// Mock buses present at the same time, enumerated in order
+// 
+static std::vector<std::unique_ptr<ScopedMockBus>> CreateBuses(ULONG Count)
+{
+	std::vector<std::unique_ptr<ScopedMockBus>> buses;
+
+	for (ULONG index = 0; index < Count; index++)
+		buses.push_back(std::make_unique<ScopedMockBus>());
+
+	return buses;
+}
+
+static PVIGEM_CLIENT Connect(VIGEM_BUS_PLACEMENT Placement)
+{
+	const auto client = vigem_alloc();
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_connect(client));
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_set_bus_placement(client, Placement));
+
+	return client;
+}
+
+static std::vector<PVIGEM_TARGET> AddTargets(PVIGEM_CLIENT Client, ULONG Count)
+{
+	std::vector<PVIGEM_TARGET> targets(Count);
+
+	for (auto& target : targets)
+	{
+		target = vigem_target_x360_alloc();
+
+		CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add(Client, target));
+	}
+
+	return targets;
+}
+
+static void RemoveTargets(PVIGEM_CLIENT Client, const std::vector<PVIGEM_TARGET>& Targets)
+{
+	for (const auto target : Targets)
+	{
+		vigem_target_remove(Client, target);
+		vigem_target_free(target);
+	}
+}
+
+TEST(ConnectOpensEveryBusUpToLimit)
+{
+	auto buses = CreateBuses(3);
+	auto client = Connect(VIGEM_BUS_PLACEMENT_FIRST);
+
+	CHECK_EQUAL(3UL, vigem_get_bus_count(client));
+
+	vigem_disconnect(client);
+	vigem_free(client);
+
+	buses = CreateBuses(VIGEM_BUSES_MAX + 2);
+	client = Connect(VIGEM_BUS_PLACEMENT_FIRST);
+
+	CHECK_EQUAL(static_cast<ULONG>(VIGEM_BUSES_MAX), vigem_get_bus_count(client));
+
+	//
+	// Only the buses it opened know the client
+	// 
+	for (ULONG index = 0; index < buses.size(); index++)
+	{
+		const ULONG expected = (index < VIGEM_BUSES_MAX) ? 1 : 0;
+
+		CHECK_EQUAL(expected, (*buses[index])->GetRequests(IOCTL_VIGEM_CHECK_VERSION));
+	}
+
+	vigem_disconnect(client);
+	vigem_free(client);
+}
+
+TEST(FirstPlacementKeepsPrimaryBus)
+{
+	const auto buses = CreateBuses(4);
+	const auto client = Connect(VIGEM_BUS_PLACEMENT_FIRST);
+	const auto targets = AddTargets(client, 6);
+
+	for (const auto target : targets)
+		CHECK_EQUAL(0UL, vigem_target_get_bus_index(target));
+
+	CHECK_EQUAL(6UL, (*buses[0])->GetTargetCount());
+	CHECK_EQUAL(0UL, (*buses[1])->GetTargetCount());
+
+	RemoveTargets(client, targets);
+	vigem_disconnect(client);
+	vigem_free(client);
+}
+
+TEST(RoundRobinSpreadsAndRoutesByBusIndex)
+{
+	const ULONG shards = 4;
+	const auto buses = CreateBuses(shards);
+	const auto client = Connect(VIGEM_BUS_PLACEMENT_ROUND_ROBIN);
+	const auto targets = AddTargets(client, 3 * shards);
+
+	for (ULONG index = 0; index < targets.size(); index++)
+		CHECK_EQUAL(index % shards, vigem_target_get_bus_index(targets[index]));
+
+	for (const auto& bus : buses)
+		CHECK_EQUAL(3UL, (*bus)->GetTargetCount());
+
+	//
+	// Serials repeat across buses, only the right bus may see a report
+	// 
+	for (ULONG index = 0; index < targets.size(); index++)
+	{
+		XUSB_REPORT report{};
+
+		report.bLeftTrigger = static_cast<BYTE>(index);
+
+		CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_x360_update(client, targets[index], report));
+	}
+
+	for (const auto& bus : buses)
+		CHECK_EQUAL(3UL, (*bus)->GetRequests(IOCTL_XUSB_SUBMIT_REPORT));
+
+	for (ULONG index = 0; index < targets.size(); index++)
+	{
+		const auto& bus = *buses[vigem_target_get_bus_index(targets[index])];
+		const auto last = bus->GetLastReport(vigem_target_get_index(targets[index]));
+
+		CHECK_EQUAL(sizeof(XUSB_SUBMIT_REPORT), last.size());
+
+		if (last.size() == sizeof(XUSB_SUBMIT_REPORT))
+			CHECK_EQUAL(index, reinterpret_cast<const XUSB_SUBMIT_REPORT*>(last.data())->Report.bLeftTrigger);
+	}
+
+	//
+	// Removal goes to the bus of the target as well
+	// 
+	RemoveTargets(client, targets);
+
+	for (const auto& bus : buses)
+	{
+		CHECK_EQUAL(3UL, (*bus)->GetRequests(IOCTL_VIGEM_UNPLUG_TARGET));
+		CHECK_EQUAL(0UL, (*bus)->GetTargetCount());
+	}
+
+	vigem_disconnect(client);
+	vigem_free(client);
+}
+
+TEST(LeastLoadedRefillsEmptiedBus)
+{
+	const auto buses = CreateBuses(3);
+	const auto client = Connect(VIGEM_BUS_PLACEMENT_LEAST_LOADED);
+	auto targets = AddTargets(client, 6);
+
+	for (const auto& bus : buses)
+		CHECK_EQUAL(2UL, (*bus)->GetTargetCount());
+
+	//
+	// Empty the middle bus, the next targets fill it up again first
+	// 
+	for (const auto target : targets)
+	{
+		if (vigem_target_get_bus_index(target) == 1)
+			CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_remove(client, target));
+	}
+
+	CHECK_EQUAL(0UL, (*buses[1])->GetTargetCount());
+
+	const auto refill = AddTargets(client, 2);
+
+	for (const auto target : refill)
+		CHECK_EQUAL(1UL, vigem_target_get_bus_index(target));
+
+	targets.insert(targets.end(), refill.begin(), refill.end());
+
+	RemoveTargets(client, targets);
+	vigem_disconnect(client);
+	vigem_free(client);
+}
+
+TEST(AddToBusPinsTarget)
+{
+	const auto buses = CreateBuses(3);
+	const auto client = Connect(VIGEM_BUS_PLACEMENT_ROUND_ROBIN);
+	const auto target = vigem_target_ds4_alloc();
+
+	CHECK_EQUAL(VIGEM_ERROR_INVALID_PARAMETER, vigem_target_add_to_bus(client, target, 3));
+	CHECK_EQUAL(VIGEM_ERROR_INVALID_PARAMETER, vigem_target_add_to_bus(client, target, VIGEM_BUSES_MAX));
+	CHECK_EQUAL(0UL, (*buses[0])->GetRequests(IOCTL_VIGEM_PLUGIN_TARGET_EX));
+
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_add_to_bus(client, target, 2));
+	CHECK_EQUAL(2UL, vigem_target_get_bus_index(target));
+	CHECK_EQUAL(1UL, (*buses[2])->GetTargetCount());
+
+	//
+	// Notification requests go to the target's bus too
+	// 
+	CHECK_EQUAL(VIGEM_ERROR_NONE, vigem_target_ds4_register_notification(
+		client, target, [](PVIGEM_CLIENT, PVIGEM_TARGET, UCHAR, UCHAR, DS4_LIGHTBAR_COLOR, LPVOID) {}, nullptr));
+
+	while ((*buses[2])->GetPendingNotifications(vigem_target_get_index(target)) == 0)
+		std::this_thread::yield();
+
+	CHECK_EQUAL(0UL, (*buses[0])->GetRequests(IOCTL_DS4_REQUEST_NOTIFICATION));
+	CHECK_EQUAL(0UL, (*buses[1])->GetRequests(IOCTL_DS4_REQUEST_NOTIFICATION));
+
+	vigem_target_ds4_unregister_notification(target);
+	vigem_target_remove(client, target);
+	vigem_disconnect(client);
+	vigem_free(client);
+	vigem_target_free(target);
+}
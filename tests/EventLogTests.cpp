@@ -0,0 +1,203 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "EventLog.hpp"
+#include "EventRing.hpp"
+#include "Test.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using ViGEm::Bus::Core::EventRing;
+using namespace ViGEm::Tools;
+
+
+static const ULONGLONG FREQUENCY = 10000000;
+
+static VIGEM_EVENT_RECORD MakeEvent(ULONGLONG Timestamp, USHORT Processor, USHORT EventId)
+{
+	VIGEM_EVENT_RECORD event = {};
+
+	event.Timestamp = Timestamp;
+	event.EventId = EventId;
+	event.Processor = Processor;
+	event.SerialNo = 1;
+
+	return event;
+}
+
+static std::vector<UCHAR> MakeLog(const VIGEM_EVENT_LOG_HEADER& Header, const std::vector<VIGEM_EVENT_RECORD>& Records)
+{
+	std::vector<UCHAR> data(sizeof(Header) + Records.size() * sizeof(VIGEM_EVENT_RECORD));
+
+	memcpy(data.data(), &Header, sizeof(Header));
+
+	if (!Records.empty())
+		memcpy(data.data() + sizeof(Header), Records.data(), Records.size() * sizeof(VIGEM_EVENT_RECORD));
+
+	return data;
+}
+
+TEST(FileRoundTripMergesProcessors)
+{
+	static const char* PATH = "EventLogTests.vgt";
+
+	VIGEM_EVENT_LOG_HEADER header;
+	VIGEM_EVENT_LOG_HEADER read;
+	std::vector<VIGEM_EVENT_RECORD> records;
+	std::vector<VIGEM_EVENT_RECORD> decoded;
+
+	VIGEM_EVENT_LOG_HEADER_INIT(&header, FREQUENCY);
+	header.Dropped = 3;
+
+	//
+	// Drain order: all of processor 0, then all of processor 1
+	// 
+	for (ULONG i = 0; i < 8; i++)
+		records.push_back(MakeEvent(100 + i * 20, 0, VIGEM_EVENT_REPORT_SUBMITTED));
+	for (ULONG i = 0; i < 8; i++)
+		records.push_back(MakeEvent(110 + i * 20, 1, VIGEM_EVENT_URB_INTERRUPT));
+
+	CHECK(WriteEventLog(PATH, header, records));
+	CHECK(ReadEventLog(PATH, read, decoded));
+
+	remove(PATH);
+
+	CHECK_EQUAL(FREQUENCY, read.Frequency);
+	CHECK_EQUAL(3ULL, read.Dropped);
+	CHECK_EQUAL(records.size(), decoded.size());
+
+	for (size_t i = 0; i < decoded.size(); i++)
+	{
+		CHECK_EQUAL(100 + i * 10, decoded[i].Timestamp);
+		CHECK_EQUAL(i % 2, decoded[i].Processor);
+	}
+}
+
+TEST(ForeignAndTruncatedLogsAreRejected)
+{
+	VIGEM_EVENT_LOG_HEADER header;
+	VIGEM_EVENT_LOG_HEADER read;
+	std::vector<VIGEM_EVENT_RECORD> records(2, MakeEvent(1, 0, VIGEM_EVENT_URB_OTHER));
+	std::vector<VIGEM_EVENT_RECORD> decoded;
+
+	VIGEM_EVENT_LOG_HEADER_INIT(&header, FREQUENCY);
+
+	auto data = MakeLog(header, records);
+
+	CHECK(ParseEventLog(data.data(), data.size(), read, decoded));
+	CHECK_EQUAL(2U, decoded.size());
+	CHECK(!ParseEventLog(data.data(), data.size() - 1, read, decoded));
+	CHECK(!ParseEventLog(data.data(), sizeof(header) - 1, read, decoded));
+
+	header.RecordSize++;
+	data = MakeLog(header, records);
+	CHECK(!ParseEventLog(data.data(), data.size(), read, decoded));
+
+	header.RecordSize--;
+	header.Magic = 0x4C524756; // "VGRL", a report log
+	data = MakeLog(header, records);
+	CHECK(!ParseEventLog(data.data(), data.size(), read, decoded));
+
+	//
+	// A log without records is valid
+	// 
+	VIGEM_EVENT_LOG_HEADER_INIT(&header, FREQUENCY);
+	data = MakeLog(header, {});
+	CHECK(ParseEventLog(data.data(), data.size(), read, decoded));
+	CHECK(decoded.empty());
+}
+
+TEST(PayloadsAreDecoded)
+{
+	auto submitted = MakeEvent(1010, 2, VIGEM_EVENT_REPORT_SUBMITTED);
+
+	submitted.Payload[0] = 3;
+	submitted.Payload[1] = 12;
+	submitted.Payload[2] = 0xC0000001;
+
+	const auto line = FormatEvent(submitted, FREQUENCY, 1000);
+
+	CHECK(line.find("1.000 us") != std::string::npos);
+	CHECK(line.find("cpu 2") != std::string::npos);
+	CHECK(line.find("ReportSubmitted") != std::string::npos);
+	CHECK(line.find("session=3 size=12 status=0xC0000001") != std::string::npos);
+
+	auto led = MakeEvent(1000, 0, VIGEM_EVENT_LED_CHANGED);
+
+	led.Payload[0] = static_cast<ULONG>(-1);
+	led.Payload[1] = 2;
+
+	CHECK(FormatEvent(led, FREQUENCY, 1000).find("led=-1->2") != std::string::npos);
+
+	//
+	// Without a frequency the raw tick delta is shown
+	// 
+	CHECK(FormatEvent(led, 0, 900).find("100 ticks") != std::string::npos);
+	CHECK(FormatEvent(MakeEvent(0, 0, 0xFF), FREQUENCY, 0).find("Unknown") != std::string::npos);
+}
+
+TEST(DrainedRingsDecodeInTimeOrder)
+{
+	static const ULONG PROCESSORS = 4;
+	static const ULONG CAPACITY = 256;
+
+	std::vector<UCHAR> storage(EventRing::GetStorageSize(PROCESSORS, CAPACITY) + 64);
+	const auto address = reinterpret_cast<uintptr_t>(storage.data());
+	EventRing ring{};
+
+	ring.Initialize(reinterpret_cast<PVOID>((address + 63) & ~static_cast<uintptr_t>(63)), PROCESSORS, CAPACITY);
+
+	for (ULONG i = 0; i < 200; i++)
+		CHECK(ring.Record(i % PROCESSORS, MakeEvent(i, static_cast<USHORT>(i % PROCESSORS), VIGEM_EVENT_URB_OTHER)));
+
+	VIGEM_EVENT_LOG_HEADER header;
+	VIGEM_EVENT_LOG_HEADER read;
+	std::vector<VIGEM_EVENT_RECORD> records(CAPACITY);
+	std::vector<VIGEM_EVENT_RECORD> decoded;
+
+	VIGEM_EVENT_LOG_HEADER_INIT(&header, FREQUENCY);
+	records.resize(ring.Drain(records.data(), CAPACITY));
+
+	const auto data = MakeLog(header, records);
+
+	CHECK(ParseEventLog(data.data(), data.size(), read, decoded));
+	CHECK_EQUAL(200U, decoded.size());
+
+	for (size_t i = 0; i < decoded.size(); i++)
+		CHECK_EQUAL(i, decoded[i].Timestamp);
+}
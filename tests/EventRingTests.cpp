@@ -0,0 +1,231 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "EventRing.hpp"
+#include "Test.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using ViGEm::Bus::Core::EventRing;
+
+
+//
+// Owns the storage a ring gets handed in by the bus
+// 
+class TestRing
+{
+public:
+	TestRing(ULONG Processors, ULONG Capacity)
+		: _Storage(EventRing::GetStorageSize(Processors, Capacity) + 64)
+	{
+		//
+		// Pool allocations are cache aligned, vectors aren't
+		// 
+		const auto address = reinterpret_cast<uintptr_t>(this->_Storage.data());
+
+		this->Ring.Initialize(reinterpret_cast<PVOID>((address + 63) & ~static_cast<uintptr_t>(63)), Processors, Capacity);
+	}
+
+	EventRing Ring{};
+
+private:
+	std::vector<UCHAR> _Storage;
+};
+
+static VIGEM_EVENT_RECORD MakeEvent(ULONG Source, ULONG Sequence)
+{
+	VIGEM_EVENT_RECORD event = {};
+
+	event.SerialNo = Source;
+	event.Payload[0] = Sequence;
+
+	return event;
+}
+
+TEST(RecordsDrainInOrder)
+{
+	TestRing test(1, 8);
+	VIGEM_EVENT_RECORD events[16];
+
+	for (ULONG i = 0; i < 5; i++)
+	{
+		CHECK(test.Ring.Record(0, MakeEvent(1, i)));
+	}
+
+	CHECK_EQUAL(5UL, test.Ring.Drain(events, RTL_NUMBER_OF(events)));
+
+	for (ULONG i = 0; i < 5; i++)
+	{
+		CHECK_EQUAL(i, events[i].Payload[0]);
+	}
+
+	CHECK_EQUAL(0UL, test.Ring.Drain(events, RTL_NUMBER_OF(events)));
+	CHECK_EQUAL(0ULL, test.Ring.GetDropped());
+}
+
+TEST(FullRingDropsAndCounts)
+{
+	TestRing test(1, 4);
+	VIGEM_EVENT_RECORD events[8];
+
+	for (ULONG i = 0; i < 4; i++)
+	{
+		CHECK(test.Ring.Record(0, MakeEvent(1, i)));
+	}
+
+	CHECK(!test.Ring.Record(0, MakeEvent(1, 4)));
+	CHECK(!test.Ring.Record(0, MakeEvent(1, 5)));
+	CHECK_EQUAL(2ULL, test.Ring.GetDropped());
+
+	//
+	// Partial drains free exactly the slots taken
+	// 
+	CHECK_EQUAL(1UL, test.Ring.Drain(events, 1));
+	CHECK_EQUAL(0UL, events[0].Payload[0]);
+
+	CHECK(test.Ring.Record(0, MakeEvent(1, 6)));
+	CHECK(!test.Ring.Record(0, MakeEvent(1, 7)));
+
+	CHECK_EQUAL(4UL, test.Ring.Drain(events, RTL_NUMBER_OF(events)));
+	CHECK_EQUAL(1UL, events[0].Payload[0]);
+	CHECK_EQUAL(6UL, events[3].Payload[0]);
+	CHECK_EQUAL(3ULL, test.Ring.GetDropped());
+}
+
+TEST(ProcessorIndexWraps)
+{
+	TestRing test(2, 4);
+	VIGEM_EVENT_RECORD events[8];
+
+	CHECK(test.Ring.Record(5, MakeEvent(5, 0)));
+
+	CHECK_EQUAL(1UL, test.Ring.Drain(events, RTL_NUMBER_OF(events)));
+	CHECK_EQUAL(5UL, events[0].SerialNo);
+}
+
+TEST(DrainRotatesStartingProcessor)
+{
+	TestRing test(2, 4);
+	VIGEM_EVENT_RECORD events[8];
+
+	for (ULONG i = 0; i < 4; i++)
+	{
+		CHECK(test.Ring.Record(0, MakeEvent(0, i)));
+		CHECK(test.Ring.Record(1, MakeEvent(1, i)));
+	}
+
+	//
+	// A busy processor can't starve the others of drain budget
+	// 
+	CHECK_EQUAL(2UL, test.Ring.Drain(events, 2));
+	CHECK_EQUAL(0UL, events[0].SerialNo);
+	CHECK_EQUAL(0UL, events[1].SerialNo);
+
+	CHECK_EQUAL(2UL, test.Ring.Drain(events, 2));
+	CHECK_EQUAL(1UL, events[0].SerialNo);
+	CHECK_EQUAL(1UL, events[1].SerialNo);
+
+	CHECK_EQUAL(4UL, test.Ring.Drain(events, RTL_NUMBER_OF(events)));
+	CHECK_EQUAL(0UL, events[0].SerialNo);
+	CHECK_EQUAL(2UL, events[0].Payload[0]);
+	CHECK_EQUAL(1UL, events[2].SerialNo);
+	CHECK_EQUAL(2UL, events[2].Payload[0]);
+}
+
+TEST(ConcurrentProducersLoseNothingUncounted)
+{
+	static const ULONG PRODUCERS = 4;
+	static const ULONG EVENTS_PER_PRODUCER = 50000;
+
+	TestRing test(2, 64);
+	std::atomic<ULONG> finished{ 0 };
+	std::vector<std::thread> producers;
+	ULONG next[PRODUCERS] = {};
+	ULONG drained = 0;
+	ULONG outOfOrder = 0;
+
+	//
+	// Two producers share each ring, like threads migrated between processors
+	// 
+	for (ULONG producer = 0; producer < PRODUCERS; producer++)
+	{
+		producers.emplace_back([&test, &finished, producer]()
+		{
+			for (ULONG i = 0; i < EVENTS_PER_PRODUCER; i++)
+			{
+				test.Ring.Record(producer % 2, MakeEvent(producer, i));
+			}
+
+			finished++;
+		});
+	}
+
+	VIGEM_EVENT_RECORD events[32];
+
+	for (;;)
+	{
+		const bool last = finished.load() == PRODUCERS;
+		const ULONG count = test.Ring.Drain(events, RTL_NUMBER_OF(events));
+
+		for (ULONG i = 0; i < count; i++)
+		{
+			const ULONG producer = events[i].SerialNo;
+
+			//
+			// Dropped records leave gaps, but a producer's records never reorder
+			// 
+			if (producer >= PRODUCERS || events[i].Payload[0] < next[producer])
+				outOfOrder++;
+			else
+				next[producer] = events[i].Payload[0] + 1;
+		}
+
+		drained += count;
+
+		if (last && count == 0)
+			break;
+	}
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	CHECK_EQUAL(0UL, outOfOrder);
+	CHECK_EQUAL(static_cast<ULONGLONG>(PRODUCERS) * EVENTS_PER_PRODUCER, drained + test.Ring.GetDropped());
+}
@@ -0,0 +1,327 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "IdentityTable.hpp"
+#include "Test.hpp"
+
+#include <vector>
+
+using ViGEm::Bus::Core::IdentityTable;
+
+
+//
+// Address of a serial, distinct per serial and Seed
+// 
+static void MakeAddress(ULONG SerialNo, UCHAR Seed, UCHAR (&Address)[IdentityTable::ADDRESS_LENGTH])
+{
+	for (ULONG i = 0; i < IdentityTable::ADDRESS_LENGTH; i++)
+		Address[i] = static_cast<UCHAR>(SerialNo * 31 + i * 7 + Seed);
+}
+
+static bool HasAddress(IdentityTable& Table, ULONG SerialNo, UCHAR Seed)
+{
+	UCHAR expected[IdentityTable::ADDRESS_LENGTH];
+	UCHAR address[IdentityTable::ADDRESS_LENGTH] = {};
+
+	MakeAddress(SerialNo, Seed, expected);
+
+	return Table.Lookup(SerialNo, address) && memcmp(expected, address, sizeof(address)) == 0;
+}
+
+static std::vector<UCHAR> Serialize(IdentityTable& Table)
+{
+	std::vector<UCHAR> buffer;
+	ULONG length = 0;
+
+	CHECK_EQUAL(STATUS_BUFFER_TOO_SMALL, Table.Serialize(nullptr, 0, &length));
+
+	buffer.resize(length);
+
+	CHECK_EQUAL(STATUS_SUCCESS, Table.Serialize(buffer.data(), length, &length));
+	CHECK_EQUAL(buffer.size(), static_cast<size_t>(length));
+
+	return buffer;
+}
+
+TEST(EmptyTableFindsNothing)
+{
+	IdentityTable table{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH] = {};
+
+	table.Initialize();
+
+	CHECK_EQUAL(0UL, table.GetCount());
+	CHECK(!table.IsPending());
+	CHECK(!table.Lookup(1, address));
+
+	table.Cleanup();
+}
+
+TEST(InsertedAddressesAreFoundInAnyOrder)
+{
+	static const ULONG SERIALS[] = { 7, 1, 300, 42, 2, 65535, 3, 100 };
+
+	IdentityTable table{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+
+	table.Initialize();
+
+	for (const ULONG serial : SERIALS)
+	{
+		MakeAddress(serial, 0, address);
+		CHECK_EQUAL(STATUS_SUCCESS, table.Insert(serial, address));
+	}
+
+	CHECK_EQUAL(static_cast<ULONG>(RTL_NUMBER_OF(SERIALS)), table.GetCount());
+	CHECK(table.IsPending());
+
+	for (const ULONG serial : SERIALS)
+		CHECK(HasAddress(table, serial, 0));
+
+	CHECK(!table.Lookup(4, address));
+	CHECK(!table.Lookup(65536, address));
+
+	table.Cleanup();
+}
+
+TEST(InsertReplacesAddressOfSerial)
+{
+	IdentityTable table{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+
+	table.Initialize();
+
+	MakeAddress(5, 0, address);
+	CHECK_EQUAL(STATUS_SUCCESS, table.Insert(5, address));
+	MakeAddress(5, 1, address);
+	CHECK_EQUAL(STATUS_SUCCESS, table.Insert(5, address));
+
+	CHECK_EQUAL(1UL, table.GetCount());
+	CHECK(HasAddress(table, 5, 1));
+
+	table.Cleanup();
+}
+
+TEST(TableGrowsPastInitialCapacity)
+{
+	static const ULONG COUNT = 1000;
+
+	IdentityTable table{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+
+	table.Initialize();
+
+	//
+	// Descending, so every insert moves all entries already in
+	// 
+	for (ULONG serial = COUNT; serial > 0; serial--)
+	{
+		MakeAddress(serial, 0, address);
+		CHECK_EQUAL(STATUS_SUCCESS, table.Insert(serial, address));
+	}
+
+	CHECK_EQUAL(COUNT, table.GetCount());
+
+	for (ULONG serial = 1; serial <= COUNT; serial++)
+		CHECK(HasAddress(table, serial, 0));
+
+	table.Cleanup();
+
+	CHECK_EQUAL(0UL, table.GetCount());
+	CHECK(!table.Lookup(1, address));
+}
+
+TEST(SerializeClearsPendingAndSizesBuffer)
+{
+	IdentityTable table{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+	ULONG length = 0;
+
+	table.Initialize();
+
+	const std::vector<UCHAR> empty = Serialize(table);
+
+	MakeAddress(1, 0, address);
+	table.Insert(1, address);
+	MakeAddress(2, 0, address);
+	table.Insert(2, address);
+
+	//
+	// Too small a buffer returns the size and keeps the changes pending
+	// 
+	std::vector<UCHAR> buffer(empty.size());
+
+	CHECK_EQUAL(STATUS_BUFFER_TOO_SMALL, table.Serialize(buffer.data(), static_cast<ULONG>(buffer.size()), &length));
+	CHECK(length > empty.size());
+	CHECK(table.IsPending());
+
+	Serialize(table);
+
+	CHECK(!table.IsPending());
+
+	//
+	// A failed write puts them back
+	// 
+	table.SetPending();
+
+	CHECK(table.IsPending());
+
+	table.Cleanup();
+}
+
+TEST(SerializedTableRoundTrips)
+{
+	IdentityTable source{};
+	IdentityTable loaded{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+
+	source.Initialize();
+	loaded.Initialize();
+
+	for (ULONG serial = 1; serial <= 100; serial += 3)
+	{
+		MakeAddress(serial, 9, address);
+		source.Insert(serial, address);
+	}
+
+	const std::vector<UCHAR> buffer = Serialize(source);
+
+	CHECK_EQUAL(STATUS_SUCCESS, loaded.Deserialize(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(source.GetCount(), loaded.GetCount());
+
+	//
+	// Loading is not a change to persist
+	// 
+	CHECK(!loaded.IsPending());
+
+	for (ULONG serial = 1; serial <= 100; serial++)
+		CHECK_EQUAL(serial % 3 == 1, HasAddress(loaded, serial, 9));
+
+	CHECK(Serialize(loaded) == buffer);
+
+	source.Cleanup();
+	loaded.Cleanup();
+}
+
+TEST(DeserializeMergesIntoExistingEntries)
+{
+	IdentityTable source{};
+	IdentityTable loaded{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+
+	source.Initialize();
+	loaded.Initialize();
+
+	MakeAddress(1, 1, address);
+	source.Insert(1, address);
+	MakeAddress(2, 1, address);
+	source.Insert(2, address);
+
+	//
+	// Imported legacy identities are in before the stored table is loaded
+	// 
+	MakeAddress(2, 0, address);
+	loaded.Insert(2, address);
+	MakeAddress(3, 0, address);
+	loaded.Insert(3, address);
+
+	const std::vector<UCHAR> buffer = Serialize(source);
+
+	CHECK_EQUAL(STATUS_SUCCESS, loaded.Deserialize(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(3UL, loaded.GetCount());
+	CHECK(HasAddress(loaded, 1, 1));
+	CHECK(HasAddress(loaded, 2, 1));
+	CHECK(HasAddress(loaded, 3, 0));
+
+	source.Cleanup();
+	loaded.Cleanup();
+}
+
+TEST(DeserializeRejectsMalformedBuffers)
+{
+	IdentityTable source{};
+	IdentityTable loaded{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+
+	source.Initialize();
+	loaded.Initialize();
+
+	for (ULONG serial = 1; serial <= 4; serial++)
+	{
+		MakeAddress(serial, 0, address);
+		source.Insert(serial, address);
+	}
+
+	std::vector<UCHAR> buffer = Serialize(source);
+
+	//
+	// Shorter than the header, truncated entries, unknown version
+	// 
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, loaded.Deserialize(buffer.data(), 4));
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, loaded.Deserialize(buffer.data(), static_cast<ULONG>(buffer.size() - 1)));
+
+	buffer[0] ^= 0xFF;
+
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, loaded.Deserialize(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(0UL, loaded.GetCount());
+
+	source.Cleanup();
+	loaded.Cleanup();
+}
+
+TEST(DeserializeSkipsSerialZero)
+{
+	IdentityTable source{};
+	IdentityTable loaded{};
+	UCHAR address[IdentityTable::ADDRESS_LENGTH];
+
+	source.Initialize();
+	loaded.Initialize();
+
+	MakeAddress(0, 0, address);
+	source.Insert(0, address);
+	MakeAddress(1, 0, address);
+	source.Insert(1, address);
+
+	const std::vector<UCHAR> buffer = Serialize(source);
+
+	CHECK_EQUAL(STATUS_SUCCESS, loaded.Deserialize(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(1UL, loaded.GetCount());
+	CHECK(!loaded.Lookup(0, address));
+	CHECK(HasAddress(loaded, 1, 0));
+
+	source.Cleanup();
+	loaded.Cleanup();
+}
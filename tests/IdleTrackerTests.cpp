@@ -0,0 +1,142 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "IdleTracker.hpp"
+#include "Test.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using ViGEm::Bus::Core::IdleTracker;
+
+
+TEST(ZeroedTrackerIsActive)
+{
+	IdleTracker tracker = {};
+
+	CHECK(!tracker.IsParked());
+	CHECK(!tracker.Activity(10));
+}
+
+TEST(ParksOnlyAfterTimeout)
+{
+	IdleTracker tracker = {};
+
+	CHECK(!tracker.Activity(1000));
+
+	CHECK(!tracker.Park(1500, 1000));
+	CHECK(!tracker.IsParked());
+
+	CHECK(tracker.Park(2000, 1000));
+	CHECK(tracker.IsParked());
+
+	// Already parked
+	CHECK(!tracker.Park(5000, 1000));
+}
+
+TEST(ActivityResumesOnce)
+{
+	IdleTracker tracker = {};
+
+	CHECK(tracker.Park(100, 10));
+
+	CHECK(tracker.Activity(200));
+	CHECK(!tracker.IsParked());
+	CHECK(!tracker.Activity(201));
+}
+
+TEST(ZeroTimeoutNeverParks)
+{
+	IdleTracker tracker = {};
+
+	CHECK(!tracker.Park(~0ULL >> 1, 0));
+	CHECK(!tracker.IsParked());
+}
+
+TEST(ActivityRecordedLaterIsRespected)
+{
+	IdleTracker tracker = {};
+
+	//
+	// Now was read before another processor recorded newer traffic
+	// 
+	CHECK(!tracker.Activity(50000));
+	CHECK(!tracker.Park(40000, 1));
+	CHECK(!tracker.IsParked());
+}
+
+TEST(ConcurrentParkingNeverLosesActivity)
+{
+	IdleTracker tracker = {};
+	std::atomic<ULONGLONG> clock{ 0 };
+	std::atomic<bool> done{ false };
+	std::atomic<ULONG> resumes{ 0 };
+	std::vector<std::thread> producers;
+	ULONG parks = 0;
+
+	//
+	// Every park is matched by exactly one resume, except a final one
+	// 
+	for (ULONG producer = 0; producer < 3; producer++)
+	{
+		producers.emplace_back([&tracker, &clock, &done, &resumes]()
+		{
+			while (!done.load())
+			{
+				if (tracker.Activity(clock.fetch_add(2) + 2))
+					resumes++;
+
+				std::this_thread::yield();
+			}
+		});
+	}
+
+	for (ULONG i = 0; i < 200000; i++)
+	{
+		if (tracker.Park(clock.fetch_add(2) + 2, 4))
+			parks++;
+	}
+
+	done = true;
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	CHECK(parks > 0);
+	CHECK_EQUAL(parks, resumes.load() + (tracker.IsParked() ? 1 : 0));
+}
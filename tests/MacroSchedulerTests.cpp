@@ -0,0 +1,242 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MacroScheduler.hpp"
+#include "Test.hpp"
+
+using ViGEm::Bus::Core::MacroScheduler;
+using ViGEm::Bus::Core::MacroSet;
+using ViGEm::Bus::Core::MACRO_OVERLAY;
+
+
+static VIGEM_MACRO_STEP MakeStep(USHORT DurationMs, ULONG ButtonsSet)
+{
+	VIGEM_MACRO_STEP step = {};
+
+	step.DurationMs = DurationMs;
+	step.ButtonsSet = ButtonsSet;
+
+	return step;
+}
+
+static ULONG GetButtonsSet(const MacroSet& Set)
+{
+	MACRO_OVERLAY overlay;
+
+	Set.GetOverlay(overlay);
+
+	return overlay.ButtonsSet;
+}
+
+TEST(LoadValidatesSteps)
+{
+	MacroScheduler scheduler = {};
+	MacroSet set(nullptr);
+	VIGEM_MACRO_STEP steps[VIGEM_MACRO_MAX_STEPS + 1] = {};
+
+	for (auto& step : steps)
+	{
+		step = MakeStep(10, XUSB_GAMEPAD_A);
+	}
+
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, set.Load(scheduler, 0, VIGEM_MACRO_MAX_SLOTS, 1, 1, steps));
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, set.Load(scheduler, 0, 0, 1, 0, steps));
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, set.Load(scheduler, 0, 0, 1, VIGEM_MACRO_MAX_STEPS + 1, steps));
+
+	steps[1].DurationMs = 0;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, set.Load(scheduler, 0, 0, 1, 2, steps));
+	steps[1].DurationMs = 10;
+
+	steps[1].AxisMask = 1 << VIGEM_AXIS_COUNT;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, set.Load(scheduler, 0, 0, 1, 2, steps));
+	steps[1].AxisMask = 1 << VIGEM_AXIS_TRIGGER_L;
+
+	steps[1].Axes[VIGEM_AXIS_TRIGGER_L] = -1;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, set.Load(scheduler, 0, 0, 1, 2, steps));
+
+	CHECK(!set.IsActive());
+	CHECK(scheduler.IsEmpty());
+
+	steps[1].Axes[VIGEM_AXIS_TRIGGER_L] = VIGEM_AXIS_MAX;
+	CHECK_EQUAL(STATUS_SUCCESS, set.Load(scheduler, 0, 0, 1, VIGEM_MACRO_MAX_STEPS, steps));
+	CHECK(set.IsActive());
+	CHECK(!scheduler.IsEmpty());
+
+	set.Clear(scheduler);
+	CHECK(!set.IsActive());
+	CHECK(scheduler.IsEmpty());
+}
+
+TEST(StepsFollowTheirDurations)
+{
+	MacroScheduler scheduler = {};
+	int context = 0;
+	MacroSet set(&context);
+	const VIGEM_MACRO_STEP steps[] = { MakeStep(10, XUSB_GAMEPAD_A), MakeStep(20, XUSB_GAMEPAD_B) };
+
+	CHECK_EQUAL(STATUS_SUCCESS, set.Load(scheduler, 0, 0, 2, 2, steps));
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_A), GetButtonsSet(set));
+
+	CHECK(scheduler.Advance(9) == nullptr);
+
+	MacroSet* changed = scheduler.Advance(10);
+
+	CHECK(changed == &set);
+	CHECK(changed->GetContext() == &context);
+	CHECK(changed->NextChanged == nullptr);
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_B), GetButtonsSet(set));
+
+	CHECK(scheduler.Advance(29) == nullptr);
+	CHECK(scheduler.Advance(30) == &set);
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_A), GetButtonsSet(set));
+
+	CHECK(scheduler.Advance(40) == &set);
+	CHECK(set.IsActive());
+
+	//
+	// The second run ends the macro
+	// 
+	CHECK(scheduler.Advance(60) == &set);
+	CHECK(!set.IsActive());
+	CHECK(scheduler.IsEmpty());
+	CHECK_EQUAL(0UL, GetButtonsSet(set));
+}
+
+TEST(DeadlinesBeyondOneRotation)
+{
+	MacroScheduler scheduler = {};
+	MacroSet set(nullptr);
+	const VIGEM_MACRO_STEP steps[] = { MakeStep(1000, XUSB_GAMEPAD_X) };
+
+	CHECK_EQUAL(STATUS_SUCCESS, set.Load(scheduler, 0, 0, 1, 1, steps));
+
+	for (ULONGLONG now = 1; now < 1000; now++)
+	{
+		if (scheduler.Advance(now) != nullptr)
+		{
+			CHECK(!"expired early");
+			break;
+		}
+	}
+
+	CHECK(scheduler.Advance(1000) == &set);
+	CHECK(!set.IsActive());
+}
+
+TEST(StalledProgramsResync)
+{
+	MacroScheduler scheduler = {};
+	MacroSet set(nullptr);
+	const VIGEM_MACRO_STEP steps[] = { MakeStep(10, XUSB_GAMEPAD_A), MakeStep(10, XUSB_GAMEPAD_B) };
+
+	CHECK_EQUAL(STATUS_SUCCESS, set.Load(scheduler, 0, 0, 0, 2, steps));
+
+	//
+	// Far behind, the next step is due relative to now instead of firing
+	// all missed steps back to back
+	// 
+	CHECK(scheduler.Advance(5000) == &set);
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_B), GetButtonsSet(set));
+
+	CHECK(scheduler.Advance(5001) == nullptr);
+	CHECK(scheduler.Advance(5009) == nullptr);
+	CHECK(scheduler.Advance(5010) == &set);
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_A), GetButtonsSet(set));
+
+	set.Clear(scheduler);
+	CHECK(scheduler.IsEmpty());
+}
+
+TEST(ChangedSetsAreListedOnce)
+{
+	MacroScheduler scheduler = {};
+	MacroSet first(nullptr);
+	MacroSet second(nullptr);
+	const VIGEM_MACRO_STEP steps[] = { MakeStep(5, XUSB_GAMEPAD_A), MakeStep(5, XUSB_GAMEPAD_B) };
+
+	CHECK_EQUAL(STATUS_SUCCESS, first.Load(scheduler, 0, 0, 1, 2, steps));
+	CHECK_EQUAL(STATUS_SUCCESS, first.Load(scheduler, 0, 3, 1, 2, steps));
+	CHECK_EQUAL(STATUS_SUCCESS, second.Load(scheduler, 0, 0, 1, 2, steps));
+
+	ULONG firstSeen = 0, secondSeen = 0;
+
+	for (MacroSet* set = scheduler.Advance(5); set; set = set->NextChanged)
+	{
+		firstSeen += (set == &first) ? 1 : 0;
+		secondSeen += (set == &second) ? 1 : 0;
+	}
+
+	CHECK_EQUAL(1UL, firstSeen);
+	CHECK_EQUAL(1UL, secondSeen);
+
+	// Unloaded macros no longer fire
+	first.Unload(scheduler, 0);
+	first.Unload(scheduler, 3);
+	CHECK(scheduler.Advance(10) == &second);
+	CHECK(scheduler.IsEmpty());
+}
+
+TEST(OverlayCombinesSlots)
+{
+	MacroScheduler scheduler = {};
+	MacroSet set(nullptr);
+	VIGEM_MACRO_STEP low = MakeStep(10, XUSB_GAMEPAD_A);
+	VIGEM_MACRO_STEP high = MakeStep(10, XUSB_GAMEPAD_B);
+
+	low.ButtonsClear = XUSB_GAMEPAD_X;
+	low.AxisMask = (1 << VIGEM_AXIS_THUMB_LX) | (1 << VIGEM_AXIS_THUMB_LY);
+	low.Axes[VIGEM_AXIS_THUMB_LX] = 100;
+	low.Axes[VIGEM_AXIS_THUMB_LY] = 200;
+
+	high.AxisMask = 1 << VIGEM_AXIS_THUMB_LX;
+	high.Axes[VIGEM_AXIS_THUMB_LX] = -300;
+
+	CHECK_EQUAL(STATUS_SUCCESS, set.Load(scheduler, 0, 1, 1, 1, &low));
+	CHECK_EQUAL(STATUS_SUCCESS, set.Load(scheduler, 0, 5, 1, 1, &high));
+
+	MACRO_OVERLAY overlay;
+	ULONG buttons = XUSB_GAMEPAD_X | XUSB_GAMEPAD_Y;
+	LONG axes[VIGEM_AXIS_COUNT] = { 1, 2, 3, 4, 5, 6 };
+
+	set.GetOverlay(overlay);
+	MacroSet::ApplyOverlay(overlay, buttons, axes);
+
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_A | XUSB_GAMEPAD_B | XUSB_GAMEPAD_Y), buttons);
+	CHECK_EQUAL(-300, axes[VIGEM_AXIS_THUMB_LX]);
+	CHECK_EQUAL(200, axes[VIGEM_AXIS_THUMB_LY]);
+	CHECK_EQUAL(3, axes[VIGEM_AXIS_THUMB_RX]);
+
+	set.Clear(scheduler);
+}
@@ -0,0 +1,130 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "PluginTimeline.hpp"
+#include "Test.hpp"
+
+#include <thread>
+#include <vector>
+
+using ViGEm::Bus::Core::PluginTimeline;
+
+
+TEST(EmptyTimelineReadsZero)
+{
+	PluginTimeline timeline{};
+	VIGEM_PLUGIN_TIMELINE snapshot;
+
+	memset(&snapshot, 0xFF, sizeof(snapshot));
+	timeline.Snapshot(&snapshot);
+
+	for (ULONG phase = 0; phase < VIGEM_PLUGIN_PHASE_COUNT; phase++)
+		CHECK_EQUAL(0ULL, snapshot.Timestamps[phase]);
+}
+
+TEST(FirstMarkOfPhaseWins)
+{
+	PluginTimeline timeline{};
+	VIGEM_PLUGIN_TIMELINE snapshot;
+
+	timeline.Mark(VIGEM_PLUGIN_PHASE_REQUESTED, 100);
+	timeline.Mark(VIGEM_PLUGIN_PHASE_DESCRIPTOR_REQUESTED, 200);
+	timeline.Mark(VIGEM_PLUGIN_PHASE_DESCRIPTOR_REQUESTED, 300);
+	timeline.Mark(VIGEM_PLUGIN_PHASE_REQUESTED, 50);
+	timeline.Snapshot(&snapshot);
+
+	CHECK_EQUAL(100ULL, snapshot.Timestamps[VIGEM_PLUGIN_PHASE_REQUESTED]);
+	CHECK_EQUAL(200ULL, snapshot.Timestamps[VIGEM_PLUGIN_PHASE_DESCRIPTOR_REQUESTED]);
+	CHECK_EQUAL(0ULL, snapshot.Timestamps[VIGEM_PLUGIN_PHASE_READY]);
+}
+
+TEST(TimestampZeroStillMarksPhase)
+{
+	PluginTimeline timeline{};
+	VIGEM_PLUGIN_TIMELINE snapshot;
+
+	timeline.Mark(VIGEM_PLUGIN_PHASE_PREPARED, 0);
+	timeline.Mark(VIGEM_PLUGIN_PHASE_PREPARED, 5);
+	timeline.Snapshot(&snapshot);
+
+	CHECK_EQUAL(1ULL, snapshot.Timestamps[VIGEM_PLUGIN_PHASE_PREPARED]);
+}
+
+TEST(PhaseCountIsIgnored)
+{
+	PluginTimeline timeline{};
+	VIGEM_PLUGIN_TIMELINE snapshot;
+
+	timeline.Mark(VIGEM_PLUGIN_PHASE_COUNT, 10);
+	timeline.Snapshot(&snapshot);
+
+	for (ULONG phase = 0; phase < VIGEM_PLUGIN_PHASE_COUNT; phase++)
+		CHECK_EQUAL(0ULL, snapshot.Timestamps[phase]);
+}
+
+TEST(ConcurrentMarksKeepOneTimestamp)
+{
+	static const ULONG THREADS = 8;
+
+	PluginTimeline timeline{};
+	VIGEM_PLUGIN_TIMELINE snapshot;
+	std::vector<std::thread> threads;
+
+	//
+	// Every thread marks every phase with its own timestamp, one of them
+	// sticks per phase
+	// 
+	for (ULONG index = 0; index < THREADS; index++)
+	{
+		threads.emplace_back([&timeline, index]
+		{
+			for (ULONG phase = 0; phase < VIGEM_PLUGIN_PHASE_COUNT; phase++)
+				timeline.Mark(static_cast<VIGEM_PLUGIN_PHASE>(phase), (index + 1) * 1000 + phase);
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	timeline.Snapshot(&snapshot);
+
+	for (ULONG phase = 0; phase < VIGEM_PLUGIN_PHASE_COUNT; phase++)
+	{
+		const ULONGLONG stamp = snapshot.Timestamps[phase];
+
+		CHECK(stamp >= 1000 && stamp <= THREADS * 1000 + phase);
+		CHECK_EQUAL(static_cast<ULONGLONG>(phase), stamp % 1000);
+	}
+}
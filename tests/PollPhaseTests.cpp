@@ -0,0 +1,211 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "PollPhase.hpp"
+#include "Test.hpp"
+
+using ViGEm::Bus::Core::PollPhaseEstimator;
+
+
+//
+// 1ms full-speed polling interval in 100ns units
+// 
+static const ULONGLONG PERIOD = 10000;
+
+static const ULONGLONG START = 50000000;
+
+//
+// Deterministic jitter in [-Amplitude, Amplitude]
+// 
+static LONGLONG Jitter(ULONG& State, LONGLONG Amplitude)
+{
+	State = State * 1664525 + 1013904223;
+
+	return static_cast<LONGLONG>(State >> 8) % (2 * Amplitude + 1) - Amplitude;
+}
+
+TEST(NoSamplesReportsNothing)
+{
+	PollPhaseEstimator estimator = {};
+	VIGEM_POLL_PHASE phase;
+
+	estimator.Snapshot(1234, &phase);
+
+	CHECK_EQUAL(1234ULL, phase.Now);
+	CHECK_EQUAL(0ULL, phase.LastPoll);
+	CHECK_EQUAL(0ULL, phase.NextPoll);
+	CHECK_EQUAL(0UL, phase.Samples);
+	CHECK(!phase.Locked);
+}
+
+TEST(SteadyPollingLocks)
+{
+	PollPhaseEstimator estimator = {};
+	VIGEM_POLL_PHASE phase;
+
+	estimator.Arrival(START);
+	estimator.Snapshot(START, &phase);
+	CHECK_EQUAL(1UL, phase.Samples);
+	CHECK_EQUAL(START, phase.LastPoll);
+	CHECK_EQUAL(0ULL, phase.NextPoll);
+
+	for (ULONGLONG poll = 1; poll < 16; poll++)
+	{
+		estimator.Arrival(START + poll * PERIOD);
+	}
+
+	estimator.Snapshot(START + 15 * PERIOD, &phase);
+	CHECK_EQUAL(16UL, phase.Samples);
+	CHECK_EQUAL(static_cast<ULONG>(PERIOD), phase.Period);
+	CHECK_EQUAL(0UL, phase.Jitter);
+	CHECK(phase.Locked);
+
+	//
+	// The next poll is predicted after Now, however late the snapshot
+	// 
+	estimator.Snapshot(START + 15 * PERIOD + 3, &phase);
+	CHECK_EQUAL(START + 16 * PERIOD, phase.NextPoll);
+
+	estimator.Snapshot(START + 20 * PERIOD, &phase);
+	CHECK_EQUAL(START + 21 * PERIOD, phase.NextPoll);
+}
+
+TEST(JitteredPollingConverges)
+{
+	PollPhaseEstimator estimator = {};
+	VIGEM_POLL_PHASE phase;
+	ULONG state = 1;
+
+	for (ULONGLONG poll = 0; poll < 2000; poll++)
+	{
+		estimator.Arrival(START + poll * PERIOD + 1000 + Jitter(state, 500));
+	}
+
+	estimator.Snapshot(START + 1999 * PERIOD + 1000, &phase);
+
+	CHECK(phase.Period > PERIOD - 100 && phase.Period < PERIOD + 100);
+	CHECK(phase.Jitter > 0 && phase.Jitter < 1000);
+	CHECK(phase.Locked);
+
+	// The phase follows the offset of the polls, not the jitter
+	const LONGLONG offset = static_cast<LONGLONG>(phase.NextPoll - START) % static_cast<LONGLONG>(PERIOD);
+
+	CHECK(offset > 1000 - 300 && offset < 1000 + 300);
+}
+
+TEST(DriftingClockIsTracked)
+{
+	PollPhaseEstimator estimator = {};
+	VIGEM_POLL_PHASE phase;
+	const ULONGLONG drifted = PERIOD + 15;
+
+	for (ULONGLONG poll = 0; poll < 4000; poll++)
+	{
+		estimator.Arrival(START + poll * drifted);
+	}
+
+	estimator.Snapshot(START + 3999 * drifted, &phase);
+
+	CHECK(phase.Period >= drifted - 2 && phase.Period <= drifted + 2);
+	CHECK(phase.Locked);
+}
+
+TEST(SkippedPollsKeepThePeriod)
+{
+	PollPhaseEstimator estimator = {};
+	VIGEM_POLL_PHASE phase;
+
+	for (ULONGLONG poll = 0; poll < 32; poll++)
+	{
+		estimator.Arrival(START + poll * PERIOD);
+	}
+
+	//
+	// Only every third poll finds a transfer queued
+	// 
+	for (ULONGLONG poll = 33; poll < 300; poll += 3)
+	{
+		estimator.Arrival(START + poll * PERIOD);
+	}
+
+	estimator.Snapshot(START + 297 * PERIOD, &phase);
+
+	CHECK_EQUAL(static_cast<ULONG>(PERIOD), phase.Period);
+	CHECK(phase.Locked);
+}
+
+TEST(LongSilenceReacquires)
+{
+	PollPhaseEstimator estimator = {};
+	VIGEM_POLL_PHASE phase;
+
+	for (ULONGLONG poll = 0; poll < 32; poll++)
+	{
+		estimator.Arrival(START + poll * PERIOD);
+	}
+
+	const ULONGLONG resumed = START + 31 * PERIOD + 9 * PERIOD;
+
+	estimator.Arrival(resumed);
+	estimator.Snapshot(resumed, &phase);
+
+	CHECK_EQUAL(1UL, phase.Samples);
+	CHECK_EQUAL(resumed, phase.LastPoll);
+	CHECK(!phase.Locked);
+}
+
+TEST(OutOfRangeIntervalsDoNotSeed)
+{
+	PollPhaseEstimator estimator = {};
+	VIGEM_POLL_PHASE phase;
+
+	estimator.Arrival(START);
+	estimator.Arrival(START + 100);
+
+	estimator.Snapshot(START + 100, &phase);
+	CHECK_EQUAL(0UL, phase.Period);
+	CHECK_EQUAL(0ULL, phase.NextPoll);
+
+	estimator.Arrival(START + 100 + 2000000);
+
+	estimator.Snapshot(START + 100 + 2000000, &phase);
+	CHECK_EQUAL(0UL, phase.Period);
+
+	estimator.Arrival(START + 100 + 2000000 + PERIOD);
+
+	estimator.Snapshot(START + 100 + 2000000 + PERIOD, &phase);
+	CHECK_EQUAL(static_cast<ULONG>(PERIOD), phase.Period);
+	CHECK_EQUAL(2UL, phase.Samples);
+}
@@ -0,0 +1,265 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "RawOutputRing.hpp"
+#include "Test.hpp"
+
+#include <vector>
+
+using ViGEm::Bus::Core::RawOutputRing;
+
+
+//
+// Payload of transfer Sequence, Length bytes
+// 
+static std::vector<UCHAR> MakeTransfer(ULONG Sequence, ULONG Length)
+{
+	std::vector<UCHAR> transfer(Length);
+
+	for (ULONG i = 0; i < Length; i++)
+		transfer[i] = static_cast<UCHAR>(Sequence * 13 + i);
+
+	return transfer;
+}
+
+static void Write(RawOutputRing& Ring, ULONG Sequence, ULONG Length)
+{
+	const std::vector<UCHAR> transfer = MakeTransfer(Sequence, Length);
+
+	Ring.Write(Sequence * 10ULL, transfer.data(), Length);
+}
+
+//
+// Walks a drained buffer like a client does, checking every record against
+// the transfer it was written from. Returns the number of records, or ~0
+// if the buffer is malformed.
+// 
+static ULONG CheckRecords(const std::vector<UCHAR>& Buffer, ULONG Drained, ULONG& Sequence, ULONG Length)
+{
+	ULONG offset = 0;
+	ULONG count = 0;
+
+	while (const PCVIGEM_RAW_OUTPUT_RECORD record = VIGEM_RAW_OUTPUT_NEXT(Buffer.data(), Drained, &offset))
+	{
+		const std::vector<UCHAR> transfer = MakeTransfer(Sequence, Length);
+
+		CHECK_EQUAL(Sequence, record->Sequence);
+		CHECK_EQUAL(Sequence * 10ULL, record->Time);
+		CHECK_EQUAL(Length, static_cast<ULONG>(record->Length));
+		CHECK_EQUAL(Length, static_cast<ULONG>(record->TransferLength));
+		CHECK(memcmp(transfer.data(), VIGEM_RAW_OUTPUT_DATA(record), Length) == 0);
+
+		Sequence++;
+		count++;
+	}
+
+	return offset == Drained ? count : ~0UL;
+}
+
+TEST(InactiveRingIgnoresTransfers)
+{
+	RawOutputRing ring;
+	UCHAR buffer[64];
+
+	CHECK(!ring.IsActive());
+
+	Write(ring, 0, 8);
+
+	CHECK_EQUAL(0UL, ring.Drain(buffer, sizeof(buffer)));
+	CHECK_EQUAL(0UL, ring.GetDropped());
+	CHECK(ring.Stop() == nullptr);
+}
+
+TEST(RecordsArePaddedToAlignment)
+{
+	std::vector<UCHAR> storage(VIGEM_RAW_OUTPUT_MIN_CAPACITY);
+	std::vector<UCHAR> buffer(VIGEM_RAW_OUTPUT_MIN_CAPACITY, 0xCC);
+	RawOutputRing ring;
+	ULONG sequence = 0;
+
+	ring.Start(storage.data(), static_cast<ULONG>(storage.size()));
+
+	CHECK(ring.IsActive());
+	CHECK_EQUAL(static_cast<ULONG>(storage.size()), ring.GetCapacity());
+
+	Write(ring, 0, 3);
+
+	const ULONG drained = ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size()));
+
+	CHECK_EQUAL(VIGEM_RAW_OUTPUT_RECORD_SIZE(3), drained);
+	CHECK_EQUAL(0UL, drained % VIGEM_RAW_OUTPUT_ALIGNMENT);
+	CHECK_EQUAL(1UL, CheckRecords(buffer, drained, sequence, 3));
+
+	for (ULONG offset = sizeof(VIGEM_RAW_OUTPUT_RECORD) + 3; offset < drained; offset++)
+		CHECK_EQUAL(0, buffer[offset]);
+
+	CHECK(ring.Stop() == storage.data());
+	CHECK(!ring.IsActive());
+}
+
+TEST(LongTransfersAreTruncated)
+{
+	std::vector<UCHAR> storage(VIGEM_RAW_OUTPUT_MIN_CAPACITY);
+	std::vector<UCHAR> buffer(VIGEM_RAW_OUTPUT_MIN_CAPACITY);
+	const std::vector<UCHAR> transfer = MakeTransfer(0, 200);
+	RawOutputRing ring;
+	ULONG offset = 0;
+
+	ring.Start(storage.data(), static_cast<ULONG>(storage.size()));
+	ring.Write(1, transfer.data(), static_cast<ULONG>(transfer.size()));
+
+	const ULONG drained = ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size()));
+	const PCVIGEM_RAW_OUTPUT_RECORD record = VIGEM_RAW_OUTPUT_NEXT(buffer.data(), drained, &offset);
+
+	CHECK(record != nullptr);
+	CHECK_EQUAL(static_cast<ULONG>(VIGEM_RAW_OUTPUT_MAX_RECORD), drained);
+	CHECK_EQUAL(VIGEM_RAW_OUTPUT_MAX_PAYLOAD, static_cast<int>(record->Length));
+	CHECK_EQUAL(200, static_cast<int>(record->TransferLength));
+	CHECK(memcmp(transfer.data(), VIGEM_RAW_OUTPUT_DATA(record), VIGEM_RAW_OUTPUT_MAX_PAYLOAD) == 0);
+}
+
+TEST(FullRingDropsAndLeavesSequenceGap)
+{
+	static const ULONG LENGTH = 32;
+
+	const ULONG size = VIGEM_RAW_OUTPUT_RECORD_SIZE(LENGTH);
+	std::vector<UCHAR> storage(size * 4);
+	std::vector<UCHAR> buffer(size * 4);
+	RawOutputRing ring;
+	ULONG sequence = 0;
+	ULONG offset = 0;
+
+	ring.Start(storage.data(), static_cast<ULONG>(storage.size()));
+
+	for (ULONG i = 0; i < 6; i++)
+		Write(ring, i, LENGTH);
+
+	CHECK_EQUAL(2UL, ring.GetDropped());
+	CHECK_EQUAL(size * 4, ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(4UL, CheckRecords(buffer, size * 4, sequence, LENGTH));
+
+	//
+	// The next record tells the client two transfers went missing
+	// 
+	Write(ring, 6, LENGTH);
+
+	CHECK_EQUAL(size, ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(6UL, VIGEM_RAW_OUTPUT_NEXT(buffer.data(), size, &offset)->Sequence);
+}
+
+TEST(DrainMovesWholeRecordsOnly)
+{
+	static const ULONG LENGTH = 20;
+
+	const ULONG size = VIGEM_RAW_OUTPUT_RECORD_SIZE(LENGTH);
+	std::vector<UCHAR> storage(VIGEM_RAW_OUTPUT_MIN_CAPACITY);
+	std::vector<UCHAR> buffer(size * 2 + size / 2);
+	RawOutputRing ring;
+	ULONG sequence = 0;
+
+	ring.Start(storage.data(), static_cast<ULONG>(storage.size()));
+
+	for (ULONG i = 0; i < 5; i++)
+		Write(ring, i, LENGTH);
+
+	CHECK_EQUAL(size * 2, ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(2UL, CheckRecords(buffer, size * 2, sequence, LENGTH));
+	CHECK_EQUAL(0UL, ring.Drain(buffer.data(), size - 1));
+	CHECK_EQUAL(size * 2, ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(2UL, CheckRecords(buffer, size * 2, sequence, LENGTH));
+	CHECK_EQUAL(size, ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size())));
+	CHECK_EQUAL(1UL, CheckRecords(buffer, size, sequence, LENGTH));
+	CHECK_EQUAL(0UL, ring.GetDropped());
+}
+
+TEST(RecordsWrapAroundTheEnd)
+{
+	//
+	// Capacities that are and aren't a multiple of the alignment, so
+	// headers, payloads and padding all get split at the end
+	// 
+	static const ULONG CAPACITIES[] = { 4096, 1000, 333 };
+	static const ULONG LENGTHS[] = { 1, 8, 32, 48, 64 };
+
+	for (const ULONG capacity : CAPACITIES)
+	{
+		for (const ULONG length : LENGTHS)
+		{
+			std::vector<UCHAR> storage(capacity);
+			std::vector<UCHAR> buffer(capacity);
+			RawOutputRing ring;
+			ULONG written = 0;
+			ULONG read = 0;
+
+			ring.Start(storage.data(), capacity);
+
+			//
+			// Three records per drain, enough rounds to pass the end many times
+			// 
+			for (ULONG round = 0; round < 200; round++)
+			{
+				for (ULONG i = 0; i < 3; i++)
+					Write(ring, written++, length);
+
+				const ULONG drained = ring.Drain(buffer.data(), capacity);
+
+				CHECK_EQUAL(3UL, CheckRecords(buffer, drained, read, length));
+			}
+
+			CHECK_EQUAL(written, read);
+			CHECK_EQUAL(0UL, ring.GetDropped());
+		}
+	}
+}
+
+TEST(StartRestartsSequence)
+{
+	std::vector<UCHAR> storage(VIGEM_RAW_OUTPUT_MIN_CAPACITY);
+	std::vector<UCHAR> buffer(VIGEM_RAW_OUTPUT_MIN_CAPACITY);
+	RawOutputRing ring;
+	ULONG sequence = 0;
+
+	ring.Start(storage.data(), static_cast<ULONG>(storage.size()));
+	Write(ring, 0, 8);
+	Write(ring, 1, 8);
+	ring.Stop();
+
+	ring.Start(storage.data(), static_cast<ULONG>(storage.size()));
+	Write(ring, 0, 8);
+
+	const ULONG drained = ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size()));
+
+	CHECK_EQUAL(1UL, CheckRecords(buffer, drained, sequence, 8));
+}
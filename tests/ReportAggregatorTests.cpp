@@ -0,0 +1,226 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ReportAggregator.hpp"
+#include "Test.hpp"
+
+using ViGEm::Bus::Core::ReportAggregator;
+using ViGEm::Bus::Core::AGGREGATOR_STATE;
+
+
+static const LONG OWNER = 1;
+
+static AGGREGATOR_STATE MakeState(ULONG Buttons, LONG ThumbLX, LONG TriggerR)
+{
+	AGGREGATOR_STATE state = {};
+
+	state.Buttons = Buttons;
+	state.Axes[VIGEM_AXIS_THUMB_LX] = ThumbLX;
+	state.Axes[VIGEM_AXIS_TRIGGER_R] = TriggerR;
+
+	return state;
+}
+
+TEST(OwnerIsAlwaysSource)
+{
+	ReportAggregator aggregator;
+
+	CHECK(!aggregator.IsEnabled());
+
+	aggregator.Enable(OWNER, VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE, 0);
+
+	CHECK(aggregator.IsEnabled());
+	CHECK(aggregator.IsSource(OWNER));
+	CHECK(!aggregator.IsSource(2));
+	CHECK(!aggregator.Detach(OWNER));
+	CHECK(aggregator.IsSource(OWNER));
+
+	aggregator.Disable();
+	CHECK(!aggregator.IsEnabled());
+}
+
+TEST(AttachIsLimited)
+{
+	ReportAggregator aggregator;
+
+	aggregator.Enable(OWNER, VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE, 0);
+
+	for (LONG session = 2; session <= VIGEM_AGGREGATION_MAX_SOURCES; session++)
+	{
+		CHECK_EQUAL(STATUS_SUCCESS, aggregator.Attach(session, 0));
+	}
+
+	CHECK_EQUAL(STATUS_INSUFFICIENT_RESOURCES, aggregator.Attach(100, 0));
+
+	// Re-attaching an existing source needs no slot
+	CHECK_EQUAL(STATUS_SUCCESS, aggregator.Attach(2, 5));
+
+	CHECK(aggregator.Detach(2));
+	CHECK(!aggregator.Detach(2));
+	CHECK(!aggregator.IsSource(2));
+	CHECK_EQUAL(STATUS_SUCCESS, aggregator.Attach(100, 0));
+	CHECK(aggregator.IsSource(100));
+}
+
+TEST(MergeRejectsUnknownSessions)
+{
+	ReportAggregator aggregator;
+	AGGREGATOR_STATE output = {};
+
+	aggregator.Enable(OWNER, VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE, 0);
+
+	CHECK(!aggregator.Merge(2, MakeState(1, 0, 0), output));
+}
+
+TEST(ButtonsAreCombined)
+{
+	ReportAggregator aggregator;
+	AGGREGATOR_STATE output = {};
+
+	aggregator.Enable(OWNER, VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE, 0);
+	CHECK_EQUAL(STATUS_SUCCESS, aggregator.Attach(2, 0));
+
+	CHECK(aggregator.Merge(OWNER, MakeState(XUSB_GAMEPAD_A, 0, 0), output));
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_A), output.Buttons);
+
+	CHECK(aggregator.Merge(2, MakeState(XUSB_GAMEPAD_B, 0, 0), output));
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_A | XUSB_GAMEPAD_B), output.Buttons);
+
+	// A detached source no longer contributes
+	CHECK(aggregator.Detach(2));
+	CHECK(aggregator.Merge(OWNER, MakeState(XUSB_GAMEPAD_A, 0, 0), output));
+	CHECK_EQUAL(static_cast<ULONG>(XUSB_GAMEPAD_A), output.Buttons);
+}
+
+TEST(MaxMagnitudeWins)
+{
+	ReportAggregator aggregator;
+	AGGREGATOR_STATE output = {};
+
+	aggregator.Enable(OWNER, VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE, 0);
+	CHECK_EQUAL(STATUS_SUCCESS, aggregator.Attach(2, 0));
+
+	CHECK(aggregator.Merge(OWNER, MakeState(0, 1000, 20000), output));
+	CHECK(aggregator.Merge(2, MakeState(0, -3000, 100), output));
+
+	CHECK_EQUAL(-3000, output.Axes[VIGEM_AXIS_THUMB_LX]);
+	CHECK_EQUAL(20000, output.Axes[VIGEM_AXIS_TRIGGER_R]);
+}
+
+TEST(PriorityPrefersActiveSources)
+{
+	ReportAggregator aggregator;
+	AGGREGATOR_STATE output = {};
+
+	aggregator.Enable(OWNER, VIGEM_AGGREGATION_AXIS_PRIORITY, 10);
+	CHECK_EQUAL(STATUS_SUCCESS, aggregator.Attach(2, 1));
+
+	//
+	// Both deflect, the owner has the higher priority
+	// 
+	CHECK(aggregator.Merge(OWNER, MakeState(0, 5000, 0), output));
+	CHECK(aggregator.Merge(2, MakeState(0, -30000, 0), output));
+	CHECK_EQUAL(5000, output.Axes[VIGEM_AXIS_THUMB_LX]);
+
+	//
+	// An idle owner stick hands over to the active lower priority source
+	// 
+	CHECK(aggregator.Merge(OWNER, MakeState(0, 100, 0), output));
+	CHECK_EQUAL(-30000, output.Axes[VIGEM_AXIS_THUMB_LX]);
+
+	// Both idle, priority decides again
+	CHECK(aggregator.Merge(2, MakeState(0, -200, 0), output));
+	CHECK_EQUAL(100, output.Axes[VIGEM_AXIS_THUMB_LX]);
+}
+
+TEST(Ds4HatDirectionsAreMerged)
+{
+	ReportAggregator aggregator;
+	AGGREGATOR_STATE input = {};
+	AGGREGATOR_STATE output = {};
+	DS4_REPORT report;
+
+	aggregator.Enable(OWNER, VIGEM_AGGREGATION_AXIS_MAX_MAGNITUDE, 0);
+	CHECK_EQUAL(STATUS_SUCCESS, aggregator.Attach(2, 0));
+
+	DS4_REPORT_INIT(&report);
+	DS4_SET_DPAD(&report, DS4_BUTTON_DPAD_NORTH);
+	report.wButtons |= DS4_BUTTON_CROSS;
+	ReportAggregator::FromDs4Report(&report, input);
+	CHECK(aggregator.Merge(OWNER, input, output));
+
+	DS4_REPORT_INIT(&report);
+	DS4_SET_DPAD(&report, DS4_BUTTON_DPAD_EAST);
+	report.bSpecial = DS4_SPECIAL_BUTTON_PS;
+	ReportAggregator::FromDs4Report(&report, input);
+	CHECK(aggregator.Merge(2, input, output));
+
+	ReportAggregator::ToDs4Report(output, &report);
+	CHECK_EQUAL(DS4_BUTTON_DPAD_NORTHEAST, report.wButtons & 0xF);
+	CHECK(report.wButtons & DS4_BUTTON_CROSS);
+	CHECK_EQUAL(DS4_SPECIAL_BUTTON_PS, report.bSpecial);
+
+	//
+	// Opposing directions cancel out
+	// 
+	DS4_REPORT_INIT(&report);
+	DS4_SET_DPAD(&report, DS4_BUTTON_DPAD_SOUTH);
+	ReportAggregator::FromDs4Report(&report, input);
+	CHECK(aggregator.Merge(2, input, output));
+
+	ReportAggregator::ToDs4Report(output, &report);
+	CHECK_EQUAL(DS4_BUTTON_DPAD_NONE, report.wButtons & 0xF);
+}
+
+TEST(Ds4ReportRoundTrip)
+{
+	for (ULONG hat = 0; hat <= DS4_BUTTON_DPAD_NONE; hat++)
+	{
+		AGGREGATOR_STATE state = {};
+		DS4_REPORT report;
+		DS4_REPORT result = {};
+
+		DS4_REPORT_INIT(&report);
+		report.wButtons = static_cast<USHORT>(DS4_BUTTON_TRIANGLE | DS4_BUTTON_SHARE | hat);
+		report.bSpecial = DS4_SPECIAL_BUTTON_TOUCHPAD;
+
+		ReportAggregator::FromDs4Report(&report, state);
+		ReportAggregator::ToDs4Report(state, &result);
+
+		CHECK_EQUAL(report.wButtons, result.wButtons);
+		CHECK_EQUAL(report.bSpecial, result.bSpecial);
+		CHECK_EQUAL(report.bThumbLX, result.bThumbLX);
+	}
+}
@@ -0,0 +1,387 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ReportLog.hpp"
+#include "ReportRecorder.hpp"
+#include "Test.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using ViGEm::Bus::Core::ReportRecorder;
+using namespace ViGEm::Tools;
+
+
+//
+// 100ns units
+// 
+static const ULONGLONG MILLISECOND = 10000;
+
+static const ULONGLONG START_TIME = 1000 * MILLISECOND;
+
+static const ULONG SERIAL_NO = 7;
+
+static XUSB_REPORT MakeReport(ULONG Index)
+{
+	XUSB_REPORT report = {};
+
+	report.wButtons = static_cast<USHORT>((Index / 8) & 0x1);
+	report.bLeftTrigger = static_cast<BYTE>(Index);
+	report.sThumbLX = static_cast<SHORT>(Index * 64);
+
+	return report;
+}
+
+//
+// Drains everything the recorder holds in chunks of the given size
+// 
+static std::vector<UCHAR> DrainAll(ReportRecorder& Recorder, ULONG Chunk)
+{
+	std::vector<UCHAR> log;
+	std::vector<UCHAR> buffer(Chunk);
+	ULONG drained;
+
+	while ((drained = Recorder.Drain(buffer.data(), Chunk)) > 0)
+		log.insert(log.end(), buffer.begin(), buffer.begin() + drained);
+
+	return log;
+}
+
+TEST(VarintRoundTrip)
+{
+	static const ULONGLONG VALUES[] = { 0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0xFFFFFFFFULL, ~0ULL };
+
+	for (const auto value : VALUES)
+	{
+		UCHAR buffer[10];
+		ULONGLONG decoded;
+
+		const ULONG length = VIGEM_REPORT_LOG_PUT_VARINT(buffer, value);
+
+		CHECK_EQUAL(length, VIGEM_REPORT_LOG_GET_VARINT(buffer, length, &decoded));
+		CHECK_EQUAL(value, decoded);
+
+		//
+		// One byte short is incomplete, not a different value
+		// 
+		CHECK_EQUAL(0UL, VIGEM_REPORT_LOG_GET_VARINT(buffer, length - 1, &decoded));
+	}
+}
+
+TEST(SmallChangesEncodeAsDeltas)
+{
+	VIGEM_REPORT_LOG_STATE state;
+	UCHAR record[VIGEM_REPORT_LOG_MAX_RECORD];
+	XUSB_REPORT report = MakeReport(1);
+
+	VIGEM_REPORT_LOG_STATE_INIT(&state, START_TIME);
+
+	const ULONG first = VIGEM_REPORT_LOG_ENCODE(&state, VIGEM_REPORT_LOG_INPUT, START_TIME,
+	                                            reinterpret_cast<PUCHAR>(&report), sizeof(report), record);
+
+	CHECK(record[0] & VIGEM_REPORT_LOG_FLAG_KEYFRAME);
+	CHECK_EQUAL(1 + 1 + 1 + sizeof(report), static_cast<size_t>(first));
+
+	VIGEM_REPORT_LOG_COMMIT(&state, VIGEM_REPORT_LOG_INPUT, START_TIME, reinterpret_cast<PUCHAR>(&report),
+	                        sizeof(report));
+
+	report.bRightTrigger = 0xFF;
+
+	const ULONG delta = VIGEM_REPORT_LOG_ENCODE(&state, VIGEM_REPORT_LOG_INPUT, START_TIME + MILLISECOND,
+	                                            reinterpret_cast<PUCHAR>(&report), sizeof(report), record);
+
+	CHECK(!(record[0] & VIGEM_REPORT_LOG_FLAG_KEYFRAME));
+	CHECK(delta < first);
+
+	//
+	// The other kind keeps its own previous payload
+	// 
+	const ULONG output = VIGEM_REPORT_LOG_ENCODE(&state, VIGEM_REPORT_LOG_OUTPUT, START_TIME,
+	                                             reinterpret_cast<PUCHAR>(&report), sizeof(report), record);
+
+	CHECK(record[0] & VIGEM_REPORT_LOG_FLAG_KEYFRAME);
+	CHECK_EQUAL(first, output);
+}
+
+TEST(RecorderLogDecodesToInput)
+{
+	static const char* PATH = "ReportRecorderTests.vgr";
+	static const ULONG COUNT = 200;
+
+	std::vector<UCHAR> storage(0x4000);
+	ReportRecorder recorder;
+
+	recorder.Start(storage.data(), static_cast<ULONG>(storage.size()), Xbox360Wired, SERIAL_NO, START_TIME);
+	CHECK(recorder.IsActive());
+
+	for (ULONG index = 0; index < COUNT; index++)
+	{
+		const XUSB_REPORT report = MakeReport(index);
+		const UCHAR rumble[] = { 0x00, 0x08, 0x00, static_cast<UCHAR>(index), 0x00, 0x00, 0x00, 0x00 };
+
+		recorder.Record(VIGEM_REPORT_LOG_INPUT, START_TIME + index * MILLISECOND, &report, sizeof(report));
+
+		if (index % 10 == 0)
+			recorder.Record(VIGEM_REPORT_LOG_OUTPUT, START_TIME + index * MILLISECOND, rumble, sizeof(rumble));
+	}
+
+	CHECK_EQUAL(0UL, recorder.GetDropped());
+
+	std::vector<UCHAR> log = DrainAll(recorder, 37);
+	VIGEM_REPORT_LOG_HEADER header;
+	std::vector<REPORT_LOG_ENTRY> entries;
+
+	CHECK(WriteReportLog(PATH, log));
+
+	log.clear();
+
+	CHECK(ReadReportLog(PATH, log));
+
+	remove(PATH);
+
+	CHECK(ParseReportLog(log.data(), log.size(), header, entries));
+	CHECK_EQUAL(static_cast<USHORT>(Xbox360Wired), header.TargetType);
+	CHECK_EQUAL(SERIAL_NO, header.SerialNo);
+	CHECK_EQUAL(START_TIME, header.StartTime);
+	CHECK_EQUAL(static_cast<size_t>(COUNT + COUNT / 10), entries.size());
+
+	ULONG inputs = 0;
+
+	for (const auto& entry : entries)
+	{
+		if (entry.Kind == VIGEM_REPORT_LOG_OUTPUT)
+		{
+			CHECK_EQUAL(8UL, entry.Length);
+			continue;
+		}
+
+		const XUSB_REPORT expected = MakeReport(inputs);
+
+		CHECK_EQUAL(static_cast<ULONG>(sizeof(expected)), entry.Length);
+		CHECK(memcmp(&expected, entry.Payload, sizeof(expected)) == 0);
+		CHECK_EQUAL(START_TIME + inputs * MILLISECOND, entry.Time);
+
+		inputs++;
+	}
+
+	CHECK_EQUAL(COUNT, inputs);
+	CHECK(recorder.Stop() == storage.data());
+	CHECK(!recorder.IsActive());
+}
+
+TEST(FullRingDropsAndStaysDecodable)
+{
+	//
+	// Room for the header and a handful of records
+	// 
+	std::vector<UCHAR> storage(sizeof(VIGEM_REPORT_LOG_HEADER) + 64);
+	std::vector<UCHAR> log;
+	ReportRecorder recorder;
+
+	recorder.Start(storage.data(), static_cast<ULONG>(storage.size()), Xbox360Wired, SERIAL_NO, START_TIME);
+
+	//
+	// Keep draining a little to move the ring across its end
+	// 
+	ULONG recorded = 0;
+
+	for (ULONG index = 0; index < 100; index++)
+	{
+		const XUSB_REPORT report = MakeReport(index);
+		UCHAR chunk[16];
+
+		recorder.Record(VIGEM_REPORT_LOG_INPUT, START_TIME + index * MILLISECOND, &report, sizeof(report));
+
+		if (index % 4 == 0)
+		{
+			const ULONG drained = recorder.Drain(chunk, sizeof(chunk));
+			log.insert(log.end(), chunk, chunk + drained);
+		}
+
+		recorded++;
+	}
+
+	const std::vector<UCHAR> rest = DrainAll(recorder, 16);
+	log.insert(log.end(), rest.begin(), rest.end());
+
+	VIGEM_REPORT_LOG_HEADER header;
+	std::vector<REPORT_LOG_ENTRY> entries;
+
+	CHECK(recorder.GetDropped() > 0);
+	CHECK(ParseReportLog(log.data(), log.size(), header, entries));
+	CHECK_EQUAL(static_cast<size_t>(recorded - recorder.GetDropped()), entries.size());
+
+	//
+	// Every stored record reproduces one of the submitted reports exactly,
+	// in submission order
+	// 
+	ULONGLONG previous = 0;
+
+	for (const auto& entry : entries)
+	{
+		const ULONG index = static_cast<ULONG>((entry.Time - START_TIME) / MILLISECOND);
+		const XUSB_REPORT expected = MakeReport(index);
+
+		CHECK(entry.Time >= previous);
+		CHECK(memcmp(&expected, entry.Payload, sizeof(expected)) == 0);
+
+		previous = entry.Time;
+	}
+}
+
+TEST(MalformedLogIsRejected)
+{
+	std::vector<UCHAR> storage(0x400);
+	ReportRecorder recorder;
+	const XUSB_REPORT report = MakeReport(3);
+
+	recorder.Start(storage.data(), static_cast<ULONG>(storage.size()), Xbox360Wired, SERIAL_NO, START_TIME);
+	recorder.Record(VIGEM_REPORT_LOG_INPUT, START_TIME, &report, sizeof(report));
+
+	std::vector<UCHAR> log = DrainAll(recorder, 0x400);
+	VIGEM_REPORT_LOG_HEADER header;
+	std::vector<REPORT_LOG_ENTRY> entries;
+
+	//
+	// A record cut short is a truncated tail, not an error
+	// 
+	CHECK(ParseReportLog(log.data(), log.size() - 1, header, entries));
+	CHECK(entries.empty());
+
+	//
+	// A delta without a previous payload of that length is
+	// 
+	std::vector<UCHAR> delta = log;
+	delta[sizeof(VIGEM_REPORT_LOG_HEADER)] &= ~VIGEM_REPORT_LOG_FLAG_KEYFRAME;
+	delta.resize(delta.size() + VIGEM_REPORT_LOG_MAX_RECORD);
+
+	CHECK(!ParseReportLog(delta.data(), delta.size(), header, entries));
+
+	log[0] ^= 0xFF;
+
+	CHECK(!ParseReportLog(log.data(), log.size(), header, entries));
+}
+
+TEST(TenfoldReplayReproducesSequence)
+{
+	using Clock = std::chrono::steady_clock;
+
+	static const ULONG COUNT = 100;
+
+	std::vector<UCHAR> storage(0x4000);
+	ReportRecorder recorder;
+
+	recorder.Start(storage.data(), static_cast<ULONG>(storage.size()), Xbox360Wired, SERIAL_NO, START_TIME);
+
+	//
+	// 1 kHz with a few gaps, notifications in between that must not replay
+	// 
+	ULONGLONG time = START_TIME;
+
+	for (ULONG index = 0; index < COUNT; index++)
+	{
+		const XUSB_REPORT report = MakeReport(index);
+		const UCHAR led[] = { 0x01, 0x03, static_cast<UCHAR>(index % 4) };
+
+		time += (index % 25 == 0) ? 20 * MILLISECOND : MILLISECOND;
+
+		recorder.Record(VIGEM_REPORT_LOG_INPUT, time, &report, sizeof(report));
+
+		if (index % 7 == 0)
+			recorder.Record(VIGEM_REPORT_LOG_OUTPUT, time, led, sizeof(led));
+	}
+
+	const std::vector<UCHAR> log = DrainAll(recorder, 0x4000);
+	VIGEM_REPORT_LOG_HEADER header;
+	std::vector<REPORT_LOG_ENTRY> entries;
+
+	CHECK(ParseReportLog(log.data(), log.size(), header, entries));
+
+	std::vector<XUSB_REPORT> replayed;
+	std::vector<Clock::duration> offsets;
+	std::vector<ULONGLONG> recorded;
+
+	const auto start = Clock::now();
+
+	const size_t submitted = ReplayReportLog(header, entries, 10.0, [&](const REPORT_LOG_ENTRY& Entry)
+	{
+		XUSB_REPORT report;
+
+		offsets.push_back(Clock::now() - start);
+		recorded.push_back(Entry.Time);
+
+		memcpy(&report, Entry.Payload, sizeof(report));
+		replayed.push_back(report);
+
+		return true;
+	});
+
+	const auto elapsed = Clock::now() - start;
+
+	CHECK_EQUAL(static_cast<size_t>(COUNT), submitted);
+	CHECK_EQUAL(static_cast<size_t>(COUNT), replayed.size());
+
+	for (ULONG index = 0; index < replayed.size(); index++)
+	{
+		const XUSB_REPORT expected = MakeReport(index);
+
+		CHECK(memcmp(&expected, &replayed[index], sizeof(expected)) == 0);
+
+		//
+		// Never ahead of the recording compressed tenfold
+		// 
+		const auto due = std::chrono::microseconds((recorded[index] - START_TIME) / 100);
+
+		CHECK(offsets[index] >= due);
+	}
+
+	//
+	// Recording spans 176ms, replay takes a tenth of it plus scheduling slack
+	// 
+	CHECK(elapsed >= std::chrono::microseconds((time - START_TIME) / 100));
+	CHECK(elapsed < std::chrono::milliseconds(500));
+
+	//
+	// Submit can stop a replay
+	// 
+	ULONG calls = 0;
+
+	CHECK_EQUAL(static_cast<size_t>(3), ReplayReportLog(header, entries, 1000.0, [&](const REPORT_LOG_ENTRY&)
+	{
+		return ++calls <= 3;
+	}));
+}
@@ -0,0 +1,287 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "SerialTable.hpp"
+#include "Test.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using ViGEm::Bus::Core::SerialTable;
+using ViGEm::Bus::Core::EmulationTargetPDO;
+
+
+//
+// Targets are never dereferenced, any distinct address will do
+// 
+static EmulationTargetPDO* FakeTarget(ULONG SerialNo)
+{
+	return reinterpret_cast<EmulationTargetPDO*>(static_cast<uintptr_t>(SerialNo + 1) * 0x40);
+}
+
+//
+// Value-initialized like the zeroed WDF context it normally lives in
+// 
+static std::unique_ptr<SerialTable> CreateTable()
+{
+	std::unique_ptr<SerialTable> table(new SerialTable());
+
+	table->Initialize();
+
+	return table;
+}
+
+TEST(LowestFreeSerialIsReused)
+{
+	const auto table = CreateTable();
+
+	for (ULONG expected = 1; expected <= 5; expected++)
+	{
+		ULONG serial = 0;
+
+		CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+		CHECK_EQUAL(expected, serial);
+	}
+
+	CHECK_EQUAL(5UL, table->GetCount());
+
+	table->Release(2);
+	table->Release(4);
+	CHECK_EQUAL(3UL, table->GetCount());
+
+	ULONG serial = 0;
+
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+	CHECK_EQUAL(2UL, serial);
+
+	serial = 0;
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+	CHECK_EQUAL(4UL, serial);
+
+	serial = 0;
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+	CHECK_EQUAL(6UL, serial);
+
+	table->Cleanup();
+}
+
+TEST(ExplicitSerialsAreValidated)
+{
+	const auto table = CreateTable();
+	ULONG serial = 300;
+
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+	CHECK_EQUAL(300UL, serial);
+	CHECK_EQUAL(STATUS_OBJECT_NAME_COLLISION, table->Reserve(&serial));
+
+	serial = SerialTable::MAX_SERIAL + 1;
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, table->Reserve(&serial));
+
+	serial = SerialTable::MAX_SERIAL;
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+
+	// Implicit reservation still starts at the bottom
+	serial = 0;
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+	CHECK_EQUAL(1UL, serial);
+
+	// Out of range releases are ignored
+	table->Release(0);
+	table->Release(SerialTable::MAX_SERIAL + 1);
+	CHECK_EQUAL(3UL, table->GetCount());
+
+	table->Cleanup();
+}
+
+TEST(ExhaustedTableReportsNoMoreEntries)
+{
+	const auto table = CreateTable();
+
+	for (ULONG expected = 1; expected <= SerialTable::MAX_SERIAL; expected++)
+	{
+		ULONG serial = 0;
+
+		if (table->Reserve(&serial) != STATUS_SUCCESS || serial != expected)
+		{
+			CHECK(!"sequential reservation");
+			break;
+		}
+	}
+
+	ULONG serial = 0;
+
+	CHECK_EQUAL(SerialTable::MAX_SERIAL, table->GetCount());
+	CHECK_EQUAL(STATUS_NO_MORE_ENTRIES, table->Reserve(&serial));
+
+	//
+	// Freeing one serial deep in the summary levels makes it the only candidate
+	// 
+	table->Release(40000);
+
+	serial = 0;
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+	CHECK_EQUAL(40000UL, serial);
+
+	serial = 0;
+	CHECK_EQUAL(STATUS_NO_MORE_ENTRIES, table->Reserve(&serial));
+
+	table->Cleanup();
+}
+
+TEST(LookupRequiresOnline)
+{
+	const auto table = CreateTable();
+	ULONG serial = 0;
+
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+
+	CHECK(table->LookupAdded(serial) == nullptr);
+
+	table->Bind(serial, FakeTarget(serial));
+
+	CHECK(table->LookupAdded(serial) == FakeTarget(serial));
+	CHECK(table->Lookup(serial) == nullptr);
+
+	table->SetOnline(serial);
+
+	CHECK(table->Lookup(serial) == FakeTarget(serial));
+	CHECK(table->Lookup(serial + 1) == nullptr);
+	CHECK(table->Lookup(0) == nullptr);
+
+	table->Release(serial);
+
+	CHECK(table->Lookup(serial) == nullptr);
+	CHECK(table->LookupAdded(serial) == nullptr);
+	CHECK_EQUAL(0UL, table->GetCount());
+
+	table->Cleanup();
+}
+
+TEST(ReleaseOfflineOnlyTakesOwnOfflineSerials)
+{
+	const auto table = CreateTable();
+	ULONG serial = 0;
+
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+	table->Bind(serial, FakeTarget(serial));
+
+	// Some other target
+	CHECK(!table->ReleaseOffline(serial, FakeTarget(serial + 1)));
+
+	table->SetOnline(serial);
+
+	// The device object exists now, its own cleanup releases it
+	CHECK(!table->ReleaseOffline(serial, FakeTarget(serial)));
+	CHECK(table->Lookup(serial) == FakeTarget(serial));
+
+	table->Release(serial);
+
+	// Reused by a new target
+	serial = 0;
+	CHECK_EQUAL(STATUS_SUCCESS, table->Reserve(&serial));
+	table->Bind(serial, FakeTarget(serial));
+
+	CHECK(table->ReleaseOffline(serial, FakeTarget(serial)));
+	CHECK(!table->ReleaseOffline(serial, FakeTarget(serial)));
+	CHECK_EQUAL(0UL, table->GetCount());
+
+	table->Cleanup();
+}
+
+TEST(ConcurrentLookupsSeeConsistentTargets)
+{
+	const auto table = CreateTable();
+	std::atomic<bool> done{ false };
+	std::atomic<ULONG> mismatches{ 0 };
+	std::vector<std::thread> readers;
+
+	//
+	// Lookups only ever see no target or the one bound to the serial, while
+	// the writer keeps plugging and unplugging across page boundaries
+	// 
+	for (ULONG reader = 0; reader < 3; reader++)
+	{
+		readers.emplace_back([&table, &done, &mismatches]()
+		{
+			while (!done.load())
+			{
+				for (ULONG serial = 250; serial < 270; serial++)
+				{
+					EmulationTargetPDO* target = table->Lookup(serial);
+
+					if (target != nullptr && target != FakeTarget(serial))
+						mismatches++;
+				}
+			}
+		});
+	}
+
+	for (ULONG round = 0; round < 2000; round++)
+	{
+		for (ULONG serial = 250; serial < 270; serial++)
+		{
+			ULONG reserved = serial;
+
+			if (table->Reserve(&reserved) != STATUS_SUCCESS)
+			{
+				mismatches++;
+				continue;
+			}
+
+			table->Bind(serial, FakeTarget(serial));
+			table->SetOnline(serial);
+		}
+
+		for (ULONG serial = 250; serial < 270; serial++)
+		{
+			table->Release(serial);
+		}
+	}
+
+	done = true;
+
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+
+	CHECK_EQUAL(0UL, mismatches.load());
+	CHECK_EQUAL(0UL, table->GetCount());
+
+	table->Cleanup();
+}
@@ -0,0 +1,187 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "SessionTargetList.hpp"
+#include "Test.hpp"
+
+using ViGEm::Bus::Core::SessionTargetList;
+using ViGEm::Bus::Core::SESSION_TARGET_LINK;
+
+
+TEST(EmptyList)
+{
+	SessionTargetList list;
+	ULONG serial = 0xFF;
+
+	list.Initialize();
+
+	CHECK(list.IsEmpty());
+	CHECK_EQUAL(0UL, list.GetCount());
+	CHECK_EQUAL(0UL, list.PeekSerial());
+	CHECK_EQUAL(0UL, list.TakeSerials(&serial, 1));
+	CHECK_EQUAL(0xFFUL, serial);
+}
+
+TEST(TakeSerialsInInsertionOrder)
+{
+	SessionTargetList list;
+	SESSION_TARGET_LINK links[5];
+	ULONG serials[3];
+
+	list.Initialize();
+
+	for (ULONG index = 0; index < 5; index++)
+	{
+		SessionTargetList::InitializeLink(&links[index], index + 1);
+		list.Insert(&links[index]);
+	}
+
+	CHECK_EQUAL(5UL, list.GetCount());
+	CHECK_EQUAL(1UL, list.PeekSerial());
+
+	//
+	// Batches smaller than the list leave the rest for the next call
+	// 
+	CHECK_EQUAL(3UL, list.TakeSerials(serials, 3));
+	CHECK_EQUAL(1UL, serials[0]);
+	CHECK_EQUAL(2UL, serials[1]);
+	CHECK_EQUAL(3UL, serials[2]);
+	CHECK_EQUAL(2UL, list.GetCount());
+
+	CHECK_EQUAL(2UL, list.TakeSerials(serials, 3));
+	CHECK_EQUAL(4UL, serials[0]);
+	CHECK_EQUAL(5UL, serials[1]);
+	CHECK(list.IsEmpty());
+
+	//
+	// Taken links are unlinked, removing them again is harmless
+	// 
+	SessionTargetList::Remove(&links[0]);
+	SessionTargetList::Remove(&links[4]);
+
+	CHECK(list.IsEmpty());
+}
+
+TEST(RemoveUnlinksFromAnyPosition)
+{
+	SessionTargetList list;
+	SESSION_TARGET_LINK links[3];
+	ULONG serials[3];
+
+	list.Initialize();
+
+	for (ULONG index = 0; index < 3; index++)
+	{
+		SessionTargetList::InitializeLink(&links[index], 10 + index);
+		list.Insert(&links[index]);
+	}
+
+	//
+	// Disposal of a target unlinks it without knowing its session
+	// 
+	SessionTargetList::Remove(&links[1]);
+	SessionTargetList::Remove(&links[1]);
+
+	CHECK_EQUAL(2UL, list.GetCount());
+
+	SessionTargetList::Remove(&links[0]);
+
+	CHECK_EQUAL(12UL, list.PeekSerial());
+	CHECK_EQUAL(1UL, list.TakeSerials(serials, 3));
+	CHECK_EQUAL(12UL, serials[0]);
+}
+
+TEST(InsertMovesBetweenSessions)
+{
+	SessionTargetList first;
+	SessionTargetList second;
+	SESSION_TARGET_LINK link;
+	SESSION_TARGET_LINK never;
+
+	first.Initialize();
+	second.Initialize();
+
+	SessionTargetList::InitializeLink(&link, 42);
+	SessionTargetList::InitializeLink(&never, 43);
+
+	//
+	// A link that was never inserted removes cleanly
+	// 
+	SessionTargetList::Remove(&never);
+
+	first.Insert(&link);
+	second.Insert(&link);
+
+	CHECK(first.IsEmpty());
+	CHECK_EQUAL(1UL, second.GetCount());
+	CHECK_EQUAL(42UL, second.PeekSerial());
+
+	//
+	// Inserting into the same list again doesn't duplicate it
+	// 
+	second.Insert(&link);
+
+	CHECK_EQUAL(1UL, second.GetCount());
+}
+
+TEST(TeardownOnlyTouchesOwnTargets)
+{
+	static const ULONG TARGETS = 64;
+
+	SessionTargetList sessions[4];
+	SESSION_TARGET_LINK links[TARGETS];
+	ULONG serials[TARGETS];
+
+	for (auto& session : sessions)
+		session.Initialize();
+
+	for (ULONG index = 0; index < TARGETS; index++)
+	{
+		SessionTargetList::InitializeLink(&links[index], index + 1);
+		sessions[index % 4].Insert(&links[index]);
+	}
+
+	const ULONG taken = sessions[2].TakeSerials(serials, TARGETS);
+
+	CHECK_EQUAL(TARGETS / 4, taken);
+
+	for (ULONG index = 0; index < taken; index++)
+		CHECK_EQUAL(3UL, serials[index] % 4);
+
+	CHECK(sessions[2].IsEmpty());
+	CHECK_EQUAL(TARGETS / 4, sessions[0].GetCount());
+	CHECK_EQUAL(TARGETS / 4, sessions[1].GetCount());
+	CHECK_EQUAL(TARGETS / 4, sessions[3].GetCount());
+}
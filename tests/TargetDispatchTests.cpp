@@ -0,0 +1,148 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "TargetDispatch.hpp"
+#include "Test.hpp"
+
+using ViGEm::Bus::Core::DispatchTargetAs;
+
+
+//
+// Stand-in of the target hierarchy: a tagged base with a virtual handler
+// and final concrete types
+// 
+class StandInTarget
+{
+public:
+	explicit StandInTarget(VIGEM_TARGET_TYPE Type) : _Type(Type) {}
+
+	virtual ~StandInTarget() = default;
+
+	VIGEM_TARGET_TYPE GetType() const { return this->_Type; }
+
+	virtual int Handle() { return 0; }
+
+private:
+	VIGEM_TARGET_TYPE _Type;
+};
+
+class StandInXusb final : public StandInTarget
+{
+public:
+	StandInXusb() : StandInTarget(Xbox360Wired) {}
+
+	int Handle() override { return 1; }
+
+	int Typed() const { return 10; }
+};
+
+class StandInDs4 final : public StandInTarget
+{
+public:
+	StandInDs4() : StandInTarget(DualShock4Wired) {}
+
+	int Handle() override { return 2; }
+
+	int Typed() const { return 20; }
+};
+
+//
+// Which type the handler got
+// 
+struct TypeOf
+{
+	int operator()(StandInXusb* Target) const { return Target->Typed(); }
+
+	int operator()(StandInDs4* Target) const { return Target->Typed(); }
+
+	int operator()(StandInTarget* Target) const { return 100 + Target->Handle(); }
+};
+
+template <typename Base>
+static int Dispatch(Base* Target)
+{
+	return DispatchTargetAs<StandInXusb, StandInDs4>(Target, TypeOf());
+}
+
+TEST(TagSelectsConcreteType)
+{
+	StandInXusb xusb;
+	StandInDs4 ds4;
+
+	CHECK_EQUAL(10, Dispatch<StandInTarget>(&xusb));
+	CHECK_EQUAL(20, Dispatch<StandInTarget>(&ds4));
+}
+
+TEST(UnknownTypeFallsBackToBase)
+{
+	StandInTarget unknown(static_cast<VIGEM_TARGET_TYPE>(1));
+
+	CHECK_EQUAL(100, Dispatch(&unknown));
+}
+
+TEST(GenericHandlerMatchesVirtualCall)
+{
+	StandInXusb xusb;
+	StandInDs4 ds4;
+	StandInTarget* targets[] = { &xusb, &ds4, &xusb };
+
+	for (StandInTarget* target : targets)
+	{
+		const int typed = DispatchTargetAs<StandInXusb, StandInDs4>(target, [](auto* Self)
+		{
+			return Self->Handle();
+		});
+
+		CHECK_EQUAL(target->Handle(), typed);
+	}
+}
+
+TEST(HandlerResultIsPassedThrough)
+{
+	StandInDs4 ds4;
+	StandInTarget* target = &ds4;
+	int calls = 0;
+
+	const NTSTATUS status = DispatchTargetAs<StandInXusb, StandInDs4>(target, [&calls](auto* Self)
+	{
+		(void)Self;
+		calls++;
+
+		return STATUS_INVALID_PARAMETER;
+	});
+
+	CHECK_EQUAL(STATUS_INVALID_PARAMETER, status);
+	CHECK_EQUAL(1, calls);
+}
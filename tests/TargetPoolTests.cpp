@@ -0,0 +1,264 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "TargetPool.hpp"
+#include "Test.hpp"
+
+using ViGEm::Bus::Core::SessionTargetList;
+using ViGEm::Bus::Core::SESSION_TARGET_LINK;
+using ViGEm::Bus::Core::TargetPool;
+
+
+//
+// Pool with Count targets of the type created and added, serials 1 to Count
+// 
+static void Fill(TargetPool& Pool, VIGEM_TARGET_TYPE Type, SESSION_TARGET_LINK* Links, ULONG Count)
+{
+	Pool.SetDepth(Type, Count);
+
+	CHECK_EQUAL(Count, Pool.BeginRefill(Type));
+
+	for (ULONG index = 0; index < Count; index++)
+	{
+		SessionTargetList::InitializeLink(&Links[index], index + 1);
+		Pool.Add(Type, &Links[index]);
+	}
+}
+
+TEST(DisabledPoolHoldsNothing)
+{
+	TargetPool pool;
+	SESSION_TARGET_LINK link;
+
+	pool.Initialize();
+	SessionTargetList::InitializeLink(&link, 1);
+
+	CHECK(TargetPool::IsSupported(Xbox360Wired));
+	CHECK(TargetPool::IsSupported(DualShock4Wired));
+	CHECK(!TargetPool::IsSupported(static_cast<VIGEM_TARGET_TYPE>(1)));
+
+	CHECK_EQUAL(0UL, pool.GetDepth(Xbox360Wired));
+	CHECK_EQUAL(0UL, pool.BeginRefill(Xbox360Wired));
+	CHECK_EQUAL(0UL, pool.Peek(Xbox360Wired));
+	CHECK_EQUAL(0UL, pool.Take(Xbox360Wired));
+	CHECK(!pool.Return(Xbox360Wired, &link));
+}
+
+TEST(PendingRefillsCountTowardsDepth)
+{
+	TargetPool pool;
+	SESSION_TARGET_LINK links[3];
+
+	pool.Initialize();
+	pool.SetDepth(DualShock4Wired, 3);
+
+	CHECK_EQUAL(3UL, pool.BeginRefill(DualShock4Wired));
+
+	//
+	// A second refill while the first is still creating targets adds none
+	// 
+	CHECK_EQUAL(0UL, pool.BeginRefill(DualShock4Wired));
+
+	for (ULONG index = 0; index < 3; index++)
+	{
+		SessionTargetList::InitializeLink(&links[index], index + 1);
+		pool.Add(DualShock4Wired, &links[index]);
+	}
+
+	CHECK_EQUAL(3UL, pool.GetIdleCount(DualShock4Wired));
+	CHECK_EQUAL(0UL, pool.BeginRefill(DualShock4Wired));
+
+	//
+	// Lanes are independent
+	// 
+	CHECK_EQUAL(0UL, pool.GetIdleCount(Xbox360Wired));
+}
+
+TEST(ClaimTakesOldestAndRefills)
+{
+	TargetPool pool;
+	SESSION_TARGET_LINK links[3];
+
+	pool.Initialize();
+	Fill(pool, Xbox360Wired, links, 3);
+
+	CHECK_EQUAL(1UL, pool.Peek(Xbox360Wired));
+	CHECK_EQUAL(1UL, pool.Take(Xbox360Wired));
+
+	//
+	// At least half is still idle, a released target can come back
+	// 
+	CHECK_EQUAL(0UL, pool.BeginRefill(Xbox360Wired));
+
+	CHECK_EQUAL(2UL, pool.Take(Xbox360Wired));
+	CHECK_EQUAL(1UL, pool.GetIdleCount(Xbox360Wired));
+
+	//
+	// Below half, refilling replaces exactly the claimed targets
+	// 
+	CHECK_EQUAL(2UL, pool.BeginRefill(Xbox360Wired));
+}
+
+TEST(ReleasedTargetGetsReused)
+{
+	TargetPool pool;
+	SessionTargetList session;
+	SESSION_TARGET_LINK links[2];
+
+	pool.Initialize();
+	session.Initialize();
+	Fill(pool, Xbox360Wired, links, 2);
+
+	//
+	// Claimed by a session, released again
+	// 
+	CHECK_EQUAL(1UL, pool.Take(Xbox360Wired));
+	session.Insert(&links[0]);
+
+	CHECK(pool.Return(Xbox360Wired, &links[0]));
+	CHECK(session.IsEmpty());
+	CHECK_EQUAL(2UL, pool.GetIdleCount(Xbox360Wired));
+
+	//
+	// The pool is full, a released target beyond its depth gets unplugged
+	// 
+	CHECK_EQUAL(2UL, pool.Take(Xbox360Wired));
+	CHECK_EQUAL(1UL, pool.Take(Xbox360Wired));
+	CHECK(pool.Return(Xbox360Wired, &links[0]));
+	CHECK(pool.Return(Xbox360Wired, &links[1]));
+
+	SESSION_TARGET_LINK extra;
+	SessionTargetList::InitializeLink(&extra, 3);
+
+	CHECK(!pool.Return(Xbox360Wired, &extra));
+	CHECK_EQUAL(1UL, pool.Take(Xbox360Wired));
+}
+
+TEST(ReturnLeavesRoomForPendingRefills)
+{
+	TargetPool pool;
+	SESSION_TARGET_LINK links[2];
+
+	pool.Initialize();
+	Fill(pool, Xbox360Wired, links, 2);
+
+	CHECK_EQUAL(1UL, pool.Take(Xbox360Wired));
+	CHECK_EQUAL(2UL, pool.Take(Xbox360Wired));
+
+	//
+	// The refill replacing the claimed targets is under way, taking one
+	// back would overshoot the depth once they arrive
+	// 
+	CHECK_EQUAL(2UL, pool.BeginRefill(Xbox360Wired));
+	CHECK(!pool.Return(Xbox360Wired, &links[0]));
+
+	pool.CancelRefill(Xbox360Wired, 1);
+
+	CHECK(pool.Return(Xbox360Wired, &links[0]));
+	CHECK(!pool.Return(Xbox360Wired, &links[1]));
+}
+
+TEST(FailedPlugInReleasesItsRefill)
+{
+	TargetPool pool;
+	SESSION_TARGET_LINK links[3];
+
+	pool.Initialize();
+	pool.SetDepth(DualShock4Wired, 3);
+
+	CHECK_EQUAL(3UL, pool.BeginRefill(DualShock4Wired));
+
+	for (ULONG index = 0; index < 3; index++)
+		SessionTargetList::InitializeLink(&links[index], index + 1);
+
+	pool.Add(DualShock4Wired, &links[0]);
+	pool.Add(DualShock4Wired, &links[1]);
+
+	//
+	// The second target failed to get plugged in after it was added, the
+	// third never got created
+	// 
+	pool.Discard(DualShock4Wired, &links[1]);
+	pool.CancelRefill(DualShock4Wired, 2);
+
+	CHECK_EQUAL(1UL, pool.GetIdleCount(DualShock4Wired));
+	CHECK_EQUAL(1UL, pool.Take(DualShock4Wired));
+	CHECK_EQUAL(0UL, pool.Take(DualShock4Wired));
+
+	//
+	// Nothing stays reserved, the next refill asks for the full depth
+	// 
+	CHECK_EQUAL(3UL, pool.BeginRefill(DualShock4Wired));
+}
+
+TEST(DisposedTargetLeavesPool)
+{
+	TargetPool pool;
+	SESSION_TARGET_LINK links[3];
+
+	pool.Initialize();
+	Fill(pool, Xbox360Wired, links, 3);
+
+	//
+	// Disposal unlinks a target without going through the pool
+	// 
+	SessionTargetList::Remove(&links[0]);
+	SessionTargetList::Remove(&links[2]);
+
+	CHECK_EQUAL(1UL, pool.GetIdleCount(Xbox360Wired));
+	CHECK_EQUAL(2UL, pool.Peek(Xbox360Wired));
+	CHECK_EQUAL(2UL, pool.BeginRefill(Xbox360Wired));
+}
+
+TEST(LoweredDepthGivesUpExcess)
+{
+	TargetPool pool;
+	SESSION_TARGET_LINK links[4];
+	ULONG serials[4];
+
+	pool.Initialize();
+	Fill(pool, Xbox360Wired, links, 4);
+
+	pool.SetDepth(Xbox360Wired, 1);
+
+	CHECK_EQUAL(2UL, pool.TakeExcess(Xbox360Wired, serials, 2));
+	CHECK_EQUAL(1UL, serials[0]);
+	CHECK_EQUAL(2UL, serials[1]);
+	CHECK_EQUAL(1UL, pool.TakeExcess(Xbox360Wired, serials, 4));
+	CHECK_EQUAL(3UL, serials[0]);
+	CHECK_EQUAL(0UL, pool.TakeExcess(Xbox360Wired, serials, 4));
+	CHECK_EQUAL(1UL, pool.GetIdleCount(Xbox360Wired));
+	CHECK_EQUAL(0UL, pool.BeginRefill(Xbox360Wired));
+}
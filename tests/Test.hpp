@@ -0,0 +1,94 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+//
+// Minimal test registry, every test source links TestMain.cpp.
+// 
+namespace ViGEm::Tests
+{
+	typedef void (*TEST_FUNCTION)();
+
+	typedef struct _TEST_CASE
+	{
+		const char* Name;
+
+		TEST_FUNCTION Function;
+
+	} TEST_CASE;
+
+	inline std::vector<TEST_CASE>& GetTests()
+	{
+		static std::vector<TEST_CASE> tests;
+
+		return tests;
+	}
+
+	inline int& GetFailures()
+	{
+		static int failures;
+
+		return failures;
+	}
+
+	struct Registration
+	{
+		Registration(const char* Name, TEST_FUNCTION Function)
+		{
+			GetTests().push_back({ Name, Function });
+		}
+	};
+
+	inline void Fail(const char* File, int Line, const char* Expression)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", File, Line, Expression);
+
+		GetFailures()++;
+	}
+}
+
+#define TEST(Name) \
+	static void Name(); \
+	static const ViGEm::Tests::Registration Name##Registration(#Name, Name); \
+	static void Name()
+
+#define CHECK(Expression) \
+	((Expression) ? (void)0 : ViGEm::Tests::Fail(__FILE__, __LINE__, #Expression))
+
+#define CHECK_EQUAL(Expected, Actual) CHECK((Expected) == (Actual))
@@ -0,0 +1,165 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "TickSet.hpp"
+#include "Test.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+using ViGEm::Bus::Core::TickSet;
+using ViGEm::Bus::Core::TICK_SET_LINK;
+
+
+static bool IsConsistent(const TickSet& Set, const std::vector<TICK_SET_LINK>& Links)
+{
+	ULONG members = 0;
+
+	for (const auto& link : Links)
+	{
+		if (!TickSet::Contains(&link))
+			continue;
+
+		if (link.Slot > Set.GetCount() || Set.GetAt(link.Slot - 1) != &link)
+			return false;
+
+		members++;
+	}
+
+	return members == Set.GetCount();
+}
+
+TEST(InsertAndRemove)
+{
+	TickSet set;
+	TICK_SET_LINK first, second, third;
+	int context = 0;
+
+	TickSet::InitializeLink(&first, &context);
+	TickSet::InitializeLink(&second, nullptr);
+	TickSet::InitializeLink(&third, nullptr);
+
+	CHECK(set.IsEmpty());
+	CHECK(first.Context == &context);
+	CHECK(!TickSet::Contains(&first));
+
+	CHECK_EQUAL(STATUS_SUCCESS, set.Insert(&first));
+	CHECK_EQUAL(STATUS_SUCCESS, set.Insert(&second));
+	CHECK_EQUAL(STATUS_SUCCESS, set.Insert(&third));
+
+	// Members aren't added twice
+	CHECK_EQUAL(STATUS_SUCCESS, set.Insert(&first));
+	CHECK_EQUAL(3UL, set.GetCount());
+
+	//
+	// The last member fills the gap
+	// 
+	set.Remove(&first);
+	CHECK(!TickSet::Contains(&first));
+	CHECK_EQUAL(2UL, set.GetCount());
+	CHECK(set.GetAt(0) == &third);
+	CHECK(set.GetAt(1) == &second);
+
+	// Not a member anymore
+	set.Remove(&first);
+	CHECK_EQUAL(2UL, set.GetCount());
+
+	set.Remove(&second);
+	set.Remove(&third);
+	CHECK(set.IsEmpty());
+
+	set.Cleanup();
+}
+
+TEST(GrowsAndCleansUp)
+{
+	TickSet set;
+	std::vector<TICK_SET_LINK> links(100);
+
+	for (auto& link : links)
+	{
+		TickSet::InitializeLink(&link, &link);
+		CHECK_EQUAL(STATUS_SUCCESS, set.Insert(&link));
+	}
+
+	CHECK_EQUAL(100UL, set.GetCount());
+	CHECK(IsConsistent(set, links));
+
+	set.Cleanup();
+
+	CHECK(set.IsEmpty());
+
+	for (const auto& link : links)
+	{
+		CHECK(!TickSet::Contains(&link));
+	}
+
+	// Usable again after cleanup
+	CHECK_EQUAL(STATUS_SUCCESS, set.Insert(&links[0]));
+	CHECK_EQUAL(1UL, set.GetCount());
+
+	set.Cleanup();
+}
+
+TEST(RandomChurnStaysConsistent)
+{
+	TickSet set;
+	std::vector<TICK_SET_LINK> links(64);
+
+	for (auto& link : links)
+	{
+		TickSet::InitializeLink(&link, &link);
+	}
+
+	srand(1);
+
+	for (ULONG i = 0; i < 20000; i++)
+	{
+		auto& link = links[rand() % links.size()];
+
+		if (rand() % 2)
+			CHECK_EQUAL(STATUS_SUCCESS, set.Insert(&link));
+		else
+			set.Remove(&link);
+
+		if (!IsConsistent(set, links))
+		{
+			CHECK(!"tick set consistent");
+			break;
+		}
+	}
+
+	set.Cleanup();
+}
@@ -0,0 +1,160 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "TokenBucket.hpp"
+#include "Test.hpp"
+
+using ViGEm::Bus::Core::TokenBucket;
+
+
+//
+// 100ns units
+// 
+static const ULONGLONG MILLISECOND = 10000;
+
+TEST(ZeroedBucketIsUnlimited)
+{
+	TokenBucket bucket = {};
+
+	CHECK(!bucket.IsLimited());
+
+	for (ULONG i = 0; i < 100000; i++)
+	{
+		CHECK(bucket.TryAcquire(0));
+	}
+
+	CHECK_EQUAL(5ULL, bucket.Reserve(5));
+}
+
+TEST(SustainedRateIsEnforced)
+{
+	TokenBucket bucket = {};
+
+	bucket.Configure(1000, 1);
+	CHECK(bucket.IsLimited());
+
+	CHECK(bucket.TryAcquire(0));
+	CHECK(!bucket.TryAcquire(0));
+	CHECK(!bucket.TryAcquire(MILLISECOND - 1));
+	CHECK(bucket.TryAcquire(MILLISECOND));
+	CHECK(!bucket.TryAcquire(MILLISECOND));
+
+	//
+	// Exactly one report per millisecond over a simulated second
+	// 
+	ULONG accepted = 0;
+
+	for (ULONGLONG now = 2 * MILLISECOND; now < 1002 * MILLISECOND; now += MILLISECOND / 10)
+	{
+		accepted += bucket.TryAcquire(now) ? 1 : 0;
+	}
+
+	CHECK_EQUAL(1000UL, accepted);
+}
+
+TEST(BurstRunsAheadOfRate)
+{
+	TokenBucket bucket = {};
+
+	bucket.Configure(1000, 4);
+
+	for (ULONG i = 0; i < 4; i++)
+	{
+		CHECK(bucket.TryAcquire(0));
+	}
+
+	CHECK(!bucket.TryAcquire(0));
+	CHECK(bucket.TryAcquire(MILLISECOND));
+	CHECK(!bucket.TryAcquire(MILLISECOND));
+}
+
+TEST(IdleTimeDoesNotAccumulateBeyondBurst)
+{
+	TokenBucket bucket = {};
+
+	bucket.Configure(1000, 2);
+
+	CHECK(bucket.TryAcquire(0));
+
+	//
+	// A long pause refills at most the burst
+	// 
+	const ULONGLONG later = 10000 * MILLISECOND;
+
+	CHECK(bucket.TryAcquire(later));
+	CHECK(bucket.TryAcquire(later));
+	CHECK(!bucket.TryAcquire(later));
+}
+
+TEST(ReserveReturnsDueTimes)
+{
+	TokenBucket bucket = {};
+
+	bucket.Configure(100, 2);
+
+	CHECK_EQUAL(0ULL, bucket.Reserve(0));
+	CHECK_EQUAL(0ULL, bucket.Reserve(0));
+	CHECK_EQUAL(10 * MILLISECOND, bucket.Reserve(0));
+	CHECK_EQUAL(20 * MILLISECOND, bucket.Reserve(0));
+
+	// Reservations count against later acquisitions
+	CHECK(!bucket.TryAcquire(20 * MILLISECOND));
+	CHECK(bucket.TryAcquire(30 * MILLISECOND));
+}
+
+TEST(RateAboveResolutionIsClamped)
+{
+	TokenBucket bucket = {};
+
+	bucket.Configure(MAXULONG, 1);
+
+	CHECK(bucket.TryAcquire(0));
+	CHECK(!bucket.TryAcquire(0));
+	CHECK(bucket.TryAcquire(1));
+}
+
+TEST(ZeroRateRemovesLimit)
+{
+	TokenBucket bucket = {};
+
+	bucket.Configure(1, 1);
+	CHECK(bucket.TryAcquire(0));
+	CHECK(!bucket.TryAcquire(0));
+
+	bucket.Configure(0, 0);
+	CHECK(!bucket.IsLimited());
+	CHECK(bucket.TryAcquire(0));
+	CHECK(bucket.TryAcquire(0));
+}
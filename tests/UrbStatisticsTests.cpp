@@ -0,0 +1,124 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "UrbStatistics.hpp"
+#include "Test.hpp"
+
+#include <usb.h>
+
+#include <thread>
+#include <vector>
+
+using ViGEm::Bus::Core::UrbStatistics;
+
+
+TEST(HandledFunctionsHaveOwnCounters)
+{
+	static const USHORT FUNCTIONS[] =
+	{
+		URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER,
+		URB_FUNCTION_CONTROL_TRANSFER,
+		URB_FUNCTION_CONTROL_TRANSFER_EX,
+		URB_FUNCTION_SELECT_CONFIGURATION,
+		URB_FUNCTION_SELECT_INTERFACE,
+		URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE,
+		URB_FUNCTION_GET_STATUS_FROM_DEVICE,
+		URB_FUNCTION_ABORT_PIPE,
+		URB_FUNCTION_CLASS_INTERFACE,
+		URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE,
+	};
+
+	static_assert(RTL_NUMBER_OF(FUNCTIONS) == VIGEM_URB_STAT_OTHER, "every handled function is listed");
+
+	//
+	// Listed in VIGEM_URB_STATISTIC order
+	// 
+	for (ULONG index = 0; index < RTL_NUMBER_OF(FUNCTIONS); index++)
+		CHECK_EQUAL(static_cast<VIGEM_URB_STATISTIC>(index), UrbStatistics::Classify(FUNCTIONS[index]));
+}
+
+TEST(UnhandledFunctionsShareOther)
+{
+	CHECK_EQUAL(VIGEM_URB_STAT_OTHER, UrbStatistics::Classify(URB_FUNCTION_CLASS_DEVICE));
+	CHECK_EQUAL(VIGEM_URB_STAT_OTHER, UrbStatistics::Classify(URB_FUNCTION_SYNC_RESET_PIPE_AND_CLEAR_STALL));
+	CHECK_EQUAL(VIGEM_URB_STAT_OTHER, UrbStatistics::Classify(MAXUSHORT));
+}
+
+TEST(ZeroedCountersSnapshotEmpty)
+{
+	UrbStatistics statistics{};
+	ULONGLONG counts[VIGEM_URB_STAT_COUNT];
+
+	statistics.Snapshot(counts);
+
+	for (const auto count : counts)
+		CHECK_EQUAL(0ULL, count);
+}
+
+TEST(ConcurrentHitsAreCounted)
+{
+	static const ULONG THREADS = 4;
+	static const ULONG HITS = 10000;
+
+	UrbStatistics statistics{};
+	std::vector<std::thread> threads;
+	ULONGLONG counts[VIGEM_URB_STAT_COUNT];
+
+	for (ULONG index = 0; index < THREADS; index++)
+	{
+		threads.emplace_back([&statistics, index]
+		{
+			for (ULONG hit = 0; hit < HITS; hit++)
+			{
+				statistics.Hit(VIGEM_URB_STAT_BULK_OR_INTERRUPT_TRANSFER);
+
+				if (hit % 100 == 0)
+					statistics.Hit(static_cast<VIGEM_URB_STATISTIC>(1 + index));
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	statistics.Snapshot(counts);
+
+	CHECK_EQUAL(static_cast<ULONGLONG>(THREADS) * HITS, counts[VIGEM_URB_STAT_BULK_OR_INTERRUPT_TRANSFER]);
+
+	for (ULONG index = 0; index < THREADS; index++)
+		CHECK_EQUAL(static_cast<ULONGLONG>(HITS / 100), counts[1 + index]);
+
+	CHECK_EQUAL(0ULL, counts[VIGEM_URB_STAT_OTHER]);
+}
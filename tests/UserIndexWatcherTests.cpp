@@ -0,0 +1,156 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "UserIndexWatcher.hpp"
+#include "Test.hpp"
+
+using ViGEm::Bus::Core::UserIndexWatcher;
+
+
+static bool Apply(UserIndexWatcher& Watcher, UCHAR Pattern, CHAR* Previous)
+{
+	const UCHAR packet[UserIndexWatcher::LED_PACKET_SIZE] = { 0x01, 0x03, Pattern };
+
+	return Watcher.ApplyLedPacket(packet, sizeof(packet), Previous);
+}
+
+TEST(StartsUnassigned)
+{
+	UserIndexWatcher watcher;
+
+	CHECK_EQUAL(UserIndexWatcher::UNASSIGNED, watcher.Get());
+}
+
+TEST(QuadrantPatternsSetIndex)
+{
+	UserIndexWatcher watcher;
+	CHAR previous = 0;
+
+	CHECK(Apply(watcher, 0x02, &previous));
+	CHECK_EQUAL(UserIndexWatcher::UNASSIGNED, previous);
+	CHECK_EQUAL(0, watcher.Get());
+
+	for (UCHAR pattern = 0x03; pattern <= 0x05; pattern++)
+	{
+		CHECK(Apply(watcher, pattern, &previous));
+		CHECK_EQUAL(pattern - 0x03, previous);
+		CHECK_EQUAL(pattern - 0x02, watcher.Get());
+	}
+}
+
+TEST(SameIndexIsNoChange)
+{
+	UserIndexWatcher watcher;
+	CHAR previous = 0;
+
+	CHECK(Apply(watcher, 0x04, &previous));
+	CHECK(!Apply(watcher, 0x04, &previous));
+	CHECK_EQUAL(2, previous);
+	CHECK_EQUAL(2, watcher.Get());
+}
+
+TEST(OtherPatternsKeepIndex)
+{
+	UserIndexWatcher watcher;
+	CHAR previous = 0;
+
+	//
+	// Off, blinking all and the blink-then-on patterns before any index
+	// 
+	CHECK(!Apply(watcher, 0x00, &previous));
+	CHECK(!Apply(watcher, 0x01, &previous));
+	CHECK(!Apply(watcher, 0x06, &previous));
+	CHECK_EQUAL(UserIndexWatcher::UNASSIGNED, watcher.Get());
+
+	CHECK(Apply(watcher, 0x03, &previous));
+
+	for (UCHAR pattern = 0x06; pattern <= 0x0D; pattern++)
+		CHECK(!Apply(watcher, pattern, &previous));
+
+	CHECK(!Apply(watcher, 0xFF, &previous));
+	CHECK_EQUAL(1, watcher.Get());
+}
+
+TEST(MalformedPacketsAreIgnored)
+{
+	UserIndexWatcher watcher;
+	CHAR previous = 0;
+
+	const UCHAR rumble[] = { 0x00, 0x08, 0x00, 0x40, 0x40, 0x00, 0x00, 0x00 };
+	const UCHAR wrongType[] = { 0x02, 0x03, 0x02 };
+	const UCHAR wrongSize[] = { 0x01, 0x02, 0x02 };
+	const UCHAR valid[] = { 0x01, 0x03, 0x02 };
+
+	CHECK(!watcher.ApplyLedPacket(rumble, sizeof(rumble), &previous));
+	CHECK(!watcher.ApplyLedPacket(wrongType, sizeof(wrongType), &previous));
+	CHECK(!watcher.ApplyLedPacket(wrongSize, sizeof(wrongSize), &previous));
+	CHECK(!watcher.ApplyLedPacket(valid, sizeof(valid) - 1, &previous));
+	CHECK_EQUAL(UserIndexWatcher::UNASSIGNED, watcher.Get());
+
+	CHECK(watcher.ApplyLedPacket(valid, sizeof(valid), &previous));
+	CHECK_EQUAL(0, watcher.Get());
+}
+
+TEST(ResetForgetsIndex)
+{
+	UserIndexWatcher watcher;
+	CHAR previous = 0;
+
+	CHECK(Apply(watcher, 0x05, &previous));
+
+	watcher.Reset();
+
+	CHECK_EQUAL(UserIndexWatcher::UNASSIGNED, watcher.Get());
+
+	//
+	// The same index is news again after a reset
+	// 
+	CHECK(Apply(watcher, 0x05, &previous));
+	CHECK_EQUAL(UserIndexWatcher::UNASSIGNED, previous);
+}
+
+TEST(SatisfiesOnlyNewIndex)
+{
+	CHECK(!UserIndexWatcher::Satisfies(UserIndexWatcher::UNASSIGNED, -1));
+	CHECK(!UserIndexWatcher::Satisfies(UserIndexWatcher::UNASSIGNED, 0));
+	CHECK(UserIndexWatcher::Satisfies(0, -1));
+	CHECK(!UserIndexWatcher::Satisfies(0, 0));
+	CHECK(UserIndexWatcher::Satisfies(3, 0));
+
+	//
+	// Whatever a feeder passes as known, a real index differs from junk
+	// 
+	CHECK(UserIndexWatcher::Satisfies(1, 1000));
+}
@@ -0,0 +1,203 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Scenarios.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ViGEm::Bench;
+
+
+//
+// Scale of --quick, enough to smoke test every path
+// 
+static const double QUICK_SCALE = 0.02;
+
+static void PrintUsage(const char* Program)
+{
+	fprintf(stderr, "usage: %s [--json] [--quick | --scale <factor>] [--scenario <name>]...\n\nscenarios:\n", Program);
+
+	for (const auto& scenario : GetScenarios())
+		fprintf(stderr, "  %s\n", scenario.Name);
+}
+
+static double GetThroughput(const BENCH_RESULT& Result)
+{
+	return (Result.Seconds > 0) ? static_cast<double>(Result.Operations) / Result.Seconds : 0;
+}
+
+static double GetAllocationsPerOperation(const BENCH_RESULT& Result)
+{
+	return Result.Operations ? static_cast<double>(Result.Allocations) / static_cast<double>(Result.Operations) : 0;
+}
+
+static void PrintText(const Transport& Bus, const std::vector<BENCH_RESULT>& Results)
+{
+	printf("transport: %s\n\n", Bus.GetName());
+	printf("%-36s %10s %12s %10s %10s %10s %10s %8s\n",
+	       "scenario", "ops", "ops/s", "p50 us", "p99 us", "p999 us", "allocs/op", "missed");
+
+	for (const auto& result : Results)
+	{
+		printf("%-36s %10llu %12.0f %10.2f %10.2f %10.2f %10.3f %8llu\n",
+		       result.Name.c_str(),
+		       result.Operations,
+		       GetThroughput(result),
+		       result.P50 / 1000.0,
+		       result.P99 / 1000.0,
+		       result.P999 / 1000.0,
+		       GetAllocationsPerOperation(result),
+		       result.Missed);
+	}
+}
+
+//
+// One object per run, latencies in nanoseconds, meant for trend tracking
+// 
+static void PrintJson(const Transport& Bus, double Scale, const std::vector<BENCH_RESULT>& Results)
+{
+	printf("{\n  \"transport\": \"%s\",\n  \"scale\": %g,\n  \"results\": [", Bus.GetName(), Scale);
+
+	for (size_t i = 0; i < Results.size(); i++)
+	{
+		const auto& result = Results[i];
+
+		printf("%s\n    {\"scenario\": \"%s\", \"operations\": %llu, \"seconds\": %.6f, \"throughput\": %.3f, "
+		       "\"samples\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, "
+		       "\"allocations\": %llu, \"allocations_per_op\": %.6f, \"missed\": %llu}",
+		       i ? "," : "",
+		       result.Name.c_str(),
+		       result.Operations,
+		       result.Seconds,
+		       GetThroughput(result),
+		       result.Samples,
+		       result.P50,
+		       result.P99,
+		       result.P999,
+		       result.Allocations,
+		       GetAllocationsPerOperation(result),
+		       result.Missed);
+	}
+
+	printf("\n  ]\n}\n");
+}
+
+int main(int argc, char* argv[])
+{
+	BENCH_OPTIONS options = { 1.0 };
+	std::vector<const BENCH_SCENARIO*> selected;
+	bool json = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--json") == 0)
+		{
+			json = true;
+		}
+		else if (strcmp(argv[i], "--quick") == 0)
+		{
+			options.Scale = QUICK_SCALE;
+		}
+		else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+		{
+			options.Scale = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			const BENCH_SCENARIO* match = nullptr;
+
+			for (const auto& scenario : GetScenarios())
+			{
+				if (strcmp(scenario.Name, name) == 0)
+					match = &scenario;
+			}
+
+			if (!match)
+			{
+				PrintUsage(argv[0]);
+				return 2;
+			}
+
+			selected.push_back(match);
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 2;
+		}
+	}
+
+	if (options.Scale <= 0)
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	if (selected.empty())
+	{
+		for (const auto& scenario : GetScenarios())
+			selected.push_back(&scenario);
+	}
+
+	const auto bus = CreateTransport();
+
+	if (!bus)
+	{
+		fprintf(stderr, "bus not available\n");
+		return 1;
+	}
+
+	std::vector<BENCH_RESULT> results;
+	int status = 0;
+
+	for (const auto scenario : selected)
+	{
+		if (!scenario->Run(*bus, options, results))
+		{
+			fprintf(stderr, "scenario %s failed\n", scenario->Name);
+			status = 3;
+		}
+	}
+
+	if (json)
+		PrintJson(*bus, options.Scale, results);
+	else
+		PrintText(*bus, results);
+
+	return status;
+}
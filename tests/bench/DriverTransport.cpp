@@ -0,0 +1,216 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Transport.hpp"
+
+#include <ViGEm/Client.h>
+#include <Xinput.h>
+
+
+namespace ViGEm::Bench
+{
+	//
+	// Drives the installed bus driver through the client library.
+	// 
+	// Vibration is sent through XInput to the user index the target got
+	// assigned, so it takes the same path as rumble from a game.
+	// 
+	class DriverTransport final : public Transport
+	{
+	public:
+		~DriverTransport() override;
+
+		bool Open();
+
+		const char* GetName() const override { return "driver"; }
+
+		bool Plug(BENCH_TARGET* Target) override;
+
+		void Unplug(BENCH_TARGET Target) override;
+
+		bool Submit(BENCH_TARGET Target, const XUSB_REPORT& Report) override;
+
+		bool RegisterRumble(BENCH_TARGET Target, BENCH_RUMBLE_CALLBACK Callback, PVOID Context) override;
+
+		bool Rumble(BENCH_TARGET Target, UCHAR LargeMotor, UCHAR SmallMotor) override;
+
+	private:
+		//
+		// How long XInput gets to assign a user index
+		// 
+		static const ULONG USER_INDEX_TIMEOUT_MS = 2000;
+
+		typedef struct _DRIVER_TARGET
+		{
+			PVIGEM_TARGET Target;
+
+			ULONG UserIndex;
+
+			BENCH_RUMBLE_CALLBACK Callback;
+
+			PVOID Context;
+
+		} DRIVER_TARGET, *PDRIVER_TARGET;
+
+		static VOID CALLBACK OnNotification(PVIGEM_CLIENT Client, PVIGEM_TARGET Target, UCHAR LargeMotor,
+		                                    UCHAR SmallMotor, UCHAR LedNumber, LPVOID UserData);
+
+		PVIGEM_CLIENT _Client{};
+	};
+}
+
+ViGEm::Bench::DriverTransport::~DriverTransport()
+{
+	if (this->_Client)
+	{
+		vigem_disconnect(this->_Client);
+		vigem_free(this->_Client);
+	}
+}
+
+bool ViGEm::Bench::DriverTransport::Open()
+{
+	this->_Client = vigem_alloc();
+
+	return this->_Client && VIGEM_SUCCESS(vigem_connect(this->_Client));
+}
+
+bool ViGEm::Bench::DriverTransport::Plug(BENCH_TARGET* Target)
+{
+	const auto target = new DRIVER_TARGET();
+
+	target->Target = vigem_target_x360_alloc();
+	target->UserIndex = XUSER_MAX_COUNT;
+
+	if (!target->Target || !VIGEM_SUCCESS(vigem_target_add(this->_Client, target->Target)))
+	{
+		if (target->Target)
+			vigem_target_free(target->Target);
+
+		delete target;
+		return false;
+	}
+
+	*Target = target;
+
+	return true;
+}
+
+void ViGEm::Bench::DriverTransport::Unplug(BENCH_TARGET Target)
+{
+	const auto target = static_cast<PDRIVER_TARGET>(Target);
+
+	if (target->Callback)
+		vigem_target_x360_unregister_notification(target->Target);
+
+	vigem_target_remove(this->_Client, target->Target);
+	vigem_target_free(target->Target);
+
+	delete target;
+}
+
+bool ViGEm::Bench::DriverTransport::Submit(BENCH_TARGET Target, const XUSB_REPORT& Report)
+{
+	const auto target = static_cast<PDRIVER_TARGET>(Target);
+
+	return VIGEM_SUCCESS(vigem_target_x360_update(this->_Client, target->Target, Report));
+}
+
+bool ViGEm::Bench::DriverTransport::RegisterRumble(BENCH_TARGET Target, BENCH_RUMBLE_CALLBACK Callback,
+                                                   PVOID Context)
+{
+	const auto target = static_cast<PDRIVER_TARGET>(Target);
+	ULONG index = XUSER_MAX_COUNT;
+
+	//
+	// The user index is only known once XInput picked up the device
+	// 
+	for (ULONG waited = 0; waited < USER_INDEX_TIMEOUT_MS; waited += 10)
+	{
+		if (VIGEM_SUCCESS(vigem_target_x360_get_user_index(this->_Client, target->Target, &index)))
+			break;
+
+		Sleep(10);
+	}
+
+	if (index >= XUSER_MAX_COUNT)
+		return false;
+
+	target->UserIndex = index;
+	target->Callback = Callback;
+	target->Context = Context;
+
+	return VIGEM_SUCCESS(vigem_target_x360_register_notification(this->_Client, target->Target, OnNotification, target));
+}
+
+bool ViGEm::Bench::DriverTransport::Rumble(BENCH_TARGET Target, UCHAR LargeMotor, UCHAR SmallMotor)
+{
+	const auto target = static_cast<PDRIVER_TARGET>(Target);
+	XINPUT_VIBRATION vibration;
+
+	if (target->UserIndex >= XUSER_MAX_COUNT)
+		return false;
+
+	//
+	// The device receives the upper byte of each motor speed
+	// 
+	vibration.wLeftMotorSpeed = static_cast<WORD>(LargeMotor << 8);
+	vibration.wRightMotorSpeed = static_cast<WORD>(SmallMotor << 8);
+
+	return XInputSetState(target->UserIndex, &vibration) == ERROR_SUCCESS;
+}
+
+VOID CALLBACK ViGEm::Bench::DriverTransport::OnNotification(PVIGEM_CLIENT Client, PVIGEM_TARGET Target,
+                                                             UCHAR LargeMotor, UCHAR SmallMotor, UCHAR LedNumber,
+                                                             LPVOID UserData)
+{
+	UNREFERENCED_PARAMETER(Client);
+	UNREFERENCED_PARAMETER(Target);
+	UNREFERENCED_PARAMETER(LedNumber);
+
+	const auto target = static_cast<PDRIVER_TARGET>(UserData);
+
+	target->Callback(target->Context, LargeMotor, SmallMotor);
+}
+
+std::unique_ptr<ViGEm::Bench::Transport> ViGEm::Bench::CreateTransport()
+{
+	auto transport = std::make_unique<DriverTransport>();
+
+	if (!transport->Open())
+		return nullptr;
+
+	return transport;
+}
@@ -0,0 +1,3530 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Scenarios.hpp"
+
+#ifndef _WIN32
+#include "AxisTransform.hpp"
+#include "EventRing.hpp"
+#include "IdentityTable.hpp"
+#include "IdleTracker.hpp"
+#include "MacroScheduler.hpp"
+#include "MockBus.hpp"
+#include "MockDiscovery.hpp"
+#include "PluginTimeline.hpp"
+#include "PollPhase.hpp"
+#include "RawOutputRing.hpp"
+#include "ReportRecorder.hpp"
+#include "SessionTargetList.hpp"
+#include "TargetDispatch.hpp"
+#include "TargetPool.hpp"
+#include "TickSet.hpp"
+#include "TokenBucket.hpp"
+#include "UrbStatistics.hpp"
+
+#include <ViGEm/Client.hpp>
+#include <ViGEm/km/BusShared.h>
+#include <usb.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace ViGEm::Bench;
+
+
+//
+// Host polling rate the feed scenarios keep up with
+// 
+static const ULONGLONG FEED_PERIOD_NS = 1000000;
+
+//
+// Vibration values are unique per message within this many messages
+// 
+static const ULONG RUMBLE_KEYS = 0x10000;
+
+static const ULONGLONG SECOND_NS = 1000000000;
+
+static ULONGLONG Scaled(const BENCH_OPTIONS& Options, ULONGLONG Value)
+{
+	return std::max(static_cast<ULONGLONG>(static_cast<double>(Value) * Options.Scale), 1ULL);
+}
+
+static double GetSeconds(ULONGLONG Start, ULONGLONG End)
+{
+	return static_cast<double>(End - Start) / SECOND_NS;
+}
+
+//
+// Sleeping is too coarse for a 1ms period on Windows, spin instead
+// 
+static void WaitUntil(ULONGLONG Deadline)
+{
+	while (GetTimestamp() < Deadline)
+		std::this_thread::yield();
+}
+
+//
+// Report with every field changing between submissions
+// 
+static XUSB_REPORT MakeReport(ULONGLONG Sequence)
+{
+	XUSB_REPORT report = {};
+
+	report.wButtons = static_cast<USHORT>((Sequence & 1) ? XUSB_GAMEPAD_A : XUSB_GAMEPAD_B);
+	report.bLeftTrigger = static_cast<BYTE>(Sequence);
+	report.bRightTrigger = static_cast<BYTE>(~Sequence);
+	report.sThumbLX = static_cast<SHORT>(Sequence * 7);
+	report.sThumbLY = static_cast<SHORT>(Sequence * 13);
+	report.sThumbRX = static_cast<SHORT>(-static_cast<LONGLONG>(Sequence));
+	report.sThumbRY = static_cast<SHORT>(Sequence << 4);
+
+	return report;
+}
+
+static bool PlugTargets(Transport& Bus, std::vector<BENCH_TARGET>& Targets, size_t Count)
+{
+	for (size_t i = 0; i < Count; i++)
+	{
+		BENCH_TARGET target;
+
+		if (!Bus.Plug(&target))
+			return false;
+
+		Targets.push_back(target);
+	}
+
+	return true;
+}
+
+static void UnplugTargets(Transport& Bus, std::vector<BENCH_TARGET>& Targets)
+{
+	for (const auto target : Targets)
+		Bus.Unplug(target);
+
+	Targets.clear();
+}
+
+#pragma region Rumble tracking
+
+//
+// Matches delivered vibration to the time it was sent
+// 
+typedef struct _RUMBLE_TRACKER
+{
+	explicit _RUMBLE_TRACKER(size_t Capacity) : Sent(RUMBLE_KEYS), Latencies(Capacity) {}
+
+	std::vector<std::atomic<ULONGLONG>> Sent;
+
+	LatencyRecorder Latencies;
+
+	std::atomic<ULONGLONG> Delivered{ 0 };
+
+	std::atomic<ULONGLONG> LastDelivery{ 0 };
+
+	ULONGLONG Next{ 0 };
+
+} RUMBLE_TRACKER, *PRUMBLE_TRACKER;
+
+static void OnRumble(PVOID Context, UCHAR LargeMotor, UCHAR SmallMotor)
+{
+	const auto tracker = static_cast<PRUMBLE_TRACKER>(Context);
+	const ULONGLONG sent = tracker->Sent[(LargeMotor << 8) | SmallMotor].exchange(0);
+
+	//
+	// Repeated deliveries of one value count once
+	// 
+	if (sent == 0)
+		return;
+
+	const ULONGLONG now = GetTimestamp();
+
+	tracker->Latencies.Add(now - sent);
+	tracker->LastDelivery.store(now);
+	tracker->Delivered++;
+}
+
+static bool SendRumble(Transport& Bus, BENCH_TARGET Target, RUMBLE_TRACKER& Tracker)
+{
+	//
+	// Key 0 is all motors off, skip it
+	// 
+	const ULONG key = static_cast<ULONG>(Tracker.Next++ % (RUMBLE_KEYS - 1)) + 1;
+
+	Tracker.Sent[key].store(GetTimestamp());
+
+	return Bus.Rumble(Target, static_cast<UCHAR>(key >> 8), static_cast<UCHAR>(key));
+}
+
+//
+// Waits for notifications still in flight until none arrived for a while,
+// returns the time of the last delivery
+// 
+static ULONGLONG WaitForRumble(const RUMBLE_TRACKER& Tracker, ULONGLONG Sent, ULONGLONG SendEnd)
+{
+	static const ULONGLONG QUIET_NS = 100000000;
+
+	ULONGLONG delivered = Tracker.Delivered.load();
+	ULONGLONG progress = GetTimestamp();
+
+	while (delivered < Sent && GetTimestamp() - progress < QUIET_NS)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		if (Tracker.Delivered.load() != delivered)
+		{
+			delivered = Tracker.Delivered.load();
+			progress = GetTimestamp();
+		}
+	}
+
+	return std::max(Tracker.LastDelivery.load(), SendEnd);
+}
+
+#pragma endregion
+
+#pragma region Scenarios
+
+//
+// One target, reports submitted back to back
+// 
+static bool SinglePadStorm(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	const ULONGLONG count = Scaled(Options, 200000);
+	const ULONGLONG budget = Scaled(Options, 10 * SECOND_NS);
+	std::vector<BENCH_TARGET> targets;
+	LatencyRecorder latencies(count);
+	ULONGLONG submitted = 0;
+	bool failed = false;
+
+	if (!PlugTargets(Bus, targets, 1))
+	{
+		UnplugTargets(Bus, targets);
+		return false;
+	}
+
+	const ULONGLONG allocations = GetAllocationCount();
+	const ULONGLONG start = GetTimestamp();
+	ULONGLONG now = start;
+
+	while (submitted < count && now - start < budget)
+	{
+		if (!Bus.Submit(targets[0], MakeReport(submitted)))
+		{
+			failed = true;
+			break;
+		}
+
+		const ULONGLONG done = GetTimestamp();
+
+		latencies.Add(done - now);
+		now = done;
+		submitted++;
+	}
+
+	Results.push_back(Summarize("single_pad_storm", latencies, submitted, GetSeconds(start, now), 0,
+	                            GetAllocationCount() - allocations));
+
+	UnplugTargets(Bus, targets);
+
+	return !failed;
+}
+
+//
+// Many targets, each fed one report per host poll
+// 
+static bool FeedTargets(Transport& Bus, const std::vector<BENCH_TARGET>& Targets, ULONGLONG Ticks,
+                        const std::atomic<bool>* Stop, LatencyRecorder& Latencies, ULONGLONG& Submitted,
+                        ULONGLONG& LateTicks)
+{
+	const ULONGLONG start = GetTimestamp();
+
+	for (ULONGLONG tick = 0; tick < Ticks && !(Stop && Stop->load()); tick++)
+	{
+		const ULONGLONG deadline = start + tick * FEED_PERIOD_NS;
+
+		WaitUntil(deadline);
+
+		ULONGLONG now = GetTimestamp();
+
+		if (now - deadline > FEED_PERIOD_NS)
+			LateTicks++;
+
+		for (const auto target : Targets)
+		{
+			if (!Bus.Submit(target, MakeReport(tick)))
+				return false;
+
+			const ULONGLONG done = GetTimestamp();
+
+			Latencies.Add(done - now);
+			now = done;
+			Submitted++;
+		}
+	}
+
+	return true;
+}
+
+static bool Feed64Pads(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const size_t PADS = 64;
+
+	const ULONGLONG ticks = Scaled(Options, 5000);
+	std::vector<BENCH_TARGET> targets;
+	LatencyRecorder latencies(PADS * ticks);
+	ULONGLONG submitted = 0;
+	ULONGLONG late = 0;
+
+	if (!PlugTargets(Bus, targets, PADS))
+	{
+		UnplugTargets(Bus, targets);
+		return false;
+	}
+
+	const ULONGLONG allocations = GetAllocationCount();
+	const ULONGLONG start = GetTimestamp();
+
+	const bool fed = FeedTargets(Bus, targets, ticks, nullptr, latencies, submitted, late);
+
+	const ULONGLONG end = GetTimestamp();
+
+	Results.push_back(Summarize("feed_64_pads_1khz", latencies, submitted, GetSeconds(start, end), late,
+	                            GetAllocationCount() - allocations));
+
+	UnplugTargets(Bus, targets);
+
+	return fed;
+}
+
+//
+// Vibration sent to one target as fast as possible, timed until delivery
+// 
+static bool RumbleFlood(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	const ULONGLONG count = Scaled(Options, 20000);
+	const ULONGLONG budget = Scaled(Options, 10 * SECOND_NS);
+	std::vector<BENCH_TARGET> targets;
+	RUMBLE_TRACKER tracker(count);
+	ULONGLONG sent = 0;
+
+	if (!PlugTargets(Bus, targets, 1) || !Bus.RegisterRumble(targets[0], OnRumble, &tracker))
+	{
+		UnplugTargets(Bus, targets);
+		return false;
+	}
+
+	const ULONGLONG allocations = GetAllocationCount();
+	const ULONGLONG start = GetTimestamp();
+
+	while (sent < count && GetTimestamp() - start < budget && SendRumble(Bus, targets[0], tracker))
+		sent++;
+
+	const ULONGLONG end = WaitForRumble(tracker, sent, GetTimestamp());
+	const ULONGLONG delivered = tracker.Delivered.load();
+
+	//
+	// Stop callbacks before the tracker goes away
+	// 
+	UnplugTargets(Bus, targets);
+
+	Results.push_back(Summarize("rumble_flood", tracker.Latencies, sent, GetSeconds(start, end),
+	                            sent - std::min(delivered, sent), GetAllocationCount() - allocations));
+
+	return sent > 0;
+}
+
+//
+// Targets plugged in and removed again in a loop
+// 
+static bool PlugChurn(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	const ULONGLONG count = Scaled(Options, 2000);
+	const ULONGLONG budget = Scaled(Options, 30 * SECOND_NS);
+	LatencyRecorder plugLatencies(count);
+	LatencyRecorder unplugLatencies(count);
+	ULONGLONG plugAllocations = 0;
+	ULONGLONG unplugAllocations = 0;
+	ULONGLONG cycles = 0;
+	bool plugged = true;
+
+	const ULONGLONG start = GetTimestamp();
+	ULONGLONG now = start;
+
+	while (cycles < count && now - start < budget)
+	{
+		BENCH_TARGET target;
+		ULONGLONG allocations = GetAllocationCount();
+
+		if (!Bus.Plug(&target))
+		{
+			plugged = false;
+			break;
+		}
+
+		ULONGLONG done = GetTimestamp();
+
+		plugAllocations += GetAllocationCount() - allocations;
+		plugLatencies.Add(done - now);
+		now = done;
+
+		allocations = GetAllocationCount();
+
+		Bus.Unplug(target);
+
+		done = GetTimestamp();
+
+		unplugAllocations += GetAllocationCount() - allocations;
+		unplugLatencies.Add(done - now);
+		now = done;
+
+		cycles++;
+	}
+
+	const double seconds = GetSeconds(start, now);
+
+	Results.push_back(Summarize("plug_churn/plug", plugLatencies, cycles, seconds, 0, plugAllocations));
+	Results.push_back(Summarize("plug_churn/unplug", unplugLatencies, cycles, seconds, 0, unplugAllocations));
+
+	return plugged;
+}
+
+//
+// Feed, vibration and churn at the same time
+// 
+static bool Mixed(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const size_t PADS = 8;
+	static const ULONGLONG CHURN_PERIOD_NS = 10000000;
+
+	const ULONGLONG duration = Scaled(Options, 5 * SECOND_NS);
+	const ULONGLONG ticks = duration / FEED_PERIOD_NS;
+	std::vector<BENCH_TARGET> feedTargets;
+	std::vector<BENCH_TARGET> rumbleTargets;
+	LatencyRecorder feedLatencies(PADS * ticks);
+	LatencyRecorder plugLatencies(duration / CHURN_PERIOD_NS + 1);
+	RUMBLE_TRACKER tracker(ticks);
+	std::atomic<bool> stop{ false };
+	ULONGLONG submitted = 0, late = 0, sent = 0, cycles = 0;
+	bool fed = true, churned = true;
+
+	//
+	// The rumble target goes first, XInput only assigns four user indices
+	// 
+	if (!PlugTargets(Bus, rumbleTargets, 1)
+		|| !Bus.RegisterRumble(rumbleTargets[0], OnRumble, &tracker)
+		|| !PlugTargets(Bus, feedTargets, PADS))
+	{
+		UnplugTargets(Bus, rumbleTargets);
+		UnplugTargets(Bus, feedTargets);
+		return false;
+	}
+
+	const ULONGLONG allocations = GetAllocationCount();
+	const ULONGLONG start = GetTimestamp();
+
+	std::thread feeder([&]()
+	{
+		fed = FeedTargets(Bus, feedTargets, ticks, &stop, feedLatencies, submitted, late);
+	});
+
+	std::thread churner([&]()
+	{
+		for (ULONGLONG deadline = start; !stop.load(); deadline += CHURN_PERIOD_NS)
+		{
+			BENCH_TARGET target;
+
+			WaitUntil(deadline);
+
+			const ULONGLONG begin = GetTimestamp();
+
+			if (!Bus.Plug(&target))
+			{
+				churned = false;
+				break;
+			}
+
+			plugLatencies.Add(GetTimestamp() - begin);
+
+			Bus.Unplug(target);
+			cycles++;
+		}
+	});
+
+	for (ULONGLONG deadline = start; deadline < start + duration; deadline += FEED_PERIOD_NS)
+	{
+		WaitUntil(deadline);
+
+		if (!SendRumble(Bus, rumbleTargets[0], tracker))
+			break;
+
+		sent++;
+	}
+
+	feeder.join();
+
+	stop = true;
+
+	churner.join();
+
+	const ULONGLONG end = WaitForRumble(tracker, sent, GetTimestamp());
+	const ULONGLONG delivered = tracker.Delivered.load();
+
+	UnplugTargets(Bus, rumbleTargets);
+	UnplugTargets(Bus, feedTargets);
+
+	//
+	// Allocations can't be told apart between the threads, each result
+	// carries those of the whole scenario
+	// 
+	const double seconds = GetSeconds(start, end);
+	const ULONGLONG allocated = GetAllocationCount() - allocations;
+
+	Results.push_back(Summarize("mixed/submit", feedLatencies, submitted, seconds, late, allocated));
+	Results.push_back(Summarize("mixed/rumble", tracker.Latencies, sent, seconds, sent - std::min(delivered, sent),
+	                            allocated));
+	Results.push_back(Summarize("mixed/plug", plugLatencies, cycles, seconds, 0, allocated));
+
+	return fed && churned;
+}
+
+#ifndef _WIN32
+
+static volatile ULONGLONG g_TransformSink;
+
+//
+// Cost of the axis transform on one report, without any transport
+// 
+static bool TransformCost(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG BATCH = 256;
+
+	const ULONGLONG batches = Scaled(Options, 20000);
+	ViGEm::Bus::Core::AxisTransform transform;
+	VIGEM_AXIS_PROFILE profiles[VIGEM_AXIS_COUNT];
+	XUSB_REPORT reports[BATCH];
+	LatencyRecorder latencies(batches);
+	ULONGLONG checksum = 0;
+
+	(void)Bus;
+
+	//
+	// Deadzone and a non-linear curve on every axis, the worst case
+	// 
+	for (ULONG axis = 0; axis < VIGEM_AXIS_COUNT; axis++)
+	{
+		VIGEM_AXIS_PROFILE_INIT(&profiles[axis], static_cast<VIGEM_AXIS>(axis));
+
+		profiles[axis].Deadzone = 2000;
+
+		for (ULONG point = 0; point < VIGEM_AXIS_CURVE_POINTS; point++)
+			profiles[axis].Curve[point] = static_cast<USHORT>(point * point * 127);
+	}
+
+	if (!NT_SUCCESS(transform.Load(profiles)))
+		return false;
+
+	for (ULONG i = 0; i < BATCH; i++)
+		reports[i] = MakeReport(i * 2654435761ULL);
+
+	const ULONGLONG allocations = GetAllocationCount();
+	const ULONGLONG start = GetTimestamp();
+	ULONGLONG now = start;
+
+	//
+	// Timing single reports would mostly measure the clock
+	// 
+	for (ULONGLONG batch = 0; batch < batches; batch++)
+	{
+		for (ULONG i = 0; i < BATCH; i++)
+		{
+			LONG axes[VIGEM_AXIS_COUNT];
+			XUSB_REPORT output;
+
+			ViGEm::Bus::Core::AxisTransform::FromXusbReport(&reports[i], axes);
+			transform.Apply(axes);
+			ViGEm::Bus::Core::AxisTransform::ToXusbReport(axes, &output);
+
+			checksum += static_cast<USHORT>(output.sThumbLX) + output.bLeftTrigger;
+		}
+
+		const ULONGLONG done = GetTimestamp();
+
+		latencies.Add((done - now) / BATCH);
+		now = done;
+	}
+
+	//
+	// Keeps the loop from being optimized away
+	// 
+	g_TransformSink = checksum;
+
+	Results.push_back(Summarize("transform_cost", latencies, batches * BATCH, GetSeconds(start, now), 0,
+	                            GetAllocationCount() - allocations));
+
+	return true;
+}
+
+//
+// Cost of recording one event into the per-processor rings the bus
+// traces hot paths with, drained after every batch like a tracing session
+// 
+static bool EventRecordCost(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG BATCH = 256;
+	static const ULONG PROCESSORS = 4;
+
+	const ULONGLONG batches = Scaled(Options, 20000);
+	std::vector<UCHAR> storage(ViGEm::Bus::Core::EventRing::GetStorageSize(PROCESSORS, BATCH) + 64);
+	const auto address = reinterpret_cast<uintptr_t>(storage.data());
+	ViGEm::Bus::Core::EventRing ring{};
+	std::vector<VIGEM_EVENT_RECORD> drained(BATCH);
+	LatencyRecorder latencies(batches);
+	ULONGLONG missed = 0;
+
+	(void)Bus;
+
+	ring.Initialize(reinterpret_cast<PVOID>((address + 63) & ~static_cast<uintptr_t>(63)), PROCESSORS, BATCH);
+
+	const ULONGLONG allocations = GetAllocationCount();
+	const ULONGLONG start = GetTimestamp();
+	ULONGLONG now = start;
+
+	for (ULONGLONG batch = 0; batch < batches; batch++)
+	{
+		VIGEM_EVENT_RECORD event = {};
+
+		event.EventId = VIGEM_EVENT_REPORT_SUBMITTED;
+		event.SerialNo = 1;
+
+		for (ULONG i = 0; i < BATCH; i++)
+		{
+			event.Timestamp = now + i;
+			event.Payload[0] = i;
+
+			if (!ring.Record(0, event))
+				missed++;
+		}
+
+		const ULONGLONG done = GetTimestamp();
+
+		latencies.Add((done - now) / BATCH);
+
+		(void)ring.Drain(drained.data(), BATCH);
+
+		now = GetTimestamp();
+	}
+
+	Results.push_back(Summarize("event_record_cost", latencies, batches * BATCH, GetSeconds(start, now), missed,
+	                            GetAllocationCount() - allocations));
+
+	return missed == 0;
+}
+
+//
+// DualShock 4 target of the idle simulation, the host always keeps an
+// interrupt IN request queued
+// 
+typedef struct _IDLE_SIM_PAD
+{
+	ViGEm::Bus::Core::IdleTracker Idle;
+
+	ViGEm::Bus::Core::TICK_SET_LINK Link;
+
+	//
+	// A report completed a request since the previous tick
+	// 
+	bool Served;
+
+	bool Active;
+
+	ULONGLONG NextToggle;
+
+	ULONGLONG NextReport;
+
+} IDLE_SIM_PAD;
+
+//
+// Runs the bus tick of DualShock 4 targets (FDO_DS4_TICK_MS, see
+// EmulationTargetDS4::BusTick) in simulated time. Pads alternate between
+// feeding reports and idling; IdleRatio is the share of time idle. Returns
+// the wakeups: tick timer expirations plus requests the tick completed.
+// 
+static ULONGLONG SimulateIdleWakeups(double IdleRatio, ULONGLONG TimeoutMs, ULONGLONG DurationMs)
+{
+	static const ULONG PADS = 200;
+	static const ULONGLONG TICK_MS = 5;
+	static const ULONGLONG REPORT_MS = 4;
+	static const ULONGLONG ACTIVE_MS = 5000;
+	static const ULONGLONG MS = 10000;
+
+	const ULONGLONG idleMs = static_cast<ULONGLONG>(ACTIVE_MS * IdleRatio / (1.0 - IdleRatio));
+	std::vector<IDLE_SIM_PAD> pads(PADS);
+	ViGEm::Bus::Core::TickSet tick{};
+	ULONGLONG seed = 0x9E3779B97F4A7C15ULL;
+	ULONGLONG wakeups = 0;
+
+	const auto random = [&seed](ULONGLONG Range)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (seed >> 33) % std::max(Range, 1ULL);
+	};
+
+	//
+	// Uniform around the mean, so the idle ratio holds on average
+	// 
+	const auto period = [&](bool Active)
+	{
+		return 1 + random(2 * (Active ? ACTIVE_MS : idleMs));
+	};
+
+	for (auto& pad : pads)
+	{
+		ViGEm::Bus::Core::TickSet::InitializeLink(&pad.Link, &pad);
+
+		pad.Active = idleMs == 0 || random(1000) >= static_cast<ULONGLONG>(IdleRatio * 1000);
+		pad.NextToggle = period(pad.Active);
+		pad.NextReport = random(REPORT_MS);
+
+		(void)tick.Insert(&pad.Link);
+	}
+
+	for (ULONGLONG now = 0; now < DurationMs; now++)
+	{
+		for (auto& pad : pads)
+		{
+			if (idleMs && now >= pad.NextToggle)
+			{
+				pad.Active = !pad.Active;
+				pad.NextToggle = now + period(pad.Active);
+			}
+
+			if (!pad.Active || now < pad.NextReport)
+				continue;
+
+			//
+			// The report completes the queued request, a parked pad rejoins
+			// 
+			pad.NextReport = now + REPORT_MS;
+			pad.Served = true;
+
+			if (pad.Idle.Activity(now * MS))
+				(void)tick.Insert(&pad.Link);
+		}
+
+		if (now % TICK_MS || tick.IsEmpty())
+			continue;
+
+		wakeups++;
+
+		for (ULONG index = tick.GetCount(); index > 0;)
+		{
+			const auto link = tick.GetAt(--index);
+			const auto pad = static_cast<IDLE_SIM_PAD*>(link->Context);
+
+			if (pad->Idle.IsParked() || pad->Idle.Park(now * MS, TimeoutMs * MS))
+			{
+				tick.Remove(link);
+				continue;
+			}
+
+			if (!pad->Served)
+				wakeups++;
+
+			pad->Served = false;
+		}
+	}
+
+	tick.Cleanup();
+
+	return wakeups;
+}
+
+//
+// Wakeups per second of 200 DualShock 4 targets at several idle ratios,
+// with idle parking (2s IdleTimeout) and without
+// 
+static bool IdleWakeups(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG IDLE_PERCENT[] = { 0, 50, 90, 99 };
+	static const ULONGLONG TIMEOUT_MS = 2000;
+
+	//
+	// Long enough for pads to go idle and park even in a quick run
+	// 
+	const ULONGLONG durationMs = std::max(Scaled(Options, 120000), 20000ULL);
+	bool reduced = true;
+
+	(void)Bus;
+
+	for (const ULONG percent : IDLE_PERCENT)
+	{
+		const ULONGLONG parked = SimulateIdleWakeups(percent / 100.0, TIMEOUT_MS, durationMs);
+		const ULONGLONG unparked = SimulateIdleWakeups(percent / 100.0, 0, durationMs);
+		LatencyRecorder none(0);
+		char name[64];
+
+		snprintf(name, sizeof(name), "idle_wakeups/%u%%/parked", percent);
+		Results.push_back(Summarize(name, none, parked, durationMs / 1000.0, 0, 0));
+
+		snprintf(name, sizeof(name), "idle_wakeups/%u%%/unparked", percent);
+		Results.push_back(Summarize(name, none, unparked, durationMs / 1000.0, 0, 0));
+
+		if (parked > unparked)
+			reduced = false;
+	}
+
+	return reduced;
+}
+
+//
+// Session of the QoS simulation, submitting a report every Period
+// 
+typedef struct _QOS_SIM_SESSION
+{
+	ViGEm::Bus::Core::TokenBucket Qos;
+
+	ULONGLONG Period;
+
+	ULONGLONG NextSubmit;
+
+	ULONGLONG Delivered;
+
+	bool Interactive;
+
+} QOS_SIM_SESSION;
+
+//
+// Held back report of a target (see EmulationTargetPDO::CoalesceReport)
+// 
+typedef struct _QOS_SIM_TARGET
+{
+	bool Pending;
+
+	size_t Session;
+
+	ULONGLONG Submitted;
+
+	ULONGLONG Due;
+
+} QOS_SIM_TARGET;
+
+typedef struct _QOS_SIM_REPORT
+{
+	size_t Session;
+
+	ULONGLONG Submitted;
+
+} QOS_SIM_REPORT;
+
+//
+// Runs Bus_SubmitReport and the coalescing of held back reports in
+// simulated time (100ns units) against a bus that dispatches one report
+// per SERVICE. Session 0 floods its own target, the others feed one
+// target each at 1 kHz with the interactive class. Latency is the time
+// from submitting a report to its dispatch completing.
+// 
+static void SimulateQos(bool Limited, ULONGLONG Duration, std::vector<QOS_SIM_SESSION>& Sessions,
+                        LatencyRecorder& Flood, LatencyRecorder& Interactive)
+{
+	static const ULONGLONG STEP = 10;
+	static const ULONGLONG SERVICE = 50;
+	static const ULONGLONG FLOOD_PERIOD = 20;
+	static const ULONGLONG INTERACTIVE_PERIOD = 10000;
+	static const size_t INTERACTIVE_SESSIONS = 4;
+
+	std::vector<QOS_SIM_TARGET> targets(1 + INTERACTIVE_SESSIONS);
+	std::deque<QOS_SIM_REPORT> dispatch;
+	ULONGLONG busyUntil = 0;
+
+	Sessions.assign(1 + INTERACTIVE_SESSIONS, QOS_SIM_SESSION{});
+
+	for (size_t index = 0; index < Sessions.size(); index++)
+	{
+		auto& session = Sessions[index];
+
+		session.Interactive = index != 0;
+		session.Period = session.Interactive ? INTERACTIVE_PERIOD : FLOOD_PERIOD;
+		session.NextSubmit = index * 1000;
+
+		if (Limited && !session.Interactive)
+			session.Qos.Configure(VIGEM_QOS_NORMAL_RATE, VIGEM_QOS_NORMAL_BURST);
+	}
+
+	for (ULONGLONG now = 0; now < Duration; now += STEP)
+	{
+		for (size_t index = 0; index < Sessions.size(); index++)
+		{
+			auto& session = Sessions[index];
+			auto& target = targets[index];
+
+			if (now < session.NextSubmit)
+				continue;
+
+			session.NextSubmit += session.Period;
+
+			if (!session.Qos.IsLimited() || session.Qos.TryAcquire(now))
+			{
+				dispatch.push_back({ index, now });
+				continue;
+			}
+
+			//
+			// Another session's held back report gets flushed, the new
+			// owner pays for a slot of its own
+			// 
+			const bool flush = target.Pending && target.Session != index;
+
+			if (flush)
+				dispatch.push_back({ target.Session, target.Submitted });
+
+			if (!target.Pending || flush)
+				target.Due = session.Qos.Reserve(now);
+
+			target.Pending = true;
+			target.Session = index;
+			target.Submitted = now;
+		}
+
+		for (auto& target : targets)
+		{
+			if (target.Pending && now >= target.Due)
+			{
+				dispatch.push_back({ target.Session, target.Submitted });
+				target.Pending = false;
+			}
+		}
+
+		while (!dispatch.empty() && busyUntil <= now)
+		{
+			const auto report = dispatch.front();
+			auto& session = Sessions[report.Session];
+
+			dispatch.pop_front();
+
+			busyUntil = std::max(busyUntil, report.Submitted) + SERVICE;
+			session.Delivered++;
+
+			(session.Interactive ? Interactive : Flood).Add((busyUntil - report.Submitted) * 100);
+		}
+	}
+}
+
+//
+// One session flooding a target against four interactive sessions, with
+// and without the normal class rate limit on the flooding one
+// 
+static bool QosFairness(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONGLONG UNITS_PER_SECOND = 10000000;
+
+	const ULONGLONG duration = std::max(Scaled(Options, 5 * UNITS_PER_SECOND), UNITS_PER_SECOND / 2);
+	const double seconds = static_cast<double>(duration) / UNITS_PER_SECOND;
+	ULONGLONG interactiveP99[2] = {};
+	ULONGLONG floodDelivered[2] = {};
+
+	(void)Bus;
+
+	for (const bool limited : { false, true })
+	{
+		std::vector<QOS_SIM_SESSION> sessions;
+		LatencyRecorder flood(static_cast<size_t>(seconds * 200000) + 1);
+		LatencyRecorder interactive(static_cast<size_t>(seconds * 4000) + 4);
+		ULONGLONG interactiveDelivered = 0;
+		char name[64];
+
+		SimulateQos(limited, duration, sessions, flood, interactive);
+
+		for (size_t index = 1; index < sessions.size(); index++)
+			interactiveDelivered += sessions[index].Delivered;
+
+		snprintf(name, sizeof(name), "qos_fairness/%s/interactive", limited ? "limited" : "unlimited");
+		Results.push_back(Summarize(name, interactive, interactiveDelivered, seconds, 0, 0));
+		interactiveP99[limited] = Results.back().P99;
+
+		snprintf(name, sizeof(name), "qos_fairness/%s/flood", limited ? "limited" : "unlimited");
+		Results.push_back(Summarize(name, flood, sessions[0].Delivered, seconds, 0, 0));
+		floodDelivered[limited] = sessions[0].Delivered;
+	}
+
+	//
+	// The limit holds the flood to its budget and keeps interactive
+	// sessions from queueing behind it
+	// 
+	const auto budget = static_cast<ULONGLONG>(seconds * VIGEM_QOS_NORMAL_RATE) + VIGEM_QOS_NORMAL_BURST + 1;
+
+	return floodDelivered[true] <= budget && interactiveP99[true] <= interactiveP99[false];
+}
+
+//
+// Child of the teardown simulation, serial is its index plus one
+// 
+typedef struct _TEARDOWN_SIM_CHILD
+{
+	ViGEm::Bus::Core::SESSION_TARGET_LINK Link;
+
+	ULONG Session;
+
+	bool Plugged;
+
+} TEARDOWN_SIM_CHILD;
+
+//
+// Unplugs the targets of a closing session the way Bus_UnPlugSessionDevices
+// does, in batches taken from the session's list under the session lock.
+// With Walk set, the way the bus did before sessions tracked their
+// targets: checking the owner of every child. Returns the unplugged count.
+// 
+static ULONG SimulateTeardown(std::vector<TEARDOWN_SIM_CHILD>& Children,
+                              ViGEm::Bus::Core::SessionTargetList& Targets, FAST_MUTEX& Lock, ULONG Session,
+                              bool Walk)
+{
+	//
+	// FDO_UNPLUG_BATCH_SIZE
+	// 
+	static const ULONG BATCH = 32;
+
+	ULONG serials[BATCH];
+	ULONG count;
+	ULONG unplugged = 0;
+
+	if (Walk)
+	{
+		for (auto& child : Children)
+		{
+			if (child.Plugged && child.Session == Session)
+			{
+				ViGEm::Bus::Core::SessionTargetList::Remove(&child.Link);
+				child.Plugged = false;
+				unplugged++;
+			}
+		}
+
+		return unplugged;
+	}
+
+	do
+	{
+		ExAcquireFastMutex(&Lock);
+		count = Targets.TakeSerials(serials, BATCH);
+		ExReleaseFastMutex(&Lock);
+
+		for (ULONG index = 0; index < count; index++)
+		{
+			Children[serials[index] - 1].Plugged = false;
+			unplugged++;
+		}
+	}
+	while (count == BATCH);
+
+	return unplugged;
+}
+
+//
+// Closing a session owning 4 targets on a bus with 64 and 1024 targets,
+// through the session's target list and by walking every child
+// 
+static bool SessionTeardown(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG BUS_TARGETS[] = { 64, 1024 };
+	static const ULONG SESSION_TARGETS = 4;
+	static const ULONG CLOSING = 1;
+
+	const ULONGLONG count = Scaled(Options, 20000);
+	ULONGLONG p50[2] = {};
+	bool complete = true;
+
+	(void)Bus;
+
+	for (const ULONG targets : BUS_TARGETS)
+	{
+		std::vector<TEARDOWN_SIM_CHILD> children(targets);
+		ViGEm::Bus::Core::SessionTargetList closing;
+		FAST_MUTEX lock;
+
+		ExInitializeFastMutex(&lock);
+		closing.Initialize();
+
+		//
+		// Four targets per session, the closing one's spread over the bus
+		// 
+		for (ULONG index = 0; index < targets; index++)
+		{
+			ViGEm::Bus::Core::SessionTargetList::InitializeLink(&children[index].Link, index + 1);
+			children[index].Session = CLOSING + 1 + index / SESSION_TARGETS;
+			children[index].Plugged = true;
+		}
+
+		for (const bool walk : { false, true })
+		{
+			LatencyRecorder latencies(count);
+			const ULONGLONG allocations = GetAllocationCount();
+			ULONGLONG elapsed = 0;
+			char name[64];
+
+			for (ULONGLONG cycle = 0; cycle < count; cycle++)
+			{
+				for (ULONG index = 0; index < SESSION_TARGETS; index++)
+				{
+					auto& child = children[(index * 2 + 1) * targets / (SESSION_TARGETS * 2)];
+
+					child.Session = CLOSING;
+					child.Plugged = true;
+					closing.Insert(&child.Link);
+				}
+
+				const ULONGLONG start = GetTimestamp();
+				const ULONG unplugged = SimulateTeardown(children, closing, lock, CLOSING, walk);
+				const ULONGLONG done = GetTimestamp();
+
+				latencies.Add(done - start);
+				elapsed += done - start;
+
+				if (unplugged != SESSION_TARGETS || !closing.IsEmpty())
+					complete = false;
+			}
+
+			snprintf(name, sizeof(name), "session_teardown/%u/%s", targets, walk ? "walk" : "list");
+			Results.push_back(Summarize(name, latencies, count, static_cast<double>(elapsed) / SECOND_NS, 0,
+			                            GetAllocationCount() - allocations));
+			p50[walk] = Results.back().P50;
+		}
+	}
+
+	//
+	// On the larger bus the list only touches the closing session's targets
+	// 
+	return complete && p50[false] <= p50[true];
+}
+
+//
+// Target of the URB dispatch comparison, handlers leave a trace in Sink
+// 
+typedef struct _URB_SIM_TARGET
+{
+	ViGEm::Bus::Core::UrbStatistics Statistics;
+
+	ULONGLONG Sink;
+
+} URB_SIM_TARGET;
+
+static volatile ULONGLONG g_UrbSink;
+
+typedef NTSTATUS (*URB_SIM_HANDLER)(URB_SIM_TARGET& Target, USHORT Function);
+
+static NTSTATUS UrbSimInterrupt(URB_SIM_TARGET& Target, USHORT Function)
+{
+	Target.Sink += Function;
+
+	return STATUS_PENDING;
+}
+
+static NTSTATUS UrbSimHandled(URB_SIM_TARGET& Target, USHORT Function)
+{
+	Target.Sink += static_cast<ULONGLONG>(Function) << 8;
+
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS UrbSimUnhandled(URB_SIM_TARGET& Target, USHORT Function)
+{
+	Target.Sink ^= Function;
+
+	return STATUS_INVALID_PARAMETER;
+}
+
+//
+// Shaped like EmulationTargetPDO::UrbHandlers
+// 
+static const URB_SIM_HANDLER URB_SIM_HANDLERS[VIGEM_URB_STAT_COUNT] =
+{
+	UrbSimInterrupt,
+	UrbSimHandled,
+	UrbSimUnhandled,
+	UrbSimHandled,
+	UrbSimHandled,
+	UrbSimHandled,
+	UrbSimHandled,
+	UrbSimHandled,
+	UrbSimHandled,
+	UrbSimHandled,
+	UrbSimUnhandled,
+};
+
+//
+// Interrupt transfers first, everything else through Classify and the
+// handler table, counting every URB (EmulationTargetPDO::UsbDispatchUrb)
+// 
+static NTSTATUS DispatchUrbTable(URB_SIM_TARGET& Target, USHORT Function)
+{
+	if (Function == URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER)
+	{
+		Target.Statistics.Hit(VIGEM_URB_STAT_BULK_OR_INTERRUPT_TRANSFER);
+
+		return UrbSimInterrupt(Target, Function);
+	}
+
+	const VIGEM_URB_STATISTIC statistic = ViGEm::Bus::Core::UrbStatistics::Classify(Function);
+
+	Target.Statistics.Hit(statistic);
+
+	return URB_SIM_HANDLERS[statistic](Target, Function);
+}
+
+//
+// One switch over every function code, as before the handler table,
+// without counters or tracing
+// 
+static NTSTATUS DispatchUrbSwitch(URB_SIM_TARGET& Target, USHORT Function)
+{
+	switch (Function)
+	{
+	case URB_FUNCTION_CONTROL_TRANSFER:
+	case URB_FUNCTION_SELECT_CONFIGURATION:
+	case URB_FUNCTION_SELECT_INTERFACE:
+	case URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE:
+	case URB_FUNCTION_GET_STATUS_FROM_DEVICE:
+	case URB_FUNCTION_ABORT_PIPE:
+	case URB_FUNCTION_CLASS_INTERFACE:
+	case URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE:
+		return UrbSimHandled(Target, Function);
+	case URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER:
+		return UrbSimInterrupt(Target, Function);
+	default:
+		return UrbSimUnhandled(Target, Function);
+	}
+}
+
+//
+// URBs a DualShock 4 target sees from plug-in through a minute of 250 Hz
+// interrupt IN polling with the host's output reports, the mix the
+// target's URB statistics show. Enumeration comes first, the rare control
+// requests of the steady state are spread over it.
+// 
+static std::vector<USHORT> MakeUrbMix()
+{
+	static const USHORT ENUMERATION[] =
+	{
+		URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE,
+		URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE,
+		URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE,
+		URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE,
+		URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE,
+		URB_FUNCTION_SELECT_CONFIGURATION,
+		URB_FUNCTION_CLASS_INTERFACE,
+		URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE,
+		URB_FUNCTION_CLASS_INTERFACE,
+		URB_FUNCTION_CLASS_INTERFACE,
+		URB_FUNCTION_CLASS_INTERFACE,
+		URB_FUNCTION_CONTROL_TRANSFER,
+		URB_FUNCTION_GET_STATUS_FROM_DEVICE,
+		URB_FUNCTION_CLASS_DEVICE,
+	};
+
+	static const USHORT STEADY[] =
+	{
+		URB_FUNCTION_CLASS_INTERFACE,
+		URB_FUNCTION_ABORT_PIPE,
+		URB_FUNCTION_SYNC_RESET_PIPE_AND_CLEAR_STALL,
+		URB_FUNCTION_GET_STATUS_FROM_DEVICE,
+	};
+
+	static const ULONG POLLS = 60 * 250;
+	static const ULONG OUTPUT_PERIOD = 25;
+
+	std::vector<USHORT> mix(std::begin(ENUMERATION), std::end(ENUMERATION));
+
+	for (ULONG poll = 0; poll < POLLS; poll++)
+	{
+		mix.push_back(URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER);
+
+		if (poll % OUTPUT_PERIOD == 0)
+			mix.push_back(URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER);
+
+		if (poll % (POLLS / RTL_NUMBER_OF(STEADY)) == POLLS / 8)
+			mix.push_back(STEADY[poll / (POLLS / RTL_NUMBER_OF(STEADY))]);
+	}
+
+	return mix;
+}
+
+//
+// Cost of dispatching one URB of a recorded mix through the handler table
+// with its counters and through the switch it replaced
+// 
+static bool UrbDispatch(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG BATCH = 256;
+
+	const std::vector<USHORT> mix = MakeUrbMix();
+	const ULONGLONG batches = Scaled(Options, 20000);
+	ULONGLONG expected[VIGEM_URB_STAT_COUNT] = {};
+	bool counted = true;
+
+	for (ULONGLONG urb = 0; urb < batches * BATCH; urb++)
+		expected[ViGEm::Bus::Core::UrbStatistics::Classify(mix[urb % mix.size()])]++;
+
+	(void)Bus;
+
+	for (const bool table : { true, false })
+	{
+		URB_SIM_TARGET target{};
+		LatencyRecorder latencies(batches);
+		size_t position = 0;
+
+		const ULONGLONG allocations = GetAllocationCount();
+		const ULONGLONG start = GetTimestamp();
+		ULONGLONG now = start;
+
+		for (ULONGLONG batch = 0; batch < batches; batch++)
+		{
+			for (ULONG i = 0; i < BATCH; i++)
+			{
+				const USHORT function = mix[position];
+
+				(void)(table ? DispatchUrbTable(target, function) : DispatchUrbSwitch(target, function));
+
+				if (++position == mix.size())
+					position = 0;
+			}
+
+			const ULONGLONG done = GetTimestamp();
+
+			latencies.Add((done - now) / BATCH);
+			now = done;
+		}
+
+		g_UrbSink = target.Sink;
+
+		Results.push_back(Summarize(table ? "urb_dispatch/table" : "urb_dispatch/switch", latencies,
+		                            batches * BATCH, GetSeconds(start, now), 0, GetAllocationCount() - allocations));
+
+		if (!table)
+			continue;
+
+		//
+		// Every URB lands on the counter of its function
+		// 
+		ULONGLONG counts[VIGEM_URB_STAT_COUNT];
+
+		target.Statistics.Snapshot(counts);
+
+		for (ULONG statistic = 0; statistic < VIGEM_URB_STAT_COUNT; statistic++)
+			counted = counted && counts[statistic] == expected[statistic];
+	}
+
+	return counted;
+}
+
+//
+// Target of the pool simulation, State stands in for the device object
+// and contexts a real target allocates
+// 
+typedef struct _POOL_SIM_TARGET
+{
+	ViGEm::Bus::Core::SESSION_TARGET_LINK Link;
+
+	ULONG Session;
+
+	UCHAR State[0x400];
+
+} POOL_SIM_TARGET;
+
+//
+// Bus side of the pool simulation, following busenum.cpp
+// 
+typedef struct _POOL_SIM_BUS
+{
+	ViGEm::Bus::Core::TargetPool Pool;
+
+	//
+	// SessionTargetLock
+	// 
+	FAST_MUTEX Lock;
+
+	//
+	// Indexed by serial - 1
+	// 
+	std::vector<POOL_SIM_TARGET*> Targets;
+
+	std::vector<ULONG> FreeSerials;
+
+} POOL_SIM_BUS;
+
+static const ULONG POOL_SIM_SESSION = 1;
+
+static ULONG PoolSimCreate(POOL_SIM_BUS& Bus, ULONG Session)
+{
+	if (Bus.FreeSerials.empty())
+		return 0;
+
+	const ULONG serial = Bus.FreeSerials.back();
+	const auto target = new POOL_SIM_TARGET();
+
+	Bus.FreeSerials.pop_back();
+
+	ViGEm::Bus::Core::SessionTargetList::InitializeLink(&target->Link, serial);
+	target->Session = Session;
+
+	Bus.Targets[serial - 1] = target;
+
+	return serial;
+}
+
+static void PoolSimDestroy(POOL_SIM_BUS& Bus, ULONG Serial)
+{
+	const auto target = Bus.Targets[Serial - 1];
+
+	ExAcquireFastMutex(&Bus.Lock);
+	ViGEm::Bus::Core::SessionTargetList::Remove(&target->Link);
+	ExReleaseFastMutex(&Bus.Lock);
+
+	delete target;
+
+	Bus.Targets[Serial - 1] = nullptr;
+	Bus.FreeSerials.push_back(Serial);
+}
+
+//
+// Bus_RefillTargetPool
+// 
+static void PoolSimRefill(POOL_SIM_BUS& Bus)
+{
+	ExAcquireFastMutex(&Bus.Lock);
+	const ULONG count = Bus.Pool.BeginRefill(Xbox360Wired);
+	ExReleaseFastMutex(&Bus.Lock);
+
+	ULONG created = 0;
+
+	for (ULONG serial; created < count && (serial = PoolSimCreate(Bus, 0)) != 0; created++)
+	{
+		ExAcquireFastMutex(&Bus.Lock);
+		Bus.Pool.Add(Xbox360Wired, &Bus.Targets[serial - 1]->Link);
+		ExReleaseFastMutex(&Bus.Lock);
+	}
+
+	ExAcquireFastMutex(&Bus.Lock);
+	Bus.Pool.CancelRefill(Xbox360Wired, count - created);
+	ExReleaseFastMutex(&Bus.Lock);
+}
+
+//
+// Bus_PlugInDevice: claims an idle pooled target and refills, or creates one
+// 
+static ULONG PoolSimPlug(POOL_SIM_BUS& Bus, ViGEm::Bus::Core::SessionTargetList& Session)
+{
+	ExAcquireFastMutex(&Bus.Lock);
+
+	ULONG serial = Bus.Pool.Take(Xbox360Wired);
+
+	if (serial)
+	{
+		Bus.Targets[serial - 1]->Session = POOL_SIM_SESSION;
+		Session.Insert(&Bus.Targets[serial - 1]->Link);
+	}
+
+	ExReleaseFastMutex(&Bus.Lock);
+
+	if (serial)
+	{
+		PoolSimRefill(Bus);
+		return serial;
+	}
+
+	if ((serial = PoolSimCreate(Bus, POOL_SIM_SESSION)) == 0)
+		return 0;
+
+	ExAcquireFastMutex(&Bus.Lock);
+	Session.Insert(&Bus.Targets[serial - 1]->Link);
+	ExReleaseFastMutex(&Bus.Lock);
+
+	return serial;
+}
+
+//
+// Bus_ReleaseChild: resets and returns the target to the pool if it has
+// room, unplugs it otherwise
+// 
+static void PoolSimRelease(POOL_SIM_BUS& Bus, ULONG Serial)
+{
+	const auto target = Bus.Targets[Serial - 1];
+
+	RtlZeroMemory(target->State, sizeof(target->State));
+	target->Session = 0;
+
+	ExAcquireFastMutex(&Bus.Lock);
+	const bool returned = Bus.Pool.Return(Xbox360Wired, &target->Link);
+	ExReleaseFastMutex(&Bus.Lock);
+
+	if (!returned)
+		PoolSimDestroy(Bus, Serial);
+}
+
+//
+// Allocations and cost of plugging in and releasing targets one at a time
+// and in bursts of four, without a pool and with a pool of depth four
+// 
+static bool PoolChurn(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG DEPTH = 4;
+	static const ULONG MAX_TARGETS = 64;
+
+	typedef struct _POOL_SIM_RUN
+	{
+		const char* Name;
+
+		ULONG Depth;
+
+		ULONG Burst;
+
+	} POOL_SIM_RUN;
+
+	static const POOL_SIM_RUN RUNS[] =
+	{
+		{ "unpooled", 0, 1 },
+		{ "pooled", DEPTH, 1 },
+		{ "unpooled_burst4", 0, DEPTH },
+		{ "pooled_burst4", DEPTH, DEPTH },
+	};
+
+	const ULONGLONG cycles = Scaled(Options, 20000);
+	bool plugged = true;
+	bool reused = false;
+
+	(void)Bus;
+
+	for (const auto& run : RUNS)
+	{
+		POOL_SIM_BUS bus;
+		ViGEm::Bus::Core::SessionTargetList session;
+		LatencyRecorder plugLatencies(cycles * run.Burst);
+		LatencyRecorder releaseLatencies(cycles * run.Burst);
+		ULONG serials[DEPTH];
+		ULONGLONG plugAllocations = 0;
+		ULONGLONG releaseAllocations = 0;
+		char name[64];
+
+		bus.Pool.Initialize();
+		ExInitializeFastMutex(&bus.Lock);
+		session.Initialize();
+
+		bus.Targets.resize(MAX_TARGETS);
+
+		for (ULONG serial = MAX_TARGETS; serial > 0; serial--)
+			bus.FreeSerials.push_back(serial);
+
+		bus.Pool.SetDepth(Xbox360Wired, run.Depth);
+		PoolSimRefill(bus);
+
+		const ULONGLONG start = GetTimestamp();
+		ULONGLONG now = start;
+
+		for (ULONGLONG cycle = 0; cycle < cycles && plugged; cycle++)
+		{
+			ULONGLONG allocations = GetAllocationCount();
+
+			for (ULONG index = 0; index < run.Burst; index++)
+			{
+				serials[index] = PoolSimPlug(bus, session);
+				plugged = plugged && serials[index] != 0;
+
+				const ULONGLONG done = GetTimestamp();
+
+				plugLatencies.Add(done - now);
+				now = done;
+			}
+
+			plugAllocations += GetAllocationCount() - allocations;
+			allocations = GetAllocationCount();
+
+			//
+			// Handle close, Bus_UnPlugSessionDevices
+			// 
+			for (ULONG index = 0; index < run.Burst; index++)
+			{
+				ExAcquireFastMutex(&bus.Lock);
+				(void)session.TakeSerials(&serials[index], 1);
+				ExReleaseFastMutex(&bus.Lock);
+
+				if (serials[index])
+					PoolSimRelease(bus, serials[index]);
+
+				const ULONGLONG done = GetTimestamp();
+
+				releaseLatencies.Add(done - now);
+				now = done;
+			}
+
+			releaseAllocations += GetAllocationCount() - allocations;
+		}
+
+		const double seconds = GetSeconds(start, now);
+
+		snprintf(name, sizeof(name), "pool_churn/%s/plug", run.Name);
+		Results.push_back(Summarize(name, plugLatencies, cycles * run.Burst, seconds, 0, plugAllocations));
+
+		snprintf(name, sizeof(name), "pool_churn/%s/release", run.Name);
+		Results.push_back(Summarize(name, releaseLatencies, cycles * run.Burst, seconds, 0, releaseAllocations));
+
+		//
+		// Single targets come straight back into the pool
+		// 
+		if (run.Depth && run.Burst == 1)
+			reused = plugAllocations == 0;
+
+		for (ULONG serial = 1; serial <= MAX_TARGETS; serial++)
+		{
+			if (bus.Targets[serial - 1])
+				PoolSimDestroy(bus, serial);
+		}
+	}
+
+	return plugged && reused;
+}
+
+static std::atomic<ULONG> g_ContentionNotifications;
+
+static VOID CALLBACK ContentionNotification(
+	PVIGEM_CLIENT Client,
+	PVIGEM_TARGET Target,
+	UCHAR LargeMotor,
+	UCHAR SmallMotor,
+	UCHAR LedNumber,
+	LPVOID UserData
+)
+{
+	(void)Client;
+	(void)Target;
+	(void)LargeMotor;
+	(void)SmallMotor;
+	(void)LedNumber;
+	(void)UserData;
+
+	g_ContentionNotifications++;
+}
+
+//
+// The client library against a mock bus, 1 to 8 threads: adding and
+// removing a target of their own, all racing for one target (the state
+// transitions turn all but one away), and vibration delivered to a target
+// each through the notification threads and their locks
+// 
+static bool ClientContention(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG THREADS[] = { 1, 2, 4, 8 };
+
+	const ULONGLONG cycles = Scaled(Options, 5000);
+	ViGEm::Tests::ScopedMockBus bus;
+	bool consistent = true;
+	bool delivered = true;
+
+	(void)Bus;
+
+	const auto client = vigem_alloc();
+
+	if (!client || !VIGEM_SUCCESS(vigem_connect(client)))
+	{
+		vigem_free(client);
+		return false;
+	}
+
+	for (const ULONG threads : THREADS)
+	{
+		for (const bool shared : { false, true })
+		{
+			std::vector<PVIGEM_TARGET> targets(shared ? 1 : threads);
+			std::vector<std::thread> workers;
+			std::atomic<LONG> balance{ 0 };
+			std::atomic<bool> go{ false };
+			LatencyRecorder latencies(cycles * threads);
+			char name[64];
+
+			for (auto& target : targets)
+				target = vigem_target_x360_alloc();
+
+			for (ULONG index = 0; index < threads; index++)
+			{
+				workers.emplace_back([&, index]
+				{
+					const auto target = targets[shared ? 0 : index];
+
+					while (!go.load())
+						std::this_thread::yield();
+
+					for (ULONGLONG cycle = 0; cycle < cycles; cycle++)
+					{
+						const ULONGLONG start = GetTimestamp();
+
+						if (VIGEM_SUCCESS(vigem_target_add(client, target)))
+							balance++;
+
+						if (VIGEM_SUCCESS(vigem_target_remove(client, target)))
+							balance--;
+
+						latencies.Add(GetTimestamp() - start);
+					}
+				});
+			}
+
+			const ULONGLONG allocations = GetAllocationCount();
+			const ULONGLONG start = GetTimestamp();
+
+			go.store(true);
+
+			for (auto& worker : workers)
+				worker.join();
+
+			const double seconds = GetSeconds(start, GetTimestamp());
+
+			//
+			// Whatever got added also got removed by someone
+			// 
+			for (const auto target : targets)
+			{
+				if (vigem_target_remove(client, target) == VIGEM_ERROR_NONE)
+					balance--;
+
+				vigem_target_free(target);
+			}
+
+			consistent = consistent && balance.load() == 0 && bus->GetTargetCount() == 0;
+
+			snprintf(name, sizeof(name), "client_contention/%s/%u", shared ? "shared" : "own", threads);
+			Results.push_back(Summarize(name, latencies, cycles * threads, seconds, 0,
+			                            GetAllocationCount() - allocations));
+		}
+
+		//
+		// One vibration round: every target gets one, timed until the last
+		// callback ran
+		// 
+		const ULONGLONG rounds = cycles / 10;
+		const SIZE_T handles = ViGEm::Tests::GetOpenHandles();
+		std::vector<PVIGEM_TARGET> targets(threads);
+		LatencyRecorder latencies(rounds);
+		ULONGLONG missed = 0;
+		char name[64];
+
+		for (auto& target : targets)
+		{
+			target = vigem_target_x360_alloc();
+			consistent = consistent && VIGEM_SUCCESS(vigem_target_add(client, target))
+				&& VIGEM_SUCCESS(vigem_target_x360_register_notification(client, target, ContentionNotification, nullptr));
+		}
+
+		const ULONGLONG allocations = GetAllocationCount();
+		const ULONGLONG start = GetTimestamp();
+
+		for (ULONGLONG round = 0; round < rounds && consistent; round++)
+		{
+			for (const auto target : targets)
+			{
+				while (bus->GetPendingNotifications(vigem_target_get_index(target)) == 0)
+					std::this_thread::yield();
+			}
+
+			g_ContentionNotifications = 0;
+
+			const ULONGLONG sent = GetTimestamp();
+
+			for (const auto target : targets)
+				bus->Notify(vigem_target_get_index(target), 0x80, 0x80, 0);
+
+			while (g_ContentionNotifications.load() < threads && GetTimestamp() - sent < SECOND_NS)
+				std::this_thread::yield();
+
+			if (g_ContentionNotifications.load() < threads)
+				missed++;
+
+			latencies.Add(GetTimestamp() - sent);
+		}
+
+		const double seconds = GetSeconds(start, GetTimestamp());
+
+		for (const auto target : targets)
+		{
+			vigem_target_x360_unregister_notification(target);
+			vigem_target_remove(client, target);
+		}
+
+		//
+		// Removal ends the notification threads, they hold an event each
+		// 
+		delivered = delivered && missed == 0
+			&& ViGEm::Tests::WaitOpenHandles(handles, 5000);
+
+		for (const auto target : targets)
+			vigem_target_free(target);
+
+		snprintf(name, sizeof(name), "client_contention/notify/%u", threads);
+		Results.push_back(Summarize(name, latencies, rounds * threads, seconds, missed,
+		                            GetAllocationCount() - allocations));
+	}
+
+	vigem_disconnect(client);
+	vigem_free(client);
+
+	return consistent && delivered;
+}
+
+//
+// Estimated cost of one registry call of a driver (open or create a key,
+// query or assign a value), not measured
+// 
+static const ULONGLONG IDENTITY_SIM_ROUND_TRIP_NS = 20000;
+
+static const ULONG IDENTITY_SIM_BURST = 16;
+
+//
+// Registry holding the DualShock 4 identities, every call spins for a round
+// trip. Per-serial TargetMacAddress values as written before the identity
+// table, and the Identities value of the table. Doesn't allocate.
+// 
+typedef struct _IDENTITY_SIM_REGISTRY
+{
+	UCHAR Addresses[IDENTITY_SIM_BURST + 1][ViGEm::Bus::Core::IdentityTable::ADDRESS_LENGTH];
+
+	bool Present[IDENTITY_SIM_BURST + 1];
+
+	std::vector<UCHAR> Table;
+
+	ULONGLONG RoundTrips;
+
+} IDENTITY_SIM_REGISTRY;
+
+static void IdentitySimRoundTrip(IDENTITY_SIM_REGISTRY& Registry)
+{
+	const ULONGLONG start = GetTimestamp();
+
+	while (GetTimestamp() - start < IDENTITY_SIM_ROUND_TRIP_NS)
+		YieldProcessor();
+
+	Registry.RoundTrips++;
+}
+
+//
+// Parameters, Targets, DualShock and the serial's key opened or created,
+// TargetMacAddress queried and, for a new serial, assigned
+// (EmulationTargetDS4::PdoInitContext before the identity table)
+// 
+static void IdentitySimRegistryPlugin(IDENTITY_SIM_REGISTRY& Registry, ULONG SerialNo, PUCHAR Address)
+{
+	for (ULONG key = 0; key < 4; key++)
+		IdentitySimRoundTrip(Registry);
+
+	IdentitySimRoundTrip(Registry);
+
+	if (Registry.Present[SerialNo])
+	{
+		RtlCopyMemory(Address, Registry.Addresses[SerialNo], ViGEm::Bus::Core::IdentityTable::ADDRESS_LENGTH);
+		return;
+	}
+
+	memset(Address, static_cast<int>(SerialNo), ViGEm::Bus::Core::IdentityTable::ADDRESS_LENGTH);
+
+	IdentitySimRoundTrip(Registry);
+
+	RtlCopyMemory(Registry.Addresses[SerialNo], Address, ViGEm::Bus::Core::IdentityTable::ADDRESS_LENGTH);
+	Registry.Present[SerialNo] = true;
+}
+
+//
+// Lookup and, for a new serial, insert; the flush is due afterwards
+// 
+static bool IdentitySimTablePlugin(ViGEm::Bus::Core::IdentityTable& Identities, ULONG SerialNo, PUCHAR Address)
+{
+	if (Identities.Lookup(SerialNo, Address))
+		return false;
+
+	memset(Address, static_cast<int>(SerialNo), ViGEm::Bus::Core::IdentityTable::ADDRESS_LENGTH);
+
+	return NT_SUCCESS(Identities.Insert(SerialNo, Address));
+}
+
+//
+// The whole table serialized and written as one value behind a burst of
+// plug-ins (Bus_PersistIdentities: three keys and one assignment)
+// 
+static bool IdentitySimFlush(IDENTITY_SIM_REGISTRY& Registry, ViGEm::Bus::Core::IdentityTable& Identities)
+{
+	ULONG length = static_cast<ULONG>(Registry.Table.capacity());
+
+	Registry.Table.resize(length);
+
+	if (!NT_SUCCESS(Identities.Serialize(Registry.Table.data(), length, &length)))
+		return false;
+
+	Registry.Table.resize(length);
+
+	for (ULONG round = 0; round < 4; round++)
+		IdentitySimRoundTrip(Registry);
+
+	return !Identities.IsPending();
+}
+
+//
+// DualShock 4 plug-in latency of getting the target's MAC address through
+// the registry on every plug-in and from the in-memory identity table, for
+// bursts of 16 serials first seen (generated and persisted) and plugged in
+// again (known), plus the write-behind flush after a burst and loading the
+// table when the bus starts
+// 
+static bool Ds4Identity(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const char* const PHASES[] = { "new", "known" };
+
+	const ULONGLONG bursts = Scaled(Options, 100);
+	UCHAR address[ViGEm::Bus::Core::IdentityTable::ADDRESS_LENGTH];
+	IDENTITY_SIM_REGISTRY registry{};
+	ULONGLONG registryTrips[2] = {};
+	bool served = true;
+	char name[64];
+
+	(void)Bus;
+
+	registry.Table.reserve(4096);
+
+	//
+	// Every plug-in through the registry
+	// 
+	for (ULONG phase = 0; phase < 2; phase++)
+	{
+		LatencyRecorder latencies(bursts * IDENTITY_SIM_BURST);
+		const ULONGLONG allocations = GetAllocationCount();
+		const ULONGLONG start = GetTimestamp();
+
+		for (ULONGLONG burst = 0; burst < bursts; burst++)
+		{
+			if (phase == 0)
+				memset(registry.Present, 0, sizeof(registry.Present));
+
+			for (ULONG serial = 1; serial <= IDENTITY_SIM_BURST; serial++)
+			{
+				const ULONGLONG trips = registry.RoundTrips;
+				const ULONGLONG begin = GetTimestamp();
+
+				IdentitySimRegistryPlugin(registry, serial, address);
+
+				latencies.Add(GetTimestamp() - begin);
+				registryTrips[phase] += registry.RoundTrips - trips;
+			}
+		}
+
+		const double seconds = GetSeconds(start, GetTimestamp());
+
+		snprintf(name, sizeof(name), "ds4_identity/registry/%s", PHASES[phase]);
+		Results.push_back(Summarize(name, latencies, bursts * IDENTITY_SIM_BURST, seconds, 0,
+		                            GetAllocationCount() - allocations));
+	}
+
+	//
+	// Plug-ins from the table, one flush behind every burst of new serials
+	// 
+	LatencyRecorder flushes(bursts);
+	double flushSeconds = 0;
+
+	for (ULONG phase = 0; phase < 2; phase++)
+	{
+		LatencyRecorder latencies(bursts * IDENTITY_SIM_BURST);
+		const ULONGLONG trips = registry.RoundTrips;
+		ULONGLONG allocations = 0;
+		double seconds = 0;
+
+		for (ULONGLONG burst = 0; burst < bursts; burst++)
+		{
+			ViGEm::Bus::Core::IdentityTable identities{};
+
+			identities.Initialize();
+
+			if (phase == 1)
+				served = served && NT_SUCCESS(identities.Deserialize(registry.Table.data(), static_cast<ULONG>(registry.Table.size())));
+
+			const ULONGLONG burstAllocations = GetAllocationCount();
+			const ULONGLONG start = GetTimestamp();
+			ULONG inserted = 0;
+
+			for (ULONG serial = 1; serial <= IDENTITY_SIM_BURST; serial++)
+			{
+				const ULONGLONG begin = GetTimestamp();
+
+				if (IdentitySimTablePlugin(identities, serial, address))
+					inserted++;
+
+				latencies.Add(GetTimestamp() - begin);
+			}
+
+			seconds += GetSeconds(start, GetTimestamp());
+			allocations += GetAllocationCount() - burstAllocations;
+
+			served = served && inserted == (phase == 0 ? IDENTITY_SIM_BURST : 0) && identities.IsPending() == (inserted != 0);
+
+			if (identities.IsPending())
+			{
+				const ULONGLONG begin = GetTimestamp();
+
+				served = served && IdentitySimFlush(registry, identities);
+
+				flushes.Add(GetTimestamp() - begin);
+				flushSeconds += GetSeconds(begin, GetTimestamp());
+			}
+
+			identities.Cleanup();
+		}
+
+		//
+		// Only the flushes go to the registry
+		// 
+		served = served && registry.RoundTrips - trips == (phase == 0 ? bursts * 4 : 0);
+
+		snprintf(name, sizeof(name), "ds4_identity/table/%s", PHASES[phase]);
+		Results.push_back(Summarize(name, latencies, bursts * IDENTITY_SIM_BURST, seconds, 0, allocations));
+	}
+
+	Results.push_back(Summarize("ds4_identity/table/flush", flushes, bursts, flushSeconds, 0, 0));
+
+	//
+	// Bus start: one query of the stored table and loading it
+	// 
+	LatencyRecorder loads(bursts);
+	double loadSeconds = 0;
+
+	for (ULONGLONG burst = 0; burst < bursts; burst++)
+	{
+		ViGEm::Bus::Core::IdentityTable identities{};
+
+		identities.Initialize();
+
+		const ULONGLONG begin = GetTimestamp();
+
+		IdentitySimRoundTrip(registry);
+		served = served && NT_SUCCESS(identities.Deserialize(registry.Table.data(), static_cast<ULONG>(registry.Table.size())))
+			&& identities.GetCount() == IDENTITY_SIM_BURST;
+
+		loads.Add(GetTimestamp() - begin);
+		loadSeconds += GetSeconds(begin, GetTimestamp());
+
+		identities.Cleanup();
+	}
+
+	Results.push_back(Summarize("ds4_identity/table/load", loads, bursts, loadSeconds, 0, 0));
+
+	return served
+		&& registryTrips[0] == bursts * IDENTITY_SIM_BURST * 6
+		&& registryTrips[1] == bursts * IDENTITY_SIM_BURST * 5;
+}
+
+typedef struct _TIMELINE_SIM_TARGET
+{
+	VIGEM_TARGET_TYPE Type;
+
+	ViGEm::Bus::Core::PluginTimeline Timeline;
+
+} TIMELINE_SIM_TARGET, *PTIMELINE_SIM_TARGET;
+
+//
+// Hands targets from one stage of the bring-up to the thread of the next
+// 
+typedef struct _TIMELINE_SIM_QUEUE
+{
+	std::mutex Lock;
+
+	std::condition_variable Posted;
+
+	std::deque<PTIMELINE_SIM_TARGET> Targets;
+
+	bool Closed;
+
+} TIMELINE_SIM_QUEUE;
+
+static void TimelineSimPost(TIMELINE_SIM_QUEUE& Queue, PTIMELINE_SIM_TARGET Target)
+{
+	{
+		std::lock_guard<std::mutex> lock(Queue.Lock);
+
+		Queue.Targets.push_back(Target);
+	}
+
+	Queue.Posted.notify_one();
+}
+
+static void TimelineSimClose(TIMELINE_SIM_QUEUE& Queue)
+{
+	{
+		std::lock_guard<std::mutex> lock(Queue.Lock);
+
+		Queue.Closed = true;
+	}
+
+	Queue.Posted.notify_all();
+}
+
+//
+// Next target, nullptr once closed and drained
+// 
+static PTIMELINE_SIM_TARGET TimelineSimWait(TIMELINE_SIM_QUEUE& Queue)
+{
+	std::unique_lock<std::mutex> lock(Queue.Lock);
+
+	Queue.Posted.wait(lock, [&Queue] { return !Queue.Targets.empty() || Queue.Closed; });
+
+	if (Queue.Targets.empty())
+		return nullptr;
+
+	const PTIMELINE_SIM_TARGET target = Queue.Targets.front();
+
+	Queue.Targets.pop_front();
+
+	return target;
+}
+
+static void TimelineSimMark(PTIMELINE_SIM_TARGET Target, VIGEM_PLUGIN_PHASE Phase)
+{
+	Target->Timeline.Mark(Phase, GetTimestamp());
+}
+
+//
+// What the host asks of a new device, in the order the phases get marked:
+// device and configuration descriptors, the configuration selected, then
+// for XUSB the six interrupt IN transfers of the init sequence (input starts
+// with the fifth) and the LED output report, for DS4 the HID report
+// descriptor (boot event) and the first interrupt IN transfer
+// 
+static void TimelineSimEnumerate(PTIMELINE_SIM_TARGET Target, volatile ULONGLONG& Sink)
+{
+	static const ULONG DESCRIPTOR_REQUESTS = 5;
+	static const ULONG XUSB_INIT_STAGES = 6;
+
+	for (ULONG request = 0; request < DESCRIPTOR_REQUESTS; request++)
+	{
+		if (request == 0)
+			TimelineSimMark(Target, VIGEM_PLUGIN_PHASE_DESCRIPTOR_REQUESTED);
+
+		Sink = Sink + request;
+	}
+
+	TimelineSimMark(Target, VIGEM_PLUGIN_PHASE_CONFIGURED);
+
+	if (Target->Type == Xbox360Wired)
+	{
+		for (ULONG stage = 0; stage < XUSB_INIT_STAGES; stage++)
+		{
+			if (stage == 4)
+				TimelineSimMark(Target, VIGEM_PLUGIN_PHASE_INPUT_STARTED);
+
+			Sink = Sink + stage;
+		}
+
+		TimelineSimMark(Target, VIGEM_PLUGIN_PHASE_READY);
+	}
+	else
+	{
+		TimelineSimMark(Target, VIGEM_PLUGIN_PHASE_READY);
+		TimelineSimMark(Target, VIGEM_PLUGIN_PHASE_INPUT_STARTED);
+	}
+}
+
+//
+// Time-to-ready breakdown of Xbox 360 and DualShock 4 targets plugged in
+// four at a time: the bus request marks request, preparation and device
+// creation, a PnP thread prepares the hardware and hands the device to a
+// host thread enumerating it. Every phase reports the time since the
+// request, read from each target's plug-in timeline like
+// vigem_target_get_plugin_timeline does; phases never reached count as
+// missed.
+// 
+static bool PluginTimelineBreakdown(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG BURST = 4;
+
+	static const char* const PHASES[VIGEM_PLUGIN_PHASE_COUNT] =
+	{
+		"requested",
+		"prepared",
+		"created",
+		"hw_prepared",
+		"descriptor",
+		"configured",
+		"input",
+		"ready",
+	};
+
+	static const VIGEM_TARGET_TYPE TYPES[] = { Xbox360Wired, DualShock4Wired };
+
+	const ULONGLONG bursts = Scaled(Options, 1000);
+	bool ordered = true;
+
+	(void)Bus;
+
+	for (const VIGEM_TARGET_TYPE type : TYPES)
+	{
+		std::vector<TIMELINE_SIM_TARGET> targets(bursts * BURST);
+		TIMELINE_SIM_QUEUE pnp{};
+		TIMELINE_SIM_QUEUE host{};
+		TIMELINE_SIM_QUEUE ready{};
+		volatile ULONGLONG sink = 0;
+
+		std::thread pnpThread([&]
+		{
+			while (const PTIMELINE_SIM_TARGET target = TimelineSimWait(pnp))
+			{
+				TimelineSimMark(target, VIGEM_PLUGIN_PHASE_HARDWARE_PREPARED);
+				TimelineSimPost(host, target);
+			}
+		});
+
+		std::thread hostThread([&]
+		{
+			while (const PTIMELINE_SIM_TARGET target = TimelineSimWait(host))
+			{
+				TimelineSimEnumerate(target, sink);
+				TimelineSimPost(ready, target);
+			}
+		});
+
+		const ULONGLONG start = GetTimestamp();
+
+		for (ULONGLONG burst = 0; burst < bursts; burst++)
+		{
+			for (ULONG index = 0; index < BURST; index++)
+			{
+				const PTIMELINE_SIM_TARGET target = &targets[burst * BURST + index];
+
+				target->Type = type;
+
+				TimelineSimMark(target, VIGEM_PLUGIN_PHASE_REQUESTED);
+				TimelineSimMark(target, VIGEM_PLUGIN_PHASE_PREPARED);
+				TimelineSimMark(target, VIGEM_PLUGIN_PHASE_DEVICE_CREATED);
+				TimelineSimPost(pnp, target);
+			}
+
+			//
+			// The client waits for every target to become ready
+			// 
+			for (ULONG index = 0; index < BURST; index++)
+				TimelineSimWait(ready);
+		}
+
+		const double seconds = GetSeconds(start, GetTimestamp());
+
+		TimelineSimClose(pnp);
+		pnpThread.join();
+		TimelineSimClose(host);
+		hostThread.join();
+
+		for (ULONG phase = VIGEM_PLUGIN_PHASE_PREPARED; phase < VIGEM_PLUGIN_PHASE_COUNT; phase++)
+		{
+			LatencyRecorder latencies(targets.size());
+			ULONGLONG missed = 0;
+			char name[64];
+
+			for (auto& target : targets)
+			{
+				VIGEM_PLUGIN_TIMELINE timeline;
+
+				target.Timeline.Snapshot(&timeline);
+
+				const ULONGLONG requested = timeline.Timestamps[VIGEM_PLUGIN_PHASE_REQUESTED];
+				const ULONGLONG reached = timeline.Timestamps[phase];
+
+				if (reached == 0)
+				{
+					missed++;
+					continue;
+				}
+
+				ordered = ordered && reached >= requested;
+				latencies.Add(reached - requested);
+			}
+
+			snprintf(name, sizeof(name), "plugin_timeline/%s/%s", type == Xbox360Wired ? "xusb" : "ds4", PHASES[phase]);
+			Results.push_back(Summarize(name, latencies, targets.size(), seconds, missed, 0));
+
+			ordered = ordered && missed == 0;
+		}
+	}
+
+	return ordered;
+}
+
+//
+// Cost per transfer of the raw output channel with the default ring size:
+// writing XUSB (8 bytes), DS4 (32 bytes) and maximum (64 bytes) output
+// transfers in batches of 256, and draining each batch into one client
+// buffer and walking its records. Records wrap around the end of the ring
+// as they go.
+// 
+static bool RawOutput(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG BATCH = 256;
+	static const ULONG LENGTHS[] = { 8, 32, VIGEM_RAW_OUTPUT_MAX_PAYLOAD };
+
+	const ULONGLONG batches = Scaled(Options, 20000);
+	std::vector<UCHAR> storage(VIGEM_RAW_OUTPUT_DEFAULT_CAPACITY);
+	std::vector<UCHAR> buffer(VIGEM_RAW_OUTPUT_DEFAULT_CAPACITY);
+	UCHAR transfer[VIGEM_RAW_OUTPUT_MAX_PAYLOAD] = {};
+	bool complete = true;
+	char name[64];
+
+	(void)Bus;
+
+	for (const ULONG length : LENGTHS)
+	{
+		ViGEm::Bus::Core::RawOutputRing ring;
+		LatencyRecorder writes(batches);
+		LatencyRecorder drains(batches);
+		ULONGLONG writeTime = 0;
+		ULONGLONG drainTime = 0;
+		ULONGLONG walked = 0;
+		ULONG sequence = 0;
+
+		ring.Start(storage.data(), static_cast<ULONG>(storage.size()));
+
+		const ULONGLONG allocations = GetAllocationCount();
+
+		for (ULONGLONG batch = 0; batch < batches; batch++)
+		{
+			const ULONGLONG start = GetTimestamp();
+
+			for (ULONG i = 0; i < BATCH; i++)
+			{
+				transfer[0] = static_cast<UCHAR>(i);
+				ring.Write(start, transfer, length);
+			}
+
+			const ULONGLONG written = GetTimestamp();
+			const ULONG drained = ring.Drain(buffer.data(), static_cast<ULONG>(buffer.size()));
+			ULONG offset = 0;
+
+			while (const PCVIGEM_RAW_OUTPUT_RECORD record = VIGEM_RAW_OUTPUT_NEXT(buffer.data(), drained, &offset))
+			{
+				complete = complete && record->Sequence == sequence++ && record->Length == length;
+				walked++;
+			}
+
+			const ULONGLONG done = GetTimestamp();
+
+			writes.Add((written - start) / BATCH);
+			drains.Add((done - written) / BATCH);
+			writeTime += written - start;
+			drainTime += done - written;
+		}
+
+		const ULONGLONG allocated = GetAllocationCount() - allocations;
+
+		ring.Stop();
+
+		complete = complete && walked == batches * BATCH && ring.GetDropped() == 0;
+
+		snprintf(name, sizeof(name), "raw_output/write/%u", length);
+		Results.push_back(Summarize(name, writes, batches * BATCH, static_cast<double>(writeTime) / SECOND_NS, 0, allocated));
+
+		snprintf(name, sizeof(name), "raw_output/drain/%u", length);
+		Results.push_back(Summarize(name, drains, batches * BATCH, static_cast<double>(drainTime) / SECOND_NS, 0, 0));
+	}
+
+	return complete;
+}
+
+//
+// Stand-in of the target hierarchy for the dispatch comparison: handlers
+// copy a changed report and count the changes, like SubmitReportImpl
+// 
+class DispatchSimTarget
+{
+public:
+	explicit DispatchSimTarget(VIGEM_TARGET_TYPE Type) : _Type(Type) {}
+
+	virtual ~DispatchSimTarget() = default;
+
+	VIGEM_TARGET_TYPE GetType() const { return this->_Type; }
+
+	virtual NTSTATUS SubmitReportImpl(const VOID* NewReport) = 0;
+
+	ULONGLONG Changes{};
+
+private:
+	VIGEM_TARGET_TYPE _Type;
+};
+
+template <typename Report, VIGEM_TARGET_TYPE Type>
+class DispatchSimTargetOf final : public DispatchSimTarget
+{
+public:
+	DispatchSimTargetOf() : DispatchSimTarget(Type) {}
+
+	NTSTATUS SubmitReportImpl(const VOID* NewReport) override
+	{
+		if (memcmp(&this->_Report, NewReport, sizeof(Report)) == 0)
+			return STATUS_SUCCESS;
+
+		RtlCopyMemory(&this->_Report, NewReport, sizeof(Report));
+		this->Changes++;
+
+		return STATUS_SUCCESS;
+	}
+
+private:
+	Report _Report{};
+};
+
+typedef DispatchSimTargetOf<XUSB_REPORT, Xbox360Wired> DispatchSimXusb;
+
+typedef DispatchSimTargetOf<DS4_REPORT, DualShock4Wired> DispatchSimDs4;
+
+//
+// Cost of submitting one report to a target of a 64 target mix of Xbox 360
+// and DualShock 4 targets, every other report changed: through the vtable
+// and through DispatchTargetAs with the handler bound to the final type
+// 
+static bool TargetDispatch(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG TARGETS = 64;
+	static const ULONG BATCH = 256;
+
+	const ULONGLONG batches = Scaled(Options, 20000);
+	UCHAR reports[2][sizeof(DS4_REPORT)] = {};
+	ULONGLONG changes[2] = {};
+
+	(void)Bus;
+
+	reports[1][0] = 1;
+
+	for (const bool typed : { false, true })
+	{
+		std::vector<std::unique_ptr<DispatchSimTarget>> targets;
+		LatencyRecorder latencies(batches);
+		ULONGLONG order = 0x9E3779B97F4A7C15ULL;
+		ULONGLONG submitted = 0;
+
+		//
+		// Types in no particular order, so the branch on the tag isn't free
+		// 
+		for (ULONG index = 0; index < TARGETS; index++)
+		{
+			order ^= order << 13;
+			order ^= order >> 7;
+			order ^= order << 17;
+
+			if (order & 1)
+				targets.push_back(std::make_unique<DispatchSimXusb>());
+			else
+				targets.push_back(std::make_unique<DispatchSimDs4>());
+		}
+
+		const ULONGLONG allocations = GetAllocationCount();
+		const ULONGLONG start = GetTimestamp();
+		ULONGLONG now = start;
+
+		for (ULONGLONG batch = 0; batch < batches; batch++)
+		{
+			for (ULONG i = 0; i < BATCH; i++, submitted++)
+			{
+				DispatchSimTarget* target = targets[submitted % TARGETS].get();
+				const VOID* report = reports[(submitted / TARGETS) & 1];
+
+				if (typed)
+				{
+					(void)ViGEm::Bus::Core::DispatchTargetAs<DispatchSimXusb, DispatchSimDs4>(target, [report](auto* Self)
+					{
+						return Self->SubmitReportImpl(report);
+					});
+				}
+				else
+					(void)target->SubmitReportImpl(report);
+			}
+
+			const ULONGLONG done = GetTimestamp();
+
+			latencies.Add((done - now) / BATCH);
+			now = done;
+		}
+
+		for (auto& target : targets)
+			changes[typed] += target->Changes;
+
+		Results.push_back(Summarize(typed ? "target_dispatch/typed" : "target_dispatch/virtual", latencies,
+		                            submitted, GetSeconds(start, now), 0, GetAllocationCount() - allocations));
+	}
+
+	return changes[0] == changes[1] && changes[0] > 0;
+}
+
+//
+// Cost and heap allocations of one report update through the client
+// library against a mock bus: the C API taking the report by value, which
+// copies it into a submit structure, and the C++ layer building it in place
+// in the target's submit structure. The event every request gets created
+// with is measured alone, its allocations are the Win32 stand-in's.
+// 
+static bool ClientSubmit(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG BATCH = 64;
+
+	const ULONGLONG batches = Scaled(Options, 2000);
+	ViGEm::Tests::ScopedMockBus bus;
+	vigem::Client client;
+	vigem::X360Target x360;
+	vigem::Ds4Target ds4;
+	bool submitted = true;
+
+	(void)Bus;
+
+	if (!VIGEM_SUCCESS(client.connect())
+		|| !VIGEM_SUCCESS(x360.add(client))
+		|| !VIGEM_SUCCESS(ds4.add(client)))
+		return false;
+
+	//
+	// Runs Update BATCH times per sample
+	// 
+	const auto measure = [&](const char* Name, auto Update)
+	{
+		LatencyRecorder latencies(batches);
+		ULONGLONG count = 0;
+
+		const ULONGLONG allocations = GetAllocationCount();
+		const ULONGLONG start = GetTimestamp();
+		ULONGLONG now = start;
+
+		for (ULONGLONG batch = 0; batch < batches; batch++)
+		{
+			for (ULONG i = 0; i < BATCH; i++, count++)
+				submitted = submitted && Update(static_cast<BYTE>(count));
+
+			const ULONGLONG done = GetTimestamp();
+
+			latencies.Add((done - now) / BATCH);
+			now = done;
+		}
+
+		Results.push_back(Summarize(Name, latencies, count, GetSeconds(start, now), 0,
+		                            GetAllocationCount() - allocations));
+	};
+
+	measure("client_submit/event", [](BYTE)
+	{
+		const HANDLE event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+		return event != nullptr && CloseHandle(event);
+	});
+
+	measure("client_submit/x360_update", [&](BYTE Value)
+	{
+		XUSB_REPORT report{};
+
+		report.bLeftTrigger = Value;
+		report.sThumbLX = static_cast<SHORT>(Value * 100);
+
+		return VIGEM_SUCCESS(vigem_target_x360_update(client.get(), x360.get(), report));
+	});
+
+	measure("client_submit/x360_builder", [&](BYTE Value)
+	{
+		x360.report().triggers(Value, 0).left_thumb(static_cast<SHORT>(Value * 100), 0);
+
+		return VIGEM_SUCCESS(x360.submit());
+	});
+
+	measure("client_submit/ds4_update_ex", [&](BYTE Value)
+	{
+		DS4_REPORT_EX report{};
+
+		DS4_REPORT_INIT(reinterpret_cast<PDS4_REPORT>(&report.Report));
+		report.Report.bTriggerL = Value;
+		report.Report.wGyroX = static_cast<SHORT>(Value * 100);
+
+		return VIGEM_SUCCESS(vigem_target_ds4_update_ex(client.get(), ds4.get(), report));
+	});
+
+	measure("client_submit/ds4_builder", [&](BYTE Value)
+	{
+		ds4.report().triggers(Value, 0).gyro(static_cast<SHORT>(Value * 100), 0, 0);
+
+		return VIGEM_SUCCESS(ds4.submit());
+	});
+
+	return submitted
+		&& bus->GetReports(x360.index()) == 2 * batches * BATCH
+		&& bus->GetReports(ds4.index()) == 2 * batches * BATCH;
+}
+
+//
+// Estimated time one bus instance is busy with a report request, not
+// measured. Requests of one bus take turns, the buses work in parallel.
+// 
+static const ULONG SHARD_SIM_SERVICE_US = 50;
+
+//
+// The client library spreading 8 feeders over 1, 2 and 4 mock buses
+// (round robin placement), each feeder submitting Xbox 360 reports to a
+// target of its own as fast as its bus takes them
+// 
+static bool ClientShards(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG SHARDS[] = { 1, 2, 4 };
+	static const ULONG FEEDERS = 8;
+
+	const ULONGLONG cycles = Scaled(Options, 200);
+	auto driver = ViGEm::Tests::MockCurrentDriver();
+	bool routed = true;
+
+	(void)Bus;
+
+	driver.ServiceTimeUs = SHARD_SIM_SERVICE_US;
+
+	for (const ULONG shards : SHARDS)
+	{
+		std::vector<std::unique_ptr<ViGEm::Tests::ScopedMockBus>> buses;
+
+		for (ULONG index = 0; index < shards; index++)
+			buses.push_back(std::make_unique<ViGEm::Tests::ScopedMockBus>(driver));
+
+		const auto client = vigem_alloc();
+
+		if (!client || !VIGEM_SUCCESS(vigem_connect(client))
+			|| vigem_get_bus_count(client) != shards
+			|| !VIGEM_SUCCESS(vigem_set_bus_placement(client, VIGEM_BUS_PLACEMENT_ROUND_ROBIN)))
+		{
+			vigem_free(client);
+			return false;
+		}
+
+		std::vector<PVIGEM_TARGET> targets(FEEDERS);
+		std::vector<std::thread> feeders;
+		std::atomic<bool> go{ false };
+		std::atomic<ULONGLONG> failed{ 0 };
+		LatencyRecorder latencies(cycles * FEEDERS);
+		char name[64];
+
+		for (auto& target : targets)
+		{
+			target = vigem_target_x360_alloc();
+			routed = routed && VIGEM_SUCCESS(vigem_target_add(client, target));
+		}
+
+		for (const auto target : targets)
+		{
+			feeders.emplace_back([&, target]
+			{
+				XUSB_REPORT report{};
+
+				while (!go.load())
+					std::this_thread::yield();
+
+				for (ULONGLONG cycle = 0; cycle < cycles; cycle++)
+				{
+					const ULONGLONG start = GetTimestamp();
+
+					report.bLeftTrigger = static_cast<BYTE>(cycle);
+
+					if (!VIGEM_SUCCESS(vigem_target_x360_update(client, target, report)))
+						failed++;
+
+					latencies.Add(GetTimestamp() - start);
+				}
+			});
+		}
+
+		const ULONGLONG allocations = GetAllocationCount();
+		const ULONGLONG start = GetTimestamp();
+
+		go.store(true);
+
+		for (auto& feeder : feeders)
+			feeder.join();
+
+		const double seconds = GetSeconds(start, GetTimestamp());
+
+		//
+		// Every report reached the bus of its target, spread evenly
+		// 
+		for (const auto target : targets)
+		{
+			const auto& bus = *buses[vigem_target_get_bus_index(target)];
+
+			routed = routed && bus->GetReports(vigem_target_get_index(target)) == cycles;
+		}
+
+		for (const auto& bus : buses)
+			routed = routed && (*bus)->GetTargetCount() == FEEDERS / shards;
+
+		for (const auto target : targets)
+		{
+			vigem_target_remove(client, target);
+			vigem_target_free(target);
+		}
+
+		vigem_disconnect(client);
+		vigem_free(client);
+
+		snprintf(name, sizeof(name), "client_shards/%u", shards);
+		Results.push_back(Summarize(name, latencies, cycles * FEEDERS, seconds, failed.load(),
+		                            GetAllocationCount() - allocations));
+	}
+
+	return routed;
+}
+
+//
+// Estimated time of a SetupAPI walk of the bus interfaces and of a request
+// to the bus, not measured
+// 
+static const ULONG RECONNECT_SIM_ENUMERATE_US = 1000;
+static const ULONG RECONNECT_SIM_REQUEST_US = 50;
+
+static VOID CALLBACK ReconnectBusNotification(PVIGEM_CLIENT Client, VIGEM_BUS_EVENT Event, LPVOID UserData)
+{
+	(void)Client;
+	(void)Event;
+	(void)UserData;
+}
+
+//
+// vigem_connect after vigem_disconnect, through a mock bus discovery: to
+// the same bus, and to a new bus as after a driver update, each with and
+// without a client watching for bus changes
+// 
+static bool ClientReconnect(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const struct
+	{
+		const char* Name;
+		bool Update;
+		bool Watched;
+
+	} RUNS[] =
+	{
+		{ "cached", false, false },
+		{ "cached_watched", false, true },
+		{ "update", true, false },
+		{ "update_watched", true, true },
+	};
+
+	const ULONGLONG cycles = Scaled(Options, 100);
+	auto driver = ViGEm::Tests::MockCurrentDriver();
+	ViGEm::Tests::ScopedMockDiscovery discovery(RECONNECT_SIM_ENUMERATE_US);
+	bool reconnected = true;
+
+	(void)Bus;
+
+	driver.ServiceTimeUs = RECONNECT_SIM_REQUEST_US;
+
+	for (const auto& run : RUNS)
+	{
+		auto bus = std::make_unique<ViGEm::Tests::ScopedMockBus>(driver);
+		const auto client = vigem_alloc();
+		LatencyRecorder latencies(cycles);
+		ULONGLONG connecting = 0;
+		ULONGLONG missed = 0;
+		char name[64];
+
+		discovery.Arrive(bus->GetPath(), false);
+
+		if (!client || (run.Watched && !VIGEM_SUCCESS(vigem_register_bus_notification(client, ReconnectBusNotification, nullptr))))
+		{
+			vigem_free(client);
+			return false;
+		}
+
+		//
+		// Fills the cache
+		// 
+		reconnected = reconnected && VIGEM_SUCCESS(vigem_connect(client));
+		vigem_disconnect(client);
+
+		const ULONG enumerations = discovery.GetEnumerations();
+		const ULONGLONG allocations = GetAllocationCount();
+
+		for (ULONGLONG cycle = 0; cycle < cycles; cycle++)
+		{
+			if (run.Update)
+			{
+				const std::wstring path = bus->GetPath();
+
+				bus.reset();
+				discovery.Remove(path, run.Watched);
+
+				bus = std::make_unique<ViGEm::Tests::ScopedMockBus>(driver);
+				discovery.Arrive(bus->GetPath(), run.Watched);
+			}
+
+			const ULONGLONG start = GetTimestamp();
+			const auto error = vigem_connect(client);
+			const ULONGLONG elapsed = GetTimestamp() - start;
+
+			latencies.Add(elapsed);
+			connecting += elapsed;
+
+			if (!VIGEM_SUCCESS(error) || vigem_get_bus_count(client) != 1)
+				missed++;
+
+			vigem_disconnect(client);
+		}
+
+		//
+		// Only an update nobody reported sends the client enumerating
+		// 
+		const ULONG expected = (run.Update && !run.Watched) ? static_cast<ULONG>(cycles) : 0;
+
+		reconnected = reconnected && missed == 0 && discovery.GetEnumerations() - enumerations == expected;
+
+		vigem_unregister_bus_notification(client);
+		vigem_free(client);
+		discovery.Remove(bus->GetPath(), false);
+
+		snprintf(name, sizeof(name), "client_reconnect/%s", run.Name);
+		Results.push_back(Summarize(name, latencies, cycles, static_cast<double>(connecting) / SECOND_NS, missed,
+		                            GetAllocationCount() - allocations));
+	}
+
+	return reconnected;
+}
+
+static const ULONG MACRO_SIM_MACROS = 1000;
+
+//
+// Turbo of macro Index: pressed and released for the same duration, 10 to
+// 40ms, so the transitions of all macros spread over the ticks
+// 
+static USHORT MacroSimHalfPeriod(ULONG Index)
+{
+	return static_cast<USHORT>(10 + Index % 31);
+}
+
+//
+// How late a transition of a turbo with HalfPeriodMs came, Elapsed after
+// the start of all of them
+// 
+static ULONGLONG MacroSimLateness(ULONGLONG Elapsed, USHORT HalfPeriodMs)
+{
+	const ULONGLONG period = HalfPeriodMs * FEED_PERIOD_NS;
+
+	return Elapsed % period;
+}
+
+//
+// Transition jitter of 1000 concurrent turbo macros: stepped by the timing
+// wheel from one 1ms tick as the bus does, and by a thread per macro
+// sleeping until its next transition as a feeder loop would. Also the
+// cost of one tick (advancing the wheel and applying the overlays).
+// 
+static bool MacroJitter(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	const ULONGLONG durationMs = std::max(Scaled(Options, 5000), 250ULL);
+	ULONGLONG expected = 0;
+
+	(void)Bus;
+
+	for (ULONG index = 0; index < MACRO_SIM_MACROS; index++)
+		expected += durationMs / MacroSimHalfPeriod(index);
+
+	//
+	// Wheel: a tick every millisecond, the overlays of changed targets
+	// applied to their reports right away
+	// 
+	{
+		ViGEm::Bus::Core::MacroScheduler scheduler{};
+		std::vector<std::unique_ptr<ViGEm::Bus::Core::MacroSet>> sets;
+		std::vector<ULONG> buttons(MACRO_SIM_MACROS);
+		std::vector<LONG> axes(MACRO_SIM_MACROS * VIGEM_AXIS_COUNT);
+		LatencyRecorder lateness(expected + MACRO_SIM_MACROS);
+		LatencyRecorder tickCost(durationMs);
+		ULONGLONG transitions = 0;
+		ULONGLONG missed = 0;
+
+		for (ULONG index = 0; index < MACRO_SIM_MACROS; index++)
+		{
+			VIGEM_MACRO_STEP steps[2] = {};
+
+			steps[0].DurationMs = MacroSimHalfPeriod(index);
+			steps[0].ButtonsSet = XUSB_GAMEPAD_A;
+			steps[1].DurationMs = MacroSimHalfPeriod(index);
+			steps[1].ButtonsClear = XUSB_GAMEPAD_A;
+
+			sets.push_back(std::make_unique<ViGEm::Bus::Core::MacroSet>(reinterpret_cast<PVOID>(static_cast<ULONG_PTR>(index))));
+
+			if (!NT_SUCCESS(sets.back()->Load(scheduler, 0, 0, 0, 2, steps)))
+				return false;
+		}
+
+		const ULONGLONG allocations = GetAllocationCount();
+		const ULONGLONG start = GetTimestamp();
+
+		for (ULONGLONG tick = 1; tick <= durationMs; tick++)
+		{
+			const ULONGLONG deadline = start + tick * FEED_PERIOD_NS;
+			const ULONGLONG now = GetTimestamp();
+
+			if (now < deadline)
+				std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now));
+
+			const ULONGLONG woke = GetTimestamp();
+
+			for (auto set = scheduler.Advance((woke - start) / FEED_PERIOD_NS); set; set = set->NextChanged)
+			{
+				const auto index = static_cast<ULONG>(reinterpret_cast<ULONG_PTR>(set->GetContext()));
+				ViGEm::Bus::Core::MACRO_OVERLAY overlay;
+				LONG (&report)[VIGEM_AXIS_COUNT] = *reinterpret_cast<LONG(*)[VIGEM_AXIS_COUNT]>(&axes[index * VIGEM_AXIS_COUNT]);
+
+				set->GetOverlay(overlay);
+				ViGEm::Bus::Core::MacroSet::ApplyOverlay(overlay, buttons[index], report);
+
+				const ULONGLONG late = MacroSimLateness(GetTimestamp() - start, MacroSimHalfPeriod(index));
+
+				lateness.Add(late);
+				transitions++;
+
+				if (late > FEED_PERIOD_NS)
+					missed++;
+			}
+
+			tickCost.Add(GetTimestamp() - woke);
+		}
+
+		const double seconds = GetSeconds(start, GetTimestamp());
+		const ULONGLONG tickAllocations = GetAllocationCount() - allocations;
+
+		Results.push_back(Summarize("macro_jitter/wheel", lateness, transitions, seconds, missed, tickAllocations));
+		Results.push_back(Summarize("macro_jitter/wheel_tick", tickCost, durationMs, seconds, 0, tickAllocations));
+
+		//
+		// Each macro may be short its last transition, never more
+		// 
+		if (transitions + MACRO_SIM_MACROS < expected)
+			return false;
+	}
+
+	//
+	// A thread per macro, sleeping until its next transition
+	// 
+	{
+		std::vector<std::thread> threads;
+		std::atomic<bool> go{ false };
+		std::atomic<ULONGLONG> transitions{ 0 };
+		std::atomic<ULONGLONG> missed{ 0 };
+		std::atomic<ULONGLONG> start{ 0 };
+		LatencyRecorder lateness(expected + MACRO_SIM_MACROS);
+
+		for (ULONG index = 0; index < MACRO_SIM_MACROS; index++)
+		{
+			threads.emplace_back([&, index]
+			{
+				const ULONGLONG halfPeriod = MacroSimHalfPeriod(index) * FEED_PERIOD_NS;
+				ULONG buttons = 0;
+
+				while (!go.load())
+					std::this_thread::yield();
+
+				const ULONGLONG begin = start.load();
+
+				for (ULONGLONG deadline = begin + halfPeriod; deadline <= begin + durationMs * FEED_PERIOD_NS; deadline += halfPeriod)
+				{
+					const ULONGLONG now = GetTimestamp();
+
+					if (now < deadline)
+						std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now));
+
+					buttons ^= XUSB_GAMEPAD_A;
+
+					const ULONGLONG late = GetTimestamp() - deadline;
+
+					lateness.Add(late);
+					transitions++;
+
+					if (late > FEED_PERIOD_NS)
+						missed++;
+				}
+
+				(void)buttons;
+			});
+		}
+
+		const ULONGLONG allocations = GetAllocationCount();
+
+		start.store(GetTimestamp());
+		go.store(true);
+
+		for (auto& thread : threads)
+			thread.join();
+
+		Results.push_back(Summarize("macro_jitter/threads", lateness, transitions.load(),
+		                            GetSeconds(start.load(), GetTimestamp()), missed.load(),
+		                            GetAllocationCount() - allocations));
+	}
+
+	return true;
+}
+
+//
+// Estimated sizes of a framework object header and of a WDFTIMER (KTIMER,
+// KDPC and framework state), not measured
+// 
+static const ULONG FOOTPRINT_SIM_WDF_OBJECT_BYTES = 0xC0;
+static const ULONG FOOTPRINT_SIM_WDF_TIMER_BYTES = 0x180;
+
+static const ULONG FOOTPRINT_SIM_BLOB_BYTES = 0x2A;
+static const ULONG FOOTPRINT_SIM_BUFFER_BYTES = 64 * (128 + sizeof(size_t));
+
+//
+// Optional storage of one simulated target, allocated for real so the
+// allocator sees the same calls as the driver
+// 
+typedef struct _FOOTPRINT_SIM_TARGET
+{
+	std::unique_ptr<UCHAR[]> Notifications;
+
+	//
+	// XUSB interrupt blob or DS4 timer of the eager policy
+	// 
+	std::unique_ptr<UCHAR[]> PerTarget;
+
+	ViGEm::Bus::Core::ReportRecorder Recorder;
+
+	ViGEm::Bus::Core::RawOutputRing RawOutput;
+
+	ULONG Bytes;
+
+} FOOTPRINT_SIM_TARGET;
+
+typedef struct _FOOTPRINT_SIM_STATE
+{
+	const char* Name;
+
+	//
+	// Owner requested notifications, input flowing, gone idle (left D0
+	// with nothing buffered), report log and raw output active
+	// 
+	bool Notified;
+	bool Fed;
+	bool Idle;
+	bool Logging;
+	bool RawOutput;
+
+} FOOTPRINT_SIM_STATE;
+
+static void FootprintSimAllocate(std::unique_ptr<UCHAR[]>& Storage, ULONG Length, ULONG& Bytes)
+{
+	Storage.reset(new UCHAR[Length]);
+	memset(Storage.get(), 0, Length);
+	Bytes += Length;
+}
+
+//
+// Brings Target into State the way the driver did before (Eager) or does
+// now, returns the optional bytes it holds
+// 
+static ULONG FootprintSimApply(FOOTPRINT_SIM_TARGET& Target, ULONG SerialNo, bool IsDs4, bool Eager,
+                               const FOOTPRINT_SIM_STATE& State)
+{
+	Target.Bytes = 0;
+
+	if (Eager)
+	{
+		FootprintSimAllocate(Target.Notifications, FOOTPRINT_SIM_WDF_OBJECT_BYTES + FOOTPRINT_SIM_BUFFER_BYTES,
+		                     Target.Bytes);
+
+		if (IsDs4)
+			FootprintSimAllocate(Target.PerTarget, FOOTPRINT_SIM_WDF_TIMER_BYTES, Target.Bytes);
+		else
+			FootprintSimAllocate(Target.PerTarget, FOOTPRINT_SIM_WDF_OBJECT_BYTES + FOOTPRINT_SIM_BLOB_BYTES,
+			                     Target.Bytes);
+	}
+	else if (State.Notified && !State.Idle)
+	{
+		//
+		// The blob is shared static data and the DS4 tick link part of the
+		// object, only the notification buffers are left
+		// 
+		FootprintSimAllocate(Target.Notifications, FOOTPRINT_SIM_WDF_OBJECT_BYTES + FOOTPRINT_SIM_BUFFER_BYTES,
+		                     Target.Bytes);
+	}
+
+	if (State.Logging)
+	{
+		Target.Recorder.Start(new UCHAR[VIGEM_RECORDING_DEFAULT_CAPACITY], VIGEM_RECORDING_DEFAULT_CAPACITY,
+		                      IsDs4 ? DualShock4Wired : Xbox360Wired, SerialNo, 0);
+		Target.Bytes += Target.Recorder.GetCapacity();
+	}
+
+	if (State.RawOutput)
+	{
+		Target.RawOutput.Start(new UCHAR[VIGEM_RAW_OUTPUT_DEFAULT_CAPACITY], VIGEM_RAW_OUTPUT_DEFAULT_CAPACITY);
+		Target.Bytes += Target.RawOutput.GetCapacity();
+	}
+
+	return Target.Bytes;
+}
+
+static void FootprintSimRelease(FOOTPRINT_SIM_TARGET& Target)
+{
+	Target.Notifications.reset();
+	Target.PerTarget.reset();
+	delete[] Target.Recorder.Stop();
+	delete[] Target.RawOutput.Stop();
+}
+
+//
+// Optional bytes per target across the lifecycle of 1000 targets, half
+// XUSB and half DS4, allocating everything up front as before and on
+// first use as now. The target objects are left out, they are the same
+// either way; ops is bytes per target, allocs/op allocations per byte.
+// 
+static bool TargetFootprint(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG TARGETS = 1000;
+	static const FOOTPRINT_SIM_STATE STATES[] =
+	{
+		{ "plugged", false, false, false, false, false },
+		{ "notified", true, false, false, false, false },
+		{ "fed", true, true, false, false, false },
+		{ "idle", true, true, true, false, false },
+		{ "logging", true, true, false, true, false },
+		{ "raw_output", true, true, false, true, true },
+	};
+	bool smaller = true;
+
+	(void)Bus;
+	(void)Options;
+
+	for (const auto& state : STATES)
+	{
+		ULONGLONG bytes[2] = {};
+
+		for (int eager = 1; eager >= 0; eager--)
+		{
+			std::vector<FOOTPRINT_SIM_TARGET> targets(TARGETS);
+			LatencyRecorder none(0);
+			char name[64];
+
+			const ULONGLONG allocations = GetAllocationCount();
+
+			for (ULONG index = 0; index < TARGETS; index++)
+				bytes[eager] += FootprintSimApply(targets[index], index + 1, index % 2 != 0, eager != 0, state);
+
+			const ULONGLONG allocated = GetAllocationCount() - allocations;
+
+			for (auto& target : targets)
+				FootprintSimRelease(target);
+
+			snprintf(name, sizeof(name), "target_footprint/%s/%s", state.Name, eager ? "eager" : "lazy");
+			Results.push_back(Summarize(name, none, bytes[eager] / TARGETS, 1.0, 0, allocated / TARGETS));
+		}
+
+		//
+		// Whatever the state, lazy never holds more; with nothing in use it
+		// holds nothing
+		// 
+		if (bytes[0] > bytes[1] || ((!state.Notified || state.Idle) && bytes[0] != 0))
+			smaller = false;
+	}
+
+	return smaller;
+}
+
+//
+// Estimated deviation of host polls from their schedule (URB completion
+// to resubmission) and of a feeder's wakeup from its deadline, in 100ns
+// units, not measured
+// 
+static const ULONGLONG INPUT_AGE_SIM_POLL_JITTER = 250;
+static const ULONGLONG INPUT_AGE_SIM_WAKE_JITTER = 1000;
+
+//
+// Drift of the host and the feeder clock from nominal, in parts per million
+// 
+static const LONGLONG INPUT_AGE_SIM_HOST_PPM = 150;
+static const LONGLONG INPUT_AGE_SIM_FEEDER_PPM = -250;
+
+//
+// Simulates a feeder submitting one report per poll period to a host
+// polling every PeriodUs, in 100ns units. A free feeder submits on its own
+// clock, a paced one just before the poll predicted by PollPhaseEstimator
+// (VIGEM_POLL_PHASE::NextPoll) once locked. Ages are from submission to
+// pickup by the next poll; a report replaced before pickup is missed.
+// 
+static void SimulateInputAge(bool Paced, ULONGLONG PeriodUs, ULONGLONG Polls, LatencyRecorder& Ages,
+                             ULONGLONG& PickedUp, ULONGLONG& Missed)
+{
+	static const ULONGLONG NEVER = ~0ULL;
+
+	const LONGLONG period = static_cast<LONGLONG>(PeriodUs * 10);
+	const LONGLONG hostPeriod = period + period * INPUT_AGE_SIM_HOST_PPM / 1000000;
+	const LONGLONG feederPeriod = period + period * INPUT_AGE_SIM_FEEDER_PPM / 1000000;
+	ViGEm::Bus::Core::PollPhaseEstimator estimator{};
+	ULONGLONG seed = 0x2545F4914F6CDD1DULL;
+	ULONGLONG pending = NEVER;
+	ULONGLONG nextFree = static_cast<ULONGLONG>(period / 3);
+	ULONGLONG nextPaced = NEVER;
+
+	const auto random = [&seed](ULONGLONG Range)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (seed >> 33) % std::max(Range, 1ULL);
+	};
+
+	const auto submit = [&](ULONGLONG Time)
+	{
+		if (pending != NEVER)
+			Missed++;
+
+		pending = Time;
+	};
+
+	ULONGLONG freeSubmit = nextFree + random(INPUT_AGE_SIM_WAKE_JITTER);
+
+	PickedUp = 0;
+	Missed = 0;
+
+	for (ULONGLONG index = 1; index <= Polls; index++)
+	{
+		const ULONGLONG poll = index * hostPeriod + random(2 * INPUT_AGE_SIM_POLL_JITTER);
+
+		if (Paced && nextPaced < poll)
+		{
+			submit(nextPaced);
+			nextPaced = NEVER;
+		}
+
+		while (!Paced && freeSubmit < poll)
+		{
+			submit(freeSubmit);
+
+			nextFree += feederPeriod;
+			freeSubmit = nextFree + random(INPUT_AGE_SIM_WAKE_JITTER);
+		}
+
+		if (pending != NEVER)
+		{
+			Ages.Add((poll - pending) * 100);
+			PickedUp++;
+			pending = NEVER;
+		}
+
+		//
+		// Woke too late for this poll, waits for the next one
+		// 
+		if (nextPaced != NEVER)
+		{
+			submit(nextPaced);
+			nextPaced = NEVER;
+		}
+
+		estimator.Arrival(poll);
+
+		if (!Paced)
+			continue;
+
+		VIGEM_POLL_PHASE phase;
+		const ULONGLONG woke = poll + random(INPUT_AGE_SIM_WAKE_JITTER);
+
+		estimator.Snapshot(woke, &phase);
+
+		if (!phase.Locked)
+		{
+			nextPaced = woke + static_cast<ULONGLONG>(period / 2);
+			continue;
+		}
+
+		//
+		// Wake early enough to absorb the poll jitter seen so far and the
+		// feeder's own wakeup delay
+		// 
+		const ULONGLONG margin = 2ULL * phase.Jitter + INPUT_AGE_SIM_WAKE_JITTER;
+
+		nextPaced = phase.NextPoll > woke + margin ? phase.NextPoll - margin : woke;
+		nextPaced += random(INPUT_AGE_SIM_WAKE_JITTER);
+	}
+}
+
+//
+// Input age of a feeder submitting on its own clock against one paced by
+// the poll phase estimate, at host poll intervals of 1, 4 and 8ms
+// 
+static bool InputAge(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONGLONG PERIODS_US[] = { 1000, 4000, 8000 };
+
+	const ULONGLONG polls = std::max(Scaled(Options, 200000), 2000ULL);
+	bool younger = true;
+
+	(void)Bus;
+
+	for (const ULONGLONG periodUs : PERIODS_US)
+	{
+		ULONGLONG p50[2] = {};
+
+		for (int paced = 0; paced < 2; paced++)
+		{
+			LatencyRecorder ages(polls);
+			ULONGLONG pickedUp;
+			ULONGLONG missed;
+			char name[64];
+
+			const ULONGLONG allocations = GetAllocationCount();
+
+			SimulateInputAge(paced != 0, periodUs, polls, ages, pickedUp, missed);
+
+			snprintf(name, sizeof(name), "input_age/%llums/%s", periodUs / 1000, paced ? "paced" : "free");
+			Results.push_back(Summarize(name, ages, pickedUp, polls * periodUs / 1000000.0, missed,
+			                            GetAllocationCount() - allocations));
+
+			p50[paced] = Results.back().P50;
+		}
+
+		if (p50[1] >= p50[0])
+			younger = false;
+	}
+
+	return younger;
+}
+
+//
+// DualShock 4 target of the tick simulation, the host always keeps an
+// interrupt IN request queued and re-queues it when one completes
+// 
+typedef struct _DS4_TICK_SIM_PAD
+{
+	ViGEm::Bus::Core::TICK_SET_LINK Link;
+
+	//
+	// A report completed the request since the previous tick
+	// 
+	bool Served;
+
+	ULONGLONG Completed;
+
+	UCHAR Report[0x40];
+
+	//
+	// Transfer buffer of the queued request
+	// 
+	UCHAR Transfer[0x40];
+
+} DS4_TICK_SIM_PAD;
+
+//
+// Completes the queued request of Pad with its cached report
+// 
+static void Ds4TickSimComplete(DS4_TICK_SIM_PAD* Pad)
+{
+	memcpy(Pad->Transfer, Pad->Report, sizeof(Pad->Report));
+	Pad->Completed++;
+}
+
+//
+// Timer DPC of a target as before the bus tick, completes unconditionally
+// 
+static void Ds4TickSimTimer(DS4_TICK_SIM_PAD* Pad)
+{
+	Ds4TickSimComplete(Pad);
+}
+
+//
+// Bus tick DPC (EmulationTargetDS4::ServiceBusTick): one pass over the
+// members, skipping the targets fed since the previous tick
+// 
+static void Ds4TickSimBusTick(ViGEm::Bus::Core::TickSet& Tick)
+{
+	for (ULONG index = Tick.GetCount(); index > 0;)
+	{
+		const auto pad = static_cast<DS4_TICK_SIM_PAD*>(Tick.GetAt(--index)->Context);
+
+		if (pad->Served)
+			pad->Served = false;
+		else
+			Ds4TickSimComplete(pad);
+	}
+}
+
+//
+// Timer DPCs and their cost per 5ms period (FDO_DS4_TICK_MS) of 1000
+// DualShock 4 targets with a timer each, as before, and sharing the bus
+// tick, at 0, 50 and 90% of them fed between ticks. Runs in simulated
+// time, ops/s are DPCs per second; the latency is the CPU time of all
+// DPCs of one period.
+// 
+static bool Ds4Tick(Transport& Bus, const BENCH_OPTIONS& Options, std::vector<BENCH_RESULT>& Results)
+{
+	static const ULONG PADS = 1000;
+	static const ULONGLONG TICK_MS = 5;
+	static const ULONG FED_PERCENT[] = { 0, 50, 90 };
+
+	const ULONGLONG periods = std::max(Scaled(Options, 4000), 100ULL);
+	bool modeled = true;
+
+	(void)Bus;
+
+	for (const ULONG percent : FED_PERCENT)
+	{
+		for (int shared = 0; shared < 2; shared++)
+		{
+			//
+			// Allocated one by one like the device contexts, timers fire in
+			// the order they happened to be started
+			// 
+			std::vector<std::unique_ptr<DS4_TICK_SIM_PAD>> pads;
+			std::vector<std::pair<void (*)(DS4_TICK_SIM_PAD*), DS4_TICK_SIM_PAD*>> timers;
+			ViGEm::Bus::Core::TickSet tick{};
+			LatencyRecorder cost(periods);
+			ULONGLONG dpcs = 0;
+			char name[64];
+
+			for (ULONG index = 0; index < PADS; index++)
+			{
+				pads.push_back(std::make_unique<DS4_TICK_SIM_PAD>());
+				ViGEm::Bus::Core::TickSet::InitializeLink(&pads.back()->Link, pads.back().get());
+
+				if (shared)
+				{
+					if (!NT_SUCCESS(tick.Insert(&pads.back()->Link)))
+						return false;
+				}
+				else
+					timers.emplace_back(Ds4TickSimTimer, pads.back().get());
+			}
+
+			for (ULONG index = 0; index < timers.size(); index++)
+				std::swap(timers[index], timers[(index * 7919) % PADS]);
+
+			const ULONGLONG allocations = GetAllocationCount();
+
+			for (ULONGLONG period = 0; period < periods; period++)
+			{
+				//
+				// Feeders submit a report, completing the queued request
+				// 
+				for (ULONG index = 0; index < PADS; index++)
+				{
+					if (index % 10 >= percent / 10)
+						continue;
+
+					DS4_TICK_SIM_PAD* pad = pads[index].get();
+
+					pad->Report[1] = static_cast<UCHAR>(period);
+					Ds4TickSimComplete(pad);
+					pad->Served = true;
+				}
+
+				const ULONGLONG start = GetTimestamp();
+
+				if (shared)
+				{
+					Ds4TickSimBusTick(tick);
+					dpcs++;
+				}
+				else
+				{
+					for (const auto& timer : timers)
+					{
+						timer.first(timer.second);
+						dpcs++;
+					}
+				}
+
+				cost.Add(GetTimestamp() - start);
+			}
+
+			const ULONGLONG tickAllocations = GetAllocationCount() - allocations;
+			ULONGLONG completed = 0;
+
+			for (const auto& pad : pads)
+				completed += pad->Completed;
+
+			//
+			// Every pad gets a completion per period, from its feeder or from a
+			// timer; the per-target timers complete once more for fed pads
+			// 
+			const ULONGLONG fed = PADS * percent / 100;
+			const ULONGLONG expected = shared ? PADS * periods : (PADS + fed) * periods;
+
+			if (dpcs != (shared ? periods : PADS * periods) || completed != expected)
+				modeled = false;
+
+			snprintf(name, sizeof(name), "ds4_tick/%u%%/%s", percent, shared ? "bus_tick" : "per_target");
+			Results.push_back(Summarize(name, cost, dpcs, periods * TICK_MS / 1000.0, 0, tickAllocations));
+
+			tick.Cleanup();
+		}
+	}
+
+	return modeled;
+}
+
+#endif
+
+#pragma endregion
+
+const std::vector<BENCH_SCENARIO>& ViGEm::Bench::GetScenarios()
+{
+	static const std::vector<BENCH_SCENARIO> scenarios =
+	{
+		{ "single_pad_storm", SinglePadStorm },
+		{ "feed_64_pads_1khz", Feed64Pads },
+		{ "rumble_flood", RumbleFlood },
+		{ "plug_churn", PlugChurn },
+		{ "mixed", Mixed },
+#ifndef _WIN32
+		{ "transform_cost", TransformCost },
+		{ "event_record_cost", EventRecordCost },
+		{ "idle_wakeups", IdleWakeups },
+		{ "qos_fairness", QosFairness },
+		{ "session_teardown", SessionTeardown },
+		{ "urb_dispatch", UrbDispatch },
+		{ "pool_churn", PoolChurn },
+		{ "client_contention", ClientContention },
+		{ "ds4_identity", Ds4Identity },
+		{ "plugin_timeline", PluginTimelineBreakdown },
+		{ "raw_output", RawOutput },
+		{ "target_dispatch", TargetDispatch },
+		{ "client_submit", ClientSubmit },
+		{ "client_shards", ClientShards },
+		{ "client_reconnect", ClientReconnect },
+		{ "macro_jitter", MacroJitter },
+		{ "target_footprint", TargetFootprint },
+		{ "input_age", InputAge },
+		{ "ds4_tick", Ds4Tick },
+#endif
+	};
+
+	return scenarios;
+}
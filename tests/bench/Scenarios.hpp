@@ -0,0 +1,69 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Transport.hpp"
+#include "Statistics.hpp"
+
+#include <vector>
+
+namespace ViGEm::Bench
+{
+	typedef struct _BENCH_OPTIONS
+	{
+		//
+		// Multiplies operation counts and durations, 1 is a full run
+		// 
+		double Scale;
+
+	} BENCH_OPTIONS, *PBENCH_OPTIONS;
+
+	//
+	// Runs one scenario and appends its results, false if it couldn't run
+	// 
+	typedef bool (*BENCH_SCENARIO_FUNCTION)(Transport& Bus, const BENCH_OPTIONS& Options,
+	                                        std::vector<BENCH_RESULT>& Results);
+
+	typedef struct _BENCH_SCENARIO
+	{
+		const char* Name;
+
+		BENCH_SCENARIO_FUNCTION Run;
+
+	} BENCH_SCENARIO, *PBENCH_SCENARIO;
+
+	const std::vector<BENCH_SCENARIO>& GetScenarios();
+}
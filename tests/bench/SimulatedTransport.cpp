@@ -0,0 +1,384 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Transport.hpp"
+#include "Statistics.hpp"
+
+#include "SerialTable.hpp"
+#include "EventRing.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+
+using ViGEm::Bus::Core::SerialTable;
+using ViGEm::Bus::Core::EventRing;
+using ViGEm::Bus::Core::EmulationTargetPDO;
+
+
+namespace ViGEm::Bench
+{
+	//
+	// User mode model of the bus data paths, built from the driver's own
+	// serial table and event trace ring.
+	// 
+	// Plug-in reserves and publishes a serial, submissions resolve their
+	// target through the serial table and record a trace event, vibration
+	// from the host is queued and delivered to the registered callback by
+	// a worker thread, like pending notification requests get completed.
+	// 
+	class SimulatedBus final : public Transport
+	{
+	public:
+		SimulatedBus();
+
+		~SimulatedBus() override;
+
+		const char* GetName() const override { return "simulated"; }
+
+		bool Plug(BENCH_TARGET* Target) override;
+
+		void Unplug(BENCH_TARGET Target) override;
+
+		bool Submit(BENCH_TARGET Target, const XUSB_REPORT& Report) override;
+
+		bool RegisterRumble(BENCH_TARGET Target, BENCH_RUMBLE_CALLBACK Callback, PVOID Context) override;
+
+		bool Rumble(BENCH_TARGET Target, UCHAR LargeMotor, UCHAR SmallMotor) override;
+
+	private:
+		//
+		// Notifications waiting for delivery, more are dropped
+		// 
+		static const ULONG NOTIFICATION_CAPACITY = 256;
+
+		static const ULONG EVENT_CAPACITY = 0x1000;
+
+		typedef struct _SIMULATED_TARGET
+		{
+			ULONG SerialNo;
+
+			EX_SPIN_LOCK Lock;
+
+			XUSB_REPORT Report;
+
+			ULONGLONG Submitted;
+
+			BENCH_RUMBLE_CALLBACK Callback;
+
+			PVOID Context;
+
+		} SIMULATED_TARGET, *PSIMULATED_TARGET;
+
+		typedef struct _SIMULATED_NOTIFICATION
+		{
+			ULONG SerialNo;
+
+			UCHAR LargeMotor;
+
+			UCHAR SmallMotor;
+
+		} SIMULATED_NOTIFICATION, *PSIMULATED_NOTIFICATION;
+
+		//
+		// The serial table only stores target pointers, it never
+		// dereferences them
+		// 
+		static EmulationTargetPDO* ToEntry(PSIMULATED_TARGET Target)
+		{
+			return reinterpret_cast<EmulationTargetPDO*>(Target);
+		}
+
+		static PSIMULATED_TARGET FromEntry(EmulationTargetPDO* Entry)
+		{
+			return reinterpret_cast<PSIMULATED_TARGET>(Entry);
+		}
+
+		static ULONG GetSerial(BENCH_TARGET Target)
+		{
+			return static_cast<ULONG>(reinterpret_cast<uintptr_t>(Target));
+		}
+
+		void RecordEvent(VIGEM_EVENT_ID EventId, ULONG SerialNo, ULONG Payload);
+
+		void DeliverNotifications();
+
+		SerialTable* _Serials;
+
+		EventRing _Events{};
+
+		std::vector<UCHAR> _EventStorage;
+
+		ULONG _Processors;
+
+		std::mutex _QueueLock;
+
+		std::condition_variable _QueueSignal;
+
+		SIMULATED_NOTIFICATION _Queue[NOTIFICATION_CAPACITY]{};
+
+		ULONG _QueueHead{};
+
+		ULONG _QueueCount{};
+
+		bool _Stopping{};
+
+		//
+		// Held while a callback runs, unplugging waits for it
+		// 
+		std::mutex _DeliveryLock;
+
+		std::thread _Worker;
+	};
+}
+
+ViGEm::Bench::SimulatedBus::SimulatedBus()
+{
+	//
+	// Zeroed like the WDF context the driver keeps it in
+	// 
+	this->_Serials = new SerialTable();
+	this->_Serials->Initialize();
+
+	this->_Processors = std::max(std::thread::hardware_concurrency(), 1U);
+	this->_EventStorage.resize(EventRing::GetStorageSize(this->_Processors, EVENT_CAPACITY) + 64);
+
+	const auto storage = reinterpret_cast<uintptr_t>(this->_EventStorage.data());
+
+	this->_Events.Initialize(reinterpret_cast<PVOID>((storage + 63) & ~static_cast<uintptr_t>(63)),
+	                         this->_Processors, EVENT_CAPACITY);
+
+	this->_Worker = std::thread(&SimulatedBus::DeliverNotifications, this);
+}
+
+ViGEm::Bench::SimulatedBus::~SimulatedBus()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->_QueueLock);
+		this->_Stopping = true;
+	}
+
+	this->_QueueSignal.notify_one();
+	this->_Worker.join();
+
+	for (ULONG serial = 1; serial <= SerialTable::MAX_SERIAL && this->_Serials->GetCount(); serial++)
+	{
+		const PSIMULATED_TARGET target = FromEntry(this->_Serials->LookupAdded(serial));
+
+		this->_Serials->Release(serial);
+		delete target;
+	}
+
+	this->_Serials->Cleanup();
+	delete this->_Serials;
+}
+
+bool ViGEm::Bench::SimulatedBus::Plug(BENCH_TARGET* Target)
+{
+	const PSIMULATED_TARGET target = new SIMULATED_TARGET();
+	ULONG serial = 0;
+
+	if (!NT_SUCCESS(this->_Serials->Reserve(&serial)))
+	{
+		delete target;
+		return false;
+	}
+
+	target->SerialNo = serial;
+
+	this->_Serials->Bind(serial, ToEntry(target));
+	this->_Serials->SetOnline(serial);
+
+	*Target = reinterpret_cast<BENCH_TARGET>(static_cast<uintptr_t>(serial));
+
+	return true;
+}
+
+void ViGEm::Bench::SimulatedBus::Unplug(BENCH_TARGET Target)
+{
+	const ULONG serial = GetSerial(Target);
+	const PSIMULATED_TARGET target = FromEntry(this->_Serials->Lookup(serial));
+
+	if (!target)
+		return;
+
+	this->_Serials->Release(serial);
+
+	//
+	// Queued notifications find no target anymore, wait out a running one
+	// 
+	{
+		std::lock_guard<std::mutex> lock(this->_DeliveryLock);
+	}
+
+	delete target;
+}
+
+bool ViGEm::Bench::SimulatedBus::Submit(BENCH_TARGET Target, const XUSB_REPORT& Report)
+{
+	const ULONG serial = GetSerial(Target);
+	const PSIMULATED_TARGET target = FromEntry(this->_Serials->Lookup(serial));
+
+	if (!target)
+		return false;
+
+	const KIRQL irql = ExAcquireSpinLockExclusive(&target->Lock);
+
+	target->Report = Report;
+	target->Submitted++;
+
+	ExReleaseSpinLockExclusive(&target->Lock, irql);
+
+	this->RecordEvent(VIGEM_EVENT_REPORT_SUBMITTED, serial, sizeof(XUSB_REPORT));
+
+	return true;
+}
+
+bool ViGEm::Bench::SimulatedBus::RegisterRumble(BENCH_TARGET Target, BENCH_RUMBLE_CALLBACK Callback, PVOID Context)
+{
+	const PSIMULATED_TARGET target = FromEntry(this->_Serials->Lookup(GetSerial(Target)));
+
+	if (!target)
+		return false;
+
+	std::lock_guard<std::mutex> lock(this->_DeliveryLock);
+
+	target->Callback = Callback;
+	target->Context = Context;
+
+	return true;
+}
+
+bool ViGEm::Bench::SimulatedBus::Rumble(BENCH_TARGET Target, UCHAR LargeMotor, UCHAR SmallMotor)
+{
+	const ULONG serial = GetSerial(Target);
+
+	if (!this->_Serials->Lookup(serial))
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(this->_QueueLock);
+
+		//
+		// No pending request to complete, the host data is lost
+		// 
+		if (this->_QueueCount == NOTIFICATION_CAPACITY)
+			return true;
+
+		const ULONG tail = (this->_QueueHead + this->_QueueCount++) % NOTIFICATION_CAPACITY;
+
+		this->_Queue[tail].SerialNo = serial;
+		this->_Queue[tail].LargeMotor = LargeMotor;
+		this->_Queue[tail].SmallMotor = SmallMotor;
+	}
+
+	this->_QueueSignal.notify_one();
+
+	this->RecordEvent(VIGEM_EVENT_NOTIFICATION_QUEUED, serial, 8);
+
+	return true;
+}
+
+void ViGEm::Bench::SimulatedBus::RecordEvent(VIGEM_EVENT_ID EventId, ULONG SerialNo, ULONG Payload)
+{
+	VIGEM_EVENT_RECORD record = {};
+	const int processor = sched_getcpu();
+
+	record.Timestamp = GetTimestamp();
+	record.EventId = static_cast<USHORT>(EventId);
+	record.Processor = static_cast<USHORT>(processor < 0 ? 0 : processor);
+	record.SerialNo = SerialNo;
+	record.Payload[0] = Payload;
+
+	(void)this->_Events.Record(record.Processor, record);
+}
+
+void ViGEm::Bench::SimulatedBus::DeliverNotifications()
+{
+	VIGEM_EVENT_RECORD events[64];
+
+	std::unique_lock<std::mutex> lock(this->_QueueLock);
+
+	for (;;)
+	{
+		//
+		// The timeout doubles as the trace consumer
+		// 
+		this->_QueueSignal.wait_for(lock, std::chrono::milliseconds(1),
+		                            [this]() { return this->_QueueCount != 0 || this->_Stopping; });
+
+		if (this->_Stopping)
+			break;
+
+		while (this->_QueueCount != 0)
+		{
+			const SIMULATED_NOTIFICATION notification = this->_Queue[this->_QueueHead];
+
+			this->_QueueHead = (this->_QueueHead + 1) % NOTIFICATION_CAPACITY;
+			this->_QueueCount--;
+
+			lock.unlock();
+
+			{
+				std::lock_guard<std::mutex> delivery(this->_DeliveryLock);
+
+				const PSIMULATED_TARGET target = FromEntry(this->_Serials->Lookup(notification.SerialNo));
+
+				if (target && target->Callback)
+					target->Callback(target->Context, notification.LargeMotor, notification.SmallMotor);
+			}
+
+			lock.lock();
+		}
+
+		lock.unlock();
+
+		while (this->_Events.Drain(events, RTL_NUMBER_OF(events)) == RTL_NUMBER_OF(events))
+		{
+		}
+
+		lock.lock();
+	}
+}
+
+std::unique_ptr<ViGEm::Bench::Transport> ViGEm::Bench::CreateTransport()
+{
+	return std::make_unique<SimulatedBus>();
+}
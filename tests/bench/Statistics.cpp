@@ -0,0 +1,154 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Statistics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+
+#pragma region Allocation counting
+
+static std::atomic<ULONGLONG> g_Allocations{ 0 };
+
+void* operator new(size_t Size)
+{
+	g_Allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* p = malloc(Size ? Size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t Size)
+{
+	return operator new(Size);
+}
+
+void* operator new(size_t Size, const std::nothrow_t&) noexcept
+{
+	g_Allocations.fetch_add(1, std::memory_order_relaxed);
+
+	return malloc(Size ? Size : 1);
+}
+
+void* operator new[](size_t Size, const std::nothrow_t& Tag) noexcept
+{
+	return operator new(Size, Tag);
+}
+
+void operator delete(void* P) noexcept
+{
+	free(P);
+}
+
+void operator delete[](void* P) noexcept
+{
+	free(P);
+}
+
+void operator delete(void* P, size_t) noexcept
+{
+	free(P);
+}
+
+void operator delete[](void* P, size_t) noexcept
+{
+	free(P);
+}
+
+#pragma endregion
+
+ULONGLONG ViGEm::Bench::GetTimestamp()
+{
+	return static_cast<ULONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+ULONGLONG ViGEm::Bench::GetAllocationCount()
+{
+	return g_Allocations.load(std::memory_order_relaxed);
+}
+
+void ViGEm::Bench::LatencyRecorder::Add(ULONGLONG Nanoseconds)
+{
+	const size_t index = this->_Count.fetch_add(1, std::memory_order_relaxed);
+
+	if (index < this->_Samples.size())
+		this->_Samples[index] = Nanoseconds;
+}
+
+size_t ViGEm::Bench::LatencyRecorder::Finish()
+{
+	const size_t count = std::min(this->_Count.load(), this->_Samples.size());
+
+	this->_Samples.resize(count);
+
+	std::sort(this->_Samples.begin(), this->_Samples.end());
+
+	return count;
+}
+
+ULONGLONG ViGEm::Bench::LatencyRecorder::GetPercentile(double Percentile) const
+{
+	if (this->_Samples.empty())
+		return 0;
+
+	const auto rank = static_cast<size_t>(Percentile / 100.0 * static_cast<double>(this->_Samples.size()) + 0.999999);
+
+	return this->_Samples[std::min(std::max(rank, static_cast<size_t>(1)), this->_Samples.size()) - 1];
+}
+
+ViGEm::Bench::BENCH_RESULT ViGEm::Bench::Summarize(const char* Name, LatencyRecorder& Latencies,
+                                                   ULONGLONG Operations, double Seconds, ULONGLONG Missed,
+                                                   ULONGLONG Allocations)
+{
+	BENCH_RESULT result;
+
+	result.Name = Name;
+	result.Operations = Operations;
+	result.Seconds = Seconds;
+	result.Missed = Missed;
+	result.Allocations = Allocations;
+	result.Samples = Latencies.Finish();
+	result.P50 = Latencies.GetPercentile(50.0);
+	result.P99 = Latencies.GetPercentile(99.0);
+	result.P999 = Latencies.GetPercentile(99.9);
+
+	return result;
+}
@@ -0,0 +1,114 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Transport.hpp"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace ViGEm::Bench
+{
+	//
+	// Monotonic time in nanoseconds
+	// 
+	ULONGLONG GetTimestamp();
+
+	//
+	// Heap allocations of the process so far, pool included
+	// 
+	ULONGLONG GetAllocationCount();
+
+	//
+	// Latency samples of one operation.
+	// 
+	// Storage is reserved up front so recording doesn't allocate during a
+	// measurement; samples beyond the capacity are not kept. Safe to add
+	// from multiple threads.
+	// 
+	class LatencyRecorder
+	{
+	public:
+		explicit LatencyRecorder(size_t Capacity) : _Samples(Capacity) {}
+
+		void Add(ULONGLONG Nanoseconds);
+
+		//
+		// Sorts the kept samples, returns their count
+		// 
+		size_t Finish();
+
+		//
+		// Nearest-rank percentile of the sorted samples, 0 without any
+		// 
+		ULONGLONG GetPercentile(double Percentile) const;
+
+	private:
+		std::vector<ULONGLONG> _Samples;
+
+		std::atomic<size_t> _Count{ 0 };
+	};
+
+	typedef struct _BENCH_RESULT
+	{
+		std::string Name;
+
+		ULONGLONG Operations;
+
+		double Seconds;
+
+		//
+		// Operations that didn't complete in time: notifications never
+		// delivered, feed ticks started late
+		// 
+		ULONGLONG Missed;
+
+		ULONGLONG Allocations;
+
+		ULONGLONG Samples;
+
+		ULONGLONG P50;
+
+		ULONGLONG P99;
+
+		ULONGLONG P999;
+
+	} BENCH_RESULT, *PBENCH_RESULT;
+
+	BENCH_RESULT Summarize(const char* Name, LatencyRecorder& Latencies, ULONGLONG Operations, double Seconds,
+	                       ULONGLONG Missed, ULONGLONG Allocations);
+}
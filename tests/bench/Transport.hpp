@@ -0,0 +1,98 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include "Platform.hpp"
+#endif
+
+#include <ViGEm/Common.h>
+
+#include <memory>
+
+namespace ViGEm::Bench
+{
+	//
+	// Opaque target handed out by a transport
+	// 
+	typedef PVOID BENCH_TARGET;
+
+	//
+	// Vibration received by a target, see Transport::Rumble
+	// 
+	typedef void (*BENCH_RUMBLE_CALLBACK)(PVOID Context, UCHAR LargeMotor, UCHAR SmallMotor);
+
+	//
+	// Path the scenarios drive Xbox 360 targets through.
+	// 
+	// Implemented by the simulated bus on Linux and by the client library
+	// talking to the installed driver on Windows. Scenarios never unplug a
+	// target another thread still submits to.
+	// 
+	class Transport
+	{
+	public:
+		virtual ~Transport() = default;
+
+		virtual const char* GetName() const = 0;
+
+		//
+		// Plugs in a target, returns once reports can be submitted
+		// 
+		virtual bool Plug(BENCH_TARGET* Target) = 0;
+
+		virtual void Unplug(BENCH_TARGET Target) = 0;
+
+		virtual bool Submit(BENCH_TARGET Target, const XUSB_REPORT& Report) = 0;
+
+		//
+		// Callback invoked for every vibration the target receives
+		// 
+		virtual bool RegisterRumble(BENCH_TARGET Target, BENCH_RUMBLE_CALLBACK Callback, PVOID Context) = 0;
+
+		//
+		// Sends vibration to the target the way a game would
+		// 
+		virtual bool Rumble(BENCH_TARGET Target, UCHAR LargeMotor, UCHAR SmallMotor) = 0;
+	};
+
+	//
+	// Returns nullptr if the bus can't be reached
+	// 
+	std::unique_ptr<Transport> CreateTransport();
+}
@@ -0,0 +1,535 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MockBus.hpp"
+
+#include "SerialTable.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using ViGEm::Tests::MOCK_BUS_DRIVER;
+using ViGEm::Tests::MockBus;
+using ViGEm::Tests::ScopedMockBus;
+
+MOCK_BUS_DRIVER ViGEm::Tests::MockCurrentDriver()
+{
+	MOCK_BUS_DRIVER driver;
+
+	driver.Version = VIGEM_COMMON_VERSION;
+	driver.ReportsCapabilities = true;
+	driver.Features = VIGEM_BUS_FEATURE_ASSIGN_SERIAL
+		| VIGEM_BUS_FEATURE_WAIT_DEVICE_READY
+		| VIGEM_BUS_FEATURE_DS4_REPORT_EX
+		| VIGEM_BUS_FEATURE_USER_INDEX_WAIT;
+	driver.MaxTargets = ViGEm::Bus::Core::SerialTable::MAX_SERIAL;
+	driver.ServiceTimeUs = 0;
+
+	return driver;
+}
+
+MOCK_BUS_DRIVER ViGEm::Tests::MockLegacyDriver()
+{
+	MOCK_BUS_DRIVER driver;
+
+	driver.Version = VIGEM_COMMON_VERSION;
+	driver.ReportsCapabilities = false;
+	driver.Features = 0;
+	driver.MaxTargets = ViGEm::Bus::Core::SerialTable::MAX_SERIAL;
+	driver.ServiceTimeUs = 0;
+
+	return driver;
+}
+
+MockBus::MockBus(const MOCK_BUS_DRIVER& Driver) : _Driver(Driver)
+{
+}
+
+DWORD MockBus::Control(
+	HANDLE File,
+	DWORD IoControlCode,
+	PVOID InBuffer,
+	DWORD InBufferSize,
+	PVOID OutBuffer,
+	DWORD OutBufferSize,
+	LPDWORD BytesReturned,
+	LPOVERLAPPED Overlapped
+)
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	_Requests[IoControlCode]++;
+
+	if (_Driver.ServiceTimeUs)
+		std::this_thread::sleep_for(std::chrono::microseconds(_Driver.ServiceTimeUs));
+
+	switch (IoControlCode)
+	{
+	case IOCTL_VIGEM_CHECK_VERSION:
+	{
+		if (InBufferSize != sizeof(VIGEM_CHECK_VERSION))
+			return ERROR_INVALID_PARAMETER;
+
+		const auto version = static_cast<PVIGEM_CHECK_VERSION>(InBuffer);
+
+		return (version->Version == _Driver.Version) ? ERROR_SUCCESS : ERROR_NOT_SUPPORTED;
+	}
+	case IOCTL_VIGEM_GET_CAPABILITIES:
+	{
+		if (!_Driver.ReportsCapabilities
+			|| InBufferSize < VIGEM_GET_CAPABILITIES_MIN_SIZE
+			|| OutBufferSize < VIGEM_GET_CAPABILITIES_MIN_SIZE)
+			return ERROR_INVALID_PARAMETER;
+
+		VIGEM_GET_CAPABILITIES reply;
+		VIGEM_GET_CAPABILITIES_INIT(&reply);
+
+		reply.Capabilities.Size = sizeof(VIGEM_BUS_CAPABILITIES);
+		reply.Capabilities.Version = _Driver.Version;
+		reply.Capabilities.Features = _Driver.Features;
+		reply.Capabilities.MaxTargets = _Driver.MaxTargets;
+
+		//
+		// Answers as much as the caller asked for, like the driver
+		// 
+		*BytesReturned = min(OutBufferSize, static_cast<DWORD>(sizeof(VIGEM_GET_CAPABILITIES)));
+		reply.Capabilities.Size = *BytesReturned - FIELD_OFFSET(VIGEM_GET_CAPABILITIES, Capabilities);
+
+		memcpy(OutBuffer, &reply, *BytesReturned);
+
+		return ERROR_SUCCESS;
+	}
+	case IOCTL_VIGEM_PLUGIN_TARGET:
+		return PlugIn(File, InBuffer, InBufferSize, OutBuffer, OutBufferSize, BytesReturned, false);
+	case IOCTL_VIGEM_PLUGIN_TARGET_EX:
+		if (!(_Driver.Features & VIGEM_BUS_FEATURE_ASSIGN_SERIAL))
+			return ERROR_INVALID_PARAMETER;
+
+		return PlugIn(File, InBuffer, InBufferSize, OutBuffer, OutBufferSize, BytesReturned, true);
+	case IOCTL_VIGEM_WAIT_DEVICE_READY:
+	{
+		if (!(_Driver.Features & VIGEM_BUS_FEATURE_WAIT_DEVICE_READY) || InBufferSize != sizeof(VIGEM_WAIT_DEVICE_READY))
+			return ERROR_INVALID_PARAMETER;
+
+		const auto target = _Targets.find(static_cast<PVIGEM_WAIT_DEVICE_READY>(InBuffer)->SerialNo);
+
+		if (target == _Targets.end())
+			return ERROR_DEV_NOT_EXIST;
+
+		return (target->second.Owner == File) ? ERROR_SUCCESS : ERROR_ACCESS_DENIED;
+	}
+	case IOCTL_VIGEM_UNPLUG_TARGET:
+	{
+		if (InBufferSize != sizeof(VIGEM_UNPLUG_TARGET))
+			return ERROR_INVALID_PARAMETER;
+
+		const auto target = _Targets.find(static_cast<PVIGEM_UNPLUG_TARGET>(InBuffer)->SerialNo);
+
+		//
+		// Unknown and foreign serials succeed without effect
+		// 
+		if (target != _Targets.end() && target->second.Owner == File)
+			Remove(target);
+
+		return ERROR_SUCCESS;
+	}
+	case IOCTL_XUSB_SUBMIT_REPORT:
+		return Submit(File, InBuffer, InBufferSize, sizeof(XUSB_SUBMIT_REPORT), Xbox360Wired);
+	case IOCTL_DS4_SUBMIT_REPORT:
+		if (InBufferSize == sizeof(DS4_SUBMIT_REPORT_EX) && (_Driver.Features & VIGEM_BUS_FEATURE_DS4_REPORT_EX))
+			return Submit(File, InBuffer, InBufferSize, sizeof(DS4_SUBMIT_REPORT_EX), DualShock4Wired);
+
+		return Submit(File, InBuffer, InBufferSize, sizeof(DS4_SUBMIT_REPORT), DualShock4Wired);
+	case IOCTL_XUSB_REQUEST_NOTIFICATION:
+	case IOCTL_DS4_REQUEST_NOTIFICATION:
+	{
+		const auto type = (IoControlCode == IOCTL_XUSB_REQUEST_NOTIFICATION) ? Xbox360Wired : DualShock4Wired;
+		const auto size = (type == Xbox360Wired) ? sizeof(XUSB_REQUEST_NOTIFICATION) : sizeof(DS4_REQUEST_NOTIFICATION);
+
+		if (InBufferSize != size || OutBufferSize < size)
+			return ERROR_INVALID_PARAMETER;
+
+		const auto target = _Targets.find(static_cast<PXUSB_REQUEST_NOTIFICATION>(InBuffer)->SerialNo);
+
+		if (target == _Targets.end() || target->second.Type != type)
+			return ERROR_DEV_NOT_EXIST;
+
+		target->second.Notifications.push_back({ File, Overlapped, OutBuffer });
+
+		return ERROR_IO_PENDING;
+	}
+	case IOCTL_XUSB_GET_USER_INDEX:
+	{
+		if (InBufferSize != sizeof(XUSB_GET_USER_INDEX) || OutBufferSize < sizeof(XUSB_GET_USER_INDEX))
+			return ERROR_INVALID_PARAMETER;
+
+		const auto request = static_cast<PXUSB_GET_USER_INDEX>(OutBuffer);
+		const auto target = _Targets.find(static_cast<PXUSB_GET_USER_INDEX>(InBuffer)->SerialNo);
+
+		if (target == _Targets.end() || target->second.Type != Xbox360Wired)
+			return ERROR_DEV_NOT_EXIST;
+
+		const CHAR index = target->second.UserIndex.Get();
+
+		if (index == Bus::Core::UserIndexWatcher::UNASSIGNED)
+			return ERROR_INVALID_DEVICE_OBJECT_PARAMETER;
+
+		request->UserIndex = static_cast<ULONG>(index);
+		*BytesReturned = sizeof(XUSB_GET_USER_INDEX);
+
+		return ERROR_SUCCESS;
+	}
+	case IOCTL_XUSB_WAIT_USER_INDEX:
+	{
+		if (!(_Driver.Features & VIGEM_BUS_FEATURE_USER_INDEX_WAIT)
+			|| InBufferSize != sizeof(XUSB_WAIT_USER_INDEX)
+			|| OutBufferSize < sizeof(XUSB_WAIT_USER_INDEX))
+			return ERROR_INVALID_PARAMETER;
+
+		const auto request = static_cast<PXUSB_WAIT_USER_INDEX>(OutBuffer);
+		const auto target = _Targets.find(static_cast<PXUSB_WAIT_USER_INDEX>(InBuffer)->SerialNo);
+
+		if (target == _Targets.end() || target->second.Type != Xbox360Wired)
+			return ERROR_DEV_NOT_EXIST;
+
+		const CHAR index = target->second.UserIndex.Get();
+
+		if (Bus::Core::UserIndexWatcher::Satisfies(index, request->KnownUserIndex))
+		{
+			request->UserIndex = static_cast<ULONG>(index);
+			*BytesReturned = sizeof(XUSB_WAIT_USER_INDEX);
+
+			return ERROR_SUCCESS;
+		}
+
+		target->second.UserIndexWaits.push_back({ File, Overlapped, OutBuffer });
+
+		return ERROR_IO_PENDING;
+	}
+	default:
+		return ERROR_INVALID_PARAMETER;
+	}
+}
+
+VOID MockBus::Cleanup(HANDLE File)
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	//
+	// The session ends, so do its targets and requests
+	// 
+	for (auto target = _Targets.begin(); target != _Targets.end();)
+	{
+		const auto next = std::next(target);
+
+		if (target->second.Owner == File)
+		{
+			Remove(target);
+			target = next;
+			continue;
+		}
+
+		for (auto* requests : { &target->second.Notifications, &target->second.UserIndexWaits })
+		{
+			for (auto request = requests->begin(); request != requests->end();)
+			{
+				if (request->File != File)
+				{
+					++request;
+					continue;
+				}
+
+				CompleteIo(request->Overlapped, ERROR_OPERATION_ABORTED, 0);
+				request = requests->erase(request);
+			}
+		}
+
+		target = next;
+	}
+}
+
+ULONG MockBus::GetTargetCount() const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	return static_cast<ULONG>(_Targets.size());
+}
+
+ULONG MockBus::GetRequests(DWORD IoControlCode) const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	const auto requests = _Requests.find(IoControlCode);
+
+	return (requests != _Requests.end()) ? requests->second : 0;
+}
+
+ULONG MockBus::GetReports(ULONG SerialNo) const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	const auto target = _Targets.find(SerialNo);
+
+	return (target != _Targets.end()) ? target->second.Reports : 0;
+}
+
+std::vector<UCHAR> MockBus::GetLastReport(ULONG SerialNo) const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	const auto target = _Targets.find(SerialNo);
+
+	return (target != _Targets.end()) ? target->second.LastReport : std::vector<UCHAR>();
+}
+
+ULONG MockBus::GetPendingNotifications(ULONG SerialNo) const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	const auto target = _Targets.find(SerialNo);
+
+	return (target != _Targets.end()) ? static_cast<ULONG>(target->second.Notifications.size()) : 0;
+}
+
+ULONG MockBus::GetPendingUserIndexWaits(ULONG SerialNo) const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	const auto target = _Targets.find(SerialNo);
+
+	return (target != _Targets.end()) ? static_cast<ULONG>(target->second.UserIndexWaits.size()) : 0;
+}
+
+ULONG MockBus::Notify(ULONG SerialNo, UCHAR LargeMotor, UCHAR SmallMotor, UCHAR LedNumber)
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	const auto target = _Targets.find(SerialNo);
+
+	if (target == _Targets.end())
+		return 0;
+
+	auto& requests = target->second.Notifications;
+	const auto count = static_cast<ULONG>(requests.size());
+
+	for (const auto& request : requests)
+	{
+		if (target->second.Type == Xbox360Wired)
+		{
+			const auto notification = static_cast<PXUSB_REQUEST_NOTIFICATION>(request.OutBuffer);
+
+			notification->LargeMotor = LargeMotor;
+			notification->SmallMotor = SmallMotor;
+			notification->LedNumber = LedNumber;
+
+			CompleteIo(request.Overlapped, ERROR_SUCCESS, sizeof(XUSB_REQUEST_NOTIFICATION));
+		}
+		else
+		{
+			const auto notification = static_cast<PDS4_REQUEST_NOTIFICATION>(request.OutBuffer);
+
+			notification->Report.LargeMotor = LargeMotor;
+			notification->Report.SmallMotor = SmallMotor;
+			notification->Report.LightbarColor = { LedNumber, 0, 0 };
+
+			CompleteIo(request.Overlapped, ERROR_SUCCESS, sizeof(DS4_REQUEST_NOTIFICATION));
+		}
+	}
+
+	requests.clear();
+
+	return count;
+}
+
+bool MockBus::SetLed(ULONG SerialNo, UCHAR Pattern)
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	const auto target = _Targets.find(SerialNo);
+
+	if (target == _Targets.end() || target->second.Type != Xbox360Wired)
+		return false;
+
+	const UCHAR packet[Bus::Core::UserIndexWatcher::LED_PACKET_SIZE] = { 0x01, 0x03, Pattern };
+	CHAR previous;
+
+	if (!target->second.UserIndex.ApplyLedPacket(packet, sizeof(packet), &previous))
+		return false;
+
+	const CHAR index = target->second.UserIndex.Get();
+	auto& waits = target->second.UserIndexWaits;
+
+	//
+	// Same as the driver: waits the index is no news to stay pending
+	// 
+	waits.erase(std::remove_if(waits.begin(), waits.end(), [index](const PENDING_REQUEST& Request)
+	{
+		const auto wait = static_cast<PXUSB_WAIT_USER_INDEX>(Request.OutBuffer);
+
+		if (!Bus::Core::UserIndexWatcher::Satisfies(index, wait->KnownUserIndex))
+			return false;
+
+		wait->UserIndex = static_cast<ULONG>(index);
+		CompleteIo(Request.Overlapped, ERROR_SUCCESS, sizeof(XUSB_WAIT_USER_INDEX));
+
+		return true;
+	}), waits.end());
+
+	return true;
+}
+
+bool MockBus::SetUserIndex(ULONG SerialNo, ULONG UserIndex)
+{
+	return SetLed(SerialNo, static_cast<UCHAR>(0x02 + UserIndex));
+}
+
+bool MockBus::Unplug(ULONG SerialNo)
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	const auto target = _Targets.find(SerialNo);
+
+	if (target == _Targets.end())
+		return false;
+
+	Remove(target);
+
+	return true;
+}
+
+DWORD MockBus::PlugIn(
+	HANDLE File,
+	PVOID InBuffer,
+	DWORD InBufferSize,
+	PVOID OutBuffer,
+	DWORD OutBufferSize,
+	LPDWORD BytesReturned,
+	bool AssignSerial
+)
+{
+	if (InBufferSize != sizeof(VIGEM_PLUGIN_TARGET))
+		return ERROR_INVALID_PARAMETER;
+
+	const auto plugIn = static_cast<PVIGEM_PLUGIN_TARGET>(InBuffer);
+	ULONG serialNo = plugIn->SerialNo;
+
+	if (plugIn->TargetType != Xbox360Wired && plugIn->TargetType != DualShock4Wired)
+		return ERROR_NOT_SUPPORTED;
+
+	if (AssignSerial)
+	{
+		if (OutBufferSize < sizeof(VIGEM_PLUGIN_TARGET))
+			return ERROR_INVALID_PARAMETER;
+
+		//
+		// Lowest free serial, like the serial table of the bus
+		// 
+		for (serialNo = 1; serialNo <= _Driver.MaxTargets; serialNo++)
+		{
+			if (_Targets.find(serialNo) == _Targets.end())
+				break;
+		}
+
+		if (serialNo > _Driver.MaxTargets)
+			return ERROR_NO_MORE_ITEMS;
+	}
+	else if (serialNo == 0 || serialNo > _Driver.MaxTargets || _Targets.find(serialNo) != _Targets.end())
+		return ERROR_INVALID_PARAMETER;
+
+	auto& target = _Targets[serialNo];
+
+	target.Type = plugIn->TargetType;
+	target.Owner = File;
+	target.UserIndex.Reset();
+
+	if (AssignSerial)
+	{
+		static_cast<PVIGEM_PLUGIN_TARGET>(OutBuffer)->SerialNo = serialNo;
+		*BytesReturned = sizeof(VIGEM_PLUGIN_TARGET);
+	}
+
+	return ERROR_SUCCESS;
+}
+
+DWORD MockBus::Submit(HANDLE File, PVOID InBuffer, DWORD InBufferSize, DWORD Size, VIGEM_TARGET_TYPE Type)
+{
+	if (InBufferSize != Size)
+		return ERROR_INVALID_PARAMETER;
+
+	const auto target = _Targets.find(static_cast<PXUSB_SUBMIT_REPORT>(InBuffer)->SerialNo);
+
+	if (target == _Targets.end() || target->second.Type != Type)
+		return ERROR_DEV_NOT_EXIST;
+
+	if (target->second.Owner != File)
+		return ERROR_ACCESS_DENIED;
+
+	const auto report = static_cast<PUCHAR>(InBuffer);
+
+	target->second.Reports++;
+	target->second.LastReport.assign(report, report + Size);
+
+	return ERROR_SUCCESS;
+}
+
+VOID MockBus::Remove(std::map<ULONG, TARGET>::iterator Target)
+{
+	//
+	// Removing the device purges its queues
+	// 
+	for (const auto& request : Target->second.Notifications)
+		CompleteIo(request.Overlapped, ERROR_OPERATION_ABORTED, 0);
+
+	for (const auto& request : Target->second.UserIndexWaits)
+		CompleteIo(request.Overlapped, ERROR_OPERATION_ABORTED, 0);
+
+	_Targets.erase(Target);
+}
+
+ScopedMockBus::ScopedMockBus(const MOCK_BUS_DRIVER& Driver) : _Bus(std::make_shared<MockBus>(Driver))
+{
+	static std::atomic<ULONG> instances;
+
+	_Path = L"\\\\?\\ROOT#SYSTEM#" + std::to_wstring(instances++) + L"#{96E42B22-F5E9-42F8-B043-ED0F932F014F}";
+
+	AddDevice(_Path, _Bus);
+}
+
+ScopedMockBus::~ScopedMockBus()
+{
+	RemoveDevice(_Path);
+}
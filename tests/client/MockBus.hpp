@@ -0,0 +1,222 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Win32.hpp"
+
+#include "UserIndexWatcher.hpp"
+
+#include <ViGEm/Client.h>
+#include <ViGEm/km/BusShared.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ViGEm::Tests
+{
+	//
+	// Driver version a mock bus behaves like
+	// 
+	typedef struct _MOCK_BUS_DRIVER
+	{
+		//
+		// Interface version IOCTL_VIGEM_CHECK_VERSION accepts
+		// 
+		USHORT Version;
+
+		//
+		// Whether IOCTL_VIGEM_GET_CAPABILITIES exists
+		// 
+		bool ReportsCapabilities;
+
+		//
+		// VIGEM_BUS_FEATURE_* the driver implements, the requests of the
+		// others are unknown to it
+		// 
+		ULONG Features;
+
+		ULONG MaxTargets;
+
+		//
+		// Time every request keeps the bus busy, in microseconds. Requests
+		// of one bus take turns, those of different buses overlap.
+		// 
+		ULONG ServiceTimeUs;
+
+	} MOCK_BUS_DRIVER;
+
+	//
+	// The driver of this tree
+	// 
+	MOCK_BUS_DRIVER MockCurrentDriver();
+
+	//
+	// A driver from before v1.17: plug-in by probing serials, no wait for
+	// the device, no capabilities
+	// 
+	MOCK_BUS_DRIVER MockLegacyDriver();
+
+	//
+	// Bus device answering the requests of the client library the way the
+	// driver does, for the target lifecycle, reports and notifications.
+	// Requests outside of that are unknown to it. Plugged in targets are
+	// ready right away.
+	// 
+	class MockBus final : public Win32Device
+	{
+	public:
+		explicit MockBus(const MOCK_BUS_DRIVER& Driver = MockCurrentDriver());
+
+		DWORD Control(
+			HANDLE File,
+			DWORD IoControlCode,
+			PVOID InBuffer,
+			DWORD InBufferSize,
+			PVOID OutBuffer,
+			DWORD OutBufferSize,
+			LPDWORD BytesReturned,
+			LPOVERLAPPED Overlapped
+		) override;
+
+		VOID Cleanup(HANDLE File) override;
+
+		ULONG GetTargetCount() const;
+
+		//
+		// Requests received with the control code, answered or not
+		// 
+		ULONG GetRequests(DWORD IoControlCode) const;
+
+		//
+		// Reports submitted to the target and the last one of them
+		// 
+		ULONG GetReports(ULONG SerialNo) const;
+		std::vector<UCHAR> GetLastReport(ULONG SerialNo) const;
+
+		ULONG GetPendingNotifications(ULONG SerialNo) const;
+		ULONG GetPendingUserIndexWaits(ULONG SerialNo) const;
+
+		//
+		// Completes every vibration request pending on the target, returns
+		// how many. DualShock 4 targets get the LED as red of the lightbar.
+		// 
+		ULONG Notify(ULONG SerialNo, UCHAR LargeMotor, UCHAR SmallMotor, UCHAR LedNumber);
+
+		//
+		// Sends the LED set packet of the host to an Xbox 360 target, the
+		// driver takes the user index from it and completes the waits for
+		// a different one. Returns whether the index changed.
+		// 
+		bool SetLed(ULONG SerialNo, UCHAR Pattern);
+
+		//
+		// Lights the quadrant of the user index
+		// 
+		bool SetUserIndex(ULONG SerialNo, ULONG UserIndex);
+
+		//
+		// Removes the target as if its owner asked for it
+		// 
+		bool Unplug(ULONG SerialNo);
+
+	private:
+		typedef struct _PENDING_REQUEST
+		{
+			HANDLE File;
+			LPOVERLAPPED Overlapped;
+			PVOID OutBuffer;
+
+		} PENDING_REQUEST;
+
+		typedef struct _TARGET
+		{
+			VIGEM_TARGET_TYPE Type;
+
+			//
+			// Handle the target got plugged in through, its session
+			// 
+			HANDLE Owner;
+
+			Bus::Core::UserIndexWatcher UserIndex;
+			ULONG Reports;
+			std::vector<UCHAR> LastReport;
+
+			std::vector<PENDING_REQUEST> Notifications;
+			std::vector<PENDING_REQUEST> UserIndexWaits;
+
+		} TARGET;
+
+		DWORD PlugIn(HANDLE File, PVOID InBuffer, DWORD InBufferSize, PVOID OutBuffer, DWORD OutBufferSize, LPDWORD BytesReturned, bool AssignSerial);
+		DWORD Submit(HANDLE File, PVOID InBuffer, DWORD InBufferSize, DWORD Size, VIGEM_TARGET_TYPE Type);
+
+		//
+		// Cancels what's pending on the target and forgets it
+		// 
+		VOID Remove(std::map<ULONG, TARGET>::iterator Target);
+
+		const MOCK_BUS_DRIVER _Driver;
+
+		mutable std::mutex _Lock;
+
+		std::map<ULONG, TARGET> _Targets;
+		std::map<DWORD, ULONG> _Requests;
+	};
+
+	//
+	// Mock bus present under an interface path of its own while in scope
+	// 
+	class ScopedMockBus
+	{
+	public:
+		explicit ScopedMockBus(const MOCK_BUS_DRIVER& Driver = MockCurrentDriver());
+		~ScopedMockBus();
+
+		ScopedMockBus(const ScopedMockBus&) = delete;
+		ScopedMockBus& operator=(const ScopedMockBus&) = delete;
+
+		MockBus* operator->() const { return _Bus.get(); }
+
+		const std::wstring& GetPath() const { return _Path; }
+
+	private:
+		std::wstring _Path;
+
+		std::shared_ptr<MockBus> _Bus;
+	};
+}
@@ -0,0 +1,181 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "MockDiscovery.hpp"
+
+#include <Internal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using ViGEm::Tests::ScopedMockDiscovery;
+
+//
+// The one in scope, the discovery table has no context
+// 
+static ScopedMockDiscovery* g_Discovery;
+
+ScopedMockDiscovery::ScopedMockDiscovery(ULONG EnumerateTimeUs)
+	: _EnumerateTimeUs(EnumerateTimeUs), _Previous(vigem_internal_discovery), _Enumerations(0), _Opens(0)
+{
+	static const VIGEM_BUS_DISCOVERY discovery = {
+		Enumerate,
+		Open,
+		Watch,
+		Unwatch
+	};
+
+	g_Discovery = this;
+	vigem_internal_discovery = &discovery;
+}
+
+ScopedMockDiscovery::~ScopedMockDiscovery()
+{
+	vigem_internal_discovery = _Previous;
+	g_Discovery = nullptr;
+}
+
+VOID ScopedMockDiscovery::Arrive(const std::wstring& Path, bool Announce)
+{
+	{
+		std::lock_guard<std::mutex> lock(_Lock);
+
+		if (std::find(_Present.begin(), _Present.end(), Path) == _Present.end())
+			_Present.push_back(Path);
+	}
+
+	if (Announce)
+		Report(VIGEM_BUS_EVENT_ARRIVAL, Path);
+}
+
+VOID ScopedMockDiscovery::Remove(const std::wstring& Path, bool Announce)
+{
+	{
+		std::lock_guard<std::mutex> lock(_Lock);
+
+		_Present.erase(std::remove(_Present.begin(), _Present.end(), Path), _Present.end());
+	}
+
+	if (Announce)
+		Report(VIGEM_BUS_EVENT_REMOVAL, Path);
+}
+
+ULONG ScopedMockDiscovery::GetEnumerations() const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	return _Enumerations;
+}
+
+ULONG ScopedMockDiscovery::GetOpens() const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	return _Opens;
+}
+
+ULONG ScopedMockDiscovery::GetWatchers() const
+{
+	std::lock_guard<std::mutex> lock(_Lock);
+
+	return static_cast<ULONG>(_Watchers.size());
+}
+
+VOID ScopedMockDiscovery::Enumerate(std::vector<std::wstring>& Paths)
+{
+	const auto discovery = g_Discovery;
+
+	if (discovery->_EnumerateTimeUs)
+		std::this_thread::sleep_for(std::chrono::microseconds(discovery->_EnumerateTimeUs));
+
+	std::lock_guard<std::mutex> lock(discovery->_Lock);
+
+	discovery->_Enumerations++;
+	Paths.insert(Paths.end(), discovery->_Present.begin(), discovery->_Present.end());
+}
+
+VIGEM_ERROR ScopedMockDiscovery::Open(LPCWSTR Path, PHANDLE Bus)
+{
+	const auto discovery = g_Discovery;
+
+	{
+		std::lock_guard<std::mutex> lock(discovery->_Lock);
+
+		discovery->_Opens++;
+
+		//
+		// Removed devices can't be opened, even if the stand-in still has them
+		// 
+		if (std::find(discovery->_Present.begin(), discovery->_Present.end(), Path) == discovery->_Present.end())
+			return VIGEM_ERROR_BUS_NOT_FOUND;
+	}
+
+	return discovery->_Previous->Open(Path, Bus);
+}
+
+VIGEM_ERROR ScopedMockDiscovery::Watch(PVIGEM_CLIENT Client)
+{
+	std::lock_guard<std::mutex> lock(g_Discovery->_Lock);
+
+	g_Discovery->_Watchers.push_back(Client);
+
+	return VIGEM_ERROR_NONE;
+}
+
+VOID ScopedMockDiscovery::Unwatch(PVIGEM_CLIENT Client)
+{
+	std::lock_guard<std::mutex> report(g_Discovery->_ReportLock);
+	std::lock_guard<std::mutex> lock(g_Discovery->_Lock);
+
+	auto& watchers = g_Discovery->_Watchers;
+
+	watchers.erase(std::remove(watchers.begin(), watchers.end(), Client), watchers.end());
+}
+
+VOID ScopedMockDiscovery::Report(VIGEM_BUS_EVENT Event, const std::wstring& Path)
+{
+	std::lock_guard<std::mutex> report(_ReportLock);
+	std::vector<PVIGEM_CLIENT> watchers;
+
+	{
+		std::lock_guard<std::mutex> lock(_Lock);
+
+		watchers = _Watchers;
+	}
+
+	for (const auto client : watchers)
+		vigem_internal_bus_changed(client, Event, Path.c_str());
+}
@@ -0,0 +1,112 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "Win32.hpp"
+
+#include <ViGEm/Client.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct _VIGEM_BUS_DISCOVERY;
+
+namespace ViGEm::Tests
+{
+	//
+	// Bus discovery of the client library replaced while in scope: bus
+	// devices are found only once they arrived here, arrival and removal
+	// get reported to the watching clients right away, on the calling
+	// thread. Opening still goes to the devices of the Win32 stand-in.
+	// 
+	class ScopedMockDiscovery
+	{
+	public:
+		//
+		// Enumerations take EnumerateTimeUs each, like a walk of the
+		// device interfaces would
+		// 
+		explicit ScopedMockDiscovery(ULONG EnumerateTimeUs = 0);
+		~ScopedMockDiscovery();
+
+		ScopedMockDiscovery(const ScopedMockDiscovery&) = delete;
+		ScopedMockDiscovery& operator=(const ScopedMockDiscovery&) = delete;
+
+		//
+		// The bus device at Path shows up in enumerations from now on,
+		// watching clients learn about it if Announce
+		// 
+		VOID Arrive(const std::wstring& Path, bool Announce = true);
+
+		//
+		// The bus device at Path is gone from enumerations
+		// 
+		VOID Remove(const std::wstring& Path, bool Announce = true);
+
+		ULONG GetEnumerations() const;
+		ULONG GetOpens() const;
+
+		//
+		// Clients between Watch and Unwatch
+		// 
+		ULONG GetWatchers() const;
+
+	private:
+		static VOID Enumerate(std::vector<std::wstring>& Paths);
+		static VIGEM_ERROR Open(LPCWSTR Path, PHANDLE Bus);
+		static VIGEM_ERROR Watch(PVIGEM_CLIENT Client);
+		static VOID Unwatch(PVIGEM_CLIENT Client);
+
+		VOID Report(VIGEM_BUS_EVENT Event, const std::wstring& Path);
+
+		const ULONG _EnumerateTimeUs;
+
+		const _VIGEM_BUS_DISCOVERY* _Previous;
+
+		mutable std::mutex _Lock;
+
+		std::vector<std::wstring> _Present;
+		std::vector<PVIGEM_CLIENT> _Watchers;
+		ULONG _Enumerations;
+		ULONG _Opens;
+
+		//
+		// Held while reporting, Unwatch waits for it
+		// 
+		std::mutex _ReportLock;
+	};
+}
@@ -0,0 +1,605 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Win32.hpp"
+
+#include <SetupAPI.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using ViGEm::Tests::Win32Device;
+
+namespace
+{
+	//
+	// Anything a handle refers to
+	// 
+	struct OBJECT
+	{
+		virtual ~OBJECT() = default;
+	};
+
+	struct EVENT_OBJECT final : OBJECT
+	{
+		std::mutex Lock;
+		std::condition_variable Changed;
+		bool Signaled = false;
+		bool ManualReset = false;
+	};
+
+	struct FILE_OBJECT final : OBJECT
+	{
+		std::shared_ptr<Win32Device> Device;
+	};
+
+	typedef struct _WIN32_STATE
+	{
+		std::mutex Lock;
+
+		//
+		// Signaled whenever a handle gets closed
+		// 
+		std::condition_variable Closed;
+
+		//
+		// Open handles by number, numbers aren't reused
+		// 
+		std::unordered_map<ULONG_PTR, std::shared_ptr<OBJECT>> Handles;
+		ULONG_PTR NextHandle = 1;
+
+		//
+		// Present devices by interface path, in order of arrival
+		// 
+		std::vector<std::pair<std::wstring, std::shared_ptr<Win32Device>>> Devices;
+
+	} WIN32_STATE;
+
+	//
+	// Never destroyed, detached threads of the client may outlive main
+	// 
+	WIN32_STATE& GetState()
+	{
+		static auto state = new WIN32_STATE;
+
+		return *state;
+	}
+
+	//
+	// OVERLAPPED::Internal of a request not completed yet, any other value
+	// is the Win32 error it completed with
+	// 
+	constexpr ULONG_PTR IO_PENDING = ~static_cast<ULONG_PTR>(0);
+
+	thread_local DWORD g_LastError = ERROR_SUCCESS;
+
+	HANDLE InsertHandle(std::shared_ptr<OBJECT> Object)
+	{
+		auto& state = GetState();
+		std::lock_guard<std::mutex> lock(state.Lock);
+
+		const auto number = state.NextHandle++;
+		state.Handles.emplace(number, std::move(Object));
+
+		return reinterpret_cast<HANDLE>(number << 4);
+	}
+
+	template <typename T>
+	std::shared_ptr<T> LookupHandle(HANDLE Handle)
+	{
+		auto& state = GetState();
+		std::lock_guard<std::mutex> lock(state.Lock);
+
+		const auto entry = state.Handles.find(reinterpret_cast<ULONG_PTR>(Handle) >> 4);
+
+		if (entry == state.Handles.end())
+			return nullptr;
+
+		return std::dynamic_pointer_cast<T>(entry->second);
+	}
+}
+
+#pragma region Test hooks
+
+VOID ViGEm::Tests::AddDevice(const std::wstring& Path, std::shared_ptr<Win32Device> Device)
+{
+	auto& state = GetState();
+	std::lock_guard<std::mutex> lock(state.Lock);
+
+	state.Devices.emplace_back(Path, std::move(Device));
+}
+
+VOID ViGEm::Tests::RemoveDevice(const std::wstring& Path)
+{
+	auto& state = GetState();
+	std::lock_guard<std::mutex> lock(state.Lock);
+
+	for (auto device = state.Devices.begin(); device != state.Devices.end(); ++device)
+	{
+		if (wcscasecmp(device->first.c_str(), Path.c_str()) == 0)
+		{
+			state.Devices.erase(device);
+			break;
+		}
+	}
+}
+
+VOID ViGEm::Tests::CompleteIo(LPOVERLAPPED Overlapped, DWORD Error, DWORD BytesReturned)
+{
+	const auto event = Overlapped->hEvent;
+
+	__atomic_store_n(&Overlapped->InternalHigh, static_cast<ULONG_PTR>(BytesReturned), __ATOMIC_RELAXED);
+	__atomic_store_n(&Overlapped->Internal, static_cast<ULONG_PTR>(Error), __ATOMIC_RELEASE);
+
+	//
+	// The waiter may free Overlapped as soon as it sees the status
+	// 
+	if (event)
+		SetEvent(event);
+}
+
+SIZE_T ViGEm::Tests::GetOpenHandles()
+{
+	auto& state = GetState();
+	std::lock_guard<std::mutex> lock(state.Lock);
+
+	return state.Handles.size();
+}
+
+bool ViGEm::Tests::WaitOpenHandles(SIZE_T Count, DWORD Milliseconds)
+{
+	auto& state = GetState();
+	std::unique_lock<std::mutex> lock(state.Lock);
+
+	return state.Closed.wait_for(lock, std::chrono::milliseconds(Milliseconds), [&state, Count]
+	{
+		return state.Handles.size() <= Count;
+	});
+}
+
+#pragma endregion
+
+#pragma region Errors
+
+DWORD GetLastError()
+{
+	return g_LastError;
+}
+
+VOID SetLastError(DWORD Error)
+{
+	g_LastError = Error;
+}
+
+#pragma endregion
+
+#pragma region Synchronization
+
+HANDLE CreateEventW(LPVOID EventAttributes, BOOL ManualReset, BOOL InitialState, LPCWSTR Name)
+{
+	(void)EventAttributes;
+	(void)Name;
+
+	const auto event = std::make_shared<EVENT_OBJECT>();
+
+	event->Signaled = InitialState != FALSE;
+	event->ManualReset = ManualReset != FALSE;
+
+	return InsertHandle(event);
+}
+
+BOOL SetEvent(HANDLE Event)
+{
+	const auto event = LookupHandle<EVENT_OBJECT>(Event);
+
+	if (!event)
+	{
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+
+	std::lock_guard<std::mutex> lock(event->Lock);
+
+	event->Signaled = true;
+	event->Changed.notify_all();
+
+	return TRUE;
+}
+
+BOOL ResetEvent(HANDLE Event)
+{
+	const auto event = LookupHandle<EVENT_OBJECT>(Event);
+
+	if (!event)
+	{
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+
+	std::lock_guard<std::mutex> lock(event->Lock);
+
+	event->Signaled = false;
+
+	return TRUE;
+}
+
+DWORD WaitForSingleObject(HANDLE Handle, DWORD Milliseconds)
+{
+	const auto event = LookupHandle<EVENT_OBJECT>(Handle);
+
+	if (!event)
+	{
+		SetLastError(ERROR_INVALID_HANDLE);
+		return WAIT_FAILED;
+	}
+
+	std::unique_lock<std::mutex> lock(event->Lock);
+	const auto signaled = [&event] { return event->Signaled; };
+
+	if (Milliseconds == INFINITE)
+		event->Changed.wait(lock, signaled);
+	else if (!event->Changed.wait_for(lock, std::chrono::milliseconds(Milliseconds), signaled))
+		return WAIT_TIMEOUT;
+
+	if (!event->ManualReset)
+		event->Signaled = false;
+
+	return WAIT_OBJECT_0;
+}
+
+BOOL CloseHandle(HANDLE Object)
+{
+	auto& state = GetState();
+	std::shared_ptr<OBJECT> object;
+
+	{
+		std::lock_guard<std::mutex> lock(state.Lock);
+
+		const auto entry = state.Handles.find(reinterpret_cast<ULONG_PTR>(Object) >> 4);
+
+		if (entry == state.Handles.end())
+		{
+			SetLastError(ERROR_INVALID_HANDLE);
+			return FALSE;
+		}
+
+		object = std::move(entry->second);
+		state.Handles.erase(entry);
+	}
+
+	//
+	// Like the I/O manager the device gets to cancel what's still pending
+	// 
+	if (const auto file = std::dynamic_pointer_cast<FILE_OBJECT>(object))
+		file->Device->Cleanup(Object);
+
+	std::lock_guard<std::mutex> lock(state.Lock);
+	state.Closed.notify_all();
+
+	return TRUE;
+}
+
+#pragma endregion
+
+#pragma region Files and I/O control
+
+HANDLE CreateFileW(
+	LPCWSTR FileName,
+	DWORD DesiredAccess,
+	DWORD ShareMode,
+	LPVOID SecurityAttributes,
+	DWORD CreationDisposition,
+	DWORD FlagsAndAttributes,
+	HANDLE TemplateFile
+)
+{
+	(void)DesiredAccess;
+	(void)ShareMode;
+	(void)SecurityAttributes;
+	(void)CreationDisposition;
+	(void)FlagsAndAttributes;
+	(void)TemplateFile;
+
+	const auto file = std::make_shared<FILE_OBJECT>();
+
+	{
+		auto& state = GetState();
+		std::lock_guard<std::mutex> lock(state.Lock);
+
+		for (const auto& device : state.Devices)
+		{
+			if (wcscasecmp(device.first.c_str(), FileName) == 0)
+				file->Device = device.second;
+		}
+	}
+
+	if (!file->Device)
+	{
+		SetLastError(ERROR_FILE_NOT_FOUND);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	return InsertHandle(file);
+}
+
+BOOL DeviceIoControl(
+	HANDLE Device,
+	DWORD IoControlCode,
+	LPVOID InBuffer,
+	DWORD InBufferSize,
+	LPVOID OutBuffer,
+	DWORD OutBufferSize,
+	LPDWORD BytesReturned,
+	LPOVERLAPPED Overlapped
+)
+{
+	const auto file = LookupHandle<FILE_OBJECT>(Device);
+
+	if (!file)
+	{
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+
+	//
+	// Synchronous requests wait on an overlapped of their own
+	// 
+	OVERLAPPED synchronous = {};
+	const auto overlapped = Overlapped ? Overlapped : &synchronous;
+
+	if (!Overlapped)
+		synchronous.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	else if (Overlapped->hEvent)
+		ResetEvent(Overlapped->hEvent);
+
+	__atomic_store_n(&overlapped->Internal, IO_PENDING, __ATOMIC_RELAXED);
+
+	DWORD transferred = 0;
+	const auto error = file->Device->Control(
+		Device,
+		IoControlCode,
+		InBuffer,
+		InBufferSize,
+		OutBuffer,
+		OutBufferSize,
+		&transferred,
+		overlapped
+	);
+
+	if (error != ERROR_IO_PENDING)
+		ViGEm::Tests::CompleteIo(overlapped, error, transferred);
+
+	if (Overlapped)
+	{
+		if (error == ERROR_IO_PENDING)
+		{
+			SetLastError(ERROR_IO_PENDING);
+			return FALSE;
+		}
+
+		if (BytesReturned)
+			*BytesReturned = transferred;
+
+		SetLastError(error);
+
+		return error == ERROR_SUCCESS;
+	}
+
+	const auto result = GetOverlappedResult(Device, &synchronous, BytesReturned, TRUE);
+	const auto status = GetLastError();
+
+	CloseHandle(synchronous.hEvent);
+	SetLastError(status);
+
+	return result;
+}
+
+BOOL GetOverlappedResult(HANDLE File, LPOVERLAPPED Overlapped, LPDWORD NumberOfBytesTransferred, BOOL Wait)
+{
+	(void)File;
+
+	auto status = __atomic_load_n(&Overlapped->Internal, __ATOMIC_ACQUIRE);
+
+	while (status == IO_PENDING)
+	{
+		if (!Wait)
+		{
+			SetLastError(ERROR_IO_INCOMPLETE);
+			return FALSE;
+		}
+
+		if (Overlapped->hEvent)
+			WaitForSingleObject(Overlapped->hEvent, INFINITE);
+		else
+			std::this_thread::yield();
+
+		status = __atomic_load_n(&Overlapped->Internal, __ATOMIC_ACQUIRE);
+	}
+
+	if (NumberOfBytesTransferred)
+		*NumberOfBytesTransferred = static_cast<DWORD>(__atomic_load_n(&Overlapped->InternalHigh, __ATOMIC_RELAXED));
+
+	SetLastError(static_cast<DWORD>(status));
+
+	return status == ERROR_SUCCESS;
+}
+
+#pragma endregion
+
+#pragma region Device enumeration
+
+HDEVINFO SetupDiGetClassDevsW(const GUID* ClassGuid, PCWSTR Enumerator, HANDLE Parent, DWORD Flags)
+{
+	(void)ClassGuid;
+	(void)Enumerator;
+	(void)Parent;
+	(void)Flags;
+
+	auto& state = GetState();
+	std::lock_guard<std::mutex> lock(state.Lock);
+
+	//
+	// A snapshot of the interface paths present right now
+	// 
+	const auto paths = new std::vector<std::wstring>;
+
+	for (const auto& device : state.Devices)
+		paths->push_back(device.first);
+
+	return paths;
+}
+
+BOOL SetupDiEnumDeviceInterfaces(
+	HDEVINFO DeviceInfoSet,
+	PSP_DEVINFO_DATA DeviceInfoData,
+	const GUID* InterfaceClassGuid,
+	DWORD MemberIndex,
+	PSP_DEVICE_INTERFACE_DATA DeviceInterfaceData
+)
+{
+	(void)DeviceInfoData;
+
+	const auto paths = static_cast<std::vector<std::wstring>*>(DeviceInfoSet);
+
+	if (MemberIndex >= paths->size())
+	{
+		SetLastError(ERROR_NO_MORE_ITEMS);
+		return FALSE;
+	}
+
+	DeviceInterfaceData->InterfaceClassGuid = *InterfaceClassGuid;
+	DeviceInterfaceData->Flags = 0;
+	DeviceInterfaceData->Reserved = MemberIndex;
+
+	return TRUE;
+}
+
+BOOL SetupDiGetDeviceInterfaceDetailW(
+	HDEVINFO DeviceInfoSet,
+	PSP_DEVICE_INTERFACE_DATA DeviceInterfaceData,
+	PSP_DEVICE_INTERFACE_DETAIL_DATA_W DeviceInterfaceDetailData,
+	DWORD DeviceInterfaceDetailDataSize,
+	LPDWORD RequiredSize,
+	PSP_DEVINFO_DATA DeviceInfoData
+)
+{
+	(void)DeviceInfoData;
+
+	const auto& path = (*static_cast<std::vector<std::wstring>*>(DeviceInfoSet))[DeviceInterfaceData->Reserved];
+	const auto required = static_cast<DWORD>(
+		offsetof(SP_DEVICE_INTERFACE_DETAIL_DATA_W, DevicePath) + (path.size() + 1) * sizeof(WCHAR)
+	);
+
+	if (RequiredSize)
+		*RequiredSize = required;
+
+	if (!DeviceInterfaceDetailData || DeviceInterfaceDetailDataSize < required)
+	{
+		SetLastError(ERROR_INSUFFICIENT_BUFFER);
+		return FALSE;
+	}
+
+	memcpy(DeviceInterfaceDetailData->DevicePath, path.c_str(), (path.size() + 1) * sizeof(WCHAR));
+
+	return TRUE;
+}
+
+BOOL SetupDiDestroyDeviceInfoList(HDEVINFO DeviceInfoSet)
+{
+	delete static_cast<std::vector<std::wstring>*>(DeviceInfoSet);
+
+	return TRUE;
+}
+
+#pragma endregion
+
+#pragma region System
+
+BOOL QueryPerformanceCounter(PLARGE_INTEGER PerformanceCount)
+{
+	PerformanceCount->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+
+	return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(PLARGE_INTEGER Frequency)
+{
+	Frequency->QuadPart = 1000000000LL;
+
+	return TRUE;
+}
+
+VOID Sleep(DWORD Milliseconds)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(Milliseconds));
+}
+
+DWORD GetCurrentProcessId()
+{
+	return static_cast<DWORD>(getpid());
+}
+
+DWORD GetCurrentThreadId()
+{
+	return static_cast<DWORD>(syscall(SYS_gettid));
+}
+
+HMODULE LoadLibraryW(LPCWSTR LibFileName)
+{
+	(void)LibFileName;
+
+	SetLastError(ERROR_FILE_NOT_FOUND);
+
+	return nullptr;
+}
+
+FARPROC GetProcAddress(HMODULE Module, PCSTR ProcName)
+{
+	(void)Module;
+	(void)ProcName;
+
+	return nullptr;
+}
+
+#pragma endregion
@@ -0,0 +1,102 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <Windows.h>
+
+#include <memory>
+#include <string>
+
+//
+// Hooks of the Win32 stand-in (include/Windows.h) the tests drive the
+// client library with. Bus devices are objects registered under an
+// interface path; SetupAPI enumerates and CreateFile opens them.
+// 
+namespace ViGEm::Tests
+{
+	class Win32Device
+	{
+	public:
+		virtual ~Win32Device() = default;
+
+		//
+		// Handles one I/O control request sent through File. Returns the
+		// Win32 error of the request, or ERROR_IO_PENDING after keeping
+		// Overlapped around for CompleteIo.
+		// 
+		virtual DWORD Control(
+			HANDLE File,
+			DWORD IoControlCode,
+			PVOID InBuffer,
+			DWORD InBufferSize,
+			PVOID OutBuffer,
+			DWORD OutBufferSize,
+			LPDWORD BytesReturned,
+			LPOVERLAPPED Overlapped
+		) = 0;
+
+		//
+		// File got closed, requests of it still pending have to be completed
+		// 
+		virtual VOID Cleanup(HANDLE File) = 0;
+	};
+
+	//
+	// Makes the device show up in enumeration and openable under Path
+	// 
+	VOID AddDevice(const std::wstring& Path, std::shared_ptr<Win32Device> Device);
+
+	//
+	// Removes the device from enumeration, handles open to it keep working
+	// 
+	VOID RemoveDevice(const std::wstring& Path);
+
+	//
+	// Completes a request its device left pending
+	// 
+	VOID CompleteIo(LPOVERLAPPED Overlapped, DWORD Error, DWORD BytesReturned);
+
+	//
+	// Handles currently open, to check for leaks and wait for the client's
+	// worker threads to wind down (each holds an event while running)
+	// 
+	SIZE_T GetOpenHandles();
+
+	//
+	// Waits up to Milliseconds for the open handles to drop to Count
+	// 
+	bool WaitOpenHandles(SIZE_T Count, DWORD Milliseconds);
+}
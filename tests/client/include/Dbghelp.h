@@ -0,0 +1,4 @@
+//
+// Only needed by the crash handler, which the tests don't compile in
+// 
+#pragma once
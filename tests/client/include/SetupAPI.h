@@ -0,0 +1,63 @@
+//
+// Device interface enumeration over the devices the tests add, see Win32.hpp
+// 
+#pragma once
+
+#include <Windows.h>
+
+typedef PVOID HDEVINFO;
+
+#define DIGCF_PRESENT           0x00000002
+#define DIGCF_DEVICEINTERFACE   0x00000010
+
+typedef struct _SP_DEVINFO_DATA
+{
+	DWORD cbSize;
+	GUID ClassGuid;
+	DWORD DevInst;
+	ULONG_PTR Reserved;
+
+} SP_DEVINFO_DATA, *PSP_DEVINFO_DATA;
+
+typedef struct _SP_DEVICE_INTERFACE_DATA
+{
+	DWORD cbSize;
+	GUID InterfaceClassGuid;
+	DWORD Flags;
+	ULONG_PTR Reserved;
+
+} SP_DEVICE_INTERFACE_DATA, *PSP_DEVICE_INTERFACE_DATA;
+
+typedef struct _SP_DEVICE_INTERFACE_DETAIL_DATA_W
+{
+	DWORD cbSize;
+	WCHAR DevicePath[1];
+
+} SP_DEVICE_INTERFACE_DETAIL_DATA_W, *PSP_DEVICE_INTERFACE_DETAIL_DATA_W;
+
+typedef SP_DEVICE_INTERFACE_DETAIL_DATA_W SP_DEVICE_INTERFACE_DETAIL_DATA;
+typedef PSP_DEVICE_INTERFACE_DETAIL_DATA_W PSP_DEVICE_INTERFACE_DETAIL_DATA;
+
+HDEVINFO SetupDiGetClassDevsW(const GUID* ClassGuid, PCWSTR Enumerator, HANDLE Parent, DWORD Flags);
+
+BOOL SetupDiEnumDeviceInterfaces(
+	HDEVINFO DeviceInfoSet,
+	PSP_DEVINFO_DATA DeviceInfoData,
+	const GUID* InterfaceClassGuid,
+	DWORD MemberIndex,
+	PSP_DEVICE_INTERFACE_DATA DeviceInterfaceData
+);
+
+BOOL SetupDiGetDeviceInterfaceDetailW(
+	HDEVINFO DeviceInfoSet,
+	PSP_DEVICE_INTERFACE_DATA DeviceInterfaceData,
+	PSP_DEVICE_INTERFACE_DETAIL_DATA_W DeviceInterfaceDetailData,
+	DWORD DeviceInterfaceDetailDataSize,
+	LPDWORD RequiredSize,
+	PSP_DEVINFO_DATA DeviceInfoData
+);
+
+BOOL SetupDiDestroyDeviceInfoList(HDEVINFO DeviceInfoSet);
+
+#define SetupDiGetClassDevs SetupDiGetClassDevsW
+#define SetupDiGetDeviceInterfaceDetail SetupDiGetDeviceInterfaceDetailW
@@ -0,0 +1,189 @@
+//
+// Win32 subset the client library uses, implemented by Win32.cpp on top of
+// the standard library. Device handles lead to objects the tests provide,
+// see Win32.hpp.
+// 
+#pragma once
+
+#include "Platform.hpp"
+
+#include <pthread.h>
+#include <cwchar>
+
+#pragma region Types
+
+typedef wchar_t WCHAR;
+typedef WCHAR* PWSTR, *LPWSTR;
+typedef const WCHAR* PCWSTR, *LPCWSTR;
+typedef void* HANDLE, *LPVOID, *HMODULE;
+typedef HANDLE* PHANDLE;
+typedef const void* LPCVOID;
+typedef DWORD* LPDWORD;
+typedef uintptr_t ULONG_PTR;
+typedef intptr_t INT_PTR;
+typedef INT_PTR (*FARPROC)();
+
+typedef union _LARGE_INTEGER
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG HighPart;
+	};
+
+	LONGLONG QuadPart;
+
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+#define WINAPI
+#define CALLBACK
+#define CONST const
+
+#define UNREFERENCED_PARAMETER(P) ((void)(P))
+
+#define _Function_class_(Name)
+
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<INT_PTR>(-1)))
+
+#pragma endregion
+
+#pragma region Errors
+
+#define ERROR_SUCCESS                           0L
+#define ERROR_INVALID_FUNCTION                  1L
+#define ERROR_FILE_NOT_FOUND                    2L
+#define ERROR_ACCESS_DENIED                     5L
+#define ERROR_INVALID_HANDLE                    6L
+#define ERROR_NOT_SUPPORTED                     50L
+#define ERROR_DEV_NOT_EXIST                     55L
+#define ERROR_INVALID_PARAMETER                 87L
+#define ERROR_INSUFFICIENT_BUFFER               122L
+#define ERROR_NO_MORE_ITEMS                     259L
+#define ERROR_OPERATION_ABORTED                 995L
+#define ERROR_IO_INCOMPLETE                     996L
+#define ERROR_IO_PENDING                        997L
+#define ERROR_INVALID_DEVICE_OBJECT_PARAMETER   650L
+#define ERROR_NO_SYSTEM_RESOURCES               1450L
+
+DWORD GetLastError();
+VOID SetLastError(DWORD Error);
+
+#pragma endregion
+
+#pragma region Synchronization
+
+typedef struct _RTL_SRWLOCK
+{
+	pthread_rwlock_t Lock;
+
+} SRWLOCK, *PSRWLOCK;
+
+#define SRWLOCK_INIT { PTHREAD_RWLOCK_INITIALIZER }
+
+FORCEINLINE VOID InitializeSRWLock(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_init(&SRWLock->Lock, nullptr);
+}
+
+FORCEINLINE VOID AcquireSRWLockExclusive(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_wrlock(&SRWLock->Lock);
+}
+
+FORCEINLINE VOID ReleaseSRWLockExclusive(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_unlock(&SRWLock->Lock);
+}
+
+FORCEINLINE VOID AcquireSRWLockShared(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_rdlock(&SRWLock->Lock);
+}
+
+FORCEINLINE VOID ReleaseSRWLockShared(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_unlock(&SRWLock->Lock);
+}
+
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0x00000000L
+#define WAIT_TIMEOUT 0x00000102L
+#define WAIT_FAILED 0xFFFFFFFF
+
+HANDLE CreateEventW(LPVOID EventAttributes, BOOL ManualReset, BOOL InitialState, LPCWSTR Name);
+BOOL SetEvent(HANDLE Event);
+BOOL ResetEvent(HANDLE Event);
+DWORD WaitForSingleObject(HANDLE Handle, DWORD Milliseconds);
+BOOL CloseHandle(HANDLE Object);
+
+#define CreateEvent CreateEventW
+
+#pragma endregion
+
+#pragma region Files and I/O control
+
+#define GENERIC_READ                    0x80000000
+#define GENERIC_WRITE                   0x40000000
+#define FILE_SHARE_READ                 0x00000001
+#define FILE_SHARE_WRITE                0x00000002
+#define CREATE_ALWAYS                   2
+#define OPEN_EXISTING                   3
+#define FILE_ATTRIBUTE_NORMAL           0x00000080
+#define FILE_FLAG_WRITE_THROUGH         0x80000000
+#define FILE_FLAG_OVERLAPPED            0x40000000
+#define FILE_FLAG_NO_BUFFERING          0x20000000
+
+typedef struct _OVERLAPPED
+{
+	ULONG_PTR Internal;
+	ULONG_PTR InternalHigh;
+	DWORD Offset;
+	DWORD OffsetHigh;
+	HANDLE hEvent;
+
+} OVERLAPPED, *LPOVERLAPPED;
+
+HANDLE CreateFileW(
+	LPCWSTR FileName,
+	DWORD DesiredAccess,
+	DWORD ShareMode,
+	LPVOID SecurityAttributes,
+	DWORD CreationDisposition,
+	DWORD FlagsAndAttributes,
+	HANDLE TemplateFile
+);
+
+BOOL DeviceIoControl(
+	HANDLE Device,
+	DWORD IoControlCode,
+	LPVOID InBuffer,
+	DWORD InBufferSize,
+	LPVOID OutBuffer,
+	DWORD OutBufferSize,
+	LPDWORD BytesReturned,
+	LPOVERLAPPED Overlapped
+);
+
+BOOL GetOverlappedResult(HANDLE File, LPOVERLAPPED Overlapped, LPDWORD NumberOfBytesTransferred, BOOL Wait);
+
+#define CreateFile CreateFileW
+
+#pragma endregion
+
+#pragma region System
+
+BOOL QueryPerformanceCounter(PLARGE_INTEGER PerformanceCount);
+BOOL QueryPerformanceFrequency(PLARGE_INTEGER Frequency);
+VOID Sleep(DWORD Milliseconds);
+DWORD GetCurrentProcessId();
+DWORD GetCurrentThreadId();
+
+//
+// No system libraries to load, optional APIs look unsupported
+// 
+HMODULE LoadLibraryW(LPCWSTR LibFileName);
+FARPROC GetProcAddress(HMODULE Module, PCSTR ProcName);
+
+#define _wcsicmp wcscasecmp
+
+#pragma endregion
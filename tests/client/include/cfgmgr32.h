@@ -0,0 +1,75 @@
+//
+// Types of the device notification API. LoadLibraryW finds no cfgmgr32.dll,
+// so the functions themselves never get called.
+// 
+#pragma once
+
+#include <Windows.h>
+
+typedef DWORD CONFIGRET;
+typedef PVOID HCMNOTIFICATION, *PHCMNOTIFICATION;
+
+#define CR_SUCCESS 0x00000000
+
+typedef enum _CM_NOTIFY_FILTER_TYPE
+{
+	CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE = 0,
+	CM_NOTIFY_FILTER_TYPE_DEVICEHANDLE,
+	CM_NOTIFY_FILTER_TYPE_DEVICEINSTANCE
+
+} CM_NOTIFY_FILTER_TYPE;
+
+typedef struct _CM_NOTIFY_FILTER
+{
+	DWORD cbSize;
+	DWORD Flags;
+	CM_NOTIFY_FILTER_TYPE FilterType;
+	DWORD Reserved;
+
+	union
+	{
+		struct
+		{
+			GUID ClassGuid;
+		} DeviceInterface;
+
+		struct
+		{
+			HANDLE hTarget;
+		} DeviceHandle;
+
+	} u;
+
+} CM_NOTIFY_FILTER, *PCM_NOTIFY_FILTER;
+
+typedef enum _CM_NOTIFY_ACTION
+{
+	CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL = 0,
+	CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL
+
+} CM_NOTIFY_ACTION;
+
+typedef struct _CM_NOTIFY_EVENT_DATA
+{
+	CM_NOTIFY_FILTER_TYPE FilterType;
+	DWORD Reserved;
+
+	union
+	{
+		struct
+		{
+			GUID ClassGuid;
+			WCHAR SymbolicLink[1];
+		} DeviceInterface;
+
+	} u;
+
+} CM_NOTIFY_EVENT_DATA, *PCM_NOTIFY_EVENT_DATA;
+
+typedef DWORD (*PCM_NOTIFY_CALLBACK)(
+	HCMNOTIFICATION hNotify,
+	PVOID Context,
+	CM_NOTIFY_ACTION Action,
+	PCM_NOTIFY_EVENT_DATA EventData,
+	DWORD EventDataSize
+);
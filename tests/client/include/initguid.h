@@ -0,0 +1,4 @@
+//
+// DEFINE_GUID always defines the GUID, see Platform.hpp
+// 
+#pragma once
@@ -0,0 +1,6 @@
+//
+// The I/O control vocabulary comes with Platform.hpp
+// 
+#pragma once
+
+#include <Windows.h>
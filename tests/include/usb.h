@@ -0,0 +1,17 @@
+//
+// URB function codes the bus components classify, values as in the WDK
+// 
+#pragma once
+
+#define URB_FUNCTION_SELECT_CONFIGURATION               0x0000
+#define URB_FUNCTION_SELECT_INTERFACE                   0x0001
+#define URB_FUNCTION_ABORT_PIPE                         0x0002
+#define URB_FUNCTION_CONTROL_TRANSFER                   0x0008
+#define URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER         0x0009
+#define URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE         0x000B
+#define URB_FUNCTION_GET_STATUS_FROM_DEVICE             0x0013
+#define URB_FUNCTION_CLASS_DEVICE                       0x001A
+#define URB_FUNCTION_CLASS_INTERFACE                    0x001B
+#define URB_FUNCTION_SYNC_RESET_PIPE_AND_CLEAR_STALL    0x001E
+#define URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE      0x0028
+#define URB_FUNCTION_CONTROL_TRANSFER_EX                0x0032
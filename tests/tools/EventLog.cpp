@@ -0,0 +1,173 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "EventLog.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+
+bool ViGEm::Tools::ParseEventLog(
+	const UCHAR* Data,
+	size_t Length,
+	VIGEM_EVENT_LOG_HEADER& Header,
+	std::vector<VIGEM_EVENT_RECORD>& Records
+)
+{
+	if (Length < sizeof(VIGEM_EVENT_LOG_HEADER))
+		return false;
+
+	memcpy(&Header, Data, sizeof(VIGEM_EVENT_LOG_HEADER));
+
+	if (Header.Magic != VIGEM_EVENT_LOG_MAGIC
+		|| Header.Version != VIGEM_EVENT_LOG_VERSION
+		|| Header.RecordSize != sizeof(VIGEM_EVENT_RECORD))
+		return false;
+
+	const size_t payload = Length - sizeof(VIGEM_EVENT_LOG_HEADER);
+
+	//
+	// A partial record means a truncated file
+	// 
+	if (payload % sizeof(VIGEM_EVENT_RECORD))
+		return false;
+
+	Records.resize(payload / sizeof(VIGEM_EVENT_RECORD));
+
+	if (!Records.empty())
+		memcpy(Records.data(), Data + sizeof(VIGEM_EVENT_LOG_HEADER), payload);
+
+	//
+	// Each processor's records are already in order, drains interleave them
+	// 
+	std::stable_sort(Records.begin(), Records.end(), [](const VIGEM_EVENT_RECORD& Left, const VIGEM_EVENT_RECORD& Right)
+	{
+		return Left.Timestamp < Right.Timestamp;
+	});
+
+	return true;
+}
+
+bool ViGEm::Tools::ReadEventLog(const char* Path, VIGEM_EVENT_LOG_HEADER& Header,
+                                std::vector<VIGEM_EVENT_RECORD>& Records)
+{
+	FILE* file = fopen(Path, "rb");
+
+	if (!file)
+		return false;
+
+	std::vector<UCHAR> data;
+	UCHAR chunk[0x10000];
+	size_t read;
+
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		data.insert(data.end(), chunk, chunk + read);
+
+	const bool failed = ferror(file) != 0;
+
+	fclose(file);
+
+	return !failed && ParseEventLog(data.data(), data.size(), Header, Records);
+}
+
+bool ViGEm::Tools::WriteEventLog(const char* Path, const VIGEM_EVENT_LOG_HEADER& Header,
+                                 const std::vector<VIGEM_EVENT_RECORD>& Records)
+{
+	FILE* file = fopen(Path, "wb");
+
+	if (!file)
+		return false;
+
+	bool written = fwrite(&Header, sizeof(Header), 1, file) == 1;
+
+	if (written && !Records.empty())
+		written = fwrite(Records.data(), sizeof(VIGEM_EVENT_RECORD), Records.size(), file) == Records.size();
+
+	return (fclose(file) == 0) && written;
+}
+
+std::string ViGEm::Tools::FormatEvent(const VIGEM_EVENT_RECORD& Record, ULONGLONG Frequency, ULONGLONG Start)
+{
+	const ULONG* payload = Record.Payload;
+	const ULONGLONG elapsed = (Record.Timestamp > Start) ? Record.Timestamp - Start : 0;
+	char time[32];
+	char details[96];
+
+	if (Frequency)
+		snprintf(time, sizeof(time), "%14.3f us", static_cast<double>(elapsed) * 1000000.0 / static_cast<double>(Frequency));
+	else
+		snprintf(time, sizeof(time), "%14llu ticks", elapsed);
+
+	switch (Record.EventId)
+	{
+	case VIGEM_EVENT_REPORT_SUBMITTED:
+		snprintf(details, sizeof(details), "session=%d size=%u status=0x%08X",
+		         static_cast<LONG>(payload[0]), payload[1], payload[2]);
+		break;
+	case VIGEM_EVENT_REPORT_COALESCED:
+		snprintf(details, sizeof(details), "session=%d", static_cast<LONG>(payload[0]));
+		break;
+	case VIGEM_EVENT_MACRO_OVERLAY:
+		snprintf(details, sizeof(details), "set=0x%04X clear=0x%04X axes=0x%X", payload[0], payload[1], payload[2]);
+		break;
+	case VIGEM_EVENT_URB_INTERRUPT:
+		snprintf(details, sizeof(details), "flags=0x%X length=%u status=0x%08X", payload[0], payload[1], payload[2]);
+		break;
+	case VIGEM_EVENT_URB_OTHER:
+		snprintf(details, sizeof(details), "function=0x%04X status=0x%08X", payload[0], payload[1]);
+		break;
+	case VIGEM_EVENT_NOTIFICATION_QUEUED:
+		snprintf(details, sizeof(details), "length=%u", payload[0]);
+		break;
+	case VIGEM_EVENT_NOTIFICATION_COMPLETED:
+		snprintf(details, sizeof(details), "large=%u small=%u led_or_rgb=0x%X", payload[0], payload[1], payload[2]);
+		break;
+	case VIGEM_EVENT_LED_CHANGED:
+		snprintf(details, sizeof(details), "led=%d->%d", static_cast<LONG>(payload[0]), static_cast<LONG>(payload[1]));
+		break;
+	default:
+		snprintf(details, sizeof(details), "id=%u payload=%08X %08X %08X %08X",
+		         Record.EventId, payload[0], payload[1], payload[2], payload[3]);
+		break;
+	}
+
+	char line[192];
+
+	snprintf(line, sizeof(line), "%s  cpu %-3u serial %-5u %-22s %s",
+	         time, Record.Processor, Record.SerialNo, VIGEM_EVENT_NAME(Record.EventId), details);
+
+	return line;
+}
@@ -0,0 +1,73 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include "Platform.hpp"
+#endif
+
+#include <ViGEm/Common.h>
+#include <ViGEm/km/EventTrace.h>
+
+#include <string>
+#include <vector>
+
+namespace ViGEm::Tools
+{
+	//
+	// Parses a saved event log (see VIGEM_EVENT_LOG_HEADER). The records of
+	// all processors get merged into one timeline ordered by Timestamp.
+	// 
+	bool ParseEventLog(
+		const UCHAR* Data,
+		size_t Length,
+		VIGEM_EVENT_LOG_HEADER& Header,
+		std::vector<VIGEM_EVENT_RECORD>& Records
+	);
+
+	bool ReadEventLog(const char* Path, VIGEM_EVENT_LOG_HEADER& Header, std::vector<VIGEM_EVENT_RECORD>& Records);
+
+	bool WriteEventLog(const char* Path, const VIGEM_EVENT_LOG_HEADER& Header,
+	                   const std::vector<VIGEM_EVENT_RECORD>& Records);
+
+	//
+	// One line per record: time since Start in microseconds (counter ticks
+	// if Frequency is 0), processor, serial, event name and its payload
+	// 
+	std::string FormatEvent(const VIGEM_EVENT_RECORD& Record, ULONGLONG Frequency, ULONGLONG Start);
+}
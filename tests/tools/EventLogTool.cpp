@@ -0,0 +1,169 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "EventLog.hpp"
+
+#ifdef _WIN32
+#include <ViGEm/Client.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ViGEm::Tools;
+
+
+static void PrintUsage(const char* Program)
+{
+	fprintf(stderr, "usage: %s decode <file>\n", Program);
+#ifdef _WIN32
+	fprintf(stderr, "       %s capture <file> <seconds> [capacity]\n", Program);
+#endif
+}
+
+static int Decode(const char* Path)
+{
+	VIGEM_EVENT_LOG_HEADER header;
+	std::vector<VIGEM_EVENT_RECORD> records;
+
+	if (!ReadEventLog(Path, header, records))
+	{
+		fprintf(stderr, "%s is not a valid event log\n", Path);
+		return 1;
+	}
+
+	const ULONGLONG start = records.empty() ? 0 : records.front().Timestamp;
+
+	for (const auto& record : records)
+		printf("%s\n", FormatEvent(record, header.Frequency, start).c_str());
+
+	printf("%zu events, %llu dropped\n", records.size(), header.Dropped);
+
+	return 0;
+}
+
+#ifdef _WIN32
+
+//
+// Records the bus event trace for a while and saves it, needs an elevated
+// process like the trace itself
+// 
+static int Capture(const char* Path, ULONG Seconds, ULONG Capacity)
+{
+	static const ULONG DRAIN_INTERVAL_MS = 100;
+	static const ULONG DRAIN_COUNT = 0x1000;
+
+	const PVIGEM_CLIENT client = vigem_alloc();
+
+	if (!client)
+		return 1;
+
+	if (!VIGEM_SUCCESS(vigem_connect(client)))
+	{
+		fprintf(stderr, "bus not available\n");
+		vigem_free(client);
+		return 1;
+	}
+
+	VIGEM_EVENT_LOG_HEADER header;
+	std::vector<VIGEM_EVENT_RECORD> records;
+	std::vector<VIGEM_EVENT_RECORD> chunk(DRAIN_COUNT);
+	VIGEM_ERROR error = vigem_set_event_trace(client, TRUE, Capacity);
+
+	VIGEM_EVENT_LOG_HEADER_INIT(&header, 0);
+
+	for (ULONG elapsed = 0; VIGEM_SUCCESS(error); elapsed += DRAIN_INTERVAL_MS)
+	{
+		const bool last = elapsed >= Seconds * 1000;
+		ULONG drained = 0;
+
+		//
+		// Drain until empty so the rings never fill between intervals
+		// 
+		do
+		{
+			error = vigem_drain_events(client, chunk.data(), DRAIN_COUNT, &drained, &header.Dropped,
+			                           &header.Frequency);
+
+			if (VIGEM_SUCCESS(error))
+				records.insert(records.end(), chunk.begin(), chunk.begin() + drained);
+		}
+		while (VIGEM_SUCCESS(error) && drained == DRAIN_COUNT);
+
+		if (last)
+			break;
+
+		Sleep(DRAIN_INTERVAL_MS);
+	}
+
+	(void)vigem_set_event_trace(client, FALSE, 0);
+
+	vigem_disconnect(client);
+	vigem_free(client);
+
+	if (!VIGEM_SUCCESS(error))
+	{
+		fprintf(stderr, "event trace failed with 0x%X\n", error);
+		return 1;
+	}
+
+	if (!WriteEventLog(Path, header, records))
+	{
+		fprintf(stderr, "failed to write %s\n", Path);
+		return 1;
+	}
+
+	printf("%zu events, %llu dropped\n", records.size(), header.Dropped);
+
+	return 0;
+}
+
+#endif
+
+int main(int argc, char* argv[])
+{
+	if (argc == 3 && strcmp(argv[1], "decode") == 0)
+		return Decode(argv[2]);
+
+#ifdef _WIN32
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "capture") == 0)
+		return Capture(argv[2], strtoul(argv[3], nullptr, 10), (argc == 5) ? strtoul(argv[4], nullptr, 10) : 0);
+#endif
+
+	PrintUsage(argv[0]);
+
+	return 2;
+}
@@ -0,0 +1,192 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ReportLog.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+
+bool ViGEm::Tools::ParseReportLog(
+	const UCHAR* Data,
+	size_t Length,
+	VIGEM_REPORT_LOG_HEADER& Header,
+	std::vector<REPORT_LOG_ENTRY>& Entries
+)
+{
+	VIGEM_REPORT_LOG_STATE state;
+
+	if (Length < sizeof(VIGEM_REPORT_LOG_HEADER) || Length > MAXULONG)
+		return false;
+
+	memcpy(&Header, Data, sizeof(VIGEM_REPORT_LOG_HEADER));
+
+	if (Header.Magic != VIGEM_REPORT_LOG_MAGIC || Header.Version != VIGEM_REPORT_LOG_VERSION)
+		return false;
+
+	VIGEM_REPORT_LOG_STATE_INIT(&state, Header.StartTime);
+
+	Entries.clear();
+
+	ULONG offset = sizeof(VIGEM_REPORT_LOG_HEADER);
+
+	while (offset < Length)
+	{
+		REPORT_LOG_ENTRY entry;
+		const UCHAR* payload;
+
+		const ULONG consumed = VIGEM_REPORT_LOG_DECODE(
+			&state,
+			&Data[offset],
+			static_cast<ULONG>(Length) - offset,
+			&entry.Kind,
+			&entry.Time,
+			&payload,
+			&entry.Length
+		);
+
+		if (consumed == 0)
+		{
+			//
+			// Only a record that couldn't be complete is a truncation
+			// 
+			return Length - offset < VIGEM_REPORT_LOG_MAX_RECORD;
+		}
+
+		memcpy(entry.Payload, payload, entry.Length);
+
+		Entries.push_back(entry);
+
+		offset += consumed;
+	}
+
+	return true;
+}
+
+bool ViGEm::Tools::ReadReportLog(const char* Path, std::vector<UCHAR>& Data)
+{
+	FILE* file = fopen(Path, "rb");
+
+	if (!file)
+		return false;
+
+	UCHAR chunk[0x10000];
+	size_t read;
+
+	Data.clear();
+
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		Data.insert(Data.end(), chunk, chunk + read);
+
+	const bool failed = ferror(file) != 0;
+
+	fclose(file);
+
+	return !failed;
+}
+
+bool ViGEm::Tools::WriteReportLog(const char* Path, const std::vector<UCHAR>& Data)
+{
+	FILE* file = fopen(Path, "wb");
+
+	if (!file)
+		return false;
+
+	const bool written = Data.empty() || fwrite(Data.data(), Data.size(), 1, file) == 1;
+
+	return (fclose(file) == 0) && written;
+}
+
+size_t ViGEm::Tools::ReplayReportLog(
+	const VIGEM_REPORT_LOG_HEADER& Header,
+	const std::vector<REPORT_LOG_ENTRY>& Entries,
+	double Speed,
+	const std::function<bool(const REPORT_LOG_ENTRY&)>& Submit
+)
+{
+	using Clock = std::chrono::steady_clock;
+
+	const auto start = Clock::now();
+	size_t submitted = 0;
+
+	if (!(Speed > 0.0))
+		return 0;
+
+	for (const auto& entry : Entries)
+	{
+		if (entry.Kind != VIGEM_REPORT_LOG_INPUT)
+			continue;
+
+		const auto due = start + std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double, std::ratio<1, 10000000>>(
+				static_cast<double>(entry.Time - Header.StartTime) / Speed));
+
+		//
+		// Sleep most of the way, spin for the remainder to stay on time
+		// 
+		for (auto now = Clock::now(); now < due; now = Clock::now())
+		{
+			if (due - now > std::chrono::milliseconds(2))
+				std::this_thread::sleep_for(due - now - std::chrono::milliseconds(1));
+			else
+				std::this_thread::yield();
+		}
+
+		if (!Submit(entry))
+			break;
+
+		submitted++;
+	}
+
+	return submitted;
+}
+
+std::string ViGEm::Tools::FormatReportLogEntry(const REPORT_LOG_ENTRY& Entry, ULONGLONG Start)
+{
+	const ULONGLONG elapsed = (Entry.Time > Start) ? Entry.Time - Start : 0;
+	char line[64 + VIGEM_REPORT_LOG_MAX_PAYLOAD * 3];
+
+	int length = snprintf(line, sizeof(line), "%12.3f ms  %-6s %2u ",
+	                      static_cast<double>(elapsed) / 10000.0,
+	                      (Entry.Kind == VIGEM_REPORT_LOG_INPUT) ? "input" : "output",
+	                      Entry.Length);
+
+	for (ULONG index = 0; index < Entry.Length; index++)
+		length += snprintf(&line[length], sizeof(line) - length, " %02X", Entry.Payload[index]);
+
+	return line;
+}
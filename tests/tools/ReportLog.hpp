@@ -0,0 +1,107 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include "Platform.hpp"
+#endif
+
+#include <ViGEm/Common.h>
+#include <ViGEm/km/ReportLog.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ViGEm::Tools
+{
+	//
+	// One decoded record of a report log
+	// 
+	typedef struct _REPORT_LOG_ENTRY
+	{
+		VIGEM_REPORT_LOG_KIND Kind;
+
+		//
+		// 100ns units, same time base as VIGEM_REPORT_LOG_HEADER::StartTime
+		// 
+		ULONGLONG Time;
+
+		ULONG Length;
+
+		UCHAR Payload[VIGEM_REPORT_LOG_MAX_PAYLOAD];
+
+	} REPORT_LOG_ENTRY, *PREPORT_LOG_ENTRY;
+
+	//
+	// Parses a drained report log (see ViGEm/km/ReportLog.h). Fails on a bad
+	// header or a malformed record; a log cut off in the middle of its last
+	// record parses up to that record.
+	// 
+	bool ParseReportLog(
+		const UCHAR* Data,
+		size_t Length,
+		VIGEM_REPORT_LOG_HEADER& Header,
+		std::vector<REPORT_LOG_ENTRY>& Entries
+	);
+
+	bool ReadReportLog(const char* Path, std::vector<UCHAR>& Data);
+
+	bool WriteReportLog(const char* Path, const std::vector<UCHAR>& Data);
+
+	//
+	// Hands the input records to Submit at their recorded pace divided by
+	// Speed, measured from the call. Output records are skipped, they only
+	// document what the host sent. Stops early if Submit returns false and
+	// returns the number of records submitted.
+	// 
+	// Same pacing as vigem_target_replay, usable without a bus.
+	// 
+	size_t ReplayReportLog(
+		const VIGEM_REPORT_LOG_HEADER& Header,
+		const std::vector<REPORT_LOG_ENTRY>& Entries,
+		double Speed,
+		const std::function<bool(const REPORT_LOG_ENTRY&)>& Submit
+	);
+
+	//
+	// One line per record: time since the log start in milliseconds, kind
+	// and the payload in hex
+	// 
+	std::string FormatReportLogEntry(const REPORT_LOG_ENTRY& Entry, ULONGLONG Start);
+}
@@ -0,0 +1,165 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ReportLog.hpp"
+
+#ifdef _WIN32
+#include <ViGEm/Client.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ViGEm::Tools;
+
+
+static void PrintUsage(const char* Program)
+{
+	fprintf(stderr, "usage: %s decode <file>\n", Program);
+#ifdef _WIN32
+	fprintf(stderr, "       %s replay <file> [speed]\n", Program);
+#endif
+}
+
+static bool Load(const char* Path, std::vector<UCHAR>& Data, VIGEM_REPORT_LOG_HEADER& Header,
+                 std::vector<REPORT_LOG_ENTRY>& Entries)
+{
+	if (ReadReportLog(Path, Data) && ParseReportLog(Data.data(), Data.size(), Header, Entries))
+		return true;
+
+	fprintf(stderr, "%s is not a valid report log\n", Path);
+
+	return false;
+}
+
+static int Decode(const char* Path)
+{
+	std::vector<UCHAR> data;
+	VIGEM_REPORT_LOG_HEADER header;
+	std::vector<REPORT_LOG_ENTRY> entries;
+
+	if (!Load(Path, data, header, entries))
+		return 1;
+
+	printf("target type %u, serial %u\n", header.TargetType, header.SerialNo);
+
+	for (const auto& entry : entries)
+		printf("%s\n", FormatReportLogEntry(entry, header.StartTime).c_str());
+
+	printf("%zu records\n", entries.size());
+
+	return 0;
+}
+
+#ifdef _WIN32
+
+//
+// Plugs in a target of the recorded type and feeds it the recorded reports
+// 
+static int Replay(const char* Path, double Speed)
+{
+	std::vector<UCHAR> data;
+	VIGEM_REPORT_LOG_HEADER header;
+	std::vector<REPORT_LOG_ENTRY> entries;
+
+	if (!Load(Path, data, header, entries))
+		return 1;
+
+	PVIGEM_TARGET target;
+
+	switch (header.TargetType)
+	{
+	case Xbox360Wired:
+		target = vigem_target_x360_alloc();
+		break;
+	case DualShock4Wired:
+		target = vigem_target_ds4_alloc();
+		break;
+	default:
+		fprintf(stderr, "unsupported target type %u\n", header.TargetType);
+		return 1;
+	}
+
+	const PVIGEM_CLIENT client = vigem_alloc();
+
+	if (!client || !target)
+	{
+		vigem_target_free(target);
+		vigem_free(client);
+		return 1;
+	}
+
+	VIGEM_ERROR error = vigem_connect(client);
+
+	if (VIGEM_SUCCESS(error))
+		error = vigem_target_add(client, target);
+
+	if (VIGEM_SUCCESS(error))
+	{
+		error = vigem_target_replay(client, target, data.data(), static_cast<ULONG>(data.size()), Speed);
+
+		(void)vigem_target_remove(client, target);
+	}
+
+	vigem_target_free(target);
+	vigem_disconnect(client);
+	vigem_free(client);
+
+	if (!VIGEM_SUCCESS(error))
+	{
+		fprintf(stderr, "replay failed with 0x%X\n", error);
+		return 1;
+	}
+
+	return 0;
+}
+
+#endif
+
+int main(int argc, char* argv[])
+{
+	if (argc == 3 && strcmp(argv[1], "decode") == 0)
+		return Decode(argv[2]);
+
+#ifdef _WIN32
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "replay") == 0)
+		return Replay(argv[2], (argc == 4) ? strtod(argv[3], nullptr) : 1.0);
+#endif
+
+	PrintUsage(argv[0]);
+
+	return 2;
+}